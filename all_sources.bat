@@ -13,6 +13,9 @@ set CONCURRENTCHUNKWRITE_SRC=%BASE_DIR%lib\concurrentchunkwrite\*.c
 
 set CACHEBLOCKSTORE_SRC=%BASE_DIR%lib\cacheblockstore\*.c
 
+set DIRECTORYCACHE_SRC=%BASE_DIR%lib\directorycache\*.c
+set DELTABLOCKSTORE_SRC=%BASE_DIR%lib\deltablockstore\*.c
+
 set FILESTORAGE_SRC=%BASE_DIR%lib\*.c
 
 set FSBLOCKSTORE_SRC=%BASE_DIR%lib\fsblockstore\*.c
@@ -29,6 +32,8 @@ set MEOWHASH_SRC=%BASE_DIR%lib\meowhash\*.c
 
 set RATELIMITEDPROGRESS_SRC=%BASE_DIR%lib\ratelimitedprogress\*.c
 
+set READAHEADSTORAGE_SRC=%BASE_DIR%lib\readaheadstorage\*.c
+
 set COMPRESSION_REGISTRY_SRC=%BASE_DIR%lib\compressionregistry\*.c
 
 set HASH_REGISTRY_SRC=%BASE_DIR%lib\hashregistry\*.c
@@ -48,6 +53,8 @@ set BLAKE3_THIRDPARTY_AVX2=%BASE_DIR%lib\blake3\ext\blake3_avx2.c
 set BLAKE3_THIRDPARTY_AVX512=%BASE_DIR%lib\blake3\ext\blake3_avx512.c
 set BLAKE3_THIRDPARTY_NEON=%BASE_DIR%lib\blake3\ext\blake3_neon.c
 
+set XXH3_SRC=%BASE_DIR%lib\xxh3\*.c
+
 set LZ4_SRC=%BASE_DIR%lib\lz4\*.c
 set LZ4_THIRDPARTY_SRC=%BASE_DIR%lib\lz4\ext\*.c
 
@@ -58,7 +65,7 @@ set ZSTD_SRC=%BASE_DIR%lib\zstd\*.c
 set ZSTD_THIRDPARTY_SRC=%BASE_DIR%lib\zstd\ext\common\*.c %BASE_DIR%lib\zstd\ext\compress\*.c %BASE_DIR%lib\zstd\ext\decompress\*.c
 set ZSTD_THIRDPARTY_GCC_SRC=%BASE_DIR%lib\zstd\ext\decompress\*.S
 
-set SRC=%BASE_DIR%src\*.c %LIB_SRC% %ARCHIVEBLOCKSTORE_SRC% %ATOMICCANCEL_SRC% %BLOCKSTORESTORAGE_SRC% %COMPRESSBLOCKSTORE_SRC% %CONCURRENTCHUNKWRITE_SRC% %CACHEBLOCKSTORE_SRC% %SHAREBLOCKSTORE_SRC% %FILESTORAGE_SRC% %FSBLOCKSTORE_SRC% %HPCDCCHUNKER_SRC% %LRUBLOCKSTORE_SRC% %MEMSTORAGE_SRC% %MEMTRACER_SRC% %RATELIMITEDPROGRESS_SRC% %COMPRESSION_REGISTRY_SRC% %HASH_REGISTRY_SRC% %BIKESHED_SRC% %BLAKE2_SRC% %BLAKE3_SRC% %MEOWHASH_SRC% %LZ4_SRC% %BROTLI_SRC% %ZSTD_SRC%
+set SRC=%BASE_DIR%src\*.c %LIB_SRC% %ARCHIVEBLOCKSTORE_SRC% %ATOMICCANCEL_SRC% %BLOCKSTORESTORAGE_SRC% %COMPRESSBLOCKSTORE_SRC% %CONCURRENTCHUNKWRITE_SRC% %CACHEBLOCKSTORE_SRC% %DIRECTORYCACHE_SRC% %DELTABLOCKSTORE_SRC% %SHAREBLOCKSTORE_SRC% %FILESTORAGE_SRC% %FSBLOCKSTORE_SRC% %HPCDCCHUNKER_SRC% %LRUBLOCKSTORE_SRC% %MEMSTORAGE_SRC% %MEMTRACER_SRC% %RATELIMITEDPROGRESS_SRC% %READAHEADSTORAGE_SRC% %COMPRESSION_REGISTRY_SRC% %HASH_REGISTRY_SRC% %BIKESHED_SRC% %BLAKE2_SRC% %BLAKE3_SRC% %MEOWHASH_SRC% %XXH3_SRC% %LZ4_SRC% %BROTLI_SRC% %ZSTD_SRC%
 set THIRDPARTY_SRC=%LIB_THIRDPARTY_SRC% %BLAKE3_THIRDPARTY_SRC% %LZ4_THIRDPARTY_SRC% %BROTLI_THIRDPARTY_SRC% %ZSTD_THIRDPARTY_SRC%
 set THIRDPARTY_SSE=%BLAKE2_THIRDPARTY_SSE% %BLAKE3_THIRDPARTY_SSE%
 set THIRDPARTY_SSE42=%BLAKE3_THIRDPARTY_SSE42%
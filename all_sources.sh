@@ -15,6 +15,9 @@ CONCURRENTCHUNKWRITE_SRC="${BASE_DIR}lib/concurrentchunkwrite/*.c"
 
 CACHEBLOCKSTORE_SRC="${BASE_DIR}lib/cacheblockstore/*.c"
 
+DIRECTORYCACHE_SRC="${BASE_DIR}lib/directorycache/*.c"
+DELTABLOCKSTORE_SRC="${BASE_DIR}lib/deltablockstore/*.c"
+
 FILESTORAGE_SRC="${BASE_DIR}lib/*.c"
 
 FSBLOCKSTORAGE_SRC="${BASE_DIR}lib/fsblockstore/*.c"
@@ -31,6 +34,8 @@ MEOWHASH_SRC="${BASE_DIR}lib/meowhash/*.c"
 
 RATELIMITEDPROGRESS_SRC="${BASE_DIR}lib/ratelimitedprogress/*.c"
 
+READAHEADSTORAGE_SRC="${BASE_DIR}lib/readaheadstorage/*.c"
+
 COMPRESSION_REGISTRY_SRC="${BASE_DIR}lib/compressionregistry/*.c"
 
 HASH_REGISTRY_SRC="${BASE_DIR}lib/hashregistry/*.c"
@@ -50,6 +55,8 @@ BLAKE3_THIRDPARTY_AVX2="${BASE_DIR}lib/blake3/ext/blake3_avx2.c"
 BLAKE3_THIRDPARTY_AVX512="${BASE_DIR}lib/blake3/ext/blake3_avx512.c"
 BLAKE3_THIRDPARTY_NEON="${BASE_DIR}lib/blake3/ext/blake3_neon.c"
 
+XXH3_SRC="${BASE_DIR}lib/xxh3/*.c"
+
 LZ4_SRC="${BASE_DIR}lib/lz4/*.c"
 LZ4_THIRDPARTY_SRC="${BASE_DIR}lib/lz4/ext/*.c"
 
@@ -60,7 +67,7 @@ ZSTD_SRC="${BASE_DIR}lib/zstd/*.c"
 ZSTD_THIRDPARTY_SRC="${BASE_DIR}lib/zstd/ext/common/*.c ${BASE_DIR}lib/zstd/ext/compress/*.c ${BASE_DIR}lib/zstd/ext/decompress/*.c"
 ZSTD_THIRDPARTY_GCC_SRC="${BASE_DIR}lib/zstd/ext/decompress/*.S"
 
-export SRC="${BASE_DIR}src/*.c $LIB_SRC $ARCHIVEBLOCKSTORE_SRC $ATOMICCANCEL_SRC $BLOCKSTORESTORAGE_SRC $COMPRESSBLOCKSTORE_SRC $CONCURRENTCHUNKWRITE_SRC $CACHEBLOCKSTORE_SRC $SHAREBLOCKSTORE_SRC $FILESTORAGE_SRC $FSBLOCKSTORAGE_SRC $HPCDCCHUNKER_SRC $LRUBLOCKSTORE_SRC $MEMSTORAGE_SRC $MEMTRACER_SRC $RATELIMITEDPROGRESS_SRC $COMPRESSION_REGISTRY_SRC $HASH_REGISTRY_SRC $BIKESHED_SRC $BLAKE2_SRC $BLAKE3_SRC $MEOWHASH_SRC $LZ4_SRC $BROTLI_SRC $ZSTD_SRC"
+export SRC="${BASE_DIR}src/*.c $LIB_SRC $ARCHIVEBLOCKSTORE_SRC $ATOMICCANCEL_SRC $BLOCKSTORESTORAGE_SRC $COMPRESSBLOCKSTORE_SRC $CONCURRENTCHUNKWRITE_SRC $CACHEBLOCKSTORE_SRC $DIRECTORYCACHE_SRC $DELTABLOCKSTORE_SRC $SHAREBLOCKSTORE_SRC $FILESTORAGE_SRC $FSBLOCKSTORAGE_SRC $HPCDCCHUNKER_SRC $LRUBLOCKSTORE_SRC $MEMSTORAGE_SRC $MEMTRACER_SRC $RATELIMITEDPROGRESS_SRC $READAHEADSTORAGE_SRC $COMPRESSION_REGISTRY_SRC $HASH_REGISTRY_SRC $BIKESHED_SRC $BLAKE2_SRC $BLAKE3_SRC $MEOWHASH_SRC $XXH3_SRC $LZ4_SRC $BROTLI_SRC $ZSTD_SRC"
 export THIRDPARTY_SRC="$LIB_THIRDPARTY_SRC $BLAKE3_THIRDPARTY_SRC $LZ4_THIRDPARTY_SRC $BROTLI_THIRDPARTY_SRC $ZSTD_THIRDPARTY_SRC"
 export THIRDPARTY_SSE="$BLAKE2_THIRDPARTY_SSE $BLAKE3_THIRDPARTY_SSE"
 export THIRDPARTY_SSE42="$BLAKE3_THIRDPARTY_SSE42"
@@ -11,3 +11,12 @@ MINIFB_SRC="${BASE_DIR}cmd/lib/minifb/*.c"
 SRC="${SRC} ${MINIFB_SRC}"
 
 export MAIN_SRC="$BASE_DIR/cmd/main.c"
+
+# `longtail mount` is only available when libfuse3 is installed
+if pkg-config --exists fuse3 2>/dev/null; then
+    FUSE_CXXFLAGS="-DLONGTAIL_ENABLE_FUSE $(pkg-config --cflags fuse3)"
+    export CXXFLAGS="$CXXFLAGS $FUSE_CXXFLAGS"
+    export CXXFLAGS_DEBUG="$CXXFLAGS_DEBUG $FUSE_CXXFLAGS"
+    # Libraries must come after the sources that use them
+    export MAIN_SRC="$MAIN_SRC $(pkg-config --libs fuse3)"
+fi
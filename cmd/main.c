@@ -12,6 +12,7 @@
 #include "../lib/cacheblockstore/longtail_cacheblockstore.h"
 #include "../lib/compressionregistry/longtail_full_compression_registry.h"
 #include "../lib/concurrentchunkwrite/longtail_concurrentchunkwrite.h"
+#include "../lib/deltablockstore/longtail_deltablockstore.h"
 #include "../lib/fsblockstore/longtail_fsblockstore.h"
 #include "../lib/hpcdcchunker/longtail_hpcdcchunker.h"
 #include "../lib/filestorage/longtail_filestorage.h"
@@ -20,7 +21,9 @@
 #include "../lib/memstorage/longtail_memstorage.h"
 #include "../lib/memtracer/longtail_memtracer.h"
 #include "../lib/meowhash/longtail_meowhash.h"
+#include "../lib/xxh3/longtail_xxh3.h"
 #include "../lib/ratelimitedprogress/longtail_ratelimitedprogress.h"
+#include "../lib/readaheadstorage/longtail_readaheadstorage.h"
 #include "../lib/shareblockstore/longtail_shareblockstore.h"
 #include "../lib/brotli/longtail_brotli.h"
 #include "../lib/lz4/longtail_lz4.h"
@@ -43,6 +46,13 @@
 #include <unistd.h>
 #endif
 
+#if defined(LONGTAIL_ENABLE_FUSE)
+#define FUSE_USE_VERSION 31
+#include <fuse.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
 static void AssertFailure(const char* expression, const char* file, int line)
 {
     fprintf(stderr, "%s(%d): Assert failed `%s`\n", file, line, expression);
@@ -729,6 +739,100 @@ struct Longtail_ProgressAPI* MakeProgressAPI(const char* task, uint32_t percent_
     return me->m_RateLimitedProgressAPI;
 }
 
+struct PathFilter
+{
+    struct Longtail_PathFilterAPI m_API;
+    const char* m_IncludePaths;
+    const char* m_ExcludePaths;
+};
+
+// Returns 1 if path is folder or a path in folder, folder is not zero terminated
+static int PathFilter_IsInFolder(const char* path, size_t path_length, const char* folder, size_t folder_length)
+{
+    if (path_length < folder_length || strncmp(path, folder, folder_length) != 0)
+    {
+        return 0;
+    }
+    return path_length == folder_length || path[folder_length] == '/';
+}
+
+// Returns 1 if asset_path matches any of the ';' separated paths, with match_parents the folders leading up to
+// a path also match
+static int PathFilter_MatchAny(const char* paths, const char* asset_path, int match_parents)
+{
+    size_t asset_path_length = strlen(asset_path);
+    while (*paths)
+    {
+        const char* separator = strchr(paths, ';');
+        size_t length = separator ? (size_t)(separator - paths) : strlen(paths);
+        size_t folder_length = length;
+        while (folder_length > 0 && paths[folder_length - 1] == '/')
+        {
+            --folder_length;
+        }
+        if (folder_length > 0)
+        {
+            if (PathFilter_IsInFolder(asset_path, asset_path_length, paths, folder_length))
+            {
+                return 1;
+            }
+            if (match_parents && PathFilter_IsInFolder(paths, folder_length, asset_path, asset_path_length))
+            {
+                return 1;
+            }
+        }
+        paths = &paths[length];
+        if (*paths == ';')
+        {
+            ++paths;
+        }
+    }
+    return 0;
+}
+
+static int PathFilter_Include(struct Longtail_PathFilterAPI* path_filter_api, const char* root_path, const char* asset_path, const char* asset_name, int is_dir, uint64_t size, uint16_t permissions)
+{
+    struct PathFilter* path_filter = (struct PathFilter*)path_filter_api;
+    if (path_filter->m_ExcludePaths && PathFilter_MatchAny(path_filter->m_ExcludePaths, asset_path, 0))
+    {
+        return 0;
+    }
+    if (path_filter->m_IncludePaths == 0)
+    {
+        return 1;
+    }
+    return PathFilter_MatchAny(path_filter->m_IncludePaths, asset_path, is_dir);
+}
+
+static void PathFilter_Dispose(struct Longtail_API* api)
+{
+    Longtail_Free(api);
+}
+
+// Creates a filter from ';' separated lists of files and folders to include and exclude, null if there is nothing to filter
+struct Longtail_PathFilterAPI* MakePathFilterAPI(const char* optional_include_paths, const char* optional_exclude_paths)
+{
+    if (optional_include_paths == 0 && optional_exclude_paths == 0)
+    {
+        return 0;
+    }
+    void* mem = Longtail_Alloc(0, sizeof(struct PathFilter));
+    if (!mem)
+    {
+        return 0;
+    }
+    struct Longtail_PathFilterAPI* path_filter_api = Longtail_MakePathFilterAPI(mem, PathFilter_Dispose, PathFilter_Include);
+    if (!path_filter_api)
+    {
+        Longtail_Free(mem);
+        return 0;
+    }
+    struct PathFilter* me = (struct PathFilter*)path_filter_api;
+    me->m_IncludePaths = optional_include_paths;
+    me->m_ExcludePaths = optional_exclude_paths;
+    return path_filter_api;
+}
+
 int ParseLogLevel(const char* log_level_raw) {
     if (0 == strcmp(log_level_raw, "debug"))
     {
@@ -827,6 +931,40 @@ uint32_t ParseCompressionType(const char* compression_algorithm) {
     return 0xffffffff;
 }
 
+// Gets the compression types of the family of compression_type ordered from fastest to strongest
+static uint32_t GetAdaptiveCompressionTypes(uint32_t compression_type, uint32_t* out_compression_types)
+{
+    if (compression_type == Longtail_GetZStdDefaultQuality() ||
+        compression_type == Longtail_GetZStdMinQuality() ||
+        compression_type == Longtail_GetZStdHighQuality() ||
+        compression_type == Longtail_GetZStdMaxQuality())
+    {
+        out_compression_types[0] = Longtail_GetZStdDefaultQuality();
+        out_compression_types[1] = Longtail_GetZStdHighQuality();
+        out_compression_types[2] = Longtail_GetZStdMaxQuality();
+        return 3;
+    }
+    if (compression_type == Longtail_GetBrotliGenericMinQuality() ||
+        compression_type == Longtail_GetBrotliGenericDefaultQuality() ||
+        compression_type == Longtail_GetBrotliGenericMaxQuality())
+    {
+        out_compression_types[0] = Longtail_GetBrotliGenericMinQuality();
+        out_compression_types[1] = Longtail_GetBrotliGenericDefaultQuality();
+        out_compression_types[2] = Longtail_GetBrotliGenericMaxQuality();
+        return 3;
+    }
+    if (compression_type == Longtail_GetBrotliTextMinQuality() ||
+        compression_type == Longtail_GetBrotliTextDefaultQuality() ||
+        compression_type == Longtail_GetBrotliTextMaxQuality())
+    {
+        out_compression_types[0] = Longtail_GetBrotliTextMinQuality();
+        out_compression_types[1] = Longtail_GetBrotliTextDefaultQuality();
+        out_compression_types[2] = Longtail_GetBrotliTextMaxQuality();
+        return 3;
+    }
+    return 0;
+}
+
 uint32_t ParseHashingType(const char* hashing_type)
 {
     if (0 == hashing_type || (strcmp("blake3", hashing_type) == 0))
@@ -841,6 +979,10 @@ uint32_t ParseHashingType(const char* hashing_type)
     {
         return Longtail_GetMeowHashType();
     }
+    if (strcmp("xxh3", hashing_type) == 0)
+    {
+        return Longtail_GetXXH3HashType();
+    }
     return 0xffffffff;
 }
 
@@ -937,18 +1079,35 @@ static int SyncGetExistingContent(struct Longtail_BlockStoreAPI* block_store, ui
     return 0;
 }
 
+// Stores written with upsync --delta-blocks have a delta sidecar index and must be read through a delta block store
+static int StoreHasDeltaBlocks(struct Longtail_StorageAPI* storage_api, const char* storage_path)
+{
+    char* delta_index_path = storage_api->ConcatPath(storage_api, storage_path, "store.ldi");
+    int has_delta_blocks = Longtail_DeltaBlockStore_HasIndex(storage_api, delta_index_path);
+    Longtail_Free(delta_index_path);
+    return has_delta_blocks;
+}
+
 int UpSync(
     const char* storage_uri_raw,
     const char* source_path,
     const char* optional_source_index_path,
     const char* target_index_path,
+    const char* optional_version_local_store_index_path,
+    const char* optional_block_ref_count_path,
     uint32_t target_chunk_size,
     uint32_t target_block_size,
     uint32_t max_chunks_per_block,
     uint32_t min_block_usage_percent,
     uint32_t hashing_type,
     uint32_t compression_type,
+    int enable_adaptive_compression,
+    int enable_raw_frames,
+    int enable_content_type_tags,
+    int enable_compact_version_index,
+    int enable_delta_blocks,
     int enable_mmap_indexing,
+    int enable_read_ahead_indexing,
     int enable_mmap_block_store,
     int enable_detailed_progress)
 {
@@ -957,13 +1116,21 @@ int UpSync(
         LONGTAIL_LOGFIELD(source_path, "%s"),
         LONGTAIL_LOGFIELD(optional_source_index_path, "%p"),
         LONGTAIL_LOGFIELD(target_index_path, "%s"),
+        LONGTAIL_LOGFIELD(optional_version_local_store_index_path, "%p"),
+        LONGTAIL_LOGFIELD(optional_block_ref_count_path, "%p"),
         LONGTAIL_LOGFIELD(target_chunk_size, "%u"),
         LONGTAIL_LOGFIELD(target_block_size, "%u"),
         LONGTAIL_LOGFIELD(max_chunks_per_block, "%u"),
         LONGTAIL_LOGFIELD(min_block_usage_percent, "%u"),
         LONGTAIL_LOGFIELD(hashing_type, "%u"),
         LONGTAIL_LOGFIELD(compression_type, "%u"),
+        LONGTAIL_LOGFIELD(enable_adaptive_compression, "%d"),
+        LONGTAIL_LOGFIELD(enable_raw_frames, "%d"),
+        LONGTAIL_LOGFIELD(enable_content_type_tags, "%d"),
+        LONGTAIL_LOGFIELD(enable_compact_version_index, "%d"),
+        LONGTAIL_LOGFIELD(enable_delta_blocks, "%d"),
         LONGTAIL_LOGFIELD(enable_mmap_indexing, "%d"),
+        LONGTAIL_LOGFIELD(enable_read_ahead_indexing, "%d"),
         LONGTAIL_LOGFIELD(enable_mmap_block_store, "%d"),
         LONGTAIL_LOGFIELD(enable_detailed_progress, "%d")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
@@ -974,12 +1141,23 @@ int UpSync(
     struct Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
     struct Longtail_StorageAPI* storage_api = Longtail_CreateFSStorageAPI();
     struct Longtail_BlockStoreAPI* store_block_fsstore_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, storage_path, 0, enable_mmap_block_store);
-    struct Longtail_BlockStoreAPI* store_block_store_api = Longtail_CreateCompressBlockStoreAPI(store_block_fsstore_api, compression_registry);
+    uint32_t adaptive_compression_types[3];
+    uint32_t adaptive_compression_type_count = enable_adaptive_compression ? GetAdaptiveCompressionTypes(compression_type, adaptive_compression_types) : 0;
+    struct Longtail_BlockStoreAPI* store_block_compressstore_api = Longtail_CreateCompressBlockStoreAPI4(store_block_fsstore_api, compression_registry, 0, 0, 0, enable_raw_frames, adaptive_compression_types, adaptive_compression_type_count);
+    struct Longtail_BlockStoreAPI* store_block_deltastore_api = 0;
+    if (enable_delta_blocks)
+    {
+        // The sidecar index keeps the base block candidates between upsyncs to the same store
+        char* delta_index_path = storage_api->ConcatPath(storage_api, storage_path, "store.ldi");
+        store_block_deltastore_api = Longtail_CreateDeltaBlockStoreAPI(store_block_compressstore_api, storage_api, delta_index_path);
+        Longtail_Free(delta_index_path);
+    }
+    struct Longtail_BlockStoreAPI* store_block_store_api = store_block_deltastore_api ? store_block_deltastore_api : store_block_compressstore_api;
 
     struct Longtail_VersionIndex* source_version_index = 0;
     if (optional_source_index_path)
     {
-        int err = Longtail_ReadVersionIndex(storage_api, optional_source_index_path, &source_version_index);
+        int err = Longtail_ReadVersionIndex2(storage_api, compression_registry, job_api, optional_source_index_path, &source_version_index);
         if (err)
         {
             LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to read version index from `%s`, %d", optional_source_index_path, err);
@@ -991,7 +1169,8 @@ int UpSync(
     if (err)
     {
         Longtail_Free(source_version_index);
-        SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(store_block_deltastore_api);
+        SAFE_DISPOSE_API(store_block_compressstore_api);
         SAFE_DISPOSE_API(store_block_fsstore_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
@@ -1005,7 +1184,8 @@ int UpSync(
     if (!chunker_api)
     {
         Longtail_Free(source_version_index);
-        SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(store_block_deltastore_api);
+        SAFE_DISPOSE_API(store_block_compressstore_api);
         SAFE_DISPOSE_API(store_block_fsstore_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
@@ -1031,7 +1211,8 @@ int UpSync(
         {
             LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to scan version content from `%s`, %d", source_path, err);
             SAFE_DISPOSE_API(chunker_api);
-            SAFE_DISPOSE_API(store_block_store_api);
+            SAFE_DISPOSE_API(store_block_deltastore_api);
+            SAFE_DISPOSE_API(store_block_compressstore_api);
             SAFE_DISPOSE_API(store_block_fsstore_api);
             SAFE_DISPOSE_API(storage_api);
             SAFE_DISPOSE_API(compression_registry);
@@ -1041,16 +1222,45 @@ int UpSync(
             return err;
         }
         uint32_t* tags = (uint32_t*)Longtail_Alloc(0, sizeof(uint32_t) * file_infos->m_Count);
-        for (uint32_t i = 0; i < file_infos->m_Count; ++i)
+        if (enable_content_type_tags)
+        {
+            err = Longtail_GetContentTypeAssetTags(file_infos, compression_type, 0, tags);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to get content type tags for `%s`, %d", source_path, err);
+                Longtail_Free(tags);
+                Longtail_Free(file_infos);
+                SAFE_DISPOSE_API(chunker_api);
+                SAFE_DISPOSE_API(store_block_deltastore_api);
+                SAFE_DISPOSE_API(store_block_compressstore_api);
+                SAFE_DISPOSE_API(store_block_fsstore_api);
+                SAFE_DISPOSE_API(storage_api);
+                SAFE_DISPOSE_API(compression_registry);
+                SAFE_DISPOSE_API(hash_registry);
+                SAFE_DISPOSE_API(job_api);
+                Longtail_Free((char*)storage_path);
+                return err;
+            }
+        }
+        else
         {
-            tags[i] = compression_type;
+            for (uint32_t i = 0; i < file_infos->m_Count; ++i)
+            {
+                tags[i] = compression_type;
+            }
         }
 
+        // Reading the next buffer of a file overlaps chunking and hashing of the current one
+        struct Longtail_StorageAPI* read_ahead_storage_api = enable_read_ahead_indexing ? Longtail_CreateReadAheadStorageAPI(storage_api, 1024 * 1024, 3) : 0;
         struct Longtail_ProgressAPI* progress = MakeProgressAPI("Indexing version", 5);
-        if (progress)
+        if (enable_read_ahead_indexing && !read_ahead_storage_api)
+        {
+            err = ENOMEM;
+        }
+        else if (progress)
         {
             err = Longtail_CreateVersionIndex(
-                storage_api,
+                read_ahead_storage_api ? read_ahead_storage_api : storage_api,
                 hash_api,
                 chunker_api,
                 job_api,
@@ -1063,12 +1273,13 @@ int UpSync(
                 target_chunk_size,
                 enable_mmap_indexing,
                 &source_version_index);
-            SAFE_DISPOSE_API(progress);
         }
         else
         {
             err = ENOMEM;
         }
+        SAFE_DISPOSE_API(progress);
+        SAFE_DISPOSE_API(read_ahead_storage_api);
 
         Longtail_Free(tags);
         Longtail_Free(file_infos);
@@ -1076,7 +1287,8 @@ int UpSync(
         {
             LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to create version index for `%s`, %d", source_path, err);
             SAFE_DISPOSE_API(chunker_api);
-            SAFE_DISPOSE_API(store_block_store_api);
+            SAFE_DISPOSE_API(store_block_deltastore_api);
+            SAFE_DISPOSE_API(store_block_compressstore_api);
             SAFE_DISPOSE_API(store_block_fsstore_api);
             SAFE_DISPOSE_API(storage_api);
             SAFE_DISPOSE_API(compression_registry);
@@ -1099,7 +1311,8 @@ int UpSync(
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to create missing store index %d", err);
         Longtail_Free(source_version_index);
         SAFE_DISPOSE_API(chunker_api);
-        SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(store_block_deltastore_api);
+        SAFE_DISPOSE_API(store_block_compressstore_api);
         SAFE_DISPOSE_API(store_block_fsstore_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
@@ -1123,7 +1336,8 @@ int UpSync(
         Longtail_Free(existing_remote_store_index);
         Longtail_Free(source_version_index);
         SAFE_DISPOSE_API(chunker_api);
-        SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(store_block_deltastore_api);
+        SAFE_DISPOSE_API(store_block_compressstore_api);
         SAFE_DISPOSE_API(store_block_fsstore_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
@@ -1164,7 +1378,8 @@ int UpSync(
         Longtail_Free(existing_remote_store_index);
         Longtail_Free(source_version_index);
         SAFE_DISPOSE_API(chunker_api);
-        SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(store_block_deltastore_api);
+        SAFE_DISPOSE_API(store_block_compressstore_api);
         SAFE_DISPOSE_API(store_block_fsstore_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
@@ -1186,7 +1401,8 @@ int UpSync(
         Longtail_Free(existing_remote_store_index);
         Longtail_Free(source_version_index);
         SAFE_DISPOSE_API(chunker_api);
-        SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(store_block_deltastore_api);
+        SAFE_DISPOSE_API(store_block_compressstore_api);
         SAFE_DISPOSE_API(store_block_fsstore_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
@@ -1196,10 +1412,22 @@ int UpSync(
         return err;
     }
 
-    err = Longtail_WriteVersionIndex(
-        storage_api,
-        source_version_index,
-        target_index_path);
+    if (enable_compact_version_index)
+    {
+        err = Longtail_WriteCompactVersionIndex(
+            storage_api,
+            source_version_index,
+            compression_registry,
+            compression_type,
+            target_index_path);
+    }
+    else
+    {
+        err = Longtail_WriteVersionIndex(
+            storage_api,
+            source_version_index,
+            target_index_path);
+    }
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to write version index for `%s` to `%s`, %d", source_path, target_index_path, err);
@@ -1208,7 +1436,8 @@ int UpSync(
         Longtail_Free(existing_remote_store_index);
         Longtail_Free(source_version_index);
         SAFE_DISPOSE_API(chunker_api);
-        SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(store_block_deltastore_api);
+        SAFE_DISPOSE_API(store_block_compressstore_api);
         SAFE_DISPOSE_API(store_block_fsstore_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
@@ -1218,28 +1447,90 @@ int UpSync(
         return err;
     }
 
+    if (optional_version_local_store_index_path)
+    {
+        err = Longtail_WriteStoreIndex(storage_api, version_local_store_index, optional_version_local_store_index_path);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to write version local store index to `%s`, %d", optional_version_local_store_index_path, err);
+        }
+    }
+
+    if (!err && optional_block_ref_count_path)
+    {
+        // Registered last so a failed upsync does not keep blocks alive, `prune` retires the version with the
+        // blocks in its version local store index
+        err = Longtail_UpdateBlockRefCountIndex(
+            storage_api,
+            optional_block_ref_count_path,
+            *version_local_store_index->m_BlockCount,
+            version_local_store_index->m_BlockHashes,
+            0,
+            0);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to register version blocks in `%s`, %d", optional_block_ref_count_path, err);
+        }
+    }
+
     Longtail_Free(version_local_store_index);
     Longtail_Free(remote_missing_store_index);
     Longtail_Free(existing_remote_store_index);
     Longtail_Free(source_version_index);
     SAFE_DISPOSE_API(chunker_api);
-    SAFE_DISPOSE_API(store_block_store_api);
+    SAFE_DISPOSE_API(store_block_deltastore_api);
+    SAFE_DISPOSE_API(store_block_compressstore_api);
     SAFE_DISPOSE_API(store_block_fsstore_api);
     SAFE_DISPOSE_API(storage_api);
     SAFE_DISPOSE_API(compression_registry);
     SAFE_DISPOSE_API(hash_registry);
     SAFE_DISPOSE_API(job_api);
     Longtail_Free((char*)storage_path);
-    return 0;
+    return err;
+}
+
+static void WriteTargetState(
+    struct Longtail_StorageAPI* storage_api,
+    const char* target_path,
+    const struct Longtail_VersionIndex* version_index,
+    const char* target_state_path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(target_path, "%s"),
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(target_state_path, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    // The target state only speeds up the next downsync, failing to write it does not fail the downsync
+    struct Longtail_FolderState* folder_state;
+    int err = Longtail_CreateFolderState(storage_api, target_path, version_index, &folder_state);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to stat files in `%s`, %d", target_path, err);
+        return;
+    }
+    err = Longtail_WriteFolderState(storage_api, version_index, folder_state, target_state_path);
+    Longtail_Free(folder_state);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to write target state to `%s`, %d", target_state_path, err);
+    }
 }
 
 int DownSync(
     const char* storage_uri_raw,
     const char* cache_path,
+    uint32_t cache_compression_type,
     const char* source_path,
     const char* target_path,
     const char* optional_target_index_path,
+    const char* optional_target_state_path,
+    const char* optional_include_paths,
+    const char* optional_exclude_paths,
     int retain_permissions,
+    int use_local_chunks,
+    int enable_delta_blocks,
     int enable_mmap_indexing,
     int enable_mmap_block_store,
     int enable_detailed_progress)
@@ -1247,10 +1538,16 @@ int DownSync(
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(storage_uri_raw, "%s"),
         LONGTAIL_LOGFIELD(cache_path, "%s"),
+        LONGTAIL_LOGFIELD(cache_compression_type, "%u"),
         LONGTAIL_LOGFIELD(source_path, "%s"),
         LONGTAIL_LOGFIELD(target_path, "%s"),
         LONGTAIL_LOGFIELD(optional_target_index_path, "%p"),
+        LONGTAIL_LOGFIELD(optional_target_state_path, "%p"),
+        LONGTAIL_LOGFIELD(optional_include_paths, "%p"),
+        LONGTAIL_LOGFIELD(optional_exclude_paths, "%p"),
         LONGTAIL_LOGFIELD(retain_permissions, "%d"),
+        LONGTAIL_LOGFIELD(use_local_chunks, "%d"),
+        LONGTAIL_LOGFIELD(enable_delta_blocks, "%d"),
         LONGTAIL_LOGFIELD(enable_mmap_indexing, "%d"),
         LONGTAIL_LOGFIELD(enable_mmap_block_store, "%d"),
         LONGTAIL_LOGFIELD(enable_detailed_progress, "%d")
@@ -1261,30 +1558,43 @@ int DownSync(
     struct Longtail_HashRegistryAPI* hash_registry = Longtail_CreateFullHashRegistry();
     struct Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
     struct Longtail_StorageAPI* storage_api = Longtail_CreateFSStorageAPI();
+    struct Longtail_PathFilterAPI* path_filter_api = MakePathFilterAPI(optional_include_paths, optional_exclude_paths);
     struct Longtail_BlockStoreAPI* store_block_remotestore_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, storage_path, 0, enable_mmap_block_store);
     struct Longtail_BlockStoreAPI* store_block_localstore_api = 0;
+    struct Longtail_BlockStoreAPI* store_block_transcodestore_api = 0;
     struct Longtail_BlockStoreAPI* store_block_cachestore_api = 0;
     struct Longtail_BlockStoreAPI* compress_block_store_api = 0;
     if (cache_path)
     {
         store_block_localstore_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, cache_path, 0, enable_mmap_block_store);
-        store_block_cachestore_api = Longtail_CreateCacheBlockStoreAPI(job_api, store_block_localstore_api, store_block_remotestore_api);
+        if (cache_compression_type != 0xffffffff)
+        {
+            // Store cached blocks with a compression that is cheap to decompress
+            store_block_transcodestore_api = Longtail_CreateTranscodeBlockStoreAPI(store_block_localstore_api, compression_registry, job_api, cache_compression_type);
+        }
+        store_block_cachestore_api = Longtail_CreateCacheBlockStoreAPI(job_api, store_block_transcodestore_api ? store_block_transcodestore_api : store_block_localstore_api, store_block_remotestore_api);
         compress_block_store_api = Longtail_CreateCompressBlockStoreAPI(store_block_cachestore_api, compression_registry);
     }
     else
     {
         compress_block_store_api = Longtail_CreateCompressBlockStoreAPI(store_block_remotestore_api, compression_registry);
     }
+    // Delta blocks are resolved on top of the decompressed blocks, reading them needs no sidecar index
+    struct Longtail_BlockStoreAPI* delta_block_store_api = (enable_delta_blocks || StoreHasDeltaBlocks(storage_api, storage_path)) ? Longtail_CreateDeltaBlockStoreAPI(compress_block_store_api, 0, 0) : 0;
+    struct Longtail_BlockStoreAPI* store_block_store_api = delta_block_store_api ? delta_block_store_api : compress_block_store_api;
 
     struct Longtail_VersionIndex* source_version_index = 0;
-    int err = Longtail_ReadVersionIndex(storage_api, source_path, &source_version_index);
+    int err = Longtail_ReadVersionIndex2(storage_api, compression_registry, job_api, source_path, &source_version_index);
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to read version index from `%s`, %d", source_path, err);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
+        SAFE_DISPOSE_API(store_block_transcodestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
         SAFE_DISPOSE_API(store_block_remotestore_api);
+        SAFE_DISPOSE_API(path_filter_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
         SAFE_DISPOSE_API(hash_registry);
@@ -1293,16 +1603,45 @@ int DownSync(
         return err;
     }
 
+    if (path_filter_api)
+    {
+        // Only the filtered assets are diffed, so only blocks for them are fetched and nothing outside the filter is touched
+        struct Longtail_VersionIndex* filtered_source_version_index = 0;
+        err = Longtail_FilterVersionIndex(source_version_index, path_filter_api, target_path, &filtered_source_version_index);
+        Longtail_Free(source_version_index);
+        source_version_index = filtered_source_version_index;
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to filter version index from `%s`, %d", source_path, err);
+            SAFE_DISPOSE_API(delta_block_store_api);
+            SAFE_DISPOSE_API(compress_block_store_api);
+            SAFE_DISPOSE_API(store_block_cachestore_api);
+            SAFE_DISPOSE_API(store_block_transcodestore_api);
+            SAFE_DISPOSE_API(store_block_localstore_api);
+            SAFE_DISPOSE_API(store_block_remotestore_api);
+            SAFE_DISPOSE_API(path_filter_api);
+            SAFE_DISPOSE_API(storage_api);
+            SAFE_DISPOSE_API(compression_registry);
+            SAFE_DISPOSE_API(hash_registry);
+            SAFE_DISPOSE_API(job_api);
+            Longtail_Free((void*)storage_path);
+            return err;
+        }
+    }
+
     uint32_t hashing_type = *source_version_index->m_HashIdentifier;
     struct Longtail_HashAPI* hash_api;
     err = hash_registry->GetHashAPI(hash_registry, hashing_type, &hash_api);
     if (err)
     {
         Longtail_Free(source_version_index);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
+        SAFE_DISPOSE_API(store_block_transcodestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
         SAFE_DISPOSE_API(store_block_remotestore_api);
+        SAFE_DISPOSE_API(path_filter_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
         SAFE_DISPOSE_API(hash_registry);
@@ -1315,10 +1654,13 @@ int DownSync(
     if (!chunker_api)
     {
         Longtail_Free(source_version_index);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
+        SAFE_DISPOSE_API(store_block_transcodestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
         SAFE_DISPOSE_API(store_block_remotestore_api);
+        SAFE_DISPOSE_API(path_filter_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
         SAFE_DISPOSE_API(hash_registry);
@@ -1330,22 +1672,46 @@ int DownSync(
     struct Longtail_VersionIndex* target_version_index = 0;
     if (optional_target_index_path)
     {
-        err = Longtail_ReadVersionIndex(storage_api, optional_target_index_path, &target_version_index);
+        err = Longtail_ReadVersionIndex2(storage_api, compression_registry, job_api, optional_target_index_path, &target_version_index);
         if (err)
         {
             LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to read version index from `%s`, %d", optional_target_index_path, err);
         }
+        else if (path_filter_api)
+        {
+            struct Longtail_VersionIndex* filtered_target_version_index = 0;
+            err = Longtail_FilterVersionIndex(target_version_index, path_filter_api, target_path, &filtered_target_version_index);
+            Longtail_Free(target_version_index);
+            target_version_index = filtered_target_version_index;
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to filter version index from `%s`, %d", optional_target_index_path, err);
+            }
+        }
     }
 
     uint32_t target_chunk_size = *source_version_index->m_TargetChunkSize;
 
+    struct Longtail_VersionIndex* state_version_index = 0;
+    struct Longtail_FolderState* folder_state = 0;
+    if (target_version_index == 0 && optional_target_state_path)
+    {
+        err = Longtail_ReadFolderState(storage_api, optional_target_state_path, &state_version_index, &folder_state);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to read target state from `%s`, %d", optional_target_state_path, err);
+            state_version_index = 0;
+            folder_state = 0;
+        }
+    }
+
     if (target_version_index == 0)
     {
         struct Longtail_FileInfos* file_infos;
         err = Longtail_GetFilesRecursively2(
             storage_api,
             job_api,
-            0,
+            path_filter_api,
             0,
             0,
             target_path,
@@ -1353,12 +1719,17 @@ int DownSync(
         if (err)
         {
             LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to scan version store from `%s`, %d", target_path, err);
+            Longtail_Free(folder_state);
+            Longtail_Free(state_version_index);
             Longtail_Free(source_version_index);
             SAFE_DISPOSE_API(chunker_api);
+            SAFE_DISPOSE_API(delta_block_store_api);
             SAFE_DISPOSE_API(compress_block_store_api);
             SAFE_DISPOSE_API(store_block_cachestore_api);
+            SAFE_DISPOSE_API(store_block_transcodestore_api);
             SAFE_DISPOSE_API(store_block_localstore_api);
             SAFE_DISPOSE_API(store_block_remotestore_api);
+            SAFE_DISPOSE_API(path_filter_api);
             SAFE_DISPOSE_API(storage_api);
             SAFE_DISPOSE_API(compression_registry);
             SAFE_DISPOSE_API(hash_registry);
@@ -1373,7 +1744,28 @@ int DownSync(
         }
 
         struct Longtail_ProgressAPI* progress = MakeProgressAPI("Indexing version", 5);
-        if (progress)
+        if (progress && state_version_index)
+        {
+            // Files that are unchanged since the last downsync wrote them are not read again
+            err = Longtail_CreateVersionIndexFromFolderState(
+                storage_api,
+                hash_api,
+                chunker_api,
+                job_api,
+                progress,
+                0,
+                0,
+                target_path,
+                file_infos,
+                tags,
+                target_chunk_size,
+                enable_mmap_indexing,
+                state_version_index,
+                folder_state,
+                &target_version_index);
+            SAFE_DISPOSE_API(progress);
+        }
+        else if (progress)
         {
             err = Longtail_CreateVersionIndex(
                 storage_api,
@@ -1396,6 +1788,8 @@ int DownSync(
             err = ENOMEM;
         }
 
+        Longtail_Free(folder_state);
+        Longtail_Free(state_version_index);
         Longtail_Free(tags);
         Longtail_Free(file_infos);
         if (err)
@@ -1403,10 +1797,13 @@ int DownSync(
             LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to create version index for `%s`, %d", target_path, err);
             Longtail_Free(source_version_index);
             SAFE_DISPOSE_API(chunker_api);
+            SAFE_DISPOSE_API(delta_block_store_api);
             SAFE_DISPOSE_API(compress_block_store_api);
             SAFE_DISPOSE_API(store_block_cachestore_api);
+            SAFE_DISPOSE_API(store_block_transcodestore_api);
             SAFE_DISPOSE_API(store_block_localstore_api);
             SAFE_DISPOSE_API(store_block_remotestore_api);
+            SAFE_DISPOSE_API(path_filter_api);
             SAFE_DISPOSE_API(storage_api);
             SAFE_DISPOSE_API(compression_registry);
             SAFE_DISPOSE_API(hash_registry);
@@ -1417,10 +1814,11 @@ int DownSync(
     }
 
     struct Longtail_VersionDiff* version_diff;
-    err = Longtail_CreateVersionDiff(
+    err = Longtail_CreateVersionDiff2(
         hash_api,
         target_version_index,
         source_version_index,
+        1,
         &version_diff);
     if (err)
     {
@@ -1428,10 +1826,13 @@ int DownSync(
         Longtail_Free(target_version_index);
         Longtail_Free(source_version_index);
         SAFE_DISPOSE_API(chunker_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
+        SAFE_DISPOSE_API(store_block_transcodestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
         SAFE_DISPOSE_API(store_block_remotestore_api);
+        SAFE_DISPOSE_API(path_filter_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
         SAFE_DISPOSE_API(hash_registry);
@@ -1443,16 +1844,24 @@ int DownSync(
     if ((*version_diff->m_SourceRemovedCount == 0) &&
         (*version_diff->m_ModifiedContentCount == 0) &&
         (*version_diff->m_TargetAddedCount == 0) &&
+        (*version_diff->m_MovedCount == 0) &&
         (*version_diff->m_ModifiedPermissionsCount == 0 || !retain_permissions) )
     {
+        if (optional_target_state_path)
+        {
+            WriteTargetState(storage_api, target_path, source_version_index, optional_target_state_path);
+        }
         Longtail_Free(version_diff);
         Longtail_Free(target_version_index);
         Longtail_Free(source_version_index);
         SAFE_DISPOSE_API(chunker_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
+        SAFE_DISPOSE_API(store_block_transcodestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
         SAFE_DISPOSE_API(store_block_remotestore_api);
+        SAFE_DISPOSE_API(path_filter_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
         SAFE_DISPOSE_API(hash_registry);
@@ -1476,10 +1885,13 @@ int DownSync(
         Longtail_Free(target_version_index);
         Longtail_Free(source_version_index);
         SAFE_DISPOSE_API(chunker_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
+        SAFE_DISPOSE_API(store_block_transcodestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
         SAFE_DISPOSE_API(store_block_remotestore_api);
+        SAFE_DISPOSE_API(path_filter_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
         SAFE_DISPOSE_API(hash_registry);
@@ -1490,7 +1902,7 @@ int DownSync(
 
     struct Longtail_StoreIndex* required_version_store_index;
     err = SyncGetExistingContent(
-        compress_block_store_api,
+        store_block_store_api,
         required_chunk_count,
         required_chunk_hashes,
         0,
@@ -1503,10 +1915,13 @@ int DownSync(
         Longtail_Free(target_version_index);
         Longtail_Free(source_version_index);
         SAFE_DISPOSE_API(chunker_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
+        SAFE_DISPOSE_API(store_block_transcodestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
         SAFE_DISPOSE_API(store_block_remotestore_api);
+        SAFE_DISPOSE_API(path_filter_api);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
         SAFE_DISPOSE_API(hash_registry);
@@ -1529,8 +1944,8 @@ int DownSync(
         struct Longtail_ConcurrentChunkWriteAPI* concurrent_chunk_write = Longtail_CreateConcurrentChunkWriteAPI(storage_api, source_version_index, version_diff, target_path);
         if (concurrent_chunk_write)
         {
-            err = Longtail_ChangeVersion2(
-                compress_block_store_api,
+            err = Longtail_ChangeVersion3(
+                store_block_store_api,
                 storage_api,
                 concurrent_chunk_write,
                 hash_api,
@@ -1543,7 +1958,8 @@ int DownSync(
                 source_version_index,
                 version_diff,
                 target_path,
-                retain_permissions ? 1 : 0);
+                retain_permissions ? 1 : 0,
+                use_local_chunks);
             SAFE_DISPOSE_API(concurrent_chunk_write);
         }
         else
@@ -1561,16 +1977,23 @@ int DownSync(
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to update version `%s` from `%s` using `%s`, %d", target_path, source_path, storage_uri_raw, err);
     }
+    else if (optional_target_state_path)
+    {
+        WriteTargetState(storage_api, target_path, source_version_index, optional_target_state_path);
+    }
 
     Longtail_Free(required_version_store_index);
     Longtail_Free(version_diff);
     Longtail_Free(target_version_index);
     Longtail_Free(source_version_index);
     SAFE_DISPOSE_API(chunker_api);
+    SAFE_DISPOSE_API(delta_block_store_api);
     SAFE_DISPOSE_API(compress_block_store_api);
     SAFE_DISPOSE_API(store_block_cachestore_api);
+    SAFE_DISPOSE_API(store_block_transcodestore_api);
     SAFE_DISPOSE_API(store_block_localstore_api);
     SAFE_DISPOSE_API(store_block_remotestore_api);
+    SAFE_DISPOSE_API(path_filter_api);
     SAFE_DISPOSE_API(storage_api);
     SAFE_DISPOSE_API(compression_registry);
     SAFE_DISPOSE_API(hash_registry);
@@ -1604,16 +2027,18 @@ int ValidateVersionIndex(
     const char* storage_path = NormalizePath(storage_uri_raw);
     struct Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(Longtail_GetCPUCount(), 0);
     struct Longtail_HashRegistryAPI* hash_registry = Longtail_CreateFullHashRegistry();
+    struct Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
     struct Longtail_StorageAPI* storage_api = Longtail_CreateFSStorageAPI();
     struct Longtail_BlockStoreAPI* store_block_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, storage_path, 0, enable_mmap_block_store);
     
     struct Longtail_VersionIndex* version_index = 0;
-    int err = Longtail_ReadVersionIndex(storage_api, version_index_path, &version_index);
+    int err = Longtail_ReadVersionIndex2(storage_api, compression_registry, job_api, version_index_path, &version_index);
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to read version index from `%s`, %d", version_index_path, err);
         SAFE_DISPOSE_API(store_block_api);
         SAFE_DISPOSE_API(storage_api);
+        SAFE_DISPOSE_API(compression_registry);
         SAFE_DISPOSE_API(hash_registry);
         SAFE_DISPOSE_API(job_api);
         Longtail_Free((void*)storage_path);
@@ -1628,6 +2053,7 @@ int ValidateVersionIndex(
         Longtail_Free(version_index);
         SAFE_DISPOSE_API(store_block_api);
         SAFE_DISPOSE_API(storage_api);
+        SAFE_DISPOSE_API(compression_registry);
         SAFE_DISPOSE_API(hash_registry);
         SAFE_DISPOSE_API(job_api);
         Longtail_Free((void*)storage_path);
@@ -1647,6 +2073,7 @@ int ValidateVersionIndex(
         Longtail_Free(version_index);
         SAFE_DISPOSE_API(store_block_api);
         SAFE_DISPOSE_API(storage_api);
+        SAFE_DISPOSE_API(compression_registry);
         SAFE_DISPOSE_API(hash_registry);
         SAFE_DISPOSE_API(job_api);
         Longtail_Free((void*)storage_path);
@@ -1661,6 +2088,7 @@ int ValidateVersionIndex(
         Longtail_Free(block_store_store_index);
         SAFE_DISPOSE_API(store_block_api);
         SAFE_DISPOSE_API(storage_api);
+        SAFE_DISPOSE_API(compression_registry);
         SAFE_DISPOSE_API(hash_registry);
         SAFE_DISPOSE_API(job_api);
         Longtail_Free((void*)storage_path);
@@ -1670,6 +2098,7 @@ int ValidateVersionIndex(
     Longtail_Free(block_store_store_index);
     SAFE_DISPOSE_API(store_block_api);
     SAFE_DISPOSE_API(storage_api);
+    SAFE_DISPOSE_API(compression_registry);
     SAFE_DISPOSE_API(hash_registry);
     SAFE_DISPOSE_API(job_api);
     Longtail_Free((void*)storage_path);
@@ -1678,8 +2107,7 @@ int ValidateVersionIndex(
 
 int VersionIndex_ls(
     const char* version_index_path,
-    const char* ls_dir,
-    int enable_mmap_block_store)
+    const char* ls_dir)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(version_index_path, "%s"),
@@ -1687,122 +2115,115 @@ int VersionIndex_ls(
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
     struct Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(Longtail_GetCPUCount(), 0);
-    struct Longtail_HashRegistryAPI* hash_registry = Longtail_CreateFullHashRegistry();
     struct Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
     struct Longtail_StorageAPI* storage_api = Longtail_CreateFSStorageAPI();
-    struct Longtail_StorageAPI* fake_block_store_fs = Longtail_CreateInMemStorageAPI();
-    struct Longtail_BlockStoreAPI* fake_block_store = Longtail_CreateFSBlockStoreAPI(
-        job_api,
-        fake_block_store_fs,
-        "store",
-        0,
-        enable_mmap_block_store);
-
 
+    // Listing only needs the asset sections, the chunk tables of a compact version index are never read
     struct Longtail_VersionIndex* version_index = 0;
-    int err = Longtail_ReadVersionIndex(storage_api, version_index_path, &version_index);
+    uint32_t* path_directory = 0;
+    int err = Longtail_ReadVersionIndexSections(
+        storage_api,
+        compression_registry,
+        job_api,
+        version_index_path,
+        Longtail_VersionIndex_AssetSections,
+        &version_index,
+        &path_directory);
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to read version index from `%s`, %d", version_index_path, err);
-        SAFE_DISPOSE_API(fake_block_store);
-        SAFE_DISPOSE_API(fake_block_store_fs);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
-        SAFE_DISPOSE_API(hash_registry);
         SAFE_DISPOSE_API(job_api);
         return err;
     }
 
-    struct Longtail_HashAPI* hash_api;
-    err = hash_registry->GetHashAPI(hash_registry, *version_index->m_HashIdentifier, &hash_api);
-    if (err)
+    const char* dir = ls_dir[0] == '.' ? &ls_dir[1] : ls_dir;
+    while (dir[0] == '/')
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Can not create hashing API for version index `%s`, failed with %d", version_index_path, err);
-        SAFE_DISPOSE_API(fake_block_store);
-        SAFE_DISPOSE_API(fake_block_store_fs);
-        SAFE_DISPOSE_API(storage_api);
-        SAFE_DISPOSE_API(compression_registry);
-        SAFE_DISPOSE_API(hash_registry);
-        SAFE_DISPOSE_API(job_api);
-        return err;
+        ++dir;
     }
+    size_t dir_length = strlen(dir);
+    size_t prefix_length = (dir_length == 0 || dir[dir_length - 1] == '/') ? dir_length : dir_length + 1;
 
-
-    struct Longtail_StoreIndex* store_index;
-    err = Longtail_CreateStoreIndex(
-        hash_api,
-        *version_index->m_ChunkCount,
-        version_index->m_ChunkHashes,
-        version_index->m_ChunkSizes,
-        version_index->m_ChunkTags,
-        1024*1024*1024,
-        1024,
-        &store_index);
-
-    struct Longtail_StorageAPI* block_store_fs = Longtail_CreateBlockStoreStorageAPI(
-        hash_api,
-        job_api,
-        fake_block_store,
-        store_index,
-        version_index);
+    uint32_t first = 0;
+    uint32_t count = 0;
+    err = Longtail_FindVersionIndexPaths(version_index, path_directory, dir, &first, &count);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to create file system for version index `%s`, failed with %d", version_index_path, err);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to find `%s` in version index `%s`, failed with %d", dir, version_index_path, err);
+        Longtail_Free(path_directory);
+        Longtail_Free(version_index);
         SAFE_DISPOSE_API(storage_api);
-        SAFE_DISPOSE_API(fake_block_store);
-        SAFE_DISPOSE_API(fake_block_store_fs);
         SAFE_DISPOSE_API(compression_registry);
-        SAFE_DISPOSE_API(hash_registry);
         SAFE_DISPOSE_API(job_api);
         return err;
     }
-
-    Longtail_StorageAPI_HIterator fs_iterator;
-    err = block_store_fs->StartFind(block_store_fs, ls_dir[0] == '.' ? &ls_dir[1] : ls_dir, &fs_iterator);
-    if (err)
+    if (count == 0)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to create file iteration for version index `%s`, failed with %d", version_index_path, err);
-        SAFE_DISPOSE_API(block_store_fs);
-        Longtail_Free(store_index);
-        SAFE_DISPOSE_API(fake_block_store);
-        SAFE_DISPOSE_API(fake_block_store_fs);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Path `%s` does not exist in version index `%s`, failed with %d", dir, version_index_path, ENOENT);
+        Longtail_Free(path_directory);
+        Longtail_Free(version_index);
         SAFE_DISPOSE_API(storage_api);
         SAFE_DISPOSE_API(compression_registry);
-        SAFE_DISPOSE_API(hash_registry);
         SAFE_DISPOSE_API(job_api);
-        return err;
+        return ENOENT;
     }
-    do
+
+    for (uint32_t i = first; i < first + count; ++i)
     {
-        struct Longtail_StorageAPI_EntryProperties properties;
-        err = block_store_fs->GetEntryProperties(block_store_fs, fs_iterator, &properties);
-        if (!err)
+        uint32_t asset_index = path_directory[i];
+        const char* asset_path = &version_index->m_NameData[version_index->m_NameOffsets[asset_index]];
+        size_t asset_path_length = strlen(asset_path);
+        int is_dir = asset_path_length > 0 && asset_path[asset_path_length - 1] == '/';
+        const char* name = asset_path;
+        size_t name_length = asset_path_length;
+        if (count > 1 || is_dir)
+        {
+            // Only list the direct children of the folder
+            if (asset_path_length <= prefix_length)
+            {
+                continue;
+            }
+            name = &asset_path[prefix_length];
+            name_length = asset_path_length - prefix_length;
+            const char* separator = strchr(name, '/');
+            if (separator && separator != &name[name_length - 1])
+            {
+                continue;
+            }
+        }
+        else
         {
-            char permission_string[11];
-            permission_string[0] = properties.m_IsDir ? 'd' : '-';
-            permission_string[1] = ((properties.m_Permissions & 0400) != 0) ? 'r' : '-';
-            permission_string[2] = ((properties.m_Permissions & 0200) != 0) ? 'w' : '-';
-            permission_string[3] = ((properties.m_Permissions & 0100) != 0) ? 'x' : '-';
-            permission_string[4] = ((properties.m_Permissions & 0040) != 0) ? 'r' : '-';
-            permission_string[5] = ((properties.m_Permissions & 0020) != 0) ? 'w' : '-';
-            permission_string[6] = ((properties.m_Permissions & 0010) != 0) ? 'x' : '-';
-            permission_string[7] = ((properties.m_Permissions & 0004) != 0) ? 'r' : '-';
-            permission_string[8] = ((properties.m_Permissions & 0002) != 0) ? 'w' : '-';
-            permission_string[9] = ((properties.m_Permissions & 0001) != 0) ? 'x' : '-';
-            permission_string[10] = 0;
-            printf("%s %12" PRIu64 " %s\n", permission_string, properties.m_Size, properties.m_Name);
+            const char* separator = strrchr(asset_path, '/');
+            name = separator ? &separator[1] : asset_path;
+            name_length = strlen(name);
+        }
+        if (is_dir)
+        {
+            --name_length;
         }
-    } while (block_store_fs->FindNext(block_store_fs, fs_iterator) == 0);
 
-    block_store_fs->CloseFind(block_store_fs, fs_iterator);
-    
-    SAFE_DISPOSE_API(block_store_fs);
-    Longtail_Free(store_index);
-    SAFE_DISPOSE_API(fake_block_store);
-    SAFE_DISPOSE_API(fake_block_store_fs);
+        uint16_t permissions = version_index->m_Permissions[asset_index];
+        char permission_string[11];
+        permission_string[0] = is_dir ? 'd' : '-';
+        permission_string[1] = ((permissions & 0400) != 0) ? 'r' : '-';
+        permission_string[2] = ((permissions & 0200) != 0) ? 'w' : '-';
+        permission_string[3] = ((permissions & 0100) != 0) ? 'x' : '-';
+        permission_string[4] = ((permissions & 0040) != 0) ? 'r' : '-';
+        permission_string[5] = ((permissions & 0020) != 0) ? 'w' : '-';
+        permission_string[6] = ((permissions & 0010) != 0) ? 'x' : '-';
+        permission_string[7] = ((permissions & 0004) != 0) ? 'r' : '-';
+        permission_string[8] = ((permissions & 0002) != 0) ? 'w' : '-';
+        permission_string[9] = ((permissions & 0001) != 0) ? 'x' : '-';
+        permission_string[10] = 0;
+        printf("%s %12" PRIu64 " %.*s\n", permission_string, is_dir ? 0 : version_index->m_AssetSizes[asset_index], (int)name_length, name);
+    }
+
+    Longtail_Free(path_directory);
+    Longtail_Free(version_index);
     SAFE_DISPOSE_API(storage_api);
     SAFE_DISPOSE_API(compression_registry);
-    SAFE_DISPOSE_API(hash_registry);
     SAFE_DISPOSE_API(job_api);
     return 0;
 }
@@ -1844,15 +2265,17 @@ int VersionIndex_cp(
     {
         compress_block_store_api = Longtail_CreateCompressBlockStoreAPI(store_block_remotestore_api, compression_registry);
     }
+    struct Longtail_BlockStoreAPI* delta_block_store_api = StoreHasDeltaBlocks(storage_api, storage_path) ? Longtail_CreateDeltaBlockStoreAPI(compress_block_store_api, 0, 0) : 0;
 
-    struct Longtail_BlockStoreAPI* store_block_store_api = Longtail_CreateShareBlockStoreAPI(compress_block_store_api);
+    struct Longtail_BlockStoreAPI* store_block_store_api = Longtail_CreateShareBlockStoreAPI(delta_block_store_api ? delta_block_store_api : compress_block_store_api);
 
     struct Longtail_VersionIndex* version_index = 0;
-    int err = Longtail_ReadVersionIndex(storage_api, version_index_path, &version_index);
+    int err = Longtail_ReadVersionIndex2(storage_api, compression_registry, job_api, version_index_path, &version_index);
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to read version index from `%s`, %d", version_index_path, err);
         SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
@@ -1871,6 +2294,7 @@ int VersionIndex_cp(
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Can not create hashing API for version index `%s`, failed with %d", version_index_path, err);
         SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
@@ -1894,6 +2318,7 @@ int VersionIndex_cp(
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to create retarget store index for version index `%s` to `%s`, failed with %d", storage_uri_raw, version_index_path, err);
         SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
@@ -1912,6 +2337,7 @@ int VersionIndex_cp(
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Store `%s` does not contain all the chunks needed for this version `%s`, Longtail_ValidateStore failed with %d", storage_uri_raw, source_path, err);
         Longtail_Free(block_store_store_index);
         SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
@@ -1935,6 +2361,7 @@ int VersionIndex_cp(
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to create file system for version index `%s`, failed with %d", version_index_path, err);
         Longtail_Free(block_store_store_index);
         SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
@@ -1955,6 +2382,7 @@ int VersionIndex_cp(
         SAFE_DISPOSE_API(block_store_fs);
         Longtail_Free(block_store_store_index);
         SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
@@ -1975,6 +2403,7 @@ int VersionIndex_cp(
         SAFE_DISPOSE_API(block_store_fs);
         Longtail_Free(block_store_store_index);
         SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
@@ -1995,6 +2424,7 @@ int VersionIndex_cp(
         SAFE_DISPOSE_API(block_store_fs);
         Longtail_Free(block_store_store_index);
         SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
@@ -2030,6 +2460,7 @@ int VersionIndex_cp(
         SAFE_DISPOSE_API(block_store_fs);
         Longtail_Free(block_store_store_index);
         SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
@@ -2049,6 +2480,7 @@ int VersionIndex_cp(
         SAFE_DISPOSE_API(block_store_fs);
         Longtail_Free(block_store_store_index);
         SAFE_DISPOSE_API(store_block_store_api);
+        SAFE_DISPOSE_API(delta_block_store_api);
         SAFE_DISPOSE_API(compress_block_store_api);
         SAFE_DISPOSE_API(store_block_cachestore_api);
         SAFE_DISPOSE_API(store_block_localstore_api);
@@ -2064,6 +2496,7 @@ int VersionIndex_cp(
     SAFE_DISPOSE_API(block_store_fs);
     Longtail_Free(block_store_store_index);
     SAFE_DISPOSE_API(store_block_store_api);
+    SAFE_DISPOSE_API(delta_block_store_api);
     SAFE_DISPOSE_API(compress_block_store_api);
     SAFE_DISPOSE_API(store_block_cachestore_api);
     SAFE_DISPOSE_API(store_block_localstore_api);
@@ -2076,6 +2509,380 @@ int VersionIndex_cp(
     return 0;
 }
 
+#if defined(LONGTAIL_ENABLE_FUSE)
+
+struct MountFS_Asset
+{
+    const char* m_Path;
+    uint32_t m_AssetIndex;
+};
+
+struct MountFS
+{
+    struct Longtail_StorageAPI* m_BlockStoreFS;
+    const struct Longtail_VersionIndex* m_VersionIndex;
+    struct MountFS_Asset* m_Assets;
+    uint32_t m_AssetCount;
+};
+
+struct MountFS_OpenFile
+{
+    Longtail_StorageAPI_HOpenFile m_File;
+    // Reads from the same open file are serialized, the block store storage keeps per file read state
+    HLongtail_Sema m_ReadLock;
+    uint64_t m_Size;
+};
+
+static int MountFS_AssetCompare(const void* a, const void* b)
+{
+    const struct MountFS_Asset* asset_a = (const struct MountFS_Asset*)a;
+    const struct MountFS_Asset* asset_b = (const struct MountFS_Asset*)b;
+    return strcmp(asset_a->m_Path, asset_b->m_Path);
+}
+
+static struct MountFS* MountFS_Get()
+{
+    return (struct MountFS*)fuse_get_context()->private_data;
+}
+
+static const struct MountFS_Asset* MountFS_FindAsset(struct MountFS* mount_fs, const char* path)
+{
+    struct MountFS_Asset key = {path, 0};
+    return (const struct MountFS_Asset*)bsearch(&key, mount_fs->m_Assets, mount_fs->m_AssetCount, sizeof(struct MountFS_Asset), MountFS_AssetCompare);
+}
+
+static void* MountFS_Init(struct fuse_conn_info* conn, struct fuse_config* cfg)
+{
+    // The content of a version never changes so the kernel is free to keep pages around
+    cfg->kernel_cache = 1;
+    return fuse_get_context()->private_data;
+}
+
+static int MountFS_GetAttr(const char* path, struct stat* stbuf, struct fuse_file_info* fi)
+{
+    struct MountFS* mount_fs = MountFS_Get();
+    memset(stbuf, 0, sizeof(struct stat));
+
+    // FUSE paths start with a slash, version index paths are relative to the version root
+    const char* version_path = &path[1];
+    if (version_path[0] == '\0')
+    {
+        stbuf->st_mode = S_IFDIR | 0555;
+        stbuf->st_nlink = 2;
+        return 0;
+    }
+
+    const struct MountFS_Asset* asset = MountFS_FindAsset(mount_fs, version_path);
+    if (asset)
+    {
+        stbuf->st_mode = S_IFREG | (mount_fs->m_VersionIndex->m_Permissions[asset->m_AssetIndex] & 0555);
+        stbuf->st_nlink = 1;
+        stbuf->st_size = (off_t)mount_fs->m_VersionIndex->m_AssetSizes[asset->m_AssetIndex];
+        return 0;
+    }
+
+    // Directories are stored with a trailing forward slash in the version index
+    size_t path_length = strlen(version_path);
+    char* dir_path = (char*)alloca(path_length + 2);
+    memcpy(dir_path, version_path, path_length);
+    dir_path[path_length] = '/';
+    dir_path[path_length + 1] = '\0';
+    asset = MountFS_FindAsset(mount_fs, dir_path);
+    if (asset)
+    {
+        stbuf->st_mode = S_IFDIR | (mount_fs->m_VersionIndex->m_Permissions[asset->m_AssetIndex] & 0555);
+        stbuf->st_nlink = 2;
+        return 0;
+    }
+    return -ENOENT;
+}
+
+static int MountFS_ReadDir(const char* path, void* buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info* fi, enum fuse_readdir_flags flags)
+{
+    struct Longtail_StorageAPI* block_store_fs = MountFS_Get()->m_BlockStoreFS;
+    const char* version_path = &path[1];
+
+    filler(buf, ".", 0, 0, (enum fuse_fill_dir_flags)0);
+    filler(buf, "..", 0, 0, (enum fuse_fill_dir_flags)0);
+
+    Longtail_StorageAPI_HIterator fs_iterator;
+    int err = block_store_fs->StartFind(block_store_fs, version_path, &fs_iterator);
+    if (err == ENOENT)
+    {
+        // Empty directory
+        return 0;
+    }
+    if (err)
+    {
+        return -err;
+    }
+    do
+    {
+        struct Longtail_StorageAPI_EntryProperties properties;
+        err = block_store_fs->GetEntryProperties(block_store_fs, fs_iterator, &properties);
+        if (err)
+        {
+            break;
+        }
+        if (filler(buf, properties.m_Name, 0, 0, (enum fuse_fill_dir_flags)0))
+        {
+            break;
+        }
+    } while (block_store_fs->FindNext(block_store_fs, fs_iterator) == 0);
+    block_store_fs->CloseFind(block_store_fs, fs_iterator);
+    return err ? -err : 0;
+}
+
+static int MountFS_Open(const char* path, struct fuse_file_info* fi)
+{
+    if ((fi->flags & O_ACCMODE) != O_RDONLY)
+    {
+        return -EROFS;
+    }
+    struct Longtail_StorageAPI* block_store_fs = MountFS_Get()->m_BlockStoreFS;
+
+    size_t open_file_size = sizeof(struct MountFS_OpenFile) + Longtail_GetSemaSize();
+    struct MountFS_OpenFile* open_file = (struct MountFS_OpenFile*)Longtail_Alloc("MountFS", open_file_size);
+    if (!open_file)
+    {
+        return -ENOMEM;
+    }
+    int err = Longtail_CreateSema(&open_file[1], 1, &open_file->m_ReadLock);
+    if (err)
+    {
+        Longtail_Free(open_file);
+        return -err;
+    }
+    err = block_store_fs->OpenReadFile(block_store_fs, &path[1], &open_file->m_File);
+    if (err)
+    {
+        Longtail_DeleteSema(open_file->m_ReadLock);
+        Longtail_Free(open_file);
+        return -err;
+    }
+    err = block_store_fs->GetSize(block_store_fs, open_file->m_File, &open_file->m_Size);
+    if (err)
+    {
+        block_store_fs->CloseFile(block_store_fs, open_file->m_File);
+        Longtail_DeleteSema(open_file->m_ReadLock);
+        Longtail_Free(open_file);
+        return -err;
+    }
+    fi->fh = (uint64_t)(uintptr_t)open_file;
+    fi->keep_cache = 1;
+    return 0;
+}
+
+static int MountFS_Read(const char* path, char* buf, size_t size, off_t offset, struct fuse_file_info* fi)
+{
+    struct Longtail_StorageAPI* block_store_fs = MountFS_Get()->m_BlockStoreFS;
+    struct MountFS_OpenFile* open_file = (struct MountFS_OpenFile*)(uintptr_t)fi->fh;
+    if (offset < 0 || (uint64_t)offset >= open_file->m_Size)
+    {
+        return 0;
+    }
+    uint64_t size_left = open_file->m_Size - (uint64_t)offset;
+    uint64_t read_size = size_left < size ? size_left : size;
+
+    Longtail_WaitSema(open_file->m_ReadLock, LONGTAIL_TIMEOUT_INFINITE);
+    int err = block_store_fs->Read(block_store_fs, open_file->m_File, (uint64_t)offset, read_size, buf);
+    Longtail_PostSema(open_file->m_ReadLock, 1);
+    if (err)
+    {
+        return -err;
+    }
+    return (int)read_size;
+}
+
+static int MountFS_Release(const char* path, struct fuse_file_info* fi)
+{
+    struct Longtail_StorageAPI* block_store_fs = MountFS_Get()->m_BlockStoreFS;
+    struct MountFS_OpenFile* open_file = (struct MountFS_OpenFile*)(uintptr_t)fi->fh;
+    block_store_fs->CloseFile(block_store_fs, open_file->m_File);
+    Longtail_DeleteSema(open_file->m_ReadLock);
+    Longtail_Free(open_file);
+    return 0;
+}
+
+static int MountFS_Run(
+    struct Longtail_StorageAPI* block_store_fs,
+    const struct Longtail_VersionIndex* version_index,
+    const char* mount_path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_fs, "%p"),
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(mount_path, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    uint32_t asset_count = *version_index->m_AssetCount;
+    struct MountFS mount_fs;
+    mount_fs.m_BlockStoreFS = block_store_fs;
+    mount_fs.m_VersionIndex = version_index;
+    mount_fs.m_AssetCount = asset_count;
+    mount_fs.m_Assets = (struct MountFS_Asset*)Longtail_Alloc("MountFS", sizeof(struct MountFS_Asset) * (asset_count == 0 ? 1 : asset_count));
+    if (!mount_fs.m_Assets)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM);
+        return ENOMEM;
+    }
+    for (uint32_t a = 0; a < asset_count; ++a)
+    {
+        mount_fs.m_Assets[a].m_Path = &version_index->m_NameData[version_index->m_NameOffsets[a]];
+        mount_fs.m_Assets[a].m_AssetIndex = a;
+    }
+    qsort(mount_fs.m_Assets, asset_count, sizeof(struct MountFS_Asset), MountFS_AssetCompare);
+
+    struct fuse_operations operations;
+    memset(&operations, 0, sizeof(operations));
+    operations.init = MountFS_Init;
+    operations.getattr = MountFS_GetAttr;
+    operations.readdir = MountFS_ReadDir;
+    operations.open = MountFS_Open;
+    operations.read = MountFS_Read;
+    operations.release = MountFS_Release;
+
+    // Run in the foreground so we get to clean up once the file system is unmounted
+    char* fuse_argv[] = {(char*)"longtail", (char*)"-f", (char*)"-o", (char*)"ro,default_permissions", (char*)mount_path, 0};
+    int fuse_argc = (int)(sizeof(fuse_argv) / sizeof(fuse_argv[0])) - 1;
+    int fuse_result = fuse_main(fuse_argc, fuse_argv, &operations, &mount_fs);
+    Longtail_Free(mount_fs.m_Assets);
+    if (fuse_result != 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "fuse_main() failed with %d", fuse_result);
+        return EIO;
+    }
+    return 0;
+}
+
+#endif // defined(LONGTAIL_ENABLE_FUSE)
+
+int VersionIndex_mount(
+    const char* storage_uri_raw,
+    const char* version_index_path,
+    const char* cache_path,
+    const char* mount_path,
+    uint32_t block_cache_count,
+    int enable_mmap_block_store)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_uri_raw, "%s"),
+        LONGTAIL_LOGFIELD(version_index_path, "%s"),
+        LONGTAIL_LOGFIELD(cache_path, "%s"),
+        LONGTAIL_LOGFIELD(mount_path, "%s"),
+        LONGTAIL_LOGFIELD(block_cache_count, "%u"),
+        LONGTAIL_LOGFIELD(enable_mmap_block_store, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+#if defined(LONGTAIL_ENABLE_FUSE)
+    const char* storage_path = NormalizePath(storage_uri_raw);
+
+    struct Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(Longtail_GetCPUCount(), 0);
+    struct Longtail_HashRegistryAPI* hash_registry = Longtail_CreateFullHashRegistry();
+    struct Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    struct Longtail_StorageAPI* storage_api = Longtail_CreateFSStorageAPI();
+    struct Longtail_BlockStoreAPI* store_block_remotestore_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, storage_path, 0, enable_mmap_block_store);
+    struct Longtail_BlockStoreAPI* store_block_localstore_api = 0;
+    struct Longtail_BlockStoreAPI* store_block_cachestore_api = 0;
+    struct Longtail_BlockStoreAPI* compress_block_store_api = 0;
+    if (cache_path)
+    {
+        store_block_localstore_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, cache_path, 0, enable_mmap_block_store);
+        store_block_cachestore_api = Longtail_CreateCacheBlockStoreAPI(job_api, store_block_localstore_api, store_block_remotestore_api);
+        compress_block_store_api = Longtail_CreateCompressBlockStoreAPI(store_block_cachestore_api, compression_registry);
+    }
+    else
+    {
+        compress_block_store_api = Longtail_CreateCompressBlockStoreAPI(store_block_remotestore_api, compression_registry);
+    }
+    struct Longtail_BlockStoreAPI* delta_block_store_api = StoreHasDeltaBlocks(storage_api, storage_path) ? Longtail_CreateDeltaBlockStoreAPI(compress_block_store_api, 0, 0) : 0;
+    // Bound the number of decompressed blocks we keep in memory, only blocks that are actually read are fetched
+    struct Longtail_BlockStoreAPI* lru_block_store_api = Longtail_CreateLRUBlockStoreAPI(delta_block_store_api ? delta_block_store_api : compress_block_store_api, block_cache_count);
+    struct Longtail_BlockStoreAPI* store_block_store_api = Longtail_CreateShareBlockStoreAPI(lru_block_store_api);
+
+    struct Longtail_VersionIndex* version_index = 0;
+    struct Longtail_StoreIndex* block_store_store_index = 0;
+    struct Longtail_StorageAPI* block_store_fs = 0;
+    struct Longtail_HashAPI* hash_api = 0;
+    int err = Longtail_ReadVersionIndex2(storage_api, compression_registry, job_api, version_index_path, &version_index);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to read version index from `%s`, %d", version_index_path, err);
+    }
+    if (!err)
+    {
+        err = hash_registry->GetHashAPI(hash_registry, *version_index->m_HashIdentifier, &hash_api);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Can not create hashing API for version index `%s`, failed with %d", version_index_path, err);
+        }
+    }
+    if (!err)
+    {
+        err = SyncGetExistingContent(
+            store_block_store_api,
+            *version_index->m_ChunkCount,
+            version_index->m_ChunkHashes,
+            0,
+            &block_store_store_index);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to create retarget store index for version index `%s` to `%s`, failed with %d", storage_uri_raw, version_index_path, err);
+        }
+    }
+    if (!err)
+    {
+        err = Longtail_ValidateStore(block_store_store_index, version_index);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Store `%s` does not contain all the chunks needed for this version `%s`, Longtail_ValidateStore failed with %d", storage_uri_raw, version_index_path, err);
+        }
+    }
+    if (!err)
+    {
+        block_store_fs = Longtail_CreateBlockStoreStorageAPI(
+            hash_api,
+            job_api,
+            store_block_store_api,
+            block_store_store_index,
+            version_index);
+        if (!block_store_fs)
+        {
+            err = ENOMEM;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to create file system for version index `%s`, failed with %d", version_index_path, err);
+        }
+    }
+    if (!err)
+    {
+        err = MountFS_Run(block_store_fs, version_index, mount_path);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to mount version index `%s` at `%s`, failed with %d", version_index_path, mount_path, err);
+        }
+    }
+
+    SAFE_DISPOSE_API(block_store_fs);
+    Longtail_Free(block_store_store_index);
+    Longtail_Free(version_index);
+    SAFE_DISPOSE_API(store_block_store_api);
+    SAFE_DISPOSE_API(lru_block_store_api);
+    SAFE_DISPOSE_API(delta_block_store_api);
+    SAFE_DISPOSE_API(compress_block_store_api);
+    SAFE_DISPOSE_API(store_block_cachestore_api);
+    SAFE_DISPOSE_API(store_block_localstore_api);
+    SAFE_DISPOSE_API(store_block_remotestore_api);
+    SAFE_DISPOSE_API(storage_api);
+    SAFE_DISPOSE_API(compression_registry);
+    SAFE_DISPOSE_API(hash_registry);
+    SAFE_DISPOSE_API(job_api);
+    Longtail_Free((void*)storage_path);
+    return err;
+#else
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "longtail was built without FUSE support, failed with %d", ENOTSUP);
+    return ENOTSUP;
+#endif // defined(LONGTAIL_ENABLE_FUSE)
+}
+
 
 struct SyncFlush
 {
@@ -2111,6 +2918,184 @@ int SyncFlush_Init(struct SyncFlush* sync_flush)
     return Longtail_CreateSema(Longtail_Alloc(0, Longtail_GetSemaSize()), 0, &sync_flush->m_NotifySema);
 }
 
+struct SyncPruneBlocks
+{
+    struct Longtail_AsyncPruneBlocksAPI m_API;
+    HLongtail_Sema m_NotifySema;
+    uint32_t m_PrunedBlockCount;
+    int m_Err;
+};
+
+void SyncPruneBlocks_OnComplete(struct Longtail_AsyncPruneBlocksAPI* async_complete_api, uint32_t pruned_block_count, int err)
+{
+    struct SyncPruneBlocks* api = (struct SyncPruneBlocks*)async_complete_api;
+    api->m_PrunedBlockCount = pruned_block_count;
+    api->m_Err = err;
+    Longtail_PostSema(api->m_NotifySema, 1);
+}
+
+void SyncPruneBlocks_Wait(struct SyncPruneBlocks* sync_prune_blocks)
+{
+    Longtail_WaitSema(sync_prune_blocks->m_NotifySema, LONGTAIL_TIMEOUT_INFINITE);
+}
+
+void SyncPruneBlocks_Dispose(struct Longtail_API* longtail_api)
+{
+    struct SyncPruneBlocks* api = (struct SyncPruneBlocks*)longtail_api;
+    Longtail_DeleteSema(api->m_NotifySema);
+    Longtail_Free(api->m_NotifySema);
+}
+
+int SyncPruneBlocks_Init(struct SyncPruneBlocks* sync_prune_blocks)
+{
+    sync_prune_blocks->m_PrunedBlockCount = 0;
+    sync_prune_blocks->m_Err = EINVAL;
+    sync_prune_blocks->m_API.m_API.Dispose = SyncPruneBlocks_Dispose;
+    sync_prune_blocks->m_API.OnComplete = SyncPruneBlocks_OnComplete;
+    return Longtail_CreateSema(Longtail_Alloc(0, Longtail_GetSemaSize()), 0, &sync_prune_blocks->m_NotifySema);
+}
+
+// Removes the blocks that no registered version references from the store.
+// The block ref count index is only complete if every upsync to the store used `--block-ref-count-path`,
+// pruning must not run at the same time as an upsync to the same store.
+int Prune(
+    const char* storage_uri_raw,
+    const char* block_ref_count_path,
+    const char* optional_retire_version_local_store_index_path,
+    int enable_delta_blocks)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_uri_raw, "%s"),
+        LONGTAIL_LOGFIELD(block_ref_count_path, "%s"),
+        LONGTAIL_LOGFIELD(optional_retire_version_local_store_index_path, "%p"),
+        LONGTAIL_LOGFIELD(enable_delta_blocks, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    const char* storage_path = NormalizePath(storage_uri_raw);
+    struct Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(Longtail_GetCPUCount(), 0);
+    struct Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    struct Longtail_StorageAPI* storage_api = Longtail_CreateFSStorageAPI();
+    struct Longtail_BlockStoreAPI* store_block_fsstore_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, storage_path, 0, 0);
+    struct Longtail_BlockStoreAPI* store_block_compressstore_api = Longtail_CreateCompressBlockStoreAPI(store_block_fsstore_api, compression_registry);
+    struct Longtail_BlockStoreAPI* store_block_deltastore_api = 0;
+    if (enable_delta_blocks || StoreHasDeltaBlocks(storage_api, storage_path))
+    {
+        // The delta block store keeps the base blocks of the kept delta blocks
+        char* delta_index_path = storage_api->ConcatPath(storage_api, storage_path, "store.ldi");
+        store_block_deltastore_api = Longtail_CreateDeltaBlockStoreAPI(store_block_compressstore_api, storage_api, delta_index_path);
+        Longtail_Free(delta_index_path);
+    }
+    struct Longtail_BlockStoreAPI* store_block_store_api = store_block_deltastore_api ? store_block_deltastore_api : store_block_compressstore_api;
+
+    struct Longtail_BlockRefCountIndex* ref_count_index = 0;
+    int err = 0;
+    // A missing index would make every block in the store unreferenced
+    if (!storage_api->IsFile(storage_api, block_ref_count_path))
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Block ref count index `%s` does not exist, %d", block_ref_count_path, ENOENT);
+        err = ENOENT;
+    }
+    else if (optional_retire_version_local_store_index_path)
+    {
+        struct Longtail_StoreIndex* retire_store_index = 0;
+        err = Longtail_ReadStoreIndex(storage_api, optional_retire_version_local_store_index_path, &retire_store_index);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to read version local store index from `%s`, %d", optional_retire_version_local_store_index_path, err);
+        }
+        else
+        {
+            err = Longtail_UpdateBlockRefCountIndex(
+                storage_api,
+                block_ref_count_path,
+                *retire_store_index->m_BlockCount,
+                retire_store_index->m_BlockHashes,
+                1,
+                &ref_count_index);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to retire version blocks in `%s`, %d", block_ref_count_path, err);
+            }
+            Longtail_Free(retire_store_index);
+        }
+    }
+    else
+    {
+        err = Longtail_ReadBlockRefCountIndex(storage_api, block_ref_count_path, &ref_count_index);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to read block ref count index from `%s`, %d", block_ref_count_path, err);
+        }
+    }
+
+    struct SyncPruneBlocks pruneCB;
+    int prune_cb_err = ENOMEM;
+    if (!err)
+    {
+        err = prune_cb_err = SyncPruneBlocks_Init(&pruneCB);
+    }
+    if (!err)
+    {
+        err = store_block_store_api->PruneBlocks(
+            store_block_store_api,
+            *ref_count_index->m_BlockCount,
+            ref_count_index->m_BlockHashes,
+            &pruneCB.m_API);
+        if (!err)
+        {
+            SyncPruneBlocks_Wait(&pruneCB);
+            err = pruneCB.m_Err;
+        }
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to prune blocks in `%s`, %d", storage_path, err);
+        }
+    }
+
+    struct SyncFlush flushCB;
+    int flush_cb_err = ENOMEM;
+    if (!err)
+    {
+        err = flush_cb_err = SyncFlush_Init(&flushCB);
+    }
+    if (!err)
+    {
+        err = store_block_store_api->Flush(store_block_store_api, &flushCB.m_API);
+        if (!err)
+        {
+            SyncFlush_Wait(&flushCB);
+            err = flushCB.m_Err;
+        }
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to flush block store `%s`, %d", storage_path, err);
+        }
+    }
+
+    if (!err)
+    {
+        printf("Pruned %u blocks, kept %u blocks\n", pruneCB.m_PrunedBlockCount, *ref_count_index->m_BlockCount);
+    }
+
+    if (flush_cb_err == 0)
+    {
+        SAFE_DISPOSE_API(&flushCB.m_API);
+    }
+    if (prune_cb_err == 0)
+    {
+        SAFE_DISPOSE_API(&pruneCB.m_API);
+    }
+    Longtail_Free(ref_count_index);
+    SAFE_DISPOSE_API(store_block_deltastore_api);
+    SAFE_DISPOSE_API(store_block_compressstore_api);
+    SAFE_DISPOSE_API(store_block_fsstore_api);
+    SAFE_DISPOSE_API(storage_api);
+    SAFE_DISPOSE_API(compression_registry);
+    SAFE_DISPOSE_API(job_api);
+    Longtail_Free((void*)storage_path);
+    return err;
+}
+
 
 
 int Pack(
@@ -2122,6 +3107,7 @@ int Pack(
     uint32_t min_block_usage_percent,
     uint32_t hashing_type,
     uint32_t compression_type,
+    int enable_content_type_tags,
     int enable_mmap_indexing,
     int enable_detailed_progress)
 {
@@ -2134,6 +3120,7 @@ int Pack(
         LONGTAIL_LOGFIELD(min_block_usage_percent, "%u"),
         LONGTAIL_LOGFIELD(hashing_type, "%u"),
         LONGTAIL_LOGFIELD(compression_type, "%u"),
+        LONGTAIL_LOGFIELD(enable_content_type_tags, "%d"),
         LONGTAIL_LOGFIELD(enable_mmap_indexing, "%d"),
         LONGTAIL_LOGFIELD(enable_detailed_progress, "%d")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
@@ -2185,9 +3172,28 @@ int Pack(
             return err;
         }
         uint32_t* tags = (uint32_t*)Longtail_Alloc(0, sizeof(uint32_t) * file_infos->m_Count);
-        for (uint32_t i = 0; i < file_infos->m_Count; ++i)
+        if (enable_content_type_tags)
         {
-            tags[i] = compression_type;
+            err = Longtail_GetContentTypeAssetTags(file_infos, compression_type, 0, tags);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to get content type tags for `%s`, %d", source_path, err);
+                Longtail_Free(tags);
+                Longtail_Free(file_infos);
+                SAFE_DISPOSE_API(chunker_api);
+                SAFE_DISPOSE_API(storage_api);
+                SAFE_DISPOSE_API(compression_registry);
+                SAFE_DISPOSE_API(job_api);
+                SAFE_DISPOSE_API(hash_registry);
+                return err;
+            }
+        }
+        else
+        {
+            for (uint32_t i = 0; i < file_infos->m_Count; ++i)
+            {
+                tags[i] = compression_type;
+            }
         }
 
         struct Longtail_ProgressAPI* progress = MakeProgressAPI("Indexing version", 5);
@@ -2553,10 +3559,11 @@ int Unpack(
     }
 
     struct Longtail_VersionDiff* version_diff;
-    err = Longtail_CreateVersionDiff(
+    err = Longtail_CreateVersionDiff2(
         hash_api,
         target_version_index,
         &archive_index->m_VersionIndex,
+        1,
         &version_diff);
     if (err)
     {
@@ -2576,6 +3583,7 @@ int Unpack(
     if ((*version_diff->m_SourceRemovedCount == 0) &&
         (*version_diff->m_ModifiedContentCount == 0) &&
         (*version_diff->m_TargetAddedCount == 0) &&
+        (*version_diff->m_MovedCount == 0) &&
         (*version_diff->m_ModifiedPermissionsCount == 0 || !retain_permissions) )
     {
         Longtail_Free(version_diff);
@@ -2706,13 +3714,21 @@ struct UpSyncArgs
     const char* source_path;
     const char* optional_source_index_path;
     const char* target_index_path;
+    const char* optional_version_local_store_index_path;
+    const char* optional_block_ref_count_path;
     uint32_t target_chunk_size;
     uint32_t target_block_size;
     uint32_t max_chunks_per_block;
     uint32_t min_block_usage_percent;
     uint32_t hashing_type;
     uint32_t compression_type;
+    int enable_adaptive_compression;
+    int enable_raw_frames;
+    int enable_content_type_tags;
+    int enable_compact_version_index;
+    int enable_delta_blocks;
     int enable_mmap_indexing;
+    int enable_read_ahead_indexing;
     int enable_mmap_block_store;
     int enable_detailed_progress;
 };
@@ -2725,13 +3741,21 @@ static int UpSyncWorker(void* context)
         Args->source_path,
         Args->optional_source_index_path,
         Args->target_index_path,
+        Args->optional_version_local_store_index_path,
+        Args->optional_block_ref_count_path,
         Args->target_chunk_size,
         Args->target_block_size,
         Args->max_chunks_per_block,
         Args->min_block_usage_percent,
         Args->hashing_type,
         Args->compression_type,
+        Args->enable_adaptive_compression,
+        Args->enable_raw_frames,
+        Args->enable_content_type_tags,
+        Args->enable_compact_version_index,
+        Args->enable_delta_blocks,
         Args->enable_mmap_indexing,
+        Args->enable_read_ahead_indexing,
         Args->enable_mmap_block_store,
         Args->enable_detailed_progress);
     return res;
@@ -2742,13 +3766,21 @@ static HLongtail_Thread UpSyncThreaded(
     const char* source_path,
     const char* optional_source_index_path,
     const char* target_index_path,
+    const char* optional_version_local_store_index_path,
+    const char* optional_block_ref_count_path,
     uint32_t target_chunk_size,
     uint32_t target_block_size,
     uint32_t max_chunks_per_block,
     uint32_t min_block_usage_percent,
     uint32_t hashing_type,
     uint32_t compression_type,
+    int enable_adaptive_compression,
+    int enable_raw_frames,
+    int enable_content_type_tags,
+    int enable_compact_version_index,
+    int enable_delta_blocks,
     int enable_mmap_indexing,
+    int enable_read_ahead_indexing,
     int enable_mmap_block_store,
     int enable_detailed_progress)
 {
@@ -2758,13 +3790,21 @@ static HLongtail_Thread UpSyncThreaded(
     Args->source_path = source_path;
     Args->optional_source_index_path = optional_source_index_path;
     Args->target_index_path = target_index_path;
+    Args->optional_version_local_store_index_path = optional_version_local_store_index_path;
+    Args->optional_block_ref_count_path = optional_block_ref_count_path;
     Args->target_chunk_size = target_chunk_size;
     Args->target_block_size = target_block_size;
     Args->max_chunks_per_block = max_chunks_per_block;
     Args->min_block_usage_percent = min_block_usage_percent;
     Args->hashing_type = hashing_type;
     Args->compression_type = compression_type;
+    Args->enable_adaptive_compression = enable_adaptive_compression;
+    Args->enable_raw_frames = enable_raw_frames;
+    Args->enable_content_type_tags = enable_content_type_tags;
+    Args->enable_compact_version_index = enable_compact_version_index;
+    Args->enable_delta_blocks = enable_delta_blocks;
     Args->enable_mmap_indexing = enable_mmap_indexing;
+    Args->enable_read_ahead_indexing = enable_read_ahead_indexing;
     Args->enable_mmap_block_store = enable_mmap_block_store;
     Args->enable_detailed_progress = enable_detailed_progress;
     HLongtail_Thread MonitorThread = 0;
@@ -2776,10 +3816,16 @@ struct DownSyncArgs
 {
     const char* storage_uri_raw;
     const char* cache_path;
+    uint32_t cache_compression_type;
     const char* source_path;
     const char* target_path;
     const char* optional_target_index_path;
+    const char* optional_target_state_path;
+    const char* optional_include_paths;
+    const char* optional_exclude_paths;
     int retain_permissions;
+    int use_local_chunks;
+    int enable_delta_blocks;
     int enable_mmap_indexing;
     int enable_mmap_block_store;
     int enable_detailed_progress;
@@ -2791,10 +3837,16 @@ static int DownSyncWorker(void* context)
     int res = DownSync(
         Args->storage_uri_raw,
         Args->cache_path,
+        Args->cache_compression_type,
         Args->source_path,
         Args->target_path,
         Args->optional_target_index_path,
+        Args->optional_target_state_path,
+        Args->optional_include_paths,
+        Args->optional_exclude_paths,
         Args->retain_permissions,
+        Args->use_local_chunks,
+        Args->enable_delta_blocks,
         Args->enable_mmap_indexing,
         Args->enable_mmap_block_store,
         Args->enable_detailed_progress);
@@ -2804,10 +3856,16 @@ static int DownSyncWorker(void* context)
 static HLongtail_Thread DownSyncThreaded(
     const char* storage_uri_raw,
     const char* cache_path,
+    uint32_t cache_compression_type,
     const char* source_path,
     const char* target_path,
     const char* optional_target_index_path,
+    const char* optional_target_state_path,
+    const char* optional_include_paths,
+    const char* optional_exclude_paths,
     int retain_permissions,
+    int use_local_chunks,
+    int enable_delta_blocks,
     int enable_mmap_indexing,
     int enable_mmap_block_store,
     int enable_detailed_progress)
@@ -2816,10 +3874,16 @@ static HLongtail_Thread DownSyncThreaded(
     struct DownSyncArgs* Args = (struct DownSyncArgs*)AsyncThreadedMem;
     Args->storage_uri_raw = storage_uri_raw;
     Args->cache_path = cache_path;
+    Args->cache_compression_type = cache_compression_type;
     Args->source_path = source_path;
     Args->target_path = target_path;
     Args->optional_target_index_path = optional_target_index_path;
+    Args->optional_target_state_path = optional_target_state_path;
+    Args->optional_include_paths = optional_include_paths;
+    Args->optional_exclude_paths = optional_exclude_paths;
     Args->retain_permissions = retain_permissions;
+    Args->use_local_chunks = use_local_chunks;
+    Args->enable_delta_blocks = enable_delta_blocks;
     Args->enable_mmap_indexing = enable_mmap_indexing;
     Args->enable_mmap_block_store = enable_mmap_block_store;
     Args->enable_detailed_progress = enable_detailed_progress;
@@ -2838,6 +3902,7 @@ struct PackArgs
     uint32_t min_block_usage_percent;
     uint32_t hashing_type;
     uint32_t compression_type;
+    int enable_content_type_tags;
     int enable_mmap_indexing;
     int enable_detailed_progress;
 };
@@ -2854,6 +3919,7 @@ static int PackWorker(void* context)
         Args->min_block_usage_percent,
         Args->hashing_type,
         Args->compression_type,
+        Args->enable_content_type_tags,
         Args->enable_mmap_indexing,
         Args->enable_detailed_progress);
     return res;
@@ -2868,6 +3934,7 @@ static HLongtail_Thread PackThreaded(
     uint32_t min_block_usage_percent,
     uint32_t hashing_type,
     uint32_t compression_type,
+    int enable_content_type_tags,
     int enable_mmap_indexing,
     int enable_detailed_progress)
 {
@@ -2881,6 +3948,7 @@ static HLongtail_Thread PackThreaded(
     Args->min_block_usage_percent = min_block_usage_percent;
     Args->hashing_type = hashing_type;
     Args->compression_type = compression_type;
+    Args->enable_content_type_tags = enable_content_type_tags;
     Args->enable_mmap_indexing = enable_mmap_indexing;
     Args->enable_detailed_progress = enable_detailed_progress;
     HLongtail_Thread MonitorThread = 0;
@@ -2960,7 +4028,7 @@ int main(int argc, char** argv)
 
     if (argc < 2)
     {
-        kgflags_set_custom_description("Use command `upsync`, `downsync`, `validate`, `ls`, `cp`, `pack` or `unpack`");
+        kgflags_set_custom_description("Use command `upsync`, `downsync`, `validate`, `ls`, `cp`, `mount`, `prune`, `pack` or `unpack`");
         kgflags_print_usage();
         return 1;
     }
@@ -2971,10 +4039,12 @@ int main(int argc, char** argv)
         (strcmp(command, "validate") != 0) &&
         (strcmp(command, "ls") != 0) &&
         (strcmp(command, "cp") != 0) &&
+        (strcmp(command, "mount") != 0) &&
+        (strcmp(command, "prune") != 0) &&
         (strcmp(command, "pack") != 0) &&
         (strcmp(command, "unpack") != 0))
     {
-        kgflags_set_custom_description("Use command `upsync`, `downsync`, `validate`, `ls`, `cp`, `pack` or `unpack`");
+        kgflags_set_custom_description("Use command `upsync`, `downsync`, `validate`, `ls`, `cp`, `mount`, `prune`, `pack` or `unpack`");
         kgflags_print_usage();
         return 1;
     }
@@ -2985,7 +4055,7 @@ int main(int argc, char** argv)
         kgflags_string("storage-uri", 0, "URI for chunks and store index for store", true, &storage_uri_raw);
 
         const char* hasing_raw = 0;
-        kgflags_string("hash-algorithm", "blake3", "Hashing algorithm: blake2, blake3, meow", false, &hasing_raw);
+        kgflags_string("hash-algorithm", "blake3", "Hashing algorithm: blake2, blake3, meow, xxh3", false, &hasing_raw);
 
         const char* source_path_raw = 0;
         kgflags_string("source-path", 0, "Source folder path", true, &source_path_raw);
@@ -2996,9 +4066,30 @@ int main(int argc, char** argv)
         const char* target_path_raw = 0;
         kgflags_string("target-path", 0, "Target file path", true, &target_path_raw);
 
+        const char* version_local_store_index_raw = 0;
+        kgflags_string("version-local-store-index-path", 0, "Optional path to write the store index of the blocks used by the version", false, &version_local_store_index_raw);
+
+        const char* block_ref_count_raw = 0;
+        kgflags_string("block-ref-count-path", 0, "Optional block ref count index to register the blocks used by the version in, see prune", false, &block_ref_count_raw);
+
         const char* compression_raw = 0;
         kgflags_string("compression-algorithm", "zstd", "Compression algorithm: none, brotli, brotli_min, brotli_max, brotli_text, brotli_text_min, brotli_text_max, lz4, zstd, zstd_min, zstd_max", false, &compression_raw);
 
+        bool enable_adaptive_compression_raw = 0;
+        kgflags_bool("adaptive-compression", false, "Move between the compression levels of the compression algorithm family to match the store throughput", false, &enable_adaptive_compression_raw);
+
+        bool enable_raw_frames_raw = 0;
+        kgflags_bool("raw-frames", false, "Store blocks that do not compress uncompressed, stores with such blocks can not be read by longtail 0.4.3 and older", false, &enable_raw_frames_raw);
+
+        bool enable_content_type_tags_raw = 0;
+        kgflags_bool("content-type-tags", false, "Store already compressed media and archive files without compressing them again", false, &enable_content_type_tags_raw);
+
+        bool enable_compact_version_index_raw = 0;
+        kgflags_bool("compact-version-index", false, "Write the version index using the compact encoding, compressed with the compression algorithm", false, &enable_compact_version_index_raw);
+
+        bool enable_delta_blocks_raw = 0;
+        kgflags_bool("delta-blocks", false, "Store blocks as deltas against similar blocks in the store, readers detect such stores by their delta index", false, &enable_delta_blocks_raw);
+
         int32_t target_chunk_size = 8;
         kgflags_int("target-chunk-size", 32768, "Target chunk size", false, &target_chunk_size);
 
@@ -3014,6 +4105,9 @@ int main(int argc, char** argv)
         bool enable_mmap_indexing_raw = 0;
         kgflags_bool("mmap-indexing", false, "Enable memory mapping of files while indexing", false, &enable_mmap_indexing_raw);
 
+        bool enable_read_ahead_indexing_raw = 0;
+        kgflags_bool("read-ahead-indexing", false, "Read files ahead on a separate thread while indexing", false, &enable_read_ahead_indexing_raw);
+
         bool enable_mmap_block_store_raw = 0;
         kgflags_bool("mmap-block-store", false, "Enable memory mapping of files in block store", false, &enable_mmap_block_store_raw);
 
@@ -3058,19 +4152,29 @@ int main(int argc, char** argv)
         const char* source_path = NormalizePath(source_path_raw);
         const char* source_index = source_index_raw ? NormalizePath(source_index_raw) : 0;
         const char* target_path = NormalizePath(target_path_raw);
+        const char* version_local_store_index = version_local_store_index_raw ? NormalizePath(version_local_store_index_raw) : 0;
+        const char* block_ref_count = block_ref_count_raw ? NormalizePath(block_ref_count_raw) : 0;
 
         HLongtail_Thread thread = UpSyncThreaded(
             storage_uri_raw,
             source_path,
             source_index,
             target_path,
+            version_local_store_index,
+            block_ref_count,
             target_chunk_size,
             target_block_size,
             max_chunks_per_block,
             min_block_usage_percent,
             hashing,
             compression,
+            enable_adaptive_compression_raw,
+            enable_raw_frames_raw,
+            enable_content_type_tags_raw,
+            enable_compact_version_index_raw,
+            enable_delta_blocks_raw,
             enable_mmap_indexing_raw,
+            enable_read_ahead_indexing_raw,
             enable_mmap_block_store_raw,
             enable_detailed_progress_raw);
         while (TryEndAsyncThread(thread))
@@ -3082,6 +4186,8 @@ int main(int argc, char** argv)
         Longtail_Free((void*)source_path);
         Longtail_Free((void*)source_index);
         Longtail_Free((void*)target_path);
+        Longtail_Free((void*)version_local_store_index);
+        Longtail_Free((void*)block_ref_count);
 
         SAFE_DISPOSE_API(FrameBufferAPI);
     }
@@ -3093,18 +4199,36 @@ int main(int argc, char** argv)
         const char* cache_path_raw = 0;
         kgflags_string("cache-path", 0, "Location for downloaded/cached blocks", false, &cache_path_raw);
 
+        const char* cache_compression_raw = 0;
+        kgflags_string("cache-compression-algorithm", 0, "Compression algorithm for blocks in cache-path, same values as compression-algorithm, default keeps the store compression", false, &cache_compression_raw);
+
         const char* target_path_raw = 0;
         kgflags_string("target-path", 0, "Target folder path", true, &target_path_raw);
 
         const char* target_index_raw = 0;
         kgflags_string("target-index-path", 0, "Optional pre-computed index of target-path", false, &target_index_raw);
 
+        const char* target_state_raw = 0;
+        kgflags_string("target-state-path", 0, "Optional state of target-path written by the last downsync, unchanged files are not hashed again", false, &target_state_raw);
+
         const char* source_path_raw = 0;
         kgflags_string("source-path", 0, "Source file path", true, &source_path_raw);
 
+        const char* include_paths_raw = 0;
+        kgflags_string("include-paths", 0, "Only sync these ';' separated files and folders, other files in target-path are left untouched", false, &include_paths_raw);
+
+        const char* exclude_paths_raw = 0;
+        kgflags_string("exclude-paths", 0, "Do not sync these ';' separated files and folders, they are left untouched in target-path", false, &exclude_paths_raw);
+
         bool retain_permission_raw = 0;
         kgflags_bool("retain-permissions", true, "Disable setting permission on file/directories from source", false, &retain_permission_raw);
 
+        bool use_local_chunks_raw = 0;
+        kgflags_bool("use-local-chunks", false, "Copy chunks that already exist in target-path instead of fetching them, copied chunks are verified and fetched from the store if they do not match", false, &use_local_chunks_raw);
+
+        bool enable_delta_blocks_raw = 0;
+        kgflags_bool("delta-blocks", false, "Resolve blocks stored as deltas even if the store has no delta index, stores written with upsync --delta-blocks are detected", false, &enable_delta_blocks_raw);
+
         bool enable_mmap_indexing_raw = 0;
         kgflags_bool("mmap-indexing", false, "Enable memory mapping of files while indexing", false, &enable_mmap_indexing_raw);
 
@@ -3135,19 +4259,33 @@ int main(int argc, char** argv)
             FrameBufferAPI = Longtail_CreateMiniFBFrameBufferAPI();
         }
 
+        uint32_t cache_compression = cache_compression_raw ? ParseCompressionType(cache_compression_raw) : 0xffffffff;
+        if (cache_compression_raw && cache_compression == 0xffffffff)
+        {
+            printf("Invalid cache compression algorithm `%s`\n", cache_compression_raw);
+            return 1;
+        }
+
         const char* cache_path = cache_path_raw ? NormalizePath(cache_path_raw) : 0;
         const char* target_path = NormalizePath(target_path_raw);
         const char* target_index = target_index_raw ? NormalizePath(target_index_raw) : 0;
+        const char* target_state = target_state_raw ? NormalizePath(target_state_raw) : 0;
         const char* source_path = NormalizePath(source_path_raw);
 
         // Downsync!
         HLongtail_Thread thread = DownSyncThreaded(
             storage_uri_raw,
             cache_path,
+            cache_compression,
             source_path,
             target_path,
             target_index,
+            target_state,
+            include_paths_raw,
+            exclude_paths_raw,
             retain_permission_raw,
+            use_local_chunks_raw,
+            enable_delta_blocks_raw,
             enable_mmap_indexing_raw,
             enable_mmap_block_store_raw,
             enable_detailed_progress_raw);
@@ -3158,6 +4296,7 @@ int main(int argc, char** argv)
         DisposeMonitor();
 
         Longtail_Free((void*)source_path);
+        Longtail_Free((void*)target_state);
         Longtail_Free((void*)target_index);
         Longtail_Free((void*)target_path);
         Longtail_Free((void*)cache_path);
@@ -3205,9 +4344,6 @@ int main(int argc, char** argv)
         const char* version_index_path_raw = 0;
         kgflags_string("version-index-path", 0, "Version index file path", true, &version_index_path_raw);
 
-        bool enable_mmap_block_store_raw = 0;
-        kgflags_bool("mmap-block-store", false, "Enable memory mapping of files in block store", false, &enable_mmap_block_store_raw);
-
         if (!kgflags_parse(argc, argv)) {
             kgflags_print_errors();
             kgflags_print_usage();
@@ -3233,8 +4369,7 @@ int main(int argc, char** argv)
 
         err = VersionIndex_ls(
             version_index_path,
-            ls_dir,
-            enable_mmap_block_store_raw);
+            ls_dir);
 	// ls [path] --source-path <version.lvi> --storage-uri <store-uri>
 	// cp source target --source-path <version.lvi> --storage-uri <store-uri>
 	// 
@@ -3289,10 +4424,101 @@ int main(int argc, char** argv)
             target_path,
             enable_mmap_block_store_raw);
     }
+    else if (strcmp(command, "mount") == 0)
+    {
+        const char* storage_uri_raw = 0;
+        kgflags_string("storage-uri", 0, "URI for chunks and store index for store", true, &storage_uri_raw);
+
+        const char* cache_path_raw = 0;
+        kgflags_string("cache-path", 0, "Location for downloaded/cached blocks", false, &cache_path_raw);
+
+        const char* version_index_path_raw = 0;
+        kgflags_string("version-index-path", 0, "Version index file path", true, &version_index_path_raw);
+
+        int block_cache_count = 64;
+        kgflags_int("block-cache-count", 64, "Max number of decompressed blocks to keep in memory", false, &block_cache_count);
+
+        bool enable_mmap_block_store_raw = 0;
+        kgflags_bool("mmap-block-store", false, "Enable memory mapping of files in block store", false, &enable_mmap_block_store_raw);
+
+        if (!kgflags_parse(argc, argv)) {
+            kgflags_print_errors();
+            kgflags_print_usage();
+            return 1;
+        }
+
+        if (kgflags_get_non_flag_args_count() < 2)
+        {
+            kgflags_set_custom_description("Use mount <mount-path>");
+            kgflags_print_errors();
+            kgflags_print_usage();
+            return 1;
+        }
+
+        if (enable_mem_tracer_raw) {
+            Longtail_MemTracer_Init();
+            Longtail_SetReAllocAndFree(Longtail_MemTracer_ReAlloc, Longtail_MemTracer_Free);
+        }
+
+        const char* mount_path_raw = kgflags_get_non_flag_arg(1);
+
+        const char* cache_path = cache_path_raw ? NormalizePath(cache_path_raw) : 0;
+        const char* version_index_path = NormalizePath(version_index_path_raw);
+        const char* mount_path = NormalizePath(mount_path_raw);
+
+        err = VersionIndex_mount(
+            storage_uri_raw,
+            version_index_path,
+            cache_path,
+            mount_path,
+            block_cache_count > 0 ? (uint32_t)block_cache_count : 1u,
+            enable_mmap_block_store_raw);
+
+        Longtail_Free((void*)cache_path);
+        Longtail_Free((void*)version_index_path);
+        Longtail_Free((void*)mount_path);
+    }
+    else if (strcmp(command, "prune") == 0)
+    {
+        const char* storage_uri_raw = 0;
+        kgflags_string("storage-uri", 0, "URI for chunks and store index for store", true, &storage_uri_raw);
+
+        const char* block_ref_count_raw = 0;
+        kgflags_string("block-ref-count-path", 0, "Block ref count index that upsync registered the versions in", true, &block_ref_count_raw);
+
+        const char* retire_version_local_store_index_raw = 0;
+        kgflags_string("retire-version-local-store-index-path", 0, "Optional version local store index of a version to retire before pruning", false, &retire_version_local_store_index_raw);
+
+        bool enable_delta_blocks_raw = 0;
+        kgflags_bool("delta-blocks", false, "Keep the base blocks of kept delta blocks even if the store has no delta index, stores written with upsync --delta-blocks are detected", false, &enable_delta_blocks_raw);
+
+        if (!kgflags_parse(argc, argv)) {
+            kgflags_print_errors();
+            kgflags_print_usage();
+            return 1;
+        }
+
+        if (enable_mem_tracer_raw) {
+            Longtail_MemTracer_Init();
+            Longtail_SetReAllocAndFree(Longtail_MemTracer_ReAlloc, Longtail_MemTracer_Free);
+        }
+
+        const char* block_ref_count_path = NormalizePath(block_ref_count_raw);
+        const char* retire_version_local_store_index_path = retire_version_local_store_index_raw ? NormalizePath(retire_version_local_store_index_raw) : 0;
+
+        err = Prune(
+            storage_uri_raw,
+            block_ref_count_path,
+            retire_version_local_store_index_path,
+            enable_delta_blocks_raw);
+
+        Longtail_Free((void*)block_ref_count_path);
+        Longtail_Free((void*)retire_version_local_store_index_path);
+    }
     else if (strcmp(command, "pack") == 0)
     {
         const char* hasing_raw = 0;
-        kgflags_string("hash-algorithm", "blake3", "Hashing algorithm: blake2, blake3, meow", false, &hasing_raw);
+        kgflags_string("hash-algorithm", "blake3", "Hashing algorithm: blake2, blake3, meow, xxh3", false, &hasing_raw);
 
         const char* source_path_raw = 0;
         kgflags_string("source-path", 0, "Source folder path", true, &source_path_raw);
@@ -3303,6 +4529,9 @@ int main(int argc, char** argv)
         const char* compression_raw = 0;
         kgflags_string("compression-algorithm", "zstd", "Compression algorithm: none, brotli, brotli_min, brotli_max, brotli_text, brotli_text_min, brotli_text_max, lz4, zstd, zstd_min, zstd_max", false, &compression_raw);
 
+        bool enable_content_type_tags_raw = 0;
+        kgflags_bool("content-type-tags", false, "Store already compressed media and archive files without compressing them again", false, &enable_content_type_tags_raw);
+
         int32_t target_chunk_size = 8;
         kgflags_int("target-chunk-size", 32768, "Target chunk size", false, &target_chunk_size);
 
@@ -3368,6 +4597,7 @@ int main(int argc, char** argv)
             min_block_usage_percent,
             hashing,
             compression,
+            enable_content_type_tags_raw,
             enable_mmap_indexing_raw,
             enable_detailed_progress_raw);
         while (TryEndAsyncThread(thread))
@@ -3442,6 +4672,7 @@ int main(int argc, char** argv)
 
         SAFE_DISPOSE_API(FrameBufferAPI);
     }
+    Longtail_DisposeScratchArenaPool();
 #if defined(_CRTDBG_MAP_ALLOC)
     _CrtDumpMemoryLeaks();
 #endif
@@ -0,0 +1,52 @@
+#!/bin/bash
+# Smoke test for `longtail mount`, requires a longtail built with libfuse3 and fusermount3
+# Usage: test_mount.sh <path to longtail executable>
+set -e
+
+LONGTAIL=$(realpath "$1")
+WORKPATH=$(mktemp -d)
+MOUNTPATH="$WORKPATH/mount"
+MOUNT_PID=""
+
+cleanup() {
+    if [ -n "$MOUNT_PID" ]; then
+        fusermount3 -u "$MOUNTPATH" 2>/dev/null || true
+        wait $MOUNT_PID 2>/dev/null || true
+    fi
+    rm -rf "$WORKPATH"
+}
+trap cleanup EXIT
+
+mkdir -p "$WORKPATH/source/folder/empty" "$MOUNTPATH"
+echo "small file" > "$WORKPATH/source/small.txt"
+head -c 3000000 /dev/urandom > "$WORKPATH/source/folder/random.bin"
+seq 1 200000 > "$WORKPATH/source/folder/sequence.txt"
+
+$LONGTAIL upsync --source-path "$WORKPATH/source" --target-path "$WORKPATH/version.lvi" --storage-uri "$WORKPATH/store"
+
+$LONGTAIL mount --storage-uri "$WORKPATH/store" --version-index-path "$WORKPATH/version.lvi" "$MOUNTPATH" &
+MOUNT_PID=$!
+
+for i in $(seq 1 50); do
+    if mountpoint -q "$MOUNTPATH"; then
+        break
+    fi
+    if ! kill -0 $MOUNT_PID 2>/dev/null; then
+        echo "longtail mount exited before the file system was mounted"
+        exit 1
+    fi
+    sleep 0.2
+done
+mountpoint -q "$MOUNTPATH"
+
+diff -r "$WORKPATH/source" "$MOUNTPATH"
+if touch "$MOUNTPATH/new.txt" 2>/dev/null; then
+    echo "Mounted version is writable"
+    exit 1
+fi
+
+fusermount3 -u "$MOUNTPATH"
+wait $MOUNT_PID
+MOUNT_PID=""
+
+echo "Done"
@@ -34,6 +34,8 @@ mkdir dist\include\lib\cacheblockstore
 mkdir dist\include\lib\compressblockstore
 mkdir dist\include\lib\compressionregistry
 mkdir dist\include\lib\concurrentchunkwrite
+mkdir dist\include\lib\directorycache
+mkdir dist\include\lib\deltablockstore
 mkdir dist\include\lib\filestorage
 mkdir dist\include\lib\fsblockstore
 mkdir dist\include\lib\hpcdcchunker
@@ -44,7 +46,9 @@ mkdir dist\include\lib\memstorage
 mkdir dist\include\lib\memtracer
 mkdir dist\include\lib\meowhash
 mkdir dist\include\lib\ratelimitedprogress
+mkdir dist\include\lib\readaheadstorage
 mkdir dist\include\lib\shareblockstore
+mkdir dist\include\lib\xxh3
 mkdir dist\include\lib\zstd
 copy src\*.h dist\include\src
 copy lib\archiveblockstore\*.h dist\include\lib\archiveblockstore
@@ -58,6 +62,8 @@ copy lib\cacheblockstore\*.h dist\include\lib\cacheblockstore
 copy lib\compressblockstore\*.h dist\include\lib\compressblockstore
 copy lib\compressionregistry\*.h dist\include\lib\compressionregistry
 copy lib\concurrentchunkwrite\*.h dist\include\lib\concurrentchunkwrite
+copy lib\directorycache\*.h dist\include\lib\directorycache
+copy lib\deltablockstore\*.h dist\include\lib\deltablockstore
 copy lib\filestorage\*.h dist\include\lib\filestorage
 copy lib\fsblockstore\*.h dist\include\lib\fsblockstore
 copy lib\hpcdcchunker\*.h dist\include\lib\hpcdcchunker
@@ -69,4 +75,6 @@ copy lib\memtracer\*.h dist\include\lib\memtracer
 copy lib\meowhash\*.h dist\include\lib\meowhash
 copy lib\shareblockstore\*.h dist\include\lib\shareblockstore
 copy lib\ratelimitedprogress\*.h dist\include\lib\ratelimitedprogress
+copy lib\readaheadstorage\*.h dist\include\lib\readaheadstorage
+copy lib\xxh3\*.h dist\include\lib\xxh3
 copy lib\zstd\*.h dist\include\lib\zstd
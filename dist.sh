@@ -38,6 +38,8 @@ mkdir dist/include/lib/cacheblockstore
 mkdir dist/include/lib/compressblockstore
 mkdir dist/include/lib/compressionregistry
 mkdir dist/include/lib/concurrentchunkwrite
+mkdir dist/include/lib/directorycache
+mkdir dist/include/lib/deltablockstore
 mkdir dist/include/lib/filestorage
 mkdir dist/include/lib/fsblockstore
 mkdir dist/include/lib/hpcdcchunker
@@ -48,7 +50,9 @@ mkdir dist/include/lib/memstorage
 mkdir dist/include/lib/memtracer
 mkdir dist/include/lib/meowhash
 mkdir dist/include/lib/ratelimitedprogress
+mkdir dist/include/lib/readaheadstorage
 mkdir dist/include/lib/shareblockstore
+mkdir dist/include/lib/xxh3
 mkdir dist/include/lib/zstd
 cp src/*.h dist/include/src
 cp lib/archiveblockstore/*.h dist/include/lib/archiveblockstore
@@ -62,6 +66,8 @@ cp lib/cacheblockstore/*.h dist/include/lib/cacheblockstore
 cp lib/compressblockstore/*.h dist/include/lib/compressblockstore
 cp lib/compressionregistry/*.h dist/include/lib/compressionregistry
 cp lib/concurrentchunkwrite/*.h dist/include/lib/concurrentchunkwrite
+cp lib/directorycache/*.h dist/include/lib/directorycache
+cp lib/deltablockstore/*.h dist/include/lib/deltablockstore
 cp lib/filestorage/*.h dist/include/lib/filestorage
 cp lib/fsblockstore/*.h dist/include/lib/fsblockstore
 cp lib/hpcdcchunker/*.h dist/include/lib/hpcdcchunker
@@ -72,5 +78,7 @@ cp lib/memstorage/*.h dist/include/lib/memstorage
 cp lib/memtracer/*.h dist/include/lib/memtracer
 cp lib/meowhash/*.h dist/include/lib/meowhash
 cp lib/ratelimitedprogress/*.h dist/include/lib/ratelimitedprogress
+cp lib/readaheadstorage/*.h dist/include/lib/readaheadstorage
 cp lib/shareblockstore/*.h dist/include/lib/shareblockstore
+cp lib/xxh3/*.h dist/include/lib/xxh3
 cp lib/zstd/*.h dist/include/lib/zstd
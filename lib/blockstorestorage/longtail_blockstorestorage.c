@@ -1,5 +1,7 @@
 #include "longtail_blockstorestorage.h"
 
+#include "../longtail_platform.h"
+
 #if defined(__GNUC__) && !defined(__clang__) && !defined(APPLE) && !defined(__USE_GNU)
 #define __USE_GNU
 #endif
@@ -218,35 +220,92 @@ struct BlockStoreStorageAPI
     struct Longtail_VersionIndex* m_VersionIndex;
     struct Longtail_LookupTable* m_ChunkHashToBlockIndexLookup;
     struct BlockStoreStorageAPI_PathLookup* m_PathLookup;
-    uint64_t* m_ChunkAssetOffsets;
+};
+
+// Number of blocks kept per open file, covers the blocks of the current read plus read ahead
+#define BLOCKSTORESTORAGEAPI_BLOCK_CACHE_SIZE       8
+// Number of blocks fetched ahead of a read when the file is read sequentially
+#define BLOCKSTORESTORAGEAPI_READ_AHEAD_BLOCK_COUNT 2
+
+enum
+{
+    BlockStoreStorageAPI_CachedBlockState_Empty = 0,
+    BlockStoreStorageAPI_CachedBlockState_Pending = 1,
+    BlockStoreStorageAPI_CachedBlockState_Ready = 2
+};
+
+struct BlockStoreStorageAPI_OpenFile;
+
+struct BlockStoreStorageAPI_CachedBlock
+{
+    struct Longtail_AsyncGetStoredBlockAPI m_AsyncCompleteAPI;
+    struct BlockStoreStorageAPI_OpenFile* m_BlockStoreFile;
+    struct Longtail_StoredBlock* m_StoredBlock;
+    struct Longtail_LookupTable* m_ChunkOffsetLookup;
+    uint64_t m_LastUse;
+    uint32_t m_BlockIndex;
+    int m_Error;
+    TLongtail_Atomic32 m_State;
 };
 
 struct BlockStoreStorageAPI_OpenFile
 {
+    struct Longtail_ScratchArena* m_ScratchArena;
+    HLongtail_Sema m_ReadAheadCompleteSema;
+    // Binary semaphore held for the whole of a read, the seek position, block cache and scratch arena are per file
+    // and a file may be read from several threads at once (such as by FUSE)
+    HLongtail_Sema m_ReadLockSema;
+    uint64_t* m_ChunkAssetOffsets;
+    uint32_t* m_ChunkBlockIndexes;
+    uint64_t m_UseCounter;
+    uint64_t m_SequentialReadPos;
+    uint32_t m_ReadAheadIssuedCount;
+    uint32_t m_ReadAheadCompletedCount;
     uint32_t m_AssetIndex;
+    uint32_t m_ChunkCount;
     uint32_t m_SeekChunkOffset;
     uint64_t m_SeekAssetPos;
+    struct BlockStoreStorageAPI_CachedBlock m_CachedBlocks[BLOCKSTORESTORAGEAPI_BLOCK_CACHE_SIZE];
 };
 
 struct BlockStoreStorageAPI_ChunkRange
 {
-    TLongtail_Hash m_BlockHash;
     uint64_t m_AssetStartOffset;
+    uint32_t m_BlockIndex;
     uint32_t m_ChunkStart;
     uint32_t m_ChunkEnd;
 };
 
-struct BlockStoreStorageAPI_BlockRange
+static struct Longtail_LookupTable* BlockStoreStorageAPI_CreateChunkOffsetLookup(const struct Longtail_StoredBlock* stored_block)
 {
-    TLongtail_Hash key;
-    struct BlockStoreStorageAPI_ChunkRange value;
-};
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(stored_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    uint32_t chunk_count = *stored_block->m_BlockIndex->m_ChunkCount;
+    void* mem = Longtail_Alloc("BlockStoreStorageAPI", LongtailPrivate_LookupTable_GetSize(chunk_count));
+    if (mem == 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return 0;
+    }
+    struct Longtail_LookupTable* chunk_offset_lookup = LongtailPrivate_LookupTable_Create(mem, chunk_count, 0);
+    const TLongtail_Hash* block_chunk_hashes = stored_block->m_BlockIndex->m_ChunkHashes;
+    const uint32_t* block_chunk_sizes = stored_block->m_BlockIndex->m_ChunkSizes;
+    uint32_t chunk_block_offset = 0;
+    for (uint32_t c = 0; c < chunk_count; ++c)
+    {
+        LongtailPrivate_LookupTable_Put(chunk_offset_lookup, block_chunk_hashes[c], chunk_block_offset);
+        chunk_block_offset += block_chunk_sizes[c];
+    }
+    return chunk_offset_lookup;
+}
 
 static int BlockStoreStorageAPI_ReadFromBlock(
     struct Longtail_StoredBlock* stored_block,
+    const struct Longtail_LookupTable* chunk_offset_lookup,
     struct BlockStoreStorageAPI_ChunkRange* range,
     struct BlockStoreStorageAPI* block_store_fs,
-    struct BlockStoreStorageAPI_OpenFile* block_store_file,
     uint64_t start,
     uint64_t size,
     char* buffer,
@@ -254,9 +313,9 @@ static int BlockStoreStorageAPI_ReadFromBlock(
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(chunk_offset_lookup, "%p"),
         LONGTAIL_LOGFIELD(range, "%p"),
         LONGTAIL_LOGFIELD(block_store_fs, "%p"),
-        LONGTAIL_LOGFIELD(block_store_file, "%p"),
         LONGTAIL_LOGFIELD(start, "%" PRIu64),
         LONGTAIL_LOGFIELD(size, "%" PRIu64),
         LONGTAIL_LOGFIELD(buffer, "%p"),
@@ -264,24 +323,6 @@ static int BlockStoreStorageAPI_ReadFromBlock(
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 
     uint64_t read_end = start + size;
-    uint32_t chunk_block_offset = 0;
-    uint32_t chunk_count = *stored_block->m_BlockIndex->m_ChunkCount;
-    size_t block_chunk_lookup_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
-    void* work_mem = Longtail_Alloc("BlockStoreStorageAPI", block_chunk_lookup_size);
-    if (work_mem == 0)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return ENOMEM;
-    }
-    const TLongtail_Hash* block_chunk_hashes = stored_block->m_BlockIndex->m_ChunkHashes;
-    const uint32_t* block_chunk_sizes = stored_block->m_BlockIndex->m_ChunkSizes;
-    struct Longtail_LookupTable* block_chunk_lookup = LongtailPrivate_LookupTable_Create(work_mem, chunk_count, 0);
-    for (uint32_t c = 0; c < chunk_count; ++c)
-    {
-        TLongtail_Hash chunk_hash = block_chunk_hashes[c];
-        LongtailPrivate_LookupTable_Put(block_chunk_lookup, chunk_hash, chunk_block_offset);
-        chunk_block_offset += block_chunk_sizes[c];
-    }
     uint64_t asset_offset = range->m_AssetStartOffset;
     const char* block_data = (char*)stored_block->m_BlockData;
     const TLongtail_Hash* version_chunk_hashes = block_store_fs->m_VersionIndex->m_ChunkHashes;
@@ -294,7 +335,7 @@ static int BlockStoreStorageAPI_ReadFromBlock(
         uint64_t asset_offset_chunk_end = asset_offset + chunk_size;
         LONGTAIL_FATAL_ASSERT(ctx, asset_offset_chunk_end >= start, return EINVAL)
 
-        uint32_t* chunk_block_offset_ptr = LongtailPrivate_LookupTable_Get(block_chunk_lookup, chunk_hash);
+        uint32_t* chunk_block_offset_ptr = LongtailPrivate_LookupTable_Get(chunk_offset_lookup, chunk_hash);
         if (chunk_block_offset_ptr == 0)
         {
             asset_offset += chunk_size;
@@ -317,10 +358,162 @@ static int BlockStoreStorageAPI_ReadFromBlock(
         memcpy(&buffer[asset_offset - start], &block_data[chunk_block_offset + chunk_offset], read_length);
         asset_offset += read_length;
     }
-    Longtail_Free(work_mem);
     return 0;
 }
 
+static void BlockStoreStorageAPI_ClearCachedBlock(struct BlockStoreStorageAPI_CachedBlock* cached_block)
+{
+    SAFE_DISPOSE_STORED_BLOCK(cached_block->m_StoredBlock);
+    if (cached_block->m_ChunkOffsetLookup)
+    {
+        Longtail_Free(cached_block->m_ChunkOffsetLookup);
+        cached_block->m_ChunkOffsetLookup = 0;
+    }
+    cached_block->m_Error = 0;
+    cached_block->m_State = BlockStoreStorageAPI_CachedBlockState_Empty;
+}
+
+static struct BlockStoreStorageAPI_CachedBlock* BlockStoreStorageAPI_FindCachedBlock(
+    struct BlockStoreStorageAPI_OpenFile* block_store_file,
+    uint32_t block_index)
+{
+    // Only the thread reading from the file moves a block in or out of the empty state
+    for (uint32_t b = 0; b < BLOCKSTORESTORAGEAPI_BLOCK_CACHE_SIZE; ++b)
+    {
+        struct BlockStoreStorageAPI_CachedBlock* cached_block = &block_store_file->m_CachedBlocks[b];
+        if (cached_block->m_State != BlockStoreStorageAPI_CachedBlockState_Empty && cached_block->m_BlockIndex == block_index)
+        {
+            return cached_block;
+        }
+    }
+    return 0;
+}
+
+static struct BlockStoreStorageAPI_CachedBlock* BlockStoreStorageAPI_EvictCachedBlock(
+    struct BlockStoreStorageAPI_OpenFile* block_store_file)
+{
+    struct BlockStoreStorageAPI_CachedBlock* evict_block = 0;
+    for (uint32_t b = 0; b < BLOCKSTORESTORAGEAPI_BLOCK_CACHE_SIZE; ++b)
+    {
+        struct BlockStoreStorageAPI_CachedBlock* cached_block = &block_store_file->m_CachedBlocks[b];
+        int32_t state = Longtail_AtomicAdd32(&cached_block->m_State, 0);
+        if (state == BlockStoreStorageAPI_CachedBlockState_Empty)
+        {
+            return cached_block;
+        }
+        if (state == BlockStoreStorageAPI_CachedBlockState_Pending)
+        {
+            continue;
+        }
+        if (cached_block->m_LastUse == block_store_file->m_UseCounter)
+        {
+            // Used by the current read
+            continue;
+        }
+        if (evict_block == 0 || cached_block->m_LastUse < evict_block->m_LastUse)
+        {
+            evict_block = cached_block;
+        }
+    }
+    if (evict_block)
+    {
+        BlockStoreStorageAPI_ClearCachedBlock(evict_block);
+    }
+    return evict_block;
+}
+
+static void BlockStoreStorageAPI_WaitForCachedBlock(
+    struct BlockStoreStorageAPI_OpenFile* block_store_file,
+    struct BlockStoreStorageAPI_CachedBlock* cached_block)
+{
+    // Each completed read ahead posts the semaphore once, we count the posts we consume so
+    // closing the file can wait for the read aheads that nobody waited for
+    while (Longtail_AtomicAdd32(&cached_block->m_State, 0) == BlockStoreStorageAPI_CachedBlockState_Pending)
+    {
+        Longtail_WaitSema(block_store_file->m_ReadAheadCompleteSema, LONGTAIL_TIMEOUT_INFINITE);
+        ++block_store_file->m_ReadAheadCompletedCount;
+    }
+}
+
+static void BlockStoreStorageAPI_ReadAhead_OnComplete(struct Longtail_AsyncGetStoredBlockAPI* async_complete_api, struct Longtail_StoredBlock* stored_block, int err)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(err, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    struct BlockStoreStorageAPI_CachedBlock* cached_block = (struct BlockStoreStorageAPI_CachedBlock*)async_complete_api;
+    HLongtail_Sema read_ahead_complete_sema = cached_block->m_BlockStoreFile->m_ReadAheadCompleteSema;
+    if (err == 0)
+    {
+        err = Longtail_ValidateStoredBlockData(stored_block);
+        if (err)
+        {
+            SAFE_DISPOSE_STORED_BLOCK(stored_block);
+        }
+    }
+    if (err)
+    {
+        // Not fatal, the block is fetched again if it is read
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "Read ahead of block failed with %d", err)
+    }
+    cached_block->m_StoredBlock = stored_block;
+    cached_block->m_Error = err;
+    Longtail_AtomicAdd32(&cached_block->m_State, BlockStoreStorageAPI_CachedBlockState_Ready - BlockStoreStorageAPI_CachedBlockState_Pending);
+    Longtail_PostSema(read_ahead_complete_sema, 1);
+}
+
+static void BlockStoreStorageAPI_ReadAhead(
+    struct BlockStoreStorageAPI* block_store_fs,
+    struct BlockStoreStorageAPI_OpenFile* block_store_file,
+    uint32_t chunk_offset)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_fs, "%p"),
+        LONGTAIL_LOGFIELD(block_store_file, "%p"),
+        LONGTAIL_LOGFIELD(chunk_offset, "%u")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    const TLongtail_Hash* block_hashes = block_store_fs->m_StoreIndex->m_BlockHashes;
+    uint32_t read_ahead_count = 0;
+    uint32_t last_block_index = 0xffffffffu;
+    for (uint32_t c = chunk_offset; c < block_store_file->m_ChunkCount && read_ahead_count < BLOCKSTORESTORAGEAPI_READ_AHEAD_BLOCK_COUNT; ++c)
+    {
+        uint32_t block_index = block_store_file->m_ChunkBlockIndexes[c];
+        if (block_index == last_block_index)
+        {
+            continue;
+        }
+        last_block_index = block_index;
+        // Blocks that are already cached count towards the read ahead window so we never reach further
+        // ahead than BLOCKSTORESTORAGEAPI_READ_AHEAD_BLOCK_COUNT blocks
+        ++read_ahead_count;
+        if (BlockStoreStorageAPI_FindCachedBlock(block_store_file, block_index))
+        {
+            continue;
+        }
+        struct BlockStoreStorageAPI_CachedBlock* cached_block = BlockStoreStorageAPI_EvictCachedBlock(block_store_file);
+        if (cached_block == 0)
+        {
+            return;
+        }
+        cached_block->m_AsyncCompleteAPI.OnComplete = BlockStoreStorageAPI_ReadAhead_OnComplete;
+        cached_block->m_BlockIndex = block_index;
+        cached_block->m_LastUse = block_store_file->m_UseCounter;
+        cached_block->m_State = BlockStoreStorageAPI_CachedBlockState_Pending;
+        ++block_store_file->m_ReadAheadIssuedCount;
+        int err = block_store_fs->m_BlockStore->GetStoredBlock(block_store_fs->m_BlockStore, block_hashes[block_index], &cached_block->m_AsyncCompleteAPI);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "block_store_fs->m_BlockStore->GetStoredBlock() failed with %d", err)
+            --block_store_file->m_ReadAheadIssuedCount;
+            cached_block->m_State = BlockStoreStorageAPI_CachedBlockState_Empty;
+            return;
+        }
+    }
+}
+
 struct BlockStoreStorageAPI_ReadFromBlockJobData;
 
 struct BlockStoreStorageAPI_ReadBlock_OnCompleteAPI
@@ -336,12 +529,14 @@ struct BlockStoreStorageAPI_ReadFromBlockJobData
 	struct BlockStoreStorageAPI_ReadBlock_OnCompleteAPI m_OnReadBlockCompleteAPI;
     struct BlockStoreStorageAPI_ChunkRange* m_Range;
     struct BlockStoreStorageAPI* m_BlockStoreFS;
-    struct BlockStoreStorageAPI_OpenFile* m_BlockStoreFile;
     uint64_t m_Start;
     uint64_t m_Size;
     char* m_Buffer;
     const uint32_t* m_ChunkIndexes;
     struct Longtail_StoredBlock* m_StoredBlock;
+    struct Longtail_LookupTable* m_ChunkOffsetLookup;
+    uint32_t m_FirstBlockChunk;
+    uint32_t m_BlockChunkCount;     // Zero to fetch the whole block
     int m_BlockReadError;
 };
 
@@ -355,6 +550,15 @@ static void BlockStoreStorageAPI_ReadBlock_OnComplete(struct Longtail_AsyncGetSt
 
     struct BlockStoreStorageAPI_ReadBlock_OnCompleteAPI* cb = (struct BlockStoreStorageAPI_ReadBlock_OnCompleteAPI*)async_complete_api;
     struct Longtail_JobAPI* job_api = cb->m_Data->m_BlockStoreFS->m_JobAPI;
+    if (err == 0)
+    {
+        // Reject blocks that are still encoded by a block store layer that is missing from the block store
+        err = Longtail_ValidateStoredBlockData(stored_block);
+        if (err)
+        {
+            SAFE_DISPOSE_STORED_BLOCK(stored_block);
+        }
+    }
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BlockStoreStorageAPI_ReadBlock_OnComplete() caller failed with %d", err)
@@ -393,7 +597,27 @@ static int BlockStoreStorageAPI_ReadFromBlockJob(void* context, uint32_t job_id,
         complete_cb->m_JobID = job_id;
         complete_cb->m_Data = data;
 
-        int err = data->m_BlockStoreFS->m_BlockStore->GetStoredBlock(data->m_BlockStoreFS->m_BlockStore, data->m_Range->m_BlockHash, &complete_cb->m_API);
+        TLongtail_Hash block_hash = data->m_BlockStoreFS->m_StoreIndex->m_BlockHashes[data->m_Range->m_BlockIndex];
+        if (data->m_BlockChunkCount > 0)
+        {
+            int err = Longtail_BlockStore_GetStoredBlockChunkRange(
+                data->m_BlockStoreFS->m_BlockStore,
+                block_hash,
+                data->m_FirstBlockChunk,
+                data->m_BlockChunkCount,
+                &complete_cb->m_API);
+            if (err == 0)
+            {
+                return EBUSY;
+            }
+            if (err != ENOTSUP)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_BlockStore_GetStoredBlockChunkRange() failed with %d", err)
+                return err;
+            }
+            data->m_BlockChunkCount = 0;
+        }
+        int err = data->m_BlockStoreFS->m_BlockStore->GetStoredBlock(data->m_BlockStoreFS->m_BlockStore, block_hash, &complete_cb->m_API);
         if (err)
         {
             LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "data->m_BlockStoreFS->m_BlockStore->GetStoredBlock() failed with %d",
@@ -403,11 +627,20 @@ static int BlockStoreStorageAPI_ReadFromBlockJob(void* context, uint32_t job_id,
         return EBUSY;
     }
 
+    // The stored block and its chunk offset lookup are handed over to the block cache of the open file when the read completes
+    data->m_ChunkOffsetLookup = BlockStoreStorageAPI_CreateChunkOffsetLookup(data->m_StoredBlock);
+    if (!data->m_ChunkOffsetLookup)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BlockStoreStorageAPI_CreateChunkOffsetLookup() failed with %d", ENOMEM)
+        SAFE_DISPOSE_STORED_BLOCK(data->m_StoredBlock);
+        return ENOMEM;
+    }
+
     int err = BlockStoreStorageAPI_ReadFromBlock(
         data->m_StoredBlock,
+        data->m_ChunkOffsetLookup,
         data->m_Range,
         data->m_BlockStoreFS,
-        data->m_BlockStoreFile,
         data->m_Start,
         data->m_Size,
         data->m_Buffer,
@@ -416,7 +649,6 @@ static int BlockStoreStorageAPI_ReadFromBlockJob(void* context, uint32_t job_id,
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BlockStoreStorageAPI_ReadFromBlock() failed with %d", err)
     }
-    SAFE_DISPOSE_STORED_BLOCK(data->m_StoredBlock);
     return err;
 }
 
@@ -462,15 +694,13 @@ static int BlockStoreStorageAPI_SeekFile(
     {
         return 0;
     }
-    uint32_t asset_index = block_store_file->m_AssetIndex;
-    uint32_t chunk_count = block_store_fs->m_VersionIndex->m_AssetChunkCounts[asset_index];
+    uint32_t chunk_count = block_store_file->m_ChunkCount;
     if (chunk_count == 0)
     {
         return pos == 0 ? 0 : EIO;
     }
-    uint32_t chunk_start_index = block_store_fs->m_VersionIndex->m_AssetChunkIndexStarts[asset_index];
 
-    const uint64_t* chunk_asset_offsets = &block_store_fs->m_ChunkAssetOffsets[chunk_start_index];
+    const uint64_t* chunk_asset_offsets = block_store_file->m_ChunkAssetOffsets;
     if (block_store_file->m_SeekChunkOffset < chunk_count)
     {
         if (pos >= chunk_asset_offsets[block_store_file->m_SeekChunkOffset])
@@ -487,10 +717,6 @@ static int BlockStoreStorageAPI_SeekFile(
         }
     }
 
-    const uint32_t* chunk_indexes = &block_store_fs->m_VersionIndex->m_AssetChunkIndexes[chunk_start_index];
-
-    uint64_t asset_size = block_store_fs->m_VersionIndex->m_AssetSizes[asset_index];
-
     uint32_t start_chunk_index = BlockStoreStorageAPI_FindStartChunk(chunk_asset_offsets, chunk_count, pos);
     uint64_t start_asset_offset = chunk_asset_offsets[start_chunk_index];
 
@@ -499,6 +725,79 @@ static int BlockStoreStorageAPI_SeekFile(
     return 0;
 }
 
+static void BlockStoreStorageAPI_DisposeJobBlocks(struct BlockStoreStorageAPI_ReadFromBlockJobData* job_datas, uint32_t job_count)
+{
+    for (uint32_t j = 0; j < job_count; ++j)
+    {
+        SAFE_DISPOSE_STORED_BLOCK(job_datas[j].m_StoredBlock);
+        if (job_datas[j].m_ChunkOffsetLookup)
+        {
+            Longtail_Free(job_datas[j].m_ChunkOffsetLookup);
+            job_datas[j].m_ChunkOffsetLookup = 0;
+        }
+    }
+}
+
+// Finds the chunks of the block of @p range that the read needs, the chunks outside of them do not have to be decompressed
+static int BlockStoreStorageAPI_GetBlockChunkRange(
+    struct BlockStoreStorageAPI* block_store_fs,
+    struct Longtail_ScratchArena* scratch_arena,
+    const struct BlockStoreStorageAPI_ChunkRange* range,
+    const uint32_t* chunk_indexes,
+    const uint32_t* chunk_block_indexes,
+    uint32_t* out_first_block_chunk,
+    uint32_t* out_block_chunk_count)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_fs, "%p"),
+        LONGTAIL_LOGFIELD(scratch_arena, "%p"),
+        LONGTAIL_LOGFIELD(range, "%p"),
+        LONGTAIL_LOGFIELD(chunk_indexes, "%p"),
+        LONGTAIL_LOGFIELD(chunk_block_indexes, "%p"),
+        LONGTAIL_LOGFIELD(out_first_block_chunk, "%p"),
+        LONGTAIL_LOGFIELD(out_block_chunk_count, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    const struct Longtail_StoreIndex* store_index = block_store_fs->m_StoreIndex;
+    const TLongtail_Hash* version_chunk_hashes = block_store_fs->m_VersionIndex->m_ChunkHashes;
+    uint32_t range_chunk_count = range->m_ChunkEnd - range->m_ChunkStart;
+    void* needed_chunks_mem = Longtail_ScratchArena_Alloc(scratch_arena, LongtailPrivate_LookupTable_GetSize(range_chunk_count));
+    if (!needed_chunks_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    struct Longtail_LookupTable* needed_chunks = LongtailPrivate_LookupTable_Create(needed_chunks_mem, range_chunk_count, 0);
+    for (uint32_t c = range->m_ChunkStart; c < range->m_ChunkEnd; ++c)
+    {
+        if (chunk_block_indexes[c] == range->m_BlockIndex)
+        {
+            LongtailPrivate_LookupTable_PutUnique(needed_chunks, version_chunk_hashes[chunk_indexes[c]], c);
+        }
+    }
+
+    uint32_t block_chunks_offset = store_index->m_BlockChunksOffsets[range->m_BlockIndex];
+    uint32_t block_chunk_count = store_index->m_BlockChunkCounts[range->m_BlockIndex];
+    uint32_t first_block_chunk = block_chunk_count;
+    uint32_t last_block_chunk = 0;
+    for (uint32_t b = 0; b < block_chunk_count; ++b)
+    {
+        if (LongtailPrivate_LookupTable_Get(needed_chunks, store_index->m_ChunkHashes[block_chunks_offset + b]))
+        {
+            first_block_chunk = first_block_chunk == block_chunk_count ? b : first_block_chunk;
+            last_block_chunk = b;
+        }
+    }
+    if (first_block_chunk == block_chunk_count)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Block %u does not hold the chunks of the read, failed with %d", range->m_BlockIndex, EBADF)
+        return EBADF;
+    }
+    *out_first_block_chunk = first_block_chunk;
+    *out_block_chunk_count = last_block_chunk - first_block_chunk + 1;
+    return 0;
+}
+
 static int BlockStoreStorageAPI_ReadFile(
     struct BlockStoreStorageAPI* block_store_fs,
     struct BlockStoreStorageAPI_OpenFile* block_store_file,
@@ -526,11 +825,11 @@ static int BlockStoreStorageAPI_ReadFile(
         return EIO;
     }
 
-    uint32_t chunk_count = version_index->m_AssetChunkCounts[asset_index];
+    uint32_t chunk_count = block_store_file->m_ChunkCount;
     uint32_t chunk_start_index = version_index->m_AssetChunkIndexStarts[asset_index];
     const uint32_t* chunk_indexes = &version_index->m_AssetChunkIndexes[chunk_start_index];
-    const TLongtail_Hash* chunk_hashes = version_index->m_ChunkHashes;
     const uint32_t* chunk_sizes = version_index->m_ChunkSizes;
+    const uint32_t* chunk_block_indexes = block_store_file->m_ChunkBlockIndexes;
 
     int err = BlockStoreStorageAPI_SeekFile(block_store_fs, block_store_file, start);
     if (err)
@@ -539,6 +838,10 @@ static int BlockStoreStorageAPI_ReadFile(
         return err;
     }
 
+    ++block_store_file->m_UseCounter;
+    int is_sequential_read = start == block_store_file->m_SequentialReadPos;
+    block_store_file->m_SequentialReadPos = read_end;
+
     uint32_t seek_chunk_offset = block_store_file->m_SeekChunkOffset;
     uint64_t seek_asset_pos = block_store_file->m_SeekAssetPos;
 
@@ -547,29 +850,34 @@ static int BlockStoreStorageAPI_ReadFile(
     uint32_t estimated_block_count = (uint32_t)(size / avg_chunk_size) + 2;
     estimated_block_count = estimated_block_count > max_block_count ? max_block_count : estimated_block_count;
 
+    // All temporary memory for the read comes from the scratch arena of the open file and is released in one go when the read completes
+    struct Longtail_ScratchArena* scratch_arena = block_store_file->m_ScratchArena;
     size_t block_range_map_size = LongtailPrivate_LookupTable_GetSize(estimated_block_count);
-    struct Longtail_LookupTable* block_range_map = LongtailPrivate_LookupTable_Create(Longtail_Alloc("BlockStoreStorageAPI", block_range_map_size), estimated_block_count, 0);
-    struct BlockStoreStorageAPI_ChunkRange* chunk_ranges = 0;
-    arrsetcap(chunk_ranges, estimated_block_count);
-    const TLongtail_Hash* block_hashes = block_store_fs->m_StoreIndex->m_BlockHashes;
+    void* block_range_map_mem = Longtail_ScratchArena_Alloc(scratch_arena, block_range_map_size);
+    struct BlockStoreStorageAPI_ChunkRange* chunk_ranges = (struct BlockStoreStorageAPI_ChunkRange*)Longtail_ScratchArena_Alloc(scratch_arena, sizeof(struct BlockStoreStorageAPI_ChunkRange) * estimated_block_count);
+    if (block_range_map_mem == 0 || chunk_ranges == 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_Alloc() failed with %d", ENOMEM)
+        Longtail_ScratchArena_ResetToMark(scratch_arena, 0);
+        return ENOMEM;
+    }
+    struct Longtail_LookupTable* block_range_map = LongtailPrivate_LookupTable_Create(block_range_map_mem, estimated_block_count, 0);
+    uint32_t block_count = 0;
 
-    for (uint32_t c = seek_chunk_offset; c < chunk_count; ++c)
+    uint32_t c = seek_chunk_offset;
+    for (; c < chunk_count; ++c)
     {
         uint32_t chunk_index = chunk_indexes[c];
-        TLongtail_Hash chunk_hash = chunk_hashes[chunk_index];
-        const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(block_store_fs->m_ChunkHashToBlockIndexLookup, chunk_hash);
-        LONGTAIL_FATAL_ASSERT(ctx, block_index_ptr, EINVAL)
-        uint32_t block_index = *block_index_ptr;
-        TLongtail_Hash block_hash = block_hashes[block_index];
-        uint32_t* chunk_range_index = LongtailPrivate_LookupTable_PutUnique(block_range_map, block_hash, (uint32_t)arrlen(chunk_ranges));
+        uint32_t block_index = chunk_block_indexes[c];
+        uint32_t* chunk_range_index = LongtailPrivate_LookupTable_PutUnique(block_range_map, block_index, block_count);
         if (chunk_range_index)
         {
             chunk_ranges[*chunk_range_index].m_ChunkEnd = c + 1;
         }
         else
         {
-            struct BlockStoreStorageAPI_ChunkRange range = {block_hash, seek_asset_pos, c, c + 1};
-            arrput(chunk_ranges, range);
+            struct BlockStoreStorageAPI_ChunkRange range = {seek_asset_pos, block_index, c, c + 1};
+            chunk_ranges[block_count++] = range;
         }
         block_store_file->m_SeekChunkOffset = c;
         block_store_file->m_SeekAssetPos = seek_asset_pos;
@@ -585,83 +893,192 @@ static int BlockStoreStorageAPI_ReadFile(
             uint64_t new_capacity = ((size_t)estimated_block_count) + (estimated_block_count >> 2) + 2;
             estimated_block_count = new_capacity > max_block_count ? max_block_count : (uint32_t)new_capacity;
             block_range_map_size = LongtailPrivate_LookupTable_GetSize(estimated_block_count);
-            struct Longtail_LookupTable* new_block_range_map = LongtailPrivate_LookupTable_Create(Longtail_Alloc("BlockStoreStorageAPI", block_range_map_size), estimated_block_count, block_range_map);
-            Longtail_Free(block_range_map);
-            block_range_map = new_block_range_map;
+            void* new_block_range_map_mem = Longtail_ScratchArena_Alloc(scratch_arena, block_range_map_size);
+            struct BlockStoreStorageAPI_ChunkRange* new_chunk_ranges = (struct BlockStoreStorageAPI_ChunkRange*)Longtail_ScratchArena_Alloc(scratch_arena, sizeof(struct BlockStoreStorageAPI_ChunkRange) * estimated_block_count);
+            if (new_block_range_map_mem == 0 || new_chunk_ranges == 0)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_Alloc() failed with %d", ENOMEM)
+                Longtail_ScratchArena_ResetToMark(scratch_arena, 0);
+                return ENOMEM;
+            }
+            block_range_map = LongtailPrivate_LookupTable_Create(new_block_range_map_mem, estimated_block_count, block_range_map);
+            memcpy(new_chunk_ranges, chunk_ranges, sizeof(struct BlockStoreStorageAPI_ChunkRange) * block_count);
+            chunk_ranges = new_chunk_ranges;
         }
     }
 
-    uint32_t block_count = (uint32_t)arrlen(chunk_ranges);
     LONGTAIL_FATAL_ASSERT(ctx, block_count > 0, return EINVAL);
 
-    struct Longtail_JobAPI* job_api = block_store_fs->m_JobAPI;
-
-	size_t work_mem_size = sizeof(struct BlockStoreStorageAPI_ReadFromBlockJobData) * block_count +
-		sizeof(Longtail_JobAPI_JobFunc) * block_count +
-		sizeof(void*) * block_count;
-	void* work_mem = Longtail_Alloc("BlockStoreStorageAPI", work_mem_size);
-	if (!work_mem)
-	{
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-		return ENOMEM;
-	}
-    struct BlockStoreStorageAPI_ReadFromBlockJobData* job_datas = (struct BlockStoreStorageAPI_ReadFromBlockJobData*)work_mem;
-    Longtail_JobAPI_JobFunc* funcs = (Longtail_JobAPI_JobFunc*)&job_datas[block_count];
-    void** ctxs = (void**)&funcs[block_count];
-
-    Longtail_JobAPI_Group job_group;
-    err = job_api->ReserveJobs(job_api, block_count, &job_group);
-    LONGTAIL_FATAL_ASSERT(ctx, err == 0, return err)
-
+    // Serve the ranges whose block is cached (or being read ahead) directly, collect the rest for fetching
+    struct BlockStoreStorageAPI_ChunkRange** fetch_ranges = (struct BlockStoreStorageAPI_ChunkRange**)Longtail_ScratchArena_Alloc(scratch_arena, sizeof(struct BlockStoreStorageAPI_ChunkRange*) * block_count);
+    if (!fetch_ranges)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_Alloc() failed with %d", ENOMEM)
+        Longtail_ScratchArena_ResetToMark(scratch_arena, 0);
+        return ENOMEM;
+    }
+    uint32_t fetch_count = 0;
     for (uint32_t b = 0; b < block_count; ++b)
     {
         struct BlockStoreStorageAPI_ChunkRange* range = &chunk_ranges[b];
-
-        job_datas[b].m_Range = range;
-        job_datas[b].m_BlockStoreFS = block_store_fs;
-        job_datas[b].m_BlockStoreFile = block_store_file;
-        job_datas[b].m_Start = start;
-        job_datas[b].m_Size = size;
-        job_datas[b].m_Buffer = buffer;
-        job_datas[b].m_ChunkIndexes = chunk_indexes;
-        job_datas[b].m_StoredBlock = 0;
-        job_datas[b].m_BlockReadError = 0;
-
-        funcs[b] = BlockStoreStorageAPI_ReadFromBlockJob;
-        ctxs[b] = &job_datas[b];
-    }
-    Longtail_JobAPI_Jobs jobs;
-    err = job_api->CreateJobs(job_api, job_group, 0, 0, 0, block_count, funcs, ctxs, 0, &jobs);
-    if (err)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job_api->CreateJobs() failed with %d", err)
-        Longtail_Free(work_mem);
-        Longtail_Free(block_range_map);
-        arrfree(chunk_ranges);
-        return err;
+        struct BlockStoreStorageAPI_CachedBlock* cached_block = BlockStoreStorageAPI_FindCachedBlock(block_store_file, range->m_BlockIndex);
+        if (cached_block)
+        {
+            BlockStoreStorageAPI_WaitForCachedBlock(block_store_file, cached_block);
+            if (cached_block->m_Error == 0 && cached_block->m_ChunkOffsetLookup == 0)
+            {
+                cached_block->m_ChunkOffsetLookup = BlockStoreStorageAPI_CreateChunkOffsetLookup(cached_block->m_StoredBlock);
+                cached_block->m_Error = cached_block->m_ChunkOffsetLookup ? 0 : ENOMEM;
+            }
+            if (cached_block->m_Error)
+            {
+                BlockStoreStorageAPI_ClearCachedBlock(cached_block);
+                cached_block = 0;
+            }
+        }
+        if (cached_block == 0)
+        {
+            fetch_ranges[fetch_count++] = range;
+            continue;
+        }
+        cached_block->m_LastUse = block_store_file->m_UseCounter;
+        err = BlockStoreStorageAPI_ReadFromBlock(
+            cached_block->m_StoredBlock,
+            cached_block->m_ChunkOffsetLookup,
+            range,
+            block_store_fs,
+            start,
+            size,
+            buffer,
+            chunk_indexes);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BlockStoreStorageAPI_ReadFromBlock() failed with %d", err)
+            Longtail_ScratchArena_ResetToMark(scratch_arena, 0);
+            return err;
+        }
     }
-    err = job_api->ReadyJobs(job_api, block_count, jobs);
-    if (err)
+
+    if (fetch_count > 0)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job_api->ReadyJobs() failed with %d", err)
-        Longtail_Free(work_mem);
-        Longtail_Free(block_range_map);
-        arrfree(chunk_ranges);
-        return err;
+        struct Longtail_JobAPI* job_api = block_store_fs->m_JobAPI;
+
+        size_t work_mem_size = sizeof(struct BlockStoreStorageAPI_ReadFromBlockJobData) * fetch_count +
+            sizeof(Longtail_JobAPI_JobFunc) * fetch_count +
+            sizeof(void*) * fetch_count;
+        void* work_mem = Longtail_ScratchArena_Alloc(scratch_arena, work_mem_size);
+        if (!work_mem)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_Alloc() failed with %d", ENOMEM)
+            Longtail_ScratchArena_ResetToMark(scratch_arena, 0);
+            return ENOMEM;
+        }
+        struct BlockStoreStorageAPI_ReadFromBlockJobData* job_datas = (struct BlockStoreStorageAPI_ReadFromBlockJobData*)work_mem;
+        Longtail_JobAPI_JobFunc* funcs = (Longtail_JobAPI_JobFunc*)&job_datas[fetch_count];
+        void** ctxs = (void**)&funcs[fetch_count];
+
+        for (uint32_t f = 0; f < fetch_count; ++f)
+        {
+            job_datas[f].m_Range = fetch_ranges[f];
+            job_datas[f].m_BlockStoreFS = block_store_fs;
+            job_datas[f].m_Start = start;
+            job_datas[f].m_Size = size;
+            job_datas[f].m_Buffer = buffer;
+            job_datas[f].m_ChunkIndexes = chunk_indexes;
+            job_datas[f].m_StoredBlock = 0;
+            job_datas[f].m_ChunkOffsetLookup = 0;
+            job_datas[f].m_FirstBlockChunk = 0;
+            job_datas[f].m_BlockChunkCount = 0;
+            job_datas[f].m_BlockReadError = 0;
+
+            // Random reads only decompress the chunks they need instead of caching the whole block
+            if (!is_sequential_read)
+            {
+                uint32_t first_block_chunk;
+                uint32_t block_chunk_count;
+                err = BlockStoreStorageAPI_GetBlockChunkRange(
+                    block_store_fs,
+                    scratch_arena,
+                    fetch_ranges[f],
+                    chunk_indexes,
+                    chunk_block_indexes,
+                    &first_block_chunk,
+                    &block_chunk_count);
+                if (err)
+                {
+                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BlockStoreStorageAPI_GetBlockChunkRange() failed with %d", err)
+                    Longtail_ScratchArena_ResetToMark(scratch_arena, 0);
+                    return err;
+                }
+                if (block_chunk_count < block_store_fs->m_StoreIndex->m_BlockChunkCounts[fetch_ranges[f]->m_BlockIndex])
+                {
+                    job_datas[f].m_FirstBlockChunk = first_block_chunk;
+                    job_datas[f].m_BlockChunkCount = block_chunk_count;
+                }
+            }
+
+            funcs[f] = BlockStoreStorageAPI_ReadFromBlockJob;
+            ctxs[f] = &job_datas[f];
+        }
+
+        Longtail_JobAPI_Group job_group;
+        err = job_api->ReserveJobs(job_api, fetch_count, &job_group);
+        LONGTAIL_FATAL_ASSERT(ctx, err == 0, return err)
+
+        Longtail_JobAPI_Jobs jobs;
+        err = job_api->CreateJobs(job_api, job_group, 0, 0, 0, fetch_count, funcs, ctxs, 0, &jobs);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job_api->CreateJobs() failed with %d", err)
+            Longtail_ScratchArena_ResetToMark(scratch_arena, 0);
+            return err;
+        }
+        err = job_api->ReadyJobs(job_api, fetch_count, jobs);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job_api->ReadyJobs() failed with %d", err)
+            Longtail_ScratchArena_ResetToMark(scratch_arena, 0);
+            return err;
+        }
+        err = job_api->WaitForAllJobs(job_api, job_group, 0, 0, 0);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_INFO : LONGTAIL_LOG_LEVEL_ERROR, "job_api->WaitForAllJobs() failed with %d", err)
+            BlockStoreStorageAPI_DisposeJobBlocks(job_datas, fetch_count);
+            Longtail_ScratchArena_ResetToMark(scratch_arena, 0);
+            return err;
+        }
+
+        for (uint32_t f = 0; f < fetch_count; ++f)
+        {
+            if (*job_datas[f].m_StoredBlock->m_BlockIndex->m_ChunkCount < block_store_fs->m_StoreIndex->m_BlockChunkCounts[job_datas[f].m_Range->m_BlockIndex])
+            {
+                // Only holds a part of the block, the cache must serve any chunk of a block
+                continue;
+            }
+            struct BlockStoreStorageAPI_CachedBlock* cached_block = BlockStoreStorageAPI_EvictCachedBlock(block_store_file);
+            if (cached_block == 0)
+            {
+                break;
+            }
+            cached_block->m_BlockIndex = job_datas[f].m_Range->m_BlockIndex;
+            cached_block->m_StoredBlock = job_datas[f].m_StoredBlock;
+            cached_block->m_ChunkOffsetLookup = job_datas[f].m_ChunkOffsetLookup;
+            cached_block->m_LastUse = block_store_file->m_UseCounter;
+            cached_block->m_Error = 0;
+            cached_block->m_State = BlockStoreStorageAPI_CachedBlockState_Ready;
+            job_datas[f].m_StoredBlock = 0;
+            job_datas[f].m_ChunkOffsetLookup = 0;
+        }
+        BlockStoreStorageAPI_DisposeJobBlocks(job_datas, fetch_count);
     }
-    err = job_api->WaitForAllJobs(job_api, job_group, 0, 0, 0);
-    if (err)
+    Longtail_ScratchArena_ResetToMark(scratch_arena, 0);
+
+    if (is_sequential_read)
     {
-        LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_INFO : LONGTAIL_LOG_LEVEL_ERROR, "job_api->WaitForAllJobs() failed with %d", err)
-        Longtail_Free(work_mem);
-        Longtail_Free(block_range_map);
-        arrfree(chunk_ranges);
-        return err;
+        BlockStoreStorageAPI_ReadAhead(block_store_fs, block_store_file, c + 1);
     }
-    Longtail_Free(work_mem);
-    Longtail_Free(block_range_map);
-    arrfree(chunk_ranges);
-    return err;
+    return 0;
 }
 
 static int BlockStoreStorageAPI_OpenReadFile(
@@ -696,10 +1113,83 @@ static int BlockStoreStorageAPI_OpenReadFile(
         return ENOENT;
     }
     uint32_t asset_index = block_store_fs->m_PathLookup->m_PathEntries[*path_entry_index].m_AssetIndex;
-    struct BlockStoreStorageAPI_OpenFile* block_store_file = (struct BlockStoreStorageAPI_OpenFile*)Longtail_Alloc("BlockStoreStorageAPI", sizeof(struct BlockStoreStorageAPI_OpenFile));
+    const struct Longtail_VersionIndex* version_index = block_store_fs->m_VersionIndex;
+    uint32_t chunk_count = version_index->m_AssetChunkCounts[asset_index];
+
+    size_t block_store_file_size = sizeof(struct BlockStoreStorageAPI_OpenFile) +
+        sizeof(uint64_t) * chunk_count +
+        Longtail_GetSemaSize() * 2 +
+        sizeof(uint32_t) * chunk_count;
+    struct BlockStoreStorageAPI_OpenFile* block_store_file = (struct BlockStoreStorageAPI_OpenFile*)Longtail_Alloc("BlockStoreStorageAPI", block_store_file_size);
+    if (!block_store_file)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    memset(block_store_file, 0, sizeof(struct BlockStoreStorageAPI_OpenFile));
+    char* p = (char*)&block_store_file[1];
+    block_store_file->m_ChunkAssetOffsets = (uint64_t*)p;
+    p += sizeof(uint64_t) * chunk_count;
+    err = Longtail_CreateSema(p, 0, &block_store_file->m_ReadAheadCompleteSema);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateSema() failed with %d", err)
+        Longtail_Free(block_store_file);
+        return err;
+    }
+    p += Longtail_GetSemaSize();
+    err = Longtail_CreateSema(p, 1, &block_store_file->m_ReadLockSema);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateSema() failed with %d", err)
+        Longtail_DeleteSema(block_store_file->m_ReadAheadCompleteSema);
+        Longtail_Free(block_store_file);
+        return err;
+    }
+    p += Longtail_GetSemaSize();
+    block_store_file->m_ChunkBlockIndexes = (uint32_t*)p;
+
+    block_store_file->m_ScratchArena = Longtail_CreateScratchArena(0);
+    if (!block_store_file->m_ScratchArena)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateScratchArena() failed with %d", ENOMEM)
+        Longtail_DeleteSema(block_store_file->m_ReadLockSema);
+        Longtail_DeleteSema(block_store_file->m_ReadAheadCompleteSema);
+        Longtail_Free(block_store_file);
+        return ENOMEM;
+    }
     block_store_file->m_AssetIndex = asset_index;
+    block_store_file->m_ChunkCount = chunk_count;
     block_store_file->m_SeekChunkOffset = 0;
     block_store_file->m_SeekAssetPos = 0;
+    block_store_file->m_SequentialReadPos = 0;
+    for (uint32_t b = 0; b < BLOCKSTORESTORAGEAPI_BLOCK_CACHE_SIZE; ++b)
+    {
+        block_store_file->m_CachedBlocks[b].m_BlockStoreFile = block_store_file;
+    }
+
+    // Resolve the asset offset and block of each chunk once so reads only need to walk the arrays
+    uint32_t chunk_start_index = version_index->m_AssetChunkIndexStarts[asset_index];
+    const uint32_t* chunk_indexes = &version_index->m_AssetChunkIndexes[chunk_start_index];
+    uint64_t offset = 0;
+    for (uint32_t c = 0; c < chunk_count; ++c)
+    {
+        uint32_t chunk_index = chunk_indexes[c];
+        const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(block_store_fs->m_ChunkHashToBlockIndexLookup, version_index->m_ChunkHashes[chunk_index]);
+        if (block_index_ptr == 0)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Chunk of asset is not present in store index, failed with %d", EINVAL)
+            Longtail_DisposeScratchArena(block_store_file->m_ScratchArena);
+            Longtail_DeleteSema(block_store_file->m_ReadLockSema);
+            Longtail_DeleteSema(block_store_file->m_ReadAheadCompleteSema);
+            Longtail_Free(block_store_file);
+            return EINVAL;
+        }
+        block_store_file->m_ChunkBlockIndexes[c] = *block_index_ptr;
+        block_store_file->m_ChunkAssetOffsets[c] = offset;
+        offset += version_index->m_ChunkSizes[chunk_index];
+    }
+
     *out_open_file = (Longtail_StorageAPI_HOpenFile)block_store_file;
     return 0;
 }
@@ -746,7 +1236,9 @@ static int BlockStoreStorageAPI_Read(
 
     struct BlockStoreStorageAPI* block_store_fs = (struct BlockStoreStorageAPI*)storage_api;
     struct BlockStoreStorageAPI_OpenFile* block_store_file = (struct BlockStoreStorageAPI_OpenFile*)f;
+    Longtail_WaitSema(block_store_file->m_ReadLockSema, LONGTAIL_TIMEOUT_INFINITE);
     int err = BlockStoreStorageAPI_ReadFile(block_store_fs, block_store_file, offset, length, output);
+    Longtail_PostSema(block_store_file->m_ReadLockSema, 1);
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BlockStoreStorageAPI_ReadFile() failed with %d", err)
@@ -817,6 +1309,27 @@ static int BlockStoreStorageAPI_Write(
     return ENOTSUP;
 }
 
+static int BlockStoreStorageAPI_WriteV(
+    struct Longtail_StorageAPI* storage_api,
+    Longtail_StorageAPI_HOpenFile f,
+    uint64_t offset,
+    uint32_t vec_count,
+    const struct Longtail_StorageAPI_IOVec* vecs)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(f, "%p"),
+        LONGTAIL_LOGFIELD(offset, "%" PRIu64),
+        LONGTAIL_LOGFIELD(vec_count, "%u"),
+        LONGTAIL_LOGFIELD(vecs, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, f != 0, return 0)
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Unsupported, failed with %d", ENOTSUP)
+    return ENOTSUP;
+}
+
 static int BlockStoreStorageAPI_SetSize(
     struct Longtail_StorageAPI* storage_api,
     Longtail_StorageAPI_HOpenFile f,
@@ -886,6 +1399,54 @@ static int BlockStoreStorageAPI_GetPermissions(
     return 0;
 }
 
+static int BlockStoreStorageAPI_GetFileStat(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    uint64_t* out_size,
+    uint64_t* out_modification_time,
+    uint64_t* out_change_time,
+    uint64_t* out_file_id)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(out_size, "%p"),
+        LONGTAIL_LOGFIELD(out_modification_time, "%p"),
+        LONGTAIL_LOGFIELD(out_change_time, "%p"),
+        LONGTAIL_LOGFIELD(out_file_id, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_size != 0, return 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_modification_time != 0, return 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_change_time != 0, return 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_file_id != 0, return 0)
+
+    struct BlockStoreStorageAPI* block_store_fs = (struct BlockStoreStorageAPI*)storage_api;
+    uint64_t path_hash = 0;
+    int err = LongtailPrivate_GetPathHash(block_store_fs->m_HashAPI, path, &path_hash);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_GetPathHash() failed with %d", err)
+        return err;
+    }
+
+    uint32_t* path_entry_index = LongtailPrivate_LookupTable_Get(block_store_fs->m_PathLookup->m_LookupTable, path_hash);
+    if (path_entry_index == 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "LongtailPrivate_LookupTable_Get() failed with %d", ENOENT)
+        return ENOENT;
+    }
+    // The content is the version index, it never changes
+    uint32_t asset_index = block_store_fs->m_PathLookup->m_PathEntries[*path_entry_index].m_AssetIndex;
+    *out_size = block_store_fs->m_VersionIndex->m_AssetSizes[asset_index];
+    *out_modification_time = 0;
+    *out_change_time = 0;
+    *out_file_id = ((uint64_t)asset_index) + 1;
+    return 0;
+}
+
 static void BlockStoreStorageAPI_CloseFile(
     struct Longtail_StorageAPI* storage_api,
     Longtail_StorageAPI_HOpenFile f)
@@ -900,6 +1461,18 @@ static void BlockStoreStorageAPI_CloseFile(
 
     struct BlockStoreStorageAPI* block_store_fs = (struct BlockStoreStorageAPI*)storage_api;
     struct BlockStoreStorageAPI_OpenFile* block_store_file = (struct BlockStoreStorageAPI_OpenFile*)f;
+    while (block_store_file->m_ReadAheadCompletedCount < block_store_file->m_ReadAheadIssuedCount)
+    {
+        Longtail_WaitSema(block_store_file->m_ReadAheadCompleteSema, LONGTAIL_TIMEOUT_INFINITE);
+        ++block_store_file->m_ReadAheadCompletedCount;
+    }
+    for (uint32_t b = 0; b < BLOCKSTORESTORAGEAPI_BLOCK_CACHE_SIZE; ++b)
+    {
+        BlockStoreStorageAPI_ClearCachedBlock(&block_store_file->m_CachedBlocks[b]);
+    }
+    Longtail_DeleteSema(block_store_file->m_ReadLockSema);
+    Longtail_DeleteSema(block_store_file->m_ReadAheadCompleteSema);
+    Longtail_DisposeScratchArena(block_store_file->m_ScratchArena);
     Longtail_Free(block_store_file);
 }
 
@@ -1427,12 +2000,13 @@ static int BlockStoreStorageAPI_Init(
         BlockStoreStorageAPI_GetParentPath,
         BlockStoreStorageAPI_MapFile,
         BlockStoreStorageAPI_UnmapFile,
-        BlockStoreStorageAPI_OpenAppendFile);
+        BlockStoreStorageAPI_OpenAppendFile,
+        BlockStoreStorageAPI_WriteV,
+        BlockStoreStorageAPI_GetFileStat);
 
     struct BlockStoreStorageAPI* block_store_fs = (struct BlockStoreStorageAPI*)api;
 
     uint64_t store_index_chunk_count = *store_index->m_ChunkCount;
-    uint32_t version_index_asset_count = *version_index->m_AssetCount;
 
     block_store_fs->m_HashAPI = hash_api;
     block_store_fs->m_JobAPI = job_api;
@@ -1444,8 +2018,6 @@ static int BlockStoreStorageAPI_Init(
     block_store_fs->m_ChunkHashToBlockIndexLookup = LongtailPrivate_LookupTable_Create(p, (uint32_t)store_index_chunk_count, 0);
     p += LongtailPrivate_LookupTable_GetSize((uint32_t)store_index_chunk_count);
     block_store_fs->m_PathLookup = BlockStoreStorageAPI_CreatePathLookup(p, hash_api, version_index);
-    p += GetPathEntriesSize(version_index_asset_count);
-    block_store_fs->m_ChunkAssetOffsets = (uint64_t*)p;
 
     const TLongtail_Hash* stire_index_chunk_hashes = store_index->m_ChunkHashes;
     uint32_t block_count = *store_index->m_BlockCount;
@@ -1461,30 +2033,6 @@ static int BlockStoreStorageAPI_Init(
         }
     }
 
-    const uint32_t* asset_chunk_index_starts = block_store_fs->m_VersionIndex->m_AssetChunkIndexStarts;
-    const uint32_t* asset_chunk_indexes = block_store_fs->m_VersionIndex->m_AssetChunkIndexes;
-    const uint32_t* version_chunk_sizes = block_store_fs->m_VersionIndex->m_ChunkSizes;
-    uint64_t* version_chunk_asset_offsets = block_store_fs->m_ChunkAssetOffsets;
-    for (uint32_t a = 0; a < version_index_asset_count; ++a)
-    {
-        uint32_t version_chunk_count = block_store_fs->m_VersionIndex->m_AssetChunkCounts[a];
-        if (version_chunk_count == 0)
-        {
-            continue;
-        }
-        uint32_t chunk_start_index = asset_chunk_index_starts[a];
-        const uint32_t* chunk_indexes = &asset_chunk_indexes[chunk_start_index];
-        uint64_t* chunk_asset_offsets = &version_chunk_asset_offsets[chunk_start_index];
-        uint64_t offset = 0;
-        for (uint32_t c = 0; c < version_chunk_count; ++c)
-        {
-            uint32_t chunk_index = chunk_indexes[c];
-            uint32_t chunk_size = version_chunk_sizes[chunk_index];
-            chunk_asset_offsets[c] = offset;
-            offset += chunk_size;
-        }
-    }
-
     *out_storage_api = &block_store_fs->m_API;
     return 0;
 }
@@ -1512,8 +2060,7 @@ struct Longtail_StorageAPI* Longtail_CreateBlockStoreStorageAPI(
 
     size_t api_size = sizeof(struct BlockStoreStorageAPI) + 
         LongtailPrivate_LookupTable_GetSize((uint32_t)*store_index->m_ChunkCount) +
-        GetPathEntriesSize(*version_index->m_AssetCount) +
-        sizeof(uint64_t) * (*version_index->m_AssetChunkIndexCount);
+        GetPathEntriesSize(*version_index->m_AssetCount);
     void* mem = Longtail_Alloc("BlockStoreStorageAPI", api_size);
     if (!mem)
     {
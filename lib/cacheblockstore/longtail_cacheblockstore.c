@@ -622,24 +622,31 @@ static void OnGetStoredBlockGetLocalComplete(struct Longtail_AsyncGetStoredBlock
     CacheBlockStore_CompleteRequest(cacheblockstore_api);
 }
 
-static int CacheBlockStore_GetStoredBlock(
+// Reads the block from the local store into buffer if one is given, or only the chunk range if chunk_count is non-zero.
+// Blocks fetched from the remote store are whole and returned in their own allocation
+static int CacheBlockStore_GetBlock(
     struct Longtail_BlockStoreAPI* block_store_api,
     uint64_t block_hash,
+    void* buffer,
+    uint32_t buffer_size,
+    uint32_t first_chunk_index,
+    uint32_t chunk_count,
     struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
 {
 #if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(block_store_api, "%p"),
         LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(buffer_size, "%u"),
+        LONGTAIL_LOGFIELD(first_chunk_index, "%u"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u"),
         LONGTAIL_LOGFIELD(async_complete_api, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 #else
     struct Longtail_LogContextFmt_Private* ctx = 0;
 #endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
-
     struct CacheBlockStoreAPI* cacheblockstore_api = (struct CacheBlockStoreAPI*)block_store_api;
 
     Longtail_AtomicAdd64(&cacheblockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count], 1);
@@ -658,7 +665,12 @@ static int CacheBlockStore_GetStoredBlock(
     on_get_stored_block_get_local_complete_api->block_hash = block_hash;
     on_get_stored_block_get_local_complete_api->async_complete_api = async_complete_api;
     Longtail_AtomicAdd32(&cacheblockstore_api->m_PendingRequestCount, 1);
-    int err = cacheblockstore_api->m_LocalBlockStoreAPI->GetStoredBlock(cacheblockstore_api->m_LocalBlockStoreAPI, block_hash, &on_get_stored_block_get_local_complete_api->m_API);
+    struct Longtail_BlockStoreAPI* local_block_store_api = cacheblockstore_api->m_LocalBlockStoreAPI;
+    int err = buffer ?
+        local_block_store_api->GetStoredBlockToBuffer(local_block_store_api, block_hash, buffer, buffer_size, &on_get_stored_block_get_local_complete_api->m_API) :
+        chunk_count ?
+        local_block_store_api->GetStoredBlockChunkRange(local_block_store_api, block_hash, first_chunk_index, chunk_count, &on_get_stored_block_get_local_complete_api->m_API) :
+        local_block_store_api->GetStoredBlock(local_block_store_api, block_hash, &on_get_stored_block_get_local_complete_api->m_API);
     if (err)
     {
         Longtail_AtomicAdd64(&cacheblockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_FailCount], 1);
@@ -668,6 +680,76 @@ static int CacheBlockStore_GetStoredBlock(
     return 0;
 }
 
+static int CacheBlockStore_GetStoredBlock(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint64_t block_hash,
+    struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
+    return CacheBlockStore_GetBlock(block_store_api, block_hash, 0, 0, 0, 0, async_complete_api);
+}
+
+static int CacheBlockStore_GetStoredBlockToBuffer(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint64_t block_hash,
+    void* buffer,
+    uint32_t buffer_size,
+    struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(buffer_size, "%u"),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, buffer, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
+    return CacheBlockStore_GetBlock(block_store_api, block_hash, buffer, buffer_size, 0, 0, async_complete_api);
+}
+
+static int CacheBlockStore_GetStoredBlockChunkRange(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint64_t block_hash,
+    uint32_t first_chunk_index,
+    uint32_t chunk_count,
+    struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(first_chunk_index, "%u"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u"),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count > 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
+    return CacheBlockStore_GetBlock(block_store_api, block_hash, 0, 0, first_chunk_index, chunk_count, async_complete_api);
+}
+
 struct GetExistingContext_GetExistingRemoteContent_Context
 {
     struct Longtail_AsyncGetExistingContentAPI m_AsyncCompleteAPI;
@@ -947,6 +1029,9 @@ static int CacheBlockStore_Init(
         return EINVAL;
     }
 
+    block_store_api->GetStoredBlockToBuffer = local_block_store->GetStoredBlockToBuffer ? CacheBlockStore_GetStoredBlockToBuffer : 0;
+    block_store_api->GetStoredBlockChunkRange = local_block_store->GetStoredBlockChunkRange ? CacheBlockStore_GetStoredBlockChunkRange : 0;
+
     struct CacheBlockStoreAPI* api = (struct CacheBlockStoreAPI*)block_store_api;
 
     api->m_LocalBlockStoreAPI = local_block_store;
@@ -7,11 +7,21 @@
 #include <inttypes.h>
 #include <string.h>
 
+// Adaptive compression compares the time to compress and the time to put a block, both per MiB of uncompressed data,
+// averaged over the blocks compressed at the current level. When one side is more than 3/2 of the other the level
+// moves one step towards balancing them, a slow backing store gets stronger compression and a slow compressor a faster level.
+#define COMPRESSBLOCKSTORE_ADAPTIVE_MIN_SAMPLE_COUNT 8u
+#define COMPRESSBLOCKSTORE_ADAPTIVE_NO_LEVEL 0xffffffffu
+
 struct CompressBlockStoreAPI
 {
     struct Longtail_BlockStoreAPI m_BlockStoreAPI;
     struct Longtail_BlockStoreAPI* m_BackingBlockStore;
     struct Longtail_CompressionRegistryAPI* m_CompressionRegistryAPI;
+    struct Longtail_JobAPI* m_JobAPI;
+    uint32_t m_SplitFrameSize;
+    int m_ChunkAlignedFrames;
+    int m_StoreRawFrames;
     struct Longtail_BlockStore_Stats m_Stats;
 
     TLongtail_Atomic64 m_StatU64[Longtail_BlockStoreAPI_StatU64_Count];
@@ -20,8 +30,108 @@ struct CompressBlockStoreAPI
     struct Longtail_AsyncFlushAPI** m_PendingAsyncFlushAPIs;
 
     TLongtail_Atomic32 m_PendingRequestCount;
+
+    // Adaptive compression state, protected by m_Lock
+    const uint32_t* m_AdaptiveCompressionTypes;
+    uint32_t m_AdaptiveCompressionTypeCount;
+    uint32_t m_AdaptiveLevel;
+    uint32_t m_AdaptiveCompressSampleCount;
+    uint32_t m_AdaptivePutSampleCount;
+    uint64_t m_AdaptiveCompressUsPerMiB;
+    uint64_t m_AdaptivePutUsPerMiB;
+
+    uint32_t m_TranscodeCompressionType;
 };
 
+static uint32_t CompressBlockStore_GetAdaptiveLevel(struct CompressBlockStoreAPI* compressblockstore_api, uint32_t compression_type)
+{
+    for (uint32_t l = 0; l < compressblockstore_api->m_AdaptiveCompressionTypeCount; ++l)
+    {
+        if (compressblockstore_api->m_AdaptiveCompressionTypes[l] == compression_type)
+        {
+            Longtail_LockSpinLock(compressblockstore_api->m_Lock);
+            uint32_t level = compressblockstore_api->m_AdaptiveLevel;
+            Longtail_UnlockSpinLock(compressblockstore_api->m_Lock);
+            return level;
+        }
+    }
+    return COMPRESSBLOCKSTORE_ADAPTIVE_NO_LEVEL;
+}
+
+uint32_t Longtail_CompressBlockStore_GetNextAdaptiveLevel(
+    uint32_t level,
+    uint32_t level_count,
+    uint64_t compress_us_per_mib,
+    uint64_t put_us_per_mib)
+{
+    if (put_us_per_mib * 2 > compress_us_per_mib * 3 && level + 1 < level_count)
+    {
+        return level + 1;
+    }
+    if (compress_us_per_mib * 2 > put_us_per_mib * 3 && level > 0)
+    {
+        return level - 1;
+    }
+    return level;
+}
+
+static void CompressBlockStore_AddAdaptiveSample(
+    struct CompressBlockStoreAPI* compressblockstore_api,
+    uint32_t level,
+    int is_put,
+    uint64_t elapsed_us,
+    uint32_t uncompressed_size)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(compressblockstore_api, "%p"),
+        LONGTAIL_LOGFIELD(level, "%u"),
+        LONGTAIL_LOGFIELD(is_put, "%d"),
+        LONGTAIL_LOGFIELD(elapsed_us, "%" PRIu64),
+        LONGTAIL_LOGFIELD(uncompressed_size, "%u")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    if (level == COMPRESSBLOCKSTORE_ADAPTIVE_NO_LEVEL || uncompressed_size == 0)
+    {
+        return;
+    }
+    uint64_t us_per_mib = (elapsed_us * 1048576u) / uncompressed_size;
+    Longtail_LockSpinLock(compressblockstore_api->m_Lock);
+    // Samples from blocks compressed at a level we have already left says nothing about the current level
+    if (level != compressblockstore_api->m_AdaptiveLevel)
+    {
+        Longtail_UnlockSpinLock(compressblockstore_api->m_Lock);
+        return;
+    }
+    uint32_t* sample_count = is_put ? &compressblockstore_api->m_AdaptivePutSampleCount : &compressblockstore_api->m_AdaptiveCompressSampleCount;
+    uint64_t* average = is_put ? &compressblockstore_api->m_AdaptivePutUsPerMiB : &compressblockstore_api->m_AdaptiveCompressUsPerMiB;
+    *average = (*sample_count == 0) ? us_per_mib : ((*average * 3) + us_per_mib) / 4;
+    ++(*sample_count);
+    if (compressblockstore_api->m_AdaptiveCompressSampleCount < COMPRESSBLOCKSTORE_ADAPTIVE_MIN_SAMPLE_COUNT ||
+        compressblockstore_api->m_AdaptivePutSampleCount < COMPRESSBLOCKSTORE_ADAPTIVE_MIN_SAMPLE_COUNT)
+    {
+        Longtail_UnlockSpinLock(compressblockstore_api->m_Lock);
+        return;
+    }
+    uint64_t compress_us = compressblockstore_api->m_AdaptiveCompressUsPerMiB;
+    uint64_t put_us = compressblockstore_api->m_AdaptivePutUsPerMiB;
+    uint32_t new_level = Longtail_CompressBlockStore_GetNextAdaptiveLevel(level, compressblockstore_api->m_AdaptiveCompressionTypeCount, compress_us, put_us);
+    if (new_level != level)
+    {
+        compressblockstore_api->m_AdaptiveLevel = new_level;
+        compressblockstore_api->m_AdaptiveCompressSampleCount = 0;
+        compressblockstore_api->m_AdaptivePutSampleCount = 0;
+    }
+    Longtail_UnlockSpinLock(compressblockstore_api->m_Lock);
+    if (new_level != level)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "Compress %" PRIu64 " us/MiB, put %" PRIu64 " us/MiB, changed compression level from %u to %u", compress_us, put_us, level, new_level)
+    }
+}
+
 static void CompressBlockStore_CompleteRequest(struct CompressBlockStoreAPI* compressblockstore_api)
 {
 #if defined(LONGTAIL_ASSERTS)
@@ -64,14 +174,265 @@ static int CompressedStoredBlock_Dispose(struct Longtail_StoredBlock* stored_blo
     return 0;
 }
 
+// A compressed block starts with a header of two uint32_t, the uncompressed size followed by the compressed size.
+// If the block was compressed in split frames the second value is COMPRESSBLOCKSTORE_SPLIT_FRAME_FLAG | frame_count,
+// followed by the uncompressed and compressed size of each frame. Frames can be compressed and decompressed independently.
+// If the store has raw frames enabled a frame that did not compress is stored raw, its compressed size is
+// COMPRESSBLOCKSTORE_RAW_FRAME_FLAG | uncompressed size. A block with a raw frame always uses the split frame header,
+// compress block stores older than raw frames can not read such blocks.
+#define COMPRESSBLOCKSTORE_SPLIT_FRAME_FLAG 0x80000000u
+#define COMPRESSBLOCKSTORE_RAW_FRAME_FLAG 0x80000000u
+
+// The incompressibility probe counts byte values and the differences between consecutive bytes in up to
+// COMPRESSBLOCKSTORE_PROBE_SAMPLE_COUNT samples spread over the frame. If both distributions are close to uniform the frame
+// is most likely already compressed or encrypted and is stored raw without running the compressor. The differences catch
+// structured data with an even byte distribution. Uniformly random bytes give a chi-square value close to 255 for 256 byte values.
+#define COMPRESSBLOCKSTORE_PROBE_MIN_SIZE 4096u
+#define COMPRESSBLOCKSTORE_PROBE_SAMPLE_SIZE 4096u
+#define COMPRESSBLOCKSTORE_PROBE_SAMPLE_COUNT 16u
+#define COMPRESSBLOCKSTORE_PROBE_MAX_CHI_SQUARE 400u
+
+struct CompressBlockStore_FrameJob
+{
+    struct Longtail_CompressionAPI* m_CompressionAPI;
+    uint32_t m_CompressionSettings;
+    const char* m_Source;
+    char* m_Target;
+    size_t m_SourceSize;
+    size_t m_TargetSize;
+    size_t m_OutSize;
+    int m_AllowRaw;
+    int m_Raw;
+    int m_Err;
+};
+
+static int CompressBlockStore_IsIncompressible(const uint8_t* data, size_t size)
+{
+    if (size < COMPRESSBLOCKSTORE_PROBE_MIN_SIZE)
+    {
+        return 0;
+    }
+    uint32_t counts[256];
+    uint32_t delta_counts[256];
+    memset(counts, 0, sizeof(counts));
+    memset(delta_counts, 0, sizeof(delta_counts));
+    uint32_t sample_count = (uint32_t)(size / COMPRESSBLOCKSTORE_PROBE_SAMPLE_SIZE);
+    sample_count = sample_count < COMPRESSBLOCKSTORE_PROBE_SAMPLE_COUNT ? sample_count : COMPRESSBLOCKSTORE_PROBE_SAMPLE_COUNT;
+    size_t sample_stride = size / sample_count;
+    for (uint32_t s = 0; s < sample_count; ++s)
+    {
+        const uint8_t* sample = &data[s * sample_stride];
+        uint8_t previous = 0;
+        for (uint32_t i = 0; i < COMPRESSBLOCKSTORE_PROBE_SAMPLE_SIZE; ++i)
+        {
+            ++counts[sample[i]];
+            ++delta_counts[(uint8_t)(sample[i] - previous)];
+            previous = sample[i];
+        }
+    }
+    uint64_t sample_size = (uint64_t)sample_count * COMPRESSBLOCKSTORE_PROBE_SAMPLE_SIZE;
+    uint64_t expected = sample_size / 256;
+    uint64_t square_sum = 0;
+    uint64_t delta_square_sum = 0;
+    for (uint32_t b = 0; b < 256; ++b)
+    {
+        int64_t d = (int64_t)counts[b] - (int64_t)expected;
+        square_sum += (uint64_t)(d * d);
+        int64_t dd = (int64_t)delta_counts[b] - (int64_t)expected;
+        delta_square_sum += (uint64_t)(dd * dd);
+    }
+    uint64_t max_square_sum = (uint64_t)COMPRESSBLOCKSTORE_PROBE_MAX_CHI_SQUARE * expected;
+    return square_sum < max_square_sum && delta_square_sum < max_square_sum;
+}
+
+static int CompressBlockStore_CompressFrameJob(void* context, uint32_t job_id, int detected_error)
+{
+    struct CompressBlockStore_FrameJob* job = (struct CompressBlockStore_FrameJob*)context;
+    if (detected_error)
+    {
+        job->m_Err = detected_error;
+        return 0;
+    }
+    if (!job->m_AllowRaw || !CompressBlockStore_IsIncompressible((const uint8_t*)job->m_Source, job->m_SourceSize))
+    {
+        job->m_Err = job->m_CompressionAPI->Compress(
+            job->m_CompressionAPI,
+            job->m_CompressionSettings,
+            job->m_Source,
+            job->m_Target,
+            job->m_SourceSize,
+            job->m_TargetSize,
+            &job->m_OutSize);
+        if (job->m_Err || !job->m_AllowRaw || job->m_OutSize < job->m_SourceSize)
+        {
+            return job->m_Err;
+        }
+    }
+    memcpy(job->m_Target, job->m_Source, job->m_SourceSize);
+    job->m_OutSize = job->m_SourceSize;
+    job->m_Raw = 1;
+    return 0;
+}
+
+static int CompressBlockStore_DecompressFrameJob(void* context, uint32_t job_id, int detected_error)
+{
+    struct CompressBlockStore_FrameJob* job = (struct CompressBlockStore_FrameJob*)context;
+    if (detected_error)
+    {
+        job->m_Err = detected_error;
+        return 0;
+    }
+    if (job->m_Raw)
+    {
+        memcpy(job->m_Target, job->m_Source, job->m_TargetSize);
+        return 0;
+    }
+    job->m_Err = job->m_CompressionAPI->Decompress(
+        job->m_CompressionAPI,
+        job->m_Source,
+        job->m_Target,
+        job->m_SourceSize,
+        job->m_TargetSize,
+        &job->m_OutSize);
+    if (job->m_Err == 0 && job->m_OutSize != job->m_TargetSize)
+    {
+        job->m_Err = EBADF;
+    }
+    return job->m_Err;
+}
+
+static int CompressBlockStore_RunFrameJobs(
+    struct Longtail_JobAPI* optional_job_api,
+    uint32_t frame_count,
+    struct CompressBlockStore_FrameJob* frame_jobs,
+    Longtail_JobAPI_JobFunc frame_job_func)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(frame_count, "%u"),
+        LONGTAIL_LOGFIELD(frame_jobs, "%p"),
+        LONGTAIL_LOGFIELD(frame_job_func, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    if (optional_job_api == 0 || frame_count < 2)
+    {
+        for (uint32_t f = 0; f < frame_count; ++f)
+        {
+            int err = frame_job_func(&frame_jobs[f], f, 0);
+            if (err)
+            {
+                return err;
+            }
+        }
+        return 0;
+    }
+
+    size_t job_mem_size = (sizeof(Longtail_JobAPI_JobFunc) + sizeof(void*)) * frame_count;
+    void* job_mem = Longtail_Alloc("CompressBlockStore", job_mem_size);
+    if (!job_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    Longtail_JobAPI_JobFunc* funcs = (Longtail_JobAPI_JobFunc*)job_mem;
+    void** ctxs = (void**)&funcs[frame_count];
+    for (uint32_t f = 0; f < frame_count; ++f)
+    {
+        funcs[f] = frame_job_func;
+        ctxs[f] = &frame_jobs[f];
+    }
+    uint32_t jobs_submitted = 0;
+    int err = Longtail_RunJobsBatched(optional_job_api, 0, 0, 0, frame_count, funcs, ctxs, &jobs_submitted);
+    Longtail_Free(job_mem);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_RunJobsBatched() failed with %d", err)
+        return err;
+    }
+    for (uint32_t f = 0; f < frame_count; ++f)
+    {
+        if (frame_jobs[f].m_Err)
+        {
+            return frame_jobs[f].m_Err;
+        }
+    }
+    return 0;
+}
+
+// Returns the number of frames to split the block data in and sets the source size of each frame in optional_frame_jobs.
+// Chunk aligned frames hold whole chunks and are closed when the next chunk would make them larger than split_frame_size,
+// so a range of chunks can be decompressed without decompressing any other frames.
+static uint32_t CompressBlockStore_GetFrameSizes(
+    const struct Longtail_BlockIndex* block_index,
+    uint32_t block_chunk_data_size,
+    uint32_t split_frame_size,
+    int chunk_aligned_frames,
+    struct CompressBlockStore_FrameJob* optional_frame_jobs)
+{
+    if (!chunk_aligned_frames)
+    {
+        if ((split_frame_size == 0) || (block_chunk_data_size <= split_frame_size))
+        {
+            if (optional_frame_jobs)
+            {
+                optional_frame_jobs[0].m_SourceSize = block_chunk_data_size;
+            }
+            return 1;
+        }
+        uint32_t frame_count = (uint32_t)((block_chunk_data_size + split_frame_size - 1) / split_frame_size);
+        for (uint32_t f = 0; optional_frame_jobs && f < frame_count; ++f)
+        {
+            uint32_t frame_offset = f * split_frame_size;
+            optional_frame_jobs[f].m_SourceSize = (block_chunk_data_size - frame_offset) < split_frame_size ? (block_chunk_data_size - frame_offset) : split_frame_size;
+        }
+        return frame_count;
+    }
+    uint32_t chunk_count = *block_index->m_ChunkCount;
+    uint32_t frame_count = 0;
+    uint32_t frame_size = 0;
+    for (uint32_t c = 0; c < chunk_count; ++c)
+    {
+        uint32_t chunk_size = block_index->m_ChunkSizes[c];
+        if (frame_size > 0 && (uint64_t)frame_size + chunk_size > split_frame_size)
+        {
+            if (optional_frame_jobs)
+            {
+                optional_frame_jobs[frame_count].m_SourceSize = frame_size;
+            }
+            ++frame_count;
+            frame_size = 0;
+        }
+        frame_size += chunk_size;
+    }
+    if (frame_size > 0 || frame_count == 0)
+    {
+        if (optional_frame_jobs)
+        {
+            optional_frame_jobs[frame_count].m_SourceSize = frame_size;
+        }
+        ++frame_count;
+    }
+    return frame_count;
+}
+
 static int CompressBlock(
     struct Longtail_CompressionRegistryAPI* compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    uint32_t split_frame_size,
+    int chunk_aligned_frames,
+    int store_raw_frames,
+    uint32_t compressionType,
     struct Longtail_StoredBlock* uncompressed_stored_block,
     struct Longtail_StoredBlock** out_compressed_stored_block)
 {
 #if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(split_frame_size, "%u"),
+        LONGTAIL_LOGFIELD(chunk_aligned_frames, "%d"),
+        LONGTAIL_LOGFIELD(store_raw_frames, "%d"),
+        LONGTAIL_LOGFIELD(compressionType, "%u"),
         LONGTAIL_LOGFIELD(uncompressed_stored_block, "%p"),
         LONGTAIL_LOGFIELD(out_compressed_stored_block, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
@@ -82,7 +443,6 @@ static int CompressBlock(
     LONGTAIL_FATAL_ASSERT(ctx, compression_registry, return EINVAL)
     LONGTAIL_FATAL_ASSERT(ctx, uncompressed_stored_block, return EINVAL)
     LONGTAIL_FATAL_ASSERT(ctx, out_compressed_stored_block, return EINVAL)
-    uint32_t compressionType = *uncompressed_stored_block->m_BlockIndex->m_Tag;
     if (compressionType == 0)
     {
         *out_compressed_stored_block = 0;
@@ -103,12 +463,44 @@ static int CompressBlock(
     uint32_t block_chunk_data_size = uncompressed_stored_block->m_BlockChunksDataSize;
     uint32_t chunk_count = *uncompressed_stored_block->m_BlockIndex->m_ChunkCount;
     size_t block_index_size = Longtail_GetBlockIndexSize(chunk_count);
-    size_t max_compressed_chunk_data_size = compression_api->GetMaxCompressedSize(compression_api, compression_settings, block_chunk_data_size);
-    size_t compressed_stored_block_size = sizeof(struct Longtail_StoredBlock) + block_index_size + sizeof(uint32_t) + sizeof(uint32_t) + max_compressed_chunk_data_size;
+
+    // Small blocks, or blocks in a store without split frames, are stored as a single frame using the plain header
+    // unless the frame is stored raw, room for the split frame header is reserved until we know
+    uint32_t frame_count = CompressBlockStore_GetFrameSizes(uncompressed_stored_block->m_BlockIndex, block_chunk_data_size, split_frame_size, chunk_aligned_frames, 0);
+    size_t max_header_size = sizeof(uint32_t) * (2 + 2 * frame_count);
+
+    size_t frame_jobs_size = sizeof(struct CompressBlockStore_FrameJob) * frame_count;
+    struct CompressBlockStore_FrameJob* frame_jobs = (struct CompressBlockStore_FrameJob*)Longtail_Alloc("CompressBlockStore", frame_jobs_size);
+    if (!frame_jobs)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    CompressBlockStore_GetFrameSizes(uncompressed_stored_block->m_BlockIndex, block_chunk_data_size, split_frame_size, chunk_aligned_frames, frame_jobs);
+    size_t max_compressed_chunk_data_size = 0;
+    size_t frame_offset = 0;
+    for (uint32_t f = 0; f < frame_count; ++f)
+    {
+        frame_jobs[f].m_CompressionAPI = compression_api;
+        frame_jobs[f].m_CompressionSettings = compression_settings;
+        frame_jobs[f].m_Source = &((const char*)uncompressed_stored_block->m_BlockData)[frame_offset];
+        frame_jobs[f].m_Target = 0;
+        frame_jobs[f].m_TargetSize = compression_api->GetMaxCompressedSize(compression_api, compression_settings, frame_jobs[f].m_SourceSize);
+        frame_jobs[f].m_TargetSize = frame_jobs[f].m_TargetSize > frame_jobs[f].m_SourceSize ? frame_jobs[f].m_TargetSize : frame_jobs[f].m_SourceSize;
+        frame_jobs[f].m_OutSize = 0;
+        frame_jobs[f].m_AllowRaw = store_raw_frames;
+        frame_jobs[f].m_Raw = 0;
+        frame_jobs[f].m_Err = 0;
+        max_compressed_chunk_data_size += frame_jobs[f].m_TargetSize;
+        frame_offset += frame_jobs[f].m_SourceSize;
+    }
+
+    size_t compressed_stored_block_size = sizeof(struct Longtail_StoredBlock) + block_index_size + max_header_size + max_compressed_chunk_data_size;
     struct Longtail_StoredBlock* compressed_stored_block = (struct Longtail_StoredBlock*)Longtail_Alloc("CompressBlockStore", compressed_stored_block_size);
     if (!compressed_stored_block)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(frame_jobs);
         return ENOMEM;
     }
     compressed_stored_block->m_BlockIndex = Longtail_InitBlockIndex(&compressed_stored_block[1], chunk_count);
@@ -116,25 +508,59 @@ static int CompressBlock(
 
     uint32_t* header_ptr = (uint32_t*)(&((uint8_t*)compressed_stored_block->m_BlockIndex)[block_index_size]);
     compressed_stored_block->m_BlockData = header_ptr;
-    memmove(compressed_stored_block->m_BlockIndex, uncompressed_stored_block->m_BlockIndex, block_index_size);
-    size_t compressed_chunk_data_size;
-    err = compression_api->Compress(
-        compression_api,
-        compression_settings,
-        (const char*)uncompressed_stored_block->m_BlockData,
-        (char*)&header_ptr[2],
-        block_chunk_data_size,
-        max_compressed_chunk_data_size,
-        &compressed_chunk_data_size);
+    // Copy the block index data only, the block index pointers of the uncompressed block point into its own memory
+    memmove(&compressed_stored_block->m_BlockIndex[1], uncompressed_stored_block->m_BlockIndex->m_BlockHash, Longtail_GetBlockIndexDataSize(chunk_count));
+    *compressed_stored_block->m_BlockIndex->m_Tag = compressionType;
+
+    size_t target_offset = max_header_size;
+    for (uint32_t f = 0; f < frame_count; ++f)
+    {
+        frame_jobs[f].m_Target = &((char*)header_ptr)[target_offset];
+        target_offset += frame_jobs[f].m_TargetSize;
+    }
+
+    err = CompressBlockStore_RunFrameJobs(optional_job_api, frame_count, frame_jobs, CompressBlockStore_CompressFrameJob);
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "compression_api->Compress() failed with %d", err)
         Longtail_Free(compressed_stored_block);
+        Longtail_Free(frame_jobs);
         return err;
     }
+
+    int split_frames = frame_count > 1;
+    for (uint32_t f = 0; f < frame_count; ++f)
+    {
+        split_frames = split_frames || frame_jobs[f].m_Raw;
+    }
+    size_t header_size = sizeof(uint32_t) * (2 + (split_frames ? 2 * frame_count : 0));
+    char* compressed_data = &((char*)header_ptr)[header_size];
+
+    // Pack the compressed frames back to back, each frame was compressed into a slot sized for its worst case
+    size_t compressed_chunk_data_size = 0;
+    for (uint32_t f = 0; f < frame_count; ++f)
+    {
+        memmove(&compressed_data[compressed_chunk_data_size], frame_jobs[f].m_Target, frame_jobs[f].m_OutSize);
+        compressed_chunk_data_size += frame_jobs[f].m_OutSize;
+    }
+
     header_ptr[0] = block_chunk_data_size;
-    header_ptr[1] = (uint32_t)compressed_chunk_data_size;
-    compressed_stored_block->m_BlockChunksDataSize = (uint32_t)(sizeof(uint32_t) + sizeof(uint32_t) + compressed_chunk_data_size);
+    if (split_frames)
+    {
+        header_ptr[1] = COMPRESSBLOCKSTORE_SPLIT_FRAME_FLAG | frame_count;
+        for (uint32_t f = 0; f < frame_count; ++f)
+        {
+            header_ptr[2 + f * 2] = (uint32_t)frame_jobs[f].m_SourceSize;
+            header_ptr[2 + f * 2 + 1] = (uint32_t)frame_jobs[f].m_OutSize | (frame_jobs[f].m_Raw ? COMPRESSBLOCKSTORE_RAW_FRAME_FLAG : 0u);
+        }
+    }
+    else
+    {
+        header_ptr[1] = (uint32_t)compressed_chunk_data_size;
+    }
+    Longtail_Free(frame_jobs);
+
+    compressed_stored_block->m_BlockChunksDataSize = (uint32_t)(header_size + compressed_chunk_data_size);
     compressed_stored_block->Dispose = CompressedStoredBlock_Dispose;
     *out_compressed_stored_block = compressed_stored_block;
     return 0;
@@ -146,36 +572,622 @@ struct OnPutBackingStoreAsync_API
     struct Longtail_StoredBlock* m_CompressedBlock;
     struct Longtail_AsyncPutStoredBlockAPI* m_AsyncCompleteAPI;
     struct CompressBlockStoreAPI* m_CompressBlockStoreAPI;
+    uint32_t m_AdaptiveLevel;
+    uint32_t m_UncompressedSize;
+    uint64_t m_PutStartUs;
 };
 
-static void OnPutBackingStoreComplete(struct Longtail_AsyncPutStoredBlockAPI* async_complete_api, int err)
+static void OnPutBackingStoreComplete(struct Longtail_AsyncPutStoredBlockAPI* async_complete_api, int err)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(err, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api, return)
+    struct OnPutBackingStoreAsync_API* async_block_store = (struct OnPutBackingStoreAsync_API*)async_complete_api;
+    struct CompressBlockStoreAPI* compressblockstore_api = async_block_store->m_CompressBlockStoreAPI;
+    if (err)
+    {
+        Longtail_AtomicAdd64(&compressblockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
+    }
+    else
+    {
+        CompressBlockStore_AddAdaptiveSample(compressblockstore_api, async_block_store->m_AdaptiveLevel, 1, Longtail_GetTimeUs() - async_block_store->m_PutStartUs, async_block_store->m_UncompressedSize);
+    }
+    if (async_block_store->m_CompressedBlock)
+    {
+        async_block_store->m_CompressedBlock->Dispose(async_block_store->m_CompressedBlock);
+    }
+    async_block_store->m_AsyncCompleteAPI->OnComplete(async_block_store->m_AsyncCompleteAPI, err);
+    Longtail_Free(async_block_store);
+    CompressBlockStore_CompleteRequest(compressblockstore_api);
+}
+
+static int CompressBlockStore_PutStoredBlock(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    struct Longtail_StoredBlock* stored_block,
+    struct Longtail_AsyncPutStoredBlockAPI* async_complete_api)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, stored_block, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL);
+
+    struct CompressBlockStoreAPI* block_store = (struct CompressBlockStoreAPI*)block_store_api;
+
+    Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_Count], 1);
+    Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_Chunk_Count], *stored_block->m_BlockIndex->m_ChunkCount);
+    Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_Byte_Count], Longtail_GetBlockIndexDataSize(*stored_block->m_BlockIndex->m_ChunkCount) + stored_block->m_BlockChunksDataSize);
+
+    // Blocks tagged with one of the adaptive compression types are compressed at the current adaptive level,
+    // the level used is recorded in the tag of the stored block
+    uint32_t compression_type = *stored_block->m_BlockIndex->m_Tag;
+    uint32_t adaptive_level = CompressBlockStore_GetAdaptiveLevel(block_store, compression_type);
+    if (adaptive_level != COMPRESSBLOCKSTORE_ADAPTIVE_NO_LEVEL)
+    {
+        compression_type = block_store->m_AdaptiveCompressionTypes[adaptive_level];
+    }
+
+    struct Longtail_StoredBlock* compressed_stored_block;
+
+    uint64_t compress_start_us = Longtail_GetTimeUs();
+    int err = CompressBlock(block_store->m_CompressionRegistryAPI, block_store->m_JobAPI, block_store->m_SplitFrameSize, block_store->m_ChunkAlignedFrames, block_store->m_StoreRawFrames, compression_type, stored_block, &compressed_stored_block);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompressBlock() failed with %d", err)
+        Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
+        return err;
+    }
+    CompressBlockStore_AddAdaptiveSample(block_store, adaptive_level, 0, Longtail_GetTimeUs() - compress_start_us, stored_block->m_BlockChunksDataSize);
+    struct Longtail_StoredBlock* to_store = compressed_stored_block ? compressed_stored_block : stored_block;
+
+    size_t on_put_backing_store_async_api_size = sizeof(struct OnPutBackingStoreAsync_API);
+    struct OnPutBackingStoreAsync_API* on_put_backing_store_async_api = (struct OnPutBackingStoreAsync_API*)Longtail_Alloc("CompressBlockStore", on_put_backing_store_async_api_size);
+    if (!on_put_backing_store_async_api)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
+        Longtail_Free(compressed_stored_block);
+        return ENOMEM;
+    }
+    on_put_backing_store_async_api->m_API.OnComplete = OnPutBackingStoreComplete;
+    on_put_backing_store_async_api->m_API.m_API.Dispose = 0;
+    on_put_backing_store_async_api->m_CompressedBlock = compressed_stored_block;
+    on_put_backing_store_async_api->m_AsyncCompleteAPI = async_complete_api;
+    on_put_backing_store_async_api->m_CompressBlockStoreAPI = block_store;
+    on_put_backing_store_async_api->m_AdaptiveLevel = adaptive_level;
+    on_put_backing_store_async_api->m_UncompressedSize = stored_block->m_BlockChunksDataSize;
+    on_put_backing_store_async_api->m_PutStartUs = Longtail_GetTimeUs();
+    Longtail_AtomicAdd32(&block_store->m_PendingRequestCount, 1);
+    err = block_store->m_BackingBlockStore->PutStoredBlock(block_store->m_BackingBlockStore, to_store, &on_put_backing_store_async_api->m_API);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_store->m_BackingBlockStore->PutStoredBlock() failed with %d", err)
+        Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
+        Longtail_Free(on_put_backing_store_async_api);
+        SAFE_DISPOSE_STORED_BLOCK(compressed_stored_block);
+        CompressBlockStore_CompleteRequest(block_store);
+    }
+    return err;
+}
+
+static int CompressBlockStore_PreflightGet(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint32_t block_count,
+    const TLongtail_Hash* block_hashes,
+    struct Longtail_AsyncPreflightStartedAPI* optional_async_complete_api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(block_hashes, "%p"),
+        LONGTAIL_LOGFIELD(optional_async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, (block_count == 0) || (block_hashes != 0), return EINVAL)
+    struct CompressBlockStoreAPI* api = (struct CompressBlockStoreAPI*)block_store_api;
+    Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PreflightGet_Count], 1);
+    int err = api->m_BackingBlockStore->PreflightGet(
+        api->m_BackingBlockStore,
+        block_count,
+        block_hashes,
+        optional_async_complete_api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "api->m_BackingBlockStore->PreflightGet() failed with %d", err)
+        Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PreflightGet_FailCount], 1);
+    }
+    return err;
+}
+
+// Sets up one decompression job per frame of a compressed block, the job targets are left for the caller to set
+static int CompressBlockStore_InitDecompressFrameJobs(
+    struct Longtail_CompressionRegistryAPI* compression_registry,
+    struct Longtail_StoredBlock* compressed_stored_block,
+    uint32_t* out_uncompressed_size,
+    uint32_t* out_frame_count,
+    struct CompressBlockStore_FrameJob** out_frame_jobs)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(compressed_stored_block, "%p"),
+        LONGTAIL_LOGFIELD(out_uncompressed_size, "%p"),
+        LONGTAIL_LOGFIELD(out_frame_count, "%p"),
+        LONGTAIL_LOGFIELD(out_frame_jobs, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    uint32_t compressionType = *compressed_stored_block->m_BlockIndex->m_Tag;
+    struct Longtail_CompressionAPI* compression_api;
+    uint32_t compression_settings;
+    int err = compression_registry->GetCompressionAPI(
+        compression_registry,
+        compressionType,
+        &compression_api,
+        &compression_settings);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "compression_registry->GetCompressionAPI() failed with %d", err)
+        return err;
+    }
+
+    if (compressed_stored_block->m_BlockChunksDataSize < sizeof(uint32_t) * 2)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Invalid compressed block header, failed with %d", EBADF)
+        return EBADF;
+    }
+    uint32_t* header_ptr = (uint32_t*)compressed_stored_block->m_BlockData;
+    uint32_t uncompressed_size = header_ptr[0];
+    int split_frames = (header_ptr[1] & COMPRESSBLOCKSTORE_SPLIT_FRAME_FLAG) != 0;
+    uint32_t frame_count = split_frames ? (header_ptr[1] & ~COMPRESSBLOCKSTORE_SPLIT_FRAME_FLAG) : 1;
+    size_t header_size = sizeof(uint32_t) * (2 + (split_frames ? 2 * (size_t)frame_count : 0));
+    if (frame_count == 0 || header_size > compressed_stored_block->m_BlockChunksDataSize)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Invalid compressed block header, failed with %d", EBADF)
+        return EBADF;
+    }
+    const char* compressed_chunks_data = &((const char*)header_ptr)[header_size];
+
+    size_t frame_jobs_size = sizeof(struct CompressBlockStore_FrameJob) * frame_count;
+    struct CompressBlockStore_FrameJob* frame_jobs = (struct CompressBlockStore_FrameJob*)Longtail_Alloc("CompressBlockStore", frame_jobs_size);
+    if (!frame_jobs)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    uint64_t source_offset = 0;
+    uint64_t target_offset = 0;
+    for (uint32_t f = 0; f < frame_count; ++f)
+    {
+        uint32_t frame_uncompressed_size = split_frames ? header_ptr[2 + f * 2] : uncompressed_size;
+        uint32_t frame_compressed_size = split_frames ? header_ptr[2 + f * 2 + 1] : header_ptr[1];
+        int raw = split_frames && (frame_compressed_size & COMPRESSBLOCKSTORE_RAW_FRAME_FLAG) != 0;
+        frame_compressed_size &= raw ? ~COMPRESSBLOCKSTORE_RAW_FRAME_FLAG : 0xffffffffu;
+        if (raw && frame_compressed_size != frame_uncompressed_size)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Invalid raw frame size, failed with %d", EBADF)
+            Longtail_Free(frame_jobs);
+            return EBADF;
+        }
+        frame_jobs[f].m_CompressionAPI = compression_api;
+        frame_jobs[f].m_CompressionSettings = compression_settings;
+        frame_jobs[f].m_Source = &compressed_chunks_data[source_offset];
+        frame_jobs[f].m_Target = 0;
+        frame_jobs[f].m_SourceSize = frame_compressed_size;
+        frame_jobs[f].m_TargetSize = frame_uncompressed_size;
+        frame_jobs[f].m_OutSize = 0;
+        frame_jobs[f].m_Raw = raw;
+        frame_jobs[f].m_Err = 0;
+        source_offset += frame_compressed_size;
+        target_offset += frame_uncompressed_size;
+    }
+    if (target_offset != uncompressed_size || header_size + source_offset > compressed_stored_block->m_BlockChunksDataSize)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Invalid compressed block frame sizes, failed with %d", EBADF)
+        Longtail_Free(frame_jobs);
+        return EBADF;
+    }
+    *out_uncompressed_size = uncompressed_size;
+    *out_frame_count = frame_count;
+    *out_frame_jobs = frame_jobs;
+    return 0;
+}
+
+// Decompresses a block, the chunk data is placed in optional_target_buffer if given, otherwise the
+// returned block owns a buffer of its own
+static int DecompressBlock(
+    struct Longtail_CompressionRegistryAPI* compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    void* optional_target_buffer,
+    uint32_t target_buffer_size,
+    struct Longtail_StoredBlock* compressed_stored_block,
+    struct Longtail_StoredBlock** out_stored_block)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_target_buffer, "%p"),
+        LONGTAIL_LOGFIELD(target_buffer_size, "%u"),
+        LONGTAIL_LOGFIELD(compressed_stored_block, "%p"),
+        LONGTAIL_LOGFIELD(out_stored_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_FATAL_ASSERT(ctx, compression_registry, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, compressed_stored_block, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, out_stored_block, return EINVAL)
+
+    uint32_t uncompressed_size;
+    uint32_t frame_count;
+    struct CompressBlockStore_FrameJob* frame_jobs;
+    int err = CompressBlockStore_InitDecompressFrameJobs(compression_registry, compressed_stored_block, &uncompressed_size, &frame_count, &frame_jobs);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompressBlockStore_InitDecompressFrameJobs() failed with %d", err)
+        return err;
+    }
+    if (optional_target_buffer && uncompressed_size > target_buffer_size)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Target buffer is smaller than the block data, failed with %d", EINVAL)
+        Longtail_Free(frame_jobs);
+        return EINVAL;
+    }
+
+    uint32_t chunk_count = *compressed_stored_block->m_BlockIndex->m_ChunkCount;
+    uint32_t block_index_data_size = (uint32_t)Longtail_GetBlockIndexDataSize(chunk_count);
+    uint32_t uncompressed_block_data_size = block_index_data_size + (optional_target_buffer ? 0 : uncompressed_size);
+    size_t uncompressed_stored_block_size = Longtail_GetStoredBlockSize(uncompressed_block_data_size);
+    struct Longtail_StoredBlock* uncompressed_stored_block = (struct Longtail_StoredBlock*)Longtail_Alloc("CompressBlockStore", uncompressed_stored_block_size);
+    if (!uncompressed_stored_block)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(frame_jobs);
+        return ENOMEM;
+    }
+    uncompressed_stored_block->m_BlockIndex = Longtail_InitBlockIndex(&uncompressed_stored_block[1], chunk_count);
+    LONGTAIL_FATAL_ASSERT(ctx, uncompressed_stored_block->m_BlockIndex, Longtail_Free(frame_jobs); Longtail_Free(uncompressed_stored_block); return EINVAL; )
+    uncompressed_stored_block->m_BlockData = optional_target_buffer ? optional_target_buffer : &((uint8_t*)(&uncompressed_stored_block->m_BlockIndex[1]))[block_index_data_size];
+    uncompressed_stored_block->m_BlockChunksDataSize = uncompressed_size;
+    uncompressed_stored_block->Dispose = CompressedStoredBlock_Dispose;
+    memmove(&uncompressed_stored_block->m_BlockIndex[1], ((const uint8_t*)(compressed_stored_block->m_BlockData))-block_index_data_size, block_index_data_size);
+
+    size_t target_offset = 0;
+    for (uint32_t f = 0; f < frame_count; ++f)
+    {
+        frame_jobs[f].m_Target = &((char*)uncompressed_stored_block->m_BlockData)[target_offset];
+        target_offset += frame_jobs[f].m_TargetSize;
+    }
+
+    err = CompressBlockStore_RunFrameJobs(optional_job_api, frame_count, frame_jobs, CompressBlockStore_DecompressFrameJob);
+    Longtail_Free(frame_jobs);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "compression_api->Decompress() failed with %d", err)
+        Longtail_Free(uncompressed_stored_block);
+        return EBADF;
+    }
+    *out_stored_block = uncompressed_stored_block;
+    return 0;
+}
+
+// Decompresses the frames overlapping [data_offset, data_offset + data_size) of the block data into out_data
+static int DecompressBlockRange(
+    struct Longtail_CompressionRegistryAPI* compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    struct Longtail_StoredBlock* compressed_stored_block,
+    uint32_t data_offset,
+    uint32_t data_size,
+    void* out_data)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(compressed_stored_block, "%p"),
+        LONGTAIL_LOGFIELD(data_offset, "%u"),
+        LONGTAIL_LOGFIELD(data_size, "%u"),
+        LONGTAIL_LOGFIELD(out_data, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    uint32_t uncompressed_size;
+    uint32_t frame_count;
+    struct CompressBlockStore_FrameJob* frame_jobs;
+    int err = CompressBlockStore_InitDecompressFrameJobs(compression_registry, compressed_stored_block, &uncompressed_size, &frame_count, &frame_jobs);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompressBlockStore_InitDecompressFrameJobs() failed with %d", err)
+        return err;
+    }
+    if ((uint64_t)data_offset + data_size > uncompressed_size)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Range is outside of the block data, failed with %d", EBADF)
+        Longtail_Free(frame_jobs);
+        return EBADF;
+    }
+
+    uint32_t first_frame = 0;
+    uint32_t first_frame_offset = 0;
+    while (first_frame + 1 < frame_count && first_frame_offset + frame_jobs[first_frame].m_TargetSize <= data_offset)
+    {
+        first_frame_offset += (uint32_t)frame_jobs[first_frame].m_TargetSize;
+        ++first_frame;
+    }
+    uint32_t end_frame = first_frame;
+    uint32_t end_frame_offset = first_frame_offset;
+    while (end_frame < frame_count && (end_frame == first_frame || end_frame_offset < data_offset + data_size))
+    {
+        end_frame_offset += (uint32_t)frame_jobs[end_frame].m_TargetSize;
+        ++end_frame;
+    }
+
+    // Frames that line up with the range are decompressed in place, otherwise they go through a scratch buffer
+    int aligned = (first_frame_offset == data_offset) && (end_frame_offset == data_offset + data_size);
+    char* scratch = aligned ? (char*)out_data : (char*)Longtail_Alloc("CompressBlockStore", end_frame_offset - first_frame_offset);
+    if (!scratch)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(frame_jobs);
+        return ENOMEM;
+    }
+    size_t target_offset = 0;
+    for (uint32_t f = first_frame; f < end_frame; ++f)
+    {
+        frame_jobs[f].m_Target = &scratch[target_offset];
+        target_offset += frame_jobs[f].m_TargetSize;
+    }
+    err = CompressBlockStore_RunFrameJobs(optional_job_api, end_frame - first_frame, &frame_jobs[first_frame], CompressBlockStore_DecompressFrameJob);
+    Longtail_Free(frame_jobs);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "compression_api->Decompress() failed with %d", err)
+        if (!aligned)
+        {
+            Longtail_Free(scratch);
+        }
+        return EBADF;
+    }
+    if (!aligned)
+    {
+        memcpy(out_data, &scratch[data_offset - first_frame_offset], data_size);
+        Longtail_Free(scratch);
+    }
+    return 0;
+}
+
+// Copies the chunk data of a block that was stored without compression into target_buffer
+static int CopyBlock(
+    void* target_buffer,
+    uint32_t target_buffer_size,
+    struct Longtail_StoredBlock* stored_block,
+    struct Longtail_StoredBlock** out_stored_block)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(target_buffer, "%p"),
+        LONGTAIL_LOGFIELD(target_buffer_size, "%u"),
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(out_stored_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    if (stored_block->m_BlockChunksDataSize > target_buffer_size)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Target buffer is smaller than the block data, failed with %d", EINVAL)
+        return EINVAL;
+    }
+    uint32_t chunk_count = *stored_block->m_BlockIndex->m_ChunkCount;
+    uint32_t block_index_data_size = (uint32_t)Longtail_GetBlockIndexDataSize(chunk_count);
+    struct Longtail_StoredBlock* copied_stored_block = (struct Longtail_StoredBlock*)Longtail_Alloc("CompressBlockStore", Longtail_GetStoredBlockSize(block_index_data_size));
+    if (!copied_stored_block)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    copied_stored_block->m_BlockIndex = Longtail_InitBlockIndex(&copied_stored_block[1], chunk_count);
+    LONGTAIL_FATAL_ASSERT(ctx, copied_stored_block->m_BlockIndex, Longtail_Free(copied_stored_block); return EINVAL; )
+    memcpy(&copied_stored_block->m_BlockIndex[1], stored_block->m_BlockIndex->m_BlockHash, block_index_data_size);
+    copied_stored_block->m_BlockData = target_buffer;
+    copied_stored_block->m_BlockChunksDataSize = stored_block->m_BlockChunksDataSize;
+    copied_stored_block->Dispose = CompressedStoredBlock_Dispose;
+    memcpy(target_buffer, stored_block->m_BlockData, stored_block->m_BlockChunksDataSize);
+    *out_stored_block = copied_stored_block;
+    return 0;
+}
+
+struct OnGetBackingStoreAsync_API
+{
+    struct Longtail_AsyncGetStoredBlockAPI m_API;
+    struct CompressBlockStoreAPI* m_BlockStore;
+    struct Longtail_AsyncGetStoredBlockAPI* m_AsyncCompleteAPI;
+    void* m_TargetBuffer;
+    uint32_t m_TargetBufferSize;
+};
+
+static void OnGetBackingStoreComplete(struct Longtail_AsyncGetStoredBlockAPI* async_complete_api, struct Longtail_StoredBlock* stored_block, int err)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(err, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api, return)
+    struct OnGetBackingStoreAsync_API* async_block_store = (struct OnGetBackingStoreAsync_API*)async_complete_api;
+    struct CompressBlockStoreAPI* blockstore = async_block_store->m_BlockStore;
+    if (err)
+    {
+        if (err != ENOENT)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "OnGetBackingStoreComplete called with error %d", err)
+            Longtail_AtomicAdd64(&blockstore->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_FailCount], 1);
+        }
+        async_block_store->m_AsyncCompleteAPI->OnComplete(async_block_store->m_AsyncCompleteAPI, stored_block, err);
+        Longtail_Free(async_block_store);
+        CompressBlockStore_CompleteRequest(blockstore);
+        return;
+    }
+
+    Longtail_AtomicAdd64(&async_block_store->m_BlockStore->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Chunk_Count], *stored_block->m_BlockIndex->m_ChunkCount);
+    Longtail_AtomicAdd64(&async_block_store->m_BlockStore->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Byte_Count], Longtail_GetBlockIndexDataSize(*stored_block->m_BlockIndex->m_ChunkCount) + stored_block->m_BlockChunksDataSize);
+
+    uint32_t compressionType = *stored_block->m_BlockIndex->m_Tag;
+    if (compressionType == 0 && async_block_store->m_TargetBuffer == 0)
+    {
+        async_block_store->m_AsyncCompleteAPI->OnComplete(async_block_store->m_AsyncCompleteAPI, stored_block, 0);
+        Longtail_Free(async_block_store);
+        CompressBlockStore_CompleteRequest(blockstore);
+        return;
+    }
+
+    struct Longtail_StoredBlock* uncompressed_stored_block;
+    if (compressionType == 0)
+    {
+        err = CopyBlock(
+            async_block_store->m_TargetBuffer,
+            async_block_store->m_TargetBufferSize,
+            stored_block,
+            &uncompressed_stored_block);
+    }
+    else
+    {
+        err = DecompressBlock(
+            async_block_store->m_BlockStore->m_CompressionRegistryAPI,
+            async_block_store->m_BlockStore->m_JobAPI,
+            async_block_store->m_TargetBuffer,
+            async_block_store->m_TargetBufferSize,
+            stored_block,
+            &uncompressed_stored_block);
+    }
+    SAFE_DISPOSE_STORED_BLOCK(stored_block);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Decompressing block failed with %d", err)
+        Longtail_AtomicAdd64(&blockstore->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_FailCount], 1);
+        async_block_store->m_AsyncCompleteAPI->OnComplete(async_block_store->m_AsyncCompleteAPI, 0, err);
+        Longtail_Free(async_block_store);
+        CompressBlockStore_CompleteRequest(blockstore);
+        return;
+    }
+    async_block_store->m_AsyncCompleteAPI->OnComplete(async_block_store->m_AsyncCompleteAPI, uncompressed_stored_block, 0);
+    Longtail_Free(async_block_store);
+    CompressBlockStore_CompleteRequest(blockstore);
+}
+
+static int CompressBlockStore_GetBackingStoredBlock(
+    struct CompressBlockStoreAPI* block_store,
+    uint64_t block_hash,
+    void* optional_target_buffer,
+    uint32_t target_buffer_size,
+    struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store, "%p"),
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(optional_target_buffer, "%p"),
+        LONGTAIL_LOGFIELD(target_buffer_size, "%u"),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count], 1);
+
+    size_t on_fetch_backing_store_async_api_size = sizeof(struct OnGetBackingStoreAsync_API);
+    struct OnGetBackingStoreAsync_API* on_fetch_backing_store_async_api = (struct OnGetBackingStoreAsync_API*)Longtail_Alloc("CompressBlockStore", on_fetch_backing_store_async_api_size);
+    if (!on_fetch_backing_store_async_api)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+
+    on_fetch_backing_store_async_api->m_API.OnComplete = OnGetBackingStoreComplete;
+    on_fetch_backing_store_async_api->m_API.m_API.Dispose = 0;
+    on_fetch_backing_store_async_api->m_BlockStore = block_store;
+    on_fetch_backing_store_async_api->m_AsyncCompleteAPI = async_complete_api;
+    on_fetch_backing_store_async_api->m_TargetBuffer = optional_target_buffer;
+    on_fetch_backing_store_async_api->m_TargetBufferSize = target_buffer_size;
+
+    Longtail_AtomicAdd32(&block_store->m_PendingRequestCount, 1);
+    int err = block_store->m_BackingBlockStore->GetStoredBlock(block_store->m_BackingBlockStore, block_hash, &on_fetch_backing_store_async_api->m_API);
+    if (err)
+    {
+        if (err != ENOENT)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_store->m_BackingBlockStore->GetStoredBlock() failed with %d", err)
+            Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_FailCount], 1);
+        }
+        Longtail_Free(on_fetch_backing_store_async_api);
+        CompressBlockStore_CompleteRequest(block_store);
+        return err;
+    }
+    return 0;
+}
+
+static int CompressBlockStore_GetStoredBlock(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint64_t block_hash,
+    struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
+
+    return CompressBlockStore_GetBackingStoredBlock((struct CompressBlockStoreAPI*)block_store_api, block_hash, 0, 0, async_complete_api);
+}
+
+// Decompresses straight into the caller buffer so the block data is not allocated by the store
+static int CompressBlockStore_GetStoredBlockToBuffer(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint64_t block_hash,
+    void* buffer,
+    uint32_t buffer_size,
+    struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
 {
 #if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
-        LONGTAIL_LOGFIELD(err, "%d")
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(buffer_size, "%u"),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 #else
     struct Longtail_LogContextFmt_Private* ctx = 0;
 #endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api, return)
-    struct OnPutBackingStoreAsync_API* async_block_store = (struct OnPutBackingStoreAsync_API*)async_complete_api;
-    struct CompressBlockStoreAPI* compressblockstore_api = async_block_store->m_CompressBlockStoreAPI;
-    if (err)
-    {
-        Longtail_AtomicAdd64(&compressblockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
-    }
-    if (async_block_store->m_CompressedBlock)
-    {
-        async_block_store->m_CompressedBlock->Dispose(async_block_store->m_CompressedBlock);
-    }
-    async_block_store->m_AsyncCompleteAPI->OnComplete(async_block_store->m_AsyncCompleteAPI, err);
-    Longtail_Free(async_block_store);
-    CompressBlockStore_CompleteRequest(compressblockstore_api);
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, buffer, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
+
+    return CompressBlockStore_GetBackingStoredBlock((struct CompressBlockStoreAPI*)block_store_api, block_hash, buffer, buffer_size, async_complete_api);
 }
 
-static int CompressBlockStore_PutStoredBlock(
+static int TranscodeBlockStore_PutStoredBlock(
     struct Longtail_BlockStoreAPI* block_store_api,
     struct Longtail_StoredBlock* stored_block,
     struct Longtail_AsyncPutStoredBlockAPI* async_complete_api)
@@ -200,16 +1212,49 @@ static int CompressBlockStore_PutStoredBlock(
     Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_Chunk_Count], *stored_block->m_BlockIndex->m_ChunkCount);
     Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_Byte_Count], Longtail_GetBlockIndexDataSize(*stored_block->m_BlockIndex->m_ChunkCount) + stored_block->m_BlockChunksDataSize);
 
-    struct Longtail_StoredBlock* compressed_stored_block;
-
-    int err = CompressBlock(block_store->m_CompressionRegistryAPI, stored_block, &compressed_stored_block);
-    if (err)
+    // The block is decompressed with the compression type of its tag and compressed again with the transcode
+    // compression type, if the transcode compression type is zero the decompressed block is stored as is
+    struct Longtail_StoredBlock* transcoded_stored_block = 0;
+    uint32_t compression_type = *stored_block->m_BlockIndex->m_Tag;
+    if (compression_type != block_store->m_TranscodeCompressionType)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompressBlock() failed with %d", err)
-        Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
-        return err;
+        struct Longtail_StoredBlock* uncompressed_stored_block = 0;
+        if (compression_type != 0)
+        {
+            int err = DecompressBlock(block_store->m_CompressionRegistryAPI, block_store->m_JobAPI, 0, 0, stored_block, &uncompressed_stored_block);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "DecompressBlock() failed with %d", err)
+                Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
+                return err;
+            }
+        }
+        if (block_store->m_TranscodeCompressionType == 0)
+        {
+            *uncompressed_stored_block->m_BlockIndex->m_Tag = 0;
+            transcoded_stored_block = uncompressed_stored_block;
+        }
+        else
+        {
+            int err = CompressBlock(
+                block_store->m_CompressionRegistryAPI,
+                block_store->m_JobAPI,
+                block_store->m_SplitFrameSize,
+                block_store->m_ChunkAlignedFrames,
+                block_store->m_StoreRawFrames,
+                block_store->m_TranscodeCompressionType,
+                uncompressed_stored_block ? uncompressed_stored_block : stored_block,
+                &transcoded_stored_block);
+            SAFE_DISPOSE_STORED_BLOCK(uncompressed_stored_block);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompressBlock() failed with %d", err)
+                Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
+                return err;
+            }
+        }
     }
-    struct Longtail_StoredBlock* to_store = compressed_stored_block ? compressed_stored_block : stored_block;
+    struct Longtail_StoredBlock* to_store = transcoded_stored_block ? transcoded_stored_block : stored_block;
 
     size_t on_put_backing_store_async_api_size = sizeof(struct OnPutBackingStoreAsync_API);
     struct OnPutBackingStoreAsync_API* on_put_backing_store_async_api = (struct OnPutBackingStoreAsync_API*)Longtail_Alloc("CompressBlockStore", on_put_backing_store_async_api_size);
@@ -217,226 +1262,234 @@ static int CompressBlockStore_PutStoredBlock(
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
         Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
-        Longtail_Free(compressed_stored_block);
+        SAFE_DISPOSE_STORED_BLOCK(transcoded_stored_block);
         return ENOMEM;
     }
     on_put_backing_store_async_api->m_API.OnComplete = OnPutBackingStoreComplete;
     on_put_backing_store_async_api->m_API.m_API.Dispose = 0;
-    on_put_backing_store_async_api->m_CompressedBlock = compressed_stored_block;
+    on_put_backing_store_async_api->m_CompressedBlock = transcoded_stored_block;
     on_put_backing_store_async_api->m_AsyncCompleteAPI = async_complete_api;
     on_put_backing_store_async_api->m_CompressBlockStoreAPI = block_store;
+    on_put_backing_store_async_api->m_AdaptiveLevel = COMPRESSBLOCKSTORE_ADAPTIVE_NO_LEVEL;
+    on_put_backing_store_async_api->m_UncompressedSize = 0;
+    on_put_backing_store_async_api->m_PutStartUs = 0;
     Longtail_AtomicAdd32(&block_store->m_PendingRequestCount, 1);
-    err = block_store->m_BackingBlockStore->PutStoredBlock(block_store->m_BackingBlockStore, to_store, &on_put_backing_store_async_api->m_API);
+    int err = block_store->m_BackingBlockStore->PutStoredBlock(block_store->m_BackingBlockStore, to_store, &on_put_backing_store_async_api->m_API);
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_store->m_BackingBlockStore->PutStoredBlock() failed with %d", err)
         Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
         Longtail_Free(on_put_backing_store_async_api);
-        SAFE_DISPOSE_STORED_BLOCK(compressed_stored_block);
+        SAFE_DISPOSE_STORED_BLOCK(transcoded_stored_block);
         CompressBlockStore_CompleteRequest(block_store);
     }
     return err;
 }
 
-static int CompressBlockStore_PreflightGet(
+static int TranscodeBlockStore_GetStoredBlock(
     struct Longtail_BlockStoreAPI* block_store_api,
-    uint32_t block_count,
-    const TLongtail_Hash* block_hashes,
-    struct Longtail_AsyncPreflightStartedAPI* optional_async_complete_api)
+    uint64_t block_hash,
+    struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
 {
+#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(block_store_api, "%p"),
-        LONGTAIL_LOGFIELD(block_count, "%u"),
-        LONGTAIL_LOGFIELD(block_hashes, "%p"),
-        LONGTAIL_LOGFIELD(optional_async_complete_api, "%p")
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
     LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, (block_count == 0) || (block_hashes != 0), return EINVAL)
-    struct CompressBlockStoreAPI* api = (struct CompressBlockStoreAPI*)block_store_api;
-    Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PreflightGet_Count], 1);
-    int err = api->m_BackingBlockStore->PreflightGet(
-        api->m_BackingBlockStore,
-        block_count,
-        block_hashes,
-        optional_async_complete_api);
-    if (err)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
+
+    // Blocks are returned in their transcoded form, the tag tells the reader how to decompress them
+    struct CompressBlockStoreAPI* block_store = (struct CompressBlockStoreAPI*)block_store_api;
+    Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count], 1);
+    int err = block_store->m_BackingBlockStore->GetStoredBlock(block_store->m_BackingBlockStore, block_hash, async_complete_api);
+    if (err && err != ENOENT)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "api->m_BackingBlockStore->PreflightGet() failed with %d", err)
-        Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PreflightGet_FailCount], 1);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_store->m_BackingBlockStore->GetStoredBlock() failed with %d", err)
+        Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_FailCount], 1);
     }
     return err;
 }
 
-static int DecompressBlock(
-    struct Longtail_CompressionRegistryAPI* compression_registry,
-    struct Longtail_StoredBlock* compressed_stored_block,
+struct OnGetChunkRangeBackingStoreAsync_API
+{
+    struct Longtail_AsyncGetStoredBlockAPI m_API;
+    struct CompressBlockStoreAPI* m_BlockStore;
+    struct Longtail_AsyncGetStoredBlockAPI* m_AsyncCompleteAPI;
+    uint32_t m_FirstChunkIndex;
+    uint32_t m_ChunkCount;
+};
+
+static int CompressBlockStore_CreateChunkRangeBlock(
+    struct CompressBlockStoreAPI* blockstore,
+    struct Longtail_StoredBlock* stored_block,
+    uint32_t first_chunk_index,
+    uint32_t chunk_count,
     struct Longtail_StoredBlock** out_stored_block)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(compression_registry, "%p"),
-        LONGTAIL_LOGFIELD(compressed_stored_block, "%p"),
+        LONGTAIL_LOGFIELD(blockstore, "%p"),
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(first_chunk_index, "%u"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u"),
         LONGTAIL_LOGFIELD(out_stored_block, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_FATAL_ASSERT(ctx, compression_registry, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, compressed_stored_block, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, out_stored_block, return EINVAL)
-    uint32_t compressionType = *compressed_stored_block->m_BlockIndex->m_Tag;
-    struct Longtail_CompressionAPI* compression_api;
-    uint32_t compression_settings;
-    int err = compression_registry->GetCompressionAPI(
-        compression_registry,
-        compressionType,
-        &compression_api,
-        &compression_settings);
-    if (err)
+    struct Longtail_BlockIndex* block_index = stored_block->m_BlockIndex;
+    if ((uint64_t)first_chunk_index + chunk_count > *block_index->m_ChunkCount)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "compression_registry->GetCompressionAPI() failed with %d", err)
-        return err;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Chunk range is outside of block with %u chunks, failed with %d", *block_index->m_ChunkCount, EINVAL)
+        return EINVAL;
     }
-
-    uint32_t chunk_count = *compressed_stored_block->m_BlockIndex->m_ChunkCount;
-    uint32_t block_index_data_size = (uint32_t)Longtail_GetBlockIndexDataSize(chunk_count);
-    uint32_t* header_ptr = (uint32_t*)compressed_stored_block->m_BlockData;
-    void* compressed_chunks_data = &header_ptr[2];
-    uint32_t uncompressed_size = header_ptr[0];
-    uint32_t compressed_size = header_ptr[1];
-
-    uint32_t uncompressed_block_data_size = block_index_data_size + uncompressed_size;
-    size_t uncompressed_stored_block_size = Longtail_GetStoredBlockSize(uncompressed_block_data_size);
-    struct Longtail_StoredBlock* uncompressed_stored_block = (struct Longtail_StoredBlock*)Longtail_Alloc("CompressBlockStore", uncompressed_stored_block_size);
-    if (!uncompressed_stored_block)
+    uint64_t data_offset = 0;
+    for (uint32_t c = 0; c < first_chunk_index; ++c)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return ENOMEM;
+        data_offset += block_index->m_ChunkSizes[c];
+    }
+    uint64_t data_size = 0;
+    for (uint32_t c = first_chunk_index; c < first_chunk_index + chunk_count; ++c)
+    {
+        data_size += block_index->m_ChunkSizes[c];
     }
-    uncompressed_stored_block->m_BlockIndex = Longtail_InitBlockIndex(&uncompressed_stored_block[1], chunk_count);
-    LONGTAIL_FATAL_ASSERT(ctx, uncompressed_stored_block->m_BlockIndex, return EINVAL; )
-    uncompressed_stored_block->m_BlockData = &((uint8_t*)(&uncompressed_stored_block->m_BlockIndex[1]))[block_index_data_size];
-    uncompressed_stored_block->m_BlockChunksDataSize = uncompressed_size;
-    memmove(&uncompressed_stored_block->m_BlockIndex[1], ((const uint8_t*)(compressed_stored_block->m_BlockData))-block_index_data_size, block_index_data_size);
 
-    size_t real_uncompressed_size = 0;
-    err = compression_api->Decompress(
-        compression_api,
-        (const char*)compressed_chunks_data,
-        (char*)uncompressed_stored_block->m_BlockData,
-        compressed_size,
-        uncompressed_size,
-        &real_uncompressed_size);
-    if (real_uncompressed_size != uncompressed_size)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "compression_api->Decompress() failed with %d", ENOMEM)
-        Longtail_Free(uncompressed_stored_block);
-        return EBADF;
+    struct Longtail_StoredBlock* range_stored_block;
+    int err = Longtail_CreateStoredBlock(
+        *block_index->m_BlockHash,
+        *block_index->m_HashIdentifier,
+        chunk_count,
+        *block_index->m_Tag,
+        &block_index->m_ChunkHashes[first_chunk_index],
+        &block_index->m_ChunkSizes[first_chunk_index],
+        (uint32_t)data_size,
+        &range_stored_block);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoredBlock() failed with %d", err)
+        return err;
     }
-    SAFE_DISPOSE_STORED_BLOCK(compressed_stored_block);
-    uncompressed_stored_block->Dispose = CompressedStoredBlock_Dispose;
-    *out_stored_block = uncompressed_stored_block;
+    if (data_size > 0)
+    {
+        if (*block_index->m_Tag == 0)
+        {
+            if (data_offset + data_size > stored_block->m_BlockChunksDataSize)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Block data is smaller than the chunk sizes, failed with %d", EBADF)
+                range_stored_block->Dispose(range_stored_block);
+                return EBADF;
+            }
+            memcpy(range_stored_block->m_BlockData, &((const uint8_t*)stored_block->m_BlockData)[data_offset], data_size);
+        }
+        else
+        {
+            err = DecompressBlockRange(
+                blockstore->m_CompressionRegistryAPI,
+                blockstore->m_JobAPI,
+                stored_block,
+                (uint32_t)data_offset,
+                (uint32_t)data_size,
+                range_stored_block->m_BlockData);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "DecompressBlockRange() failed with %d", err)
+                range_stored_block->Dispose(range_stored_block);
+                return err;
+            }
+        }
+    }
+    *out_stored_block = range_stored_block;
     return 0;
 }
 
-struct OnGetBackingStoreAsync_API
-{
-    struct Longtail_AsyncGetStoredBlockAPI m_API;
-    struct CompressBlockStoreAPI* m_BlockStore;
-    struct Longtail_AsyncGetStoredBlockAPI* m_AsyncCompleteAPI;
-};
-
-static void OnGetBackingStoreComplete(struct Longtail_AsyncGetStoredBlockAPI* async_complete_api, struct Longtail_StoredBlock* stored_block, int err)
+static void OnGetChunkRangeBackingStoreComplete(struct Longtail_AsyncGetStoredBlockAPI* async_complete_api, struct Longtail_StoredBlock* stored_block, int err)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(async_complete_api, "%p"),
         LONGTAIL_LOGFIELD(stored_block, "%p"),
         LONGTAIL_LOGFIELD(err, "%d")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
 
     LONGTAIL_FATAL_ASSERT(ctx, async_complete_api, return)
-    struct OnGetBackingStoreAsync_API* async_block_store = (struct OnGetBackingStoreAsync_API*)async_complete_api;
+    struct OnGetChunkRangeBackingStoreAsync_API* async_block_store = (struct OnGetChunkRangeBackingStoreAsync_API*)async_complete_api;
     struct CompressBlockStoreAPI* blockstore = async_block_store->m_BlockStore;
+    struct Longtail_StoredBlock* range_stored_block = 0;
     if (err)
     {
         if (err != ENOENT)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "OnGetBackingStoreComplete called with error %d", err)
-            Longtail_AtomicAdd64(&blockstore->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_FailCount], 1);
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "OnGetChunkRangeBackingStoreComplete called with error %d", err)
         }
-        async_block_store->m_AsyncCompleteAPI->OnComplete(async_block_store->m_AsyncCompleteAPI, stored_block, err);
-        Longtail_Free(async_block_store);
-        CompressBlockStore_CompleteRequest(blockstore);
-        return;
     }
-
-    Longtail_AtomicAdd64(&async_block_store->m_BlockStore->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Chunk_Count], *stored_block->m_BlockIndex->m_ChunkCount);
-    Longtail_AtomicAdd64(&async_block_store->m_BlockStore->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Byte_Count], Longtail_GetBlockIndexDataSize(*stored_block->m_BlockIndex->m_ChunkCount) + stored_block->m_BlockChunksDataSize);
-
-    uint32_t compressionType = *stored_block->m_BlockIndex->m_Tag;
-    if (compressionType == 0)
+    else
     {
-        async_block_store->m_AsyncCompleteAPI->OnComplete(async_block_store->m_AsyncCompleteAPI, stored_block, 0);
-        Longtail_Free(async_block_store);
-        CompressBlockStore_CompleteRequest(blockstore);
-        return;
+        err = CompressBlockStore_CreateChunkRangeBlock(
+            blockstore,
+            stored_block,
+            async_block_store->m_FirstChunkIndex,
+            async_block_store->m_ChunkCount,
+            &range_stored_block);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompressBlockStore_CreateChunkRangeBlock() failed with %d", err)
+        }
+        else
+        {
+            Longtail_AtomicAdd64(&blockstore->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Chunk_Count], *range_stored_block->m_BlockIndex->m_ChunkCount);
+            Longtail_AtomicAdd64(&blockstore->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Byte_Count], Longtail_GetBlockIndexDataSize(*range_stored_block->m_BlockIndex->m_ChunkCount) + range_stored_block->m_BlockChunksDataSize);
+        }
+        SAFE_DISPOSE_STORED_BLOCK(stored_block);
     }
-
-    err = DecompressBlock(
-        async_block_store->m_BlockStore->m_CompressionRegistryAPI,
-        stored_block,
-        &stored_block);
-    if (err)
+    if (err && err != ENOENT)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "DecompressBlock() failed with %d", err)
         Longtail_AtomicAdd64(&blockstore->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_FailCount], 1);
-        SAFE_DISPOSE_STORED_BLOCK(stored_block);
-        async_block_store->m_AsyncCompleteAPI->OnComplete(async_block_store->m_AsyncCompleteAPI, 0, err);
-        Longtail_Free(async_block_store);
-        CompressBlockStore_CompleteRequest(blockstore);
-        return;
     }
-    async_block_store->m_AsyncCompleteAPI->OnComplete(async_block_store->m_AsyncCompleteAPI, stored_block, 0);
+    async_block_store->m_AsyncCompleteAPI->OnComplete(async_block_store->m_AsyncCompleteAPI, range_stored_block, err);
     Longtail_Free(async_block_store);
     CompressBlockStore_CompleteRequest(blockstore);
 }
 
-static int CompressBlockStore_GetStoredBlock(
+// The backing block store returns the whole block, only the frames that overlap the chunk range are decompressed
+static int CompressBlockStore_GetStoredBlockChunkRange(
     struct Longtail_BlockStoreAPI* block_store_api,
     uint64_t block_hash,
+    uint32_t first_chunk_index,
+    uint32_t chunk_count,
     struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
         LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(first_chunk_index, "%u"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u"),
         LONGTAIL_LOGFIELD(async_complete_api, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
 
     LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count > 0, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
 
     struct CompressBlockStoreAPI* block_store = (struct CompressBlockStoreAPI*)block_store_api;
 
     Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count], 1);
 
-    size_t on_fetch_backing_store_async_api_size = sizeof(struct OnGetBackingStoreAsync_API);
-    struct OnGetBackingStoreAsync_API* on_fetch_backing_store_async_api = (struct OnGetBackingStoreAsync_API*)Longtail_Alloc("CompressBlockStore", on_fetch_backing_store_async_api_size);
+    size_t on_fetch_backing_store_async_api_size = sizeof(struct OnGetChunkRangeBackingStoreAsync_API);
+    struct OnGetChunkRangeBackingStoreAsync_API* on_fetch_backing_store_async_api = (struct OnGetChunkRangeBackingStoreAsync_API*)Longtail_Alloc("CompressBlockStore", on_fetch_backing_store_async_api_size);
     if (!on_fetch_backing_store_async_api)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
         return ENOMEM;
     }
 
-    on_fetch_backing_store_async_api->m_API.OnComplete = OnGetBackingStoreComplete;
+    on_fetch_backing_store_async_api->m_API.OnComplete = OnGetChunkRangeBackingStoreComplete;
     on_fetch_backing_store_async_api->m_API.m_API.Dispose = 0;
     on_fetch_backing_store_async_api->m_BlockStore = block_store;
     on_fetch_backing_store_async_api->m_AsyncCompleteAPI = async_complete_api;
+    on_fetch_backing_store_async_api->m_FirstChunkIndex = first_chunk_index;
+    on_fetch_backing_store_async_api->m_ChunkCount = chunk_count;
 
     Longtail_AtomicAdd32(&block_store->m_PendingRequestCount, 1);
     int err = block_store->m_BackingBlockStore->GetStoredBlock(block_store->m_BackingBlockStore, block_hash, &on_fetch_backing_store_async_api->m_API);
@@ -509,7 +1562,23 @@ static int CompressBlockStore_PruneBlocks(
     LONGTAIL_VALIDATE_INPUT(ctx, (block_keep_count == 0) || (block_keep_hashes != 0), return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
 
-    return ENOTSUP;
+    struct CompressBlockStoreAPI* api = (struct CompressBlockStoreAPI*)block_store_api;
+
+    Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PruneBlocks_Count], 1);
+
+    // Compression does not change the block hashes so the backing store can prune with the same keep list
+    int err = api->m_BackingBlockStore->PruneBlocks(
+        api->m_BackingBlockStore,
+        block_keep_count,
+        block_keep_hashes,
+        async_complete_api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "api->m_BackingBlockStore->PruneBlocks() failed with %d", err)
+        Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PruneBlocks_FailCount], 1);
+        return err;
+    }
+    return 0;
 }
 
 static int CompressBlockStore_GetStats(struct Longtail_BlockStoreAPI* block_store_api, struct Longtail_BlockStore_Stats* out_stats)
@@ -578,12 +1647,24 @@ static int CompressBlockStore_Init(
     void* mem,
     struct Longtail_BlockStoreAPI* backing_block_store,
     struct Longtail_CompressionRegistryAPI* compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    uint32_t split_frame_size,
+    int chunk_aligned_frames,
+    int store_raw_frames,
+    const uint32_t* optional_adaptive_compression_types,
+    uint32_t adaptive_compression_type_count,
     struct Longtail_BlockStoreAPI** out_block_store_api)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(mem, "%p"),
         LONGTAIL_LOGFIELD(backing_block_store, "%p"),
         LONGTAIL_LOGFIELD(compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(split_frame_size, "%u"),
+        LONGTAIL_LOGFIELD(chunk_aligned_frames, "%d"),
+        LONGTAIL_LOGFIELD(store_raw_frames, "%d"),
+        LONGTAIL_LOGFIELD(optional_adaptive_compression_types, "%p"),
+        LONGTAIL_LOGFIELD(adaptive_compression_type_count, "%u"),
         LONGTAIL_LOGFIELD(out_block_store_api, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
@@ -609,11 +1690,32 @@ static int CompressBlockStore_Init(
 
     struct CompressBlockStoreAPI* api = (struct CompressBlockStoreAPI*)block_store_api;
 
+    block_store_api->GetStoredBlockToBuffer = CompressBlockStore_GetStoredBlockToBuffer;
+    block_store_api->GetStoredBlockChunkRange = CompressBlockStore_GetStoredBlockChunkRange;
+
     api->m_BackingBlockStore = backing_block_store;
     api->m_CompressionRegistryAPI = compression_registry;
+    api->m_JobAPI = optional_job_api;
+    api->m_SplitFrameSize = split_frame_size;
+    api->m_ChunkAlignedFrames = chunk_aligned_frames;
+    api->m_StoreRawFrames = store_raw_frames;
     api->m_PendingRequestCount = 0;
     api->m_PendingAsyncFlushAPIs = 0;
 
+    uint32_t* adaptive_compression_types = (uint32_t*)&api[1];
+    for (uint32_t l = 0; l < adaptive_compression_type_count; ++l)
+    {
+        adaptive_compression_types[l] = optional_adaptive_compression_types[l];
+    }
+    api->m_AdaptiveCompressionTypes = adaptive_compression_types;
+    api->m_AdaptiveCompressionTypeCount = adaptive_compression_type_count;
+    api->m_AdaptiveLevel = adaptive_compression_type_count / 2;
+    api->m_AdaptiveCompressSampleCount = 0;
+    api->m_AdaptivePutSampleCount = 0;
+    api->m_AdaptiveCompressUsPerMiB = 0;
+    api->m_AdaptivePutUsPerMiB = 0;
+    api->m_TranscodeCompressionType = 0;
+
     for (uint32_t s = 0; s < Longtail_BlockStoreAPI_StatU64_Count; ++s)
     {
         api->m_StatU64[s] = 0;
@@ -632,10 +1734,100 @@ static int CompressBlockStore_Init(
 struct Longtail_BlockStoreAPI* Longtail_CreateCompressBlockStoreAPI(
     struct Longtail_BlockStoreAPI* backing_block_store,
     struct Longtail_CompressionRegistryAPI* compression_registry)
+{
+    return Longtail_CreateCompressBlockStoreAPI2(backing_block_store, compression_registry, 0, 0);
+}
+
+struct Longtail_BlockStoreAPI* Longtail_CreateCompressBlockStoreAPI2(
+    struct Longtail_BlockStoreAPI* backing_block_store,
+    struct Longtail_CompressionRegistryAPI* compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    uint32_t split_frame_size)
+{
+    return Longtail_CreateCompressBlockStoreAPI3(backing_block_store, compression_registry, optional_job_api, split_frame_size, 0);
+}
+
+struct Longtail_BlockStoreAPI* Longtail_CreateCompressBlockStoreAPI3(
+    struct Longtail_BlockStoreAPI* backing_block_store,
+    struct Longtail_CompressionRegistryAPI* compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    uint32_t split_frame_size,
+    int chunk_aligned_frames)
+{
+    return Longtail_CreateCompressBlockStoreAPI4(backing_block_store, compression_registry, optional_job_api, split_frame_size, chunk_aligned_frames, 0, 0, 0);
+}
+
+struct Longtail_BlockStoreAPI* Longtail_CreateCompressBlockStoreAPI4(
+    struct Longtail_BlockStoreAPI* backing_block_store,
+    struct Longtail_CompressionRegistryAPI* compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    uint32_t split_frame_size,
+    int chunk_aligned_frames,
+    int store_raw_frames,
+    const uint32_t* optional_adaptive_compression_types,
+    uint32_t adaptive_compression_type_count)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(backing_block_store, "%p"),
+        LONGTAIL_LOGFIELD(compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(split_frame_size, "%u"),
+        LONGTAIL_LOGFIELD(chunk_aligned_frames, "%d"),
+        LONGTAIL_LOGFIELD(store_raw_frames, "%d"),
+        LONGTAIL_LOGFIELD(optional_adaptive_compression_types, "%p"),
+        LONGTAIL_LOGFIELD(adaptive_compression_type_count, "%u")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, backing_block_store, return 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, compression_registry, return 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, split_frame_size < COMPRESSBLOCKSTORE_SPLIT_FRAME_FLAG, return 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, adaptive_compression_type_count == 0 || optional_adaptive_compression_types != 0, return 0)
+    for (uint32_t l = 0; l < adaptive_compression_type_count; ++l)
+    {
+        // Levels are only exchangeable within one compression family
+        LONGTAIL_VALIDATE_INPUT(ctx, optional_adaptive_compression_types[l] != 0, return 0)
+        LONGTAIL_VALIDATE_INPUT(ctx, (optional_adaptive_compression_types[l] & 0xffffff00u) == (optional_adaptive_compression_types[0] & 0xffffff00u), return 0)
+    }
+
+    size_t api_size = sizeof(struct CompressBlockStoreAPI) + sizeof(uint32_t) * adaptive_compression_type_count;
+    void* mem = Longtail_Alloc("CompressBlockStore", api_size);
+    if (!mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return 0;
+    }
+    struct Longtail_BlockStoreAPI* block_store_api;
+    int err = CompressBlockStore_Init(
+        mem,
+        backing_block_store,
+        compression_registry,
+        optional_job_api,
+        split_frame_size,
+        chunk_aligned_frames,
+        store_raw_frames,
+        optional_adaptive_compression_types,
+        adaptive_compression_type_count,
+        &block_store_api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompressBlockStore_Init() failed with %d", err)
+        Longtail_Free(mem);
+        return 0;
+    }
+    return block_store_api;
+}
+
+struct Longtail_BlockStoreAPI* Longtail_CreateTranscodeBlockStoreAPI(
+    struct Longtail_BlockStoreAPI* backing_block_store,
+    struct Longtail_CompressionRegistryAPI* compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    uint32_t transcode_compression_type)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(backing_block_store, "%p"),
-        LONGTAIL_LOGFIELD(compression_registry, "%p")
+        LONGTAIL_LOGFIELD(compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(transcode_compression_type, "%u")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
     LONGTAIL_VALIDATE_INPUT(ctx, backing_block_store, return 0)
@@ -653,6 +1845,12 @@ struct Longtail_BlockStoreAPI* Longtail_CreateCompressBlockStoreAPI(
         mem,
         backing_block_store,
         compression_registry,
+        optional_job_api,
+        0,
+        0,
+        0,
+        0,
+        0,
         &block_store_api);
     if (err)
     {
@@ -660,5 +1858,12 @@ struct Longtail_BlockStoreAPI* Longtail_CreateCompressBlockStoreAPI(
         Longtail_Free(mem);
         return 0;
     }
+    struct CompressBlockStoreAPI* api = (struct CompressBlockStoreAPI*)block_store_api;
+    api->m_TranscodeCompressionType = transcode_compression_type;
+    block_store_api->PutStoredBlock = TranscodeBlockStore_PutStoredBlock;
+    block_store_api->GetStoredBlock = TranscodeBlockStore_GetStoredBlock;
+    // GetStoredBlock returns the blocks as they are stored, a decompressing GetStoredBlockToBuffer or GetStoredBlockChunkRange would not match it
+    block_store_api->GetStoredBlockToBuffer = 0;
+    block_store_api->GetStoredBlockChunkRange = 0;
     return block_store_api;
 }
@@ -13,6 +13,105 @@ LONGTAIL_EXPORT extern struct Longtail_BlockStoreAPI* Longtail_CreateCompressBlo
     struct Longtail_BlockStoreAPI* backing_block_store,
     struct Longtail_CompressionRegistryAPI* compression_registry);
 
+LONGTAIL_EXPORT extern struct Longtail_BlockStoreAPI* Longtail_CreateCompressBlockStoreAPI2(
+    struct Longtail_BlockStoreAPI* backing_block_store,
+    struct Longtail_CompressionRegistryAPI* compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    uint32_t split_frame_size);
+
+/*! @brief Creates a compress block store that can decompress a range of chunks of a block.
+ *
+ * Works as Longtail_CreateCompressBlockStoreAPI2 but when @p chunk_aligned_frames is non-zero each frame holds
+ * whole chunks, a frame is closed when the next chunk would make it larger than @p split_frame_size. With a
+ * @p split_frame_size of zero each chunk is compressed as its own frame.
+ * Blocks written with chunk aligned frames can be read by any compress block store.
+ *
+ * @param[in] backing_block_store   The block store to store compressed blocks in
+ * @param[in] compression_registry  The compression registry used to look up the block tag compression
+ * @param[in] optional_job_api      Job API used to compress and decompress frames in parallel, may be null
+ * @param[in] split_frame_size      The max size of a frame, zero to not split blocks unless @p chunk_aligned_frames is set
+ * @param[in] chunk_aligned_frames  Non-zero to only split frames at chunk boundaries
+ * @return                          The block store API, or null on failure
+ */
+LONGTAIL_EXPORT extern struct Longtail_BlockStoreAPI* Longtail_CreateCompressBlockStoreAPI3(
+    struct Longtail_BlockStoreAPI* backing_block_store,
+    struct Longtail_CompressionRegistryAPI* compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    uint32_t split_frame_size,
+    int chunk_aligned_frames);
+
+/*! @brief Creates a compress block store that adapts the compression level to the backing store throughput.
+ *
+ * Works as Longtail_CreateCompressBlockStoreAPI3 but blocks tagged with any of the @p optional_adaptive_compression_types
+ * are compressed with the type at the current adaptive level instead. The block store measures the time to compress
+ * and the time for the backing store to put each block and moves one level up when putting is the bottleneck
+ * and one level down when compressing is the bottleneck. The type used is recorded in the tag of each stored block
+ * so blocks decompress exactly. Adaptation starts at the middle level.
+ *
+ * With @p store_raw_frames set, frames that do not compress, or that look like already compressed data, are stored
+ * uncompressed and are copied instead of decompressed on read. Blocks with raw frames use a frame header that
+ * compress block stores in longtail 0.4.3 and older can not read, leave it at zero for stores read by older versions.
+ *
+ * @param[in] backing_block_store                   The block store to store compressed blocks in
+ * @param[in] compression_registry                  The compression registry used to look up the block tag compression
+ * @param[in] optional_job_api                      Job API used to compress and decompress frames in parallel, may be null
+ * @param[in] split_frame_size                      The max size of a frame, zero to not split blocks unless @p chunk_aligned_frames is set
+ * @param[in] chunk_aligned_frames                  Non-zero to only split frames at chunk boundaries
+ * @param[in] store_raw_frames                      Non-zero to store frames that do not compress uncompressed
+ * @param[in] optional_adaptive_compression_types   Compression types of one compression family ordered from fastest to strongest, may be null
+ * @param[in] adaptive_compression_type_count       Number of compression types in @p optional_adaptive_compression_types
+ * @return                                          The block store API, or null on failure
+ */
+LONGTAIL_EXPORT extern struct Longtail_BlockStoreAPI* Longtail_CreateCompressBlockStoreAPI4(
+    struct Longtail_BlockStoreAPI* backing_block_store,
+    struct Longtail_CompressionRegistryAPI* compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    uint32_t split_frame_size,
+    int chunk_aligned_frames,
+    int store_raw_frames,
+    const uint32_t* optional_adaptive_compression_types,
+    uint32_t adaptive_compression_type_count);
+
+/*! @brief Picks the next adaptive compression level from the measured compress and put throughput.
+ *
+ * Moves one level up when putting is more than 3/2 of the time to compress, one level down when compressing is
+ * more than 3/2 of the time to put and otherwise keeps @p level. The level never leaves [0, @p level_count).
+ *
+ * @param[in] level                 The current level
+ * @param[in] level_count           The number of adaptive compression types
+ * @param[in] compress_us_per_mib   Average time to compress one MiB of uncompressed data at @p level
+ * @param[in] put_us_per_mib        Average time to put one MiB of uncompressed data compressed at @p level
+ * @return                          The level to compress the next blocks at
+ */
+LONGTAIL_EXPORT extern uint32_t Longtail_CompressBlockStore_GetNextAdaptiveLevel(
+    uint32_t level,
+    uint32_t level_count,
+    uint64_t compress_us_per_mib,
+    uint64_t put_us_per_mib);
+
+/*! @brief Creates a block store that stores blocks with a different compression than they are put with.
+ *
+ * Blocks put to the transcode block store are decompressed using their tag and compressed with
+ * @p transcode_compression_type before they are put to @p backing_block_store, the tag of the stored block is set to
+ * @p transcode_compression_type. With a @p transcode_compression_type of zero blocks are stored uncompressed.
+ * GetStoredBlock returns blocks as stored, place a compress block store above to decompress them. It does not implement
+ * GetStoredBlockToBuffer or GetStoredBlockChunkRange.
+ *
+ * Use it for the local block store of a cache block store to store blocks in a format that is fast to decompress,
+ * or uncompressed for memory mapped reads, while the remote block store keeps the high ratio compression.
+ *
+ * @param[in] backing_block_store           The block store to store transcoded blocks in
+ * @param[in] compression_registry          The compression registry used to look up the block tag compression
+ * @param[in] optional_job_api              Job API used to compress and decompress frames in parallel, may be null
+ * @param[in] transcode_compression_type    The compression type to store blocks with, zero to store blocks uncompressed
+ * @return                                  The block store API, or null on failure
+ */
+LONGTAIL_EXPORT extern struct Longtail_BlockStoreAPI* Longtail_CreateTranscodeBlockStoreAPI(
+    struct Longtail_BlockStoreAPI* backing_block_store,
+    struct Longtail_CompressionRegistryAPI* compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    uint32_t transcode_compression_type);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,5 +1,6 @@
 #include "longtail_concurrentchunkwrite.h"
 
+#include "../directorycache/longtail_directorycache.h"
 #include "../longtail_platform.h"
 #include "../../src/ext/stb_ds.h"
 #include <inttypes.h>
@@ -22,6 +23,7 @@ struct ConcurrentChunkWriteAPI
     struct Longtail_StorageAPI* m_StorageAPI;
     const struct Longtail_VersionIndex* m_VersionIndex;
     struct OpenFileEntry** m_AssetEntries;
+    struct Longtail_DirectoryCache* m_DirectoryCache;
     char* m_BasePath;
 };
 
@@ -47,10 +49,10 @@ static int ConcurrentChunkWriteAPI_Open(
     if (open_file_entry->m_SpinLock == 0)
     {
         LONGTAIL_FATAL_ASSERT(ctx, open_file_entry->m_FileHandle == 0, return EINVAL);
-        int err = EnsureParentPathExists(api->m_StorageAPI, open_file_entry->m_FullPath);
+        int err = Longtail_DirectoryCache_EnsureParentPathExists(api->m_DirectoryCache, api->m_StorageAPI, open_file_entry->m_FullPath);
         if (err != 0)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "EnsureParentPathExists() failed with %d", err)
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "Longtail_DirectoryCache_EnsureParentPathExists() failed with %d", err)
             return err;
         }
         err = api->m_StorageAPI->OpenWriteFile(api->m_StorageAPI, open_file_entry->m_FullPath, 0, &open_file_entry->m_FileHandle);
@@ -88,10 +90,10 @@ static int ConcurrentChunkWriteAPI_Open(
     }
     Longtail_UnlockSpinLock(open_file_entry->m_SpinLock);
 
-    int err = EnsureParentPathExists(api->m_StorageAPI, open_file_entry->m_FullPath);
+    int err = Longtail_DirectoryCache_EnsureParentPathExists(api->m_DirectoryCache, api->m_StorageAPI, open_file_entry->m_FullPath);
     if (err != 0)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "EnsureParentPathExists() failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "Longtail_DirectoryCache_EnsureParentPathExists() failed with %d", err)
         return err;
     }
 
@@ -165,6 +167,52 @@ static int ConcurrentChunkWriteAPI_Write(
     return 0;
 }
 
+static int ConcurrentChunkWriteAPI_WriteV(
+    struct Longtail_ConcurrentChunkWriteAPI* concurrent_chunk_write_api,
+    uint32_t asset_index,
+    uint64_t offset,
+    uint32_t vec_count,
+    const struct Longtail_StorageAPI_IOVec* vecs)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(concurrent_chunk_write_api, "%p"),
+        LONGTAIL_LOGFIELD(asset_index, "%u"),
+        LONGTAIL_LOGFIELD(offset, "%" PRIu64),
+        LONGTAIL_LOGFIELD(vec_count, "%u"),
+        LONGTAIL_LOGFIELD(vecs, "%p"),
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, concurrent_chunk_write_api != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, vec_count != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, vecs != 0, return EINVAL);
+
+    struct ConcurrentChunkWriteAPI* api = (struct ConcurrentChunkWriteAPI*)concurrent_chunk_write_api;
+    LONGTAIL_VALIDATE_INPUT(ctx, asset_index < *api->m_VersionIndex->m_AssetCount, return EINVAL);
+
+    struct OpenFileEntry* open_file_entry = api->m_AssetEntries[asset_index];
+    LONGTAIL_FATAL_ASSERT(ctx, open_file_entry != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, open_file_entry->m_ActiveOpenCount > 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, open_file_entry->m_FileHandle != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, open_file_entry->m_FullPath != 0, return EINVAL)
+
+    uint64_t size = 0;
+    for (uint32_t v = 0; v < vec_count; ++v)
+    {
+        size += vecs[v].m_Length;
+    }
+    Longtail_AtomicAdd64(&open_file_entry->m_BytesLeftToWrite, -(int64_t)size);
+    int err = api->m_StorageAPI->WriteV(api->m_StorageAPI, open_file_entry->m_FileHandle, offset, vec_count, vecs);
+    if (err)
+    {
+        return err;
+    }
+    return 0;
+}
+
 static void ConcurrentChunkWriteAPI_Close(
     struct Longtail_ConcurrentChunkWriteAPI* concurrent_chunk_write_api,
     uint32_t asset_index)
@@ -277,18 +325,10 @@ static int ConcurrentChunkWriteAPI_CreateDir(struct Longtail_ConcurrentChunkWrit
     }
     full_asset_path[strlen(full_asset_path) - 1] = '\0';
 
-    int err = EnsureParentPathExists(api->m_StorageAPI, full_asset_path);
+    int err = Longtail_DirectoryCache_CreateDir(api->m_DirectoryCache, api->m_StorageAPI, full_asset_path);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "EnsureParentPathExists() failed with %d", err)
-        Longtail_Free(full_asset_path);
-        return err;
-    }
-
-    err = api->m_StorageAPI->CreateDir(api->m_StorageAPI, full_asset_path);
-    if (err == EEXIST)
-    {
-        err = 0;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "Longtail_DirectoryCache_CreateDir() failed with %d", err)
     }
     Longtail_Free(full_asset_path);
     return err;
@@ -336,6 +376,7 @@ static void ConcurrentChunkWriteAPI_Dispose(struct Longtail_API* concurrent_chun
 
     DisposeFileEntries(api);
 
+    Longtail_DisposeDirectoryCache(api->m_DirectoryCache);
     Longtail_Free(api->m_BasePath);
     Longtail_Free(concurrent_chunk_write_api);
 }
@@ -447,7 +488,8 @@ static int ConcurrentChunkWriteAPI_Init(
         ConcurrentChunkWriteAPI_Open,
         ConcurrentChunkWriteAPI_Close,
         ConcurrentChunkWriteAPI_Write,
-        ConcurrentChunkWriteAPI_Flush);
+        ConcurrentChunkWriteAPI_Flush,
+        ConcurrentChunkWriteAPI_WriteV);
 
     struct ConcurrentChunkWriteAPI* concurrent_chunk_write_api = (struct ConcurrentChunkWriteAPI*)api;
     concurrent_chunk_write_api->m_StorageAPI = storageAPI;
@@ -475,6 +517,12 @@ static int ConcurrentChunkWriteAPI_Init(
             return err;
         }
     }
+    concurrent_chunk_write_api->m_DirectoryCache = Longtail_CreateDirectoryCache();
+    if (concurrent_chunk_write_api->m_DirectoryCache == 0)
+    {
+        DisposeFileEntries(concurrent_chunk_write_api);
+        return ENOMEM;
+    }
     concurrent_chunk_write_api->m_BasePath = Longtail_Strdup(base_path);
 //    concurrent_chunk_write_api->m_MaxOpenFileEntryCount = 0;
     *out_concurrent_chunk_write_api = api;
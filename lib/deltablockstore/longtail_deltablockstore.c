@@ -0,0 +1,1549 @@
+#include "longtail_deltablockstore.h"
+
+#include "../../src/ext/stb_ds.h"
+#include "../longtail_platform.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+
+// Size of the window used both for sketching blocks and for finding matches against the base block
+#define DELTABLOCKSTORE_WINDOW_SIZE 16u
+#define DELTABLOCKSTORE_HASH_MULTIPLIER 0x01000193u
+#define DELTABLOCKSTORE_MIX_MULTIPLIER 0x9E3779B1u
+
+// A window is sampled for the sketch if the top DELTABLOCKSTORE_SAMPLE_BITS of its mixed hash are zero
+#define DELTABLOCKSTORE_SAMPLE_BITS 5u
+#define DELTABLOCKSTORE_MIN_SAMPLE_COUNT 4u
+#define DELTABLOCKSTORE_FEATURE_COUNT 8u
+#define DELTABLOCKSTORE_SUPER_FEATURE_COUNT 4u
+
+// Blocks smaller than this are always stored as is
+#define DELTABLOCKSTORE_MIN_DELTA_BLOCK_SIZE 1024u
+
+// A delta is only stored if it is at most 3/4 of the size of the block data
+#define DELTABLOCKSTORE_MAX_DELTA_SIZE(size) ((size) - (size) / 4u)
+
+#define DELTABLOCKSTORE_DELTA_MAGIC 0x4244544cu
+#define DELTABLOCKSTORE_INDEX_MAGIC 0x4944544cu
+#define DELTABLOCKSTORE_INDEX_VERSION 1u
+
+#define DELTABLOCKSTORE_OP_INSERT 0u
+#define DELTABLOCKSTORE_OP_COPY 1u
+
+// The block data of a delta block starts with this header followed by the delta operations.
+// An insert operation is a DELTABLOCKSTORE_OP_INSERT byte, a uint32_t length and the inserted bytes.
+// A copy operation is a DELTABLOCKSTORE_OP_COPY byte, a uint32_t base block data offset and a uint32_t length.
+// The block index of a delta block is the block index of the full block so the block data size of a delta block
+// never matches the sum of its chunk sizes. Longtail_ValidateStoredBlockData() rejects such blocks so readers without
+// a delta block store fail on delta blocks instead of reading chunks past the end of the block data.
+struct DeltaBlockStore_DeltaHeader
+{
+    uint32_t m_Magic;
+    uint32_t m_BlockChunksDataSize;
+    TLongtail_Hash m_BaseBlockHash;
+};
+
+struct DeltaBlockStore_Sketch
+{
+    uint64_t m_SuperFeatures[DELTABLOCKSTORE_SUPER_FEATURE_COUNT];
+};
+
+struct DeltaBlockStore_SketchLookup
+{
+    TLongtail_Hash key;
+    struct DeltaBlockStore_Sketch value;
+};
+
+struct DeltaBlockStore_FeatureLookup
+{
+    uint64_t key;
+    TLongtail_Hash value;
+};
+
+struct DeltaBlockStore_BaseLookup
+{
+    TLongtail_Hash key;
+    TLongtail_Hash value;
+};
+
+struct DeltaBlockStoreAPI
+{
+    struct Longtail_BlockStoreAPI m_BlockStoreAPI;
+    struct Longtail_BlockStoreAPI* m_BackingBlockStore;
+    struct Longtail_StorageAPI* m_StorageAPI;
+    char* m_IndexPath;
+
+    TLongtail_Atomic64 m_StatU64[Longtail_BlockStoreAPI_StatU64_Count];
+
+    HLongtail_SpinLock m_Lock;
+    struct Longtail_AsyncFlushAPI** m_PendingAsyncFlushAPIs;
+
+    struct DeltaBlockStore_SketchLookup* m_Sketches;
+    struct DeltaBlockStore_FeatureLookup* m_Features;
+    struct DeltaBlockStore_BaseLookup* m_DeltaBases;
+    int m_IndexIsDirty;
+
+    TLongtail_Atomic32 m_PendingRequestCount;
+};
+
+static int DeltaBlockStore_SaveIndex(struct DeltaBlockStoreAPI* api);
+
+static void DeltaBlockStore_CompleteRequest(struct DeltaBlockStoreAPI* deltablockstore_api)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(deltablockstore_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, deltablockstore_api->m_PendingRequestCount > 0, return)
+    struct Longtail_AsyncFlushAPI** pendingAsyncFlushAPIs = 0;
+    Longtail_LockSpinLock(deltablockstore_api->m_Lock);
+    if (0 == Longtail_AtomicAdd32(&deltablockstore_api->m_PendingRequestCount, -1))
+    {
+        pendingAsyncFlushAPIs = deltablockstore_api->m_PendingAsyncFlushAPIs;
+        deltablockstore_api->m_PendingAsyncFlushAPIs = 0;
+    }
+    Longtail_UnlockSpinLock(deltablockstore_api->m_Lock);
+    size_t c = arrlen(pendingAsyncFlushAPIs);
+    int err = c > 0 ? DeltaBlockStore_SaveIndex(deltablockstore_api) : 0;
+    for (size_t n = 0; n < c; ++n)
+    {
+        pendingAsyncFlushAPIs[n]->OnComplete(pendingAsyncFlushAPIs[n], err);
+    }
+    arrfree(pendingAsyncFlushAPIs);
+}
+
+static uint32_t DeltaBlockStore_WindowPower()
+{
+    uint32_t power = 1;
+    for (uint32_t i = 0; i < DELTABLOCKSTORE_WINDOW_SIZE; ++i)
+    {
+        power *= DELTABLOCKSTORE_HASH_MULTIPLIER;
+    }
+    return power;
+}
+
+static uint32_t DeltaBlockStore_WindowHash(const uint8_t* data)
+{
+    uint32_t h = 0;
+    for (uint32_t i = 0; i < DELTABLOCKSTORE_WINDOW_SIZE; ++i)
+    {
+        h = h * DELTABLOCKSTORE_HASH_MULTIPLIER + data[i];
+    }
+    return h;
+}
+
+// Returns 0 if the block is too small or too uniform to be sketched
+static int DeltaBlockStore_ComputeSketch(const uint8_t* data, uint32_t size, struct DeltaBlockStore_Sketch* out_sketch)
+{
+    if (size < DELTABLOCKSTORE_MIN_DELTA_BLOCK_SIZE)
+    {
+        return 0;
+    }
+    static const uint32_t feature_multipliers[DELTABLOCKSTORE_FEATURE_COUNT] = {
+        0x2545F491u, 0x9E3779B9u, 0x85EBCA6Bu, 0xC2B2AE35u, 0x27D4EB2Fu, 0x165667B1u, 0xD3A2646Du, 0xFD7046C5u };
+    static const uint32_t feature_offsets[DELTABLOCKSTORE_FEATURE_COUNT] = {
+        0x68E31DA4u, 0xB5297A4Du, 0x1B56C4E9u, 0x7FEB352Du, 0x846CA68Bu, 0x5BD1E995u, 0xCC9E2D51u, 0x1B873593u };
+
+    uint32_t features[DELTABLOCKSTORE_FEATURE_COUNT];
+    memset(features, 0, sizeof(features));
+    uint32_t sample_count = 0;
+
+    const uint32_t window_power = DeltaBlockStore_WindowPower();
+    uint32_t h = DeltaBlockStore_WindowHash(data);
+    for (uint32_t i = 0; i + DELTABLOCKSTORE_WINDOW_SIZE <= size; ++i)
+    {
+        uint32_t mixed = h * DELTABLOCKSTORE_MIX_MULTIPLIER;
+        if ((mixed >> (32u - DELTABLOCKSTORE_SAMPLE_BITS)) == 0)
+        {
+            for (uint32_t f = 0; f < DELTABLOCKSTORE_FEATURE_COUNT; ++f)
+            {
+                uint32_t v = mixed * feature_multipliers[f] + feature_offsets[f];
+                features[f] = v > features[f] ? v : features[f];
+            }
+            ++sample_count;
+        }
+        if (i + DELTABLOCKSTORE_WINDOW_SIZE < size)
+        {
+            h = h * DELTABLOCKSTORE_HASH_MULTIPLIER + data[i + DELTABLOCKSTORE_WINDOW_SIZE] - data[i] * window_power;
+        }
+    }
+    if (sample_count < DELTABLOCKSTORE_MIN_SAMPLE_COUNT)
+    {
+        return 0;
+    }
+
+    const uint32_t features_per_super_feature = DELTABLOCKSTORE_FEATURE_COUNT / DELTABLOCKSTORE_SUPER_FEATURE_COUNT;
+    for (uint32_t s = 0; s < DELTABLOCKSTORE_SUPER_FEATURE_COUNT; ++s)
+    {
+        // Mix in the super-feature index so equal values at different indexes do not match
+        uint64_t super_feature = (s + 1) * 0x9E3779B97F4A7C15ull;
+        for (uint32_t f = 0; f < features_per_super_feature; ++f)
+        {
+            super_feature = (super_feature ^ features[s * features_per_super_feature + f]) * 0xFF51AFD7ED558CCDull;
+            super_feature ^= super_feature >> 33;
+        }
+        out_sketch->m_SuperFeatures[s] = super_feature;
+    }
+    return 1;
+}
+
+static uint64_t DeltaBlockStore_GetBlockChunksSize(const struct Longtail_BlockIndex* block_index)
+{
+    uint64_t size = 0;
+    uint32_t chunk_count = *block_index->m_ChunkCount;
+    for (uint32_t c = 0; c < chunk_count; ++c)
+    {
+        size += block_index->m_ChunkSizes[c];
+    }
+    return size;
+}
+
+static int DeltaBlockStore_IsDeltaBlock(const struct Longtail_StoredBlock* stored_block, struct DeltaBlockStore_DeltaHeader* out_header)
+{
+    uint64_t block_chunks_size = DeltaBlockStore_GetBlockChunksSize(stored_block->m_BlockIndex);
+    if (block_chunks_size == stored_block->m_BlockChunksDataSize)
+    {
+        return 0;
+    }
+    if (stored_block->m_BlockChunksDataSize < sizeof(struct DeltaBlockStore_DeltaHeader))
+    {
+        return 0;
+    }
+    memcpy(out_header, stored_block->m_BlockData, sizeof(struct DeltaBlockStore_DeltaHeader));
+    return out_header->m_Magic == DELTABLOCKSTORE_DELTA_MAGIC && out_header->m_BlockChunksDataSize == block_chunks_size;
+}
+
+static int DeltaBlockStore_EmitOp(uint8_t* out, uint32_t capacity, uint32_t* pos, uint8_t op, uint32_t a, uint32_t b, const uint8_t* data)
+{
+    uint32_t size = 1 + sizeof(uint32_t) + (op == DELTABLOCKSTORE_OP_COPY ? sizeof(uint32_t) : b);
+    if (capacity - *pos < size)
+    {
+        return ENOSPC;
+    }
+    uint8_t* p = &out[*pos];
+    *p++ = op;
+    if (op == DELTABLOCKSTORE_OP_COPY)
+    {
+        memcpy(p, &a, sizeof(uint32_t));
+        memcpy(&p[sizeof(uint32_t)], &b, sizeof(uint32_t));
+    }
+    else
+    {
+        memcpy(p, &b, sizeof(uint32_t));
+        memcpy(&p[sizeof(uint32_t)], data, b);
+    }
+    *pos += size;
+    return 0;
+}
+
+// Encodes target as copy and insert operations against base. The base block is indexed at window aligned
+// offsets and the target is scanned with a rolling hash at every offset, matches are extended in both directions.
+// Returns ENOSPC if the operations do not fit in out_capacity bytes.
+static int DeltaBlockStore_EncodeDelta(
+    const uint8_t* base,
+    uint32_t base_size,
+    const uint8_t* target,
+    uint32_t target_size,
+    uint8_t* out,
+    uint32_t out_capacity,
+    uint32_t* out_size)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(base, "%p"),
+        LONGTAIL_LOGFIELD(base_size, "%u"),
+        LONGTAIL_LOGFIELD(target, "%p"),
+        LONGTAIL_LOGFIELD(target_size, "%u"),
+        LONGTAIL_LOGFIELD(out, "%p"),
+        LONGTAIL_LOGFIELD(out_capacity, "%u"),
+        LONGTAIL_LOGFIELD(out_size, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    if (base_size < DELTABLOCKSTORE_WINDOW_SIZE || target_size < DELTABLOCKSTORE_WINDOW_SIZE)
+    {
+        return ENOSPC;
+    }
+
+    uint32_t table_bits = 10;
+    while (table_bits < 24 && (1u << table_bits) < (base_size / DELTABLOCKSTORE_WINDOW_SIZE) * 2u)
+    {
+        ++table_bits;
+    }
+    size_t table_size = sizeof(uint32_t) << table_bits;
+    uint32_t* table = (uint32_t*)Longtail_Alloc("DeltaBlockStore", table_size);
+    if (!table)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    memset(table, 0, table_size);
+    for (uint32_t offset = 0; offset + DELTABLOCKSTORE_WINDOW_SIZE <= base_size; offset += DELTABLOCKSTORE_WINDOW_SIZE)
+    {
+        uint32_t slot = (DeltaBlockStore_WindowHash(&base[offset]) * DELTABLOCKSTORE_MIX_MULTIPLIER) >> (32u - table_bits);
+        table[slot] = offset + 1;
+    }
+
+    const uint32_t window_power = DeltaBlockStore_WindowPower();
+    uint32_t pos = 0;
+    uint32_t insert_start = 0;
+    uint32_t i = 0;
+    uint32_t h = 0;
+    int has_hash = 0;
+    int err = 0;
+    while (!err && i + DELTABLOCKSTORE_WINDOW_SIZE <= target_size)
+    {
+        if (!has_hash)
+        {
+            h = DeltaBlockStore_WindowHash(&target[i]);
+            has_hash = 1;
+        }
+        uint32_t candidate = table[(h * DELTABLOCKSTORE_MIX_MULTIPLIER) >> (32u - table_bits)];
+        if (candidate != 0 && memcmp(&base[candidate - 1], &target[i], DELTABLOCKSTORE_WINDOW_SIZE) == 0)
+        {
+            uint32_t match_target = i;
+            uint32_t match_base = candidate - 1;
+            uint32_t match_length = DELTABLOCKSTORE_WINDOW_SIZE;
+            while (match_target + match_length < target_size && match_base + match_length < base_size && target[match_target + match_length] == base[match_base + match_length])
+            {
+                ++match_length;
+            }
+            while (match_target > insert_start && match_base > 0 && target[match_target - 1] == base[match_base - 1])
+            {
+                --match_target;
+                --match_base;
+                ++match_length;
+            }
+            if (match_target > insert_start)
+            {
+                err = DeltaBlockStore_EmitOp(out, out_capacity, &pos, DELTABLOCKSTORE_OP_INSERT, 0, match_target - insert_start, &target[insert_start]);
+            }
+            if (!err)
+            {
+                err = DeltaBlockStore_EmitOp(out, out_capacity, &pos, DELTABLOCKSTORE_OP_COPY, match_base, match_length, 0);
+            }
+            i = match_target + match_length;
+            insert_start = i;
+            has_hash = 0;
+            continue;
+        }
+        if (i + DELTABLOCKSTORE_WINDOW_SIZE < target_size)
+        {
+            h = h * DELTABLOCKSTORE_HASH_MULTIPLIER + target[i + DELTABLOCKSTORE_WINDOW_SIZE] - target[i] * window_power;
+        }
+        ++i;
+    }
+    if (!err && insert_start < target_size)
+    {
+        err = DeltaBlockStore_EmitOp(out, out_capacity, &pos, DELTABLOCKSTORE_OP_INSERT, 0, target_size - insert_start, &target[insert_start]);
+    }
+    Longtail_Free(table);
+    if (err)
+    {
+        return err;
+    }
+    *out_size = pos;
+    return 0;
+}
+
+static int DeltaBlockStore_DecodeDelta(
+    const uint8_t* base,
+    uint32_t base_size,
+    const uint8_t* ops,
+    uint32_t ops_size,
+    uint8_t* target,
+    uint32_t target_size)
+{
+    uint32_t pos = 0;
+    uint32_t target_offset = 0;
+    while (pos < ops_size)
+    {
+        uint8_t op = ops[pos++];
+        uint32_t a;
+        uint32_t b;
+        if (op == DELTABLOCKSTORE_OP_COPY)
+        {
+            if (ops_size - pos < sizeof(uint32_t) * 2)
+            {
+                return EBADF;
+            }
+            memcpy(&a, &ops[pos], sizeof(uint32_t));
+            memcpy(&b, &ops[pos + sizeof(uint32_t)], sizeof(uint32_t));
+            pos += sizeof(uint32_t) * 2;
+            if (a > base_size || base_size - a < b || target_size - target_offset < b)
+            {
+                return EBADF;
+            }
+            memcpy(&target[target_offset], &base[a], b);
+        }
+        else if (op == DELTABLOCKSTORE_OP_INSERT)
+        {
+            if (ops_size - pos < sizeof(uint32_t))
+            {
+                return EBADF;
+            }
+            memcpy(&b, &ops[pos], sizeof(uint32_t));
+            pos += sizeof(uint32_t);
+            if (ops_size - pos < b || target_size - target_offset < b)
+            {
+                return EBADF;
+            }
+            memcpy(&target[target_offset], &ops[pos], b);
+            pos += b;
+        }
+        else
+        {
+            return EBADF;
+        }
+        target_offset += b;
+    }
+    return target_offset == target_size ? 0 : EBADF;
+}
+
+// Must be called with the lock held
+static int DeltaBlockStore_FindBaseBlock(struct DeltaBlockStoreAPI* api, TLongtail_Hash block_hash, const struct DeltaBlockStore_Sketch* sketch, TLongtail_Hash* out_base_block_hash)
+{
+    TLongtail_Hash candidates[DELTABLOCKSTORE_SUPER_FEATURE_COUNT];
+    uint32_t votes[DELTABLOCKSTORE_SUPER_FEATURE_COUNT];
+    uint32_t candidate_count = 0;
+    for (uint32_t s = 0; s < DELTABLOCKSTORE_SUPER_FEATURE_COUNT; ++s)
+    {
+        intptr_t i = hmgeti(api->m_Features, sketch->m_SuperFeatures[s]);
+        if (i == -1 || api->m_Features[i].value == block_hash)
+        {
+            continue;
+        }
+        TLongtail_Hash candidate = api->m_Features[i].value;
+        uint32_t c = 0;
+        while (c < candidate_count && candidates[c] != candidate)
+        {
+            ++c;
+        }
+        if (c == candidate_count)
+        {
+            candidates[candidate_count] = candidate;
+            votes[candidate_count++] = 0;
+        }
+        ++votes[c];
+    }
+    if (candidate_count == 0)
+    {
+        return 0;
+    }
+    // The candidate sharing the most super-features is the most similar block
+    uint32_t best = 0;
+    for (uint32_t c = 1; c < candidate_count; ++c)
+    {
+        if (votes[c] > votes[best])
+        {
+            best = c;
+        }
+    }
+    *out_base_block_hash = candidates[best];
+    return 1;
+}
+
+// Must be called with the lock held
+static void DeltaBlockStore_AddSketch(struct DeltaBlockStoreAPI* api, TLongtail_Hash block_hash, const struct DeltaBlockStore_Sketch* sketch)
+{
+    hmput(api->m_Sketches, block_hash, *sketch);
+    for (uint32_t s = 0; s < DELTABLOCKSTORE_SUPER_FEATURE_COUNT; ++s)
+    {
+        hmput(api->m_Features, sketch->m_SuperFeatures[s], block_hash);
+    }
+}
+
+static int DeltaBlockStore_LoadIndex(struct DeltaBlockStoreAPI* api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    struct Longtail_StorageAPI* storage_api = api->m_StorageAPI;
+    if (!storage_api->IsFile(storage_api, api->m_IndexPath))
+    {
+        return 0;
+    }
+    Longtail_StorageAPI_HOpenFile f;
+    int err = storage_api->OpenReadFile(storage_api, api->m_IndexPath, &f);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+        return err;
+    }
+    uint64_t size;
+    err = storage_api->GetSize(storage_api, f, &size);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetSize() failed with %d", err)
+        storage_api->CloseFile(storage_api, f);
+        return err;
+    }
+    uint8_t* buffer = (uint8_t*)Longtail_Alloc("DeltaBlockStore", size ? size : 1);
+    if (!buffer)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        storage_api->CloseFile(storage_api, f);
+        return ENOMEM;
+    }
+    err = storage_api->Read(storage_api, f, 0, size, buffer);
+    storage_api->CloseFile(storage_api, f);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
+        Longtail_Free(buffer);
+        return err;
+    }
+
+    uint32_t header[4];
+    if (size < sizeof(header))
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Delta index `%s` is truncated, failed with %d", api->m_IndexPath, EBADF)
+        Longtail_Free(buffer);
+        return EBADF;
+    }
+    memcpy(header, buffer, sizeof(header));
+    uint32_t sketch_count = header[2];
+    uint32_t delta_count = header[3];
+    const uint64_t sketch_record_size = sizeof(TLongtail_Hash) + sizeof(struct DeltaBlockStore_Sketch);
+    const uint64_t delta_record_size = sizeof(TLongtail_Hash) * 2;
+    if (header[0] != DELTABLOCKSTORE_INDEX_MAGIC ||
+        header[1] != DELTABLOCKSTORE_INDEX_VERSION ||
+        size != sizeof(header) + sketch_count * sketch_record_size + delta_count * delta_record_size)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Delta index `%s` is invalid, failed with %d", api->m_IndexPath, EBADF)
+        Longtail_Free(buffer);
+        return EBADF;
+    }
+    const uint8_t* p = &buffer[sizeof(header)];
+    for (uint32_t s = 0; s < sketch_count; ++s)
+    {
+        TLongtail_Hash block_hash;
+        struct DeltaBlockStore_Sketch sketch;
+        memcpy(&block_hash, p, sizeof(TLongtail_Hash));
+        memcpy(&sketch, &p[sizeof(TLongtail_Hash)], sizeof(struct DeltaBlockStore_Sketch));
+        DeltaBlockStore_AddSketch(api, block_hash, &sketch);
+        p += sketch_record_size;
+    }
+    for (uint32_t d = 0; d < delta_count; ++d)
+    {
+        TLongtail_Hash hashes[2];
+        memcpy(hashes, p, sizeof(hashes));
+        hmput(api->m_DeltaBases, hashes[0], hashes[1]);
+        p += delta_record_size;
+    }
+    Longtail_Free(buffer);
+    return 0;
+}
+
+static int DeltaBlockStore_SaveIndex(struct DeltaBlockStoreAPI* api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    if (api->m_IndexPath == 0)
+    {
+        return 0;
+    }
+
+    Longtail_LockSpinLock(api->m_Lock);
+    if (!api->m_IndexIsDirty)
+    {
+        Longtail_UnlockSpinLock(api->m_Lock);
+        return 0;
+    }
+    uint32_t sketch_count = (uint32_t)hmlen(api->m_Sketches);
+    uint32_t delta_count = (uint32_t)hmlen(api->m_DeltaBases);
+    const size_t sketch_record_size = sizeof(TLongtail_Hash) + sizeof(struct DeltaBlockStore_Sketch);
+    const size_t delta_record_size = sizeof(TLongtail_Hash) * 2;
+    uint32_t header[4] = { DELTABLOCKSTORE_INDEX_MAGIC, DELTABLOCKSTORE_INDEX_VERSION, sketch_count, delta_count };
+    size_t size = sizeof(header) + sketch_count * sketch_record_size + delta_count * delta_record_size;
+    uint8_t* buffer = (uint8_t*)Longtail_Alloc("DeltaBlockStore", size);
+    if (!buffer)
+    {
+        Longtail_UnlockSpinLock(api->m_Lock);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    memcpy(buffer, header, sizeof(header));
+    uint8_t* p = &buffer[sizeof(header)];
+    for (uint32_t s = 0; s < sketch_count; ++s)
+    {
+        memcpy(p, &api->m_Sketches[s].key, sizeof(TLongtail_Hash));
+        memcpy(&p[sizeof(TLongtail_Hash)], &api->m_Sketches[s].value, sizeof(struct DeltaBlockStore_Sketch));
+        p += sketch_record_size;
+    }
+    for (uint32_t d = 0; d < delta_count; ++d)
+    {
+        memcpy(p, &api->m_DeltaBases[d].key, sizeof(TLongtail_Hash));
+        memcpy(&p[sizeof(TLongtail_Hash)], &api->m_DeltaBases[d].value, sizeof(TLongtail_Hash));
+        p += delta_record_size;
+    }
+    api->m_IndexIsDirty = 0;
+    Longtail_UnlockSpinLock(api->m_Lock);
+
+    struct Longtail_StorageAPI* storage_api = api->m_StorageAPI;
+    size_t index_path_length = strlen(api->m_IndexPath);
+    char* tmp_index_path = (char*)Longtail_Alloc("DeltaBlockStore", index_path_length + 5);
+    if (!tmp_index_path)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(buffer);
+        api->m_IndexIsDirty = 1;
+        return ENOMEM;
+    }
+    memcpy(tmp_index_path, api->m_IndexPath, index_path_length);
+    strcpy(&tmp_index_path[index_path_length], ".tmp");
+
+    int err = EnsureParentPathExists(storage_api, tmp_index_path);
+    Longtail_StorageAPI_HOpenFile f = 0;
+    if (!err)
+    {
+        err = storage_api->OpenWriteFile(storage_api, tmp_index_path, 0, &f);
+    }
+    if (!err)
+    {
+        err = storage_api->Write(storage_api, f, 0, size, buffer);
+        storage_api->CloseFile(storage_api, f);
+    }
+    if (!err && storage_api->IsFile(storage_api, api->m_IndexPath))
+    {
+        err = storage_api->RemoveFile(storage_api, api->m_IndexPath);
+    }
+    if (!err)
+    {
+        err = storage_api->RenameFile(storage_api, tmp_index_path, api->m_IndexPath);
+    }
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to write delta index `%s`, failed with %d", api->m_IndexPath, err)
+        storage_api->RemoveFile(storage_api, tmp_index_path);
+        Longtail_LockSpinLock(api->m_Lock);
+        api->m_IndexIsDirty = 1;
+        Longtail_UnlockSpinLock(api->m_Lock);
+    }
+    Longtail_Free(tmp_index_path);
+    Longtail_Free(buffer);
+    return err;
+}
+
+struct DeltaBlockStore_OnPutAsync_API
+{
+    struct Longtail_AsyncPutStoredBlockAPI m_API;
+    struct DeltaBlockStoreAPI* m_BlockStore;
+    struct Longtail_StoredBlock* m_StoredBlock;
+    struct Longtail_StoredBlock* m_DeltaBlock;
+    struct Longtail_AsyncPutStoredBlockAPI* m_AsyncCompleteAPI;
+    TLongtail_Hash m_BaseBlockHash;
+    int m_HasSketch;
+    struct DeltaBlockStore_Sketch m_Sketch;
+};
+
+struct DeltaBlockStore_OnGetBaseAsync_API
+{
+    struct Longtail_AsyncGetStoredBlockAPI m_API;
+    struct DeltaBlockStore_OnPutAsync_API* m_PutAsyncAPI;
+};
+
+static void DeltaBlockStore_OnPutBackingStoreComplete(struct Longtail_AsyncPutStoredBlockAPI* async_complete_api, int err)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(err, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api, return)
+    struct DeltaBlockStore_OnPutAsync_API* put_async_api = (struct DeltaBlockStore_OnPutAsync_API*)async_complete_api;
+    struct DeltaBlockStoreAPI* deltablockstore_api = put_async_api->m_BlockStore;
+    if (err)
+    {
+        Longtail_AtomicAdd64(&deltablockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
+    }
+    else if (put_async_api->m_DeltaBlock || put_async_api->m_HasSketch)
+    {
+        TLongtail_Hash block_hash = *put_async_api->m_StoredBlock->m_BlockIndex->m_BlockHash;
+        Longtail_LockSpinLock(deltablockstore_api->m_Lock);
+        if (put_async_api->m_DeltaBlock)
+        {
+            hmput(deltablockstore_api->m_DeltaBases, block_hash, put_async_api->m_BaseBlockHash);
+        }
+        else
+        {
+            DeltaBlockStore_AddSketch(deltablockstore_api, block_hash, &put_async_api->m_Sketch);
+        }
+        deltablockstore_api->m_IndexIsDirty = 1;
+        Longtail_UnlockSpinLock(deltablockstore_api->m_Lock);
+    }
+    SAFE_DISPOSE_STORED_BLOCK(put_async_api->m_DeltaBlock);
+    put_async_api->m_AsyncCompleteAPI->OnComplete(put_async_api->m_AsyncCompleteAPI, err);
+    Longtail_Free(put_async_api);
+    DeltaBlockStore_CompleteRequest(deltablockstore_api);
+}
+
+static int DeltaBlockStore_PutToBackingStore(struct DeltaBlockStore_OnPutAsync_API* put_async_api)
+{
+    struct DeltaBlockStoreAPI* deltablockstore_api = put_async_api->m_BlockStore;
+    struct Longtail_StoredBlock* to_store = put_async_api->m_DeltaBlock ? put_async_api->m_DeltaBlock : put_async_api->m_StoredBlock;
+    return deltablockstore_api->m_BackingBlockStore->PutStoredBlock(deltablockstore_api->m_BackingBlockStore, to_store, &put_async_api->m_API);
+}
+
+// Creates the delta block for put_async_api->m_StoredBlock, leaves put_async_api->m_DeltaBlock at zero if the delta is not small enough
+static int DeltaBlockStore_CreateDeltaBlock(struct DeltaBlockStore_OnPutAsync_API* put_async_api, const struct Longtail_StoredBlock* base_block)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(put_async_api, "%p"),
+        LONGTAIL_LOGFIELD(base_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    struct DeltaBlockStore_DeltaHeader base_header;
+    if (DeltaBlockStore_IsDeltaBlock(base_block, &base_header))
+    {
+        return 0;
+    }
+    struct Longtail_StoredBlock* stored_block = put_async_api->m_StoredBlock;
+    struct Longtail_BlockIndex* block_index = stored_block->m_BlockIndex;
+    uint32_t block_chunks_data_size = stored_block->m_BlockChunksDataSize;
+    uint32_t max_delta_size = DELTABLOCKSTORE_MAX_DELTA_SIZE(block_chunks_data_size);
+    if (max_delta_size <= sizeof(struct DeltaBlockStore_DeltaHeader))
+    {
+        return 0;
+    }
+
+    struct Longtail_StoredBlock* delta_block;
+    int err = Longtail_CreateStoredBlock(
+        *block_index->m_BlockHash,
+        *block_index->m_HashIdentifier,
+        *block_index->m_ChunkCount,
+        *block_index->m_Tag,
+        block_index->m_ChunkHashes,
+        block_index->m_ChunkSizes,
+        max_delta_size,
+        &delta_block);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoredBlock() failed with %d", err)
+        return err;
+    }
+
+    uint8_t* delta_data = (uint8_t*)delta_block->m_BlockData;
+    uint32_t ops_size;
+    err = DeltaBlockStore_EncodeDelta(
+        (const uint8_t*)base_block->m_BlockData,
+        base_block->m_BlockChunksDataSize,
+        (const uint8_t*)stored_block->m_BlockData,
+        block_chunks_data_size,
+        &delta_data[sizeof(struct DeltaBlockStore_DeltaHeader)],
+        max_delta_size - (uint32_t)sizeof(struct DeltaBlockStore_DeltaHeader),
+        &ops_size);
+    if (err == ENOSPC)
+    {
+        delta_block->Dispose(delta_block);
+        return 0;
+    }
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "DeltaBlockStore_EncodeDelta() failed with %d", err)
+        delta_block->Dispose(delta_block);
+        return err;
+    }
+    struct DeltaBlockStore_DeltaHeader header;
+    header.m_Magic = DELTABLOCKSTORE_DELTA_MAGIC;
+    header.m_BlockChunksDataSize = block_chunks_data_size;
+    header.m_BaseBlockHash = *base_block->m_BlockIndex->m_BlockHash;
+    memcpy(delta_data, &header, sizeof(struct DeltaBlockStore_DeltaHeader));
+    delta_block->m_BlockChunksDataSize = (uint32_t)sizeof(struct DeltaBlockStore_DeltaHeader) + ops_size;
+    put_async_api->m_DeltaBlock = delta_block;
+    return 0;
+}
+
+static void DeltaBlockStore_OnGetBaseComplete(struct Longtail_AsyncGetStoredBlockAPI* async_complete_api, struct Longtail_StoredBlock* stored_block, int err)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(err, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api, return)
+    struct DeltaBlockStore_OnGetBaseAsync_API* get_base_async_api = (struct DeltaBlockStore_OnGetBaseAsync_API*)async_complete_api;
+    struct DeltaBlockStore_OnPutAsync_API* put_async_api = get_base_async_api->m_PutAsyncAPI;
+    Longtail_Free(get_base_async_api);
+
+    if (err)
+    {
+        // The base block is gone, store the block as is
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "Failed to get base block 0x%" PRIx64 ", failed with %d", put_async_api->m_BaseBlockHash, err)
+    }
+    else
+    {
+        err = DeltaBlockStore_CreateDeltaBlock(put_async_api, stored_block);
+        SAFE_DISPOSE_STORED_BLOCK(stored_block);
+        if (err)
+        {
+            DeltaBlockStore_OnPutBackingStoreComplete(&put_async_api->m_API, err);
+            return;
+        }
+    }
+    err = DeltaBlockStore_PutToBackingStore(put_async_api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "DeltaBlockStore_PutToBackingStore() failed with %d", err)
+        DeltaBlockStore_OnPutBackingStoreComplete(&put_async_api->m_API, err);
+    }
+}
+
+static int DeltaBlockStore_PutStoredBlock(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    struct Longtail_StoredBlock* stored_block,
+    struct Longtail_AsyncPutStoredBlockAPI* async_complete_api)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, stored_block, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL);
+
+    struct DeltaBlockStoreAPI* block_store = (struct DeltaBlockStoreAPI*)block_store_api;
+
+    Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_Count], 1);
+    Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_Chunk_Count], *stored_block->m_BlockIndex->m_ChunkCount);
+    Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_Byte_Count], Longtail_GetBlockIndexDataSize(*stored_block->m_BlockIndex->m_ChunkCount) + stored_block->m_BlockChunksDataSize);
+
+    size_t put_async_api_size = sizeof(struct DeltaBlockStore_OnPutAsync_API);
+    struct DeltaBlockStore_OnPutAsync_API* put_async_api = (struct DeltaBlockStore_OnPutAsync_API*)Longtail_Alloc("DeltaBlockStore", put_async_api_size);
+    if (!put_async_api)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
+        return ENOMEM;
+    }
+    put_async_api->m_API.OnComplete = DeltaBlockStore_OnPutBackingStoreComplete;
+    put_async_api->m_API.m_API.Dispose = 0;
+    put_async_api->m_BlockStore = block_store;
+    put_async_api->m_StoredBlock = stored_block;
+    put_async_api->m_DeltaBlock = 0;
+    put_async_api->m_AsyncCompleteAPI = async_complete_api;
+    put_async_api->m_BaseBlockHash = 0;
+    put_async_api->m_HasSketch = DeltaBlockStore_ComputeSketch((const uint8_t*)stored_block->m_BlockData, stored_block->m_BlockChunksDataSize, &put_async_api->m_Sketch);
+
+    int has_base_block = 0;
+    if (put_async_api->m_HasSketch)
+    {
+        Longtail_LockSpinLock(block_store->m_Lock);
+        has_base_block = DeltaBlockStore_FindBaseBlock(block_store, *stored_block->m_BlockIndex->m_BlockHash, &put_async_api->m_Sketch, &put_async_api->m_BaseBlockHash);
+        Longtail_UnlockSpinLock(block_store->m_Lock);
+    }
+
+    Longtail_AtomicAdd32(&block_store->m_PendingRequestCount, 1);
+    if (has_base_block)
+    {
+        size_t get_base_async_api_size = sizeof(struct DeltaBlockStore_OnGetBaseAsync_API);
+        struct DeltaBlockStore_OnGetBaseAsync_API* get_base_async_api = (struct DeltaBlockStore_OnGetBaseAsync_API*)Longtail_Alloc("DeltaBlockStore", get_base_async_api_size);
+        if (!get_base_async_api)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+            Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
+            Longtail_Free(put_async_api);
+            DeltaBlockStore_CompleteRequest(block_store);
+            return ENOMEM;
+        }
+        get_base_async_api->m_API.OnComplete = DeltaBlockStore_OnGetBaseComplete;
+        get_base_async_api->m_API.m_API.Dispose = 0;
+        get_base_async_api->m_PutAsyncAPI = put_async_api;
+        int err = block_store->m_BackingBlockStore->GetStoredBlock(block_store->m_BackingBlockStore, put_async_api->m_BaseBlockHash, &get_base_async_api->m_API);
+        if (err == 0)
+        {
+            return 0;
+        }
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "block_store->m_BackingBlockStore->GetStoredBlock() failed with %d", err)
+        Longtail_Free(get_base_async_api);
+    }
+
+    int err = DeltaBlockStore_PutToBackingStore(put_async_api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "DeltaBlockStore_PutToBackingStore() failed with %d", err)
+        Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
+        Longtail_Free(put_async_api);
+        DeltaBlockStore_CompleteRequest(block_store);
+    }
+    return err;
+}
+
+static int DeltaBlockStore_PreflightGet(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint32_t block_count,
+    const TLongtail_Hash* block_hashes,
+    struct Longtail_AsyncPreflightStartedAPI* optional_async_complete_api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(block_hashes, "%p"),
+        LONGTAIL_LOGFIELD(optional_async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, (block_count == 0) || (block_hashes != 0), return EINVAL)
+    struct DeltaBlockStoreAPI* api = (struct DeltaBlockStoreAPI*)block_store_api;
+    Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PreflightGet_Count], 1);
+    int err = api->m_BackingBlockStore->PreflightGet(
+        api->m_BackingBlockStore,
+        block_count,
+        block_hashes,
+        optional_async_complete_api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "api->m_BackingBlockStore->PreflightGet() failed with %d", err)
+        Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PreflightGet_FailCount], 1);
+    }
+    return err;
+}
+
+struct DeltaBlockStore_OnGetAsync_API
+{
+    struct Longtail_AsyncGetStoredBlockAPI m_API;
+    struct DeltaBlockStoreAPI* m_BlockStore;
+    struct Longtail_AsyncGetStoredBlockAPI* m_AsyncCompleteAPI;
+    struct Longtail_StoredBlock* m_DeltaBlock;
+};
+
+static void DeltaBlockStore_CompleteGet(struct DeltaBlockStore_OnGetAsync_API* get_async_api, struct Longtail_StoredBlock* stored_block, int err)
+{
+    struct DeltaBlockStoreAPI* deltablockstore_api = get_async_api->m_BlockStore;
+    if (err && err != ENOENT)
+    {
+        Longtail_AtomicAdd64(&deltablockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_FailCount], 1);
+    }
+    if (stored_block)
+    {
+        Longtail_AtomicAdd64(&deltablockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Chunk_Count], *stored_block->m_BlockIndex->m_ChunkCount);
+        Longtail_AtomicAdd64(&deltablockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Byte_Count], Longtail_GetBlockIndexDataSize(*stored_block->m_BlockIndex->m_ChunkCount) + stored_block->m_BlockChunksDataSize);
+    }
+    SAFE_DISPOSE_STORED_BLOCK(get_async_api->m_DeltaBlock);
+    get_async_api->m_AsyncCompleteAPI->OnComplete(get_async_api->m_AsyncCompleteAPI, stored_block, err);
+    Longtail_Free(get_async_api);
+    DeltaBlockStore_CompleteRequest(deltablockstore_api);
+}
+
+static void DeltaBlockStore_OnGetDeltaBaseComplete(struct Longtail_AsyncGetStoredBlockAPI* async_complete_api, struct Longtail_StoredBlock* stored_block, int err)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(err, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api, return)
+    struct DeltaBlockStore_OnGetAsync_API* get_async_api = (struct DeltaBlockStore_OnGetAsync_API*)async_complete_api;
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to get base block of delta block, failed with %d", err)
+        DeltaBlockStore_CompleteGet(get_async_api, 0, err == ENOENT ? EBADF : err);
+        return;
+    }
+
+    struct Longtail_StoredBlock* delta_block = get_async_api->m_DeltaBlock;
+    struct Longtail_BlockIndex* block_index = delta_block->m_BlockIndex;
+    struct DeltaBlockStore_DeltaHeader header;
+    memcpy(&header, delta_block->m_BlockData, sizeof(struct DeltaBlockStore_DeltaHeader));
+    struct DeltaBlockStore_DeltaHeader base_header;
+    if (DeltaBlockStore_IsDeltaBlock(stored_block, &base_header))
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Base block 0x%" PRIx64 " is a delta block, failed with %d", header.m_BaseBlockHash, EBADF)
+        stored_block->Dispose(stored_block);
+        DeltaBlockStore_CompleteGet(get_async_api, 0, EBADF);
+        return;
+    }
+
+    struct Longtail_StoredBlock* full_block;
+    err = Longtail_CreateStoredBlock(
+        *block_index->m_BlockHash,
+        *block_index->m_HashIdentifier,
+        *block_index->m_ChunkCount,
+        *block_index->m_Tag,
+        block_index->m_ChunkHashes,
+        block_index->m_ChunkSizes,
+        header.m_BlockChunksDataSize,
+        &full_block);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoredBlock() failed with %d", err)
+        stored_block->Dispose(stored_block);
+        DeltaBlockStore_CompleteGet(get_async_api, 0, err);
+        return;
+    }
+    err = DeltaBlockStore_DecodeDelta(
+        (const uint8_t*)stored_block->m_BlockData,
+        stored_block->m_BlockChunksDataSize,
+        &((const uint8_t*)delta_block->m_BlockData)[sizeof(struct DeltaBlockStore_DeltaHeader)],
+        delta_block->m_BlockChunksDataSize - (uint32_t)sizeof(struct DeltaBlockStore_DeltaHeader),
+        (uint8_t*)full_block->m_BlockData,
+        header.m_BlockChunksDataSize);
+    stored_block->Dispose(stored_block);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "DeltaBlockStore_DecodeDelta() failed with %d", err)
+        full_block->Dispose(full_block);
+        DeltaBlockStore_CompleteGet(get_async_api, 0, err);
+        return;
+    }
+    DeltaBlockStore_CompleteGet(get_async_api, full_block, 0);
+}
+
+static void DeltaBlockStore_OnGetBackingStoreComplete(struct Longtail_AsyncGetStoredBlockAPI* async_complete_api, struct Longtail_StoredBlock* stored_block, int err)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(err, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api, return)
+    struct DeltaBlockStore_OnGetAsync_API* get_async_api = (struct DeltaBlockStore_OnGetAsync_API*)async_complete_api;
+    struct DeltaBlockStoreAPI* deltablockstore_api = get_async_api->m_BlockStore;
+    struct DeltaBlockStore_DeltaHeader header;
+    if (err || !DeltaBlockStore_IsDeltaBlock(stored_block, &header))
+    {
+        if (err && err != ENOENT)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "DeltaBlockStore_OnGetBackingStoreComplete called with error %d", err)
+        }
+        else if (err == 0)
+        {
+            // A block that is not a delta block must hold the chunks of its block index
+            err = Longtail_ValidateStoredBlockData(stored_block);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Block is neither a full block nor a delta block, failed with %d", err)
+                SAFE_DISPOSE_STORED_BLOCK(stored_block);
+            }
+        }
+        DeltaBlockStore_CompleteGet(get_async_api, stored_block, err);
+        return;
+    }
+
+    get_async_api->m_DeltaBlock = stored_block;
+    get_async_api->m_API.OnComplete = DeltaBlockStore_OnGetDeltaBaseComplete;
+    err = deltablockstore_api->m_BackingBlockStore->GetStoredBlock(deltablockstore_api->m_BackingBlockStore, header.m_BaseBlockHash, &get_async_api->m_API);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "deltablockstore_api->m_BackingBlockStore->GetStoredBlock() failed with %d", err)
+        DeltaBlockStore_CompleteGet(get_async_api, 0, err == ENOENT ? EBADF : err);
+    }
+}
+
+// Reads the block into buffer if one is given, a delta block read into buffer is decoded into a new full block
+static int DeltaBlockStore_GetBlock(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint64_t block_hash,
+    void* buffer,
+    uint32_t buffer_size,
+    struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(buffer_size, "%u"),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    struct DeltaBlockStoreAPI* block_store = (struct DeltaBlockStoreAPI*)block_store_api;
+
+    Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count], 1);
+
+    size_t get_async_api_size = sizeof(struct DeltaBlockStore_OnGetAsync_API);
+    struct DeltaBlockStore_OnGetAsync_API* get_async_api = (struct DeltaBlockStore_OnGetAsync_API*)Longtail_Alloc("DeltaBlockStore", get_async_api_size);
+    if (!get_async_api)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+
+    get_async_api->m_API.OnComplete = DeltaBlockStore_OnGetBackingStoreComplete;
+    get_async_api->m_API.m_API.Dispose = 0;
+    get_async_api->m_BlockStore = block_store;
+    get_async_api->m_AsyncCompleteAPI = async_complete_api;
+    get_async_api->m_DeltaBlock = 0;
+
+    Longtail_AtomicAdd32(&block_store->m_PendingRequestCount, 1);
+    int err = buffer ?
+        block_store->m_BackingBlockStore->GetStoredBlockToBuffer(block_store->m_BackingBlockStore, block_hash, buffer, buffer_size, &get_async_api->m_API) :
+        block_store->m_BackingBlockStore->GetStoredBlock(block_store->m_BackingBlockStore, block_hash, &get_async_api->m_API);
+    if (err)
+    {
+        if (err != ENOENT)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_store->m_BackingBlockStore->GetStoredBlock() failed with %d", err)
+            Longtail_AtomicAdd64(&block_store->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_FailCount], 1);
+        }
+        Longtail_Free(get_async_api);
+        DeltaBlockStore_CompleteRequest(block_store);
+        return err;
+    }
+    return 0;
+}
+
+static int DeltaBlockStore_GetStoredBlock(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint64_t block_hash,
+    struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
+    return DeltaBlockStore_GetBlock(block_store_api, block_hash, 0, 0, async_complete_api);
+}
+
+static int DeltaBlockStore_GetStoredBlockToBuffer(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint64_t block_hash,
+    void* buffer,
+    uint32_t buffer_size,
+    struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(buffer_size, "%u"),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, buffer, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
+    return DeltaBlockStore_GetBlock(block_store_api, block_hash, buffer, buffer_size, async_complete_api);
+}
+
+static int DeltaBlockStore_GetExistingContent(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint32_t chunk_count,
+    const TLongtail_Hash* chunk_hashes,
+    uint32_t min_block_usage_percent,
+    struct Longtail_AsyncGetExistingContentAPI* async_complete_api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u"),
+        LONGTAIL_LOGFIELD(chunk_hashes, "%p"),
+        LONGTAIL_LOGFIELD(min_block_usage_percent, "%u"),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, (chunk_count == 0) || (chunk_hashes != 0), return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
+
+    struct DeltaBlockStoreAPI* api = (struct DeltaBlockStoreAPI*)block_store_api;
+
+    Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetExistingContent_Count], 1);
+
+    int err = api->m_BackingBlockStore->GetExistingContent(
+        api->m_BackingBlockStore,
+        chunk_count,
+        chunk_hashes,
+        min_block_usage_percent,
+        async_complete_api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "api->m_BackingBlockStore->GetExistingContent() failed with %d", err)
+        Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetExistingContent_FailCount], 1);
+        return err;
+    }
+    return 0;
+}
+
+struct DeltaBlockStore_KeepLookup
+{
+    TLongtail_Hash key;
+    uint32_t value;
+};
+
+struct DeltaBlockStore_OnPruneAsync_API
+{
+    struct Longtail_AsyncPruneBlocksAPI m_API;
+    struct DeltaBlockStoreAPI* m_BlockStore;
+    struct Longtail_AsyncPruneBlocksAPI* m_AsyncCompleteAPI;
+    struct DeltaBlockStore_KeepLookup* m_KeepLookup;
+    TLongtail_Hash* m_KeepHashes;
+};
+
+static void DeltaBlockStore_OnPruneBackingStoreComplete(struct Longtail_AsyncPruneBlocksAPI* async_complete_api, uint32_t pruned_block_count, int err)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(pruned_block_count, "%u"),
+        LONGTAIL_LOGFIELD(err, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api, return)
+    struct DeltaBlockStore_OnPruneAsync_API* prune_async_api = (struct DeltaBlockStore_OnPruneAsync_API*)async_complete_api;
+    struct DeltaBlockStoreAPI* deltablockstore_api = prune_async_api->m_BlockStore;
+    if (err)
+    {
+        Longtail_AtomicAdd64(&deltablockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PruneBlocks_FailCount], 1);
+    }
+    else
+    {
+        // Drop the pruned blocks from the index so they are no longer picked as base blocks
+        Longtail_LockSpinLock(deltablockstore_api->m_Lock);
+        struct DeltaBlockStore_SketchLookup* sketches = 0;
+        struct DeltaBlockStore_BaseLookup* delta_bases = 0;
+        for (ptrdiff_t i = 0; i < hmlen(deltablockstore_api->m_Sketches); ++i)
+        {
+            if (hmgeti(prune_async_api->m_KeepLookup, deltablockstore_api->m_Sketches[i].key) != -1)
+            {
+                hmput(sketches, deltablockstore_api->m_Sketches[i].key, deltablockstore_api->m_Sketches[i].value);
+            }
+        }
+        for (ptrdiff_t i = 0; i < hmlen(deltablockstore_api->m_DeltaBases); ++i)
+        {
+            if (hmgeti(prune_async_api->m_KeepLookup, deltablockstore_api->m_DeltaBases[i].key) != -1)
+            {
+                hmput(delta_bases, deltablockstore_api->m_DeltaBases[i].key, deltablockstore_api->m_DeltaBases[i].value);
+            }
+        }
+        hmfree(deltablockstore_api->m_Sketches);
+        hmfree(deltablockstore_api->m_Features);
+        hmfree(deltablockstore_api->m_DeltaBases);
+        deltablockstore_api->m_DeltaBases = delta_bases;
+        for (ptrdiff_t i = 0; i < hmlen(sketches); ++i)
+        {
+            DeltaBlockStore_AddSketch(deltablockstore_api, sketches[i].key, &sketches[i].value);
+        }
+        hmfree(sketches);
+        deltablockstore_api->m_IndexIsDirty = 1;
+        Longtail_UnlockSpinLock(deltablockstore_api->m_Lock);
+    }
+    prune_async_api->m_AsyncCompleteAPI->OnComplete(prune_async_api->m_AsyncCompleteAPI, pruned_block_count, err);
+    hmfree(prune_async_api->m_KeepLookup);
+    arrfree(prune_async_api->m_KeepHashes);
+    Longtail_Free(prune_async_api);
+    DeltaBlockStore_CompleteRequest(deltablockstore_api);
+}
+
+static int DeltaBlockStore_PruneBlocks(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint32_t block_keep_count,
+    const TLongtail_Hash* block_keep_hashes,
+    struct Longtail_AsyncPruneBlocksAPI* async_complete_api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(block_keep_count, "%u"),
+        LONGTAIL_LOGFIELD(block_keep_hashes, "%p"),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, (block_keep_count == 0) || (block_keep_hashes != 0), return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
+
+    struct DeltaBlockStoreAPI* api = (struct DeltaBlockStoreAPI*)block_store_api;
+    Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PruneBlocks_Count], 1);
+
+    // Without the sidecar index we do not know the base blocks of deltas stored earlier
+    if (api->m_IndexPath == 0)
+    {
+        return ENOTSUP;
+    }
+
+    size_t prune_async_api_size = sizeof(struct DeltaBlockStore_OnPruneAsync_API);
+    struct DeltaBlockStore_OnPruneAsync_API* prune_async_api = (struct DeltaBlockStore_OnPruneAsync_API*)Longtail_Alloc("DeltaBlockStore", prune_async_api_size);
+    if (!prune_async_api)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PruneBlocks_FailCount], 1);
+        return ENOMEM;
+    }
+    prune_async_api->m_API.OnComplete = DeltaBlockStore_OnPruneBackingStoreComplete;
+    prune_async_api->m_API.m_API.Dispose = 0;
+    prune_async_api->m_BlockStore = api;
+    prune_async_api->m_AsyncCompleteAPI = async_complete_api;
+    prune_async_api->m_KeepLookup = 0;
+    prune_async_api->m_KeepHashes = 0;
+
+    // Keep the base blocks of all kept delta blocks
+    arrsetcap(prune_async_api->m_KeepHashes, block_keep_count);
+    Longtail_LockSpinLock(api->m_Lock);
+    for (uint32_t b = 0; b < block_keep_count; ++b)
+    {
+        TLongtail_Hash block_hash = block_keep_hashes[b];
+        if (hmgeti(prune_async_api->m_KeepLookup, block_hash) == -1)
+        {
+            hmput(prune_async_api->m_KeepLookup, block_hash, 1);
+            arrput(prune_async_api->m_KeepHashes, block_hash);
+        }
+        intptr_t i = hmgeti(api->m_DeltaBases, block_hash);
+        if (i != -1 && hmgeti(prune_async_api->m_KeepLookup, api->m_DeltaBases[i].value) == -1)
+        {
+            hmput(prune_async_api->m_KeepLookup, api->m_DeltaBases[i].value, 1);
+            arrput(prune_async_api->m_KeepHashes, api->m_DeltaBases[i].value);
+        }
+    }
+    Longtail_UnlockSpinLock(api->m_Lock);
+
+    Longtail_AtomicAdd32(&api->m_PendingRequestCount, 1);
+    int err = api->m_BackingBlockStore->PruneBlocks(
+        api->m_BackingBlockStore,
+        (uint32_t)arrlen(prune_async_api->m_KeepHashes),
+        prune_async_api->m_KeepHashes,
+        &prune_async_api->m_API);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "api->m_BackingBlockStore->PruneBlocks() failed with %d", err)
+        Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PruneBlocks_FailCount], 1);
+        hmfree(prune_async_api->m_KeepLookup);
+        arrfree(prune_async_api->m_KeepHashes);
+        Longtail_Free(prune_async_api);
+        DeltaBlockStore_CompleteRequest(api);
+        return err;
+    }
+    return 0;
+}
+
+static int DeltaBlockStore_GetStats(struct Longtail_BlockStoreAPI* block_store_api, struct Longtail_BlockStore_Stats* out_stats)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(out_stats, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_stats, return EINVAL)
+    struct DeltaBlockStoreAPI* deltablockstore_api = (struct DeltaBlockStoreAPI*)block_store_api;
+    Longtail_AtomicAdd64(&deltablockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStats_Count], 1);
+    memset(out_stats, 0, sizeof(struct Longtail_BlockStore_Stats));
+    for (uint32_t s = 0; s < Longtail_BlockStoreAPI_StatU64_Count; ++s)
+    {
+        out_stats->m_StatU64[s] = deltablockstore_api->m_StatU64[s];
+    }
+    return 0;
+}
+
+static int DeltaBlockStore_Flush(struct Longtail_BlockStoreAPI* block_store_api, struct Longtail_AsyncFlushAPI* async_complete_api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    struct DeltaBlockStoreAPI* deltablockstore_api = (struct DeltaBlockStoreAPI*)block_store_api;
+    Longtail_AtomicAdd64(&deltablockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_Flush_Count], 1);
+    Longtail_LockSpinLock(deltablockstore_api->m_Lock);
+    if (deltablockstore_api->m_PendingRequestCount > 0)
+    {
+        arrput(deltablockstore_api->m_PendingAsyncFlushAPIs, async_complete_api);
+        Longtail_UnlockSpinLock(deltablockstore_api->m_Lock);
+        return 0;
+    }
+    Longtail_UnlockSpinLock(deltablockstore_api->m_Lock);
+    int err = DeltaBlockStore_SaveIndex(deltablockstore_api);
+    if (err)
+    {
+        Longtail_AtomicAdd64(&deltablockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_Flush_FailCount], 1);
+    }
+    async_complete_api->OnComplete(async_complete_api, err);
+    return 0;
+}
+
+static void DeltaBlockStore_Dispose(struct Longtail_API* api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, api, return)
+
+    struct DeltaBlockStoreAPI* block_store = (struct DeltaBlockStoreAPI*)api;
+    while (block_store->m_PendingRequestCount > 0)
+    {
+        Longtail_Sleep(1000);
+        if (block_store->m_PendingRequestCount > 0)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Waiting for %d pending requests", (int32_t)block_store->m_PendingRequestCount);
+        }
+    }
+    DeltaBlockStore_SaveIndex(block_store);
+    hmfree(block_store->m_Sketches);
+    hmfree(block_store->m_Features);
+    hmfree(block_store->m_DeltaBases);
+    Longtail_DeleteSpinLock(block_store->m_Lock);
+    Longtail_Free(block_store->m_Lock);
+    Longtail_Free(block_store);
+}
+
+static int DeltaBlockStore_Init(
+    void* mem,
+    struct Longtail_BlockStoreAPI* backing_block_store,
+    struct Longtail_StorageAPI* optional_storage_api,
+    const char* optional_index_path,
+    struct Longtail_BlockStoreAPI** out_block_store_api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(mem, "%p"),
+        LONGTAIL_LOGFIELD(backing_block_store, "%p"),
+        LONGTAIL_LOGFIELD(optional_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_index_path, "%p"),
+        LONGTAIL_LOGFIELD(out_block_store_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_FATAL_ASSERT(ctx, mem, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, backing_block_store, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, out_block_store_api, return EINVAL)
+
+    struct Longtail_BlockStoreAPI* block_store_api = Longtail_MakeBlockStoreAPI(
+        mem,
+        DeltaBlockStore_Dispose,
+        DeltaBlockStore_PutStoredBlock,
+        DeltaBlockStore_PreflightGet,
+        DeltaBlockStore_GetStoredBlock,
+        DeltaBlockStore_GetExistingContent,
+        DeltaBlockStore_PruneBlocks,
+        DeltaBlockStore_GetStats,
+        DeltaBlockStore_Flush);
+    if (!block_store_api)
+    {
+        return EINVAL;
+    }
+
+    block_store_api->GetStoredBlockToBuffer = backing_block_store->GetStoredBlockToBuffer ? DeltaBlockStore_GetStoredBlockToBuffer : 0;
+    // A delta block can only be decoded whole, a chunk range of it read from the backing store would not be block data
+    block_store_api->GetStoredBlockChunkRange = 0;
+
+    struct DeltaBlockStoreAPI* api = (struct DeltaBlockStoreAPI*)block_store_api;
+
+    api->m_BackingBlockStore = backing_block_store;
+    api->m_StorageAPI = optional_index_path ? optional_storage_api : 0;
+    api->m_IndexPath = 0;
+    api->m_PendingRequestCount = 0;
+    api->m_PendingAsyncFlushAPIs = 0;
+    api->m_Sketches = 0;
+    api->m_Features = 0;
+    api->m_DeltaBases = 0;
+    api->m_IndexIsDirty = 0;
+
+    for (uint32_t s = 0; s < Longtail_BlockStoreAPI_StatU64_Count; ++s)
+    {
+        api->m_StatU64[s] = 0;
+    }
+
+    int err = Longtail_CreateSpinLock(Longtail_Alloc("DeltaBlockStore", Longtail_GetSpinLockSize()), &api->m_Lock);
+    if (err)
+    {
+        return err;
+    }
+
+    if (api->m_StorageAPI)
+    {
+        api->m_IndexPath = (char*)&api[1];
+        strcpy(api->m_IndexPath, optional_index_path);
+        // The sidecar index marks the store as holding delta blocks, write it before the first delta block is put
+        api->m_IndexIsDirty = !api->m_StorageAPI->IsFile(api->m_StorageAPI, api->m_IndexPath);
+        err = DeltaBlockStore_LoadIndex(api);
+        if (!err)
+        {
+            err = DeltaBlockStore_SaveIndex(api);
+        }
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Loading the sidecar index failed with %d", err)
+            hmfree(api->m_Sketches);
+            hmfree(api->m_Features);
+            hmfree(api->m_DeltaBases);
+            Longtail_DeleteSpinLock(api->m_Lock);
+            Longtail_Free(api->m_Lock);
+            return err;
+        }
+    }
+
+    *out_block_store_api = block_store_api;
+    return 0;
+}
+
+struct Longtail_BlockStoreAPI* Longtail_CreateDeltaBlockStoreAPI(
+    struct Longtail_BlockStoreAPI* backing_block_store,
+    struct Longtail_StorageAPI* optional_storage_api,
+    const char* optional_index_path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(backing_block_store, "%p"),
+        LONGTAIL_LOGFIELD(optional_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_index_path, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, backing_block_store, return 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, optional_index_path == 0 || optional_storage_api != 0, return 0)
+
+    size_t api_size = sizeof(struct DeltaBlockStoreAPI) + (optional_index_path ? strlen(optional_index_path) + 1 : 0);
+    void* mem = Longtail_Alloc("DeltaBlockStore", api_size);
+    if (!mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return 0;
+    }
+    struct Longtail_BlockStoreAPI* block_store_api;
+    int err = DeltaBlockStore_Init(
+        mem,
+        backing_block_store,
+        optional_storage_api,
+        optional_index_path,
+        &block_store_api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "DeltaBlockStore_Init() failed with %d", err)
+        Longtail_Free(mem);
+        return 0;
+    }
+    return block_store_api;
+}
+
+int Longtail_DeltaBlockStore_HasIndex(
+    struct Longtail_StorageAPI* storage_api,
+    const char* index_path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(index_path, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api, return 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, index_path, return 0)
+
+    return storage_api->IsFile(storage_api, index_path);
+}
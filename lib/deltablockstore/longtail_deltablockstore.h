@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../../src/longtail.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! @brief Creates a block store that stores blocks as deltas against similar blocks.
+ *
+ * Each block passed to PutStoredBlock is sketched with a set of content defined super-features. If a block
+ * already in the store shares a super-feature the new block is encoded as copy/insert operations against that
+ * base block and the delta is stored instead, as long as it saves at least a quarter of the block data.
+ * Blocks stored as deltas are never used as base blocks so a delta is always resolved with a single base block.
+ *
+ * GetStoredBlock resolves deltas transparently, the returned block is identical to the block that was put.
+ * Block stores read without a delta block store return delta blocks as is, Longtail_ChangeVersion2 and the block
+ * store storage API reject them with EBADF since their block data does not match their block index.
+ * Place the delta block store on top of the compress block store, the block tag is preserved so the delta
+ * payload is compressed the same way as the full block would have been.
+ *
+ * The super-features of the full blocks and the delta to base block mapping are kept in a sidecar index at
+ * @p optional_index_path, it is read on creation and written on Flush and Dispose. Without a sidecar index only
+ * blocks put through this instance are used as base blocks and PruneBlocks is not supported since the base
+ * blocks of deltas stored earlier are not known. A missing sidecar index is written on creation so it also marks
+ * the store as one that may hold delta blocks, readers check for it with Longtail_DeltaBlockStore_HasIndex.
+ *
+ * @param[in] backing_block_store   The block store to store full and delta blocks in
+ * @param[in] optional_storage_api  The storage API for the sidecar index, may be null
+ * @param[in] optional_index_path   The path of the sidecar index, may be null
+ * @return                          The block store API, or null on failure
+ */
+LONGTAIL_EXPORT extern struct Longtail_BlockStoreAPI* Longtail_CreateDeltaBlockStoreAPI(
+    struct Longtail_BlockStoreAPI* backing_block_store,
+    struct Longtail_StorageAPI* optional_storage_api,
+    const char* optional_index_path);
+
+/*! @brief Checks if a store may hold delta blocks.
+ *
+ * A delta block store with a sidecar index writes the index when it is created, before any delta block is put.
+ * Readers of a store that has a sidecar index must read it through a delta block store.
+ *
+ * @param[in] storage_api   The storage API of the sidecar index
+ * @param[in] index_path    The path of the sidecar index
+ * @return                  Non-zero if the sidecar index exists
+ */
+LONGTAIL_EXPORT extern int Longtail_DeltaBlockStore_HasIndex(
+    struct Longtail_StorageAPI* storage_api,
+    const char* index_path);
+
+#ifdef __cplusplus
+}
+#endif
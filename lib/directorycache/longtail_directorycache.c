@@ -0,0 +1,137 @@
+#include "longtail_directorycache.h"
+
+#include "../../src/ext/stb_ds.h"
+#include "../longtail_platform.h"
+
+#include <errno.h>
+#include <inttypes.h>
+
+struct DirectoryCacheEntry
+{
+    char* key;
+    uint8_t value;
+};
+
+struct Longtail_DirectoryCache
+{
+    HLongtail_SpinLock m_Lock;
+    struct DirectoryCacheEntry* m_Directories;
+};
+
+static int DirectoryCache_Contains(struct Longtail_DirectoryCache* directory_cache, const char* path)
+{
+    Longtail_LockSpinLock(directory_cache->m_Lock);
+    int contains = directory_cache->m_Directories != 0 && shgeti(directory_cache->m_Directories, (char*)path) != -1;
+    Longtail_UnlockSpinLock(directory_cache->m_Lock);
+    return contains;
+}
+
+static void DirectoryCache_Add(struct Longtail_DirectoryCache* directory_cache, const char* path)
+{
+    Longtail_LockSpinLock(directory_cache->m_Lock);
+    if (directory_cache->m_Directories == 0)
+    {
+        sh_new_strdup(directory_cache->m_Directories);
+    }
+    shput(directory_cache->m_Directories, (char*)path, 1);
+    Longtail_UnlockSpinLock(directory_cache->m_Lock);
+}
+
+struct Longtail_DirectoryCache* Longtail_CreateDirectoryCache()
+{
+    MAKE_LOG_CONTEXT(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    size_t directory_cache_size = sizeof(struct Longtail_DirectoryCache) + Longtail_GetSpinLockSize();
+    void* mem = Longtail_Alloc("DirectoryCache", directory_cache_size);
+    if (!mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return 0;
+    }
+    struct Longtail_DirectoryCache* directory_cache = (struct Longtail_DirectoryCache*)mem;
+    directory_cache->m_Directories = 0;
+    int err = Longtail_CreateSpinLock(&directory_cache[1], &directory_cache->m_Lock);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateSpinLock() failed with %d", err)
+        Longtail_Free(mem);
+        return 0;
+    }
+    return directory_cache;
+}
+
+void Longtail_DisposeDirectoryCache(struct Longtail_DirectoryCache* directory_cache)
+{
+    if (directory_cache == 0)
+    {
+        return;
+    }
+    shfree(directory_cache->m_Directories);
+    Longtail_DeleteSpinLock(directory_cache->m_Lock);
+    Longtail_Free(directory_cache);
+}
+
+int Longtail_DirectoryCache_CreateDir(struct Longtail_DirectoryCache* directory_cache, struct Longtail_StorageAPI* storage_api, const char* path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(directory_cache, "%p"),
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, directory_cache != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
+
+    if (DirectoryCache_Contains(directory_cache, path))
+    {
+        return 0;
+    }
+
+    if (!storage_api->IsDir(storage_api, path))
+    {
+        int err = Longtail_DirectoryCache_EnsureParentPathExists(directory_cache, storage_api, path);
+        if (err)
+        {
+            return err;
+        }
+        err = storage_api->CreateDir(storage_api, path);
+        if (err != 0 && err != EEXIST)
+        {
+            return err;
+        }
+    }
+
+    DirectoryCache_Add(directory_cache, path);
+    return 0;
+}
+
+int Longtail_DirectoryCache_EnsureParentPathExists(struct Longtail_DirectoryCache* directory_cache, struct Longtail_StorageAPI* storage_api, const char* path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(directory_cache, "%p"),
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, directory_cache != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
+
+    char* parent_path = storage_api->GetParentPath(storage_api, path);
+    if (parent_path == 0)
+    {
+        return 0;
+    }
+    int err = Longtail_DirectoryCache_CreateDir(directory_cache, storage_api, parent_path);
+    Longtail_Free(parent_path);
+    return err;
+}
+
+void Longtail_DirectoryCache_Clear(struct Longtail_DirectoryCache* directory_cache)
+{
+    Longtail_LockSpinLock(directory_cache->m_Lock);
+    shfree(directory_cache->m_Directories);
+    directory_cache->m_Directories = 0;
+    Longtail_UnlockSpinLock(directory_cache->m_Lock);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../../src/longtail.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct Longtail_DirectoryCache;
+
+/*! @brief Creates a cache of directories known to exist.
+ *
+ * The cache remembers every directory it has created or found so that writing many files to the same
+ * folder only checks and creates the folder once. It is safe to use from multiple threads at once.
+ * The cache does not notice directories that are removed behind its back, call Longtail_DirectoryCache_Clear()
+ * if directories may have been removed.
+ *
+ * @return  The directory cache, or null on failure
+ */
+LONGTAIL_EXPORT extern struct Longtail_DirectoryCache* Longtail_CreateDirectoryCache();
+
+/*! @brief Disposes a directory cache created with Longtail_CreateDirectoryCache().
+ *
+ * @param[in] directory_cache   The directory cache
+ */
+LONGTAIL_EXPORT extern void Longtail_DisposeDirectoryCache(struct Longtail_DirectoryCache* directory_cache);
+
+/*! @brief Creates a directory and any missing parent directories unless it is already known to exist.
+ *
+ * @param[in] directory_cache   The directory cache
+ * @param[in] storage_api       The storage to create the directory in
+ * @param[in] path              Path of the directory
+ * @return                      Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT extern int Longtail_DirectoryCache_CreateDir(struct Longtail_DirectoryCache* directory_cache, struct Longtail_StorageAPI* storage_api, const char* path);
+
+/*! @brief Cached version of EnsureParentPathExists().
+ *
+ * @param[in] directory_cache   The directory cache
+ * @param[in] storage_api       The storage to create the directories in
+ * @param[in] path              Path of the file or directory whose parent directories should exist
+ * @return                      Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT extern int Longtail_DirectoryCache_EnsureParentPathExists(struct Longtail_DirectoryCache* directory_cache, struct Longtail_StorageAPI* storage_api, const char* path);
+
+/*! @brief Forgets all directories in the cache.
+ *
+ * @param[in] directory_cache   The directory cache
+ */
+LONGTAIL_EXPORT extern void Longtail_DirectoryCache_Clear(struct Longtail_DirectoryCache* directory_cache);
+
+#ifdef __cplusplus
+}
+#endif
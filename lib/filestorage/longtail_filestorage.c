@@ -213,6 +213,76 @@ static int FSStorageAPI_Write(
     return err;
 }
 
+static int FSStorageAPI_WriteV(
+    struct Longtail_StorageAPI* storage_api,
+    Longtail_StorageAPI_HOpenFile f,
+    uint64_t offset,
+    uint32_t vec_count,
+    const struct Longtail_StorageAPI_IOVec* vecs)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(f, "%p"),
+        LONGTAIL_LOGFIELD(offset, "%" PRIu64),
+        LONGTAIL_LOGFIELD(vec_count, "%u"),
+        LONGTAIL_LOGFIELD(vecs, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, f != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, vec_count == 0 || vecs != 0, return EINVAL);
+    int err = Longtail_WriteV((HLongtail_OpenFile)f, offset, vec_count, vecs);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_WriteV() failed with %d", err)
+    }
+    return err;
+}
+
+static int FSStorageAPI_GetFileStat(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    uint64_t* out_size,
+    uint64_t* out_modification_time,
+    uint64_t* out_change_time,
+    uint64_t* out_file_id)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(out_size, "%p"),
+        LONGTAIL_LOGFIELD(out_modification_time, "%p"),
+        LONGTAIL_LOGFIELD(out_change_time, "%p"),
+        LONGTAIL_LOGFIELD(out_file_id, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, out_size != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, out_modification_time != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, out_change_time != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, out_file_id != 0, return EINVAL);
+    int err = Longtail_GetFileStat(path, out_size, out_modification_time, out_change_time, out_file_id);
+    if (err == ENOENT)
+    {
+        return err;
+    }
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "Longtail_GetFileStat() failed with %d", err)
+        return err;
+    }
+    return 0;
+}
+
 static int FSStorageAPI_SetSize(
     struct Longtail_StorageAPI* storage_api,
     Longtail_StorageAPI_HOpenFile f,
@@ -697,7 +767,9 @@ static int FSStorageAPI_Init(
         FSStorageAPI_GetParentPath,
         FSStorageAPI_MapFile,
         FSStorageAPI_UnmapFile,
-        FSStorageAPI_OpenAppendFile);
+        FSStorageAPI_OpenAppendFile,
+        FSStorageAPI_WriteV,
+        FSStorageAPI_GetFileStat);
     *out_storage_api = api;
     return 0;
 }
@@ -1,6 +1,7 @@
 #include "longtail_fsblockstore.h"
 
 #include "../../src/ext/stb_ds.h"
+#include "../directorycache/longtail_directorycache.h"
 #include "../longtail_platform.h"
 
 #include <errno.h>
@@ -16,6 +17,68 @@ struct BlockHashToBlockState
 
 #define TMP_EXTENSION_LENGTH (1 + 16)
 
+// Blocks can be appended to pack files instead of being written as one file each.
+// A pack file `packs/<id>-<sequence>.lpk` is only ever appended to by the block store instance that created it
+// and it is never appended to once it reaches the maximum pack size. The companion pack index file
+// `packs/<id>-<sequence>.lpi` lists the block hash, offset and size of each block in the pack and the size of the
+// pack it covers, it is rewritten (write to temp + rename) when the pack is sealed and on Flush.
+// Each block in the pack is preceded by a struct PackIndexEntry record, blocks appended after the pack index was
+// last written, for example by an instance that crashed, are recovered by scanning the records after the indexed part.
+#define PACK_FILE_EXTENSION ".lpk"
+#define PACK_INDEX_FILE_EXTENSION ".lpi"
+#define NO_ACTIVE_PACK 0xffffffffu
+#define PACK_BLOCK_RECORD_MAGIC 0x6b63706cu
+
+// PruneBlocks moves the remaining blocks to a new pack if less than this percentage of the pack data is still in use
+#define PACK_REWRITE_LIVE_PERCENT 50
+
+static const uint32_t LONGTAIL_PACK_INDEX_VERSION = (((uint32_t)'l') << 24) + (((uint32_t)'p') << 16) + (((uint32_t)'i') << 8) + ((uint32_t)'2');
+
+struct PackIndexHeader
+{
+    uint32_t m_Version;
+    uint32_t m_BlockCount;
+    uint64_t m_PackSize;
+};
+
+struct PackIndexEntry
+{
+    TLongtail_Hash m_BlockHash;
+    uint64_t m_Offset;
+    uint32_t m_Size;
+    uint32_t m_Reserved;    // PACK_BLOCK_RECORD_MAGIC in the record in front of a block in the pack, zero in the pack index
+};
+
+struct PackNameToIndexFileSize
+{
+    char* key;
+    uint64_t value;
+};
+
+struct PackBlockLocation
+{
+    uint64_t m_Offset;
+    uint32_t m_PackIndex;
+    uint32_t m_Size;
+};
+
+struct BlockHashToPackBlockLocation
+{
+    uint64_t key;
+    struct PackBlockLocation value;
+};
+
+struct FSPack
+{
+    char* m_Name;                   // Path relative to the store path, without extension
+    TLongtail_Hash* m_BlockHashes;  // Blocks that are located in this pack
+    uint64_t m_IndexFileSize;       // Size of the pack index file when it was last read
+    uint64_t m_PackFileSize;        // Size of the pack file when it was last read
+    uint64_t m_PackSize;            // Size of the part of the pack that holds the blocks in m_BlockHashes
+    int m_IsOwned;                  // Created by this instance, the in-memory state is the truth
+    int m_IsIndexDirty;
+};
+
 struct FSBlockStoreAPI
 {
     struct Longtail_BlockStoreAPI m_BlockStoreAPI;
@@ -35,6 +98,23 @@ struct FSBlockStoreAPI
     uint32_t m_StoreIndexIsDirty;
     int m_EnableFileMapping;
     char m_TmpExtension[TMP_EXTENSION_LENGTH + 1];
+
+    // m_Packs and m_PackBlockLocations are protected by m_Lock
+    struct FSPack* m_Packs;
+    struct BlockHashToPackBlockLocation* m_PackBlockLocations;
+    int m_PackIndexesLoaded;
+
+    // Writing to packs is serialized by m_PackLock, m_PackLock must be taken before m_Lock
+    // It is held across pack file I/O so it is a semaphore with a count of one, not a spin lock
+    HLongtail_Sema m_PackLock;
+    uint64_t m_MaxPackSize;
+    uint32_t m_ActivePackIndex;
+    uint64_t m_ActivePackSize;
+    Longtail_StorageAPI_HOpenFile m_ActivePackFile;   // Kept open between appends, closed on seal, Flush and when reading the active pack
+    uint32_t m_NextPackSequence;
+
+    // Block folders known to exist, cleared if a block write can't find its folder
+    struct Longtail_DirectoryCache* m_DirectoryCache;
 };
 
 #define BLOCK_NAME_LENGTH   23
@@ -271,16 +351,26 @@ static int SafeWriteStoredBlock(
     }
 
     char* tmp_block_path = GetTempBlockPath(storage_api, store_path, block_hash, api->m_TmpExtension);
-    int err = EnsureParentPathExists(storage_api, tmp_block_path);
+    int err = Longtail_DirectoryCache_EnsureParentPathExists(api->m_DirectoryCache, storage_api, tmp_block_path);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_DirectoryCache_EnsureParentPathExists() failed with %d", err)
         Longtail_Free((char*)tmp_block_path);
         Longtail_Free((char*)block_path);
         return err;
     }
 
     err = Longtail_WriteStoredBlock(storage_api, stored_block, tmp_block_path);
+    if (err == ENOENT)
+    {
+        // The block folder may have been removed after we cached it
+        Longtail_DirectoryCache_Clear(api->m_DirectoryCache);
+        err = Longtail_DirectoryCache_EnsureParentPathExists(api->m_DirectoryCache, storage_api, tmp_block_path);
+        if (err == 0)
+        {
+            err = Longtail_WriteStoredBlock(storage_api, stored_block, tmp_block_path);
+        }
+    }
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_WriteStoredBlock() failed with %d", err)
@@ -319,127 +409,1267 @@ static int SafeWriteStoredBlock(
     return 0;
 }
 
-static int UpdateStoreIndex(
-    struct Longtail_StoreIndex* current_store_index,
-    struct Longtail_BlockIndex** added_block_indexes,
-    struct Longtail_StoreIndex** out_store_index)
+int EndsWith(const char *str, const char *suffix)
+{
+    if (!str || !suffix)
+        return 0;
+    size_t lenstr = strlen(str);
+    size_t lensuffix = strlen(suffix);
+    if (lensuffix >  lenstr)
+        return 0;
+    return strncmp(str + lenstr - lensuffix, suffix, lensuffix) == 0;
+}
+
+static char* GetPackPath(
+    struct Longtail_StorageAPI* storage_api,
+    const char* store_path,
+    const char* pack_name,
+    const char* extension,
+    const char* suffix)
+{
+    size_t pack_name_length = strlen(pack_name);
+    size_t extension_length = strlen(extension);
+    size_t suffix_length = strlen(suffix);
+    char* file_name = (char*)Longtail_Alloc("FSBlockStoreAPI", pack_name_length + extension_length + suffix_length + 1);
+    if (!file_name)
+    {
+        return 0;
+    }
+    memcpy(file_name, pack_name, pack_name_length);
+    memcpy(&file_name[pack_name_length], extension, extension_length);
+    memcpy(&file_name[pack_name_length + extension_length], suffix, suffix_length + 1);
+    char* path = storage_api->ConcatPath(storage_api, store_path, file_name);
+    Longtail_Free(file_name);
+    return path;
+}
+
+static int ReadPackIndex(
+    struct Longtail_StorageAPI* storage_api,
+    const char* pack_index_path,
+    void** out_buffer,
+    uint32_t* out_block_count,
+    const struct PackIndexEntry** out_entries,
+    uint64_t* out_pack_size)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(current_store_index, "%p"),
-        LONGTAIL_LOGFIELD(added_block_indexes, "%p"),
-        LONGTAIL_LOGFIELD(out_store_index, "%p")
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(pack_index_path, "%s"),
+        LONGTAIL_LOGFIELD(out_buffer, "%p"),
+        LONGTAIL_LOGFIELD(out_block_count, "%p"),
+        LONGTAIL_LOGFIELD(out_entries, "%p"),
+        LONGTAIL_LOGFIELD(out_pack_size, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    struct Longtail_StoreIndex* added_store_index;
-    int err = Longtail_CreateStoreIndexFromBlocks(
-        (uint32_t)(arrlen(added_block_indexes)),
-        (const struct Longtail_BlockIndex** )added_block_indexes,
-        &added_store_index);
+    Longtail_StorageAPI_HOpenFile f;
+    int err = storage_api->OpenReadFile(storage_api, pack_index_path, &f);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_INFO : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
         return err;
     }
-    struct Longtail_StoreIndex* new_store_index;
-    err = Longtail_MergeStoreIndex(
-        added_store_index,  // Added first as it has precedence
-        current_store_index,
-        &new_store_index);
-    Longtail_Free(added_store_index);
+    uint64_t size;
+    err = storage_api->GetSize(storage_api, f, &size);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_MergeStoreIndex() failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetSize() failed with %d", err)
+        storage_api->CloseFile(storage_api, f);
         return err;
     }
-    *out_store_index = new_store_index;
+    if (size < sizeof(struct PackIndexHeader))
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Pack index is too small, failed with %d", EBADF)
+        storage_api->CloseFile(storage_api, f);
+        return EBADF;
+    }
+    void* buffer = Longtail_Alloc("FSBlockStoreAPI", (size_t)size);
+    if (!buffer)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        storage_api->CloseFile(storage_api, f);
+        return ENOMEM;
+    }
+    err = storage_api->Read(storage_api, f, 0, size, buffer);
+    storage_api->CloseFile(storage_api, f);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
+        Longtail_Free(buffer);
+        return err;
+    }
+    const struct PackIndexHeader* header = (const struct PackIndexHeader*)buffer;
+    if ((header->m_Version != LONGTAIL_PACK_INDEX_VERSION) ||
+        (size != sizeof(struct PackIndexHeader) + sizeof(struct PackIndexEntry) * (uint64_t)header->m_BlockCount))
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Invalid pack index, failed with %d", EBADF)
+        Longtail_Free(buffer);
+        return EBADF;
+    }
+    *out_buffer = buffer;
+    *out_block_count = header->m_BlockCount;
+    *out_entries = (const struct PackIndexEntry*)&header[1];
+    *out_pack_size = header->m_PackSize;
     return 0;
 }
 
-struct FSStoredBlock
-{
-    struct Longtail_StoredBlock m_StoredBlock;
-};
-
-static int FSStoredBlock_Dispose(struct Longtail_StoredBlock* stored_block)
+// Reads the blocks of a pack from its pack index and recovers the blocks appended after the pack index was written
+// from the records in front of them. Returns the blocks in a stb array and the size of the pack the blocks cover.
+static int ReadPackEntries(
+    struct Longtail_StorageAPI* storage_api,
+    const char* store_path,
+    const char* pack_name,
+    uint64_t pack_file_size,
+    struct PackIndexEntry** out_entries,
+    uint64_t* out_pack_size)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(stored_block, "%p")
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(store_path, "%s"),
+        LONGTAIL_LOGFIELD(pack_name, "%s"),
+        LONGTAIL_LOGFIELD(pack_file_size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(out_entries, "%p"),
+        LONGTAIL_LOGFIELD(out_pack_size, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_FATAL_ASSERT(ctx, stored_block, return EINVAL)
-    Longtail_Free(stored_block);
+    char* pack_index_path = GetPackPath(storage_api, store_path, pack_name, PACK_INDEX_FILE_EXTENSION, "");
+    char* pack_path = GetPackPath(storage_api, store_path, pack_name, PACK_FILE_EXTENSION, "");
+    if (!pack_index_path || !pack_path)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "GetPackPath() failed with %d", ENOMEM)
+        Longtail_Free(pack_path);
+        Longtail_Free(pack_index_path);
+        return ENOMEM;
+    }
+
+    struct PackIndexEntry* entries = 0;
+    uint64_t pack_size = 0;
+    void* index_buffer = 0;
+    uint32_t index_block_count = 0;
+    const struct PackIndexEntry* index_entries = 0;
+    int err = ReadPackIndex(storage_api, pack_index_path, &index_buffer, &index_block_count, &index_entries, &pack_size);
+    if (err == ENOMEM)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ReadPackIndex() failed with %d", err)
+        Longtail_Free(pack_path);
+        Longtail_Free(pack_index_path);
+        return err;
+    }
+    if (err)
+    {
+        // No usable pack index, recover all blocks from the pack
+        pack_size = 0;
+    }
+    else
+    {
+        arrsetlen(entries, index_block_count);
+        memcpy(entries, index_entries, sizeof(struct PackIndexEntry) * index_block_count);
+        Longtail_Free(index_buffer);
+    }
+    Longtail_Free(pack_index_path);
+
+    err = 0;
+    if (pack_size < pack_file_size)
+    {
+        Longtail_StorageAPI_HOpenFile pack_file;
+        err = storage_api->OpenReadFile(storage_api, pack_path, &pack_file);
+        if (!err)
+        {
+            err = storage_api->GetSize(storage_api, pack_file, &pack_file_size);
+            while (!err && (pack_size + sizeof(struct PackIndexEntry) <= pack_file_size))
+            {
+                struct PackIndexEntry record;
+                if (storage_api->Read(storage_api, pack_file, pack_size, sizeof(struct PackIndexEntry), &record))
+                {
+                    break;
+                }
+                uint64_t block_offset = pack_size + sizeof(struct PackIndexEntry);
+                if ((record.m_Reserved != PACK_BLOCK_RECORD_MAGIC) || (record.m_Offset != block_offset) || (record.m_Size == 0) || (block_offset + record.m_Size > pack_file_size))
+                {
+                    // Not a block record or a block that was not completely written
+                    break;
+                }
+                record.m_Reserved = 0;
+                arrput(entries, record);
+                pack_size = block_offset + record.m_Size;
+            }
+            storage_api->CloseFile(storage_api, pack_file);
+        }
+    }
+    else if (!storage_api->IsFile(storage_api, pack_path))
+    {
+        err = ENOENT;
+    }
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_INFO : LONGTAIL_LOG_LEVEL_WARNING, "Failed to read pack `%s`, failed with %d", pack_path, err)
+        arrfree(entries);
+        Longtail_Free(pack_path);
+        return err;
+    }
+    Longtail_Free(pack_path);
+    *out_entries = entries;
+    *out_pack_size = pack_size;
     return 0;
 }
 
-struct ScanBlockJob
+// Caller must hold m_PackLock and must not hold m_Lock
+static int WritePackIndex(struct FSBlockStoreAPI* api, uint32_t pack_index)
 {
-    struct Longtail_StorageAPI* m_StorageAPI;
-    const char* m_StorePath;
-    const char* m_ChunksPath;
-    const char* m_BlockPath;
-    const char* m_BlockExtension;
-    struct Longtail_BlockIndex* m_BlockIndex;
-};
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(api, "%p"),
+        LONGTAIL_LOGFIELD(pack_index, "%u")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-int EndsWith(const char *str, const char *suffix)
+    struct Longtail_StorageAPI* storage_api = api->m_StorageAPI;
+
+    Longtail_LockSpinLock(api->m_Lock);
+    struct FSPack* pack = &api->m_Packs[pack_index];
+    uint32_t block_count = (uint32_t)arrlen(pack->m_BlockHashes);
+    size_t index_size = sizeof(struct PackIndexHeader) + sizeof(struct PackIndexEntry) * block_count;
+    struct PackIndexHeader* header = (struct PackIndexHeader*)Longtail_Alloc("FSBlockStoreAPI", index_size);
+    if (!header)
+    {
+        Longtail_UnlockSpinLock(api->m_Lock);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    header->m_Version = LONGTAIL_PACK_INDEX_VERSION;
+    header->m_BlockCount = block_count;
+    header->m_PackSize = pack->m_PackSize;
+    struct PackIndexEntry* entries = (struct PackIndexEntry*)&header[1];
+    for (uint32_t b = 0; b < block_count; ++b)
+    {
+        TLongtail_Hash block_hash = pack->m_BlockHashes[b];
+        struct PackBlockLocation location = hmget(api->m_PackBlockLocations, block_hash);
+        entries[b].m_BlockHash = block_hash;
+        entries[b].m_Offset = location.m_Offset;
+        entries[b].m_Size = location.m_Size;
+        entries[b].m_Reserved = 0;
+    }
+    char* pack_index_path = GetPackPath(storage_api, api->m_StorePath, pack->m_Name, PACK_INDEX_FILE_EXTENSION, "");
+    char* tmp_pack_index_path = GetPackPath(storage_api, api->m_StorePath, pack->m_Name, PACK_INDEX_FILE_EXTENSION, api->m_TmpExtension);
+    pack->m_IsIndexDirty = 0;
+    Longtail_UnlockSpinLock(api->m_Lock);
+
+    int err = (pack_index_path && tmp_pack_index_path) ? 0 : ENOMEM;
+    if (!err)
+    {
+        err = EnsureParentPathExists(storage_api, tmp_pack_index_path);
+    }
+    if (!err)
+    {
+        Longtail_StorageAPI_HOpenFile f;
+        err = storage_api->OpenWriteFile(storage_api, tmp_pack_index_path, 0, &f);
+        if (!err)
+        {
+            err = storage_api->Write(storage_api, f, 0, index_size, header);
+            storage_api->CloseFile(storage_api, f);
+            if (!err && storage_api->IsFile(storage_api, pack_index_path))
+            {
+                err = storage_api->RemoveFile(storage_api, pack_index_path);
+            }
+            if (!err)
+            {
+                err = storage_api->RenameFile(storage_api, tmp_pack_index_path, pack_index_path);
+            }
+            if (err)
+            {
+                storage_api->RemoveFile(storage_api, tmp_pack_index_path);
+            }
+        }
+    }
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to write pack index `%s`, failed with %d", pack_index_path ? pack_index_path : "", err)
+        Longtail_LockSpinLock(api->m_Lock);
+        api->m_Packs[pack_index].m_IsIndexDirty = 1;
+        Longtail_UnlockSpinLock(api->m_Lock);
+    }
+    Longtail_Free(tmp_pack_index_path);
+    Longtail_Free(pack_index_path);
+    Longtail_Free(header);
+    return err;
+}
+
+// Reads the packs written by other instances, caller must not hold m_Lock
+static int LoadPackIndexes(struct FSBlockStoreAPI* api)
 {
-    if (!str || !suffix)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    struct Longtail_StorageAPI* storage_api = api->m_StorageAPI;
+    char* packs_path = storage_api->ConcatPath(storage_api, api->m_StorePath, "packs");
+    if (!storage_api->IsDir(storage_api, packs_path))
+    {
+        Longtail_Free(packs_path);
+        api->m_PackIndexesLoaded = 1;
         return 0;
-    size_t lenstr = strlen(str);
-    size_t lensuffix = strlen(suffix);
-    if (lensuffix >  lenstr)
+    }
+
+    struct Longtail_FileInfos* file_infos;
+    int err = Longtail_GetFilesRecursively2(storage_api, api->m_JobAPI, 0, 0, 0, packs_path, &file_infos);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_GetFilesRecursively2() failed with %d", err)
+        Longtail_Free(packs_path);
+        return err;
+    }
+
+    struct PackNameToIndexFileSize* index_file_sizes = 0;
+    sh_new_strdup(index_file_sizes);
+    for (uint32_t f = 0; f < file_infos->m_Count; ++f)
+    {
+        const char* file_path = &file_infos->m_PathData[file_infos->m_PathStartOffsets[f]];
+        if (!EndsWith(file_path, PACK_INDEX_FILE_EXTENSION))
+        {
+            continue;
+        }
+        char* pack_file_path = Longtail_Strdup(file_path);
+        if (!pack_file_path)
+        {
+            err = ENOMEM;
+            break;
+        }
+        strcpy(&pack_file_path[strlen(pack_file_path) - strlen(PACK_INDEX_FILE_EXTENSION)], PACK_FILE_EXTENSION);
+        shput(index_file_sizes, pack_file_path, file_infos->m_Sizes[f]);
+        Longtail_Free(pack_file_path);
+    }
+
+    for (uint32_t f = 0; f < file_infos->m_Count && !err; ++f)
+    {
+        const char* file_path = &file_infos->m_PathData[file_infos->m_PathStartOffsets[f]];
+        if (!EndsWith(file_path, PACK_FILE_EXTENSION))
+        {
+            continue;
+        }
+        uint64_t pack_file_size = file_infos->m_Sizes[f];
+        intptr_t index_file_size_ptr = shgeti(index_file_sizes, (char*)file_path);
+        uint64_t index_file_size = index_file_size_ptr == -1 ? 0 : index_file_sizes[index_file_size_ptr].value;
+        size_t name_length = strlen("packs/") + strlen(file_path) - strlen(PACK_FILE_EXTENSION);
+        char* pack_name = (char*)Longtail_Alloc("FSBlockStoreAPI", name_length + 1);
+        if (!pack_name)
+        {
+            err = ENOMEM;
+            break;
+        }
+        strcpy(pack_name, "packs/");
+        strncat(pack_name, file_path, name_length - strlen("packs/"));
+
+        Longtail_LockSpinLock(api->m_Lock);
+        uint32_t pack_index = 0;
+        uint32_t pack_count = (uint32_t)arrlen(api->m_Packs);
+        while (pack_index < pack_count && strcmp(api->m_Packs[pack_index].m_Name, pack_name) != 0)
+        {
+            ++pack_index;
+        }
+        int is_up_to_date = (pack_index < pack_count) &&
+            (api->m_Packs[pack_index].m_IsOwned ||
+            ((api->m_Packs[pack_index].m_IndexFileSize == index_file_size) && (api->m_Packs[pack_index].m_PackFileSize == pack_file_size)));
+        Longtail_UnlockSpinLock(api->m_Lock);
+        if (is_up_to_date)
+        {
+            Longtail_Free(pack_name);
+            continue;
+        }
+
+        struct PackIndexEntry* entries = 0;
+        uint64_t pack_size = 0;
+        err = ReadPackEntries(storage_api, api->m_StorePath, pack_name, pack_file_size, &entries, &pack_size);
+        if (err && err != ENOMEM)
+        {
+            // Removed by a concurrent prune or held open by the instance appending to it, pick it up on the next load
+            Longtail_Free(pack_name);
+            err = 0;
+            continue;
+        }
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ReadPackEntries() failed with %d", err)
+            Longtail_Free(pack_name);
+            break;
+        }
+        uint32_t block_count = (uint32_t)arrlen(entries);
+
+        // Packs may have been added or removed while we were reading the pack
+        Longtail_LockSpinLock(api->m_Lock);
+        pack_index = 0;
+        pack_count = (uint32_t)arrlen(api->m_Packs);
+        while (pack_index < pack_count && strcmp(api->m_Packs[pack_index].m_Name, pack_name) != 0)
+        {
+            ++pack_index;
+        }
+        if (pack_index == pack_count)
+        {
+            struct FSPack pack;
+            pack.m_Name = pack_name;
+            pack.m_BlockHashes = 0;
+            pack.m_IndexFileSize = 0;
+            pack.m_PackFileSize = 0;
+            pack.m_PackSize = 0;
+            pack.m_IsOwned = 0;
+            pack.m_IsIndexDirty = 0;
+            arrput(api->m_Packs, pack);
+            pack_name = 0;
+        }
+        struct FSPack* pack = &api->m_Packs[pack_index];
+        intptr_t old_block_count = arrlen(pack->m_BlockHashes);
+        for (intptr_t b = 0; b < old_block_count; ++b)
+        {
+            intptr_t location_ptr = hmgeti(api->m_PackBlockLocations, pack->m_BlockHashes[b]);
+            if (location_ptr != -1 && api->m_PackBlockLocations[location_ptr].value.m_PackIndex == pack_index)
+            {
+                hmdel(api->m_PackBlockLocations, pack->m_BlockHashes[b]);
+            }
+        }
+        arrsetlen(pack->m_BlockHashes, 0);
+        for (uint32_t b = 0; b < block_count; ++b)
+        {
+            TLongtail_Hash block_hash = entries[b].m_BlockHash;
+            if (hmgeti(api->m_PackBlockLocations, block_hash) != -1)
+            {
+                // Already present in another pack
+                continue;
+            }
+            struct PackBlockLocation location;
+            location.m_Offset = entries[b].m_Offset;
+            location.m_PackIndex = pack_index;
+            location.m_Size = entries[b].m_Size;
+            hmput(api->m_PackBlockLocations, block_hash, location);
+            arrput(pack->m_BlockHashes, block_hash);
+        }
+        pack->m_IndexFileSize = index_file_size;
+        pack->m_PackFileSize = pack_file_size;
+        pack->m_PackSize = pack_size;
+        Longtail_UnlockSpinLock(api->m_Lock);
+
+        Longtail_Free(pack_name);
+        arrfree(entries);
+    }
+
+    shfree(index_file_sizes);
+    Longtail_Free(file_infos);
+    Longtail_Free(packs_path);
+    if (!err)
+    {
+        api->m_PackIndexesLoaded = 1;
+    }
+    return err;
+}
+
+// Caller must hold m_PackLock
+static void CloseActivePackFile(struct FSBlockStoreAPI* api)
+{
+    if (api->m_ActivePackFile)
+    {
+        api->m_StorageAPI->CloseFile(api->m_StorageAPI, api->m_ActivePackFile);
+        api->m_ActivePackFile = 0;
+    }
+}
+
+// Caller must hold m_PackLock and must not hold m_Lock
+static int SealActivePack(struct FSBlockStoreAPI* api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    CloseActivePackFile(api);
+    if (api->m_ActivePackIndex == NO_ACTIVE_PACK)
+    {
         return 0;
-    return strncmp(str + lenstr - lensuffix, suffix, lensuffix) == 0;
+    }
+    Longtail_LockSpinLock(api->m_Lock);
+    int is_index_dirty = api->m_Packs[api->m_ActivePackIndex].m_IsIndexDirty;
+    Longtail_UnlockSpinLock(api->m_Lock);
+    if (is_index_dirty)
+    {
+        int err = WritePackIndex(api, api->m_ActivePackIndex);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "WritePackIndex() failed with %d", err)
+            return err;
+        }
+    }
+    api->m_ActivePackIndex = NO_ACTIVE_PACK;
+    api->m_ActivePackSize = 0;
+    return 0;
+}
+
+// Caller must hold m_PackLock and must not hold m_Lock
+static int CreateActivePack(struct FSBlockStoreAPI* api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    struct Longtail_StorageAPI* storage_api = api->m_StorageAPI;
+    char pack_name[6 + TMP_EXTENSION_LENGTH + 1 + 8 + 1];
+    while (1)
+    {
+        sprintf(pack_name, "packs/%s-%08x", &api->m_TmpExtension[1], api->m_NextPackSequence++);
+        char* pack_path = GetPackPath(storage_api, api->m_StorePath, pack_name, PACK_FILE_EXTENSION, "");
+        char* pack_index_path = GetPackPath(storage_api, api->m_StorePath, pack_name, PACK_INDEX_FILE_EXTENSION, "");
+        if (!pack_path || !pack_index_path)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "GetPackPath() failed with %d", ENOMEM)
+            Longtail_Free(pack_index_path);
+            Longtail_Free(pack_path);
+            return ENOMEM;
+        }
+        int exists = storage_api->IsFile(storage_api, pack_path) || storage_api->IsFile(storage_api, pack_index_path);
+        Longtail_Free(pack_index_path);
+        Longtail_Free(pack_path);
+        if (!exists)
+        {
+            break;
+        }
+    }
+
+    struct FSPack pack;
+    pack.m_Name = Longtail_Strdup(pack_name);
+    if (!pack.m_Name)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Strdup() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    pack.m_BlockHashes = 0;
+    pack.m_IndexFileSize = 0;
+    pack.m_PackFileSize = 0;
+    pack.m_PackSize = 0;
+    pack.m_IsOwned = 1;
+    pack.m_IsIndexDirty = 0;
+
+    Longtail_LockSpinLock(api->m_Lock);
+    api->m_ActivePackIndex = (uint32_t)arrlen(api->m_Packs);
+    arrput(api->m_Packs, pack);
+    Longtail_UnlockSpinLock(api->m_Lock);
+    api->m_ActivePackSize = 0;
+    return 0;
+}
+
+// Caller must hold m_PackLock and must not hold m_Lock
+static int AppendToPack(
+    struct FSBlockStoreAPI* api,
+    TLongtail_Hash block_hash,
+    const void* data,
+    uint32_t size)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(api, "%p"),
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(data, "%p"),
+        LONGTAIL_LOGFIELD(size, "%u")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    struct Longtail_StorageAPI* storage_api = api->m_StorageAPI;
+    int err = 0;
+    uint64_t record_size = sizeof(struct PackIndexEntry) + size;
+    if ((api->m_ActivePackIndex != NO_ACTIVE_PACK) && (api->m_ActivePackSize > 0) && (api->m_ActivePackSize + record_size > api->m_MaxPackSize))
+    {
+        err = SealActivePack(api);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "SealActivePack() failed with %d", err)
+            return err;
+        }
+    }
+    if (api->m_ActivePackIndex == NO_ACTIVE_PACK)
+    {
+        err = CreateActivePack(api);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateActivePack() failed with %d", err)
+            return err;
+        }
+    }
+
+    if (!api->m_ActivePackFile)
+    {
+        Longtail_LockSpinLock(api->m_Lock);
+        char* pack_path = GetPackPath(storage_api, api->m_StorePath, api->m_Packs[api->m_ActivePackIndex].m_Name, PACK_FILE_EXTENSION, "");
+        Longtail_UnlockSpinLock(api->m_Lock);
+        if (!pack_path)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "GetPackPath() failed with %d", ENOMEM)
+            return ENOMEM;
+        }
+        if (api->m_ActivePackSize == 0)
+        {
+            err = EnsureParentPathExists(storage_api, pack_path);
+            if (!err)
+            {
+                err = storage_api->OpenWriteFile(storage_api, pack_path, 0, &api->m_ActivePackFile);
+            }
+        }
+        else
+        {
+            err = storage_api->OpenAppendFile(storage_api, pack_path, &api->m_ActivePackFile);
+        }
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to open pack `%s`, failed with %d", pack_path, err)
+            api->m_ActivePackFile = 0;
+            Longtail_Free(pack_path);
+            return err;
+        }
+        Longtail_Free(pack_path);
+    }
+
+    struct PackIndexEntry record;
+    record.m_BlockHash = block_hash;
+    record.m_Offset = api->m_ActivePackSize + sizeof(struct PackIndexEntry);
+    record.m_Size = size;
+    record.m_Reserved = PACK_BLOCK_RECORD_MAGIC;
+    struct Longtail_StorageAPI_IOVec vecs[2] = {{&record, sizeof(struct PackIndexEntry)}, {data, size}};
+    err = storage_api->WriteV(storage_api, api->m_ActivePackFile, api->m_ActivePackSize, 2, vecs);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->WriteV() failed with %d", err)
+        CloseActivePackFile(api);
+        return err;
+    }
+
+    struct PackBlockLocation location;
+    location.m_Offset = record.m_Offset;
+    location.m_PackIndex = api->m_ActivePackIndex;
+    location.m_Size = size;
+
+    api->m_ActivePackSize += record_size;
+
+    Longtail_LockSpinLock(api->m_Lock);
+    hmput(api->m_PackBlockLocations, block_hash, location);
+    struct FSPack* pack = &api->m_Packs[api->m_ActivePackIndex];
+    arrput(pack->m_BlockHashes, block_hash);
+    pack->m_PackSize = api->m_ActivePackSize;
+    pack->m_IsIndexDirty = 1;
+    Longtail_UnlockSpinLock(api->m_Lock);
+    return 0;
+}
+
+// Caller must hold m_PackLock and must not hold m_Lock
+static int FlushPackIndexes(struct FSBlockStoreAPI* api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    Longtail_LockSpinLock(api->m_Lock);
+    uint32_t pack_count = (uint32_t)arrlen(api->m_Packs);
+    Longtail_UnlockSpinLock(api->m_Lock);
+    for (uint32_t p = 0; p < pack_count; ++p)
+    {
+        Longtail_LockSpinLock(api->m_Lock);
+        int is_index_dirty = api->m_Packs[p].m_IsIndexDirty;
+        Longtail_UnlockSpinLock(api->m_Lock);
+        if (!is_index_dirty)
+        {
+            continue;
+        }
+        int err = WritePackIndex(api, p);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "WritePackIndex() failed with %d", err)
+            return err;
+        }
+    }
+    return 0;
+}
+
+static int PackWriteStoredBlock(
+    struct FSBlockStoreAPI* api,
+    struct Longtail_StoredBlock* stored_block)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(api, "%p"),
+        LONGTAIL_LOGFIELD(stored_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    TLongtail_Hash block_hash = *stored_block->m_BlockIndex->m_BlockHash;
+    if (!api->m_PackIndexesLoaded)
+    {
+        int err = LoadPackIndexes(api);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LoadPackIndexes() failed with %d", err)
+            return err;
+        }
+    }
+
+    // Check if block exists, if it does it is just the store store index that is out of sync.
+    Longtail_LockSpinLock(api->m_Lock);
+    int exists = hmgeti(api->m_PackBlockLocations, block_hash) != -1;
+    Longtail_UnlockSpinLock(api->m_Lock);
+    if (exists)
+    {
+        return 0;
+    }
+
+    void* buffer;
+    size_t size;
+    int err = Longtail_WriteStoredBlockToBuffer(stored_block, &buffer, &size);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_WriteStoredBlockToBuffer() failed with %d", err)
+        return err;
+    }
+    Longtail_WaitSema(api->m_PackLock, LONGTAIL_TIMEOUT_INFINITE);
+    err = AppendToPack(api, block_hash, buffer, (uint32_t)size);
+    Longtail_PostSema(api->m_PackLock, 1);
+    Longtail_Free(buffer);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "AppendToPack() failed with %d", err)
+        return err;
+    }
+    return 0;
+}
+
+static int UpdateStoreIndex(
+    struct Longtail_StoreIndex* current_store_index,
+    struct Longtail_BlockIndex** added_block_indexes,
+    struct Longtail_StoreIndex** out_store_index)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(current_store_index, "%p"),
+        LONGTAIL_LOGFIELD(added_block_indexes, "%p"),
+        LONGTAIL_LOGFIELD(out_store_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    struct Longtail_StoreIndex* added_store_index;
+    int err = Longtail_CreateStoreIndexFromBlocks(
+        (uint32_t)(arrlen(added_block_indexes)),
+        (const struct Longtail_BlockIndex** )added_block_indexes,
+        &added_store_index);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
+        return err;
+    }
+    struct Longtail_StoreIndex* new_store_index;
+    err = Longtail_MergeStoreIndex(
+        added_store_index,  // Added first as it has precedence
+        current_store_index,
+        &new_store_index);
+    Longtail_Free(added_store_index);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_MergeStoreIndex() failed with %d", err)
+        return err;
+    }
+    *out_store_index = new_store_index;
+    return 0;
+}
+
+struct FSStoredBlock
+{
+    struct Longtail_StoredBlock m_StoredBlock;
+};
+
+static int FSStoredBlock_Dispose(struct Longtail_StoredBlock* stored_block)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(stored_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_FATAL_ASSERT(ctx, stored_block, return EINVAL)
+    Longtail_Free(stored_block);
+    return 0;
+}
+
+// When rebuilding the store index each scan job reads the block index of SCAN_BLOCK_JOB_FILE_COUNT block files,
+// using a single read of at most SCAN_BLOCK_READ_SIZE bytes per block file for all but the largest block indexes.
+// Every SCAN_CHECKPOINT_FILE_COUNT files the block indexes read so far are written as a store index to the
+// SCAN_CHECKPOINT_FOLDER so an interrupted rebuild can resume without reading those block files again.
+#define SCAN_BLOCK_READ_SIZE 16384
+#define SCAN_BLOCK_JOB_FILE_COUNT 64
+#define SCAN_CHECKPOINT_FILE_COUNT 16384
+#define SCAN_CHECKPOINT_FOLDER "store.lsi.scan"
+
+struct ScanBlockJob
+{
+    struct Longtail_StorageAPI* m_StorageAPI;
+    const char* m_StorePath;
+    const char* m_ChunksPath;
+    const char* m_BlockExtension;
+    const struct Longtail_FileInfos* m_FileInfos;
+    uint32_t m_FirstPathIndex;
+    uint32_t m_PathCount;
+    struct Longtail_BlockIndex** m_BlockIndexes;
+};
+
+// Reads the block index of a block file with a known size using one read unless the block index is larger than SCAN_BLOCK_READ_SIZE
+static int ReadBlockIndexWithSize(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    uint64_t block_size,
+    struct Longtail_BlockIndex** out_block_index)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(block_size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(out_block_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    const size_t header_size = sizeof(TLongtail_Hash) + sizeof(uint32_t) + sizeof(uint32_t);
+    if (block_size < header_size || block_size > 0xffffffff)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "file size %" PRIu64 " is invalid, failed with %d", block_size, EBADF)
+        return EBADF;
+    }
+
+    Longtail_StorageAPI_HOpenFile f;
+    int err = storage_api->OpenReadFile(storage_api, path, &f);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_WARNING : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+        return err;
+    }
+    size_t read_size = block_size < SCAN_BLOCK_READ_SIZE ? (size_t)block_size : SCAN_BLOCK_READ_SIZE;
+    uint8_t* buffer = (uint8_t*)Longtail_Alloc("FSBlockStoreAPI", read_size);
+    if (!buffer)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        storage_api->CloseFile(storage_api, f);
+        return ENOMEM;
+    }
+    err = storage_api->Read(storage_api, f, 0, read_size, buffer);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
+        Longtail_Free(buffer);
+        storage_api->CloseFile(storage_api, f);
+        return err;
+    }
+    uint32_t chunk_count = *(const uint32_t*)&buffer[sizeof(TLongtail_Hash) + sizeof(uint32_t)];
+    size_t block_index_data_size = Longtail_GetBlockIndexDataSize(chunk_count);
+    if (chunk_count == 0 || block_index_data_size >= block_size)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "chunk count %u does not match file size %" PRIu64 ", failed with %d", chunk_count, block_size, EBADF)
+        Longtail_Free(buffer);
+        storage_api->CloseFile(storage_api, f);
+        return EBADF;
+    }
+    if (block_index_data_size > read_size)
+    {
+        uint8_t* full_buffer = (uint8_t*)Longtail_Alloc("FSBlockStoreAPI", block_index_data_size);
+        if (!full_buffer)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+            Longtail_Free(buffer);
+            storage_api->CloseFile(storage_api, f);
+            return ENOMEM;
+        }
+        memcpy(full_buffer, buffer, read_size);
+        Longtail_Free(buffer);
+        buffer = full_buffer;
+        err = storage_api->Read(storage_api, f, read_size, block_index_data_size - read_size, &buffer[read_size]);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
+            Longtail_Free(buffer);
+            storage_api->CloseFile(storage_api, f);
+            return err;
+        }
+    }
+    storage_api->CloseFile(storage_api, f);
+    err = Longtail_ReadBlockIndexFromBuffer(buffer, block_index_data_size, out_block_index);
+    Longtail_Free(buffer);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ReadBlockIndexFromBuffer() failed with %d", err)
+    }
+    return err;
+}
+
+static int ScanBlock(void* context, uint32_t job_id, int detected_error)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(job_id, "%u"),
+        LONGTAIL_LOGFIELD(detected_error, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return 0)
+    struct ScanBlockJob* job = (struct ScanBlockJob*)context;
+    if (detected_error)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "ScanBlock aborted due to previous error %d", detected_error)
+        return 0;
+    }
+
+    struct Longtail_StorageAPI* storage_api = job->m_StorageAPI;
+    const struct Longtail_FileInfos* file_infos = job->m_FileInfos;
+    for (uint32_t path_index = job->m_FirstPathIndex; path_index < job->m_FirstPathIndex + job->m_PathCount; ++path_index)
+    {
+        if (job->m_BlockIndexes[path_index])
+        {
+            // Read from a scan checkpoint
+            continue;
+        }
+        const char* block_path = &file_infos->m_PathData[file_infos->m_PathStartOffsets[path_index]];
+        if (!EndsWith(block_path, job->m_BlockExtension))
+        {
+            // Not a block, skip it
+            continue;
+        }
+
+        char* full_block_path = storage_api->ConcatPath(storage_api, job->m_ChunksPath, block_path);
+
+        struct Longtail_BlockIndex* block_index = 0;
+        int err = ReadBlockIndexWithSize(
+            storage_api,
+            full_block_path,
+            file_infos->m_Sizes[path_index],
+            &block_index);
+
+        if (err == 0)
+        {
+            TLongtail_Hash block_hash = *block_index->m_BlockHash;
+            char* validate_file_name = GetBlockPath(storage_api, job->m_StorePath, job->m_BlockExtension, block_hash);
+            if (strcmp(validate_file_name, full_block_path) != 0)
+            {
+                Longtail_Free(block_index);
+                block_index = 0;
+                err = EBADF;
+            }
+            Longtail_Free(validate_file_name);
+        }
+
+        Longtail_Free(full_block_path);
+        full_block_path = 0;
+        if (err)
+        {
+            return err;
+        }
+        job->m_BlockIndexes[path_index] = block_index;
+    }
+    return 0;
+}
+
+// Parses the block hash from the `0x<hash><extension>` block file name at the end of block_path
+static int ParseBlockHashFromPath(const char* block_path, const char* block_extension, TLongtail_Hash* out_block_hash)
+{
+    size_t path_length = strlen(block_path);
+    size_t name_length = (BLOCK_NAME_LENGTH - 5) + strlen(block_extension);
+    if (path_length < name_length || !EndsWith(block_path, block_extension))
+    {
+        return 0;
+    }
+    const char* name = &block_path[path_length - name_length];
+    if (name[0] != '0' || name[1] != 'x')
+    {
+        return 0;
+    }
+    TLongtail_Hash block_hash = 0;
+    for (uint32_t c = 2; c < 18; ++c)
+    {
+        char h = name[c];
+        uint64_t v = (h >= '0' && h <= '9') ? (uint64_t)(h - '0') : (h >= 'a' && h <= 'f') ? (uint64_t)(h - 'a' + 10) : 16;
+        if (v == 16)
+        {
+            return 0;
+        }
+        block_hash = (block_hash << 4) | v;
+    }
+    *out_block_hash = block_hash;
+    return 1;
+}
+
+// Reads the block indexes from the checkpoints of an interrupted rebuild of the store index
+static int ReadScanCheckpoints(
+    struct Longtail_StorageAPI* storage_api,
+    const char* store_path,
+    struct Longtail_BlockIndex*** out_block_indexes,
+    uint32_t* out_checkpoint_count)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(store_path, "%s"),
+        LONGTAIL_LOGFIELD(out_block_indexes, "%p"),
+        LONGTAIL_LOGFIELD(out_checkpoint_count, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    struct Longtail_BlockIndex** block_indexes = 0;
+    uint32_t checkpoint_count = 0;
+    char* checkpoint_path = storage_api->ConcatPath(storage_api, store_path, SCAN_CHECKPOINT_FOLDER);
+    if (!checkpoint_path)
+    {
+        return ENOMEM;
+    }
+    struct Longtail_FileInfos* file_infos = 0;
+    if (storage_api->IsDir(storage_api, checkpoint_path))
+    {
+        int err = Longtail_GetFilesRecursively2(storage_api, 0, 0, 0, 0, checkpoint_path, &file_infos);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to list scan checkpoints in `%s`, failed with %d", checkpoint_path, err)
+            file_infos = 0;
+        }
+    }
+    for (uint32_t f = 0; file_infos && f < file_infos->m_Count; ++f)
+    {
+        const char* file_name = &file_infos->m_PathData[file_infos->m_PathStartOffsets[f]];
+        if (!EndsWith(file_name, ".lsi"))
+        {
+            continue;
+        }
+        char* file_path = storage_api->ConcatPath(storage_api, checkpoint_path, file_name);
+        struct Longtail_StoreIndex* store_index = 0;
+        int err = file_path ? Longtail_ReadStoreIndex(storage_api, file_path, &store_index) : ENOMEM;
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to read scan checkpoint `%s`, failed with %d", file_path ? file_path : "", err)
+        }
+        else
+        {
+            uint32_t block_count = *store_index->m_BlockCount;
+            for (uint32_t b = 0; b < block_count; ++b)
+            {
+                struct Longtail_BlockIndex block_index;
+                Longtail_MakeBlockIndex(store_index, b, &block_index);
+                struct Longtail_BlockIndex* block_index_copy = Longtail_CopyBlockIndex(&block_index);
+                if (block_index_copy)
+                {
+                    arrput(block_indexes, block_index_copy);
+                }
+            }
+            Longtail_Free(store_index);
+        }
+        Longtail_Free(file_path);
+        ++checkpoint_count;
+    }
+    Longtail_Free(file_infos);
+    Longtail_Free(checkpoint_path);
+    *out_block_indexes = block_indexes;
+    *out_checkpoint_count = checkpoint_count;
+    return 0;
+}
+
+static int WriteScanCheckpoint(
+    struct Longtail_StorageAPI* storage_api,
+    const char* store_path,
+    uint32_t checkpoint_index,
+    uint32_t block_count,
+    const struct Longtail_BlockIndex** block_indexes)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(store_path, "%s"),
+        LONGTAIL_LOGFIELD(checkpoint_index, "%u"),
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(block_indexes, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    struct Longtail_StoreIndex* store_index;
+    int err = Longtail_CreateStoreIndexFromBlocks(block_count, block_indexes, &store_index);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
+        return err;
+    }
+    char file_name[sizeof(SCAN_CHECKPOINT_FOLDER) + 1 + 8 + 4 + 4 + 1];
+    sprintf(file_name, SCAN_CHECKPOINT_FOLDER "/%08x.lsi", checkpoint_index);
+    char* checkpoint_file_path = storage_api->ConcatPath(storage_api, store_path, file_name);
+    strcat(file_name, ".tmp");
+    char* tmp_checkpoint_file_path = storage_api->ConcatPath(storage_api, store_path, file_name);
+    err = (checkpoint_file_path && tmp_checkpoint_file_path) ? EnsureParentPathExists(storage_api, tmp_checkpoint_file_path) : ENOMEM;
+    if (!err)
+    {
+        err = Longtail_WriteStoreIndex(storage_api, store_index, tmp_checkpoint_file_path);
+    }
+    if (!err)
+    {
+        err = storage_api->RenameFile(storage_api, tmp_checkpoint_file_path, checkpoint_file_path);
+    }
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to write scan checkpoint, failed with %d", err)
+    }
+    Longtail_Free(tmp_checkpoint_file_path);
+    Longtail_Free(checkpoint_file_path);
+    Longtail_Free(store_index);
+    return err;
+}
+
+static void RemoveScanCheckpoints(
+    struct Longtail_StorageAPI* storage_api,
+    const char* store_path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(store_path, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    char* checkpoint_path = storage_api->ConcatPath(storage_api, store_path, SCAN_CHECKPOINT_FOLDER);
+    if (!checkpoint_path || !storage_api->IsDir(storage_api, checkpoint_path))
+    {
+        Longtail_Free(checkpoint_path);
+        return;
+    }
+    struct Longtail_FileInfos* file_infos;
+    int err = Longtail_GetFilesRecursively2(storage_api, 0, 0, 0, 0, checkpoint_path, &file_infos);
+    if (err == 0)
+    {
+        for (uint32_t f = 0; f < file_infos->m_Count; ++f)
+        {
+            char* file_path = storage_api->ConcatPath(storage_api, checkpoint_path, &file_infos->m_PathData[file_infos->m_PathStartOffsets[f]]);
+            if (file_path)
+            {
+                storage_api->RemoveFile(storage_api, file_path);
+                Longtail_Free(file_path);
+            }
+        }
+        Longtail_Free(file_infos);
+    }
+    err = storage_api->RemoveDir(storage_api, checkpoint_path);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to remove scan checkpoints in `%s`, failed with %d", checkpoint_path, err)
+    }
+    Longtail_Free(checkpoint_path);
 }
 
-static int ScanBlock(void* context, uint32_t job_id, int detected_error)
+// Reads the block indexes of all blocks in the pack files listed in file_infos that are not already in block_indexes,
+// including blocks appended to a pack after its pack index was written
+static int ScanPacks(
+    struct Longtail_StorageAPI* storage_api,
+    const char* store_path,
+    const struct Longtail_FileInfos* file_infos,
+    struct Longtail_BlockIndex** block_indexes,
+    uint32_t block_count,
+    struct Longtail_BlockIndex*** out_pack_block_indexes)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(context, "%p"),
-        LONGTAIL_LOGFIELD(job_id, "%u"),
-        LONGTAIL_LOGFIELD(detected_error, "%d")
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(store_path, "%s"),
+        LONGTAIL_LOGFIELD(file_infos, "%p"),
+        LONGTAIL_LOGFIELD(block_indexes, "%p"),
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(out_pack_block_indexes, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return 0)
-    struct ScanBlockJob* job = (struct ScanBlockJob*)context;
-    if (detected_error)
+    struct BlockHashToBlockState* found_blocks = 0;
+    for (uint32_t b = 0; b < block_count; ++b)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "ScanBlock aborted due to previous error %d", detected_error)
-        return 0;
+        hmput(found_blocks, *block_indexes[b]->m_BlockHash, b);
     }
-
-    const char* block_path = job->m_BlockPath;
-    if (!EndsWith(block_path, job->m_BlockExtension))
+    struct Longtail_BlockIndex** pack_block_indexes = 0;
+    int err = 0;
+    for (uint32_t f = 0; f < file_infos->m_Count && !err; ++f)
     {
-        // Not a block, skip it
-        return 0;
+        const char* file_path = &file_infos->m_PathData[file_infos->m_PathStartOffsets[f]];
+        if (!EndsWith(file_path, PACK_FILE_EXTENSION))
+        {
+            continue;
+        }
+        size_t name_length = strlen(file_path) - strlen(PACK_FILE_EXTENSION);
+        char* pack_name = (char*)Longtail_Alloc("FSBlockStoreAPI", name_length + 1);
+        if (!pack_name)
+        {
+            err = ENOMEM;
+            break;
+        }
+        memcpy(pack_name, file_path, name_length);
+        pack_name[name_length] = 0;
+        char* pack_path = GetPackPath(storage_api, store_path, pack_name, PACK_FILE_EXTENSION, "");
+
+        struct PackIndexEntry* entries = 0;
+        uint64_t pack_size = 0;
+        err = pack_path ? ReadPackEntries(storage_api, store_path, pack_name, file_infos->m_Sizes[f], &entries, &pack_size) : ENOMEM;
+        Longtail_Free(pack_name);
+        Longtail_StorageAPI_HOpenFile pack_file = 0;
+        if (!err)
+        {
+            err = storage_api->OpenReadFile(storage_api, pack_path, &pack_file);
+        }
+        if (err == ENOMEM)
+        {
+            arrfree(entries);
+            Longtail_Free(pack_path);
+            break;
+        }
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to read pack `%s`, failed with %d", pack_path, err)
+            arrfree(entries);
+            Longtail_Free(pack_path);
+            // Skip broken or concurrently removed packs
+            err = 0;
+            continue;
+        }
+        uint32_t pack_block_count = (uint32_t)arrlen(entries);
+        for (uint32_t b = 0; b < pack_block_count; ++b)
+        {
+            const struct PackIndexEntry* entry = &entries[b];
+            if (hmgeti(found_blocks, entry->m_BlockHash) != -1)
+            {
+                continue;
+            }
+            uint8_t header[sizeof(TLongtail_Hash) + sizeof(uint32_t) + sizeof(uint32_t)];
+            if (entry->m_Size < sizeof(header))
+            {
+                continue;
+            }
+            int read_err = storage_api->Read(storage_api, pack_file, entry->m_Offset, sizeof(header), header);
+            if (read_err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "storage_api->Read() in `%s` failed with %d", pack_path, read_err)
+                continue;
+            }
+            uint32_t chunk_count = *(const uint32_t*)&header[sizeof(TLongtail_Hash) + sizeof(uint32_t)];
+            size_t block_index_data_size = Longtail_GetBlockIndexDataSize(chunk_count);
+            if (block_index_data_size > entry->m_Size)
+            {
+                continue;
+            }
+            void* block_index_data = Longtail_Alloc("FSBlockStoreAPI", block_index_data_size);
+            if (!block_index_data)
+            {
+                err = ENOMEM;
+                break;
+            }
+            struct Longtail_BlockIndex* block_index = 0;
+            read_err = storage_api->Read(storage_api, pack_file, entry->m_Offset, block_index_data_size, block_index_data);
+            if (!read_err)
+            {
+                read_err = Longtail_ReadBlockIndexFromBuffer(block_index_data, block_index_data_size, &block_index);
+            }
+            Longtail_Free(block_index_data);
+            if (read_err || (*block_index->m_BlockHash != entry->m_BlockHash))
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Invalid block %" PRIx64 " in `%s`", entry->m_BlockHash, pack_path)
+                Longtail_Free(block_index);
+                continue;
+            }
+            hmput(found_blocks, entry->m_BlockHash, block_count + (uint32_t)arrlen(pack_block_indexes));
+            arrput(pack_block_indexes, block_index);
+        }
+        storage_api->CloseFile(storage_api, pack_file);
+        arrfree(entries);
+        Longtail_Free(pack_path);
     }
-
-    struct Longtail_StorageAPI* storage_api = job->m_StorageAPI;
-    const char* chunks_path = job->m_ChunksPath;
-    char* full_block_path = storage_api->ConcatPath(storage_api, chunks_path, block_path);
-
-    int err = Longtail_ReadBlockIndex(
-        storage_api,
-        full_block_path,
-        &job->m_BlockIndex);
-
-    if (err == 0)
+    hmfree(found_blocks);
+    if (err)
     {
-        TLongtail_Hash block_hash = *job->m_BlockIndex->m_BlockHash;
-        char* validate_file_name = GetBlockPath(storage_api, job->m_StorePath, job->m_BlockExtension, block_hash);
-        if (strcmp(validate_file_name, full_block_path) != 0)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ScanPacks failed with %d", err)
+        for (intptr_t b = 0; b < arrlen(pack_block_indexes); ++b)
         {
-            Longtail_Free(job->m_BlockIndex);
-            job->m_BlockIndex = 0;
-            err = EBADF;
+            Longtail_Free(pack_block_indexes[b]);
         }
-        Longtail_Free(validate_file_name);
+        arrfree(pack_block_indexes);
+        return err;
     }
-
-    Longtail_Free(full_block_path);
-    full_block_path = 0;
-    return err;
+    *out_pack_block_indexes = pack_block_indexes;
+    return 0;
 }
 
 static int ReadContent(
@@ -495,90 +1725,205 @@ static int ReadContent(
         Longtail_Free((void*)chunks_path);
         return err;
     }
-    Longtail_JobAPI_Group job_group;
-    err = job_api->ReserveJobs(job_api, path_count, &job_group);
+
+    size_t block_indexes_size = sizeof(struct Longtail_BlockIndex*) * (path_count);
+    struct Longtail_BlockIndex** block_indexes = (struct Longtail_BlockIndex**)Longtail_Alloc("FSBlockStoreAPI", block_indexes_size);
+    if (!block_indexes)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(file_infos);
+        Longtail_Free((void*)chunks_path);
+        return ENOMEM;
+    }
+    memset(block_indexes, 0, block_indexes_size);
+
+    // Pick up the block indexes from an interrupted scan
+    struct Longtail_BlockIndex** checkpoint_block_indexes = 0;
+    uint32_t checkpoint_count = 0;
+    err = ReadScanCheckpoints(storage_api, store_path, &checkpoint_block_indexes, &checkpoint_count);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job_api->ReserveJobs() failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ReadScanCheckpoints() failed with %d", err)
+        Longtail_Free(block_indexes);
         Longtail_Free(file_infos);
         Longtail_Free((void*)chunks_path);
         return err;
     }
+    intptr_t checkpoint_block_count = arrlen(checkpoint_block_indexes);
+    if (checkpoint_block_count > 0)
+    {
+        struct BlockHashToBlockState* checkpoint_lookup = 0;
+        for (intptr_t b = 0; b < checkpoint_block_count; ++b)
+        {
+            hmput(checkpoint_lookup, *checkpoint_block_indexes[b]->m_BlockHash, (uint32_t)b);
+        }
+        for (uint32_t path_index = 0; path_index < path_count; ++path_index)
+        {
+            const char* block_path = &file_infos->m_PathData[file_infos->m_PathStartOffsets[path_index]];
+            TLongtail_Hash block_hash;
+            if (!ParseBlockHashFromPath(block_path, block_extension, &block_hash))
+            {
+                continue;
+            }
+            intptr_t lookup_ptr = hmgeti(checkpoint_lookup, block_hash);
+            if (lookup_ptr == -1 || checkpoint_block_indexes[checkpoint_lookup[lookup_ptr].value] == 0)
+            {
+                continue;
+            }
+            char* full_block_path = storage_api->ConcatPath(storage_api, chunks_path, block_path);
+            char* validate_file_name = GetBlockPath(storage_api, store_path, block_extension, block_hash);
+            if (full_block_path && validate_file_name && strcmp(validate_file_name, full_block_path) == 0)
+            {
+                uint32_t b = checkpoint_lookup[lookup_ptr].value;
+                block_indexes[path_index] = checkpoint_block_indexes[b];
+                checkpoint_block_indexes[b] = 0;
+            }
+            Longtail_Free(validate_file_name);
+            Longtail_Free(full_block_path);
+        }
+        hmfree(checkpoint_lookup);
+        for (intptr_t b = 0; b < checkpoint_block_count; ++b)
+        {
+            Longtail_Free(checkpoint_block_indexes[b]);
+        }
+    }
+    arrfree(checkpoint_block_indexes);
 
-    size_t scan_jobs_size = sizeof(struct ScanBlockJob) * path_count;
-    struct ScanBlockJob* scan_jobs = (struct ScanBlockJob*)Longtail_Alloc("FSBlockStoreAPI", scan_jobs_size);
+    uint32_t max_job_count = (SCAN_CHECKPOINT_FILE_COUNT + SCAN_BLOCK_JOB_FILE_COUNT - 1) / SCAN_BLOCK_JOB_FILE_COUNT;
+    struct ScanBlockJob* scan_jobs = (struct ScanBlockJob*)Longtail_Alloc("FSBlockStoreAPI", sizeof(struct ScanBlockJob) * max_job_count);
     if (!scan_jobs)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        Longtail_Free(file_infos);
-        Longtail_Free((void*)chunks_path);
-        return ENOMEM;
+        err = ENOMEM;
+    }
+
+    for (uint32_t batch_start = 0; (batch_start < path_count) && !err; batch_start += SCAN_CHECKPOINT_FILE_COUNT)
+    {
+        uint32_t batch_end = (path_count - batch_start) > SCAN_CHECKPOINT_FILE_COUNT ? batch_start + SCAN_CHECKPOINT_FILE_COUNT : path_count;
+        uint32_t job_count = (batch_end - batch_start + SCAN_BLOCK_JOB_FILE_COUNT - 1) / SCAN_BLOCK_JOB_FILE_COUNT;
+
+        Longtail_JobAPI_Group job_group;
+        err = job_api->ReserveJobs(job_api, job_count, &job_group);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job_api->ReserveJobs() failed with %d", err)
+            break;
+        }
+
+        for (uint32_t job_index = 0; job_index < job_count; ++job_index)
+        {
+            struct ScanBlockJob* job = &scan_jobs[job_index];
+            uint32_t first_path_index = batch_start + job_index * SCAN_BLOCK_JOB_FILE_COUNT;
+            job->m_StorageAPI = storage_api;
+            job->m_StorePath = store_path;
+            job->m_ChunksPath = chunks_path;
+            job->m_BlockExtension = block_extension;
+            job->m_FileInfos = file_infos;
+            job->m_FirstPathIndex = first_path_index;
+            job->m_PathCount = (batch_end - first_path_index) > SCAN_BLOCK_JOB_FILE_COUNT ? SCAN_BLOCK_JOB_FILE_COUNT : batch_end - first_path_index;
+            job->m_BlockIndexes = block_indexes;
+
+            Longtail_JobAPI_JobFunc job_func[] = {ScanBlock};
+            void* ctxs[] = {job};
+            Longtail_JobAPI_Jobs jobs;
+            err = job_api->CreateJobs(job_api, job_group, 0, 0, 0, 1, job_func, ctxs, 0, &jobs);
+            LONGTAIL_FATAL_ASSERT(ctx, !err, return err)
+            err = job_api->ReadyJobs(job_api, 1, jobs);
+            LONGTAIL_FATAL_ASSERT(ctx, !err, return err)
+        }
+
+        err = job_api->WaitForAllJobs(job_api, job_group, 0, 0, 0);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_INFO : LONGTAIL_LOG_LEVEL_ERROR, "job_api->WaitForAllJobs() failed with %d", err)
+            break;
+        }
+
+        if (batch_end < path_count)
+        {
+            struct Longtail_BlockIndex** batch_block_indexes = 0;
+            for (uint32_t path_index = batch_start; path_index < batch_end; ++path_index)
+            {
+                if (block_indexes[path_index])
+                {
+                    arrput(batch_block_indexes, block_indexes[path_index]);
+                }
+            }
+            if (arrlen(batch_block_indexes) > 0)
+            {
+                // Failing to write a checkpoint only means that an interrupted scan has to read more blocks when resumed
+                WriteScanCheckpoint(storage_api, store_path, checkpoint_count++, (uint32_t)arrlen(batch_block_indexes), (const struct Longtail_BlockIndex**)batch_block_indexes);
+            }
+            arrfree(batch_block_indexes);
+        }
     }
+    Longtail_Free(scan_jobs);
+    scan_jobs = 0;
 
+    uint32_t block_count = 0;
     for (uint32_t path_index = 0; path_index < path_count; ++path_index)
     {
-        struct ScanBlockJob* job = &scan_jobs[path_index];
-        const char* block_path = &file_infos->m_PathData[file_infos->m_PathStartOffsets[path_index]];
-        job->m_StorageAPI = storage_api;
-        job->m_StorePath = store_path;
-        job->m_ChunksPath = chunks_path;
-        job->m_BlockPath = block_path;
-        job->m_BlockExtension = block_extension;
-        job->m_BlockIndex = 0;
-
-        Longtail_JobAPI_JobFunc job_func[] = {ScanBlock};
-        void* ctxs[] = {job};
-        Longtail_JobAPI_Jobs jobs;
-        err = job_api->CreateJobs(job_api, job_group, 0, 0, 0, 1, job_func, ctxs, 0, &jobs);
-        LONGTAIL_FATAL_ASSERT(ctx, !err, return err)
-        err = job_api->ReadyJobs(job_api, 1, jobs);
-        LONGTAIL_FATAL_ASSERT(ctx, !err, return err)
-    }
-
-    err = job_api->WaitForAllJobs(job_api, job_group, 0, 0, 0);
+        if (block_indexes[path_index])
+        {
+            block_indexes[block_count] = block_indexes[path_index];
+            ++block_count;
+        }
+    }
+
     if (err)
     {
-        LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_INFO : LONGTAIL_LOG_LEVEL_ERROR, "job_api->WaitForAllJobs() failed with %d", err)
-        for (uint32_t path_index = 0; path_index < path_count; ++path_index)
+        for (uint32_t b = 0; b < block_count; ++b)
         {
-            struct ScanBlockJob* job = &scan_jobs[path_index];
-            Longtail_Free(job->m_BlockIndex);
+            Longtail_Free(block_indexes[b]);
         }
-        Longtail_Free(scan_jobs);
+        Longtail_Free(block_indexes);
         Longtail_Free(file_infos);
         Longtail_Free((void*)chunks_path);
         return err;
     }
 
-    size_t block_indexes_size = sizeof(struct Longtail_BlockIndex*) * (path_count);
-    struct Longtail_BlockIndex** block_indexes = (struct Longtail_BlockIndex**)Longtail_Alloc("FSBlockStoreAPI", block_indexes_size);
-    if (!block_indexes)
+    struct Longtail_BlockIndex** pack_block_indexes = 0;
+    err = ScanPacks(storage_api, store_path, file_infos, block_indexes, block_count, &pack_block_indexes);
+    if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        for (uint32_t path_index = 0; path_index < path_count; ++path_index)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ScanPacks() failed with %d", err)
+        for (uint32_t b = 0; b < block_count; ++b)
         {
-            struct ScanBlockJob* job = &scan_jobs[path_index];
-            Longtail_Free(job->m_BlockIndex);
+            Longtail_Free(block_indexes[b]);
         }
-        Longtail_Free(scan_jobs);
+        Longtail_Free(block_indexes);
         Longtail_Free(file_infos);
         Longtail_Free((void*)chunks_path);
-        return ENOMEM;
+        return err;
     }
-
-    uint32_t block_count = 0;
-    for (uint32_t path_index = 0; path_index < path_count; ++path_index)
+    uint32_t pack_block_count = (uint32_t)arrlen(pack_block_indexes);
+    if (pack_block_count > 0)
     {
-        struct ScanBlockJob* job = &scan_jobs[path_index];
-        if (job->m_BlockIndex)
+        struct Longtail_BlockIndex** all_block_indexes = (struct Longtail_BlockIndex**)Longtail_Alloc("FSBlockStoreAPI", sizeof(struct Longtail_BlockIndex*) * (block_count + pack_block_count));
+        if (!all_block_indexes)
         {
-            block_indexes[block_count] = job->m_BlockIndex;
-            ++block_count;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+            for (uint32_t b = 0; b < block_count; ++b)
+            {
+                Longtail_Free(block_indexes[b]);
+            }
+            for (uint32_t b = 0; b < pack_block_count; ++b)
+            {
+                Longtail_Free(pack_block_indexes[b]);
+            }
+            arrfree(pack_block_indexes);
+            Longtail_Free(block_indexes);
+            Longtail_Free(file_infos);
+            Longtail_Free((void*)chunks_path);
+            return ENOMEM;
         }
+        memcpy(all_block_indexes, block_indexes, sizeof(struct Longtail_BlockIndex*) * block_count);
+        memcpy(&all_block_indexes[block_count], pack_block_indexes, sizeof(struct Longtail_BlockIndex*) * pack_block_count);
+        Longtail_Free(block_indexes);
+        block_indexes = all_block_indexes;
+        block_count += pack_block_count;
     }
-
-    Longtail_Free(scan_jobs);
-    scan_jobs = 0;
+    arrfree(pack_block_indexes);
 
     Longtail_Free(file_infos);
     file_infos = 0;
@@ -599,8 +1944,10 @@ static int ReadContent(
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
+        return err;
     }
-    return err;
+    RemoveScanCheckpoints(storage_api, store_path);
+    return 0;
 }
 
 
@@ -819,10 +2166,12 @@ static int FSBlockStore_PutStoredBlock(
     hmput(fsblockstore_api->m_BlockState, block_hash, 0);
     Longtail_UnlockSpinLock(fsblockstore_api->m_Lock);
 
-    int err = SafeWriteStoredBlock(fsblockstore_api, fsblockstore_api->m_StorageAPI, fsblockstore_api->m_StorePath, fsblockstore_api->m_BlockExtension, stored_block);
+    int err = (fsblockstore_api->m_MaxPackSize > 0) ?
+        PackWriteStoredBlock(fsblockstore_api, stored_block) :
+        SafeWriteStoredBlock(fsblockstore_api, fsblockstore_api->m_StorageAPI, fsblockstore_api->m_StorePath, fsblockstore_api->m_BlockExtension, stored_block);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "SafeWriteStoredBlock() failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Writing stored block failed with %d", err)
         Longtail_AtomicAdd64(&fsblockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_FailCount], 1);
         Longtail_LockSpinLock(fsblockstore_api->m_Lock);
         hmdel(fsblockstore_api->m_BlockState, block_hash);
@@ -893,67 +2242,212 @@ static int FSBlockStore_PreflightGet(
     TLongtail_Hash* found_block_hashes = (TLongtail_Hash*)Longtail_Alloc("CacheBlockStore", sizeof(TLongtail_Hash) * block_count);
     if (!found_block_hashes)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Longtail_Alloc() failed with %d", ENOMEM)
-        Longtail_Free(requested_block_lookup);
-        Longtail_Free(store_index);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(requested_block_lookup);
+        Longtail_Free(store_index);
+        return ENOMEM;
+    }
+
+    uint32_t found_block_count = 0;
+    for (uint32_t b = 0; b < block_count; ++b)
+    {
+        TLongtail_Hash block_hash = block_hashes[b];
+        LongtailPrivate_LookupTable_PutUnique(requested_block_lookup, block_hash, b);
+    }
+
+    for (uint32_t b = 0; b < *store_index->m_BlockCount; ++b)
+    {
+        TLongtail_Hash block_hash = store_index->m_BlockHashes[b];
+        if (LongtailPrivate_LookupTable_Get(requested_block_lookup, block_hash))
+        {
+            found_block_hashes[found_block_count++] = block_hash;
+        }
+    }
+    Longtail_Free(store_index);
+    store_index = 0;
+    Longtail_Free(requested_block_lookup);
+
+    optional_async_complete_api->OnComplete(optional_async_complete_api, found_block_count, found_block_hashes, 0);
+
+    Longtail_Free(found_block_hashes);
+
+    return 0;
+}
+
+static int MappedStoredBlock_Dispose(struct Longtail_StoredBlock* stored_block)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(stored_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, stored_block, return EINVAL)
+
+    const char* p = (const char*)stored_block;
+    p += Longtail_GetStoredBlockSize(0);
+
+    struct Longtail_StorageAPI* storage_api = *(struct Longtail_StorageAPI**)p;
+    p += sizeof(struct Longtail_StorageAPI*);
+    Longtail_StorageAPI_HOpenFile file_handle = *(Longtail_StorageAPI_HOpenFile*)p;
+    p += sizeof(Longtail_StorageAPI_HOpenFile);
+    Longtail_StorageAPI_HFileMap file_map = *(Longtail_StorageAPI_HFileMap*)p;
+
+    storage_api->UnMapFile(storage_api, file_map);
+    storage_api->CloseFile(storage_api, file_handle);
+
+    Longtail_Free(stored_block);
+    return 0;
+}
+
+
+static int ReadPackedStoredBlock(
+    struct Longtail_StorageAPI* storage_api,
+    const char* pack_path,
+    const struct PackBlockLocation* location,
+    int enable_file_mapping,
+    struct Longtail_StoredBlock** out_stored_block)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(pack_path, "%s"),
+        LONGTAIL_LOGFIELD(location, "%p"),
+        LONGTAIL_LOGFIELD(enable_file_mapping, "%d"),
+        LONGTAIL_LOGFIELD(out_stored_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    Longtail_StorageAPI_HOpenFile file_handle;
+    int err = storage_api->OpenReadFile(storage_api, pack_path, &file_handle);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_INFO : LONGTAIL_LOG_LEVEL_WARNING, "storage_api->OpenReadFile() failed with %d", err)
+        return err;
+    }
+
+    if (enable_file_mapping)
+    {
+        void* block_data;
+        Longtail_StorageAPI_HFileMap file_map;
+        err = storage_api->MapFile(storage_api, file_handle, location->m_Offset, location->m_Size, &file_map, (const void**)&block_data);
+        if (!err)
+        {
+            size_t block_mem_size = Longtail_GetStoredBlockSize(0) + sizeof(struct Longtail_StorageAPI*) + sizeof(Longtail_StorageAPI_HOpenFile) + sizeof(Longtail_StorageAPI_HFileMap);
+            struct Longtail_StoredBlock* stored_block = (struct Longtail_StoredBlock*)Longtail_Alloc("FSBlockStoreAPI", block_mem_size);
+            if (!stored_block)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+                storage_api->UnMapFile(storage_api, file_map);
+                storage_api->CloseFile(storage_api, file_handle);
+                return ENOMEM;
+            }
+            err = Longtail_InitStoredBlockFromData(stored_block, block_data, location->m_Size);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitStoredBlockFromData() failed with %d", err)
+                Longtail_Free(stored_block);
+                storage_api->UnMapFile(storage_api, file_map);
+                storage_api->CloseFile(storage_api, file_handle);
+                return err;
+            }
+            char* p = (char*)stored_block;
+            p += Longtail_GetStoredBlockSize(0);
+            *(struct Longtail_StorageAPI**)p = storage_api;
+            p += sizeof(struct Longtail_StorageAPI*);
+            *(Longtail_StorageAPI_HOpenFile*)p = file_handle;
+            p += sizeof(Longtail_StorageAPI_HOpenFile);
+            *(Longtail_StorageAPI_HFileMap*)p = file_map;
+            stored_block->Dispose = MappedStoredBlock_Dispose;
+            *out_stored_block = stored_block;
+            return 0;
+        }
+        else if (err != ENOTSUP)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "storage_api->MapFile() failed with %d", err)
+            storage_api->CloseFile(storage_api, file_handle);
+            return err;
+        }
+    }
+
+    size_t block_mem_size = Longtail_GetStoredBlockSize(location->m_Size);
+    struct Longtail_StoredBlock* stored_block = (struct Longtail_StoredBlock*)Longtail_Alloc("FSBlockStoreAPI", block_mem_size);
+    if (!stored_block)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        storage_api->CloseFile(storage_api, file_handle);
         return ENOMEM;
     }
-
-    uint32_t found_block_count = 0;
-    for (uint32_t b = 0; b < block_count; ++b)
+    void* block_data = &((uint8_t*)stored_block)[block_mem_size - location->m_Size];
+    err = storage_api->Read(storage_api, file_handle, location->m_Offset, location->m_Size, block_data);
+    storage_api->CloseFile(storage_api, file_handle);
+    if (err)
     {
-        TLongtail_Hash block_hash = block_hashes[b];
-        LongtailPrivate_LookupTable_PutUnique(requested_block_lookup, block_hash, b);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "storage_api->Read() failed with %d", err)
+        Longtail_Free(stored_block);
+        return err;
     }
-
-    for (uint32_t b = 0; b < *store_index->m_BlockCount; ++b)
+    err = Longtail_InitStoredBlockFromData(stored_block, block_data, location->m_Size);
+    if (err)
     {
-        TLongtail_Hash block_hash = store_index->m_BlockHashes[b];
-        if (LongtailPrivate_LookupTable_Get(requested_block_lookup, block_hash))
-        {
-            found_block_hashes[found_block_count++] = block_hash;
-        }
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitStoredBlockFromData() failed with %d", err)
+        Longtail_Free(stored_block);
+        return err;
     }
-    Longtail_Free(store_index);
-    store_index = 0;
-    Longtail_Free(requested_block_lookup);
-
-    optional_async_complete_api->OnComplete(optional_async_complete_api, found_block_count, found_block_hashes, 0);
-
-    Longtail_Free(found_block_hashes);
-
+    stored_block->Dispose = FSStoredBlock_Dispose;
+    *out_stored_block = stored_block;
     return 0;
 }
 
-static int MappedStoredBlock_Dispose(struct Longtail_StoredBlock* stored_block)
+static int GetPackedStoredBlock(
+    struct FSBlockStoreAPI* api,
+    uint64_t block_hash,
+    struct Longtail_StoredBlock** out_stored_block)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(stored_block, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
-
-    LONGTAIL_FATAL_ASSERT(ctx, stored_block, return EINVAL)
-
-    const char* p = (const char*)stored_block;
-    p += Longtail_GetStoredBlockSize(0);
-
-    struct Longtail_StorageAPI* storage_api = *(struct Longtail_StorageAPI**)p;
-    p += sizeof(struct Longtail_StorageAPI*);
-    Longtail_StorageAPI_HOpenFile file_handle = *(Longtail_StorageAPI_HOpenFile*)p;
-    p += sizeof(Longtail_StorageAPI_HOpenFile);
-    Longtail_StorageAPI_HFileMap file_map = *(Longtail_StorageAPI_HFileMap*)p;
-
-    storage_api->UnMapFile(storage_api, file_map);
-    storage_api->CloseFile(storage_api, file_handle);
+        LONGTAIL_LOGFIELD(api, "%p"),
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(out_stored_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    Longtail_Free(stored_block);
-    return 0;
+    // The active pack is appended to while we read, don't keep it open or mapped.
+    // Storage APIs may not allow reading a file that is open for write so we close the pack, the next append reopens it
+    Longtail_WaitSema(api->m_PackLock, LONGTAIL_TIMEOUT_INFINITE);
+    Longtail_LockSpinLock(api->m_Lock);
+    intptr_t location_ptr = hmgeti(api->m_PackBlockLocations, block_hash);
+    if (location_ptr == -1)
+    {
+        Longtail_UnlockSpinLock(api->m_Lock);
+        Longtail_PostSema(api->m_PackLock, 1);
+        return ENOENT;
+    }
+    struct PackBlockLocation location = api->m_PackBlockLocations[location_ptr].value;
+    char* pack_path = GetPackPath(api->m_StorageAPI, api->m_StorePath, api->m_Packs[location.m_PackIndex].m_Name, PACK_FILE_EXTENSION, "");
+    Longtail_UnlockSpinLock(api->m_Lock);
+    if (!pack_path)
+    {
+        Longtail_PostSema(api->m_PackLock, 1);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "GetPackPath() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    int is_active_pack = location.m_PackIndex == api->m_ActivePackIndex;
+    if (is_active_pack)
+    {
+        CloseActivePackFile(api);
+    }
+    else
+    {
+        Longtail_PostSema(api->m_PackLock, 1);
+    }
+    int err = ReadPackedStoredBlock(api->m_StorageAPI, pack_path, &location, is_active_pack ? 0 : api->m_EnableFileMapping, out_stored_block);
+    if (is_active_pack)
+    {
+        Longtail_PostSema(api->m_PackLock, 1);
+    }
+    Longtail_Free(pack_path);
+    return err;
 }
 
-
 static int FSBlockStore_GetStoredBlock(
     struct Longtail_BlockStoreAPI* block_store_api,
     uint64_t block_hash,
@@ -975,18 +2469,42 @@ static int FSBlockStore_GetStoredBlock(
     struct FSBlockStoreAPI* fsblockstore_api = (struct FSBlockStoreAPI*)block_store_api;
     Longtail_AtomicAdd64(&fsblockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count], 1);
 
+    if (!fsblockstore_api->m_PackIndexesLoaded)
+    {
+        int err = LoadPackIndexes(fsblockstore_api);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "LoadPackIndexes() failed with %d", err)
+        }
+    }
+
     Longtail_LockSpinLock(fsblockstore_api->m_Lock);
     intptr_t block_ptr = hmgeti(fsblockstore_api->m_BlockState, block_hash);
     if (block_ptr == -1)
     {
-        char* block_path = GetBlockPath(fsblockstore_api->m_StorageAPI, fsblockstore_api->m_StorePath, fsblockstore_api->m_BlockExtension, block_hash);
-        if (!fsblockstore_api->m_StorageAPI->IsFile(fsblockstore_api->m_StorageAPI, block_path))
+        int is_packed = hmgeti(fsblockstore_api->m_PackBlockLocations, block_hash) != -1;
+        if (!is_packed)
         {
+            char* block_path = GetBlockPath(fsblockstore_api->m_StorageAPI, fsblockstore_api->m_StorePath, fsblockstore_api->m_BlockExtension, block_hash);
+            int is_file = fsblockstore_api->m_StorageAPI->IsFile(fsblockstore_api->m_StorageAPI, block_path);
             Longtail_Free((void*)block_path);
-            Longtail_UnlockSpinLock(fsblockstore_api->m_Lock);
-            return ENOENT;
+            if (!is_file)
+            {
+                // The block may have been added to a pack by another instance
+                Longtail_UnlockSpinLock(fsblockstore_api->m_Lock);
+                int err = LoadPackIndexes(fsblockstore_api);
+                if (err)
+                {
+                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "LoadPackIndexes() failed with %d", err)
+                }
+                Longtail_LockSpinLock(fsblockstore_api->m_Lock);
+                if (hmgeti(fsblockstore_api->m_PackBlockLocations, block_hash) == -1)
+                {
+                    Longtail_UnlockSpinLock(fsblockstore_api->m_Lock);
+                    return ENOENT;
+                }
+            }
         }
-        Longtail_Free((void*)block_path);
         hmput(fsblockstore_api->m_BlockState, block_hash, 1);
         block_ptr = hmgeti(fsblockstore_api->m_BlockState, block_hash);
     }
@@ -999,6 +2517,26 @@ static int FSBlockStore_GetStoredBlock(
         state = hmget(fsblockstore_api->m_BlockState, block_hash);
         Longtail_UnlockSpinLock(fsblockstore_api->m_Lock);
     }
+
+    Longtail_LockSpinLock(fsblockstore_api->m_Lock);
+    int is_packed = hmgeti(fsblockstore_api->m_PackBlockLocations, block_hash) != -1;
+    Longtail_UnlockSpinLock(fsblockstore_api->m_Lock);
+    if (is_packed)
+    {
+        struct Longtail_StoredBlock* stored_block = 0;
+        int err = GetPackedStoredBlock(fsblockstore_api, block_hash, &stored_block);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_INFO : LONGTAIL_LOG_LEVEL_WARNING, "GetPackedStoredBlock() failed with %d", err)
+            Longtail_AtomicAdd64(&fsblockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_FailCount], 1);
+            return err;
+        }
+        Longtail_AtomicAdd64(&fsblockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Chunk_Count], *stored_block->m_BlockIndex->m_ChunkCount);
+        Longtail_AtomicAdd64(&fsblockstore_api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Byte_Count], Longtail_GetBlockIndexDataSize(*stored_block->m_BlockIndex->m_ChunkCount) + stored_block->m_BlockChunksDataSize);
+        async_complete_api->OnComplete(async_complete_api, stored_block, 0);
+        return 0;
+    }
+
     char* block_path = GetBlockPath(fsblockstore_api->m_StorageAPI, fsblockstore_api->m_StorePath, fsblockstore_api->m_BlockExtension, block_hash);
 
     struct Longtail_StoredBlock* stored_block = 0;
@@ -1140,6 +2678,249 @@ static int FSBlockStore_GetExistingContent(
     return 0;
 }
 
+// Removes pruned blocks from the packs. A pack without live blocks is deleted, a pack where less than
+// PACK_REWRITE_LIVE_PERCENT of the data is live has its live blocks moved to the active pack and is then deleted.
+// Other packs keep their data and get their pack index rewritten without the pruned blocks.
+// Caller must not hold m_PackLock or m_Lock
+static int PrunePacks(
+    struct FSBlockStoreAPI* api,
+    struct Longtail_LookupTable* kept_block_lookup)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(api, "%p"),
+        LONGTAIL_LOGFIELD(kept_block_lookup, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    struct Longtail_StorageAPI* storage_api = api->m_StorageAPI;
+    int err = LoadPackIndexes(api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LoadPackIndexes() failed with %d", err)
+        return err;
+    }
+
+    Longtail_WaitSema(api->m_PackLock, LONGTAIL_TIMEOUT_INFINITE);
+    err = SealActivePack(api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "SealActivePack() failed with %d", err)
+        Longtail_PostSema(api->m_PackLock, 1);
+        return err;
+    }
+
+    Longtail_LockSpinLock(api->m_Lock);
+    uint32_t pack_count = (uint32_t)arrlen(api->m_Packs);
+    Longtail_UnlockSpinLock(api->m_Lock);
+
+    uint32_t* removed_packs = 0;
+    TLongtail_Hash* live_hashes = 0;
+    struct PackBlockLocation* live_locations = 0;
+    void* block_data = 0;
+    for (uint32_t p = 0; p < pack_count && !err; ++p)
+    {
+        arrsetlen(live_hashes, 0);
+        arrsetlen(live_locations, 0);
+        Longtail_LockSpinLock(api->m_Lock);
+        struct FSPack* pack = &api->m_Packs[p];
+        intptr_t pack_block_count = arrlen(pack->m_BlockHashes);
+        for (intptr_t b = 0; b < pack_block_count; ++b)
+        {
+            TLongtail_Hash block_hash = pack->m_BlockHashes[b];
+            if (LongtailPrivate_LookupTable_Get(kept_block_lookup, block_hash))
+            {
+                arrput(live_hashes, block_hash);
+                arrput(live_locations, hmget(api->m_PackBlockLocations, block_hash));
+            }
+        }
+        char* pack_path = GetPackPath(storage_api, api->m_StorePath, pack->m_Name, PACK_FILE_EXTENSION, "");
+        Longtail_UnlockSpinLock(api->m_Lock);
+        if (!pack_path)
+        {
+            err = ENOMEM;
+            break;
+        }
+
+        intptr_t live_count = arrlen(live_hashes);
+        if (live_count == pack_block_count)
+        {
+            Longtail_Free(pack_path);
+            continue;
+        }
+        if (live_count == 0)
+        {
+            Longtail_Free(pack_path);
+            arrput(removed_packs, p);
+            continue;
+        }
+
+        Longtail_StorageAPI_HOpenFile pack_file;
+        err = storage_api->OpenReadFile(storage_api, pack_path, &pack_file);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+            Longtail_Free(pack_path);
+            break;
+        }
+        uint64_t pack_size = 0;
+        err = storage_api->GetSize(storage_api, pack_file, &pack_size);
+        uint64_t live_size = 0;
+        for (intptr_t b = 0; b < live_count; ++b)
+        {
+            live_size += sizeof(struct PackIndexEntry) + live_locations[b].m_Size;
+        }
+        if (!err && (live_size * 100 < pack_size * PACK_REWRITE_LIVE_PERCENT))
+        {
+            for (intptr_t b = 0; b < live_count && !err; ++b)
+            {
+                block_data = Longtail_Alloc("FSBlockStoreAPI", live_locations[b].m_Size);
+                if (!block_data)
+                {
+                    err = ENOMEM;
+                    break;
+                }
+                err = storage_api->Read(storage_api, pack_file, live_locations[b].m_Offset, live_locations[b].m_Size, block_data);
+                if (!err)
+                {
+                    err = AppendToPack(api, live_hashes[b], block_data, live_locations[b].m_Size);
+                }
+                Longtail_Free(block_data);
+                block_data = 0;
+            }
+            if (!err)
+            {
+                arrput(removed_packs, p);
+            }
+        }
+        else if (!err)
+        {
+            Longtail_LockSpinLock(api->m_Lock);
+            pack = &api->m_Packs[p];
+            for (intptr_t b = 0; b < pack_block_count; ++b)
+            {
+                TLongtail_Hash block_hash = pack->m_BlockHashes[b];
+                if (!LongtailPrivate_LookupTable_Get(kept_block_lookup, block_hash))
+                {
+                    hmdel(api->m_PackBlockLocations, block_hash);
+                }
+            }
+            arrsetlen(pack->m_BlockHashes, 0);
+            for (intptr_t b = 0; b < live_count; ++b)
+            {
+                arrput(pack->m_BlockHashes, live_hashes[b]);
+            }
+            pack->m_IsIndexDirty = 1;
+            Longtail_UnlockSpinLock(api->m_Lock);
+        }
+        storage_api->CloseFile(storage_api, pack_file);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to prune pack `%s`, failed with %d", pack_path, err)
+        }
+        Longtail_Free(pack_path);
+    }
+    arrfree(live_locations);
+    arrfree(live_hashes);
+
+    intptr_t removed_pack_count = arrlen(removed_packs);
+    Longtail_LockSpinLock(api->m_Lock);
+    for (intptr_t r = 0; r < removed_pack_count; ++r)
+    {
+        uint32_t p = removed_packs[r];
+        struct FSPack* pack = &api->m_Packs[p];
+        intptr_t pack_block_count = arrlen(pack->m_BlockHashes);
+        for (intptr_t b = 0; b < pack_block_count; ++b)
+        {
+            TLongtail_Hash block_hash = pack->m_BlockHashes[b];
+            intptr_t location_ptr = hmgeti(api->m_PackBlockLocations, block_hash);
+            if (location_ptr != -1 && api->m_PackBlockLocations[location_ptr].value.m_PackIndex == p)
+            {
+                hmdel(api->m_PackBlockLocations, block_hash);
+            }
+        }
+        arrfree(pack->m_BlockHashes);
+        pack->m_IndexFileSize = 0;
+        pack->m_IsIndexDirty = 0;
+    }
+    Longtail_UnlockSpinLock(api->m_Lock);
+
+    // Write the new pack indexes before removing any data they may have been moved from
+    int flush_err = FlushPackIndexes(api);
+    if (flush_err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "FlushPackIndexes() failed with %d", flush_err)
+        err = err ? err : flush_err;
+    }
+    else
+    {
+        for (intptr_t r = 0; r < removed_pack_count; ++r)
+        {
+            Longtail_LockSpinLock(api->m_Lock);
+            const char* pack_name = api->m_Packs[removed_packs[r]].m_Name;
+            char* pack_index_path = GetPackPath(storage_api, api->m_StorePath, pack_name, PACK_INDEX_FILE_EXTENSION, "");
+            char* pack_path = GetPackPath(storage_api, api->m_StorePath, pack_name, PACK_FILE_EXTENSION, "");
+            Longtail_UnlockSpinLock(api->m_Lock);
+            // Remove the pack before its index, a pack without an index would have its blocks recovered
+            if (pack_path && storage_api->IsFile(storage_api, pack_path))
+            {
+                int remove_err = storage_api->RemoveFile(storage_api, pack_path);
+                if (remove_err)
+                {
+                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to remove pack `%s`, error %d", pack_path, remove_err)
+                }
+            }
+            if (pack_index_path && storage_api->IsFile(storage_api, pack_index_path))
+            {
+                int remove_err = storage_api->RemoveFile(storage_api, pack_index_path);
+                if (remove_err)
+                {
+                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to remove pack index `%s`, error %d", pack_index_path, remove_err)
+                }
+            }
+            Longtail_Free(pack_path);
+            Longtail_Free(pack_index_path);
+        }
+    }
+
+    // Drop the removed packs and renumber the packs after them, none of the block locations refer to a removed pack
+    if (removed_pack_count > 0)
+    {
+        Longtail_LockSpinLock(api->m_Lock);
+        uint32_t old_pack_count = (uint32_t)arrlen(api->m_Packs);
+        uint32_t* new_pack_indexes = 0;
+        arrsetlen(new_pack_indexes, old_pack_count);
+        uint32_t new_pack_count = 0;
+        intptr_t r = 0;
+        for (uint32_t p = 0; p < old_pack_count; ++p)
+        {
+            if (r < removed_pack_count && removed_packs[r] == p)
+            {
+                Longtail_Free(api->m_Packs[p].m_Name);
+                new_pack_indexes[p] = NO_ACTIVE_PACK;
+                ++r;
+                continue;
+            }
+            new_pack_indexes[p] = new_pack_count;
+            api->m_Packs[new_pack_count++] = api->m_Packs[p];
+        }
+        arrsetlen(api->m_Packs, new_pack_count);
+        intptr_t location_count = hmlen(api->m_PackBlockLocations);
+        for (intptr_t l = 0; l < location_count; ++l)
+        {
+            struct PackBlockLocation* location = &api->m_PackBlockLocations[l].value;
+            location->m_PackIndex = new_pack_indexes[location->m_PackIndex];
+        }
+        if (api->m_ActivePackIndex != NO_ACTIVE_PACK)
+        {
+            api->m_ActivePackIndex = new_pack_indexes[api->m_ActivePackIndex];
+        }
+        arrfree(new_pack_indexes);
+        Longtail_UnlockSpinLock(api->m_Lock);
+    }
+    arrfree(removed_packs);
+    Longtail_PostSema(api->m_PackLock, 1);
+    return err;
+}
+
 static int FSBlockStore_PruneBlocks(
     struct Longtail_BlockStoreAPI* block_store_api,
     uint32_t block_keep_count,
@@ -1248,6 +3029,12 @@ static int FSBlockStore_PruneBlocks(
             {
                 continue;
             }
+            hmdel(api->m_BlockState, block_hash);
+            if (hmgeti(api->m_PackBlockLocations, block_hash) != -1)
+            {
+                // Removed from its pack by PrunePacks
+                continue;
+            }
             char* block_path = GetBlockPath(api->m_StorageAPI, api->m_StorePath, api->m_BlockExtension, block_hash);
 
             // Check if block exists, if it does it is just the store store index that is out of sync.
@@ -1263,14 +3050,28 @@ static int FSBlockStore_PruneBlocks(
                 LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "FSBlockStore_PruneBlocks() failed to remove file `%s`, error %d", block_path, err);
             }
             Longtail_Free((void*)block_path);
-            hmdel(api->m_BlockState, block_hash);
+        }
+        Longtail_UnlockSpinLock(api->m_Lock);
+
+        err = PrunePacks(api, kept_block_lookup);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "PrunePacks() failed with %d", err)
+            Longtail_Free(kept_block_lookup_mem);
+            api->m_StorageAPI->UnlockFile(api->m_StorageAPI, store_index_lock_file);
+            Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PruneBlocks_FailCount], 1);
+            Longtail_Free(store_index);
+            return err;
         }
         Longtail_Free(kept_block_lookup_mem);
     }
+    else
+    {
+        Longtail_UnlockSpinLock(api->m_Lock);
+    }
 
     api->m_StorageAPI->UnlockFile(api->m_StorageAPI, store_index_lock_file);
     Longtail_Free(store_index);
-    Longtail_UnlockSpinLock(api->m_Lock);
 
     Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_PruneBlocks_Count], 1);
 
@@ -1308,10 +3109,19 @@ static int FSBlockStore_Flush(struct Longtail_BlockStoreAPI* block_store_api, st
     struct FSBlockStoreAPI* api = (struct FSBlockStoreAPI*)block_store_api;
     Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_Flush_Count], 1);
 
+    // Hold the pack lock so any block in the store index we write has its pack index written.
+    // The active pack is closed so other instances can read the blocks its pack index makes visible to them
+    Longtail_WaitSema(api->m_PackLock, LONGTAIL_TIMEOUT_INFINITE);
+    CloseActivePackFile(api);
+    int err = FlushPackIndexes(api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "FlushPackIndexes() failed with %d", err)
+    }
+
     Longtail_LockSpinLock(api->m_Lock);
     intptr_t new_block_count = arrlen(api->m_AddedBlockIndexes);
-    int err = 0;
-    if (new_block_count > 0)
+    if ((err == 0) && (new_block_count > 0))
     {
         err = FSBlockStore_UpdateStoreIndex(api);
         if (err)
@@ -1349,6 +3159,7 @@ static int FSBlockStore_Flush(struct Longtail_BlockStoreAPI* block_store_api, st
     }
 
     Longtail_UnlockSpinLock(api->m_Lock);
+    Longtail_PostSema(api->m_PackLock, 1);
 
     if (err)
     {
@@ -1381,6 +3192,16 @@ static void FSBlockStore_Dispose(struct Longtail_API* api)
 
     hmfree(fsblockstore_api->m_BlockState);
     fsblockstore_api->m_BlockState = 0;
+    for (intptr_t p = 0; p < arrlen(fsblockstore_api->m_Packs); ++p)
+    {
+        Longtail_Free(fsblockstore_api->m_Packs[p].m_Name);
+        arrfree(fsblockstore_api->m_Packs[p].m_BlockHashes);
+    }
+    arrfree(fsblockstore_api->m_Packs);
+    hmfree(fsblockstore_api->m_PackBlockLocations);
+    Longtail_DisposeDirectoryCache(fsblockstore_api->m_DirectoryCache);
+    Longtail_DeleteSema(fsblockstore_api->m_PackLock);
+    Longtail_Free(fsblockstore_api->m_PackLock);
     Longtail_DeleteSpinLock(fsblockstore_api->m_Lock);
     Longtail_Free(fsblockstore_api->m_Lock);
     Longtail_Free((void*)fsblockstore_api->m_StoreIndexLockPath);
@@ -1397,6 +3218,7 @@ static int FSBlockStore_Init(
     const char* block_extension,
     uint64_t unique_id,
     int enable_file_mapping,
+    uint64_t max_pack_size,
     struct Longtail_BlockStoreAPI** out_block_store_api)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
@@ -1406,6 +3228,8 @@ static int FSBlockStore_Init(
         LONGTAIL_LOGFIELD(content_path, "%s"),
         LONGTAIL_LOGFIELD(block_extension, "%p"),
         LONGTAIL_LOGFIELD(unique_id, "%" PRIu64),
+        LONGTAIL_LOGFIELD(enable_file_mapping, "%d"),
+        LONGTAIL_LOGFIELD(max_pack_size, "%" PRIu64),
         LONGTAIL_LOGFIELD(out_block_store_api, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
@@ -1445,6 +3269,15 @@ static int FSBlockStore_Init(
     GetUniqueExtension(unique_id, api->m_TmpExtension);
     api->m_StoreIndexIsDirty = 0;
     api->m_EnableFileMapping = enable_file_mapping;
+    api->m_Packs = 0;
+    api->m_PackBlockLocations = 0;
+    api->m_PackIndexesLoaded = 0;
+    api->m_PackLock = 0;
+    api->m_MaxPackSize = max_pack_size;
+    api->m_ActivePackIndex = NO_ACTIVE_PACK;
+    api->m_ActivePackSize = 0;
+    api->m_ActivePackFile = 0;
+    api->m_NextPackSequence = 0;
 
     for (uint32_t s = 0; s < Longtail_BlockStoreAPI_StatU64_Count; ++s)
     {
@@ -1461,22 +3294,49 @@ static int FSBlockStore_Init(
         api->m_StoreIndex = 0;
         return err;
     }
+    err = Longtail_CreateSema(Longtail_Alloc("FSBlockStoreAPI", Longtail_GetSemaSize()), 1, &api->m_PackLock);
+    if (err)
+    {
+        Longtail_DeleteSpinLock(api->m_Lock);
+        Longtail_Free(api->m_Lock);
+        hmfree(api->m_BlockState);
+        api->m_BlockState = 0;
+        Longtail_Free(api->m_StoreIndex);
+        api->m_StoreIndex = 0;
+        return err;
+    }
+    api->m_DirectoryCache = Longtail_CreateDirectoryCache();
+    if (api->m_DirectoryCache == 0)
+    {
+        Longtail_DeleteSema(api->m_PackLock);
+        Longtail_Free(api->m_PackLock);
+        Longtail_DeleteSpinLock(api->m_Lock);
+        Longtail_Free(api->m_Lock);
+        hmfree(api->m_BlockState);
+        api->m_BlockState = 0;
+        Longtail_Free(api->m_StoreIndex);
+        api->m_StoreIndex = 0;
+        return ENOMEM;
+    }
     *out_block_store_api = block_store_api;
     return 0;
 }
 
-struct Longtail_BlockStoreAPI* Longtail_CreateFSBlockStoreAPI(
+struct Longtail_BlockStoreAPI* Longtail_CreateFSBlockStoreAPI2(
     struct Longtail_JobAPI* job_api,
     struct Longtail_StorageAPI* storage_api,
     const char* content_path,
     const char* optional_extension,
-    int enable_file_mapping)
+    int enable_file_mapping,
+    uint64_t max_pack_size)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(job_api, "%p"),
         LONGTAIL_LOGFIELD(storage_api, "%p"),
         LONGTAIL_LOGFIELD(content_path, "%s"),
-        LONGTAIL_LOGFIELD(optional_extension, "%p")
+        LONGTAIL_LOGFIELD(optional_extension, "%p"),
+        LONGTAIL_LOGFIELD(enable_file_mapping, "%d"),
+        LONGTAIL_LOGFIELD(max_pack_size, "%" PRIu64)
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
     LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return 0)
@@ -1504,6 +3364,7 @@ struct Longtail_BlockStoreAPI* Longtail_CreateFSBlockStoreAPI(
         block_extension,
         unique_id,
         enable_file_mapping,
+        max_pack_size,
         &block_store_api);
     if (err)
     {
@@ -1513,3 +3374,13 @@ struct Longtail_BlockStoreAPI* Longtail_CreateFSBlockStoreAPI(
     }
     return block_store_api;
 }
+
+struct Longtail_BlockStoreAPI* Longtail_CreateFSBlockStoreAPI(
+    struct Longtail_JobAPI* job_api,
+    struct Longtail_StorageAPI* storage_api,
+    const char* content_path,
+    const char* optional_extension,
+    int enable_file_mapping)
+{
+    return Longtail_CreateFSBlockStoreAPI2(job_api, storage_api, content_path, optional_extension, enable_file_mapping, 0);
+}
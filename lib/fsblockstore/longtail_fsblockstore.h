@@ -13,6 +13,32 @@ LONGTAIL_EXPORT extern struct Longtail_BlockStoreAPI* Longtail_CreateFSBlockStor
     const char* optional_extension,
     int enable_file_mapping);
 
+/*! @brief Creates a file system block store that can store blocks in pack files.
+ *
+ * Same as Longtail_CreateFSBlockStoreAPI() but if @p max_pack_size is non-zero new blocks are appended to
+ * pack files in the `packs` folder of @p content_path instead of being written as one file per block.
+ * A pack is closed for writing when adding a block would make it larger than @p max_pack_size.
+ * Blocks in pack files written by other block store instances are always readable, regardless of @p max_pack_size.
+ * Blocks appended to a pack after its pack index was last written, for example by a process that crashed, are
+ * recovered from the pack itself.
+ * PruneBlocks removes empty packs and moves the remaining blocks out of packs that are mostly pruned.
+ *
+ * @param[in] job_api               The job API used when scanning the store
+ * @param[in] storage_api           The storage API to store blocks in
+ * @param[in] content_path          The root path of the store
+ * @param[in] optional_extension    The block file extension, or null for the default `.lrb`
+ * @param[in] enable_file_mapping   Map block files instead of reading them when the storage API supports it
+ * @param[in] max_pack_size         The maximum size of a pack file, zero writes one file per block
+ * @return                          The block store API, or null on failure
+ */
+LONGTAIL_EXPORT extern struct Longtail_BlockStoreAPI* Longtail_CreateFSBlockStoreAPI2(
+    struct Longtail_JobAPI* job_api,
+    struct Longtail_StorageAPI* storage_api,
+    const char* content_path,
+    const char* optional_extension,
+    int enable_file_mapping,
+    uint64_t max_pack_size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -5,29 +5,34 @@
 #include "../blake2/longtail_blake2.h"
 #include "../blake3/longtail_blake3.h"
 #include "../meowhash/longtail_meowhash.h"
+#include "../xxh3/longtail_xxh3.h"
 
  struct Longtail_HashRegistryAPI* Longtail_CreateFullHashRegistry()
  {
      struct Longtail_HashAPI* blake2_hash = Longtail_CreateBlake2HashAPI();
      struct Longtail_HashAPI* blake3_hash = Longtail_CreateBlake3HashAPI();
      struct Longtail_HashAPI* meow_hash = Longtail_CreateMeowHashAPI();
+     struct Longtail_HashAPI* xxh3_hash = Longtail_CreateXXH3HashAPI();
 
-     uint32_t hash_types[3] = {
+     uint32_t hash_types[4] = {
          Longtail_GetBlake2HashType(),
          Longtail_GetBlake3HashType(),
-         Longtail_GetMeowHashType()};
+         Longtail_GetMeowHashType(),
+         Longtail_GetXXH3HashType()};
 
-    struct Longtail_HashAPI* hash_apis[3] = {
+    struct Longtail_HashAPI* hash_apis[4] = {
         blake2_hash,
         blake3_hash,
-        meow_hash};
+        meow_hash,
+        xxh3_hash};
 
     struct Longtail_HashRegistryAPI* registry = Longtail_CreateDefaultHashRegistry(
-        3,
+        4,
         (const uint32_t*)hash_types,
         (const struct Longtail_HashAPI**)hash_apis);
     if (!registry)
     {
+         SAFE_DISPOSE_API(xxh3_hash);
          SAFE_DISPOSE_API(meow_hash);
          SAFE_DISPOSE_API(blake3_hash);
          SAFE_DISPOSE_API(blake2_hash);
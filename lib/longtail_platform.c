@@ -181,6 +181,15 @@ void Longtail_Sleep(uint64_t timeout_us)
     Sleep(wait_ms);
 }
 
+uint64_t Longtail_GetTimeUs()
+{
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((counter.QuadPart / frequency.QuadPart) * 1000000 + ((counter.QuadPart % frequency.QuadPart) * 1000000) / frequency.QuadPart);
+}
+
 int32_t Longtail_AtomicAdd32(TLongtail_Atomic32* value, int32_t amount)
 {
     return (int32_t)InterlockedAdd((LONG volatile*)value, (LONG)amount);
@@ -1104,6 +1113,55 @@ int Longtail_GetFilePermissions(const char* path, uint16_t* out_permissions)
     return 0;
 }
 
+int Longtail_GetFileStat(const char* path, uint64_t* out_size, uint64_t* out_modification_time, uint64_t* out_change_time, uint64_t* out_file_id)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(out_size, "%p"),
+        LONGTAIL_LOGFIELD(out_modification_time, "%p"),
+        LONGTAIL_LOGFIELD(out_change_time, "%p"),
+        LONGTAIL_LOGFIELD(out_file_id, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    wchar_t long_path_buffer[512];
+    wchar_t* long_path = MakeLongPlatformPath(path, long_path_buffer, sizeof(long_path_buffer));
+    HANDLE handle = CreateFileW(long_path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (long_path != long_path_buffer)
+    {
+        Longtail_Free(long_path);
+    }
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        int e = Win32ErrorToErrno(GetLastError());
+        if (e == ENOENT)
+        {
+            return e;
+        }
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Can't open `%s`: %d\n", path, e);
+        return e;
+    }
+    BY_HANDLE_FILE_INFORMATION info;
+    FILE_BASIC_INFO basic_info;
+    BOOL ok = GetFileInformationByHandle(handle, &info) &&
+        GetFileInformationByHandleEx(handle, FileBasicInfo, &basic_info, sizeof(basic_info));
+    CloseHandle(handle);
+    if (!ok)
+    {
+        int e = Win32ErrorToErrno(GetLastError());
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Can't get file information of `%s`: %d\n", path, e);
+        return e;
+    }
+    *out_size = (((uint64_t)info.nFileSizeHigh) << 32) + info.nFileSizeLow;
+    *out_modification_time = (((uint64_t)info.ftLastWriteTime.dwHighDateTime) << 32) + info.ftLastWriteTime.dwLowDateTime;
+    *out_change_time = (uint64_t)basic_info.ChangeTime.QuadPart;
+    *out_file_id = (((uint64_t)info.nFileIndexHigh) << 32) + info.nFileIndexLow;
+    return 0;
+}
+
 int Longtail_Read(HLongtail_OpenFile handle, uint64_t offset, uint64_t length, void* output)
 {
     HANDLE h = (HANDLE)(handle);
@@ -1158,6 +1216,21 @@ int Longtail_Write(HLongtail_OpenFile handle, uint64_t offset, uint64_t length,
     return 0;
 }
 
+int Longtail_WriteV(HLongtail_OpenFile handle, uint64_t offset, uint32_t vec_count, const struct Longtail_StorageAPI_IOVec* vecs)
+{
+    // WriteFileGather requires unbuffered, page aligned I/O so we issue one overlapped write per buffer
+    for (uint32_t v = 0; v < vec_count; ++v)
+    {
+        int err = Longtail_Write(handle, offset, vecs[v].m_Length, vecs[v].m_Data);
+        if (err)
+        {
+            return err;
+        }
+        offset += vecs[v].m_Length;
+    }
+    return 0;
+}
+
 int Longtail_GetFileSize(HLongtail_OpenFile handle, uint64_t* out_size)
 {
     HANDLE h = (HANDLE)(handle);
@@ -1422,6 +1495,7 @@ void Longtail_UnmapFile(HLongtail_FileMap file_map)
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/file.h>
+#include <sys/uio.h>
 #include <pthread.h>
 #include <pwd.h>
 
@@ -1435,6 +1509,13 @@ void Longtail_Sleep(uint64_t timeout_us)
     usleep((useconds_t)timeout_us);
 }
 
+uint64_t Longtail_GetTimeUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
 int32_t Longtail_AtomicAdd32(TLongtail_Atomic32* value, int32_t amount)
 {
     return __sync_fetch_and_add(value, amount) + amount;
@@ -2255,6 +2336,26 @@ int Longtail_GetFilePermissions(const char* path, uint16_t* out_permissions)
     return res;
 }
 
+int Longtail_GetFileStat(const char* path, uint64_t* out_size, uint64_t* out_modification_time, uint64_t* out_change_time, uint64_t* out_file_id)
+{
+    struct stat stat_buf;
+    int res = stat(path, &stat_buf);
+    if (res != 0)
+    {
+        return errno;
+    }
+    *out_size = (uint64_t)stat_buf.st_size;
+#if defined(__APPLE__)
+    *out_modification_time = ((uint64_t)stat_buf.st_mtimespec.tv_sec) * 1000000000u + (uint64_t)stat_buf.st_mtimespec.tv_nsec;
+    *out_change_time = ((uint64_t)stat_buf.st_ctimespec.tv_sec) * 1000000000u + (uint64_t)stat_buf.st_ctimespec.tv_nsec;
+#else
+    *out_modification_time = ((uint64_t)stat_buf.st_mtim.tv_sec) * 1000000000u + (uint64_t)stat_buf.st_mtim.tv_nsec;
+    *out_change_time = ((uint64_t)stat_buf.st_ctim.tv_sec) * 1000000000u + (uint64_t)stat_buf.st_ctim.tv_nsec;
+#endif
+    *out_file_id = (uint64_t)stat_buf.st_ino;
+    return 0;
+}
+
 int Longtail_Read(HLongtail_OpenFile handle, uint64_t offset, uint64_t length, void* output)
 {
     FILE* f = (FILE*)handle;
@@ -2296,6 +2397,66 @@ int Longtail_Write(HLongtail_OpenFile handle, uint64_t offset, uint64_t length,
     return 0;
 }
 
+#define LONGTAIL_WRITEV_MAX_IOVEC 64
+
+int Longtail_WriteV(HLongtail_OpenFile handle, uint64_t offset, uint32_t vec_count, const struct Longtail_StorageAPI_IOVec* vecs)
+{
+    FILE* f = (FILE*)handle;
+
+    int fd = fileno(f);
+    struct iovec iov[LONGTAIL_WRITEV_MAX_IOVEC];
+    uint32_t v = 0;
+    uint64_t v_offset = 0;
+    while (v < vec_count)
+    {
+        int iov_count = 0;
+        uint64_t batch_size = 0;
+        uint32_t i = v;
+        uint64_t i_offset = v_offset;
+        while (i < vec_count && iov_count < LONGTAIL_WRITEV_MAX_IOVEC && batch_size < MaxChunkSize)
+        {
+            uint64_t length = vecs[i].m_Length - i_offset;
+            if (length > MaxChunkSize - batch_size)
+            {
+                length = MaxChunkSize - batch_size;
+            }
+            if (length > 0)
+            {
+                iov[iov_count].iov_base = (void*)&((const char*)vecs[i].m_Data)[i_offset];
+                iov[iov_count].iov_len = (size_t)length;
+                ++iov_count;
+                batch_size += length;
+            }
+            ++i;
+            i_offset = 0;
+        }
+        if (iov_count == 0)
+        {
+            break;
+        }
+        ssize_t length_written = pwritev(fd, iov, iov_count, (off_t)offset);
+        if (length_written == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return errno;
+        }
+        offset += (uint64_t)length_written;
+        // Advance past the written bytes, a short write resumes in the middle of a buffer
+        uint64_t left = (uint64_t)length_written;
+        while (v < vec_count && left >= vecs[v].m_Length - v_offset)
+        {
+            left -= vecs[v].m_Length - v_offset;
+            ++v;
+            v_offset = 0;
+        }
+        v_offset += left;
+    }
+    return 0;
+}
+
 int Longtail_GetFileSize(HLongtail_OpenFile handle, uint64_t* out_size)
 {
     FILE* f = (FILE*)handle;
@@ -11,6 +11,7 @@ static const uint64_t LONGTAIL_TIMEOUT_INFINITE = ((uint64_t)-1);
 
 uint32_t    Longtail_GetCPUCount();
 void        Longtail_Sleep(uint64_t timeout_us);
+uint64_t    Longtail_GetTimeUs();
 
 typedef int32_t volatile TLongtail_Atomic32;
 int32_t Longtail_AtomicAdd32(TLongtail_Atomic32* value, int32_t amount);
@@ -63,6 +64,7 @@ const char* Longtail_GetDirectoryName(HLongtail_FSIterator fs_iterator);
 int         Longtail_GetEntryProperties(HLongtail_FSIterator fs_iterator, uint64_t* out_size, uint16_t* out_permissions, int* out_is_dir);
 
 typedef struct Longtail_OpenFile_private* HLongtail_OpenFile;
+struct Longtail_StorageAPI_IOVec;
 
 int     Longtail_OpenReadFile(const char* path, HLongtail_OpenFile* out_read_file);
 int     Longtail_OpenWriteFile(const char* path, uint64_t initial_size, HLongtail_OpenFile* out_write_file);
@@ -70,8 +72,10 @@ int     Longtail_OpenAppendFile(const char* path, HLongtail_OpenFile* out_write_
 int     Longtail_SetFileSize(HLongtail_OpenFile handle, uint64_t length);
 int     Longtail_SetFilePermissions(const char* path, uint16_t permissions);
 int     Longtail_GetFilePermissions(const char* path, uint16_t* out_permissions);
+int     Longtail_GetFileStat(const char* path, uint64_t* out_size, uint64_t* out_modification_time, uint64_t* out_change_time, uint64_t* out_file_id);
 int     Longtail_Read(HLongtail_OpenFile handle, uint64_t offset, uint64_t length, void* output);
 int     Longtail_Write(HLongtail_OpenFile handle, uint64_t offset, uint64_t length, const void* input);
+int     Longtail_WriteV(HLongtail_OpenFile handle, uint64_t offset, uint32_t vec_count, const struct Longtail_StorageAPI_IOVec* vecs);
 int     Longtail_GetFileSize(HLongtail_OpenFile handle, uint64_t* out_size);
 void    Longtail_CloseFile(HLongtail_OpenFile handle);
 char*   Longtail_ConcatPath(const char* folder, const char* file);
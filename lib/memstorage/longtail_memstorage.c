@@ -68,6 +68,8 @@ struct PathEntry
     uint32_t m_ParentHash;
     uint8_t* m_Content;
     uint16_t m_Permissions;
+    uint64_t m_ModificationTime;
+    uint64_t m_ChangeTime;
     uint8_t m_IsOpenWrite;
     uint32_t m_IsOpenRead;
 };
@@ -83,6 +85,7 @@ struct InMemStorageAPI
     struct Longtail_StorageAPI m_InMemStorageAPI;
     struct Lookup* m_PathHashToContent;
     struct PathEntry* m_PathEntries;
+    uint64_t m_ModificationCount;
     HLongtail_SpinLock m_SpinLock;
 };
 
@@ -319,12 +322,16 @@ static int InMemStorageAPI_OpenWriteFile(struct Longtail_StorageAPI* storage_api
         path_entry->m_FileName = Longtail_Strdup(InMemStorageAPI_GetFileNamePart(path));
         path_entry->m_Content = 0;
         path_entry->m_Permissions = 0644;
+        path_entry->m_ModificationTime = ++instance->m_ModificationCount;
+        path_entry->m_ChangeTime = path_entry->m_ModificationTime;
         path_entry->m_IsOpenRead = 0;
         path_entry->m_IsOpenWrite = 1;
         hmput(instance->m_PathHashToContent, path_hash, (uint32_t)entry_index);
     }
     arrsetcap(path_entry->m_Content, initial_size == 0 ? 16 : (uint32_t)initial_size);
     arrsetlen(path_entry->m_Content, (uint32_t)initial_size);
+    path_entry->m_ModificationTime = ++instance->m_ModificationCount;
+    path_entry->m_ChangeTime = path_entry->m_ModificationTime;
     Longtail_UnlockSpinLock(instance->m_SpinLock);
     *out_open_file = (Longtail_StorageAPI_HOpenFile)(uintptr_t)path_hash;
     return 0;
@@ -390,6 +397,8 @@ static int InMemStorageAPI_OpenAppendFile(struct Longtail_StorageAPI* storage_ap
         path_entry->m_FileName = Longtail_Strdup(InMemStorageAPI_GetFileNamePart(path));
         path_entry->m_Content = 0;
         path_entry->m_Permissions = 0644;
+        path_entry->m_ModificationTime = ++instance->m_ModificationCount;
+        path_entry->m_ChangeTime = path_entry->m_ModificationTime;
         path_entry->m_IsOpenRead = 0;
         path_entry->m_IsOpenWrite = 1;
         arrsetcap(path_entry->m_Content, 16);
@@ -436,6 +445,59 @@ static int InMemStorageAPI_Write(struct Longtail_StorageAPI* storage_api, Longta
     arrsetcap(path_entry->m_Content, size == 0 ? 16 : (uint32_t)size);
     arrsetlen(path_entry->m_Content, (uint32_t)size);
     memcpy(&(path_entry->m_Content)[offset], input, length);
+    path_entry->m_ModificationTime = ++instance->m_ModificationCount;
+    path_entry->m_ChangeTime = path_entry->m_ModificationTime;
+    Longtail_UnlockSpinLock(instance->m_SpinLock);
+    return 0;
+}
+
+static int InMemStorageAPI_WriteV(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HOpenFile f, uint64_t offset, uint32_t vec_count, const struct Longtail_StorageAPI_IOVec* vecs)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(f, "%p"),
+        LONGTAIL_LOGFIELD(offset, "%" PRIu64),
+        LONGTAIL_LOGFIELD(vec_count, "%u"),
+        LONGTAIL_LOGFIELD(vecs, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, f != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, vec_count == 0 || vecs != 0, return EINVAL);
+    uint64_t length = 0;
+    for (uint32_t v = 0; v < vec_count; ++v)
+    {
+        length += vecs[v].m_Length;
+    }
+    struct InMemStorageAPI* instance = (struct InMemStorageAPI*)storage_api;
+    Longtail_LockSpinLock(instance->m_SpinLock);
+    uint32_t path_hash = (uint32_t)(uintptr_t)f;
+    intptr_t it = hmgeti(instance->m_PathHashToContent, path_hash);
+    if (it == -1)
+    {
+        Longtail_UnlockSpinLock(instance->m_SpinLock);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "File not found, failed with %d", EINVAL)
+        return EINVAL;
+    }
+    struct PathEntry* path_entry = &instance->m_PathEntries[instance->m_PathHashToContent[it].value];
+    ptrdiff_t size = arrlen(path_entry->m_Content);
+    if ((ptrdiff_t)(offset + length) > size)
+    {
+        size = offset + length;
+    }
+    arrsetcap(path_entry->m_Content, size == 0 ? 16 : (uint32_t)size);
+    arrsetlen(path_entry->m_Content, (uint32_t)size);
+    for (uint32_t v = 0; v < vec_count; ++v)
+    {
+        memcpy(&(path_entry->m_Content)[offset], vecs[v].m_Data, vecs[v].m_Length);
+        offset += vecs[v].m_Length;
+    }
+    path_entry->m_ModificationTime = ++instance->m_ModificationCount;
+    path_entry->m_ChangeTime = path_entry->m_ModificationTime;
     Longtail_UnlockSpinLock(instance->m_SpinLock);
     return 0;
 }
@@ -466,6 +528,8 @@ static int InMemStorageAPI_SetSize(struct Longtail_StorageAPI* storage_api, Long
     }
     struct PathEntry* path_entry = &instance->m_PathEntries[instance->m_PathHashToContent[it].value];
     arrsetlen(path_entry->m_Content, (uint32_t)length);
+    path_entry->m_ModificationTime = ++instance->m_ModificationCount;
+    path_entry->m_ChangeTime = path_entry->m_ModificationTime;
     Longtail_UnlockSpinLock(instance->m_SpinLock);
     return 0;
 }
@@ -496,6 +560,7 @@ static int InMemStorageAPI_SetPermissions(struct Longtail_StorageAPI* storage_ap
     }
     struct PathEntry* path_entry = &instance->m_PathEntries[instance->m_PathHashToContent[it].value];
     path_entry->m_Permissions = permissions;
+    path_entry->m_ChangeTime = ++instance->m_ModificationCount;
     Longtail_UnlockSpinLock(instance->m_SpinLock);
     return 0;
 }
@@ -530,6 +595,48 @@ static int InMemStorageAPI_GetPermissions(struct Longtail_StorageAPI* storage_ap
     return 0;
 }
 
+static int InMemStorageAPI_GetFileStat(struct Longtail_StorageAPI* storage_api, const char* path, uint64_t* out_size, uint64_t* out_modification_time, uint64_t* out_change_time, uint64_t* out_file_id)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(out_size, "%p"),
+        LONGTAIL_LOGFIELD(out_modification_time, "%p"),
+        LONGTAIL_LOGFIELD(out_change_time, "%p"),
+        LONGTAIL_LOGFIELD(out_file_id, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, out_size != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, out_modification_time != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, out_change_time != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, out_file_id != 0, return EINVAL);
+    struct InMemStorageAPI* instance = (struct InMemStorageAPI*)storage_api;
+    uint32_t path_hash = InMemStorageAPI_GetPathHash(path);
+    Longtail_LockSpinLock(instance->m_SpinLock);
+    intptr_t it = hmgeti(instance->m_PathHashToContent, path_hash);
+    if (it == -1)
+    {
+        Longtail_UnlockSpinLock(instance->m_SpinLock);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "File not found, failed with %d", ENOENT)
+        return ENOENT;
+    }
+    // Path entries are never reused so the entry index identifies the file, also after it is renamed
+    uint32_t entry_index = instance->m_PathHashToContent[it].value;
+    struct PathEntry* path_entry = &instance->m_PathEntries[entry_index];
+    *out_size = (uint64_t)arrlen(path_entry->m_Content);
+    *out_modification_time = path_entry->m_ModificationTime;
+    *out_change_time = path_entry->m_ChangeTime;
+    *out_file_id = ((uint64_t)entry_index) + 1;
+    Longtail_UnlockSpinLock(instance->m_SpinLock);
+    return 0;
+}
+
 static void InMemStorageAPI_CloseFile(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HOpenFile f)
 {
 #if defined(LONGTAIL_ASSERTS)
@@ -641,6 +748,8 @@ static int InMemStorageAPI_CreateDir(struct Longtail_StorageAPI* storage_api, co
     path_entry->m_FileName = Longtail_Strdup(InMemStorageAPI_GetFileNamePart(path));
     path_entry->m_Content = 0;
     path_entry->m_Permissions = 0775;
+    path_entry->m_ModificationTime = ++instance->m_ModificationCount;
+    path_entry->m_ChangeTime = path_entry->m_ModificationTime;
     path_entry->m_IsOpenRead = 0;
     path_entry->m_IsOpenWrite = 0;
     hmput(instance->m_PathHashToContent, path_hash, (uint32_t)entry_index);
@@ -687,6 +796,7 @@ static int InMemStorageAPI_RenameFile(struct Longtail_StorageAPI* storage_api, c
     source_entry->m_ParentHash = target_parent_path_hash;
     Longtail_Free(source_entry->m_FileName);
     source_entry->m_FileName = Longtail_Strdup(InMemStorageAPI_GetFileNamePart(target_path));
+    source_entry->m_ChangeTime = ++instance->m_ModificationCount;
     hmput(instance->m_PathHashToContent, target_path_hash, instance->m_PathHashToContent[source_path_ptr].value);
     hmdel(instance->m_PathHashToContent, source_path_hash);
     Longtail_UnlockSpinLock(instance->m_SpinLock);
@@ -1083,6 +1193,8 @@ static int InMemStorageAPI_LockFile(struct Longtail_StorageAPI* storage_api, con
     path_entry->m_FileName = Longtail_Strdup(InMemStorageAPI_GetFileNamePart(path));
     path_entry->m_Content = 0;
     path_entry->m_Permissions = 0644;
+    path_entry->m_ModificationTime = ++instance->m_ModificationCount;
+    path_entry->m_ChangeTime = path_entry->m_ModificationTime;
     path_entry->m_IsOpenRead = 0;
     path_entry->m_IsOpenWrite = 2;
     hmput(instance->m_PathHashToContent, path_hash, (uint32_t)entry_index);
@@ -1275,12 +1387,15 @@ static int InMemStorageAPI_Init(
         InMemStorageAPI_GetParentPath,
         InMemStorageAPI_MapFile,
         InMemStorageAPI_UnmapFile,
-        InMemStorageAPI_OpenAppendFile);
+        InMemStorageAPI_OpenAppendFile,
+        InMemStorageAPI_WriteV,
+        InMemStorageAPI_GetFileStat);
 
     struct InMemStorageAPI* storage_api = (struct InMemStorageAPI*)api;
 
     storage_api->m_PathHashToContent = 0;
     storage_api->m_PathEntries = 0;
+    storage_api->m_ModificationCount = 0;
     int err = Longtail_CreateSpinLock(&storage_api[1], &storage_api->m_SpinLock);
     if (err)
     {
@@ -0,0 +1,688 @@
+#include "longtail_readaheadstorage.h"
+
+#include "../longtail_platform.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+
+#define READAHEADSTORAGE_READ_ALIGNMENT 4096u
+
+struct ReadAheadStorageAPI
+{
+    struct Longtail_StorageAPI m_API;
+    struct Longtail_StorageAPI* m_BackingStorage;
+    uint32_t m_BufferSize;
+    uint32_t m_BufferCount;
+};
+
+struct ReadAheadStorageAPI_Buffer
+{
+    uint64_t m_Offset;
+    uint64_t m_Size;
+    int m_Err;
+    uint8_t* m_Data;
+};
+
+struct ReadAheadStorageAPI_OpenFile
+{
+    struct ReadAheadStorageAPI* m_ReadAheadStorage;
+    Longtail_StorageAPI_HOpenFile m_BackingFile;
+    int m_IsReadFile;
+    uint64_t m_Size;
+    uint64_t m_NextReadOffset;
+
+    // Allocated on the first sequential read, the thread and the semaphores only live while a read ahead is active
+    void* m_ReadAheadMem;
+    struct ReadAheadStorageAPI_Buffer* m_Buffers;
+    HLongtail_Thread m_Thread;
+    HLongtail_Sema m_FilledSema;
+    HLongtail_Sema m_FreeSema;
+    TLongtail_Atomic32 m_Stop;
+    int m_IsReadingAhead;
+    uint64_t m_ReadAheadOffset;
+    uint32_t m_ConsumeIndex;
+    int m_ConsumeBufferFilled;
+};
+
+static int ReadAheadStorageAPI_PrefetchThread(void* context_data)
+{
+    struct ReadAheadStorageAPI_OpenFile* read_ahead_file = (struct ReadAheadStorageAPI_OpenFile*)context_data;
+    struct ReadAheadStorageAPI* api = read_ahead_file->m_ReadAheadStorage;
+    struct Longtail_StorageAPI* backing_storage = api->m_BackingStorage;
+    uint32_t buffer_count = api->m_BufferCount;
+    uint64_t buffer_size = api->m_BufferSize;
+
+    for (uint64_t i = 0; ; ++i)
+    {
+        Longtail_WaitSema(read_ahead_file->m_FreeSema, LONGTAIL_TIMEOUT_INFINITE);
+        if (read_ahead_file->m_Stop)
+        {
+            break;
+        }
+        struct ReadAheadStorageAPI_Buffer* buffer = &read_ahead_file->m_Buffers[i % buffer_count];
+        buffer->m_Offset = read_ahead_file->m_ReadAheadOffset + i * buffer_size;
+        buffer->m_Size = 0;
+        buffer->m_Err = 0;
+        if (buffer->m_Offset >= read_ahead_file->m_Size)
+        {
+            Longtail_PostSema(read_ahead_file->m_FilledSema, 1);
+            break;
+        }
+        uint64_t left = read_ahead_file->m_Size - buffer->m_Offset;
+        buffer->m_Size = left < buffer_size ? left : buffer_size;
+        buffer->m_Err = backing_storage->Read(backing_storage, read_ahead_file->m_BackingFile, buffer->m_Offset, buffer->m_Size, buffer->m_Data);
+        Longtail_PostSema(read_ahead_file->m_FilledSema, 1);
+        if (buffer->m_Err)
+        {
+            break;
+        }
+    }
+    return 0;
+}
+
+static int ReadAheadStorageAPI_StartReadAhead(struct ReadAheadStorageAPI_OpenFile* read_ahead_file, uint64_t offset)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(read_ahead_file, "%p"),
+        LONGTAIL_LOGFIELD(offset, "%" PRIu64)
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    struct ReadAheadStorageAPI* api = read_ahead_file->m_ReadAheadStorage;
+    uint32_t buffer_count = api->m_BufferCount;
+    if (read_ahead_file->m_ReadAheadMem == 0)
+    {
+        size_t mem_size =
+            Longtail_GetThreadSize() +
+            Longtail_GetSemaSize() * 2 +
+            sizeof(struct ReadAheadStorageAPI_Buffer) * buffer_count +
+            (size_t)api->m_BufferSize * buffer_count;
+        void* mem = Longtail_Alloc("ReadAheadStorageAPI", mem_size);
+        if (!mem)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+            return ENOMEM;
+        }
+        read_ahead_file->m_ReadAheadMem = mem;
+        uint8_t* p = (uint8_t*)mem + Longtail_GetThreadSize() + Longtail_GetSemaSize() * 2;
+        read_ahead_file->m_Buffers = (struct ReadAheadStorageAPI_Buffer*)p;
+        p += sizeof(struct ReadAheadStorageAPI_Buffer) * buffer_count;
+        for (uint32_t b = 0; b < buffer_count; ++b)
+        {
+            read_ahead_file->m_Buffers[b].m_Data = p;
+            p += api->m_BufferSize;
+        }
+    }
+
+    uint8_t* p = (uint8_t*)read_ahead_file->m_ReadAheadMem;
+    void* thread_mem = p;
+    p += Longtail_GetThreadSize();
+    int err = Longtail_CreateSema(p, 0, &read_ahead_file->m_FilledSema);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateSema() failed with %d", err)
+        return err;
+    }
+    p += Longtail_GetSemaSize();
+    err = Longtail_CreateSema(p, (int)buffer_count, &read_ahead_file->m_FreeSema);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateSema() failed with %d", err)
+        Longtail_DeleteSema(read_ahead_file->m_FilledSema);
+        return err;
+    }
+
+    read_ahead_file->m_Stop = 0;
+    read_ahead_file->m_ReadAheadOffset = offset - (offset % READAHEADSTORAGE_READ_ALIGNMENT);
+    read_ahead_file->m_ConsumeIndex = 0;
+    read_ahead_file->m_ConsumeBufferFilled = 0;
+    err = Longtail_CreateThread(thread_mem, ReadAheadStorageAPI_PrefetchThread, 0, read_ahead_file, 0, &read_ahead_file->m_Thread);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateThread() failed with %d", err)
+        Longtail_DeleteSema(read_ahead_file->m_FreeSema);
+        Longtail_DeleteSema(read_ahead_file->m_FilledSema);
+        return err;
+    }
+    read_ahead_file->m_IsReadingAhead = 1;
+    return 0;
+}
+
+static void ReadAheadStorageAPI_StopReadAhead(struct ReadAheadStorageAPI_OpenFile* read_ahead_file)
+{
+    if (!read_ahead_file->m_IsReadingAhead)
+    {
+        return;
+    }
+    Longtail_AtomicAdd32(&read_ahead_file->m_Stop, 1);
+    Longtail_PostSema(read_ahead_file->m_FreeSema, 1);
+    Longtail_JoinThread(read_ahead_file->m_Thread, LONGTAIL_TIMEOUT_INFINITE);
+    Longtail_DeleteThread(read_ahead_file->m_Thread);
+    Longtail_DeleteSema(read_ahead_file->m_FreeSema);
+    Longtail_DeleteSema(read_ahead_file->m_FilledSema);
+    read_ahead_file->m_IsReadingAhead = 0;
+}
+
+// Serves a sequential read from the read ahead buffers, returns EAGAIN if the buffers does not cover the read
+static int ReadAheadStorageAPI_ReadFromBuffers(
+    struct ReadAheadStorageAPI_OpenFile* read_ahead_file,
+    uint64_t* io_offset,
+    uint64_t* io_length,
+    uint8_t** io_output)
+{
+    uint32_t buffer_count = read_ahead_file->m_ReadAheadStorage->m_BufferCount;
+    while (*io_length > 0)
+    {
+        struct ReadAheadStorageAPI_Buffer* buffer = &read_ahead_file->m_Buffers[read_ahead_file->m_ConsumeIndex % buffer_count];
+        if (!read_ahead_file->m_ConsumeBufferFilled)
+        {
+            Longtail_WaitSema(read_ahead_file->m_FilledSema, LONGTAIL_TIMEOUT_INFINITE);
+            read_ahead_file->m_ConsumeBufferFilled = 1;
+        }
+        if (buffer->m_Err)
+        {
+            return buffer->m_Err;
+        }
+        uint64_t buffer_end = buffer->m_Offset + buffer->m_Size;
+        if (*io_offset < buffer->m_Offset || *io_offset >= buffer_end)
+        {
+            return EAGAIN;
+        }
+        uint64_t copy_size = buffer_end - *io_offset;
+        if (copy_size > *io_length)
+        {
+            copy_size = *io_length;
+        }
+        memcpy(*io_output, &buffer->m_Data[*io_offset - buffer->m_Offset], (size_t)copy_size);
+        *io_offset += copy_size;
+        *io_length -= copy_size;
+        *io_output += copy_size;
+        if (*io_offset == buffer_end)
+        {
+            read_ahead_file->m_ConsumeBufferFilled = 0;
+            ++read_ahead_file->m_ConsumeIndex;
+            Longtail_PostSema(read_ahead_file->m_FreeSema, 1);
+        }
+    }
+    return 0;
+}
+
+static void ReadAheadStorageAPI_Dispose(struct Longtail_API* storage_api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_FATAL_ASSERT(ctx, storage_api != 0, return);
+    Longtail_Free(storage_api);
+}
+
+static int ReadAheadStorageAPI_WrapFile(
+    struct ReadAheadStorageAPI* api,
+    Longtail_StorageAPI_HOpenFile backing_file,
+    int is_read_file,
+    Longtail_StorageAPI_HOpenFile* out_open_file)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(api, "%p"),
+        LONGTAIL_LOGFIELD(backing_file, "%p"),
+        LONGTAIL_LOGFIELD(is_read_file, "%d"),
+        LONGTAIL_LOGFIELD(out_open_file, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    uint64_t size = 0;
+    if (is_read_file)
+    {
+        int err = api->m_BackingStorage->GetSize(api->m_BackingStorage, backing_file, &size);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "api->m_BackingStorage->GetSize() failed with %d", err)
+            api->m_BackingStorage->CloseFile(api->m_BackingStorage, backing_file);
+            return err;
+        }
+    }
+    struct ReadAheadStorageAPI_OpenFile* read_ahead_file = (struct ReadAheadStorageAPI_OpenFile*)Longtail_Alloc("ReadAheadStorageAPI", sizeof(struct ReadAheadStorageAPI_OpenFile));
+    if (!read_ahead_file)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        api->m_BackingStorage->CloseFile(api->m_BackingStorage, backing_file);
+        return ENOMEM;
+    }
+    memset(read_ahead_file, 0, sizeof(struct ReadAheadStorageAPI_OpenFile));
+    read_ahead_file->m_ReadAheadStorage = api;
+    read_ahead_file->m_BackingFile = backing_file;
+    read_ahead_file->m_IsReadFile = is_read_file;
+    read_ahead_file->m_Size = size;
+    read_ahead_file->m_NextReadOffset = 0;
+    *out_open_file = (Longtail_StorageAPI_HOpenFile)read_ahead_file;
+    return 0;
+}
+
+static int ReadAheadStorageAPI_OpenReadFile(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    Longtail_StorageAPI_HOpenFile* out_open_file)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(out_open_file, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, out_open_file != 0, return EINVAL);
+
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    Longtail_StorageAPI_HOpenFile backing_file;
+    int err = api->m_BackingStorage->OpenReadFile(api->m_BackingStorage, path, &backing_file);
+    if (err)
+    {
+        return err;
+    }
+    return ReadAheadStorageAPI_WrapFile(api, backing_file, 1, out_open_file);
+}
+
+static int ReadAheadStorageAPI_GetSize(
+    struct Longtail_StorageAPI* storage_api,
+    Longtail_StorageAPI_HOpenFile f,
+    uint64_t* out_size)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(f, "%p"),
+        LONGTAIL_LOGFIELD(out_size, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, f != 0, return EINVAL);
+
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    struct ReadAheadStorageAPI_OpenFile* read_ahead_file = (struct ReadAheadStorageAPI_OpenFile*)f;
+    return api->m_BackingStorage->GetSize(api->m_BackingStorage, read_ahead_file->m_BackingFile, out_size);
+}
+
+static int ReadAheadStorageAPI_Read(
+    struct Longtail_StorageAPI* storage_api,
+    Longtail_StorageAPI_HOpenFile f,
+    uint64_t offset,
+    uint64_t length,
+    void* output)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(f, "%p"),
+        LONGTAIL_LOGFIELD(offset, "%" PRIu64),
+        LONGTAIL_LOGFIELD(length, "%" PRIu64),
+        LONGTAIL_LOGFIELD(output, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, f != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, output != 0, return EINVAL);
+
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    struct ReadAheadStorageAPI_OpenFile* read_ahead_file = (struct ReadAheadStorageAPI_OpenFile*)f;
+    struct Longtail_StorageAPI* backing_storage = api->m_BackingStorage;
+
+    int is_sequential = read_ahead_file->m_IsReadFile && (offset == read_ahead_file->m_NextReadOffset) && (offset + length <= read_ahead_file->m_Size);
+    if (read_ahead_file->m_IsReadingAhead && !is_sequential)
+    {
+        ReadAheadStorageAPI_StopReadAhead(read_ahead_file);
+    }
+    if (is_sequential && !read_ahead_file->m_IsReadingAhead && (read_ahead_file->m_Size - offset) > api->m_BufferSize)
+    {
+        int err = ReadAheadStorageAPI_StartReadAhead(read_ahead_file, offset);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "ReadAheadStorageAPI_StartReadAhead() failed with %d", err)
+        }
+    }
+    read_ahead_file->m_NextReadOffset = offset + length;
+
+    uint8_t* p = (uint8_t*)output;
+    if (read_ahead_file->m_IsReadingAhead)
+    {
+        int err = ReadAheadStorageAPI_ReadFromBuffers(read_ahead_file, &offset, &length, &p);
+        if (err == 0)
+        {
+            return 0;
+        }
+        ReadAheadStorageAPI_StopReadAhead(read_ahead_file);
+        if (err != EAGAIN)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ReadAheadStorageAPI_ReadFromBuffers() failed with %d", err)
+            return err;
+        }
+    }
+    return backing_storage->Read(backing_storage, read_ahead_file->m_BackingFile, offset, length, p);
+}
+
+static int ReadAheadStorageAPI_OpenWriteFile(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    uint64_t initial_size,
+    Longtail_StorageAPI_HOpenFile* out_open_file)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(initial_size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(out_open_file, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, out_open_file != 0, return EINVAL);
+
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    Longtail_StorageAPI_HOpenFile backing_file;
+    int err = api->m_BackingStorage->OpenWriteFile(api->m_BackingStorage, path, initial_size, &backing_file);
+    if (err)
+    {
+        return err;
+    }
+    return ReadAheadStorageAPI_WrapFile(api, backing_file, 0, out_open_file);
+}
+
+static int ReadAheadStorageAPI_Write(
+    struct Longtail_StorageAPI* storage_api,
+    Longtail_StorageAPI_HOpenFile f,
+    uint64_t offset,
+    uint64_t length,
+    const void* input)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    struct ReadAheadStorageAPI_OpenFile* read_ahead_file = (struct ReadAheadStorageAPI_OpenFile*)f;
+    return api->m_BackingStorage->Write(api->m_BackingStorage, read_ahead_file->m_BackingFile, offset, length, input);
+}
+
+static int ReadAheadStorageAPI_WriteV(
+    struct Longtail_StorageAPI* storage_api,
+    Longtail_StorageAPI_HOpenFile f,
+    uint64_t offset,
+    uint32_t vec_count,
+    const struct Longtail_StorageAPI_IOVec* vecs)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    struct ReadAheadStorageAPI_OpenFile* read_ahead_file = (struct ReadAheadStorageAPI_OpenFile*)f;
+    return api->m_BackingStorage->WriteV(api->m_BackingStorage, read_ahead_file->m_BackingFile, offset, vec_count, vecs);
+}
+
+static int ReadAheadStorageAPI_SetSize(
+    struct Longtail_StorageAPI* storage_api,
+    Longtail_StorageAPI_HOpenFile f,
+    uint64_t length)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    struct ReadAheadStorageAPI_OpenFile* read_ahead_file = (struct ReadAheadStorageAPI_OpenFile*)f;
+    return api->m_BackingStorage->SetSize(api->m_BackingStorage, read_ahead_file->m_BackingFile, length);
+}
+
+static int ReadAheadStorageAPI_SetPermissions(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    uint16_t permissions)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->SetPermissions(api->m_BackingStorage, path, permissions);
+}
+
+static int ReadAheadStorageAPI_GetPermissions(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    uint16_t* out_permissions)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->GetPermissions(api->m_BackingStorage, path, out_permissions);
+}
+
+static int ReadAheadStorageAPI_GetFileStat(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    uint64_t* out_size,
+    uint64_t* out_modification_time,
+    uint64_t* out_change_time,
+    uint64_t* out_file_id)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->GetFileStat(api->m_BackingStorage, path, out_size, out_modification_time, out_change_time, out_file_id);
+}
+
+static void ReadAheadStorageAPI_CloseFile(
+    struct Longtail_StorageAPI* storage_api,
+    Longtail_StorageAPI_HOpenFile f)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(f, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return)
+    LONGTAIL_VALIDATE_INPUT(ctx, f != 0, return)
+
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    struct ReadAheadStorageAPI_OpenFile* read_ahead_file = (struct ReadAheadStorageAPI_OpenFile*)f;
+    ReadAheadStorageAPI_StopReadAhead(read_ahead_file);
+    api->m_BackingStorage->CloseFile(api->m_BackingStorage, read_ahead_file->m_BackingFile);
+    Longtail_Free(read_ahead_file->m_ReadAheadMem);
+    Longtail_Free(read_ahead_file);
+}
+
+static int ReadAheadStorageAPI_CreateDir(struct Longtail_StorageAPI* storage_api, const char* path)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->CreateDir(api->m_BackingStorage, path);
+}
+
+static int ReadAheadStorageAPI_RenameFile(struct Longtail_StorageAPI* storage_api, const char* source_path, const char* target_path)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->RenameFile(api->m_BackingStorage, source_path, target_path);
+}
+
+static char* ReadAheadStorageAPI_ConcatPath(struct Longtail_StorageAPI* storage_api, const char* root_path, const char* sub_path)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->ConcatPath(api->m_BackingStorage, root_path, sub_path);
+}
+
+static int ReadAheadStorageAPI_IsDir(struct Longtail_StorageAPI* storage_api, const char* path)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->IsDir(api->m_BackingStorage, path);
+}
+
+static int ReadAheadStorageAPI_IsFile(struct Longtail_StorageAPI* storage_api, const char* path)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->IsFile(api->m_BackingStorage, path);
+}
+
+static int ReadAheadStorageAPI_RemoveDir(struct Longtail_StorageAPI* storage_api, const char* path)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->RemoveDir(api->m_BackingStorage, path);
+}
+
+static int ReadAheadStorageAPI_RemoveFile(struct Longtail_StorageAPI* storage_api, const char* path)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->RemoveFile(api->m_BackingStorage, path);
+}
+
+static int ReadAheadStorageAPI_StartFind(struct Longtail_StorageAPI* storage_api, const char* path, Longtail_StorageAPI_HIterator* out_iterator)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->StartFind(api->m_BackingStorage, path, out_iterator);
+}
+
+static int ReadAheadStorageAPI_FindNext(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HIterator iterator)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->FindNext(api->m_BackingStorage, iterator);
+}
+
+static void ReadAheadStorageAPI_CloseFind(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HIterator iterator)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    api->m_BackingStorage->CloseFind(api->m_BackingStorage, iterator);
+}
+
+static int ReadAheadStorageAPI_GetEntryProperties(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HIterator iterator, struct Longtail_StorageAPI_EntryProperties* out_properties)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->GetEntryProperties(api->m_BackingStorage, iterator, out_properties);
+}
+
+static int ReadAheadStorageAPI_LockFile(struct Longtail_StorageAPI* storage_api, const char* path, Longtail_StorageAPI_HLockFile* out_lock_file)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->LockFile(api->m_BackingStorage, path, out_lock_file);
+}
+
+static int ReadAheadStorageAPI_UnlockFile(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HLockFile lock_file)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->UnlockFile(api->m_BackingStorage, lock_file);
+}
+
+static char* ReadAheadStorageAPI_GetParentPath(struct Longtail_StorageAPI* storage_api, const char* path)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    return api->m_BackingStorage->GetParentPath(api->m_BackingStorage, path);
+}
+
+static int ReadAheadStorageAPI_MapFile(
+    struct Longtail_StorageAPI* storage_api,
+    Longtail_StorageAPI_HOpenFile f,
+    uint64_t offset,
+    uint64_t length,
+    Longtail_StorageAPI_HFileMap* out_file_map,
+    const void** out_data_ptr)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    struct ReadAheadStorageAPI_OpenFile* read_ahead_file = (struct ReadAheadStorageAPI_OpenFile*)f;
+    return api->m_BackingStorage->MapFile(api->m_BackingStorage, read_ahead_file->m_BackingFile, offset, length, out_file_map, out_data_ptr);
+}
+
+static void ReadAheadStorageAPI_UnmapFile(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HFileMap m)
+{
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    api->m_BackingStorage->UnMapFile(api->m_BackingStorage, m);
+}
+
+static int ReadAheadStorageAPI_OpenAppendFile(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    Longtail_StorageAPI_HOpenFile* out_open_file)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(out_open_file, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL);
+    LONGTAIL_VALIDATE_INPUT(ctx, out_open_file != 0, return EINVAL);
+
+    struct ReadAheadStorageAPI* api = (struct ReadAheadStorageAPI*)storage_api;
+    Longtail_StorageAPI_HOpenFile backing_file;
+    int err = api->m_BackingStorage->OpenAppendFile(api->m_BackingStorage, path, &backing_file);
+    if (err)
+    {
+        return err;
+    }
+    return ReadAheadStorageAPI_WrapFile(api, backing_file, 0, out_open_file);
+}
+
+static int ReadAheadStorageAPI_Init(
+    void* mem,
+    struct Longtail_StorageAPI* backing_storage,
+    uint32_t buffer_size,
+    uint32_t buffer_count,
+    struct Longtail_StorageAPI** out_storage_api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(mem, "%p"),
+        LONGTAIL_LOGFIELD(backing_storage, "%p"),
+        LONGTAIL_LOGFIELD(buffer_size, "%u"),
+        LONGTAIL_LOGFIELD(buffer_count, "%u"),
+        LONGTAIL_LOGFIELD(out_storage_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, mem != 0, return EINVAL);
+    struct Longtail_StorageAPI* api = Longtail_MakeStorageAPI(
+        mem,
+        ReadAheadStorageAPI_Dispose,
+        ReadAheadStorageAPI_OpenReadFile,
+        ReadAheadStorageAPI_GetSize,
+        ReadAheadStorageAPI_Read,
+        ReadAheadStorageAPI_OpenWriteFile,
+        ReadAheadStorageAPI_Write,
+        ReadAheadStorageAPI_SetSize,
+        ReadAheadStorageAPI_SetPermissions,
+        ReadAheadStorageAPI_GetPermissions,
+        ReadAheadStorageAPI_CloseFile,
+        ReadAheadStorageAPI_CreateDir,
+        ReadAheadStorageAPI_RenameFile,
+        ReadAheadStorageAPI_ConcatPath,
+        ReadAheadStorageAPI_IsDir,
+        ReadAheadStorageAPI_IsFile,
+        ReadAheadStorageAPI_RemoveDir,
+        ReadAheadStorageAPI_RemoveFile,
+        ReadAheadStorageAPI_StartFind,
+        ReadAheadStorageAPI_FindNext,
+        ReadAheadStorageAPI_CloseFind,
+        ReadAheadStorageAPI_GetEntryProperties,
+        ReadAheadStorageAPI_LockFile,
+        ReadAheadStorageAPI_UnlockFile,
+        ReadAheadStorageAPI_GetParentPath,
+        ReadAheadStorageAPI_MapFile,
+        ReadAheadStorageAPI_UnmapFile,
+        ReadAheadStorageAPI_OpenAppendFile,
+        ReadAheadStorageAPI_WriteV,
+        ReadAheadStorageAPI_GetFileStat);
+
+    struct ReadAheadStorageAPI* read_ahead_storage_api = (struct ReadAheadStorageAPI*)api;
+    read_ahead_storage_api->m_BackingStorage = backing_storage;
+    read_ahead_storage_api->m_BufferSize = buffer_size;
+    read_ahead_storage_api->m_BufferCount = buffer_count;
+    *out_storage_api = api;
+    return 0;
+}
+
+struct Longtail_StorageAPI* Longtail_CreateReadAheadStorageAPI(
+    struct Longtail_StorageAPI* backing_storage,
+    uint32_t buffer_size,
+    uint32_t buffer_count)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(backing_storage, "%p"),
+        LONGTAIL_LOGFIELD(buffer_size, "%u"),
+        LONGTAIL_LOGFIELD(buffer_count, "%u")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, backing_storage != 0, return 0);
+    LONGTAIL_VALIDATE_INPUT(ctx, buffer_size > 0, return 0);
+    LONGTAIL_VALIDATE_INPUT(ctx, buffer_count >= 2, return 0);
+
+    uint32_t aligned_buffer_size = ((buffer_size + READAHEADSTORAGE_READ_ALIGNMENT - 1) / READAHEADSTORAGE_READ_ALIGNMENT) * READAHEADSTORAGE_READ_ALIGNMENT;
+    void* mem = Longtail_Alloc("ReadAheadStorageAPI", sizeof(struct ReadAheadStorageAPI));
+    if (!mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return 0;
+    }
+    struct Longtail_StorageAPI* storage_api;
+    int err = ReadAheadStorageAPI_Init(mem, backing_storage, aligned_buffer_size, buffer_count, &storage_api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ReadAheadStorageAPI_Init() failed with %d", err)
+        Longtail_Free(mem);
+        return 0;
+    }
+    return storage_api;
+}
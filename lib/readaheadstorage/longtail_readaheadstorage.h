@@ -0,0 +1,30 @@
+#pragma once
+
+#include "../../src/longtail.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! @brief Creates a storage API that reads ahead when a file is read sequentially.
+ *
+ * Wraps @p backing_storage and forwards all calls to it. When a file opened with OpenReadFile is read
+ * sequentially a prefetch thread starts filling @p buffer_count rotating buffers of @p buffer_size bytes
+ * ahead of the reader, so the caller can process one buffer while the next ones are being read.
+ * Reads from the backing storage are made in @p buffer_size chunks at offsets aligned to 4096 bytes.
+ * A non-sequential read stops the prefetch, it is restarted on the next sequential read.
+ * A file handle opened for reading must not be read from more than one thread at a time.
+ *
+ * @param[in] backing_storage   The storage API to read from
+ * @param[in] buffer_size       The size of each read ahead buffer, rounded up to a multiple of 4096 bytes
+ * @param[in] buffer_count      The number of read ahead buffers per file, at least two
+ * @return                      The storage API, or null on failure
+ */
+LONGTAIL_EXPORT extern struct Longtail_StorageAPI* Longtail_CreateReadAheadStorageAPI(
+    struct Longtail_StorageAPI* backing_storage,
+    uint32_t buffer_size,
+    uint32_t buffer_count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -379,6 +379,110 @@ static int ShareBlockStore_GetStoredBlock(
     return 0;
 }
 
+// Hands out the block if it is already shared, returns zero if it is not
+static int ShareBlockStore_GetSharedStoredBlock(
+    struct ShareBlockStoreAPI* api,
+    uint64_t block_hash,
+    struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
+{
+    Longtail_LockSpinLock(api->m_Lock);
+    intptr_t find_block_ptr = hmgeti(api->m_BlockHashToSharedStoredBlock, block_hash);
+    if (find_block_ptr == -1)
+    {
+        Longtail_UnlockSpinLock(api->m_Lock);
+        return 0;
+    }
+    struct SharedStoredBlock* shared_stored_block = api->m_BlockHashToSharedStoredBlock[find_block_ptr].value;
+    Longtail_AtomicAdd32(&shared_stored_block->m_RefCount, 1);
+    Longtail_UnlockSpinLock(api->m_Lock);
+    Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Chunk_Count], *shared_stored_block->m_StoredBlock.m_BlockIndex->m_ChunkCount);
+    Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Byte_Count], Longtail_GetBlockIndexDataSize(*shared_stored_block->m_StoredBlock.m_BlockIndex->m_ChunkCount) + shared_stored_block->m_StoredBlock.m_BlockChunksDataSize);
+    async_complete_api->OnComplete(async_complete_api, &shared_stored_block->m_StoredBlock, 0);
+    return 1;
+}
+
+// Blocks that are already shared are handed out as is, other blocks are read into the caller buffer by the
+// backing store and are not shared since the caller owns their data
+static int ShareBlockStore_GetStoredBlockToBuffer(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint64_t block_hash,
+    void* buffer,
+    uint32_t buffer_size,
+    struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(buffer_size, "%u"),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, buffer, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api->OnComplete, return EINVAL)
+    struct ShareBlockStoreAPI* api = (struct ShareBlockStoreAPI*)block_store_api;
+    Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count], 1);
+
+    if (ShareBlockStore_GetSharedStoredBlock(api, block_hash, async_complete_api))
+    {
+        return 0;
+    }
+
+    int err = api->m_BackingBlockStore->GetStoredBlockToBuffer(api->m_BackingBlockStore, block_hash, buffer, buffer_size, async_complete_api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_INFO : LONGTAIL_LOG_LEVEL_ERROR, "api->m_BackingBlockStore->GetStoredBlockToBuffer() failed with %d", err)
+        Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_FailCount], 1);
+    }
+    return err;
+}
+
+// Blocks that are already shared are handed out whole, chunk ranges read by the backing store are not shared
+static int ShareBlockStore_GetStoredBlockChunkRange(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    uint64_t block_hash,
+    uint32_t first_chunk_index,
+    uint32_t chunk_count,
+    struct Longtail_AsyncGetStoredBlockAPI* async_complete_api)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(first_chunk_index, "%u"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u"),
+        LONGTAIL_LOGFIELD(async_complete_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, async_complete_api->OnComplete, return EINVAL)
+    struct ShareBlockStoreAPI* api = (struct ShareBlockStoreAPI*)block_store_api;
+    Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count], 1);
+
+    if (ShareBlockStore_GetSharedStoredBlock(api, block_hash, async_complete_api))
+    {
+        return 0;
+    }
+
+    int err = api->m_BackingBlockStore->GetStoredBlockChunkRange(api->m_BackingBlockStore, block_hash, first_chunk_index, chunk_count, async_complete_api);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_INFO : LONGTAIL_LOG_LEVEL_ERROR, "api->m_BackingBlockStore->GetStoredBlockChunkRange() failed with %d", err)
+        Longtail_AtomicAdd64(&api->m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_FailCount], 1);
+    }
+    return err;
+}
+
 static int ShareBlockStore_GetExistingContent(
     struct Longtail_BlockStoreAPI* block_store_api,
     uint32_t chunk_count,
@@ -529,6 +633,9 @@ static int ShareBlockStore_Init(
         return EINVAL;
     }
 
+    block_store_api->GetStoredBlockToBuffer = backing_block_store->GetStoredBlockToBuffer ? ShareBlockStore_GetStoredBlockToBuffer : 0;
+    block_store_api->GetStoredBlockChunkRange = backing_block_store->GetStoredBlockChunkRange ? ShareBlockStore_GetStoredBlockChunkRange : 0;
+
     struct ShareBlockStoreAPI* api = (struct ShareBlockStoreAPI*)block_store_api;
     api->m_BackingBlockStore = backing_block_store;
     api->m_BlockHashToSharedStoredBlock = 0;
@@ -0,0 +1,142 @@
+#include "longtail_xxh3.h"
+
+#define XXH_INLINE_ALL
+#include "ext/xxhash.h"
+#include <errno.h>
+
+const uint32_t LONGTAIL_XXH3_HASH_TYPE = (((uint32_t)'x') << 24) + (((uint32_t)'x') << 16) + (((uint32_t)'h') << 8) + ((uint32_t)'3');
+const uint32_t Longtail_GetXXH3HashType() { return LONGTAIL_XXH3_HASH_TYPE; }
+
+// XXH3_state_t must be 64 byte aligned, we over-allocate and keep the allocation pointer just before the aligned state
+#define LONGTAIL_XXH3_STATE_ALIGNMENT 64
+
+struct XXH3HashAPI
+{
+    struct Longtail_HashAPI m_XXH3HashAPI;
+};
+
+static uint32_t XXH3Hash_GetIdentifier(struct Longtail_HashAPI* hash_api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(hash_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_FATAL_ASSERT(ctx, hash_api, return 0)
+    return LONGTAIL_XXH3_HASH_TYPE;
+}
+
+static int XXH3Hash_BeginContext(struct Longtail_HashAPI* hash_api, Longtail_HashAPI_HContext* out_context)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(hash_api, "%p"),
+        LONGTAIL_LOGFIELD(out_context, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_FATAL_ASSERT(ctx, hash_api, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, out_context, return EINVAL)
+    void* mem = Longtail_Alloc("XXH3", sizeof(XXH3_state_t) + LONGTAIL_XXH3_STATE_ALIGNMENT);
+    if (!mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    uintptr_t aligned = ((uintptr_t)mem + LONGTAIL_XXH3_STATE_ALIGNMENT) & ~((uintptr_t)LONGTAIL_XXH3_STATE_ALIGNMENT - 1);
+    ((void**)aligned)[-1] = mem;
+    XXH3_state_t* state = (XXH3_state_t*)aligned;
+    XXH3_INITSTATE(state);
+    XXH3_64bits_reset(state);
+    *out_context = (Longtail_HashAPI_HContext)state;
+    return 0;
+}
+
+static void XXH3Hash_Hash(struct Longtail_HashAPI* hash_api, Longtail_HashAPI_HContext context, uint32_t length, const void* data)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(hash_api, "%p"),
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(length, "%u"),
+        LONGTAIL_LOGFIELD(data, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, hash_api, return)
+    LONGTAIL_FATAL_ASSERT(ctx, context, return)
+    XXH3_state_t* state = (XXH3_state_t*)context;
+    XXH3_64bits_update(state, data, (size_t)length);
+}
+
+static uint64_t XXH3Hash_EndContext(struct Longtail_HashAPI* hash_api, Longtail_HashAPI_HContext context)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(hash_api, "%p"),
+        LONGTAIL_LOGFIELD(context, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_FATAL_ASSERT(ctx, hash_api, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, context, return 0)
+    XXH3_state_t* state = (XXH3_state_t*)context;
+    uint64_t hash = (uint64_t)XXH3_64bits_digest(state);
+    Longtail_Free(((void**)state)[-1]);
+    return hash;
+}
+
+static int XXH3Hash_HashBuffer(struct Longtail_HashAPI* hash_api, uint32_t length, const void* data, uint64_t* out_hash)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(hash_api, "%p"),
+        LONGTAIL_LOGFIELD(length, "%u"),
+        LONGTAIL_LOGFIELD(data, "%p"),
+        LONGTAIL_LOGFIELD(out_hash, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, hash_api, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, data, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, out_hash, return EINVAL)
+    *out_hash = (uint64_t)XXH3_64bits(data, (size_t)length);
+    return 0;
+}
+
+static void XXH3Hash_Dispose(struct Longtail_API* hash_api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(hash_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_FATAL_ASSERT(ctx, hash_api, return)
+    Longtail_Free(hash_api);
+}
+
+static void XXH3Hash_Init(struct XXH3HashAPI* hash_api)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(hash_api, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_FATAL_ASSERT(ctx, hash_api, return)
+    hash_api->m_XXH3HashAPI.m_API.Dispose = XXH3Hash_Dispose;
+    hash_api->m_XXH3HashAPI.GetIdentifier = XXH3Hash_GetIdentifier;
+    hash_api->m_XXH3HashAPI.BeginContext = XXH3Hash_BeginContext;
+    hash_api->m_XXH3HashAPI.Hash = XXH3Hash_Hash;
+    hash_api->m_XXH3HashAPI.EndContext = XXH3Hash_EndContext;
+    hash_api->m_XXH3HashAPI.HashBuffer = XXH3Hash_HashBuffer;
+}
+
+struct Longtail_HashAPI* Longtail_CreateXXH3HashAPI()
+{
+    MAKE_LOG_CONTEXT(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+    struct XXH3HashAPI* xxh3_hash = (struct XXH3HashAPI*)Longtail_Alloc("XXH3", sizeof(struct XXH3HashAPI));
+    if (!xxh3_hash)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return 0;
+    }
+    XXH3Hash_Init(xxh3_hash);
+    return &xxh3_hash->m_XXH3HashAPI;
+}
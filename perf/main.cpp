@@ -16,6 +16,10 @@
 #include "../src/longtail.h"
 #include "../lib/filestorage/longtail_filestorage.h"
 #include "../lib/bikeshed/longtail_bikeshed.h"
+#include "../lib/blake2/longtail_blake2.h"
+#include "../lib/blake3/longtail_blake3.h"
+#include "../lib/meowhash/longtail_meowhash.h"
+#include "../lib/xxh3/longtail_xxh3.h"
 
 
 struct Longtail_LookupTable
@@ -330,6 +334,62 @@ uint64_t TestGetExistingContentSpeed(struct Longtail_StorageAPI* storage_api)
     return elapsed;
 }
 
+uint64_t TestHashSpeed(struct Longtail_HashAPI* hash_api, const uint8_t* data, uint32_t data_size, uint32_t chunk_size)
+{
+    uint64_t start = stm_now();
+    uint64_t sum = 0;
+    for (uint32_t offset = 0; offset < data_size; offset += chunk_size)
+    {
+        uint32_t size = (data_size - offset) < chunk_size ? (data_size - offset) : chunk_size;
+        uint64_t hash;
+        hash_api->HashBuffer(hash_api, size, &data[offset], &hash);
+        sum += hash;
+    }
+    uint64_t elapsed = stm_now() - start;
+    if (sum == 0)
+    {
+        printf("TestHashSpeed: unexpected zero hash sum\n");
+    }
+    return elapsed;
+}
+
+void RunHashSpeedTests()
+{
+    const uint32_t data_size = 256 * 1024 * 1024;
+    uint8_t* data = (uint8_t*)Longtail_Alloc("perf", data_size);
+    uint64_t seed = 0x9e3779b97f4a7c15ull;
+    for (uint32_t i = 0; i < data_size; ++i)
+    {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        data[i] = (uint8_t)(seed >> 56);
+    }
+
+    const char* hash_names[4] = { "blake2", "blake3", "meow", "xxh3" };
+    struct Longtail_HashAPI* hash_apis[4] = {
+        Longtail_CreateBlake2HashAPI(),
+        Longtail_CreateBlake3HashAPI(),
+        Longtail_CreateMeowHashAPI(),
+        Longtail_CreateXXH3HashAPI() };
+    const uint32_t chunk_sizes[4] = { 4096, 32768, 131072, 1048576 };
+
+    for (uint32_t h = 0; h < 4; ++h)
+    {
+        if (hash_apis[h] == 0)
+        {
+            printf("TestHashSpeed %s: not supported\n", hash_names[h]);
+            continue;
+        }
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            uint64_t ticks = TestHashSpeed(hash_apis[h], data, data_size, chunk_sizes[c]);
+            double ms = stm_ms(ticks);
+            printf("TestHashSpeed %s, %u byte chunks: %.3lf ms (%.1lf MB/s)\n", hash_names[h], chunk_sizes[c], ms, (data_size / (1024.0 * 1024.0)) / (ms / 1000.0));
+        }
+        SAFE_DISPOSE_API(hash_apis[h]);
+    }
+    Longtail_Free(data);
+}
+
 int main(int argc, char** argv)
 {
     int result = 0;
@@ -377,6 +437,8 @@ int main(int argc, char** argv)
     uint64_t get_existing_content_ticks = TestGetExistingContentSpeed(storage_api);
     printf("TestGetExistingContentSpeed: %.3lf ms\n", stm_ms(get_existing_content_ticks));
 
+    RunHashSpeedTests();
+
     SAFE_DISPOSE_API(storage_api);
 
     Longtail_SetAssert(0);
@@ -13,15 +13,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#if defined(_WIN32)
+    #include <intrin.h>
+#endif
+
 #define LONGTAIL_VERSION(major, minor, patch)  ((((uint32_t)major) << 24) | ((uint32_t)minor << 16) | ((uint32_t)patch))
 #define LONGTAIL_VERSION_INDEX_VERSION_0_0_1  LONGTAIL_VERSION(0,0,1)
 #define LONGTAIL_VERSION_INDEX_VERSION_0_0_2  LONGTAIL_VERSION(0,0,2)
 #define LONGTAIL_STORE_INDEX_VERSION_1_0_0    LONGTAIL_VERSION(1,0,0)
 #define LONGTAIL_ARCHIVE_VERSION_0_0_1        LONGTAIL_VERSION(0,0,1)
+#define LONGTAIL_BLOCK_REF_COUNT_INDEX_VERSION_1_0_0  LONGTAIL_VERSION(1,0,0)
+#define LONGTAIL_FOLDER_STATE_VERSION_1_0_0   LONGTAIL_VERSION(1,0,0)
 
 uint32_t Longtail_CurrentVersionIndexVersion = LONGTAIL_VERSION_INDEX_VERSION_0_0_2;
 uint32_t Longtail_CurrentStoreIndexVersion = LONGTAIL_STORE_INDEX_VERSION_1_0_0;
 uint32_t Longtail_CurrentArchiveVersion = LONGTAIL_ARCHIVE_VERSION_0_0_1;
+uint32_t Longtail_CurrentBlockRefCountIndexVersion = LONGTAIL_BLOCK_REF_COUNT_INDEX_VERSION_1_0_0;
+uint32_t Longtail_CurrentFolderStateVersion = LONGTAIL_FOLDER_STATE_VERSION_1_0_0;
 
 #if defined(_WIN32)
     #define SORTFUNC(name) int name(void* context, const void* a_ptr, const void* b_ptr)
@@ -266,7 +274,9 @@ struct Longtail_StorageAPI* Longtail_MakeStorageAPI(
     Longtail_Storage_GetParentPathFunc get_parent_path_func,
     Longtail_Storage_MapFileFunc map_file_func,
     Longtail_Storage_UnmapFileFunc unmap_file_func,
-    Longtail_Storage_OpenAppendFileFunc open_append_file_func)
+    Longtail_Storage_OpenAppendFileFunc open_append_file_func,
+    Longtail_Storage_WriteVFunc write_v_func,
+    Longtail_Storage_GetFileStatFunc get_file_stat_func)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(mem, "%p"),
@@ -296,7 +306,9 @@ struct Longtail_StorageAPI* Longtail_MakeStorageAPI(
         LONGTAIL_LOGFIELD(get_parent_path_func, "%p"),
         LONGTAIL_LOGFIELD(map_file_func, "%p"),
         LONGTAIL_LOGFIELD(unmap_file_func, "%p"),
-        LONGTAIL_LOGFIELD(open_append_file_func, "%p")
+        LONGTAIL_LOGFIELD(open_append_file_func, "%p"),
+        LONGTAIL_LOGFIELD(write_v_func, "%p"),
+        LONGTAIL_LOGFIELD(get_file_stat_func, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
     LONGTAIL_VALIDATE_INPUT(ctx, mem != 0, return 0)
@@ -328,6 +340,8 @@ struct Longtail_StorageAPI* Longtail_MakeStorageAPI(
     api->MapFile = map_file_func;
     api->UnMapFile = unmap_file_func;
     api->OpenAppendFile = open_append_file_func;
+    api->WriteV = write_v_func;
+    api->GetFileStat = get_file_stat_func;
     return api;
 }
 
@@ -357,6 +371,8 @@ char* Longtail_Storage_GetParentPath(struct Longtail_StorageAPI* storage_api, co
 int Longtail_Storage_MapFile(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HOpenFile f, uint64_t offset, uint64_t length, Longtail_StorageAPI_HFileMap* out_file_map, const void** out_data_ptr) { return storage_api->MapFile(storage_api, f, offset, length, out_file_map, out_data_ptr); }
 void Longtail_Storage_UnmapFile(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HFileMap m) { storage_api->UnMapFile(storage_api, m); }
 int Longtail_Storage_OpenAppendFile(struct Longtail_StorageAPI* storage_api, const char* path, Longtail_StorageAPI_HOpenFile* out_open_file) { return storage_api->OpenAppendFile(storage_api, path, out_open_file); }
+int Longtail_Storage_WriteV(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HOpenFile f, uint64_t offset, uint32_t vec_count, const struct Longtail_StorageAPI_IOVec* vecs) { return storage_api->WriteV(storage_api, f, offset, vec_count, vecs); }
+int Longtail_Storage_GetFileStat(struct Longtail_StorageAPI* storage_api, const char* path, uint64_t* out_size, uint64_t* out_modification_time, uint64_t* out_change_time, uint64_t* out_file_id) { return storage_api->GetFileStat(storage_api, path, out_size, out_modification_time, out_change_time, out_file_id); }
 
 ////////////// ConcurrentChunkWriteAPI
 
@@ -372,7 +388,8 @@ LONGTAIL_EXPORT struct Longtail_ConcurrentChunkWriteAPI* Longtail_MakeConcurrent
     Longtail_ConcurrentChunkWrite_OpenFunc open_func,
     Longtail_ConcurrentChunkWrite_CloseFunc close_func,
     Longtail_ConcurrentChunkWrite_WriteFunc write_func,
-    Longtail_ConcurrentChunkWrite_FlushFunc flush_func)
+    Longtail_ConcurrentChunkWrite_FlushFunc flush_func,
+    Longtail_ConcurrentChunkWrite_WriteVFunc write_v_func)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(mem, "%p"),
@@ -381,7 +398,8 @@ LONGTAIL_EXPORT struct Longtail_ConcurrentChunkWriteAPI* Longtail_MakeConcurrent
         LONGTAIL_LOGFIELD(open_func, "%p"),
         LONGTAIL_LOGFIELD(close_func, "%p"),
         LONGTAIL_LOGFIELD(write_func, "%p"),
-        LONGTAIL_LOGFIELD(flush_func, "%p")
+        LONGTAIL_LOGFIELD(flush_func, "%p"),
+        LONGTAIL_LOGFIELD(write_v_func, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
     LONGTAIL_VALIDATE_INPUT(ctx, mem != 0, return 0)
@@ -392,6 +410,7 @@ LONGTAIL_EXPORT struct Longtail_ConcurrentChunkWriteAPI* Longtail_MakeConcurrent
     api->Close = close_func;
     api->Write = write_func;
     api->Flush = flush_func;
+    api->WriteV = write_v_func;
     return api;
 }
 
@@ -400,6 +419,7 @@ int Longtail_ConcurrentChunkWrite_Open(struct Longtail_ConcurrentChunkWriteAPI*
 void Longtail_ConcurrentChunkWrite_Close(struct Longtail_ConcurrentChunkWriteAPI* concurrent_file_write_api, uint32_t asset_index) { concurrent_file_write_api->Close(concurrent_file_write_api, asset_index); }
 int Longtail_ConcurrentChunkWrite_Write(struct Longtail_ConcurrentChunkWriteAPI* concurrent_file_write_api, uint32_t asset_index, uint64_t offset, uint32_t size, const void* input) { return concurrent_file_write_api->Write(concurrent_file_write_api, asset_index, offset, size, input); }
 int Longtail_ConcurrentChunkWrite_Flush(struct Longtail_ConcurrentChunkWriteAPI* concurrent_file_write_api) { return concurrent_file_write_api->Flush(concurrent_file_write_api); }
+int Longtail_ConcurrentChunkWrite_WriteV(struct Longtail_ConcurrentChunkWriteAPI* concurrent_file_write_api, uint32_t asset_index, uint64_t offset, uint32_t vec_count, const struct Longtail_StorageAPI_IOVec* vecs) { return concurrent_file_write_api->WriteV(concurrent_file_write_api, asset_index, offset, vec_count, vecs); }
 
 ////////////// ProgressAPI
 
@@ -729,6 +749,8 @@ struct Longtail_BlockStoreAPI* Longtail_MakeBlockStoreAPI(
     api->PruneBlocks = prune_blocks_func;
     api->GetStats = get_stats_func;
     api->Flush = flush_func;
+    api->GetStoredBlockToBuffer = 0;
+    api->GetStoredBlockChunkRange = 0;
     return api;
 }
 
@@ -739,6 +761,8 @@ int Longtail_BlockStore_GetExistingContent(struct Longtail_BlockStoreAPI* block_
 int Longtail_BlockStore_PruneBlocks(struct Longtail_BlockStoreAPI* block_store_api, uint32_t block_keep_count, const TLongtail_Hash* block_keep_hashes, struct Longtail_AsyncPruneBlocksAPI* async_complete_api) { return block_store_api->PruneBlocks(block_store_api, block_keep_count, block_keep_hashes, async_complete_api);}
 int Longtail_BlockStore_GetStats(struct Longtail_BlockStoreAPI* block_store_api, struct Longtail_BlockStore_Stats* out_stats) { return block_store_api->GetStats(block_store_api, out_stats); }
 int Longtail_BlockStore_Flush(struct Longtail_BlockStoreAPI* block_store_api, struct Longtail_AsyncFlushAPI* async_complete_api) {return block_store_api->Flush(block_store_api, async_complete_api); }
+int Longtail_BlockStore_GetStoredBlockToBuffer(struct Longtail_BlockStoreAPI* block_store_api, uint64_t block_hash, void* buffer, uint32_t buffer_size, struct Longtail_AsyncGetStoredBlockAPI* async_complete_api) { return block_store_api->GetStoredBlockToBuffer ? block_store_api->GetStoredBlockToBuffer(block_store_api, block_hash, buffer, buffer_size, async_complete_api) : ENOTSUP; }
+int Longtail_BlockStore_GetStoredBlockChunkRange(struct Longtail_BlockStoreAPI* block_store_api, uint64_t block_hash, uint32_t first_chunk_index, uint32_t chunk_count, struct Longtail_AsyncGetStoredBlockAPI* async_complete_api) { return block_store_api->GetStoredBlockChunkRange ? block_store_api->GetStoredBlockChunkRange(block_store_api, block_hash, first_chunk_index, chunk_count, async_complete_api) : ENOTSUP; }
 
 static struct Longtail_Monitor Monitor_private = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 
@@ -804,6 +828,8 @@ static void* Longtail_SetAllocWrapper_private(const char* context, size_t s)
 
 void Longtail_SetReAllocAndFree(Longtail_ReAlloc_Func alloc, Longtail_Free_Func Longtail_Free)
 {
+    // Pooled scratch arenas must be freed with the allocator that allocated them
+    Longtail_DisposeScratchArenaPool();
     Longtail_ReAlloc_private = alloc;
     Free_private = Longtail_Free;
 }
@@ -837,6 +863,310 @@ void Longtail_Free(void* p)
     Free_private ? Free_private(p) : free(p);
 }
 
+#define LONGTAIL_SCRATCH_ARENA_ALIGNMENT 16
+#define LONGTAIL_SCRATCH_ARENA_MIN_BLOCK_SIZE 65536
+
+struct Longtail_ScratchArenaBlock
+{
+    struct Longtail_ScratchArenaBlock* m_Previous;
+    size_t m_BaseOffset;
+    size_t m_Capacity;
+    size_t m_Used;
+};
+
+struct Longtail_ScratchArena
+{
+    struct Longtail_ScratchArenaBlock* m_Block;
+    size_t m_PeakUsage;
+};
+
+static size_t Longtail_ScratchArena_AlignSize(size_t size)
+{
+    return (size + (LONGTAIL_SCRATCH_ARENA_ALIGNMENT - 1)) & ~((size_t)LONGTAIL_SCRATCH_ARENA_ALIGNMENT - 1);
+}
+
+static const size_t Longtail_ScratchArenaBlockHeaderSize = (sizeof(struct Longtail_ScratchArenaBlock) + (LONGTAIL_SCRATCH_ARENA_ALIGNMENT - 1)) & ~((size_t)LONGTAIL_SCRATCH_ARENA_ALIGNMENT - 1);
+
+static struct Longtail_ScratchArenaBlock* Longtail_ScratchArena_AllocBlock(struct Longtail_ScratchArenaBlock* previous, size_t base_offset, size_t capacity)
+{
+    struct Longtail_ScratchArenaBlock* block = (struct Longtail_ScratchArenaBlock*)Longtail_Alloc("ScratchArena", Longtail_ScratchArenaBlockHeaderSize + capacity);
+    if (!block)
+    {
+        return 0;
+    }
+    block->m_Previous = previous;
+    block->m_BaseOffset = base_offset;
+    block->m_Capacity = capacity;
+    block->m_Used = 0;
+    return block;
+}
+
+struct Longtail_ScratchArena* Longtail_CreateScratchArena(size_t initial_capacity)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(initial_capacity, "%" PRIu64)
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    struct Longtail_ScratchArena* arena = (struct Longtail_ScratchArena*)Longtail_Alloc("ScratchArena", sizeof(struct Longtail_ScratchArena));
+    if (!arena)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return 0;
+    }
+    arena->m_Block = 0;
+    arena->m_PeakUsage = 0;
+    if (initial_capacity > 0)
+    {
+        arena->m_Block = Longtail_ScratchArena_AllocBlock(0, 0, Longtail_ScratchArena_AlignSize(initial_capacity));
+        if (!arena->m_Block)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_AllocBlock() failed with %d", ENOMEM)
+            Longtail_Free(arena);
+            return 0;
+        }
+    }
+    return arena;
+}
+
+void Longtail_DisposeScratchArena(struct Longtail_ScratchArena* arena)
+{
+    if (!arena)
+    {
+        return;
+    }
+    struct Longtail_ScratchArenaBlock* block = arena->m_Block;
+    while (block)
+    {
+        struct Longtail_ScratchArenaBlock* previous = block->m_Previous;
+        Longtail_Free(block);
+        block = previous;
+    }
+    Longtail_Free(arena);
+}
+
+void* Longtail_ScratchArena_Alloc(struct Longtail_ScratchArena* arena, size_t size)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(arena, "%p"),
+        LONGTAIL_LOGFIELD(size, "%" PRIu64)
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, arena != 0, return 0)
+
+    size = Longtail_ScratchArena_AlignSize(size == 0 ? 1 : size);
+    struct Longtail_ScratchArenaBlock* block = arena->m_Block;
+    if (block == 0 || (block->m_Capacity - block->m_Used) < size)
+    {
+        size_t base_offset = block ? (block->m_BaseOffset + block->m_Used) : 0;
+        size_t capacity = block ? block->m_Capacity * 2 : LONGTAIL_SCRATCH_ARENA_MIN_BLOCK_SIZE;
+        capacity = capacity < size ? size : capacity;
+        struct Longtail_ScratchArenaBlock* new_block = Longtail_ScratchArena_AllocBlock(block, base_offset, capacity);
+        if (!new_block)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_AllocBlock() failed with %d", ENOMEM)
+            return 0;
+        }
+        arena->m_Block = new_block;
+        block = new_block;
+    }
+    void* mem = &((char*)block)[Longtail_ScratchArenaBlockHeaderSize + block->m_Used];
+    block->m_Used += size;
+    size_t usage = block->m_BaseOffset + block->m_Used;
+    if (usage > arena->m_PeakUsage)
+    {
+        arena->m_PeakUsage = usage;
+    }
+    return mem;
+}
+
+size_t Longtail_ScratchArena_GetMark(struct Longtail_ScratchArena* arena)
+{
+    struct Longtail_ScratchArenaBlock* block = arena->m_Block;
+    return block ? (block->m_BaseOffset + block->m_Used) : 0;
+}
+
+int Longtail_ScratchArena_ResetToMark(struct Longtail_ScratchArena* arena, size_t mark)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(arena, "%p"),
+        LONGTAIL_LOGFIELD(mark, "%" PRIu64)
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_FATAL_ASSERT(ctx, mark <= Longtail_ScratchArena_GetMark(arena), return EINVAL)
+
+    struct Longtail_ScratchArenaBlock* block = arena->m_Block;
+    if (block == 0)
+    {
+        return 0;
+    }
+    if (mark == 0 && block->m_Previous)
+    {
+        // Merge into a single block that fits the peak usage so the next use does not need to grow.
+        // The first block is kept until the merged block is allocated so the arena stays usable if we run out of memory
+        size_t capacity = Longtail_ScratchArena_AlignSize(arena->m_PeakUsage);
+        while (block->m_Previous)
+        {
+            struct Longtail_ScratchArenaBlock* previous = block->m_Previous;
+            Longtail_Free(block);
+            block = previous;
+        }
+        block->m_Used = 0;
+        arena->m_Block = block;
+        struct Longtail_ScratchArenaBlock* merged_block = Longtail_ScratchArena_AllocBlock(0, 0, capacity);
+        if (!merged_block)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_AllocBlock() failed with %d", ENOMEM)
+            return ENOMEM;
+        }
+        Longtail_Free(block);
+        arena->m_Block = merged_block;
+        return 0;
+    }
+    while (block->m_Previous && block->m_BaseOffset > mark)
+    {
+        struct Longtail_ScratchArenaBlock* previous = block->m_Previous;
+        Longtail_Free(block);
+        block = previous;
+    }
+    block->m_Used = mark - block->m_BaseOffset;
+    arena->m_Block = block;
+    return 0;
+}
+
+size_t Longtail_ScratchArena_GetPeakUsage(struct Longtail_ScratchArena* arena)
+{
+    return arena->m_PeakUsage;
+}
+
+void Longtail_ScratchArena_ResetPeakUsage(struct Longtail_ScratchArena* arena)
+{
+    arena->m_PeakUsage = Longtail_ScratchArena_GetMark(arena);
+}
+
+#define LONGTAIL_SCRATCH_ARENA_POOL_SIZE 64
+#define LONGTAIL_SCRATCH_ARENA_POOL_MAX_CAPACITY (64u * 1024u * 1024u)
+
+#if defined(_WIN32)
+    #define LONGTAIL_ATOMIC_EXCHANGE_PTR(target, value) _InterlockedExchangePointer((void* volatile*)(target), (value))
+    #define LONGTAIL_ATOMIC_CAS_PTR(target, expected, wanted) (_InterlockedCompareExchangePointer((void* volatile*)(target), (wanted), (expected)) == (expected))
+#elif defined(__clang__) || defined(__GNUC__)
+    #define LONGTAIL_ATOMIC_EXCHANGE_PTR(target, value) __atomic_exchange_n((target), (value), __ATOMIC_ACQ_REL)
+    #define LONGTAIL_ATOMIC_CAS_PTR(target, expected, wanted) __sync_bool_compare_and_swap((target), (expected), (wanted))
+#endif
+
+// Arenas released by operations using the default provider, reused by the next operation on any thread
+static struct Longtail_ScratchArena* volatile Longtail_ScratchArenaPool_private[LONGTAIL_SCRATCH_ARENA_POOL_SIZE];
+
+static struct Longtail_ScratchArena* Longtail_DefaultAcquireScratchArena(void* context, const char* operation, size_t size_hint)
+{
+    for (uint32_t i = 0; i < LONGTAIL_SCRATCH_ARENA_POOL_SIZE; ++i)
+    {
+        if (Longtail_ScratchArenaPool_private[i] == 0)
+        {
+            continue;
+        }
+        struct Longtail_ScratchArena* arena = (struct Longtail_ScratchArena*)LONGTAIL_ATOMIC_EXCHANGE_PTR(&Longtail_ScratchArenaPool_private[i], (struct Longtail_ScratchArena*)0);
+        if (arena)
+        {
+            return arena;
+        }
+    }
+    return Longtail_CreateScratchArena(size_hint);
+}
+
+static void Longtail_DefaultReleaseScratchArena(void* context, const char* operation, struct Longtail_ScratchArena* arena, size_t peak_usage)
+{
+    if (Longtail_ScratchArena_ResetToMark(arena, 0) == 0 && (arena->m_Block == 0 || arena->m_Block->m_Capacity <= LONGTAIL_SCRATCH_ARENA_POOL_MAX_CAPACITY))
+    {
+        for (uint32_t i = 0; i < LONGTAIL_SCRATCH_ARENA_POOL_SIZE; ++i)
+        {
+            if (Longtail_ScratchArenaPool_private[i] == 0 && LONGTAIL_ATOMIC_CAS_PTR(&Longtail_ScratchArenaPool_private[i], (struct Longtail_ScratchArena*)0, arena))
+            {
+                return;
+            }
+        }
+    }
+    Longtail_DisposeScratchArena(arena);
+}
+
+void Longtail_DisposeScratchArenaPool()
+{
+    for (uint32_t i = 0; i < LONGTAIL_SCRATCH_ARENA_POOL_SIZE; ++i)
+    {
+        struct Longtail_ScratchArena* arena = (struct Longtail_ScratchArena*)LONGTAIL_ATOMIC_EXCHANGE_PTR(&Longtail_ScratchArenaPool_private[i], (struct Longtail_ScratchArena*)0);
+        Longtail_DisposeScratchArena(arena);
+    }
+}
+
+static Longtail_ScratchArena_AcquireFunc Longtail_AcquireScratchArena_private = Longtail_DefaultAcquireScratchArena;
+static Longtail_ScratchArena_ReleaseFunc Longtail_ReleaseScratchArena_private = Longtail_DefaultReleaseScratchArena;
+static void* Longtail_ScratchArenaContext_private = 0;
+
+void Longtail_SetScratchArenaProvider(Longtail_ScratchArena_AcquireFunc acquire_func, Longtail_ScratchArena_ReleaseFunc release_func, void* context)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(acquire_func, "%p"),
+        LONGTAIL_LOGFIELD(release_func, "%p"),
+        LONGTAIL_LOGFIELD(context, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    Longtail_DisposeScratchArenaPool();
+    if (acquire_func == 0 || release_func == 0)
+    {
+        Longtail_AcquireScratchArena_private = Longtail_DefaultAcquireScratchArena;
+        Longtail_ReleaseScratchArena_private = Longtail_DefaultReleaseScratchArena;
+        Longtail_ScratchArenaContext_private = 0;
+        return;
+    }
+    Longtail_AcquireScratchArena_private = acquire_func;
+    Longtail_ReleaseScratchArena_private = release_func;
+    Longtail_ScratchArenaContext_private = context;
+}
+
+struct ScratchScope
+{
+    struct Longtail_ScratchArena* m_Arena;
+    const char* m_Operation;
+    size_t m_Mark;
+    size_t m_OuterPeakUsage;
+};
+
+static struct Longtail_ScratchArena* AcquireScratchScope(struct ScratchScope* scope, const char* operation, size_t size_hint)
+{
+    struct Longtail_ScratchArena* arena = Longtail_AcquireScratchArena_private(Longtail_ScratchArenaContext_private, operation, size_hint);
+    if (!arena)
+    {
+        return 0;
+    }
+    scope->m_Arena = arena;
+    scope->m_Operation = operation;
+    scope->m_Mark = Longtail_ScratchArena_GetMark(arena);
+    scope->m_OuterPeakUsage = Longtail_ScratchArena_GetPeakUsage(arena);
+    Longtail_ScratchArena_ResetPeakUsage(arena);
+    return arena;
+}
+
+static void ReleaseScratchScope(struct ScratchScope* scope)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(scope, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    struct Longtail_ScratchArena* arena = scope->m_Arena;
+    size_t peak_usage = Longtail_ScratchArena_GetPeakUsage(arena) - scope->m_Mark;
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "%s used %" PRIu64 " bytes of scratch memory", scope->m_Operation, (uint64_t)peak_usage)
+    if (arena->m_PeakUsage < scope->m_OuterPeakUsage)
+    {
+        arena->m_PeakUsage = scope->m_OuterPeakUsage;
+    }
+    Longtail_ScratchArena_ResetToMark(arena, scope->m_Mark);
+    Longtail_ReleaseScratchArena_private(Longtail_ScratchArenaContext_private, scope->m_Operation, arena, peak_usage);
+}
+
 #if !defined(LONGTAIL_LOG_LEVEL)
     #define LONGTAIL_LOG_LEVEL   LONGTAIL_LOG_LEVEL_WARNING
 #endif
@@ -2310,6 +2640,187 @@ static int DynamicChunking(void* context, uint32_t job_id, int detected_error)
     return err;
 }
 
+// Large assets are split into several HashJob parts that are chunked in parallel, each part starting from
+// its own start offset. A content defined chunk only depends on where it starts so once a serial pass lands
+// on a chunk start of a part, the rest of that part matches the serial pass. At each seam we chunk serially
+// from the last known good boundary until we land on a chunk start of the part, the chunks of the part
+// from there on are kept as is. The result is identical to chunking the asset in one go.
+struct ResyncChunkSeamsJob
+{
+    struct HashJob* m_Parts;
+    uint32_t m_PartCount;
+    uint64_t m_AssetSize;
+};
+
+static int ResyncChunkSeams(void* context, uint32_t job_id, int detected_error)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(job_id, "%u"),
+        LONGTAIL_LOGFIELD(detected_error, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return EINVAL)
+    struct ResyncChunkSeamsJob* job = (struct ResyncChunkSeamsJob*)context;
+
+    if (detected_error)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "ResyncChunkSeams aborted due to previous error %d", detected_error)
+        return 0;
+    }
+
+    struct HashJob* parts = job->m_Parts;
+    struct Longtail_StorageAPI* storage_api = parts[0].m_StorageAPI;
+    struct Longtail_HashAPI* hash_api = parts[0].m_HashAPI;
+    struct Longtail_ChunkerAPI* chunker_api = parts[0].m_ChunkerAPI;
+
+    uint32_t chunker_min_size;
+    int err = chunker_api->GetMinChunkSize(chunker_api, &chunker_min_size);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "chunker_api->GetMinChunkSize() failed with %d", err)
+        return err;
+    }
+    uint32_t min_chunk_size = MIN_CHUNKER_SIZE(chunker_min_size, parts[0].m_TargetChunkSize);
+    uint32_t avg_chunk_size = AVG_CHUNKER_SIZE(chunker_min_size, parts[0].m_TargetChunkSize);
+    uint32_t max_chunk_size = MAX_CHUNKER_SIZE(chunker_min_size, parts[0].m_TargetChunkSize);
+
+    char* path = storage_api->ConcatPath(storage_api, parts[0].m_RootPath, parts[0].m_Path);
+    if (!path)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->ConcatPath() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    Longtail_StorageAPI_HOpenFile file_handle;
+    err = storage_api->OpenReadFile(storage_api, path, &file_handle);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+        Longtail_Free(path);
+        return err;
+    }
+
+    TLongtail_Hash* chunk_hashes = 0;
+    uint32_t* chunk_sizes = 0;
+    Longtail_ChunkerAPI_HChunker chunker = 0;
+    struct StorageChunkFeederContext feeder_context;
+
+    uint64_t asset_size = job->m_AssetSize;
+    uint64_t pos = 0;
+    uint32_t part = 0;
+    uint32_t spec = 0;
+    uint64_t spec_start = 0;
+    while (pos < asset_size)
+    {
+        while (pos >= parts[part].m_StartRange + parts[part].m_SizeRange)
+        {
+            ++part;
+            spec = 0;
+            spec_start = parts[part].m_StartRange;
+        }
+        const struct HashJob* p = &parts[part];
+        uint32_t spec_count = *p->m_AssetChunkCount;
+        while (spec < spec_count && spec_start < pos)
+        {
+            spec_start += p->m_ChunkSizes[spec++];
+        }
+
+        // The last chunk of a part that is not the last part is cut by the end of the part, not by the chunker
+        uint32_t sync_end = (part + 1 == job->m_PartCount) ? spec_count : (spec_count > 0 ? spec_count - 1 : 0);
+        if (spec < sync_end && spec_start == pos)
+        {
+            if (chunker)
+            {
+                chunker_api->DisposeChunker(chunker_api, chunker);
+                chunker = 0;
+            }
+            for (; spec < sync_end; ++spec)
+            {
+                arrput(chunk_hashes, p->m_ChunkHashes[spec]);
+                arrput(chunk_sizes, p->m_ChunkSizes[spec]);
+                spec_start += p->m_ChunkSizes[spec];
+            }
+            pos = spec_start;
+            continue;
+        }
+
+        if (!chunker)
+        {
+            err = chunker_api->CreateChunker(chunker_api, min_chunk_size, avg_chunk_size, max_chunk_size, &chunker);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "chunker_api->CreateChunker() failed with %d", err)
+                chunker = 0;
+                break;
+            }
+            feeder_context.m_StorageAPI = storage_api;
+            feeder_context.m_AssetFile = file_handle;
+            feeder_context.m_AssetPath = path;
+            feeder_context.m_StartRange = pos;
+            feeder_context.m_Size = asset_size - pos;
+            feeder_context.m_Offset = 0;
+        }
+
+        struct Longtail_Chunker_ChunkRange chunk_range;
+        err = chunker_api->NextChunk(chunker_api, chunker, StorageChunkFeederFunc, &feeder_context, &chunk_range);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "chunker_api->NextChunk() failed with %d", err)
+            break;
+        }
+        TLongtail_Hash chunk_hash;
+        err = hash_api->HashBuffer(hash_api, chunk_range.len, (void*)chunk_range.buf, &chunk_hash);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "hash_api->HashBuffer() failed with %d", err)
+            break;
+        }
+        arrput(chunk_hashes, chunk_hash);
+        arrput(chunk_sizes, chunk_range.len);
+        pos += chunk_range.len;
+    }
+    if (chunker)
+    {
+        chunker_api->DisposeChunker(chunker_api, chunker);
+    }
+    storage_api->CloseFile(storage_api, file_handle);
+    Longtail_Free(path);
+
+    if (err == 0)
+    {
+        uint32_t chunk_count = (uint32_t)arrlen(chunk_hashes);
+        void* output_mem = Longtail_Alloc("ResyncChunkSeams", (sizeof(TLongtail_Hash) + sizeof(uint32_t)) * (chunk_count + 1));
+        if (!output_mem)
+        {
+            err = ENOMEM;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", err)
+        }
+        else
+        {
+            TLongtail_Hash* output_chunk_hashes = (TLongtail_Hash*)output_mem;
+            uint32_t* output_chunk_sizes = (uint32_t*)&output_chunk_hashes[chunk_count + 1];
+            memcpy(output_chunk_hashes, chunk_hashes, sizeof(TLongtail_Hash) * chunk_count);
+            memcpy(output_chunk_sizes, chunk_sizes, sizeof(uint32_t) * chunk_count);
+            for (uint32_t p = 0; p < job->m_PartCount; ++p)
+            {
+                if (parts[p].m_ChunkHashes != parts[p].m_InlineChunkHashes)
+                {
+                    Longtail_Free(parts[p].m_ChunkHashes);
+                }
+                parts[p].m_ChunkHashes = parts[p].m_InlineChunkHashes;
+                parts[p].m_ChunkSizes = parts[p].m_InlineChunkSizes;
+                *parts[p].m_AssetChunkCount = 0;
+            }
+            parts[0].m_ChunkHashes = output_chunk_hashes;
+            parts[0].m_ChunkSizes = output_chunk_sizes;
+            *parts[0].m_AssetChunkCount = chunk_count;
+        }
+    }
+    arrfree(chunk_sizes);
+    arrfree(chunk_hashes);
+    return err;
+}
+
 struct ChunkAssetsData {
     uint32_t m_ChunkCount;
     TLongtail_Hash* m_ChunkHashes;
@@ -2395,12 +2906,14 @@ static int ChunkAssets(
 
     uint64_t max_hash_size = ((uint64_t)target_chunk_size) * 1024;
     uint32_t job_count = 0;
+    uint32_t resync_job_count = 0;
 
     for (uint32_t asset_index = 0; asset_index < asset_count; ++asset_index)
     {
         uint64_t asset_size = file_infos->m_Sizes[asset_index];
         uint64_t asset_part_count = 1 + (asset_size / max_hash_size);
         job_count += (uint32_t)asset_part_count;
+        resync_job_count += (asset_part_count > 1) ? 1 : 0;
     }
 
     if (job_count == 0)
@@ -2410,26 +2923,44 @@ static int ChunkAssets(
 
     size_t work_mem_size = (sizeof(uint32_t) * job_count) +
         (sizeof(struct HashJob) * job_count) +
+        (sizeof(struct ResyncChunkSeamsJob) * resync_job_count) +
         (sizeof(Longtail_JobAPI_JobFunc) * job_count) +
         (sizeof(void*) * job_count);
-    void* work_mem = Longtail_Alloc("ChunkAssets", work_mem_size);
+    struct ScratchScope scratch;
+    struct Longtail_ScratchArena* scratch_arena = AcquireScratchScope(&scratch, "ChunkAssets", work_mem_size);
+    if (!scratch_arena)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "AcquireScratchScope() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    void* work_mem = Longtail_ScratchArena_Alloc(scratch_arena, work_mem_size);
     if (!work_mem)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_Alloc() failed with %d", ENOMEM)
+        ReleaseScratchScope(&scratch);
         return ENOMEM;
     }
 
     uint32_t* tmp_job_chunk_counts = (uint32_t*)work_mem;
     struct HashJob* tmp_hash_jobs = (struct HashJob*)&tmp_job_chunk_counts[job_count];
-    Longtail_JobAPI_JobFunc* funcs = (Longtail_JobAPI_JobFunc*)&tmp_hash_jobs[job_count];
+    struct ResyncChunkSeamsJob* tmp_resync_jobs = (struct ResyncChunkSeamsJob*)&tmp_hash_jobs[job_count];
+    Longtail_JobAPI_JobFunc* funcs = (Longtail_JobAPI_JobFunc*)&tmp_resync_jobs[resync_job_count];
     void** ctxs = (void**)&funcs[job_count];
 
     uint32_t jobs_prepared = 0;
+    uint32_t resync_jobs_prepared = 0;
     uint64_t chunks_offset = 0;
     for (uint32_t asset_index = 0; asset_index < asset_count; ++asset_index)
     {
         uint64_t asset_size = file_infos->m_Sizes[asset_index];
         uint64_t asset_part_count = 1 + (asset_size / max_hash_size);
+        if (asset_part_count > 1)
+        {
+            struct ResyncChunkSeamsJob* resync_job = &tmp_resync_jobs[resync_jobs_prepared++];
+            resync_job->m_Parts = &tmp_hash_jobs[jobs_prepared];
+            resync_job->m_PartCount = (uint32_t)asset_part_count;
+            resync_job->m_AssetSize = asset_size;
+        }
 
         for (uint64_t job_part = 0; job_part < asset_part_count; ++job_part)
         {
@@ -2470,21 +3001,21 @@ static int ChunkAssets(
                 Longtail_Free(tmp_hash_jobs[i].m_ChunkHashes);
             }
         }
-        Longtail_Free(work_mem);
+        ReleaseScratchScope(&scratch);
         return err;
     }
 
+    if (resync_job_count > 0)
     {
-        uint32_t built_chunk_count = 0;
-        for (uint32_t i = 0; i < job_count; ++i)
+        for (uint32_t r = 0; r < resync_job_count; ++r)
         {
-            built_chunk_count += *tmp_hash_jobs[i].m_AssetChunkCount;
+            funcs[r] = ResyncChunkSeams;
+            ctxs[r] = &tmp_resync_jobs[r];
         }
-
-        struct ChunkAssetsData* cad = AllocChunkAssetsData(built_chunk_count);
-        if (!cad)
+        err = Longtail_RunJobsBatched(job_api, 0, optional_cancel_api, optional_cancel_token, resync_job_count, funcs, ctxs, &jobs_submitted);
+        if (err)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "AllocChunkAssetsData() failed with %d", ENOMEM)
+            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "Longtail_RunJobsBatched() failed with %d", err)
             for (uint32_t i = 0; i < job_count; ++i)
             {
                 if (tmp_hash_jobs[i].m_ChunkHashes != tmp_hash_jobs[i].m_InlineChunkHashes)
@@ -2492,8 +3023,31 @@ static int ChunkAssets(
                     Longtail_Free(tmp_hash_jobs[i].m_ChunkHashes);
                 }
             }
-            Longtail_Free(work_mem);
-            return ENOMEM;
+            ReleaseScratchScope(&scratch);
+            return err;
+        }
+    }
+
+    {
+        uint32_t built_chunk_count = 0;
+        for (uint32_t i = 0; i < job_count; ++i)
+        {
+            built_chunk_count += *tmp_hash_jobs[i].m_AssetChunkCount;
+        }
+
+        struct ChunkAssetsData* cad = AllocChunkAssetsData(built_chunk_count);
+        if (!cad)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "AllocChunkAssetsData() failed with %d", ENOMEM)
+            for (uint32_t i = 0; i < job_count; ++i)
+            {
+                if (tmp_hash_jobs[i].m_ChunkHashes != tmp_hash_jobs[i].m_InlineChunkHashes)
+                {
+                    Longtail_Free(tmp_hash_jobs[i].m_ChunkHashes);
+                }
+            }
+            ReleaseScratchScope(&scratch);
+            return ENOMEM;
         }
 
         uint32_t chunk_offset = 0;
@@ -2531,7 +3085,7 @@ static int ChunkAssets(
                         Longtail_Free(tmp_hash_jobs[i].m_ChunkHashes);
                     }
                 }
-                Longtail_Free(work_mem);
+                ReleaseScratchScope(&scratch);
                 return err;
             }
         }
@@ -2545,7 +3099,7 @@ static int ChunkAssets(
             Longtail_Free(tmp_hash_jobs[i].m_ChunkHashes);
         }
     }
-    Longtail_Free(work_mem);
+    ReleaseScratchScope(&scratch);
     return err;
 }
 
@@ -2805,6 +3359,62 @@ int Longtail_BuildVersionIndex(
     return 0;
 }
 
+static const char* CompressedContentExtensions[] = {
+    "png", "jpg", "jpeg", "webp", "ktx2",
+    "ogg", "opus", "mp3", "flac",
+    "mp4", "webm", "bk2", "bik",
+    "zip", "7z", "gz", "xz", "zst", "rar"
+};
+
+static int IsCompressedContentPath(const char* path)
+{
+    const char* extension = strrchr(path, '.');
+    if (extension == 0 || strchr(extension, '/') != 0)
+    {
+        return 0;
+    }
+    ++extension;
+    for (uint32_t e = 0; e < sizeof(CompressedContentExtensions) / sizeof(CompressedContentExtensions[0]); ++e)
+    {
+        const char* c = CompressedContentExtensions[e];
+        const char* p = extension;
+        while (*c && *p && tolower((unsigned char)*p) == *c)
+        {
+            ++c;
+            ++p;
+        }
+        if (*c == 0 && *p == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int Longtail_GetContentTypeAssetTags(
+    const struct Longtail_FileInfos* file_infos,
+    uint32_t default_tag,
+    uint32_t compressed_content_tag,
+    uint32_t* out_asset_tags)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(file_infos, "%p"),
+        LONGTAIL_LOGFIELD(default_tag, "%u"),
+        LONGTAIL_LOGFIELD(compressed_content_tag, "%u"),
+        LONGTAIL_LOGFIELD(out_asset_tags, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, file_infos != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, file_infos->m_Count == 0 || out_asset_tags != 0, return EINVAL)
+
+    for (uint32_t f = 0; f < file_infos->m_Count; ++f)
+    {
+        const char* path = &file_infos->m_PathData[file_infos->m_PathStartOffsets[f]];
+        out_asset_tags[f] = (!IsDirPath(path) && IsCompressedContentPath(path)) ? compressed_content_tag : default_tag;
+    }
+    return 0;
+}
+
 int Longtail_CreateVersionIndex(
     struct Longtail_StorageAPI* storage_api,
     struct Longtail_HashAPI* hash_api,
@@ -3412,450 +4022,1072 @@ int Longtail_MergeVersionIndex(
     return 0;
 }
 
-int Longtail_WriteVersionIndexToBuffer(
-    const struct Longtail_VersionIndex* version_index,
-    void** out_buffer,
-    size_t* out_size)
+//////////////////////////////// Compact index encoding
+
+// A compact index starts with a fixed header, the counts of the index and a section table:
+//   uint32_t magic, uint32_t format, uint32_t compression_type, uint32_t reserved,
+//   uint32_t header_value_count, uint32_t section_count
+//   uint64_t header_values[header_value_count]
+//   { uint64_t offset, uint64_t stored_size, uint64_t encoded_size } sections[section_count]
+// Each section encodes one array of the index and is compressed on its own with the compression type
+// in the header, a section with stored_size equal to encoded_size is stored uncompressed. Sections are
+// decoded independently of each other so a reader can read and decode only the sections it needs.
+//
+// Format 1 is still read. It has no section table, the header is followed by one payload that is compressed
+// as a whole and holds the varint encoded header values, the varint encoded section sizes and the sections:
+//   uint32_t magic, uint32_t format, uint32_t compression_type, uint32_t reserved, uint64_t payload_size
+
+#define LONGTAIL_COMPACT_VERSION_INDEX_MAGIC    0x4349564cu // "LVIC"
+#define LONGTAIL_COMPACT_STORE_INDEX_MAGIC      0x4349534cu // "LSIC"
+#define LONGTAIL_COMPACT_INDEX_FORMAT_1         1u
+#define LONGTAIL_COMPACT_INDEX_FORMAT_2         2u
+#define LONGTAIL_COMPACT_INDEX_HEADER_SIZE      (sizeof(uint32_t) * 6)
+#define LONGTAIL_COMPACT_INDEX_FORMAT_1_HEADER_SIZE (sizeof(uint32_t) * 4 + sizeof(uint64_t))
+#define LONGTAIL_COMPACT_INDEX_MAX_SECTIONS     16u
+
+enum CompactSectionType
+{
+    COMPACT_SECTION_RAW_HASH,   // Hashes stored as is, they do not compress
+    COMPACT_SECTION_VARINT32,   // Sizes and counts
+    COMPACT_SECTION_VARINT64,   // Asset sizes
+    COMPACT_SECTION_DELTA32,    // Zig-zag varint delta to the previous value, for indexes and offsets
+    COMPACT_SECTION_RLE32,      // Runs of value and count, for tags
+    COMPACT_SECTION_RLE16,      // Runs of value and count, for permissions
+    COMPACT_SECTION_PATHS       // Front coded paths, shared prefix length with the previous path and the suffix
+};
+
+struct CompactSection
 {
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(version_index, "%p"),
-        LONGTAIL_LOGFIELD(out_buffer, "%p"),
-        LONGTAIL_LOGFIELD(out_size, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_buffer != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_size != 0, return EINVAL)
+    uint32_t m_Type;
+    uint32_t m_Count;
+    const void* m_Source;
+    const char* m_SourceNameData;
+    void* m_Target;
+    uint32_t* m_TargetNameOffsets;
+    uint32_t m_TargetNameDataSize;
+    const uint8_t* m_Data;
+    size_t m_DataSize;
+    int m_Err;
+    size_t m_EncodedSize;
+    struct Longtail_CompressionAPI* m_CompressionAPI;
+};
 
-    size_t index_data_size = Longtail_GetVersionIndexDataSize(*version_index->m_AssetCount, *version_index->m_ChunkCount, *version_index->m_AssetChunkIndexCount, version_index->m_NameDataSize);
-    *out_buffer = Longtail_Alloc("WriteVersionIndexToBuffer", index_data_size);
-    if (!(*out_buffer))
+static uint8_t* CompactWriteVarint(uint8_t* p, uint64_t value)
+{
+    while (value >= 0x80)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return ENOMEM;
+        *p++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+static const uint8_t* CompactReadVarint(const uint8_t* p, const uint8_t* end, uint64_t* out_value)
+{
+    uint64_t value = 0;
+    uint32_t shift = 0;
+    while (p < end && shift < 64)
+    {
+        uint8_t b = *p++;
+        value |= ((uint64_t)(b & 0x7f)) << shift;
+        if ((b & 0x80) == 0)
+        {
+            *out_value = value;
+            return p;
+        }
+        shift += 7;
     }
-    memcpy(*out_buffer, version_index->m_Version, index_data_size);
-    *out_size = index_data_size;
     return 0;
 }
 
-int Longtail_WriteVersionIndex(
-    struct Longtail_StorageAPI* storage_api,
-    struct Longtail_VersionIndex* version_index,
-    const char* path)
+static uint64_t CompactZigZag(int64_t value)
 {
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(storage_api, "%p"),
-        LONGTAIL_LOGFIELD(version_index, "%p"),
-        LONGTAIL_LOGFIELD(path, "%s")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
 
-    size_t index_data_size = Longtail_GetVersionIndexDataSize(*version_index->m_AssetCount, *version_index->m_ChunkCount, *version_index->m_AssetChunkIndexCount, version_index->m_NameDataSize);
+static int64_t CompactUnZigZag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
 
-    int err = EnsureParentPathExists(storage_api, path);
-    if (err)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed with %d", err)
-        return err;
-    }
-    Longtail_StorageAPI_HOpenFile file_handle;
-    err = storage_api->OpenWriteFile(storage_api, path, 0, &file_handle);
-    if (err)
+static uint32_t CompactPathLength(const struct CompactSection* section, uint32_t index)
+{
+    return (uint32_t)strlen(&section->m_SourceNameData[((const uint32_t*)section->m_Source)[index]]);
+}
+
+static size_t CompactSection_GetMaxEncodedSize(const struct CompactSection* section)
+{
+    size_t count = section->m_Count;
+    switch (section->m_Type)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenWriteFile) failed with %d",err)
-        return err;
+        case COMPACT_SECTION_RAW_HASH:
+            return sizeof(TLongtail_Hash) * count;
+        case COMPACT_SECTION_VARINT32:
+        case COMPACT_SECTION_DELTA32:
+            return 5 * count;
+        case COMPACT_SECTION_VARINT64:
+            return 10 * count;
+        case COMPACT_SECTION_RLE32:
+            return 10 * count;
+        case COMPACT_SECTION_RLE16:
+            return 8 * count;
+        case COMPACT_SECTION_PATHS:
+        {
+            size_t size = 10 * count;
+            for (uint32_t i = 0; i < section->m_Count; ++i)
+            {
+                size += CompactPathLength(section, i);
+            }
+            return size;
+        }
     }
+    return 0;
+}
 
-    err = storage_api->Write(storage_api, file_handle, 0, index_data_size, version_index->m_Version);
-    if (err)
+static uint8_t* CompactSection_Encode(const struct CompactSection* section, uint8_t* p)
+{
+    uint32_t count = section->m_Count;
+    switch (section->m_Type)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Write() failed with %d", err)
-        storage_api->CloseFile(storage_api, file_handle);
-        file_handle = 0;
-        return err;
+        case COMPACT_SECTION_RAW_HASH:
+            memcpy(p, section->m_Source, sizeof(TLongtail_Hash) * count);
+            return p + sizeof(TLongtail_Hash) * count;
+        case COMPACT_SECTION_VARINT32:
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                p = CompactWriteVarint(p, ((const uint32_t*)section->m_Source)[i]);
+            }
+            return p;
+        case COMPACT_SECTION_VARINT64:
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                p = CompactWriteVarint(p, ((const uint64_t*)section->m_Source)[i]);
+            }
+            return p;
+        case COMPACT_SECTION_DELTA32:
+        {
+            int64_t previous = 0;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                int64_t value = ((const uint32_t*)section->m_Source)[i];
+                p = CompactWriteVarint(p, CompactZigZag(value - previous));
+                previous = value;
+            }
+            return p;
+        }
+        case COMPACT_SECTION_RLE32:
+        case COMPACT_SECTION_RLE16:
+        {
+            uint32_t i = 0;
+            while (i < count)
+            {
+                uint32_t value = section->m_Type == COMPACT_SECTION_RLE32 ? ((const uint32_t*)section->m_Source)[i] : ((const uint16_t*)section->m_Source)[i];
+                uint32_t run = 1;
+                while (i + run < count &&
+                    value == (section->m_Type == COMPACT_SECTION_RLE32 ? ((const uint32_t*)section->m_Source)[i + run] : ((const uint16_t*)section->m_Source)[i + run]))
+                {
+                    ++run;
+                }
+                p = CompactWriteVarint(p, value);
+                p = CompactWriteVarint(p, run);
+                i += run;
+            }
+            return p;
+        }
+        case COMPACT_SECTION_PATHS:
+        {
+            const char* previous = "";
+            uint32_t previous_length = 0;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const char* path = &section->m_SourceNameData[((const uint32_t*)section->m_Source)[i]];
+                uint32_t length = (uint32_t)strlen(path);
+                uint32_t prefix = 0;
+                while (prefix < length && prefix < previous_length && path[prefix] == previous[prefix])
+                {
+                    ++prefix;
+                }
+                p = CompactWriteVarint(p, prefix);
+                p = CompactWriteVarint(p, length - prefix);
+                memcpy(p, &path[prefix], length - prefix);
+                p += length - prefix;
+                previous = path;
+                previous_length = length;
+            }
+            return p;
+        }
     }
-
-    storage_api->CloseFile(storage_api, file_handle);
-    file_handle = 0;
-
-    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "wrote %" PRIu64 " bytes", index_data_size)
-
-    return 0;
+    return p;
 }
 
-int Longtail_ReadVersionIndexFromBuffer(
-    const void* buffer,
-    size_t size,
-    struct Longtail_VersionIndex** out_version_index)
+static int CompactSection_DecodeData(struct CompactSection* section, const uint8_t* data, size_t data_size)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(buffer, "%p"),
-        LONGTAIL_LOGFIELD(size, "%" PRIu64),
-        LONGTAIL_LOGFIELD(out_version_index, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-    LONGTAIL_VALIDATE_INPUT(ctx, buffer != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, size != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_version_index != 0, return EINVAL)
+        LONGTAIL_LOGFIELD(section, "%p"),
+        LONGTAIL_LOGFIELD(data, "%p"),
+        LONGTAIL_LOGFIELD(data_size, "%" PRIu64)
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 
-    size_t version_index_size = sizeof(struct Longtail_VersionIndex) + size;
-    struct Longtail_VersionIndex* version_index = (struct Longtail_VersionIndex*)Longtail_Alloc("ReadVersionIndexFromBuffer", version_index_size);
-    if (!version_index)
+    const uint8_t* p = data;
+    const uint8_t* end = p + data_size;
+    uint32_t count = section->m_Count;
+    uint64_t value = 0;
+    switch (section->m_Type)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return ENOMEM;
+        case COMPACT_SECTION_RAW_HASH:
+            if (data_size != sizeof(TLongtail_Hash) * count)
+            {
+                return EBADF;
+            }
+            memcpy(section->m_Target, p, data_size);
+            return 0;
+        case COMPACT_SECTION_VARINT32:
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                p = CompactReadVarint(p, end, &value);
+                if (p == 0 || value > 0xffffffffu)
+                {
+                    return EBADF;
+                }
+                ((uint32_t*)section->m_Target)[i] = (uint32_t)value;
+            }
+            break;
+        case COMPACT_SECTION_VARINT64:
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                p = CompactReadVarint(p, end, &value);
+                if (p == 0)
+                {
+                    return EBADF;
+                }
+                ((uint64_t*)section->m_Target)[i] = value;
+            }
+            break;
+        case COMPACT_SECTION_DELTA32:
+        {
+            int64_t previous = 0;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                p = CompactReadVarint(p, end, &value);
+                if (p == 0)
+                {
+                    return EBADF;
+                }
+                previous += CompactUnZigZag(value);
+                if (previous < 0 || previous > 0xffffffffll)
+                {
+                    return EBADF;
+                }
+                ((uint32_t*)section->m_Target)[i] = (uint32_t)previous;
+            }
+            break;
+        }
+        case COMPACT_SECTION_RLE32:
+        case COMPACT_SECTION_RLE16:
+        {
+            uint32_t i = 0;
+            while (i < count)
+            {
+                uint64_t run = 0;
+                p = CompactReadVarint(p, end, &value);
+                p = p ? CompactReadVarint(p, end, &run) : 0;
+                if (p == 0 || run == 0 || run > (count - i) ||
+                    value > (section->m_Type == COMPACT_SECTION_RLE32 ? 0xffffffffu : 0xffffu))
+                {
+                    return EBADF;
+                }
+                for (uint32_t r = 0; r < (uint32_t)run; ++r)
+                {
+                    if (section->m_Type == COMPACT_SECTION_RLE32)
+                    {
+                        ((uint32_t*)section->m_Target)[i + r] = (uint32_t)value;
+                    }
+                    else
+                    {
+                        ((uint16_t*)section->m_Target)[i + r] = (uint16_t)value;
+                    }
+                }
+                i += (uint32_t)run;
+            }
+            break;
+        }
+        case COMPACT_SECTION_PATHS:
+        {
+            char* name_data = (char*)section->m_Target;
+            uint32_t name_data_size = section->m_TargetNameDataSize;
+            uint32_t offset = 0;
+            uint32_t previous_offset = 0;
+            uint32_t previous_length = 0;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                uint64_t prefix = 0;
+                uint64_t suffix = 0;
+                p = CompactReadVarint(p, end, &prefix);
+                p = p ? CompactReadVarint(p, end, &suffix) : 0;
+                if (p == 0 || prefix > previous_length || suffix > (uint64_t)(end - p) ||
+                    (uint64_t)offset + prefix + suffix + 1 > name_data_size)
+                {
+                    return EBADF;
+                }
+                memmove(&name_data[offset], &name_data[previous_offset], (size_t)prefix);
+                memcpy(&name_data[offset + prefix], p, (size_t)suffix);
+                p += suffix;
+                name_data[offset + prefix + suffix] = '\0';
+                section->m_TargetNameOffsets[i] = offset;
+                previous_offset = offset;
+                previous_length = (uint32_t)(prefix + suffix);
+                offset += previous_length + 1;
+            }
+            if (offset != name_data_size)
+            {
+                return EBADF;
+            }
+            break;
+        }
+        default:
+            return EBADF;
     }
-    memcpy(&version_index[1], buffer, size);
-    int err = InitVersionIndexFromData(version_index, &version_index[1], size);
-    if (err)
+    if (p != end)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "InitVersionIndexFromData() failed with %d", err)
-        Longtail_Free(version_index);
-        return err;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Compact index section has %" PRIu64 " bytes of trailing data", (uint64_t)(end - p))
+        return EBADF;
     }
-    *out_version_index = version_index;
     return 0;
 }
 
-int Longtail_ReadVersionIndex(
-    struct Longtail_StorageAPI* storage_api,
-    const char* path,
-    struct Longtail_VersionIndex** out_version_index)
+static int CompactSection_Decode(struct CompactSection* section)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(storage_api, "%p"),
-        LONGTAIL_LOGFIELD(path, "%s"),
-        LONGTAIL_LOGFIELD(out_version_index, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_version_index != 0, return EINVAL)
+        LONGTAIL_LOGFIELD(section, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 
-    Longtail_StorageAPI_HOpenFile file_handle;
-    int err = storage_api->OpenReadFile(storage_api, path, &file_handle);
-    if (err != 0)
+    if (section->m_DataSize == section->m_EncodedSize)
     {
-        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_WARNING : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
-        return err;
+        return CompactSection_DecodeData(section, section->m_Data, section->m_DataSize);
     }
-    uint64_t version_index_data_size;
-    err = storage_api->GetSize(storage_api, file_handle, &version_index_data_size);
-    if (err != 0)
+    if (section->m_CompressionAPI == 0)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetSize() failed with %d", err)
-        return err;
+        return EBADF;
     }
-    size_t version_index_size = version_index_data_size + sizeof(struct Longtail_VersionIndex);
-    struct Longtail_VersionIndex* version_index = (struct Longtail_VersionIndex*)Longtail_Alloc("ReadVersionIndex", version_index_size);
-    if (!version_index)
+    void* encoded_data = Longtail_Alloc("CompactSection_Decode", section->m_EncodedSize);
+    if (!encoded_data)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        Longtail_Free(version_index);
-        storage_api->CloseFile(storage_api, file_handle);
-        return err;
+        return ENOMEM;
     }
-    err = storage_api->Read(storage_api, file_handle, 0, version_index_data_size, &version_index[1]);
-    if (err)
+    size_t encoded_size = 0;
+    int err = section->m_CompressionAPI->Decompress(section->m_CompressionAPI, (const char*)section->m_Data, (char*)encoded_data, section->m_DataSize, section->m_EncodedSize, &encoded_size);
+    if (!err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
-        Longtail_Free(version_index);
-        storage_api->CloseFile(storage_api, file_handle);
-        return err;
+        err = (encoded_size == section->m_EncodedSize) ? CompactSection_DecodeData(section, (const uint8_t*)encoded_data, encoded_size) : EBADF;
     }
-    err = InitVersionIndexFromData(version_index, &version_index[1], version_index_data_size);
-    storage_api->CloseFile(storage_api, file_handle);
-    if (err)
+    Longtail_Free(encoded_data);
+    return err;
+}
+
+static int CompactSectionDecodeJob(void* context, uint32_t job_id, int detected_error)
+{
+    if (detected_error)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "InitVersionIndexFromData() failed with %d", err)
-        Longtail_Free(version_index);
-        return err;
+        return 0;
     }
-
-    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Read version index containing %u assets in %u chunks",
-        *version_index->m_AssetCount, *version_index->m_ChunkCount)
-
-    *out_version_index = version_index;
-
-    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "read %" PRIu64 " bytes", version_index_data_size)
-
-    return 0;
+    struct CompactSection* section = (struct CompactSection*)context;
+    section->m_Err = CompactSection_Decode(section);
+    return section->m_Err;
 }
 
-size_t Longtail_GetBlockIndexDataSize(uint32_t chunk_count)
+static size_t CompactIndex_GetTableSize(uint32_t header_value_count, uint32_t section_count)
 {
-#if defined(LONGTAIL_ASSERTS)
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(chunk_count, "%u")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
-    return
-        sizeof(TLongtail_Hash) +                    // m_BlockHash
-        sizeof(uint32_t) +                          // m_HashIdentifier
-        sizeof(uint32_t) +                          // m_ChunkCount
-        sizeof(uint32_t) +                          // m_Tag
-        (sizeof(TLongtail_Hash) * chunk_count) +    // m_ChunkHashes
-        (sizeof(uint32_t) * chunk_count);           // m_ChunkSizes
+    return LONGTAIL_COMPACT_INDEX_HEADER_SIZE + sizeof(uint64_t) * header_value_count + sizeof(uint64_t) * 3 * section_count;
 }
 
-struct Longtail_BlockIndex* Longtail_InitBlockIndex(void* mem, uint32_t chunk_count)
+// Encodes and compresses the sections and writes them after the header and the section table
+static int CompactIndex_Encode(
+    uint32_t magic,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    uint32_t compression_type,
+    uint32_t header_value_count,
+    const uint64_t* header_values,
+    uint32_t section_count,
+    const struct CompactSection* sections,
+    void** out_buffer,
+    size_t* out_size)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(mem, "%p"),
-        LONGTAIL_LOGFIELD(chunk_count, "%u")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
-    LONGTAIL_VALIDATE_INPUT(ctx, mem != 0, return 0)
-
-    struct Longtail_BlockIndex* block_index = (struct Longtail_BlockIndex*)mem;
-    char* p = (char*)&block_index[1];
-
-    block_index->m_BlockHash = (TLongtail_Hash*)(void*)p;
-    p += sizeof(TLongtail_Hash);
+        LONGTAIL_LOGFIELD(magic, "%x"),
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(compression_type, "%u"),
+        LONGTAIL_LOGFIELD(header_value_count, "%u"),
+        LONGTAIL_LOGFIELD(header_values, "%p"),
+        LONGTAIL_LOGFIELD(section_count, "%u"),
+        LONGTAIL_LOGFIELD(sections, "%p"),
+        LONGTAIL_LOGFIELD(out_buffer, "%p"),
+        LONGTAIL_LOGFIELD(out_size, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    block_index->m_HashIdentifier = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
+    struct Longtail_CompressionAPI* compression_api = 0;
+    uint32_t compression_settings = 0;
+    if (compression_type != 0)
+    {
+        if (optional_compression_registry == 0)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Compression type %u requires a compression registry, failed with %d", compression_type, EINVAL)
+            return EINVAL;
+        }
+        int err = optional_compression_registry->GetCompressionAPI(optional_compression_registry, compression_type, &compression_api, &compression_settings);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "optional_compression_registry->GetCompressionAPI() failed with %d", err)
+            return err;
+        }
+    }
 
-    block_index->m_ChunkCount = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
+    size_t table_size = CompactIndex_GetTableSize(header_value_count, section_count);
+    size_t max_encoded_size = 0;
+    size_t max_stored_size = table_size;
+    for (uint32_t s = 0; s < section_count; ++s)
+    {
+        size_t section_max_size = CompactSection_GetMaxEncodedSize(&sections[s]);
+        max_encoded_size = section_max_size > max_encoded_size ? section_max_size : max_encoded_size;
+        max_stored_size += compression_api ? compression_api->GetMaxCompressedSize(compression_api, compression_settings, section_max_size) : section_max_size;
+    }
 
-    block_index->m_Tag = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
+    uint8_t* encode_buffer = (uint8_t*)Longtail_Alloc("CompactIndex_Encode", max_encoded_size == 0 ? 1 : max_encoded_size);
+    if (!encode_buffer)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    uint8_t* buffer = (uint8_t*)Longtail_Alloc("CompactIndex_Encode", max_stored_size);
+    if (!buffer)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(encode_buffer);
+        return ENOMEM;
+    }
 
-    block_index->m_ChunkHashes = (TLongtail_Hash*)(void*)p;
-    p += sizeof(TLongtail_Hash) * chunk_count;
+    uint32_t header[6] = {magic, LONGTAIL_COMPACT_INDEX_FORMAT_2, compression_type, 0, header_value_count, section_count};
+    memcpy(buffer, header, sizeof(header));
+    memcpy(&buffer[sizeof(header)], header_values, sizeof(uint64_t) * header_value_count);
+    uint64_t* section_table = (uint64_t*)(void*)&buffer[sizeof(header) + sizeof(uint64_t) * header_value_count];
 
-    block_index->m_ChunkSizes = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * chunk_count;
+    size_t offset = table_size;
+    for (uint32_t s = 0; s < section_count; ++s)
+    {
+        size_t encoded_size = (size_t)(CompactSection_Encode(&sections[s], encode_buffer) - encode_buffer);
+        size_t stored_size = encoded_size;
+        if (compression_api && encoded_size > 0)
+        {
+            size_t max_compressed_size = max_stored_size - offset;
+            int err = compression_api->Compress(compression_api, compression_settings, (const char*)encode_buffer, (char*)&buffer[offset], encoded_size, max_compressed_size, &stored_size);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "compression_api->Compress() failed with %d", err)
+                Longtail_Free(buffer);
+                Longtail_Free(encode_buffer);
+                return err;
+            }
+        }
+        if (stored_size >= encoded_size)
+        {
+            // Hashes do not compress, store the section as is
+            memcpy(&buffer[offset], encode_buffer, encoded_size);
+            stored_size = encoded_size;
+        }
+        uint64_t entry[3] = {offset, stored_size, encoded_size};
+        memcpy(&section_table[s * 3], entry, sizeof(entry));
+        offset += stored_size;
+    }
+    Longtail_Free(encode_buffer);
 
-    return block_index;
+    *out_buffer = buffer;
+    *out_size = offset;
+    return 0;
 }
 
-struct Longtail_BlockIndex* Longtail_CopyBlockIndex(struct Longtail_BlockIndex* block_index)
+static int IsCompactIndex(uint32_t magic, const void* buffer, size_t size)
 {
-    uint32_t chunk_count = *block_index->m_ChunkCount;
-    size_t block_index_size = Longtail_GetBlockIndexSize(chunk_count);
-    void* mem = Longtail_Alloc("Longtail_CopyBlockIndex", block_index_size);
-    struct Longtail_BlockIndex* copy_block_index = Longtail_InitBlockIndex(mem, chunk_count);
-    *copy_block_index->m_BlockHash = *block_index->m_BlockHash;
-    *copy_block_index->m_HashIdentifier = *block_index->m_HashIdentifier;
-    *copy_block_index->m_ChunkCount = *block_index->m_ChunkCount;
-    *copy_block_index->m_Tag = *block_index->m_Tag;
-    memcpy(copy_block_index->m_ChunkHashes, block_index->m_ChunkHashes, sizeof(TLongtail_Hash) * chunk_count);
-    memcpy(copy_block_index->m_ChunkSizes, block_index->m_ChunkSizes, sizeof(uint32_t) * chunk_count);
-    return copy_block_index;
+    uint32_t buffer_magic;
+    if (size < LONGTAIL_COMPACT_INDEX_HEADER_SIZE)
+    {
+        return 0;
+    }
+    memcpy(&buffer_magic, buffer, sizeof(buffer_magic));
+    return buffer_magic == magic;
 }
 
-int Longtail_InitBlockIndexFromData(
-    struct Longtail_BlockIndex* block_index,
-    void* data,
-    uint64_t data_size)
+// Reads the header values and the section table of a compact index, the m_Data of each section is set
+// to its offset from the start of the index
+static int CompactIndex_ReadTable(
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    const void* table,
+    size_t table_size,
+    uint64_t index_size,
+    uint32_t header_value_count,
+    uint64_t* out_header_values,
+    uint32_t section_count,
+    struct CompactSection* out_sections)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(block_index, "%p"),
-        LONGTAIL_LOGFIELD(data, "%p"),
-        LONGTAIL_LOGFIELD(data_size, "%" PRIu64)
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
-    LONGTAIL_VALIDATE_INPUT(ctx, block_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, data != 0, return EINVAL)
-
-    char* p = (char*)data;
-
-    block_index->m_BlockHash = (TLongtail_Hash*)(void*)p;
-    p += sizeof(TLongtail_Hash);
-
-    block_index->m_HashIdentifier = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
-
-    block_index->m_ChunkCount = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
-
-    block_index->m_Tag = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
-
-    uint32_t chunk_count = *block_index->m_ChunkCount;
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(table, "%p"),
+        LONGTAIL_LOGFIELD(table_size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(index_size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(header_value_count, "%u"),
+        LONGTAIL_LOGFIELD(out_header_values, "%p"),
+        LONGTAIL_LOGFIELD(section_count, "%u"),
+        LONGTAIL_LOGFIELD(out_sections, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    size_t block_index_data_size = Longtail_GetBlockIndexDataSize(chunk_count);
-    if (block_index_data_size > data_size)
+    uint32_t header[6];
+    memcpy(header, table, sizeof(header));
+    if (header[1] != LONGTAIL_COMPACT_INDEX_FORMAT_2)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Chunk count results in block index data %" PRIu64 " larger that data size (%" PRIu64 ")", block_index_data_size, data_size)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Unsupported compact index format %u", header[1])
+        return EBADF;
+    }
+    if (header[4] != header_value_count || header[5] != section_count || table_size < CompactIndex_GetTableSize(header_value_count, section_count))
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Compact index has %u values and %u sections, expected %u and %u", header[4], header[5], header_value_count, section_count)
         return EBADF;
     }
 
-    block_index->m_ChunkHashes = (TLongtail_Hash*)(void*)p;
-    p += sizeof(TLongtail_Hash) * chunk_count;
-
-    block_index->m_ChunkSizes = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * chunk_count;
+    struct Longtail_CompressionAPI* compression_api = 0;
+    uint32_t compression_type = header[2];
+    if (compression_type != 0)
+    {
+        if (optional_compression_registry == 0)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Compact index is compressed with type %u and requires a compression registry, failed with %d", compression_type, EINVAL)
+            return EINVAL;
+        }
+        uint32_t compression_settings = 0;
+        int err = optional_compression_registry->GetCompressionAPI(optional_compression_registry, compression_type, &compression_api, &compression_settings);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "optional_compression_registry->GetCompressionAPI() failed with %d", err)
+            return err;
+        }
+    }
 
+    const uint8_t* p = &((const uint8_t*)table)[sizeof(header)];
+    memcpy(out_header_values, p, sizeof(uint64_t) * header_value_count);
+    p += sizeof(uint64_t) * header_value_count;
+    for (uint32_t s = 0; s < section_count; ++s)
+    {
+        uint64_t entry[3];
+        memcpy(entry, &p[s * sizeof(entry)], sizeof(entry));
+        if (entry[0] > index_size || entry[1] > index_size - entry[0] || entry[1] > entry[2] || entry[2] > (uint64_t)((size_t)-1))
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Compact index section %u is outside of the index, failed with %d", s, EBADF)
+            return EBADF;
+        }
+        out_sections[s].m_Data = (const uint8_t*)(uintptr_t)entry[0];
+        out_sections[s].m_DataSize = (size_t)entry[1];
+        out_sections[s].m_EncodedSize = (size_t)entry[2];
+        out_sections[s].m_CompressionAPI = compression_api;
+    }
     return 0;
 }
 
-size_t Longtail_GetBlockIndexSize(uint32_t chunk_count)
+static uint32_t CompactIndex_GetFormat(const void* buffer)
 {
-    size_t block_index_size =
-        sizeof(struct Longtail_BlockIndex) +
-        Longtail_GetBlockIndexDataSize(chunk_count);
-
-    return block_index_size;
+    uint32_t header[2];
+    memcpy(header, buffer, sizeof(header));
+    return header[1];
 }
 
-int Longtail_CreateBlockIndex(
-    struct Longtail_HashAPI* hash_api,
-    uint32_t tag,
-    uint32_t chunk_count,
-    const uint32_t* chunk_indexes,
-    const TLongtail_Hash* chunk_hashes,
-    const uint32_t* chunk_sizes,
-    struct Longtail_BlockIndex** out_block_index)
+// Unwraps the payload of a format 1 compact index and reads the header values and section sizes,
+// *out_payload_mem is allocated if the payload was compressed and must be freed by the caller
+static int CompactIndex_DecodeFormat1(
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    const void* buffer,
+    size_t size,
+    uint32_t header_value_count,
+    uint64_t* out_header_values,
+    uint32_t section_count,
+    struct CompactSection* out_sections,
+    void** out_payload_mem)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(hash_api, "%p"),
-        LONGTAIL_LOGFIELD(tag, "%u"),
-        LONGTAIL_LOGFIELD(chunk_count, "%u"),
-        LONGTAIL_LOGFIELD(chunk_indexes, "%p"),
-        LONGTAIL_LOGFIELD(chunk_sizes, "%p"),
-        LONGTAIL_LOGFIELD(out_block_index, "%p")
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(header_value_count, "%u"),
+        LONGTAIL_LOGFIELD(out_header_values, "%p"),
+        LONGTAIL_LOGFIELD(section_count, "%u"),
+        LONGTAIL_LOGFIELD(out_sections, "%p"),
+        LONGTAIL_LOGFIELD(out_payload_mem, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, hash_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, chunk_indexes != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, chunk_hashes != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, chunk_sizes != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_block_index != 0, return EINVAL)
+    uint32_t header[4];
+    uint64_t payload_size;
+    memcpy(header, buffer, sizeof(header));
+    memcpy(&payload_size, &((const uint8_t*)buffer)[sizeof(header)], sizeof(payload_size));
 
-    size_t block_index_size = Longtail_GetBlockIndexSize(chunk_count);
-    void* mem = Longtail_Alloc("CreateBlockIndex", block_index_size);
-    if (mem == 0)
+    const uint8_t* stored = &((const uint8_t*)buffer)[LONGTAIL_COMPACT_INDEX_FORMAT_1_HEADER_SIZE];
+    size_t stored_size = size - LONGTAIL_COMPACT_INDEX_FORMAT_1_HEADER_SIZE;
+    const uint8_t* payload = stored;
+    *out_payload_mem = 0;
+    uint32_t compression_type = header[2];
+    if (compression_type != 0)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return ENOMEM;
+        if (optional_compression_registry == 0)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Compact index is compressed with type %u and requires a compression registry, failed with %d", compression_type, EINVAL)
+            return EINVAL;
+        }
+        struct Longtail_CompressionAPI* compression_api = 0;
+        uint32_t compression_settings = 0;
+        int err = optional_compression_registry->GetCompressionAPI(optional_compression_registry, compression_type, &compression_api, &compression_settings);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "optional_compression_registry->GetCompressionAPI() failed with %d", err)
+            return err;
+        }
+        if (payload_size > (uint64_t)((size_t)-1))
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Compact index data is invalid, failed with %d", EBADF)
+            return EBADF;
+        }
+        void* payload_mem = Longtail_Alloc("CompactIndex_DecodeFormat1", payload_size == 0 ? 1 : (size_t)payload_size);
+        if (!payload_mem)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+            return ENOMEM;
+        }
+        size_t decompressed_size = 0;
+        err = compression_api->Decompress(compression_api, (const char*)stored, (char*)payload_mem, stored_size, (size_t)payload_size, &decompressed_size);
+        if (err || decompressed_size != payload_size)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "compression_api->Decompress() failed with %d", err ? err : EBADF)
+            Longtail_Free(payload_mem);
+            return err ? err : EBADF;
+        }
+        payload = (const uint8_t*)payload_mem;
+        *out_payload_mem = payload_mem;
+    }
+    else if (stored_size != payload_size)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Compact index data is truncated: %" PRIu64 " != %" PRIu64, (uint64_t)stored_size, payload_size)
+        return EBADF;
     }
 
-    struct Longtail_BlockIndex* block_index = Longtail_InitBlockIndex(mem, chunk_count);
-    for (uint32_t i = 0; i < chunk_count; ++i)
+    const uint8_t* end = payload + payload_size;
+    const uint8_t* p = payload;
+    for (uint32_t h = 0; h < header_value_count && p; ++h)
     {
-        uint32_t chunk_index = chunk_indexes[i];
-        block_index->m_ChunkHashes[i] = chunk_hashes[chunk_index];
-        block_index->m_ChunkSizes[i] = chunk_sizes[chunk_index];
+        p = CompactReadVarint(p, end, &out_header_values[h]);
     }
-    size_t hash_buffer_size = sizeof(TLongtail_Hash) * chunk_count;
-    int err = hash_api->HashBuffer(hash_api, (uint32_t)(hash_buffer_size), (void*)block_index->m_ChunkHashes, block_index->m_BlockHash);
-    if (err != 0)
+    uint64_t section_sizes[LONGTAIL_COMPACT_INDEX_MAX_SECTIONS];
+    for (uint32_t s = 0; s < section_count && p; ++s)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "hash_api->HashBuffer() failed with %d", err)
-        Longtail_Free(mem);
-        return err;
+        p = CompactReadVarint(p, end, &section_sizes[s]);
+    }
+    for (uint32_t s = 0; s < section_count && p; ++s)
+    {
+        if (section_sizes[s] > (uint64_t)(end - p))
+        {
+            p = 0;
+            break;
+        }
+        out_sections[s].m_Data = p;
+        out_sections[s].m_DataSize = (size_t)section_sizes[s];
+        out_sections[s].m_EncodedSize = (size_t)section_sizes[s];
+        out_sections[s].m_CompressionAPI = 0;
+        p += section_sizes[s];
+    }
+    if (p != end)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Compact index data is invalid, failed with %d", EBADF)
+        Longtail_Free(*out_payload_mem);
+        *out_payload_mem = 0;
+        return EBADF;
     }
-    *block_index->m_HashIdentifier = hash_api->GetIdentifier(hash_api);
-    *block_index->m_Tag = tag;
-    *block_index->m_ChunkCount = chunk_count;
-
-    *out_block_index = block_index;
     return 0;
 }
 
-int Longtail_WriteBlockIndexToBuffer(
-    const struct Longtail_BlockIndex* block_index,
-    void** out_buffer,
-    size_t* out_size)
+// Reads the sections of a compact index that is fully in memory. A format 1 index only has the first
+// format_1_section_count sections, the sections added later are empty. *out_payload_mem is allocated
+// for compressed format 1 indexes and must be freed by the caller after the sections are decoded
+static int CompactIndex_Decode(
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    const void* buffer,
+    size_t size,
+    uint32_t header_value_count,
+    uint64_t* out_header_values,
+    uint32_t section_count,
+    uint32_t format_1_section_count,
+    struct CompactSection* out_sections,
+    void** out_payload_mem)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(block_index, "%p"),
-        LONGTAIL_LOGFIELD(out_buffer, "%p"),
-        LONGTAIL_LOGFIELD(out_size, "%p")
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(header_value_count, "%u"),
+        LONGTAIL_LOGFIELD(out_header_values, "%p"),
+        LONGTAIL_LOGFIELD(section_count, "%u"),
+        LONGTAIL_LOGFIELD(format_1_section_count, "%u"),
+        LONGTAIL_LOGFIELD(out_sections, "%p"),
+        LONGTAIL_LOGFIELD(out_payload_mem, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, block_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_buffer != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_size != 0, return EINVAL)
+    *out_payload_mem = 0;
+    if (CompactIndex_GetFormat(buffer) == LONGTAIL_COMPACT_INDEX_FORMAT_1)
+    {
+        int err = CompactIndex_DecodeFormat1(optional_compression_registry, buffer, size, header_value_count, out_header_values, format_1_section_count, out_sections, out_payload_mem);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompactIndex_DecodeFormat1() failed with %d", err)
+            return err;
+        }
+        for (uint32_t s = format_1_section_count; s < section_count; ++s)
+        {
+            out_sections[s].m_Data = (const uint8_t*)buffer;
+            out_sections[s].m_DataSize = 0;
+            out_sections[s].m_EncodedSize = 0;
+            out_sections[s].m_CompressionAPI = 0;
+        }
+        return 0;
+    }
 
-    size_t index_data_size = Longtail_GetBlockIndexDataSize(*block_index->m_ChunkCount);
-    *out_buffer = Longtail_Alloc("WriteBlockIndexToBuffer", index_data_size);
-    if (!(*out_buffer))
+    int err = CompactIndex_ReadTable(optional_compression_registry, buffer, size, size, header_value_count, out_header_values, section_count, out_sections);
+    if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return ENOMEM;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompactIndex_ReadTable() failed with %d", err)
+        return err;
+    }
+    for (uint32_t s = 0; s < section_count; ++s)
+    {
+        out_sections[s].m_Data = &((const uint8_t*)buffer)[(uintptr_t)out_sections[s].m_Data];
     }
-    memcpy(*out_buffer, block_index->m_BlockHash, index_data_size);
-    *out_size = index_data_size;
     return 0;
 }
 
-int Longtail_ReadBlockIndexFromBuffer(
-    const void* buffer,
-    size_t size,
-    struct Longtail_BlockIndex** out_block_index)
+static int CompactIndex_DecodeSections(
+    struct Longtail_JobAPI* optional_job_api,
+    uint32_t section_count,
+    struct CompactSection* sections)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(buffer, "%p"),
-        LONGTAIL_LOGFIELD(size, "%" PRIu64),
-        LONGTAIL_LOGFIELD(out_block_index, "%p")
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(section_count, "%u"),
+        LONGTAIL_LOGFIELD(sections, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    if (optional_job_api)
+    {
+        Longtail_JobAPI_JobFunc funcs[LONGTAIL_COMPACT_INDEX_MAX_SECTIONS];
+        void* ctxs[LONGTAIL_COMPACT_INDEX_MAX_SECTIONS];
+        for (uint32_t s = 0; s < section_count; ++s)
+        {
+            sections[s].m_Err = 0;
+            funcs[s] = CompactSectionDecodeJob;
+            ctxs[s] = &sections[s];
+        }
+        uint32_t jobs_submitted = 0;
+        int err = Longtail_RunJobsBatched(optional_job_api, 0, 0, 0, section_count, funcs, ctxs, &jobs_submitted);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_RunJobsBatched() failed with %d", err)
+            return err;
+        }
+    }
+    else
+    {
+        for (uint32_t s = 0; s < section_count; ++s)
+        {
+            sections[s].m_Err = CompactSection_Decode(&sections[s]);
+        }
+    }
+    for (uint32_t s = 0; s < section_count; ++s)
+    {
+        if (sections[s].m_Err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Compact index section %u is invalid", s)
+            return sections[s].m_Err;
+        }
+    }
+    return 0;
+}
+
+#define LONGTAIL_COMPACT_VERSION_INDEX_HEADER_VALUE_COUNT   6u
+#define LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT        12u
+#define LONGTAIL_COMPACT_VERSION_INDEX_PATH_DIRECTORY       11u
+#define LONGTAIL_COMPACT_VERSION_INDEX_FORMAT_1_SECTION_COUNT   11u
+
+// The Longtail_VersionIndex_*Sections flag that loads each section, the path directory is loaded on request
+static const uint32_t CompactVersionIndexSectionFlags[LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT] = {
+    Longtail_VersionIndex_AssetSections,        // m_PathHashes
+    Longtail_VersionIndex_AssetSections,        // m_ContentHashes
+    Longtail_VersionIndex_AssetSections,        // m_AssetSizes
+    Longtail_VersionIndex_AssetChunkSections,   // m_AssetChunkCounts
+    Longtail_VersionIndex_AssetChunkSections,   // m_AssetChunkIndexStarts
+    Longtail_VersionIndex_AssetChunkSections,   // m_AssetChunkIndexes
+    Longtail_VersionIndex_ChunkSections,        // m_ChunkHashes
+    Longtail_VersionIndex_ChunkSections,        // m_ChunkSizes
+    Longtail_VersionIndex_ChunkSections,        // m_ChunkTags
+    Longtail_VersionIndex_AssetSections,        // m_Permissions
+    Longtail_VersionIndex_AssetSections,        // m_NameOffsets and m_NameData
+    0                                           // Path directory
+};
+
+static void SetupCompactVersionIndexSections(
+    const struct Longtail_VersionIndex* version_index,
+    const uint32_t* path_directory,
+    struct CompactSection* sections)
+{
+    uint32_t asset_count = *version_index->m_AssetCount;
+    uint32_t chunk_count = *version_index->m_ChunkCount;
+    uint32_t asset_chunk_index_count = *version_index->m_AssetChunkIndexCount;
+    struct CompactSection s[LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT] = {
+        {COMPACT_SECTION_RAW_HASH, asset_count,             version_index->m_PathHashes,            0, version_index->m_PathHashes,             0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_RAW_HASH, asset_count,             version_index->m_ContentHashes,         0, version_index->m_ContentHashes,          0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_VARINT64, asset_count,             version_index->m_AssetSizes,            0, version_index->m_AssetSizes,             0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_VARINT32, asset_count,             version_index->m_AssetChunkCounts,      0, version_index->m_AssetChunkCounts,       0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_DELTA32,  asset_count,             version_index->m_AssetChunkIndexStarts, 0, version_index->m_AssetChunkIndexStarts,  0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_DELTA32,  asset_chunk_index_count, version_index->m_AssetChunkIndexes,     0, version_index->m_AssetChunkIndexes,      0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_RAW_HASH, chunk_count,             version_index->m_ChunkHashes,           0, version_index->m_ChunkHashes,            0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_VARINT32, chunk_count,             version_index->m_ChunkSizes,            0, version_index->m_ChunkSizes,             0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_RLE32,    chunk_count,             version_index->m_ChunkTags,             0, version_index->m_ChunkTags,              0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_RLE16,    asset_count,             version_index->m_Permissions,           0, version_index->m_Permissions,            0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_PATHS,    asset_count,             version_index->m_NameOffsets,           version_index->m_NameData, version_index->m_NameData, version_index->m_NameOffsets, version_index->m_NameDataSize, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_DELTA32,  asset_count,             path_directory,                         0, (void*)path_directory,                   0, 0, 0, 0, 0, 0, 0}
+    };
+    memcpy(sections, s, sizeof(s));
+}
+
+static SORTFUNC(SortAssetPaths)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(a_ptr, "%p"),
+        LONGTAIL_LOGFIELD(b_ptr, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 #else
     struct Longtail_LogContextFmt_Private* ctx = 0;
 #endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, buffer != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, size != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_block_index != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
 
-    size_t block_index_size = size + sizeof(struct Longtail_BlockIndex);
-    struct Longtail_BlockIndex* block_index = (struct Longtail_BlockIndex*)Longtail_Alloc("ReadBlockIndexFromBuffer", block_index_size);
-    if (!block_index)
+    const struct Longtail_VersionIndex* version_index = (const struct Longtail_VersionIndex*)context;
+    uint32_t a = *(const uint32_t*)a_ptr;
+    uint32_t b = *(const uint32_t*)b_ptr;
+    return strcmp(&version_index->m_NameData[version_index->m_NameOffsets[a]], &version_index->m_NameData[version_index->m_NameOffsets[b]]);
+}
+
+int Longtail_CreateVersionIndexPathDirectory(
+    const struct Longtail_VersionIndex* version_index,
+    uint32_t** out_path_directory)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(out_path_directory, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index->m_NameOffsets != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_path_directory != 0, return EINVAL)
+
+    uint32_t asset_count = *version_index->m_AssetCount;
+    uint32_t* path_directory = (uint32_t*)Longtail_Alloc("CreateVersionIndexPathDirectory", sizeof(uint32_t) * (asset_count == 0 ? 1 : asset_count));
+    if (!path_directory)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
         return ENOMEM;
     }
-    memcpy(&block_index[1], buffer, size);
-    int err = Longtail_InitBlockIndexFromData(block_index, &block_index[1], size);
+    for (uint32_t a = 0; a < asset_count; ++a)
+    {
+        path_directory[a] = a;
+    }
+    QSORT(path_directory, asset_count, sizeof(uint32_t), SortAssetPaths, (void*)version_index);
+    *out_path_directory = path_directory;
+    return 0;
+}
+
+// Compares the start of path with folder followed by a '/', zero if path is in folder
+static int ComparePathToFolder(const char* path, const char* folder, size_t folder_length)
+{
+    int cmp = strncmp(path, folder, folder_length);
+    if (cmp != 0)
+    {
+        return cmp;
+    }
+    if (folder_length == 0)
+    {
+        return 0;
+    }
+    return (int)(unsigned char)path[folder_length] - (int)'/';
+}
+
+int Longtail_FindVersionIndexPaths(
+    const struct Longtail_VersionIndex* version_index,
+    const uint32_t* path_directory,
+    const char* path,
+    uint32_t* out_first,
+    uint32_t* out_count)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(path_directory, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(out_first, "%p"),
+        LONGTAIL_LOGFIELD(out_count, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index->m_NameOffsets != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path_directory != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_first != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_count != 0, return EINVAL)
+
+    const char* name_data = version_index->m_NameData;
+    const uint32_t* name_offsets = version_index->m_NameOffsets;
+    uint32_t asset_count = *version_index->m_AssetCount;
+
+    // An exact match is a single file
+    uint32_t low = 0;
+    uint32_t high = asset_count;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (strcmp(&name_data[name_offsets[path_directory[mid]]], path) < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    size_t path_length = strlen(path);
+    if (low < asset_count && path_length > 0 && path[path_length - 1] != '/' && strcmp(&name_data[name_offsets[path_directory[low]]], path) == 0)
+    {
+        *out_first = low;
+        *out_count = 1;
+        return 0;
+    }
+
+    // Otherwise everything in the folder, including the folder itself. All paths that start with
+    // the folder and a '/' are consecutive in the directory
+    size_t folder_length = (path_length > 0 && path[path_length - 1] == '/') ? path_length - 1 : path_length;
+    low = 0;
+    high = asset_count;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (ComparePathToFolder(&name_data[name_offsets[path_directory[mid]]], path, folder_length) < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    uint32_t first = low;
+    high = asset_count;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (ComparePathToFolder(&name_data[name_offsets[path_directory[mid]]], path, folder_length) <= 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    *out_first = first;
+    *out_count = low - first;
+    return 0;
+}
+
+int Longtail_WriteCompactVersionIndexToBuffer(
+    const struct Longtail_VersionIndex* version_index,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    uint32_t compression_type,
+    void** out_buffer,
+    size_t* out_size)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(compression_type, "%u"),
+        LONGTAIL_LOGFIELD(out_buffer, "%p"),
+        LONGTAIL_LOGFIELD(out_size, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, compression_type == 0 || optional_compression_registry != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_buffer != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_size != 0, return EINVAL)
+
+    uint32_t asset_count = *version_index->m_AssetCount;
+    uint32_t chunk_count = *version_index->m_ChunkCount;
+    uint32_t asset_chunk_index_count = *version_index->m_AssetChunkIndexCount;
+
+    // Paths are written in asset order and get consecutive name offsets when read back
+    uint64_t name_data_size = 0;
+    for (uint32_t a = 0; a < asset_count; ++a)
+    {
+        name_data_size += strlen(&version_index->m_NameData[version_index->m_NameOffsets[a]]) + 1;
+    }
+
+    uint32_t* path_directory = 0;
+    int err = Longtail_CreateVersionIndexPathDirectory(version_index, &path_directory);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitBlockIndexFromData() failed with %d", err)
-        Longtail_Free(block_index);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateVersionIndexPathDirectory() failed with %d", err)
+        return err;
+    }
+
+    uint64_t header_values[LONGTAIL_COMPACT_VERSION_INDEX_HEADER_VALUE_COUNT] = {
+        *version_index->m_HashIdentifier,
+        *version_index->m_TargetChunkSize,
+        asset_count,
+        chunk_count,
+        asset_chunk_index_count,
+        name_data_size
+    };
+    struct CompactSection sections[LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT];
+    SetupCompactVersionIndexSections(version_index, path_directory, sections);
+
+    err = CompactIndex_Encode(
+        LONGTAIL_COMPACT_VERSION_INDEX_MAGIC,
+        optional_compression_registry,
+        compression_type,
+        LONGTAIL_COMPACT_VERSION_INDEX_HEADER_VALUE_COUNT,
+        header_values,
+        LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT,
+        sections,
+        out_buffer,
+        out_size);
+    Longtail_Free(path_directory);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompactIndex_Encode() failed with %d", err)
         return err;
     }
-    *out_block_index = block_index;
     return 0;
 }
 
-int Longtail_WriteBlockIndex(
+static int WriteIndexBuffer(
     struct Longtail_StorageAPI* storage_api,
-    struct Longtail_BlockIndex* block_index,
-    const char* path)
+    const char* path,
+    const void* buffer,
+    size_t size)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(storage_api, "%p"),
-        LONGTAIL_LOGFIELD(block_index, "%p"),
-        LONGTAIL_LOGFIELD(path, "%s")
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(size, "%" PRIu64)
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
-
-    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, block_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
 
     int err = EnsureParentPathExists(storage_api, path);
     if (err)
@@ -3867,2267 +5099,2931 @@ int Longtail_WriteBlockIndex(
     err = storage_api->OpenWriteFile(storage_api, path, 0, &file_handle);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenWriteFile) failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenWriteFile() failed with %d", err)
         return err;
     }
-    size_t index_data_size = Longtail_GetBlockIndexDataSize(*block_index->m_ChunkCount);
-    err = storage_api->Write(storage_api, file_handle, 0, index_data_size, block_index->m_BlockHash);
-    if (err){
+    err = storage_api->Write(storage_api, file_handle, 0, size, buffer);
+    storage_api->CloseFile(storage_api, file_handle);
+    if (err)
+    {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Write() failed with %d", err)
-        storage_api->CloseFile(storage_api, file_handle);
-        file_handle = 0;
         return err;
     }
-    storage_api->CloseFile(storage_api, file_handle);
-
-    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "wrote %" PRIu64 " bytes", index_data_size)
-
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "wrote %" PRIu64 " bytes", size)
     return 0;
 }
 
-struct Longtail_BlockIndexHeader
-{
-    TLongtail_Hash m_BlockHash;
-    uint32_t m_HashIdentifier;
-    uint32_t m_ChunkCount;
-    uint32_t m_Tag;
-};
-
-int Longtail_ReadBlockIndex(
+int Longtail_WriteCompactVersionIndex(
     struct Longtail_StorageAPI* storage_api,
-    const char* path,
-    struct Longtail_BlockIndex** out_block_index)
+    const struct Longtail_VersionIndex* version_index,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    uint32_t compression_type,
+    const char* path)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(storage_api, "%p"),
-        LONGTAIL_LOGFIELD(path, "%s"),
-        LONGTAIL_LOGFIELD(out_block_index, "%p")
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(compression_type, "%u"),
+        LONGTAIL_LOGFIELD(path, "%s")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
-
     LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_block_index != 0, return EINVAL)
 
-    Longtail_StorageAPI_HOpenFile f;
-    int err = storage_api->OpenReadFile(storage_api, path, &f);
+    void* buffer = 0;
+    size_t size = 0;
+    int err = Longtail_WriteCompactVersionIndexToBuffer(version_index, optional_compression_registry, compression_type, &buffer, &size);
     if (err)
     {
-        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_WARNING : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_WriteCompactVersionIndexToBuffer() failed with %d", err)
         return err;
     }
-    uint64_t block_size;
-    err = storage_api->GetSize(storage_api, f, &block_size);
+    err = WriteIndexBuffer(storage_api, path, buffer, size);
+    Longtail_Free(buffer);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetSize() failed with %d", err)
-        storage_api->CloseFile(storage_api, f);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "WriteIndexBuffer() failed with %d", err)
         return err;
     }
-    if (block_size < sizeof(struct Longtail_BlockIndexHeader))
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "file size %" PRIu64 " is to small, expected at least %" PRIu64 " bytes", block_size, sizeof(struct Longtail_BlockIndexHeader))
-        storage_api->CloseFile(storage_api, f);
-        return EBADF;
-    }
-    if (block_size > 0xffffffff)
+    return 0;
+}
+
+// Sets up the arrays of the sections in section_flags after the version index header, arrays of other sections are null.
+// Returns the size of the version index data
+static size_t LayoutVersionIndexSections(
+    struct Longtail_VersionIndex* version_index,
+    uint32_t section_flags,
+    uint32_t asset_count,
+    uint32_t chunk_count,
+    uint32_t asset_chunk_index_count,
+    uint32_t name_data_size)
+{
+    size_t array_sizes[LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT] = {
+        sizeof(TLongtail_Hash) * asset_count,
+        sizeof(TLongtail_Hash) * asset_count,
+        sizeof(uint64_t) * asset_count,
+        sizeof(uint32_t) * asset_count,
+        sizeof(uint32_t) * asset_count,
+        sizeof(uint32_t) * asset_chunk_index_count,
+        sizeof(TLongtail_Hash) * chunk_count,
+        sizeof(uint32_t) * chunk_count,
+        sizeof(uint32_t) * chunk_count,
+        sizeof(uint16_t) * asset_count,
+        sizeof(uint32_t) * asset_count + name_data_size,
+        0
+    };
+    // Same order as InitVersionIndexFromData() so a version index with all sections has the regular layout
+    static const uint32_t layout_order[LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT - 1] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 10, 9};
+    void* arrays[LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT] = {0};
+    size_t size = sizeof(uint32_t) * 6;
+    char* p = version_index ? (char*)&version_index[1] : 0;
+    for (uint32_t i = 0; i < LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT - 1; ++i)
+    {
+        uint32_t s = layout_order[i];
+        if (CompactVersionIndexSectionFlags[s] & section_flags)
+        {
+            arrays[s] = p ? &p[size] : 0;
+            size += array_sizes[s];
+        }
+    }
+    if (!version_index)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "file size %" PRIu64 " is to large, size can be at most %" PRIu64 " bytes", block_size, 0xffffffff)
-        storage_api->CloseFile(storage_api, f);
+        return size;
+    }
+
+    uint32_t* header = (uint32_t*)(void*)p;
+    version_index->m_Version = &header[0];
+    version_index->m_HashIdentifier = &header[1];
+    version_index->m_TargetChunkSize = &header[2];
+    version_index->m_AssetCount = &header[3];
+    version_index->m_ChunkCount = &header[4];
+    version_index->m_AssetChunkIndexCount = &header[5];
+    version_index->m_PathHashes = (TLongtail_Hash*)arrays[0];
+    version_index->m_ContentHashes = (TLongtail_Hash*)arrays[1];
+    version_index->m_AssetSizes = (uint64_t*)arrays[2];
+    version_index->m_AssetChunkCounts = (uint32_t*)arrays[3];
+    version_index->m_AssetChunkIndexStarts = (uint32_t*)arrays[4];
+    version_index->m_AssetChunkIndexes = (uint32_t*)arrays[5];
+    version_index->m_ChunkHashes = (TLongtail_Hash*)arrays[6];
+    version_index->m_ChunkSizes = (uint32_t*)arrays[7];
+    version_index->m_ChunkTags = (uint32_t*)arrays[8];
+    version_index->m_Permissions = (uint16_t*)arrays[9];
+    version_index->m_NameOffsets = (uint32_t*)arrays[10];
+    version_index->m_NameData = arrays[10] ? (char*)&version_index->m_NameOffsets[asset_count] : 0;
+    version_index->m_NameDataSize = arrays[10] ? name_data_size : 0;
+    return size;
+}
+
+// Creates a version index with the sections in section_flags from the compact index sections, the m_Data of the
+// requested sections must point to their stored data
+static int CreateVersionIndexFromCompactSections(
+    struct Longtail_JobAPI* optional_job_api,
+    const uint64_t* header_values,
+    const struct CompactSection* sections,
+    uint32_t section_flags,
+    struct Longtail_VersionIndex** out_version_index,
+    uint32_t** out_optional_path_directory)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(header_values, "%p"),
+        LONGTAIL_LOGFIELD(sections, "%p"),
+        LONGTAIL_LOGFIELD(section_flags, "%u"),
+        LONGTAIL_LOGFIELD(out_version_index, "%p"),
+        LONGTAIL_LOGFIELD(out_optional_path_directory, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    for (uint32_t h = 0; h < LONGTAIL_COMPACT_VERSION_INDEX_HEADER_VALUE_COUNT; ++h)
+    {
+        if (header_values[h] > 0xffffffffu)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Compact version index header is invalid, failed with %d", EBADF)
+            return EBADF;
+        }
+    }
+    uint32_t asset_count = (uint32_t)header_values[2];
+    uint32_t chunk_count = (uint32_t)header_values[3];
+    uint32_t asset_chunk_index_count = (uint32_t)header_values[4];
+    uint32_t name_data_size = (uint32_t)header_values[5];
+    if (asset_chunk_index_count < chunk_count || name_data_size < asset_count)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Compact version index header is invalid, failed with %d", EBADF)
         return EBADF;
     }
-    uint64_t read_offset = 0;
 
-    struct Longtail_BlockIndexHeader blockIndexHeader;
-    err = storage_api->Read(storage_api, f, read_offset, sizeof(struct Longtail_BlockIndexHeader), &blockIndexHeader);
-    if (err)
+    size_t version_index_size = sizeof(struct Longtail_VersionIndex) + LayoutVersionIndexSections(0, section_flags, asset_count, chunk_count, asset_chunk_index_count, name_data_size);
+    struct Longtail_VersionIndex* version_index = (struct Longtail_VersionIndex*)Longtail_Alloc("CreateVersionIndexFromCompactSections", version_index_size);
+    if (!version_index)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
-        storage_api->CloseFile(storage_api, f);
-        return err;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
     }
-    read_offset += sizeof(struct Longtail_BlockIndexHeader);
+    LayoutVersionIndexSections(version_index, section_flags, asset_count, chunk_count, asset_chunk_index_count, name_data_size);
+    *version_index->m_Version = Longtail_CurrentVersionIndexVersion;
+    *version_index->m_HashIdentifier = (uint32_t)header_values[0];
+    *version_index->m_TargetChunkSize = (uint32_t)header_values[1];
+    *version_index->m_AssetCount = asset_count;
+    *version_index->m_ChunkCount = chunk_count;
+    *version_index->m_AssetChunkIndexCount = asset_chunk_index_count;
 
-    if (blockIndexHeader.m_ChunkCount == 0)
+    uint32_t* path_directory = 0;
+    if (out_optional_path_directory)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "blockIndexHeader.m_ChunkCount (%u) must be larger than zero", blockIndexHeader.m_ChunkCount)
-        storage_api->CloseFile(storage_api, f);
-        return EBADF;
+        path_directory = (uint32_t*)Longtail_Alloc("CreateVersionIndexFromCompactSections", sizeof(uint32_t) * (asset_count == 0 ? 1 : asset_count));
+        if (!path_directory)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+            Longtail_Free(version_index);
+            return ENOMEM;
+        }
     }
 
-    uint32_t block_index_data_size = (uint32_t)Longtail_GetBlockIndexDataSize(blockIndexHeader.m_ChunkCount);
-    if (block_index_data_size >= block_size)
+    struct CompactSection targets[LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT];
+    SetupCompactVersionIndexSections(version_index, path_directory, targets);
+    uint32_t decode_count = 0;
+    for (uint32_t s = 0; s < LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT; ++s)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_index_data_size %" PRIu64 " is to large, size can be at most %" PRIu64 " bytes", block_index_data_size, block_size)
-        storage_api->CloseFile(storage_api, f);
-        return EBADF;
+        int requested = (s == LONGTAIL_COMPACT_VERSION_INDEX_PATH_DIRECTORY) ? (path_directory != 0) : ((CompactVersionIndexSectionFlags[s] & section_flags) != 0);
+        if (!requested)
+        {
+            continue;
+        }
+        struct CompactSection* target = &targets[decode_count++];
+        *target = targets[s];
+        target->m_Source = 0;
+        target->m_SourceNameData = 0;
+        target->m_Data = sections[s].m_Data;
+        target->m_DataSize = sections[s].m_DataSize;
+        target->m_EncodedSize = sections[s].m_EncodedSize;
+        target->m_CompressionAPI = sections[s].m_CompressionAPI;
     }
-
-    size_t block_index_size = Longtail_GetBlockIndexSize(blockIndexHeader.m_ChunkCount);
-    void* block_index_mem = Longtail_Alloc("ReadBlockIndex", block_index_size);
-    if (!block_index_mem)
+    int err = CompactIndex_DecodeSections(optional_job_api, decode_count, targets);
+    for (uint32_t a = 0; path_directory && !err && a < asset_count; ++a)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        storage_api->CloseFile(storage_api, f);
-        return ENOMEM;
+        err = (path_directory[a] < asset_count) ? 0 : EBADF;
     }
-    struct Longtail_BlockIndex* block_index = Longtail_InitBlockIndex(block_index_mem, blockIndexHeader.m_ChunkCount);
-    err = storage_api->Read(storage_api, f, 0, block_index_data_size, &block_index[1]);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
-        Longtail_Free(block_index);
-        storage_api->CloseFile(storage_api, f);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompactIndex_DecodeSections() failed with %d", err)
+        Longtail_Free(path_directory);
+        Longtail_Free(version_index);
         return err;
     }
-    storage_api->CloseFile(storage_api, f);
-    *out_block_index = block_index;
-
-    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "read %" PRIu64 " bytes", sizeof(struct Longtail_BlockIndexHeader) + block_index_data_size)
-
-    return 0;
-}
-
-static int DisposeStoredBlock(struct Longtail_StoredBlock* stored_block)
-{
-    Longtail_Free(stored_block);
+    *out_version_index = version_index;
+    if (out_optional_path_directory)
+    {
+        *out_optional_path_directory = path_directory;
+    }
     return 0;
 }
 
-size_t Longtail_GetStoredBlockSize(size_t block_data_size)
-{
-    return sizeof(struct Longtail_StoredBlock) + sizeof(struct Longtail_BlockIndex) + block_data_size;
-}
-
-int Longtail_InitStoredBlockFromData(
-    struct Longtail_StoredBlock* stored_block,
-    void* block_data,
-    size_t block_data_size)
+static int ReadCompactVersionIndex(
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    const void* buffer,
+    size_t size,
+    struct Longtail_VersionIndex** out_version_index)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(stored_block, "%p"),
-        LONGTAIL_LOGFIELD(block_data, "%p"),
-        LONGTAIL_LOGFIELD(block_data_size, "%" PRIu64)
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
-
-    LONGTAIL_VALIDATE_INPUT(ctx, stored_block != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, block_data != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, block_data_size > 0, return EINVAL)
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(out_version_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    stored_block->m_BlockIndex = (struct Longtail_BlockIndex*)&stored_block[1];
-    int err = Longtail_InitBlockIndexFromData(
-        stored_block->m_BlockIndex,
-        block_data,
-        block_data_size);
+    uint64_t header_values[LONGTAIL_COMPACT_VERSION_INDEX_HEADER_VALUE_COUNT];
+    struct CompactSection sections[LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT];
+    void* payload_mem = 0;
+    int err = CompactIndex_Decode(
+        optional_compression_registry,
+        buffer,
+        size,
+        LONGTAIL_COMPACT_VERSION_INDEX_HEADER_VALUE_COUNT,
+        header_values,
+        LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT,
+        LONGTAIL_COMPACT_VERSION_INDEX_FORMAT_1_SECTION_COUNT,
+        sections,
+        &payload_mem);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitBlockIndexFromData() failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompactIndex_Decode() failed with %d", err)
+        return err;
+    }
+    err = CreateVersionIndexFromCompactSections(optional_job_api, header_values, sections, Longtail_VersionIndex_AllSections, out_version_index, 0);
+    Longtail_Free(payload_mem);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateVersionIndexFromCompactSections() failed with %d", err)
         return err;
     }
-    size_t BlockIndexDataSize = Longtail_GetBlockIndexDataSize(*stored_block->m_BlockIndex->m_ChunkCount);
-    stored_block->m_BlockData = &((uint8_t*)block_data)[BlockIndexDataSize];
-    stored_block->m_BlockChunksDataSize = (uint32_t)(block_data_size - BlockIndexDataSize);
-    stored_block->Dispose = 0;
     return 0;
 }
 
-int Longtail_CreateStoredBlock(
-    TLongtail_Hash block_hash,
-    uint32_t hash_identifier,
-    uint32_t chunk_count,
-    uint32_t tag,
-    TLongtail_Hash* chunk_hashes,
-    uint32_t* chunk_sizes,
-    uint32_t block_data_size,
-    struct Longtail_StoredBlock** out_stored_block)
+int Longtail_ReadVersionIndexSections(
+    struct Longtail_StorageAPI* storage_api,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    const char* path,
+    uint32_t section_flags,
+    struct Longtail_VersionIndex** out_version_index,
+    uint32_t** out_optional_path_directory)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
-        LONGTAIL_LOGFIELD(hash_identifier, "%u"),
-        LONGTAIL_LOGFIELD(chunk_count, "%u"),
-        LONGTAIL_LOGFIELD(tag, "%u"),
-        LONGTAIL_LOGFIELD(chunk_hashes, "%p"),
-        LONGTAIL_LOGFIELD(chunk_sizes, "%p"),
-        LONGTAIL_LOGFIELD(block_data_size, "%u"),
-        LONGTAIL_LOGFIELD(out_stored_block, "%p")
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(section_flags, "%u"),
+        LONGTAIL_LOGFIELD(out_version_index, "%p"),
+        LONGTAIL_LOGFIELD(out_optional_path_directory, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, (section_flags & ~Longtail_VersionIndex_AllSections) == 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_optional_path_directory == 0 || (section_flags & Longtail_VersionIndex_AssetSections), return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_version_index != 0, return EINVAL)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || chunk_hashes != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || chunk_sizes != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_stored_block != 0, return EINVAL)
+    Longtail_StorageAPI_HOpenFile file_handle;
+    int err = storage_api->OpenReadFile(storage_api, path, &file_handle);
+    if (err != 0)
+    {
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_WARNING : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+        return err;
+    }
+    uint64_t file_size;
+    err = storage_api->GetSize(storage_api, file_handle, &file_size);
+    if (err != 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetSize() failed with %d", err)
+        storage_api->CloseFile(storage_api, file_handle);
+        return err;
+    }
 
-    size_t block_index_size = Longtail_GetBlockIndexSize(chunk_count);
-    size_t stored_block_size = sizeof(struct Longtail_StoredBlock) + block_index_size + block_data_size;
-    struct Longtail_StoredBlock* stored_block = (struct Longtail_StoredBlock*)Longtail_Alloc("CreateStoredBlock", stored_block_size);
-    if (stored_block == 0)
+    size_t table_size = CompactIndex_GetTableSize(LONGTAIL_COMPACT_VERSION_INDEX_HEADER_VALUE_COUNT, LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT);
+    uint8_t table[LONGTAIL_COMPACT_INDEX_HEADER_SIZE + sizeof(uint64_t) * (LONGTAIL_COMPACT_VERSION_INDEX_HEADER_VALUE_COUNT + 3 * LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT)];
+    int is_compact = 0;
+    if (file_size >= table_size)
+    {
+        err = storage_api->Read(storage_api, file_handle, 0, table_size, table);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
+            storage_api->CloseFile(storage_api, file_handle);
+            return err;
+        }
+        is_compact = IsCompactIndex(LONGTAIL_COMPACT_VERSION_INDEX_MAGIC, table, table_size) && CompactIndex_GetFormat(table) != LONGTAIL_COMPACT_INDEX_FORMAT_1;
+    }
+    if (!is_compact)
+    {
+        // The plain encoding and format 1 compact indexes have no section table, read all of it
+        storage_api->CloseFile(storage_api, file_handle);
+        struct Longtail_VersionIndex* version_index = 0;
+        err = Longtail_ReadVersionIndex2(storage_api, optional_compression_registry, optional_job_api, path, &version_index);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ReadVersionIndex2() failed with %d", err)
+            return err;
+        }
+        if (out_optional_path_directory)
+        {
+            err = Longtail_CreateVersionIndexPathDirectory(version_index, out_optional_path_directory);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateVersionIndexPathDirectory() failed with %d", err)
+                Longtail_Free(version_index);
+                return err;
+            }
+        }
+        *out_version_index = version_index;
+        return 0;
+    }
+
+    uint64_t header_values[LONGTAIL_COMPACT_VERSION_INDEX_HEADER_VALUE_COUNT];
+    struct CompactSection sections[LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT];
+    err = CompactIndex_ReadTable(
+        optional_compression_registry,
+        table,
+        table_size,
+        file_size,
+        LONGTAIL_COMPACT_VERSION_INDEX_HEADER_VALUE_COUNT,
+        header_values,
+        LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT,
+        sections);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompactIndex_ReadTable() failed with %d", err)
+        storage_api->CloseFile(storage_api, file_handle);
+        return err;
+    }
+
+    // Only the requested sections are read from the file
+    size_t stored_size = 0;
+    for (uint32_t s = 0; s < LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT; ++s)
+    {
+        int requested = (s == LONGTAIL_COMPACT_VERSION_INDEX_PATH_DIRECTORY) ? (out_optional_path_directory != 0) : ((CompactVersionIndexSectionFlags[s] & section_flags) != 0);
+        stored_size += requested ? sections[s].m_DataSize : 0;
+    }
+    uint8_t* stored_data = (uint8_t*)Longtail_Alloc("ReadVersionIndexSections", stored_size == 0 ? 1 : stored_size);
+    if (!stored_data)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        storage_api->CloseFile(storage_api, file_handle);
         return ENOMEM;
     }
-    stored_block->m_BlockIndex = Longtail_InitBlockIndex(&stored_block[1], chunk_count);
-    LONGTAIL_FATAL_ASSERT(ctx, stored_block->m_BlockIndex != 0, return EINVAL)
+    size_t stored_offset = 0;
+    for (uint32_t s = 0; s < LONGTAIL_COMPACT_VERSION_INDEX_SECTION_COUNT; ++s)
+    {
+        int requested = (s == LONGTAIL_COMPACT_VERSION_INDEX_PATH_DIRECTORY) ? (out_optional_path_directory != 0) : ((CompactVersionIndexSectionFlags[s] & section_flags) != 0);
+        if (!requested)
+        {
+            continue;
+        }
+        if (sections[s].m_DataSize == 0)
+        {
+            sections[s].m_Data = stored_data;
+            continue;
+        }
+        err = storage_api->Read(storage_api, file_handle, (uint64_t)(uintptr_t)sections[s].m_Data, sections[s].m_DataSize, &stored_data[stored_offset]);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
+            Longtail_Free(stored_data);
+            storage_api->CloseFile(storage_api, file_handle);
+            return err;
+        }
+        sections[s].m_Data = &stored_data[stored_offset];
+        stored_offset += sections[s].m_DataSize;
+    }
+    storage_api->CloseFile(storage_api, file_handle);
 
-    *stored_block->m_BlockIndex->m_BlockHash = block_hash;
-    *stored_block->m_BlockIndex->m_HashIdentifier = hash_identifier;
-    *stored_block->m_BlockIndex->m_ChunkCount = chunk_count;
-    *stored_block->m_BlockIndex->m_Tag = tag;
-    memmove(stored_block->m_BlockIndex->m_ChunkHashes, chunk_hashes, sizeof(TLongtail_Hash) * chunk_count);
-    memmove(stored_block->m_BlockIndex->m_ChunkSizes, chunk_sizes, sizeof(uint32_t) * chunk_count);
+    err = CreateVersionIndexFromCompactSections(optional_job_api, header_values, sections, section_flags, out_version_index, out_optional_path_directory);
+    Longtail_Free(stored_data);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateVersionIndexFromCompactSections() failed with %d", err)
+        return err;
+    }
 
-    stored_block->Dispose = DisposeStoredBlock;
-    stored_block->m_BlockData = ((uint8_t*)stored_block->m_BlockIndex) + block_index_size;
-    stored_block->m_BlockChunksDataSize = block_data_size;
-    *out_stored_block = stored_block;
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "read %" PRIu64 " of %" PRIu64 " bytes", (uint64_t)(table_size + stored_size), file_size)
     return 0;
 }
 
-static int ReadStoredBlock_Dispose(struct Longtail_StoredBlock* stored_block)
+static int CreateVersionIndexSubset(
+    const struct Longtail_VersionIndex* version_index,
+    const uint8_t* keep_asset,
+    struct Longtail_VersionIndex** out_version_index)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(stored_block, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(keep_asset, "%p"),
+        LONGTAIL_LOGFIELD(out_version_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_FATAL_ASSERT(ctx, stored_block, return EINVAL)
+    uint32_t asset_count = *version_index->m_AssetCount;
+    uint32_t chunk_count = *version_index->m_ChunkCount;
 
-    Longtail_Free(stored_block);
+    size_t tmp_mem_size = sizeof(uint32_t) * asset_count + sizeof(uint32_t) * chunk_count;
+    void* tmp_mem = Longtail_Alloc("CreateVersionIndexSubset", tmp_mem_size);
+    if (!tmp_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    uint32_t* kept_asset_indexes = (uint32_t*)tmp_mem;
+    uint32_t* chunk_remap = &kept_asset_indexes[asset_count];
+    for (uint32_t c = 0; c < chunk_count; ++c)
+    {
+        chunk_remap[c] = 0xffffffffu;
+    }
+
+    // Keep the asset order of the version index
+    uint32_t kept_asset_count = 0;
+    for (uint32_t a = 0; a < asset_count; ++a)
+    {
+        if (keep_asset[a])
+        {
+            kept_asset_indexes[kept_asset_count++] = a;
+        }
+    }
+
+    uint64_t asset_chunk_index_count = 0;
+    uint64_t name_data_size = 0;
+    uint32_t kept_chunk_count = 0;
+    for (uint32_t k = 0; k < kept_asset_count; ++k)
+    {
+        uint32_t asset_index = kept_asset_indexes[k];
+        uint32_t asset_chunk_count = version_index->m_AssetChunkCounts[asset_index];
+        uint32_t asset_chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
+        for (uint32_t i = 0; i < asset_chunk_count; ++i)
+        {
+            uint32_t chunk_index = version_index->m_AssetChunkIndexes[asset_chunk_index_start + i];
+            if (chunk_remap[chunk_index] == 0xffffffffu)
+            {
+                chunk_remap[chunk_index] = kept_chunk_count++;
+            }
+        }
+        asset_chunk_index_count += asset_chunk_count;
+        name_data_size += strlen(&version_index->m_NameData[version_index->m_NameOffsets[asset_index]]) + 1;
+    }
+    if (asset_chunk_index_count > 0xffffffffu || name_data_size > 0xffffffffu)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Filtered version index is too large, failed with %d", ENOMEM)
+        Longtail_Free(tmp_mem);
+        return ENOMEM;
+    }
+
+    size_t filtered_version_index_size = sizeof(struct Longtail_VersionIndex) + LayoutVersionIndexSections(0, Longtail_VersionIndex_AllSections, kept_asset_count, kept_chunk_count, (uint32_t)asset_chunk_index_count, (uint32_t)name_data_size);
+    struct Longtail_VersionIndex* filtered_version_index = (struct Longtail_VersionIndex*)Longtail_Alloc("CreateVersionIndexSubset", filtered_version_index_size);
+    if (!filtered_version_index)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(tmp_mem);
+        return ENOMEM;
+    }
+    LayoutVersionIndexSections(filtered_version_index, Longtail_VersionIndex_AllSections, kept_asset_count, kept_chunk_count, (uint32_t)asset_chunk_index_count, (uint32_t)name_data_size);
+    *filtered_version_index->m_Version = Longtail_CurrentVersionIndexVersion;
+    *filtered_version_index->m_HashIdentifier = *version_index->m_HashIdentifier;
+    *filtered_version_index->m_TargetChunkSize = *version_index->m_TargetChunkSize;
+    *filtered_version_index->m_AssetCount = kept_asset_count;
+    *filtered_version_index->m_ChunkCount = kept_chunk_count;
+    *filtered_version_index->m_AssetChunkIndexCount = (uint32_t)asset_chunk_index_count;
+
+    for (uint32_t c = 0; c < chunk_count; ++c)
+    {
+        uint32_t kept_chunk_index = chunk_remap[c];
+        if (kept_chunk_index == 0xffffffffu)
+        {
+            continue;
+        }
+        filtered_version_index->m_ChunkHashes[kept_chunk_index] = version_index->m_ChunkHashes[c];
+        filtered_version_index->m_ChunkSizes[kept_chunk_index] = version_index->m_ChunkSizes[c];
+        filtered_version_index->m_ChunkTags[kept_chunk_index] = version_index->m_ChunkTags[c];
+    }
+
+    uint32_t asset_chunk_offset = 0;
+    uint32_t name_offset = 0;
+    for (uint32_t k = 0; k < kept_asset_count; ++k)
+    {
+        uint32_t asset_index = kept_asset_indexes[k];
+        uint32_t asset_chunk_count = version_index->m_AssetChunkCounts[asset_index];
+        uint32_t asset_chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
+        filtered_version_index->m_PathHashes[k] = version_index->m_PathHashes[asset_index];
+        filtered_version_index->m_ContentHashes[k] = version_index->m_ContentHashes[asset_index];
+        filtered_version_index->m_AssetSizes[k] = version_index->m_AssetSizes[asset_index];
+        filtered_version_index->m_AssetChunkCounts[k] = asset_chunk_count;
+        filtered_version_index->m_AssetChunkIndexStarts[k] = asset_chunk_offset;
+        filtered_version_index->m_Permissions[k] = version_index->m_Permissions[asset_index];
+        for (uint32_t i = 0; i < asset_chunk_count; ++i)
+        {
+            filtered_version_index->m_AssetChunkIndexes[asset_chunk_offset++] = chunk_remap[version_index->m_AssetChunkIndexes[asset_chunk_index_start + i]];
+        }
+        const char* asset_path = &version_index->m_NameData[version_index->m_NameOffsets[asset_index]];
+        size_t asset_path_size = strlen(asset_path) + 1;
+        filtered_version_index->m_NameOffsets[k] = name_offset;
+        memcpy(&filtered_version_index->m_NameData[name_offset], asset_path, asset_path_size);
+        name_offset += (uint32_t)asset_path_size;
+    }
+    Longtail_Free(tmp_mem);
+
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "kept %u of %u assets and %u of %u chunks", kept_asset_count, asset_count, kept_chunk_count, chunk_count)
+    *out_version_index = filtered_version_index;
     return 0;
 }
 
-int Longtail_WriteStoredBlockToBuffer(
-    const struct Longtail_StoredBlock* stored_block,
-    void** out_buffer,
-    size_t* out_size)
+int Longtail_FilterVersionIndex(
+    const struct Longtail_VersionIndex* version_index,
+    struct Longtail_PathFilterAPI* path_filter_api,
+    const char* root_path,
+    struct Longtail_VersionIndex** out_version_index)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(stored_block, "%p"),
-        LONGTAIL_LOGFIELD(out_buffer, "%p"),
-        LONGTAIL_LOGFIELD(out_size, "%p")
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(path_filter_api, "%p"),
+        LONGTAIL_LOGFIELD(root_path, "%s"),
+        LONGTAIL_LOGFIELD(out_version_index, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index->m_NameOffsets != 0 && version_index->m_AssetChunkIndexes != 0 && version_index->m_ChunkHashes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path_filter_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, root_path != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_version_index != 0, return EINVAL)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, stored_block != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_buffer != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_size != 0, return EINVAL)
+    uint32_t asset_count = *version_index->m_AssetCount;
 
-    uint32_t chunk_count = *stored_block->m_BlockIndex->m_ChunkCount;
-    uint32_t block_index_data_size = (uint32_t)Longtail_GetBlockIndexDataSize(chunk_count);
+    uint32_t* path_directory;
+    int err = Longtail_CreateVersionIndexPathDirectory(version_index, &path_directory);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateVersionIndexPathDirectory() failed with %d", err)
+        return err;
+    }
 
-    size_t size = ((size_t)block_index_data_size) + stored_block->m_BlockChunksDataSize;
+    size_t max_path_length = 0;
+    for (uint32_t a = 0; a < asset_count; ++a)
+    {
+        size_t path_length = strlen(&version_index->m_NameData[version_index->m_NameOffsets[a]]);
+        max_path_length = path_length > max_path_length ? path_length : max_path_length;
+    }
 
-    void* mem = (uint8_t*)Longtail_Alloc("WriteStoredBlockToBuffer", size);
-    if (!mem)
+    size_t tmp_mem_size = sizeof(uint8_t) * asset_count + max_path_length + 1;
+    void* tmp_mem = Longtail_Alloc("Longtail_FilterVersionIndex", tmp_mem_size);
+    if (!tmp_mem)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(path_directory);
         return ENOMEM;
     }
-    uint8_t* write_ptr = (uint8_t*)mem;
+    uint8_t* keep_asset = (uint8_t*)tmp_mem;
+    char* filter_path = (char*)&keep_asset[asset_count];
+    memset(keep_asset, 0, sizeof(uint8_t) * asset_count);
 
-    memcpy(write_ptr, stored_block->m_BlockIndex->m_BlockHash, block_index_data_size);
-    write_ptr += block_index_data_size;
-    memcpy(write_ptr, stored_block->m_BlockData, stored_block->m_BlockChunksDataSize);
+    // Same rules as scanning with a path filter: an excluded folder excludes everything in it. The content
+    // of a folder follows the folder in the path directory so we skip ahead past it
+    uint32_t d = 0;
+    while (d < asset_count)
+    {
+        uint32_t asset_index = path_directory[d];
+        const char* asset_path = &version_index->m_NameData[version_index->m_NameOffsets[asset_index]];
+        size_t asset_path_length = strlen(asset_path);
+        int is_dir = asset_path_length > 0 && asset_path[asset_path_length - 1] == '/';
+        memcpy(filter_path, asset_path, asset_path_length + 1);
+        if (is_dir)
+        {
+            filter_path[asset_path_length - 1] = '\0';
+        }
+        const char* asset_name = strrchr(filter_path, '/');
+        asset_name = asset_name ? &asset_name[1] : filter_path;
+        int include = path_filter_api->Include(
+            path_filter_api,
+            root_path,
+            filter_path,
+            asset_name,
+            is_dir,
+            version_index->m_AssetSizes[asset_index],
+            version_index->m_Permissions[asset_index]);
+        if (include)
+        {
+            keep_asset[asset_index] = 1;
+            ++d;
+            continue;
+        }
+        ++d;
+        if (is_dir)
+        {
+            while (d < asset_count && strncmp(&version_index->m_NameData[version_index->m_NameOffsets[path_directory[d]]], asset_path, asset_path_length) == 0)
+            {
+                ++d;
+            }
+        }
+    }
+    Longtail_Free(path_directory);
 
-    *out_size = size;
-    *out_buffer = mem;
+    err = CreateVersionIndexSubset(version_index, keep_asset, out_version_index);
+    Longtail_Free(tmp_mem);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateVersionIndexSubset() failed with %d", err)
+        return err;
+    }
     return 0;
 }
 
-int Longtail_ReadStoredBlockFromBuffer(
-    const void* buffer,
-    size_t size,
-    struct Longtail_StoredBlock** out_stored_block)
+static size_t GetFolderStateDataSize(uint32_t asset_count)
+{
+    return
+        sizeof(uint32_t) +                  // m_Version
+        sizeof(uint32_t) +                  // m_AssetCount
+        (sizeof(uint64_t) * asset_count) +  // m_ModificationTimes
+        (sizeof(uint64_t) * asset_count) +  // m_ChangeTimes
+        (sizeof(uint64_t) * asset_count);   // m_FileIds
+}
+
+size_t Longtail_GetFolderStateSize(uint32_t asset_count)
+{
+    return sizeof(struct Longtail_FolderState) + GetFolderStateDataSize(asset_count);
+}
+
+static struct Longtail_FolderState* InitFolderState(void* mem, uint32_t asset_count)
+{
+    struct Longtail_FolderState* folder_state = (struct Longtail_FolderState*)mem;
+    char* p = (char*)&folder_state[1];
+
+    folder_state->m_Version = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    folder_state->m_AssetCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    folder_state->m_ModificationTimes = (uint64_t*)(void*)p;
+    p += sizeof(uint64_t) * asset_count;
+
+    folder_state->m_ChangeTimes = (uint64_t*)(void*)p;
+    p += sizeof(uint64_t) * asset_count;
+
+    folder_state->m_FileIds = (uint64_t*)(void*)p;
+    p += sizeof(uint64_t) * asset_count;
+
+    *folder_state->m_Version = Longtail_CurrentFolderStateVersion;
+    *folder_state->m_AssetCount = asset_count;
+    folder_state->m_WriteTime = 0;
+    return folder_state;
+}
+
+static int InitFolderStateFromData(
+    struct Longtail_FolderState* folder_state,
+    void* data,
+    uint64_t data_size)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(buffer, "%p"),
-        LONGTAIL_LOGFIELD(size, "%" PRIu64),
-        LONGTAIL_LOGFIELD(out_stored_block, "%p")
+        LONGTAIL_LOGFIELD(folder_state, "%p"),
+        LONGTAIL_LOGFIELD(data, "%p"),
+        LONGTAIL_LOGFIELD(data_size, "%" PRIu64)
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    if (data_size < (2 * sizeof(uint32_t)))
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Folder state is invalid, not big enough for minimal header. Size %" PRIu64 " < %" PRIu64 "", data_size, (2 * sizeof(uint32_t)));
+        return EBADF;
+    }
+
+    char* p = (char*)data;
+
+    folder_state->m_Version = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    if (*folder_state->m_Version != Longtail_CurrentFolderStateVersion)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Mismatching versions in folder state data %u != %u", *folder_state->m_Version, Longtail_CurrentFolderStateVersion);
+        return EBADF;
+    }
+
+    folder_state->m_AssetCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    uint32_t asset_count = *folder_state->m_AssetCount;
+    if (GetFolderStateDataSize(asset_count) > data_size)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Folder state data is truncated: %" PRIu64 " < %" PRIu64, data_size, (uint64_t)GetFolderStateDataSize(asset_count))
+        return EBADF;
+    }
+
+    folder_state->m_ModificationTimes = (uint64_t*)(void*)p;
+    p += sizeof(uint64_t) * asset_count;
+
+    folder_state->m_ChangeTimes = (uint64_t*)(void*)p;
+    p += sizeof(uint64_t) * asset_count;
+
+    folder_state->m_FileIds = (uint64_t*)(void*)p;
+    p += sizeof(uint64_t) * asset_count;
+
+    folder_state->m_WriteTime = 0;
+
+    return 0;
+}
+
+int Longtail_CreateFolderState(
+    struct Longtail_StorageAPI* storage_api,
+    const char* root_path,
+    const struct Longtail_VersionIndex* version_index,
+    struct Longtail_FolderState** out_folder_state)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(root_path, "%s"),
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(out_folder_state, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, buffer != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_stored_block != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, root_path != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_folder_state != 0, return EINVAL)
 
-    size_t block_mem_size = Longtail_GetStoredBlockSize(size);
-    struct Longtail_StoredBlock* stored_block = (struct Longtail_StoredBlock*)Longtail_Alloc("ReadStoredBlockFromBuffer", block_mem_size);
-    if (!stored_block)
+    uint32_t asset_count = *version_index->m_AssetCount;
+    void* mem = Longtail_Alloc("CreateFolderState", Longtail_GetFolderStateSize(asset_count));
+    if (!mem)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
         return ENOMEM;
     }
-    void* block_data = &((uint8_t*)stored_block)[block_mem_size - size];
-    memcpy(block_data, buffer, size);
-    int err = Longtail_InitStoredBlockFromData(
-        stored_block,
-        block_data,
-        size);
-    if (err)
+    struct Longtail_FolderState* folder_state = InitFolderState(mem, asset_count);
+
+    for (uint32_t a = 0; a < asset_count; ++a)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitStoredBlockFromData() failed with %d", err)
-        Longtail_Free(stored_block);
-        return err;
+        folder_state->m_ModificationTimes[a] = 0;
+        folder_state->m_ChangeTimes[a] = 0;
+        folder_state->m_FileIds[a] = 0;
+        const char* asset_path = &version_index->m_NameData[version_index->m_NameOffsets[a]];
+        if (IsDirPath(asset_path))
+        {
+            continue;
+        }
+        char* full_path = storage_api->ConcatPath(storage_api, root_path, asset_path);
+        uint64_t size;
+        int err = storage_api->GetFileStat(storage_api, full_path, &size, &folder_state->m_ModificationTimes[a], &folder_state->m_ChangeTimes[a], &folder_state->m_FileIds[a]);
+        Longtail_Free(full_path);
+        if (err == ENOENT)
+        {
+            // A zero modification time never matches so the asset is hashed again next time
+            folder_state->m_ModificationTimes[a] = 0;
+            folder_state->m_ChangeTimes[a] = 0;
+            folder_state->m_FileIds[a] = 0;
+            continue;
+        }
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetFileStat() failed with %d", err)
+            Longtail_Free(folder_state);
+            return err;
+        }
+        if (size != version_index->m_AssetSizes[a])
+        {
+            folder_state->m_ModificationTimes[a] = 0;
+            folder_state->m_ChangeTimes[a] = 0;
+            folder_state->m_FileIds[a] = 0;
+        }
     }
-    stored_block->Dispose = ReadStoredBlock_Dispose;
-    *out_stored_block = stored_block;
+    *out_folder_state = folder_state;
     return 0;
 }
 
-int Longtail_WriteStoredBlock(
+int Longtail_WriteFolderState(
     struct Longtail_StorageAPI* storage_api,
-    struct Longtail_StoredBlock* stored_block,
+    const struct Longtail_VersionIndex* version_index,
+    const struct Longtail_FolderState* folder_state,
     const char* path)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(storage_api, "%p"),
-        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(folder_state, "%p"),
         LONGTAIL_LOGFIELD(path, "%s")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
     LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, stored_block != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, folder_state != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, *folder_state->m_AssetCount == *version_index->m_AssetCount, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
 
-    Longtail_StorageAPI_HOpenFile block_file_handle;
-    int err = storage_api->OpenWriteFile(storage_api, path, 0, &block_file_handle);
+    void* version_index_buffer;
+    size_t version_index_size;
+    int err = Longtail_WriteVersionIndexToBuffer(version_index, &version_index_buffer, &version_index_size);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_WriteVersionIndexToBuffer() failed with %d", err)
+        return err;
+    }
+
+    size_t folder_state_data_size = GetFolderStateDataSize(*folder_state->m_AssetCount);
+
+    err = EnsureParentPathExists(storage_api, path);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed with %d", err)
+        Longtail_Free(version_index_buffer);
+        return err;
+    }
+    Longtail_StorageAPI_HOpenFile file_handle;
+    err = storage_api->OpenWriteFile(storage_api, path, 0, &file_handle);
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenWriteFile() failed with %d", err)
+        Longtail_Free(version_index_buffer);
         return err;
     }
-    uint32_t write_offset = 0;
-    uint32_t chunk_count = *stored_block->m_BlockIndex->m_ChunkCount;
-    uint32_t block_index_data_size = (uint32_t)Longtail_GetBlockIndexDataSize(chunk_count);
-    err = storage_api->Write(storage_api, block_file_handle, write_offset, block_index_data_size, stored_block->m_BlockIndex->m_BlockHash);
+    err = storage_api->Write(storage_api, file_handle, 0, folder_state_data_size, folder_state->m_Version);
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Write() failed with %d", err)
+        storage_api->CloseFile(storage_api, file_handle);
+        Longtail_Free(version_index_buffer);
         return err;
     }
-    write_offset += block_index_data_size;
-
-    err = storage_api->Write(storage_api, block_file_handle, write_offset, stored_block->m_BlockChunksDataSize, stored_block->m_BlockData);
+    err = storage_api->Write(storage_api, file_handle, folder_state_data_size, version_index_size, version_index_buffer);
+    storage_api->CloseFile(storage_api, file_handle);
+    Longtail_Free(version_index_buffer);
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Write() failed with %d", err)
-        storage_api->CloseFile(storage_api, block_file_handle);
         return err;
     }
-    storage_api->CloseFile(storage_api, block_file_handle);
-
-    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "wrote %u bytes", block_index_data_size + stored_block->m_BlockChunksDataSize)
-
     return 0;
 }
 
-int Longtail_ReadStoredBlock(
+int Longtail_ReadFolderState(
     struct Longtail_StorageAPI* storage_api,
     const char* path,
-    struct Longtail_StoredBlock** out_stored_block)
+    struct Longtail_VersionIndex** out_version_index,
+    struct Longtail_FolderState** out_folder_state)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(storage_api, "%p"),
         LONGTAIL_LOGFIELD(path, "%s"),
-        LONGTAIL_LOGFIELD(out_stored_block, "%p")
+        LONGTAIL_LOGFIELD(out_version_index, "%p"),
+        LONGTAIL_LOGFIELD(out_folder_state, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
     LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_stored_block != 0, return EINVAL)
-
-    Longtail_StorageAPI_HOpenFile f;
-    int err = storage_api->OpenReadFile(storage_api, path, &f);
+    LONGTAIL_VALIDATE_INPUT(ctx, out_version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_folder_state != 0, return EINVAL)
+
+    // Files modified at or after the folder state was written are not trusted, the state file tells when that was
+    uint64_t state_file_size;
+    uint64_t write_time;
+    uint64_t change_time;
+    uint64_t file_id;
+    int err = storage_api->GetFileStat(storage_api, path, &state_file_size, &write_time, &change_time, &file_id);
     if (err)
     {
-        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_INFO : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_WARNING : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetFileStat() failed with %d", err)
         return err;
     }
-    uint64_t stored_block_data_size;
-    err = storage_api->GetSize(storage_api, f, &stored_block_data_size);
+
+    Longtail_StorageAPI_HOpenFile file_handle;
+    err = storage_api->OpenReadFile(storage_api, path, &file_handle);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_WARNING : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+        return err;
+    }
+    uint64_t data_size;
+    err = storage_api->GetSize(storage_api, file_handle, &data_size);
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetSize() failed with %d", err)
-        storage_api->CloseFile(storage_api, f);
+        storage_api->CloseFile(storage_api, file_handle);
         return err;
     }
-    size_t block_mem_size = Longtail_GetStoredBlockSize(stored_block_data_size);
-    struct Longtail_StoredBlock* stored_block = (struct Longtail_StoredBlock*)Longtail_Alloc("ReadStoredBlock", block_mem_size);
-    if (!stored_block)
+    struct Longtail_FolderState* folder_state = (struct Longtail_FolderState*)Longtail_Alloc("ReadFolderState", sizeof(struct Longtail_FolderState) + data_size);
+    if (!folder_state)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        storage_api->CloseFile(storage_api, f);
+        storage_api->CloseFile(storage_api, file_handle);
         return ENOMEM;
     }
-    void* block_data = &((uint8_t*)stored_block)[block_mem_size - stored_block_data_size];
-    err = storage_api->Read(storage_api, f, 0, stored_block_data_size, block_data);
+    err = storage_api->Read(storage_api, file_handle, 0, data_size, &folder_state[1]);
+    storage_api->CloseFile(storage_api, file_handle);
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
-        Longtail_Free(stored_block);
-        storage_api->CloseFile(storage_api, f);
+        Longtail_Free(folder_state);
         return err;
     }
-    storage_api->CloseFile(storage_api, f);
-    err = Longtail_InitStoredBlockFromData(
-        stored_block,
-        block_data,
-        stored_block_data_size);
+    err = InitFolderStateFromData(folder_state, &folder_state[1], data_size);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitStoredBlockFromData() failed with %d", err)
-        Longtail_Free(stored_block);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "InitFolderStateFromData() failed with %d", err)
+        Longtail_Free(folder_state);
         return err;
     }
-    stored_block->Dispose = ReadStoredBlock_Dispose;
-    *out_stored_block = stored_block;
-
-    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "read %" PRIu64 " bytes", stored_block_data_size)
+    folder_state->m_WriteTime = write_time;
 
+    // The version index follows the folder state data, it is copied out so the folder state keeps its layout
+    size_t folder_state_data_size = GetFolderStateDataSize(*folder_state->m_AssetCount);
+    struct Longtail_VersionIndex* version_index;
+    err = Longtail_ReadVersionIndexFromBuffer(&((const char*)&folder_state[1])[folder_state_data_size], (size_t)(data_size - folder_state_data_size), &version_index);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ReadVersionIndexFromBuffer() failed with %d", err)
+        Longtail_Free(folder_state);
+        return err;
+    }
+    if (*version_index->m_AssetCount != *folder_state->m_AssetCount)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Folder state asset count %u does not match version index asset count %u", *folder_state->m_AssetCount, *version_index->m_AssetCount)
+        Longtail_Free(version_index);
+        Longtail_Free(folder_state);
+        return EBADF;
+    }
+    *out_version_index = version_index;
+    *out_folder_state = folder_state;
     return 0;
 }
 
-static uint32_t GetUniqueHashes(
-    uint32_t hash_count,
-    const TLongtail_Hash* hashes,
-    uint32_t* out_unique_hash_indexes)
+int Longtail_CreateVersionIndexFromFolderState(
+    struct Longtail_StorageAPI* storage_api,
+    struct Longtail_HashAPI* hash_api,
+    struct Longtail_ChunkerAPI* chunker_api,
+    struct Longtail_JobAPI* job_api,
+    struct Longtail_ProgressAPI* progress_api,
+    struct Longtail_CancelAPI* optional_cancel_api,
+    Longtail_CancelAPI_HCancelToken optional_cancel_token,
+    const char* root_path,
+    const struct Longtail_FileInfos* file_infos,
+    const uint32_t* optional_asset_tags,
+    uint32_t target_chunk_size,
+    int enable_file_map,
+    const struct Longtail_VersionIndex* state_version_index,
+    const struct Longtail_FolderState* folder_state,
+    struct Longtail_VersionIndex** out_version_index)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(hash_count, "%u"),
-        LONGTAIL_LOGFIELD(hashes, "%p"),
-        LONGTAIL_LOGFIELD(out_unique_hash_indexes, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(hash_api, "%p"),
+        LONGTAIL_LOGFIELD(chunker_api, "%p"),
+        LONGTAIL_LOGFIELD(job_api, "%p"),
+        LONGTAIL_LOGFIELD(progress_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
+        LONGTAIL_LOGFIELD(root_path, "%s"),
+        LONGTAIL_LOGFIELD(file_infos, "%p"),
+        LONGTAIL_LOGFIELD(optional_asset_tags, "%p"),
+        LONGTAIL_LOGFIELD(target_chunk_size, "%u"),
+        LONGTAIL_LOGFIELD(enable_file_map, "%d"),
+        LONGTAIL_LOGFIELD(state_version_index, "%p"),
+        LONGTAIL_LOGFIELD(folder_state, "%p"),
+        LONGTAIL_LOGFIELD(out_version_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_FATAL_ASSERT(ctx, hash_count != 0, return 0)
-    LONGTAIL_FATAL_ASSERT(ctx, hashes != 0, return 0)
-    LONGTAIL_FATAL_ASSERT(ctx, hash_count == 0 || out_unique_hash_indexes != 0, return 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, hash_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, root_path != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, file_infos != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, state_version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, folder_state != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, *folder_state->m_AssetCount == *state_version_index->m_AssetCount, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_version_index != 0, return EINVAL)
 
-    struct Longtail_LookupTable* lookup_table = LongtailPrivate_LookupTable_Create(Longtail_Alloc("GetUniqueHashes", LongtailPrivate_LookupTable_GetSize(hash_count)), hash_count, 0);
-    if (!lookup_table)
+    uint32_t file_count = file_infos->m_Count;
+    uint32_t state_asset_count = *state_version_index->m_AssetCount;
+
+    // Chunks of the state can only be reused if they were made with the same hashing and chunking
+    int can_reuse =
+        *state_version_index->m_HashIdentifier == hash_api->GetIdentifier(hash_api) &&
+        *state_version_index->m_TargetChunkSize == target_chunk_size;
+
+    uint32_t* path_directory = 0;
+    if (can_reuse)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return 0;
+        int err = Longtail_CreateVersionIndexPathDirectory(state_version_index, &path_directory);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateVersionIndexPathDirectory() failed with %d", err)
+            return err;
+        }
     }
 
-    uint32_t unique_hash_count = 0;
-    for (uint32_t i = 0; i < hash_count; ++i)
+    size_t tmp_mem_size =
+        sizeof(uint8_t) * state_asset_count +
+        sizeof(const char*) * file_count +
+        sizeof(uint64_t) * file_count +
+        sizeof(uint16_t) * file_count +
+        sizeof(uint32_t) * file_count;
+    void* tmp_mem = Longtail_Alloc("CreateVersionIndexFromFolderState", tmp_mem_size);
+    if (!tmp_mem)
     {
-        TLongtail_Hash hash = hashes[i];
-        uint32_t* lookup_index = LongtailPrivate_LookupTable_PutUnique(lookup_table, hash, unique_hash_count);
-        if (lookup_index == 0)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(path_directory);
+        return ENOMEM;
+    }
+    const char** changed_paths = (const char**)tmp_mem;
+    uint64_t* changed_sizes = (uint64_t*)&changed_paths[file_count];
+    uint32_t* changed_tags = (uint32_t*)&changed_sizes[file_count];
+    uint16_t* changed_permissions = (uint16_t*)&changed_tags[file_count];
+    uint8_t* reuse_asset = (uint8_t*)&changed_permissions[file_count];
+    memset(reuse_asset, 0, sizeof(uint8_t) * state_asset_count);
+
+    uint32_t changed_count = 0;
+    uint32_t reused_count = 0;
+    for (uint32_t f = 0; f < file_count; ++f)
+    {
+        const char* path = &file_infos->m_PathData[file_infos->m_PathStartOffsets[f]];
+        uint64_t size = file_infos->m_Sizes[f];
+        uint16_t permissions = file_infos->m_Permissions[f];
+        uint32_t state_asset_index = 0xffffffffu;
+        if (can_reuse)
+        {
+            uint32_t first;
+            uint32_t count;
+            int err = Longtail_FindVersionIndexPaths(state_version_index, path_directory, path, &first, &count);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_FindVersionIndexPaths() failed with %d", err)
+                Longtail_Free(tmp_mem);
+                Longtail_Free(path_directory);
+                return err;
+            }
+            if (count > 0 && strcmp(&state_version_index->m_NameData[state_version_index->m_NameOffsets[path_directory[first]]], path) == 0)
+            {
+                state_asset_index = path_directory[first];
+            }
+        }
+        int unchanged = 0;
+        if (state_asset_index != 0xffffffffu &&
+            state_version_index->m_AssetSizes[state_asset_index] == size &&
+            state_version_index->m_Permissions[state_asset_index] == permissions)
         {
-            out_unique_hash_indexes[unique_hash_count++] = i;
+            if (IsDirPath(path))
+            {
+                unchanged = 1;
+            }
+            else if (folder_state->m_ModificationTimes[state_asset_index] != 0)
+            {
+                char* full_path = storage_api->ConcatPath(storage_api, root_path, path);
+                uint64_t stat_size;
+                uint64_t modification_time;
+                uint64_t change_time;
+                uint64_t file_id;
+                int err = storage_api->GetFileStat(storage_api, full_path, &stat_size, &modification_time, &change_time, &file_id);
+                Longtail_Free(full_path);
+                // A file modified in the same timestamp tick as the folder state was written is racy, it could have
+                // been changed again after it was stat'ed without its modification time changing
+                unchanged = (err == 0) &&
+                    stat_size == size &&
+                    modification_time == folder_state->m_ModificationTimes[state_asset_index] &&
+                    modification_time < folder_state->m_WriteTime &&
+                    change_time == folder_state->m_ChangeTimes[state_asset_index] &&
+                    file_id == folder_state->m_FileIds[state_asset_index];
+            }
         }
-        else
+        if (unchanged)
         {
-            // Take the last chunk hash we find
-            out_unique_hash_indexes[*lookup_index] = i;
+            reuse_asset[state_asset_index] = 1;
+            ++reused_count;
+            continue;
         }
+        changed_paths[changed_count] = path;
+        changed_sizes[changed_count] = size;
+        changed_permissions[changed_count] = permissions;
+        changed_tags[changed_count] = optional_asset_tags ? optional_asset_tags[f] : 0;
+        ++changed_count;
     }
-    Longtail_Free(lookup_table);
-    lookup_table = 0;
-    return unique_hash_count;
+    Longtail_Free(path_directory);
+
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "reusing %u of %u assets from folder state, hashing %u assets", reused_count, file_count, changed_count)
+
+    struct Longtail_VersionIndex* reused_version_index;
+    int err = CreateVersionIndexSubset(state_version_index, reuse_asset, &reused_version_index);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateVersionIndexSubset() failed with %d", err)
+        Longtail_Free(tmp_mem);
+        return err;
+    }
+    if (changed_count == 0 && can_reuse)
+    {
+        Longtail_Free(tmp_mem);
+        *out_version_index = reused_version_index;
+        return 0;
+    }
+
+    struct Longtail_FileInfos* changed_file_infos;
+    err = LongtailPrivate_MakeFileInfos(changed_count, changed_count ? changed_paths : 0, changed_count ? changed_sizes : 0, changed_count ? changed_permissions : 0, &changed_file_infos);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_MakeFileInfos() failed with %d", err)
+        Longtail_Free(reused_version_index);
+        Longtail_Free(tmp_mem);
+        return err;
+    }
+    struct Longtail_VersionIndex* changed_version_index;
+    err = Longtail_CreateVersionIndex(
+        storage_api,
+        hash_api,
+        chunker_api,
+        job_api,
+        progress_api,
+        optional_cancel_api,
+        optional_cancel_token,
+        root_path,
+        changed_file_infos,
+        changed_tags,
+        target_chunk_size,
+        enable_file_map,
+        &changed_version_index);
+    Longtail_Free(changed_file_infos);
+    Longtail_Free(tmp_mem);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_INFO : LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateVersionIndex() failed with %d", err)
+        Longtail_Free(reused_version_index);
+        return err;
+    }
+    if (reused_count == 0)
+    {
+        Longtail_Free(reused_version_index);
+        *out_version_index = changed_version_index;
+        return 0;
+    }
+
+    err = Longtail_MergeVersionIndex(reused_version_index, changed_version_index, out_version_index);
+    Longtail_Free(changed_version_index);
+    Longtail_Free(reused_version_index);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_MergeVersionIndex() failed with %d", err)
+        return err;
+    }
+    return 0;
 }
 
-int Longtail_GetRequiredChunkHashes(
+int Longtail_WriteVersionIndexToBuffer(
     const struct Longtail_VersionIndex* version_index,
-    const struct Longtail_VersionDiff* version_diff,
-    uint32_t* out_chunk_count,
-    TLongtail_Hash* out_chunk_hashes)
+    void** out_buffer,
+    size_t* out_size)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(version_index, "%p"),
-        LONGTAIL_LOGFIELD(version_diff, "%p"),
-        LONGTAIL_LOGFIELD(out_chunk_count, "%p"),
-        LONGTAIL_LOGFIELD(out_chunk_hashes, "%p")
+        LONGTAIL_LOGFIELD(out_buffer, "%p"),
+        LONGTAIL_LOGFIELD(out_size, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-
     LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_diff != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_chunk_count != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, (*version_index->m_ChunkCount == 0) ||  out_chunk_hashes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_buffer != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_size != 0, return EINVAL)
 
-    uint32_t max_chunk_count = *version_index->m_ChunkCount;
-    void* work_mem = Longtail_Alloc("GetRequiredChunkHashes", LongtailPrivate_LookupTable_GetSize(max_chunk_count));
-    if (!work_mem)
+    size_t index_data_size = Longtail_GetVersionIndexDataSize(*version_index->m_AssetCount, *version_index->m_ChunkCount, *version_index->m_AssetChunkIndexCount, version_index->m_NameDataSize);
+    *out_buffer = Longtail_Alloc("WriteVersionIndexToBuffer", index_data_size);
+    if (!(*out_buffer))
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
         return ENOMEM;
     }
+    memcpy(*out_buffer, version_index->m_Version, index_data_size);
+    *out_size = index_data_size;
+    return 0;
+}
 
-    struct Longtail_LookupTable* chunk_lookup = LongtailPrivate_LookupTable_Create(work_mem, max_chunk_count, 0);
+int Longtail_WriteVersionIndex(
+    struct Longtail_StorageAPI* storage_api,
+    struct Longtail_VersionIndex* version_index,
+    const char* path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
 
-    uint32_t chunk_count = 0;
+    size_t index_data_size = Longtail_GetVersionIndexDataSize(*version_index->m_AssetCount, *version_index->m_ChunkCount, *version_index->m_AssetChunkIndexCount, version_index->m_NameDataSize);
 
-    uint32_t added_asset_count = *version_diff->m_TargetAddedCount;
-    for (uint32_t a = 0; a < added_asset_count; ++a)
+    int err = EnsureParentPathExists(storage_api, path);
+    if (err)
     {
-        uint32_t asset_index = version_diff->m_TargetAddedAssetIndexes[a];
-        uint32_t asset_chunk_count = version_index->m_AssetChunkCounts[asset_index];
-        uint32_t asset_chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
-        for (uint32_t ci = 0; ci < asset_chunk_count; ++ci)
-        {
-            uint32_t chunk_index = version_index->m_AssetChunkIndexes[asset_chunk_index_start + ci];
-            TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
-            if (0 == LongtailPrivate_LookupTable_PutUnique(chunk_lookup, chunk_hash, chunk_count))
-            {
-                out_chunk_hashes[chunk_count] = chunk_hash;
-                ++chunk_count;
-            }
-        }
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed with %d", err)
+        return err;
     }
-    uint32_t modified_asset_count = *version_diff->m_ModifiedContentCount;
-    for (uint32_t a = 0; a < modified_asset_count; ++a)
+    Longtail_StorageAPI_HOpenFile file_handle;
+    err = storage_api->OpenWriteFile(storage_api, path, 0, &file_handle);
+    if (err)
     {
-        uint32_t asset_index = version_diff->m_TargetContentModifiedAssetIndexes[a];
-        uint32_t asset_chunk_count = version_index->m_AssetChunkCounts[asset_index];
-        uint32_t asset_chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
-        for (uint32_t ci = 0; ci < asset_chunk_count; ++ci)
-        {
-            uint32_t chunk_index = version_index->m_AssetChunkIndexes[asset_chunk_index_start + ci];
-            TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
-            if (0 == LongtailPrivate_LookupTable_PutUnique(chunk_lookup, chunk_hash, chunk_count))
-            {
-                out_chunk_hashes[chunk_count] = chunk_hash;
-                ++chunk_count;
-            }
-        }
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenWriteFile) failed with %d",err)
+        return err;
     }
 
-    Longtail_Free(work_mem);
-    *out_chunk_count = chunk_count;
+    err = storage_api->Write(storage_api, file_handle, 0, index_data_size, version_index->m_Version);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Write() failed with %d", err)
+        storage_api->CloseFile(storage_api, file_handle);
+        file_handle = 0;
+        return err;
+    }
+
+    storage_api->CloseFile(storage_api, file_handle);
+    file_handle = 0;
+
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "wrote %" PRIu64 " bytes", index_data_size)
 
     return 0;
 }
 
-struct AssetPartLookup
+int Longtail_ReadVersionIndexFromBuffer(
+    const void* buffer,
+    size_t size,
+    struct Longtail_VersionIndex** out_version_index)
 {
-    uint64_t* m_AssetOffsets;
-    uint32_t* m_AssetIndexes;
-    uint32_t* m_ChunkIndexes;
-    uint32_t* m_Tags;
-    struct Longtail_LookupTable* m_ChunkHashToIndex;
-};
+    return Longtail_ReadVersionIndexFromBuffer2(buffer, size, 0, 0, out_version_index);
+}
 
-static int CreateAssetPartLookup(
-    struct Longtail_VersionIndex* version_index,
-    struct AssetPartLookup** out_assert_part_lookup)
+int Longtail_ReadVersionIndexFromBuffer2(
+    const void* buffer,
+    size_t size,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    struct Longtail_VersionIndex** out_version_index)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(version_index, "%p"),
-        LONGTAIL_LOGFIELD(out_assert_part_lookup, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(out_version_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+    LONGTAIL_VALIDATE_INPUT(ctx, buffer != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, size != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_version_index != 0, return EINVAL)
 
-    LONGTAIL_FATAL_ASSERT(ctx, version_index != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, out_assert_part_lookup != 0, return EINVAL)
+    if (IsCompactIndex(LONGTAIL_COMPACT_VERSION_INDEX_MAGIC, buffer, size))
+    {
+        int err = ReadCompactVersionIndex(optional_compression_registry, optional_job_api, buffer, size, out_version_index);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ReadCompactVersionIndex() failed with %d", err)
+            return err;
+        }
+        return 0;
+    }
 
-    uint32_t asset_chunk_index_count = *version_index->m_AssetChunkIndexCount;
-    size_t asset_part_lookup_size =
-        sizeof(struct AssetPartLookup) +
-        sizeof(uint64_t) * asset_chunk_index_count +
-        sizeof(uint32_t) * asset_chunk_index_count +
-        sizeof(uint32_t) * asset_chunk_index_count +
-        sizeof(uint32_t) * asset_chunk_index_count +
-        LongtailPrivate_LookupTable_GetSize(asset_chunk_index_count);
-    struct AssetPartLookup* asset_part_lookup = (struct AssetPartLookup*)Longtail_Alloc("CreateAssetPartLookup", asset_part_lookup_size);
-    if (!asset_part_lookup_size)
+    size_t version_index_size = sizeof(struct Longtail_VersionIndex) + size;
+    struct Longtail_VersionIndex* version_index = (struct Longtail_VersionIndex*)Longtail_Alloc("ReadVersionIndexFromBuffer", version_index_size);
+    if (!version_index)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
         return ENOMEM;
     }
-    char* p = (char*)&asset_part_lookup[1];
-
-    asset_part_lookup->m_AssetOffsets = (uint64_t*)p;
-    p += sizeof(uint64_t) * asset_chunk_index_count;
-
-    asset_part_lookup->m_AssetIndexes = (uint32_t*)p;
-    p += sizeof(uint32_t) * asset_chunk_index_count;
-
-    asset_part_lookup->m_ChunkIndexes = (uint32_t*)p;
-    p += sizeof(uint32_t) * asset_chunk_index_count;
-
-    asset_part_lookup->m_Tags = (uint32_t*)p;
-    p += sizeof(uint32_t) * asset_chunk_index_count;
-
-    asset_part_lookup->m_ChunkHashToIndex = LongtailPrivate_LookupTable_Create(p, asset_chunk_index_count, 0);
-
-    uint32_t unique_chunk_count = 0;
-    uint32_t asset_count = *version_index->m_AssetCount;
-    for (uint32_t asset_index = 0; asset_index < asset_count; ++asset_index)
+    memcpy(&version_index[1], buffer, size);
+    int err = InitVersionIndexFromData(version_index, &version_index[1], size);
+    if (err)
     {
-        const char* path = &version_index->m_NameData[version_index->m_NameOffsets[asset_index]];
-        uint32_t asset_chunk_count = version_index->m_AssetChunkCounts[asset_index];
-        uint32_t asset_chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
-        uint64_t asset_chunk_offset = 0;
-        for (uint32_t asset_chunk_index = 0; asset_chunk_index < asset_chunk_count; ++asset_chunk_index)
-        {
-            LONGTAIL_FATAL_ASSERT(ctx, asset_chunk_index_start + asset_chunk_index < *version_index->m_AssetChunkIndexCount, return EINVAL)
-            uint32_t chunk_index = version_index->m_AssetChunkIndexes[asset_chunk_index_start + asset_chunk_index];
-            LONGTAIL_FATAL_ASSERT(ctx, chunk_index < *version_index->m_ChunkCount, return EINVAL)
-            uint32_t chunk_size = version_index->m_ChunkSizes[chunk_index];
-            TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
-            uint32_t tag = version_index->m_ChunkTags[chunk_index];
-            if (0 == LongtailPrivate_LookupTable_PutUnique(asset_part_lookup->m_ChunkHashToIndex, chunk_hash, unique_chunk_count))
-            {
-                asset_part_lookup->m_AssetOffsets[unique_chunk_count] = asset_chunk_offset;
-                asset_part_lookup->m_AssetIndexes[unique_chunk_count] = asset_index;
-                asset_part_lookup->m_ChunkIndexes[unique_chunk_count] = unique_chunk_count;
-                asset_part_lookup->m_Tags[unique_chunk_count] = tag;
-                unique_chunk_count++;
-            }
-            asset_chunk_offset += chunk_size;
-        }
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "InitVersionIndexFromData() failed with %d", err)
+        Longtail_Free(version_index);
+        return err;
     }
-    *out_assert_part_lookup = asset_part_lookup;
+    *out_version_index = version_index;
     return 0;
 }
 
-struct WriteBlockJob
+int Longtail_ReadVersionIndex(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    struct Longtail_VersionIndex** out_version_index)
 {
-    struct Longtail_AsyncPutStoredBlockAPI m_AsyncCompleteAPI;
-    struct Longtail_StorageAPI* m_SourceStorageAPI;
-    struct Longtail_BlockStoreAPI* m_BlockStoreAPI;
-    struct Longtail_JobAPI* m_JobAPI;
-    uint32_t m_JobID;
-    struct Longtail_StoredBlock* m_StoredBlock;
-    const char* m_AssetsFolder;
-    const struct Longtail_StoreIndex* m_StoreIndex;
-    const struct Longtail_VersionIndex* m_VersionIndex;
-    struct AssetPartLookup* m_AssetPartLookup;
-    uint32_t m_BlockIndex;
-    int m_PutStoredBlockErr;
-};
+    return Longtail_ReadVersionIndex2(storage_api, 0, 0, path, out_version_index);
+}
 
-static void BlockWriterJobOnComplete(struct Longtail_AsyncPutStoredBlockAPI* async_complete_api, int err)
+int Longtail_ReadVersionIndex2(
+    struct Longtail_StorageAPI* storage_api,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    const char* path,
+    struct Longtail_VersionIndex** out_version_index)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
-        LONGTAIL_LOGFIELD(err, "%d")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(out_version_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_version_index != 0, return EINVAL)
 
+    Longtail_StorageAPI_HOpenFile file_handle;
+    int err = storage_api->OpenReadFile(storage_api, path, &file_handle);
+    if (err != 0)
+    {
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_WARNING : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+        return err;
+    }
+    uint64_t version_index_data_size;
+    err = storage_api->GetSize(storage_api, file_handle, &version_index_data_size);
+    if (err != 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetSize() failed with %d", err)
+        return err;
+    }
+    size_t version_index_size = version_index_data_size + sizeof(struct Longtail_VersionIndex);
+    struct Longtail_VersionIndex* version_index = (struct Longtail_VersionIndex*)Longtail_Alloc("ReadVersionIndex", version_index_size);
+    if (!version_index)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(version_index);
+        storage_api->CloseFile(storage_api, file_handle);
+        return err;
+    }
+    err = storage_api->Read(storage_api, file_handle, 0, version_index_data_size, &version_index[1]);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BlockWriterJobOnComplete() caller failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
+        Longtail_Free(version_index);
+        storage_api->CloseFile(storage_api, file_handle);
+        return err;
     }
-    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api != 0, return)
-    struct WriteBlockJob* job = (struct WriteBlockJob*)async_complete_api;
-    LONGTAIL_FATAL_ASSERT(ctx, job->m_AsyncCompleteAPI.OnComplete != 0, return);
-    LONGTAIL_FATAL_ASSERT(ctx, job->m_StoredBlock != 0, return);
-    LONGTAIL_FATAL_ASSERT(ctx, job->m_JobID != 0, return);
-    uint32_t job_id = job->m_JobID;
-    SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
-    job->m_JobID = 0;
-    job->m_PutStoredBlockErr = err;
-    job->m_JobAPI->ResumeJob(job->m_JobAPI, job_id);
+    storage_api->CloseFile(storage_api, file_handle);
+    if (IsCompactIndex(LONGTAIL_COMPACT_VERSION_INDEX_MAGIC, &version_index[1], version_index_data_size))
+    {
+        struct Longtail_VersionIndex* compact_version_index = 0;
+        err = ReadCompactVersionIndex(optional_compression_registry, optional_job_api, &version_index[1], version_index_data_size, &compact_version_index);
+        Longtail_Free(version_index);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ReadCompactVersionIndex() failed with %d", err)
+            return err;
+        }
+        version_index = compact_version_index;
+    }
+    else
+    {
+        err = InitVersionIndexFromData(version_index, &version_index[1], version_index_data_size);
+    }
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "InitVersionIndexFromData() failed with %d", err)
+        Longtail_Free(version_index);
+        return err;
+    }
+
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Read version index containing %u assets in %u chunks",
+        *version_index->m_AssetCount, *version_index->m_ChunkCount)
+
+    *out_version_index = version_index;
+
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "read %" PRIu64 " bytes", version_index_data_size)
+
+    return 0;
 }
 
-static int DisposePutBlock(struct Longtail_StoredBlock* stored_block)
+size_t Longtail_GetBlockIndexDataSize(uint32_t chunk_count)
 {
 #if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(stored_block, "%p")
+        LONGTAIL_LOGFIELD(chunk_count, "%u")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 #else
     struct Longtail_LogContextFmt_Private* ctx = 0;
 #endif // defined(LONGTAIL_ASSERTS)
-
-    Longtail_Free(stored_block);
-    return 0;
+    return
+        sizeof(TLongtail_Hash) +                    // m_BlockHash
+        sizeof(uint32_t) +                          // m_HashIdentifier
+        sizeof(uint32_t) +                          // m_ChunkCount
+        sizeof(uint32_t) +                          // m_Tag
+        (sizeof(TLongtail_Hash) * chunk_count) +    // m_ChunkHashes
+        (sizeof(uint32_t) * chunk_count);           // m_ChunkSizes
 }
 
-static int WriteContentBlockJob(void* context, uint32_t job_id, int detected_error)
+struct Longtail_BlockIndex* Longtail_InitBlockIndex(void* mem, uint32_t chunk_count)
 {
 #if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(context, "%p"),
-        LONGTAIL_LOGFIELD(job_id, "%u"),
-        LONGTAIL_LOGFIELD(detected_error, "%d")
+        LONGTAIL_LOGFIELD(mem, "%p"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 #else
     struct Longtail_LogContextFmt_Private* ctx = 0;
 #endif // defined(LONGTAIL_ASSERTS)
+    LONGTAIL_VALIDATE_INPUT(ctx, mem != 0, return 0)
 
-    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return EINVAL)
-
-    struct WriteBlockJob* job = (struct WriteBlockJob*)context;
-    LONGTAIL_FATAL_ASSERT(ctx, job->m_JobID == 0, return EINVAL);
+    struct Longtail_BlockIndex* block_index = (struct Longtail_BlockIndex*)mem;
+    char* p = (char*)&block_index[1];
 
-    if (detected_error)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "WriteContentBlockJob aborted due to previous error %d", detected_error)
-        return 0;
-    }
+    block_index->m_BlockHash = (TLongtail_Hash*)(void*)p;
+    p += sizeof(TLongtail_Hash);
 
-    if (job->m_AsyncCompleteAPI.OnComplete)
-    {
-        // We got a notification so we are complete
-        job->m_AsyncCompleteAPI.OnComplete = 0;
-        LONGTAIL_MONITOR_BLOCK_SAVED(job->m_StoreIndex, job->m_BlockIndex, job->m_PutStoredBlockErr);
-        return job->m_PutStoredBlockErr;
-    }
+    block_index->m_HashIdentifier = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
 
-    LONGTAIL_MONTITOR_BLOCK_COMPOSE(job->m_StoreIndex, job->m_BlockIndex);
+    block_index->m_ChunkCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
 
-    struct Longtail_StorageAPI* source_storage_api = job->m_SourceStorageAPI;
-    struct Longtail_BlockStoreAPI* block_store_api = job->m_BlockStoreAPI;
+    block_index->m_Tag = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
 
-    const struct Longtail_StoreIndex* store_index = job->m_StoreIndex;
-
-    TLongtail_Hash block_hash = store_index->m_BlockHashes[job->m_BlockIndex];
+    block_index->m_ChunkHashes = (TLongtail_Hash*)(void*)p;
+    p += sizeof(TLongtail_Hash) * chunk_count;
 
-    uint32_t chunk_count = store_index->m_BlockChunkCounts[job->m_BlockIndex];
-    uint32_t first_chunk_index = store_index->m_BlockChunksOffsets[job->m_BlockIndex];
+    block_index->m_ChunkSizes = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * chunk_count;
 
-    uint32_t block_data_size = 0;
-    for (uint32_t chunk_index = first_chunk_index; chunk_index < first_chunk_index + chunk_count; ++chunk_index)
-    {
-        uint32_t chunk_size = store_index->m_ChunkSizes[chunk_index];
-        block_data_size += chunk_size;
-    }
+    return block_index;
+}
 
+struct Longtail_BlockIndex* Longtail_CopyBlockIndex(struct Longtail_BlockIndex* block_index)
+{
+    uint32_t chunk_count = *block_index->m_ChunkCount;
     size_t block_index_size = Longtail_GetBlockIndexSize(chunk_count);
-    size_t stored_block_size = sizeof(struct Longtail_StoredBlock);
-    size_t put_block_mem_size =
-        stored_block_size +
-        block_index_size +
-        block_data_size;
+    void* mem = Longtail_Alloc("Longtail_CopyBlockIndex", block_index_size);
+    struct Longtail_BlockIndex* copy_block_index = Longtail_InitBlockIndex(mem, chunk_count);
+    *copy_block_index->m_BlockHash = *block_index->m_BlockHash;
+    *copy_block_index->m_HashIdentifier = *block_index->m_HashIdentifier;
+    *copy_block_index->m_ChunkCount = *block_index->m_ChunkCount;
+    *copy_block_index->m_Tag = *block_index->m_Tag;
+    memcpy(copy_block_index->m_ChunkHashes, block_index->m_ChunkHashes, sizeof(TLongtail_Hash) * chunk_count);
+    memcpy(copy_block_index->m_ChunkSizes, block_index->m_ChunkSizes, sizeof(uint32_t) * chunk_count);
+    return copy_block_index;
+}
 
-    void* put_block_mem = Longtail_Alloc("WriteContentBlockJob", put_block_mem_size);
-    if (!put_block_mem)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM);
-        return ENOMEM;
-    }
+int Longtail_InitBlockIndexFromData(
+    struct Longtail_BlockIndex* block_index,
+    void* data,
+    uint64_t data_size)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_index, "%p"),
+        LONGTAIL_LOGFIELD(data, "%p"),
+        LONGTAIL_LOGFIELD(data_size, "%" PRIu64)
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+    LONGTAIL_VALIDATE_INPUT(ctx, block_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, data != 0, return EINVAL)
 
-    char* p = (char*)put_block_mem;
-    struct Longtail_StoredBlock* stored_block = (struct Longtail_StoredBlock*)p;
-    p += stored_block_size;
-    struct Longtail_BlockIndex* block_index_ptr = (struct Longtail_BlockIndex*)p;
-    p += block_index_size;
-    char* block_data_buffer = p;
+    char* p = (char*)data;
 
-    char* write_buffer = block_data_buffer;
+    block_index->m_BlockHash = (TLongtail_Hash*)(void*)p;
+    p += sizeof(TLongtail_Hash);
 
-    uint32_t last_asset_index = 0;
-    uint32_t path_name_offset = 0xffffffffu;
-    uint32_t tag = 0;
+    block_index->m_HashIdentifier = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
 
-    Longtail_StorageAPI_HOpenFile file_handle = 0;
-    uint64_t asset_file_size = 0;
-    uint32_t write_offset = 0;
+    block_index->m_ChunkCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
 
-    for (uint32_t chunk_index = first_chunk_index; chunk_index < first_chunk_index + chunk_count; ++chunk_index)
+    block_index->m_Tag = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    uint32_t chunk_count = *block_index->m_ChunkCount;
+
+    size_t block_index_data_size = Longtail_GetBlockIndexDataSize(chunk_count);
+    if (block_index_data_size > data_size)
     {
-        TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_index];
-        uint32_t chunk_size = store_index->m_ChunkSizes[chunk_index];
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Chunk count results in block index data %" PRIu64 " larger that data size (%" PRIu64 ")", block_index_data_size, data_size)
+        return EBADF;
+    }
 
-        uint32_t* asset_part_index = LongtailPrivate_LookupTable_Get(job->m_AssetPartLookup->m_ChunkHashToIndex, chunk_hash);
-        LONGTAIL_FATAL_ASSERT(ctx, asset_part_index != 0, return EINVAL)
-        uint32_t next_asset_index = *asset_part_index;
+    block_index->m_ChunkHashes = (TLongtail_Hash*)(void*)p;
+    p += sizeof(TLongtail_Hash) * chunk_count;
 
-        uint32_t next_tag = job->m_AssetPartLookup->m_Tags[next_asset_index];
-        if (path_name_offset != 0xffffffffu && tag != next_tag)
-        {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "WriteContentBlockJob(%p, %u, %d): Warning: Inconsistent tag type for chunks inside block 0x%" PRIx64 ", retaining 0x%" PRIx64 "",
-                context, job, job_id, detected_error,
-                block_hash, tag)
-        }
-        else
-        {
-            tag = next_tag;
-        }
+    block_index->m_ChunkSizes = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * chunk_count;
 
-        uint32_t asset_index = job->m_AssetPartLookup->m_AssetIndexes[next_asset_index];
-        uint32_t next_path_name_offset = job->m_VersionIndex->m_NameOffsets[asset_index];
-        if (next_path_name_offset != path_name_offset)
-        {
-            if (file_handle)
-            {
-                source_storage_api->CloseFile(source_storage_api, file_handle);
-                file_handle = 0;
-                LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_VersionIndex, last_asset_index);
-            }
-            const char* asset_path = &job->m_VersionIndex->m_NameData[next_path_name_offset];
-            LONGTAIL_FATAL_ASSERT(ctx, !IsDirPath(asset_path), return EINVAL)
+    return 0;
+}
 
-            char* full_path = source_storage_api->ConcatPath(source_storage_api, job->m_AssetsFolder, asset_path);
-            int err = source_storage_api->OpenReadFile(source_storage_api, full_path, &file_handle);
-            LONGTAIL_MONTITOR_ASSET_OPEN(job->m_VersionIndex, asset_index, err);
-            Longtail_Free(full_path);
-            full_path = 0;
-            if (err)
-            {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "source_storage_api->OpenReadFile() failed with %d", err);
-                Longtail_Free(put_block_mem);
-                return err;
-            }
-            last_asset_index = asset_index;
-            uint64_t next_asset_file_size = 0;
-            err = source_storage_api->GetSize(source_storage_api, file_handle, &next_asset_file_size);
-            if (err)
-            {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "source_storage_api->GetSize() failed with %d", err);
-                Longtail_Free(put_block_mem);
-                LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_VersionIndex, last_asset_index);
-                source_storage_api->CloseFile(source_storage_api, file_handle);
-                return err;
-            }
-            asset_file_size = next_asset_file_size;
-            path_name_offset = next_path_name_offset;
-        }
+size_t Longtail_GetBlockIndexSize(uint32_t chunk_count)
+{
+    size_t block_index_size =
+        sizeof(struct Longtail_BlockIndex) +
+        Longtail_GetBlockIndexDataSize(chunk_count);
 
-        uint64_t asset_offset = job->m_AssetPartLookup->m_AssetOffsets[next_asset_index];
-        if (asset_file_size < (asset_offset + chunk_size))
-        {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Source asset file does not match indexed size %" PRIu64 " < %" PRIu64,
-                asset_file_size, (asset_offset + chunk_size))
-            Longtail_Free(put_block_mem);
-            source_storage_api->CloseFile(source_storage_api, file_handle);
-            LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_VersionIndex, asset_index);
-            return EBADF;
-        }
-        int err = source_storage_api->Read(source_storage_api, file_handle, asset_offset, chunk_size, write_buffer + write_offset);
-        LONGTAIL_MONTITOR_ASSET_READ(job->m_StoreIndex, job->m_VersionIndex, asset_index, asset_offset, chunk_size, chunk_hash, job->m_BlockIndex, write_offset, err);
-        if (err)
-        {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "source_storage_api->Read() failed with %d", err);
-            Longtail_Free(put_block_mem);
-            source_storage_api->CloseFile(source_storage_api, file_handle);
-            LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_VersionIndex, last_asset_index);
-            return err;
-        }
-        write_offset += chunk_size;
-    }
+    return block_index_size;
+}
 
-    if (file_handle)
-    {
-        source_storage_api->CloseFile(source_storage_api, file_handle);
-        file_handle = 0;
-        LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_VersionIndex, last_asset_index);
-    }
+int Longtail_CreateBlockIndex(
+    struct Longtail_HashAPI* hash_api,
+    uint32_t tag,
+    uint32_t chunk_count,
+    const uint32_t* chunk_indexes,
+    const TLongtail_Hash* chunk_hashes,
+    const uint32_t* chunk_sizes,
+    struct Longtail_BlockIndex** out_block_index)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(hash_api, "%p"),
+        LONGTAIL_LOGFIELD(tag, "%u"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u"),
+        LONGTAIL_LOGFIELD(chunk_indexes, "%p"),
+        LONGTAIL_LOGFIELD(chunk_sizes, "%p"),
+        LONGTAIL_LOGFIELD(out_block_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-    Longtail_InitBlockIndex(block_index_ptr, chunk_count);
-    memmove(block_index_ptr->m_ChunkHashes, &store_index->m_ChunkHashes[first_chunk_index], sizeof(TLongtail_Hash) * chunk_count);
-    memmove(block_index_ptr->m_ChunkSizes, &store_index->m_ChunkSizes[first_chunk_index], sizeof(uint32_t) * chunk_count);
-    *block_index_ptr->m_BlockHash = block_hash;
-    *block_index_ptr->m_HashIdentifier = *store_index->m_HashIdentifier;
-    *block_index_ptr->m_Tag = tag;
-    *block_index_ptr->m_ChunkCount = chunk_count;
-    job->m_StoredBlock = stored_block;
-    job->m_StoredBlock->Dispose = DisposePutBlock;
-    job->m_StoredBlock->m_BlockIndex = block_index_ptr;
-    job->m_StoredBlock->m_BlockData = block_data_buffer;
-    job->m_StoredBlock->m_BlockChunksDataSize = block_data_size;
+    LONGTAIL_VALIDATE_INPUT(ctx, hash_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_indexes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_hashes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_sizes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_block_index != 0, return EINVAL)
 
-    job->m_JobID = job_id;
-    job->m_AsyncCompleteAPI.OnComplete = BlockWriterJobOnComplete;
+    size_t block_index_size = Longtail_GetBlockIndexSize(chunk_count);
+    void* mem = Longtail_Alloc("CreateBlockIndex", block_index_size);
+    if (mem == 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
 
-    LONGTAIL_MONITOR_BLOCK_SAVE(job->m_StoreIndex, job->m_BlockIndex, put_block_mem_size);
-    int err = block_store_api->PutStoredBlock(block_store_api, job->m_StoredBlock, &job->m_AsyncCompleteAPI);
-    if (err)
+    struct Longtail_BlockIndex* block_index = Longtail_InitBlockIndex(mem, chunk_count);
+    for (uint32_t i = 0; i < chunk_count; ++i)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_store_api->PutStoredBlock() failed with %d", err);
-        SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
-        job->m_JobID = 0;
-        LONGTAIL_MONITOR_BLOCK_SAVED(job->m_StoreIndex, job->m_BlockIndex, err);
+        uint32_t chunk_index = chunk_indexes[i];
+        block_index->m_ChunkHashes[i] = chunk_hashes[chunk_index];
+        block_index->m_ChunkSizes[i] = chunk_sizes[chunk_index];
+    }
+    size_t hash_buffer_size = sizeof(TLongtail_Hash) * chunk_count;
+    int err = hash_api->HashBuffer(hash_api, (uint32_t)(hash_buffer_size), (void*)block_index->m_ChunkHashes, block_index->m_BlockHash);
+    if (err != 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "hash_api->HashBuffer() failed with %d", err)
+        Longtail_Free(mem);
         return err;
     }
+    *block_index->m_HashIdentifier = hash_api->GetIdentifier(hash_api);
+    *block_index->m_Tag = tag;
+    *block_index->m_ChunkCount = chunk_count;
 
-    return EBUSY;
+    *out_block_index = block_index;
+    return 0;
 }
 
-int Longtail_WriteContent(
-    struct Longtail_StorageAPI* source_storage_api,
-    struct Longtail_BlockStoreAPI* block_store_api,
-    struct Longtail_JobAPI* job_api,
-    struct Longtail_ProgressAPI* progress_api,
-    struct Longtail_CancelAPI* optional_cancel_api,
-    Longtail_CancelAPI_HCancelToken optional_cancel_token,
-    struct Longtail_StoreIndex* store_index,
-    struct Longtail_VersionIndex* version_index,
-    const char* assets_folder)
+int Longtail_WriteBlockIndexToBuffer(
+    const struct Longtail_BlockIndex* block_index,
+    void** out_buffer,
+    size_t* out_size)
 {
+#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(source_storage_api, "%p"),
-        LONGTAIL_LOGFIELD(block_store_api, "%p"),
-        LONGTAIL_LOGFIELD(job_api, "%p"),
-        LONGTAIL_LOGFIELD(progress_api, "%p"),
-        LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
-        LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
-        LONGTAIL_LOGFIELD(store_index, "%p"),
-        LONGTAIL_LOGFIELD(version_index, "%p"),
-        LONGTAIL_LOGFIELD(assets_folder, "%s")
+        LONGTAIL_LOGFIELD(block_index, "%p"),
+        LONGTAIL_LOGFIELD(out_buffer, "%p"),
+        LONGTAIL_LOGFIELD(out_size, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, source_storage_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, job_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, assets_folder != 0, return EINVAL)
-
-    uint32_t block_count = *store_index->m_BlockCount;
-    if (block_count == 0)
-    {
-        return 0;
-    }
-
-    uint32_t version_chunk_count = *version_index->m_ChunkCount;
-    uint32_t version_store_index_chunk_count = *store_index->m_ChunkCount;
-
-    size_t chunk_lookup_size = LongtailPrivate_LookupTable_GetSize(version_chunk_count);
-    size_t chunk_sizes_size = sizeof(uint32_t) * version_store_index_chunk_count;
-    size_t write_block_jobs_size = sizeof(struct WriteBlockJob) * block_count;
-    size_t funcs_size = sizeof(Longtail_JobAPI_JobFunc*) * block_count;
-    size_t ctxs_size = sizeof(void*) * block_count;
-
-    size_t work_mem_size =
-        chunk_lookup_size +
-        chunk_sizes_size +
-        write_block_jobs_size +
-        funcs_size +
-        ctxs_size;
+    LONGTAIL_VALIDATE_INPUT(ctx, block_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_buffer != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_size != 0, return EINVAL)
 
-    void* work_mem = Longtail_Alloc("WriteContent", work_mem_size);
-    if (!work_mem)
+    size_t index_data_size = Longtail_GetBlockIndexDataSize(*block_index->m_ChunkCount);
+    *out_buffer = Longtail_Alloc("WriteBlockIndexToBuffer", index_data_size);
+    if (!(*out_buffer))
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
         return ENOMEM;
     }
+    memcpy(*out_buffer, block_index->m_BlockHash, index_data_size);
+    *out_size = index_data_size;
+    return 0;
+}
 
-    char* p = (char*)work_mem;
-
-    struct Longtail_LookupTable* chunk_lookup = LongtailPrivate_LookupTable_Create(p, version_chunk_count, 0);
-    p += chunk_lookup_size;
-    uint32_t* chunk_sizes = (uint32_t*)p;
-    p += chunk_sizes_size;
-    struct WriteBlockJob* write_block_jobs = (struct WriteBlockJob*)p;
-    p += write_block_jobs_size;
-    Longtail_JobAPI_JobFunc* funcs = (Longtail_JobAPI_JobFunc*)p;
-    p += funcs_size;
-    void** ctxs = (void**)p;
-    p += ctxs_size;
+int Longtail_ReadBlockIndexFromBuffer(
+    const void* buffer,
+    size_t size,
+    struct Longtail_BlockIndex** out_block_index)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(out_block_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-    for (uint32_t c = 0; c < version_chunk_count; ++c)
-    {
-        LongtailPrivate_LookupTable_Put(chunk_lookup, version_index->m_ChunkHashes[c], c);
-    }
+    LONGTAIL_VALIDATE_INPUT(ctx, buffer != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, size != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_block_index != 0, return EINVAL)
 
-    for (uint32_t c = 0; c < version_store_index_chunk_count; ++c)
+    size_t block_index_size = size + sizeof(struct Longtail_BlockIndex);
+    struct Longtail_BlockIndex* block_index = (struct Longtail_BlockIndex*)Longtail_Alloc("ReadBlockIndexFromBuffer", block_index_size);
+    if (!block_index)
     {
-        uint32_t* version_chunk_index = LongtailPrivate_LookupTable_Get(chunk_lookup, store_index->m_ChunkHashes[c]);
-        if (version_chunk_index == 0)
-        {
-            Longtail_Free(work_mem);
-            return EINVAL;
-        }
-        chunk_sizes[c] = version_index->m_ChunkSizes[*version_chunk_index];
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
     }
-
-    struct AssetPartLookup* asset_part_lookup;
-    int err = CreateAssetPartLookup(version_index, &asset_part_lookup);
+    memcpy(&block_index[1], buffer, size);
+    int err = Longtail_InitBlockIndexFromData(block_index, &block_index[1], size);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateAssetPartLookup() failed with %d", err)
-        Longtail_Free(work_mem);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitBlockIndexFromData() failed with %d", err)
+        Longtail_Free(block_index);
         return err;
     }
+    *out_block_index = block_index;
+    return 0;
+}
 
-    uint32_t job_count = 0;
-    for (uint32_t block_index = 0; block_index < block_count; ++block_index)
-    {
-        TLongtail_Hash block_hash = store_index->m_BlockHashes[block_index];
-
-        struct WriteBlockJob* job = &write_block_jobs[job_count];
-        job->m_AsyncCompleteAPI.m_API.Dispose = 0;
-        job->m_AsyncCompleteAPI.OnComplete = 0;
-        job->m_SourceStorageAPI = source_storage_api;
-        job->m_BlockStoreAPI = block_store_api;
-        job->m_JobAPI = job_api;
-        job->m_JobID = 0;
-        job->m_StoredBlock = 0;
-        job->m_AssetsFolder = assets_folder;
-        job->m_StoreIndex = store_index;
-        job->m_VersionIndex = version_index;
-        job->m_BlockIndex = block_index;
-        job->m_AssetPartLookup = asset_part_lookup;
-
-        funcs[job_count] = WriteContentBlockJob;
-        ctxs[job_count] = job;
+int Longtail_WriteBlockIndex(
+    struct Longtail_StorageAPI* storage_api,
+    struct Longtail_BlockIndex* block_index,
+    const char* path)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(block_index, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-        ++job_count;
-    }
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, block_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
 
-    uint32_t jobs_submitted = 0;
-    err = Longtail_RunJobsBatched(
-        job_api,
-        progress_api,
-        optional_cancel_api,
-        optional_cancel_token,
-        job_count,
-        funcs,
-        ctxs,
-        &jobs_submitted);
+    int err = EnsureParentPathExists(storage_api, path);
     if (err)
     {
-        LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "Longtail_RunJobsBatched() failed with %d", err)
-        Longtail_Free(asset_part_lookup);
-        Longtail_Free(work_mem);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed with %d", err)
         return err;
     }
-
-    Longtail_Free(asset_part_lookup);
-    asset_part_lookup = 0;
-
+    Longtail_StorageAPI_HOpenFile file_handle;
+    err = storage_api->OpenWriteFile(storage_api, path, 0, &file_handle);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "WriteBlockJob() failed with %d", err)
-        Longtail_Free(work_mem);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenWriteFile) failed with %d", err)
+        return err;
+    }
+    size_t index_data_size = Longtail_GetBlockIndexDataSize(*block_index->m_ChunkCount);
+    err = storage_api->Write(storage_api, file_handle, 0, index_data_size, block_index->m_BlockHash);
+    if (err){
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Write() failed with %d", err)
+        storage_api->CloseFile(storage_api, file_handle);
+        file_handle = 0;
         return err;
     }
+    storage_api->CloseFile(storage_api, file_handle);
+
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "wrote %" PRIu64 " bytes", index_data_size)
 
-    Longtail_Free(work_mem);
     return 0;
 }
 
-struct BlockReaderJob
+struct Longtail_BlockIndexHeader
 {
-    struct Longtail_AsyncGetStoredBlockAPI m_AsyncCompleteAPI;
-    struct Longtail_BlockStoreAPI* m_BlockStoreAPI;
-    struct Longtail_JobAPI* m_JobAPI;
-    uint32_t m_JobID;
     TLongtail_Hash m_BlockHash;
-    struct Longtail_StoredBlock* m_StoredBlock;
-    int m_GetStoredBlockErr;
+    uint32_t m_HashIdentifier;
+    uint32_t m_ChunkCount;
+    uint32_t m_Tag;
 };
 
-void BlockReaderJobOnComplete(struct Longtail_AsyncGetStoredBlockAPI* async_complete_api, struct Longtail_StoredBlock* stored_block, int err)
+int Longtail_ReadBlockIndex(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    struct Longtail_BlockIndex** out_block_index)
 {
 #if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
-        LONGTAIL_LOGFIELD(stored_block, "%p"),
-        LONGTAIL_LOGFIELD(err, "%d")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(out_block_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 #else
     struct Longtail_LogContextFmt_Private* ctx = 0;
 #endif // defined(LONGTAIL_ASSERTS)
 
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_block_index != 0, return EINVAL)
+
+    Longtail_StorageAPI_HOpenFile f;
+    int err = storage_api->OpenReadFile(storage_api, path, &f);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BlockReaderJobOnComplete() failed with %d", err)
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_WARNING : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+        return err;
     }
-    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api != 0, return)
-    struct BlockReaderJob* job = (struct BlockReaderJob*)async_complete_api;
-    LONGTAIL_FATAL_ASSERT(ctx, job->m_AsyncCompleteAPI.OnComplete != 0, return);
-    job->m_GetStoredBlockErr = err;
-    job->m_StoredBlock = stored_block;
-    job->m_JobAPI->ResumeJob(job->m_JobAPI, job->m_JobID);
-}
-
-static int BlockReader(void* context, uint32_t job_id, int detected_error)
-{
-#if defined(LONGTAIL_ASSERTS)
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(context, "%p"),
-        LONGTAIL_LOGFIELD(job_id, "%u"),
-        LONGTAIL_LOGFIELD(detected_error, "%d")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
-
-    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return EINVAL)
+    uint64_t block_size;
+    err = storage_api->GetSize(storage_api, f, &block_size);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetSize() failed with %d", err)
+        storage_api->CloseFile(storage_api, f);
+        return err;
+    }
+    if (block_size < sizeof(struct Longtail_BlockIndexHeader))
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "file size %" PRIu64 " is to small, expected at least %" PRIu64 " bytes", block_size, sizeof(struct Longtail_BlockIndexHeader))
+        storage_api->CloseFile(storage_api, f);
+        return EBADF;
+    }
+    if (block_size > 0xffffffff)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "file size %" PRIu64 " is to large, size can be at most %" PRIu64 " bytes", block_size, 0xffffffff)
+        storage_api->CloseFile(storage_api, f);
+        return EBADF;
+    }
+    uint64_t read_offset = 0;
 
-    struct BlockReaderJob* job = (struct BlockReaderJob*)context;
+    struct Longtail_BlockIndexHeader blockIndexHeader;
+    err = storage_api->Read(storage_api, f, read_offset, sizeof(struct Longtail_BlockIndexHeader), &blockIndexHeader);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
+        storage_api->CloseFile(storage_api, f);
+        return err;
+    }
+    read_offset += sizeof(struct Longtail_BlockIndexHeader);
 
-    if (detected_error)
+    if (blockIndexHeader.m_ChunkCount == 0)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "BlockReader aborted due to previous error %d", detected_error)
-        return 0;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "blockIndexHeader.m_ChunkCount (%u) must be larger than zero", blockIndexHeader.m_ChunkCount)
+        storage_api->CloseFile(storage_api, f);
+        return EBADF;
     }
 
-    if (job->m_AsyncCompleteAPI.OnComplete)
+    uint32_t block_index_data_size = (uint32_t)Longtail_GetBlockIndexDataSize(blockIndexHeader.m_ChunkCount);
+    if (block_index_data_size >= block_size)
     {
-        // We got a notification so we are complete
-        job->m_AsyncCompleteAPI.OnComplete = 0;
-        return job->m_GetStoredBlockErr;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_index_data_size %" PRIu64 " is to large, size can be at most %" PRIu64 " bytes", block_index_data_size, block_size)
+        storage_api->CloseFile(storage_api, f);
+        return EBADF;
     }
 
-    job->m_JobID = job_id;
-    job->m_StoredBlock = 0;
-    job->m_AsyncCompleteAPI.OnComplete = BlockReaderJobOnComplete;
-    
-    int err = job->m_BlockStoreAPI->GetStoredBlock(job->m_BlockStoreAPI, job->m_BlockHash, &job->m_AsyncCompleteAPI);
+    size_t block_index_size = Longtail_GetBlockIndexSize(blockIndexHeader.m_ChunkCount);
+    void* block_index_mem = Longtail_Alloc("ReadBlockIndex", block_index_size);
+    if (!block_index_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        storage_api->CloseFile(storage_api, f);
+        return ENOMEM;
+    }
+    struct Longtail_BlockIndex* block_index = Longtail_InitBlockIndex(block_index_mem, blockIndexHeader.m_ChunkCount);
+    err = storage_api->Read(storage_api, f, 0, block_index_data_size, &block_index[1]);
     if (err)
     {
-        LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job->m_BlockStoreAPI->GetStoredBlock() failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
+        Longtail_Free(block_index);
+        storage_api->CloseFile(storage_api, f);
         return err;
     }
-    return EBUSY;
+    storage_api->CloseFile(storage_api, f);
+    *out_block_index = block_index;
+
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "read %" PRIu64 " bytes", sizeof(struct Longtail_BlockIndexHeader) + block_index_data_size)
+
+    return 0;
 }
 
-static int WriteReady(void* context, uint32_t job_id, int detected_error)
+static int DisposeStoredBlock(struct Longtail_StoredBlock* stored_block)
 {
-    // Nothing to do here, we are just a syncronization point
+    Longtail_Free(stored_block);
     return 0;
 }
 
-#define MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE  32u
+size_t Longtail_GetStoredBlockSize(size_t block_data_size)
+{
+    return sizeof(struct Longtail_StoredBlock) + sizeof(struct Longtail_BlockIndex) + block_data_size;
+}
 
-struct WritePartialAssetFromBlocksJob
+int Longtail_InitStoredBlockFromData(
+    struct Longtail_StoredBlock* stored_block,
+    void* block_data,
+    size_t block_data_size)
 {
-    struct Longtail_StorageAPI* m_VersionStorageAPI;
-    struct Longtail_BlockStoreAPI* m_BlockStoreAPI;
-    struct Longtail_JobAPI* m_JobAPI;
-    struct Longtail_ProgressAPI* m_ProgressAPI;
-    struct Longtail_CancelAPI* m_OptionalCancelAPI;
-    Longtail_CancelAPI_HCancelToken m_OptionalCancelToken;
-    const struct Longtail_StoreIndex* m_StoreIndex;
-    const struct Longtail_VersionIndex* m_VersionIndex;
-    const char* m_VersionFolder;
-    struct Longtail_LookupTable* m_ChunkHashToBlockIndex;
-    uint32_t m_AssetIndex;
-    int m_RetainPermissions;
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(block_data, "%p"),
+        LONGTAIL_LOGFIELD(block_data_size, "%" PRIu64)
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-    Longtail_JobAPI_Group m_JobGroup;
-    struct BlockReaderJob m_BlockReaderJobs[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
-    uint32_t m_BlockReaderJobCount;
+    LONGTAIL_VALIDATE_INPUT(ctx, stored_block != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, block_data != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, block_data_size > 0, return EINVAL)
 
-    uint32_t m_AssetChunkIndexOffset;
-    uint32_t m_AssetChunkCount;
+    stored_block->m_BlockIndex = (struct Longtail_BlockIndex*)&stored_block[1];
+    int err = Longtail_InitBlockIndexFromData(
+        stored_block->m_BlockIndex,
+        block_data,
+        block_data_size);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitBlockIndexFromData() failed with %d", err)
+        return err;
+    }
+    size_t BlockIndexDataSize = Longtail_GetBlockIndexDataSize(*stored_block->m_BlockIndex->m_ChunkCount);
+    stored_block->m_BlockData = &((uint8_t*)block_data)[BlockIndexDataSize];
+    stored_block->m_BlockChunksDataSize = (uint32_t)(block_data_size - BlockIndexDataSize);
+    stored_block->Dispose = 0;
+    return 0;
+}
 
-    Longtail_StorageAPI_HOpenFile m_AssetOutputFile;
-};
+int Longtail_CreateStoredBlock(
+    TLongtail_Hash block_hash,
+    uint32_t hash_identifier,
+    uint32_t chunk_count,
+    uint32_t tag,
+    TLongtail_Hash* chunk_hashes,
+    uint32_t* chunk_sizes,
+    uint32_t block_data_size,
+    struct Longtail_StoredBlock** out_stored_block)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_hash, "%" PRIx64),
+        LONGTAIL_LOGFIELD(hash_identifier, "%u"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u"),
+        LONGTAIL_LOGFIELD(tag, "%u"),
+        LONGTAIL_LOGFIELD(chunk_hashes, "%p"),
+        LONGTAIL_LOGFIELD(chunk_sizes, "%p"),
+        LONGTAIL_LOGFIELD(block_data_size, "%u"),
+        LONGTAIL_LOGFIELD(out_stored_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-int WritePartialAssetFromBlocks(void* context, uint32_t job_id, int detected_error);
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || chunk_hashes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || chunk_sizes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_stored_block != 0, return EINVAL)
 
-static uint32_t GetMaxParallelBlockReadJobs(struct Longtail_JobAPI* job_api)
+    size_t block_index_size = Longtail_GetBlockIndexSize(chunk_count);
+    size_t stored_block_size = sizeof(struct Longtail_StoredBlock) + block_index_size + block_data_size;
+    struct Longtail_StoredBlock* stored_block = (struct Longtail_StoredBlock*)Longtail_Alloc("CreateStoredBlock", stored_block_size);
+    if (stored_block == 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    stored_block->m_BlockIndex = Longtail_InitBlockIndex(&stored_block[1], chunk_count);
+    LONGTAIL_FATAL_ASSERT(ctx, stored_block->m_BlockIndex != 0, return EINVAL)
+
+    *stored_block->m_BlockIndex->m_BlockHash = block_hash;
+    *stored_block->m_BlockIndex->m_HashIdentifier = hash_identifier;
+    *stored_block->m_BlockIndex->m_ChunkCount = chunk_count;
+    *stored_block->m_BlockIndex->m_Tag = tag;
+    memmove(stored_block->m_BlockIndex->m_ChunkHashes, chunk_hashes, sizeof(TLongtail_Hash) * chunk_count);
+    memmove(stored_block->m_BlockIndex->m_ChunkSizes, chunk_sizes, sizeof(uint32_t) * chunk_count);
+
+    stored_block->Dispose = DisposeStoredBlock;
+    stored_block->m_BlockData = ((uint8_t*)stored_block->m_BlockIndex) + block_index_size;
+    stored_block->m_BlockChunksDataSize = block_data_size;
+    *out_stored_block = stored_block;
+    return 0;
+}
+
+int Longtail_ValidateStoredBlockData(
+    const struct Longtail_StoredBlock* stored_block)
 {
-    uint32_t worker_count = job_api->GetWorkerCount(job_api);
-    if (worker_count > 2)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(stored_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, stored_block != 0, return EINVAL)
+
+    const struct Longtail_BlockIndex* block_index = stored_block->m_BlockIndex;
+    uint32_t chunk_count = *block_index->m_ChunkCount;
+    uint64_t block_chunks_size = 0;
+    for (uint32_t c = 0; c < chunk_count; ++c)
     {
-        worker_count--;
+        block_chunks_size += block_index->m_ChunkSizes[c];
     }
-    else if (worker_count == 0)
+    if (block_chunks_size != stored_block->m_BlockChunksDataSize)
     {
-        worker_count = 1;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Block 0x%" PRIx64 " has %u bytes of data but its chunks are %" PRIu64 " bytes, it may be a delta block read without a delta block store, failed with %d",
+            *block_index->m_BlockHash, stored_block->m_BlockChunksDataSize, block_chunks_size, EBADF)
+        return EBADF;
     }
-    const uint32_t max_parallell_block_read_jobs = worker_count < MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE ? worker_count : MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE;
-    return max_parallell_block_read_jobs;
+    return 0;
 }
 
-// Returns the write sync task, or the write task if there is no need for reading new blocks
-static int CreatePartialAssetWriteJob(
-    struct Longtail_BlockStoreAPI* block_store_api,
-    struct Longtail_StorageAPI* version_storage_api,
-    struct Longtail_JobAPI* job_api,
-    struct Longtail_ProgressAPI* progress_api,
-    struct Longtail_CancelAPI* optional_cancel_api,
-    Longtail_CancelAPI_HCancelToken optional_cancel_token,
-    const struct Longtail_StoreIndex* store_index,
-    const struct Longtail_VersionIndex* version_index,
-    const char* version_folder,
-    struct Longtail_LookupTable* chunk_hash_to_block_index,
-    uint32_t asset_index,
-    int retain_permissions,
-    Longtail_JobAPI_Group job_group,
-    struct WritePartialAssetFromBlocksJob* job,
-    uint32_t asset_chunk_index_offset,
-    Longtail_StorageAPI_HOpenFile asset_output_file,
-    Longtail_JobAPI_Jobs* out_jobs)
+static int ReadStoredBlock_Dispose(struct Longtail_StoredBlock* stored_block)
 {
+#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(block_store_api, "%p"),
-        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
-        LONGTAIL_LOGFIELD(job_api, "%p"),
-        LONGTAIL_LOGFIELD(store_index, "%p"),
-        LONGTAIL_LOGFIELD(version_index, "%p"),
-        LONGTAIL_LOGFIELD(version_folder, "%s"),
-        LONGTAIL_LOGFIELD(chunk_hash_to_block_index, "%p"),
-        LONGTAIL_LOGFIELD(asset_index, "%u"),
-        LONGTAIL_LOGFIELD(retain_permissions, "%d"),
-        LONGTAIL_LOGFIELD(job_group, "%p"),
-        LONGTAIL_LOGFIELD(job, "%p"),
-        LONGTAIL_LOGFIELD(asset_chunk_index_offset, "%u"),
-        LONGTAIL_LOGFIELD(asset_output_file, "%p"),
-        LONGTAIL_LOGFIELD(out_jobs, "%p")
+        LONGTAIL_LOGFIELD(stored_block, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_FATAL_ASSERT(ctx, block_store_api !=0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, version_storage_api !=0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, job_api !=0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, store_index !=0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, version_index !=0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, version_folder !=0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, chunk_hash_to_block_index !=0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, asset_index < *version_index->m_AssetCount, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, job !=0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, out_jobs !=0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, stored_block, return EINVAL)
 
-    job->m_VersionStorageAPI = version_storage_api;
-    job->m_BlockStoreAPI = block_store_api;
-    job->m_JobAPI = job_api;
-    job->m_ProgressAPI = progress_api;
-    job->m_OptionalCancelAPI = optional_cancel_api;
-    job->m_OptionalCancelToken = optional_cancel_token;
-    job->m_StoreIndex = store_index;
-    job->m_VersionIndex = version_index;
-    job->m_VersionFolder = version_folder;
-    job->m_ChunkHashToBlockIndex = chunk_hash_to_block_index;
-    job->m_AssetIndex = asset_index;
-    job->m_JobGroup = job_group;
-    job->m_RetainPermissions = retain_permissions;
-    job->m_BlockReaderJobCount = 0;
-    job->m_AssetChunkIndexOffset = asset_chunk_index_offset;
-    job->m_AssetChunkCount = 0;
-    job->m_AssetOutputFile = asset_output_file;
+    Longtail_Free(stored_block);
+    return 0;
+}
 
-    uint32_t chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
-    uint32_t chunk_start_index_offset = chunk_index_start + asset_chunk_index_offset;
-    uint32_t chunk_index_end = chunk_index_start + version_index->m_AssetChunkCounts[asset_index];
-    uint32_t chunk_index_offset = chunk_start_index_offset;
+int Longtail_WriteStoredBlockToBuffer(
+    const struct Longtail_StoredBlock* stored_block,
+    void** out_buffer,
+    size_t* out_size)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(out_buffer, "%p"),
+        LONGTAIL_LOGFIELD(out_size, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-    Longtail_JobAPI_JobFunc block_read_funcs[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
-    void* block_read_ctx[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
+    LONGTAIL_VALIDATE_INPUT(ctx, stored_block != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_buffer != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_size != 0, return EINVAL)
 
-    const uint32_t max_parallell_block_read_jobs = GetMaxParallelBlockReadJobs(job_api);
+    uint32_t chunk_count = *stored_block->m_BlockIndex->m_ChunkCount;
+    uint32_t block_index_data_size = (uint32_t)Longtail_GetBlockIndexDataSize(chunk_count);
 
-    while (chunk_index_offset != chunk_index_end && job->m_BlockReaderJobCount <= max_parallell_block_read_jobs)
-    {
-        uint32_t chunk_index = version_index->m_AssetChunkIndexes[chunk_index_offset];
-        TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
-        const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, chunk_hash);
-        LONGTAIL_FATAL_ASSERT(ctx, block_index_ptr, return EINVAL)
-        uint32_t block_index = *block_index_ptr;
-        TLongtail_Hash block_hash = store_index->m_BlockHashes[block_index];
-        int has_block = 0;
-        for (uint32_t d = 0; d < job->m_BlockReaderJobCount; ++d)
-        {
-            if (job->m_BlockReaderJobs[d].m_BlockHash == block_hash)
-            {
-                has_block = 1;
-                break;
-            }
-        }
-        if (!has_block)
-        {
-            if (job->m_BlockReaderJobCount == max_parallell_block_read_jobs)
-            {
-                break;
-            }
-            struct BlockReaderJob* block_job = &job->m_BlockReaderJobs[job->m_BlockReaderJobCount];
-            block_job->m_BlockStoreAPI = block_store_api;
-            block_job->m_BlockHash = block_hash;
-            block_job->m_AsyncCompleteAPI.m_API.Dispose = 0;
-            block_job->m_AsyncCompleteAPI.OnComplete = 0;
-            block_job->m_JobAPI = job_api;
-            block_job->m_JobID = 0;
-            block_job->m_StoredBlock = 0;
-            block_read_funcs[job->m_BlockReaderJobCount] = BlockReader;
-            block_read_ctx[job->m_BlockReaderJobCount] = block_job;
-            ++job->m_BlockReaderJobCount;
-        }
-        ++job->m_AssetChunkCount;
-        ++chunk_index_offset;
-    }
+    size_t size = ((size_t)block_index_data_size) + stored_block->m_BlockChunksDataSize;
 
-    Longtail_JobAPI_JobFunc write_funcs[1] = { WritePartialAssetFromBlocks };
-    void* write_ctx[1] = { job };
-    Longtail_JobAPI_Jobs write_job;
-    int err = job_api->CreateJobs(job_api, job_group, progress_api, optional_cancel_api, optional_cancel_token, 1, write_funcs, write_ctx, 0, &write_job);
-    if (err)
+    void* mem = (uint8_t*)Longtail_Alloc("WriteStoredBlockToBuffer", size);
+    if (!mem)
     {
-        LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job_api->CreateJobs() failed with %d", err)
-        return err;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
     }
+    uint8_t* write_ptr = (uint8_t*)mem;
 
-    if (job->m_BlockReaderJobCount > 0)
-    {
-        Longtail_JobAPI_Jobs block_read_jobs;
-        err = job_api->CreateJobs(job_api, job_group, progress_api, optional_cancel_api, optional_cancel_token, job->m_BlockReaderJobCount, block_read_funcs, block_read_ctx, 1, &block_read_jobs);
-        if (err)
-        {
-            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job_api->CreateJobs() failed with %d", err)
-            return err;
-        }
-        Longtail_JobAPI_JobFunc sync_write_funcs[1] = { WriteReady };
-        void* sync_write_ctx[1] = { 0 };
-        Longtail_JobAPI_Jobs write_sync_job;
-        err = job_api->CreateJobs(job_api, job_group, progress_api, optional_cancel_api, optional_cancel_token, 1, sync_write_funcs, sync_write_ctx, 0, &write_sync_job);
-        if (err)
-        {
-            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job_api->CreateJobs() failed with %d", err)
-            return err;
-        }
+    memcpy(write_ptr, stored_block->m_BlockIndex->m_BlockHash, block_index_data_size);
+    write_ptr += block_index_data_size;
+    memcpy(write_ptr, stored_block->m_BlockData, stored_block->m_BlockChunksDataSize);
 
-        err = job_api->AddDependecies(job_api, 1, write_job, 1, write_sync_job);
-        LONGTAIL_FATAL_ASSERT(ctx, err == 0, return err)
-        err = job_api->AddDependecies(job_api, 1, write_job, job->m_BlockReaderJobCount, block_read_jobs);
-        LONGTAIL_FATAL_ASSERT(ctx, err == 0, return err)
-        err = job_api->ReadyJobs(job_api, job->m_BlockReaderJobCount, block_read_jobs);
-        LONGTAIL_FATAL_ASSERT(ctx, err == 0, return err)
+    *out_size = size;
+    *out_buffer = mem;
+    return 0;
+}
 
-        *out_jobs = write_sync_job;
-        return 0;
+int Longtail_ReadStoredBlockFromBuffer(
+    const void* buffer,
+    size_t size,
+    struct Longtail_StoredBlock** out_stored_block)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(out_stored_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, buffer != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_stored_block != 0, return EINVAL)
+
+    size_t block_mem_size = Longtail_GetStoredBlockSize(size);
+    struct Longtail_StoredBlock* stored_block = (struct Longtail_StoredBlock*)Longtail_Alloc("ReadStoredBlockFromBuffer", block_mem_size);
+    if (!stored_block)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
     }
-    *out_jobs = write_job;
+    void* block_data = &((uint8_t*)stored_block)[block_mem_size - size];
+    memcpy(block_data, buffer, size);
+    int err = Longtail_InitStoredBlockFromData(
+        stored_block,
+        block_data,
+        size);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitStoredBlockFromData() failed with %d", err)
+        Longtail_Free(stored_block);
+        return err;
+    }
+    stored_block->Dispose = ReadStoredBlock_Dispose;
+    *out_stored_block = stored_block;
     return 0;
 }
 
-int WritePartialAssetFromBlocks(void* context, uint32_t job_id, int detected_error)
+int Longtail_WriteStoredBlock(
+    struct Longtail_StorageAPI* storage_api,
+    struct Longtail_StoredBlock* stored_block,
+    const char* path)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(context, "%p"),
-        LONGTAIL_LOGFIELD(job_id, "%u"),
-        LONGTAIL_LOGFIELD(detected_error, "%d")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-
-    LONGTAIL_FATAL_ASSERT(ctx, context !=0, return EINVAL)
-    struct WritePartialAssetFromBlocksJob* job = (struct WritePartialAssetFromBlocksJob*)context;
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    uint32_t block_reader_job_count = job->m_BlockReaderJobCount;
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, stored_block != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
 
-    if ((!job->m_AssetOutputFile) && job->m_AssetChunkIndexOffset)
+    Longtail_StorageAPI_HOpenFile block_file_handle;
+    int err = storage_api->OpenWriteFile(storage_api, path, 0, &block_file_handle);
+    if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "WritePartialAssetFromBlocks(%p, %u, %d) aborted due to previous error %d",
-            context, job, job_id, detected_error, detected_error)
-        for (uint32_t d = 0; d < block_reader_job_count; ++d)
-        {
-            SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReaderJobs[d].m_StoredBlock);
-        }
-        return 0;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenWriteFile() failed with %d", err)
+        return err;
     }
-
-    if (detected_error)
+    uint32_t write_offset = 0;
+    uint32_t chunk_count = *stored_block->m_BlockIndex->m_ChunkCount;
+    uint32_t block_index_data_size = (uint32_t)Longtail_GetBlockIndexDataSize(chunk_count);
+    err = storage_api->Write(storage_api, block_file_handle, write_offset, block_index_data_size, stored_block->m_BlockIndex->m_BlockHash);
+    if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "WritePartialAssetFromBlocks aborted due to previous error %d", detected_error)
-
-        for (uint32_t d = 0; d < block_reader_job_count; ++d)
-        {
-            SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReaderJobs[d].m_StoredBlock);
-        }
-        if (job->m_AssetOutputFile)
-        {
-            job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
-            job->m_AssetOutputFile = 0;
-        }
-        return 0;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Write() failed with %d", err)
+        return err;
     }
+    write_offset += block_index_data_size;
 
-    // Need to fetch all the data we need from the context since we will reuse the context
-    int block_reader_errors = 0;
-    TLongtail_Hash block_hashes[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
-    struct Longtail_StoredBlock* stored_block[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
-    for (uint32_t d = 0; d < block_reader_job_count; ++d)
+    err = storage_api->Write(storage_api, block_file_handle, write_offset, stored_block->m_BlockChunksDataSize, stored_block->m_BlockData);
+    if (err)
     {
-        if (job->m_BlockReaderJobs[d].m_GetStoredBlockErr)
-        {
-            block_reader_errors = block_reader_errors == 0 ? job->m_BlockReaderJobs[d].m_GetStoredBlockErr : block_reader_errors;
-            block_hashes[d] = 0;
-            stored_block[d] = 0;
-            continue;
-        }
-        block_hashes[d] = job->m_BlockReaderJobs[d].m_BlockHash;
-        stored_block[d] = job->m_BlockReaderJobs[d].m_StoredBlock;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Write() failed with %d", err)
+        storage_api->CloseFile(storage_api, block_file_handle);
+        return err;
     }
+    storage_api->CloseFile(storage_api, block_file_handle);
 
-    if (block_reader_errors)
-    {
-        LONGTAIL_LOG(ctx, (block_reader_errors == ECANCELED) ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "BlockRead() failed with %d", block_reader_errors)
-        for (uint32_t d = 0; d < block_reader_job_count; ++d)
-        {
-            if (stored_block[d] && stored_block[d]->Dispose)
-            {
-                stored_block[d]->Dispose(stored_block[d]);
-                stored_block[d] = 0;
-            }
-        }
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "wrote %u bytes", block_index_data_size + stored_block->m_BlockChunksDataSize)
 
-        if (job->m_AssetOutputFile)
-        {
-            job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
-            job->m_AssetOutputFile = 0;
-        }
-        return block_reader_errors;
+    return 0;
+}
+
+int Longtail_ReadStoredBlock(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    struct Longtail_StoredBlock** out_stored_block)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(out_stored_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_stored_block != 0, return EINVAL)
+
+    Longtail_StorageAPI_HOpenFile f;
+    int err = storage_api->OpenReadFile(storage_api, path, &f);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_INFO : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+        return err;
+    }
+    uint64_t stored_block_data_size;
+    err = storage_api->GetSize(storage_api, f, &stored_block_data_size);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetSize() failed with %d", err)
+        storage_api->CloseFile(storage_api, f);
+        return err;
+    }
+    size_t block_mem_size = Longtail_GetStoredBlockSize(stored_block_data_size);
+    struct Longtail_StoredBlock* stored_block = (struct Longtail_StoredBlock*)Longtail_Alloc("ReadStoredBlock", block_mem_size);
+    if (!stored_block)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        storage_api->CloseFile(storage_api, f);
+        return ENOMEM;
+    }
+    void* block_data = &((uint8_t*)stored_block)[block_mem_size - stored_block_data_size];
+    err = storage_api->Read(storage_api, f, 0, stored_block_data_size, block_data);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
+        Longtail_Free(stored_block);
+        storage_api->CloseFile(storage_api, f);
+        return err;
+    }
+    storage_api->CloseFile(storage_api, f);
+    err = Longtail_InitStoredBlockFromData(
+        stored_block,
+        block_data,
+        stored_block_data_size);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitStoredBlockFromData() failed with %d", err)
+        Longtail_Free(stored_block);
+        return err;
     }
+    stored_block->Dispose = ReadStoredBlock_Dispose;
+    *out_stored_block = stored_block;
 
-    uint32_t write_chunk_index_offset = job->m_AssetChunkIndexOffset;
-    uint32_t write_chunk_count = job->m_AssetChunkCount;
-    uint32_t asset_chunk_count = job->m_VersionIndex->m_AssetChunkCounts[job->m_AssetIndex];
-    const char* asset_path = &job->m_VersionIndex->m_NameData[job->m_VersionIndex->m_NameOffsets[job->m_AssetIndex]];
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "read %" PRIu64 " bytes", stored_block_data_size)
 
-    if (!job->m_AssetOutputFile)
+    return 0;
+}
+
+static uint32_t GetUniqueHashes(
+    struct Longtail_ScratchArena* scratch_arena,
+    uint32_t hash_count,
+    const TLongtail_Hash* hashes,
+    uint32_t* out_unique_hash_indexes)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(scratch_arena, "%p"),
+        LONGTAIL_LOGFIELD(hash_count, "%u"),
+        LONGTAIL_LOGFIELD(hashes, "%p"),
+        LONGTAIL_LOGFIELD(out_unique_hash_indexes, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_FATAL_ASSERT(ctx, hash_count != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, hashes != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, hash_count == 0 || out_unique_hash_indexes != 0, return 0)
+
+    size_t scratch_mark = Longtail_ScratchArena_GetMark(scratch_arena);
+    void* lookup_table_mem = Longtail_ScratchArena_Alloc(scratch_arena, LongtailPrivate_LookupTable_GetSize(hash_count));
+    if (!lookup_table_mem)
     {
-        char* full_asset_path = job->m_VersionStorageAPI->ConcatPath(job->m_VersionStorageAPI, job->m_VersionFolder, asset_path);
-        int err = EnsureParentPathExists(job->m_VersionStorageAPI, full_asset_path);
-        if (err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_Alloc() failed with %d", ENOMEM)
+        return 0;
+    }
+    struct Longtail_LookupTable* lookup_table = LongtailPrivate_LookupTable_Create(lookup_table_mem, hash_count, 0);
+
+    uint32_t unique_hash_count = 0;
+    for (uint32_t i = 0; i < hash_count; ++i)
+    {
+        TLongtail_Hash hash = hashes[i];
+        uint32_t* lookup_index = LongtailPrivate_LookupTable_PutUnique(lookup_table, hash, unique_hash_count);
+        if (lookup_index == 0)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed with %d", err)
-            Longtail_Free(full_asset_path);
-            for (uint32_t d = 0; d < block_reader_job_count; ++d)
-            {
-                stored_block[d]->Dispose(stored_block[d]);
-                stored_block[d] = 0;
-            }
-            return err;
+            out_unique_hash_indexes[unique_hash_count++] = i;
         }
-        if (IsDirPath(full_asset_path))
+        else
         {
-            // Remove trailing forward slash
-            full_asset_path[strlen(full_asset_path) - 1] = '\0';
-            err = job->m_VersionStorageAPI->CreateDir(job->m_VersionStorageAPI, full_asset_path);
-            if (err == EEXIST)
-            {
-                err = 0;
-            }
-            if (err != 0)
-            {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->CreateDir() failed with %d", err)
-                Longtail_Free(full_asset_path);
-                return err;
-            }
-            Longtail_Free(full_asset_path);
-            return err;
+            // Take the last chunk hash we find
+            out_unique_hash_indexes[*lookup_index] = i;
         }
+    }
+    Longtail_ScratchArena_ResetToMark(scratch_arena, scratch_mark);
+    return unique_hash_count;
+}
 
-        uint16_t permissions;
-        err = job->m_VersionStorageAPI->GetPermissions(job->m_VersionStorageAPI, full_asset_path, &permissions);
-        if (err && (err != ENOENT))
-        {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->GetPermissions() failed with %d", err)
-            Longtail_Free(full_asset_path);
-            for (uint32_t d = 0; d < block_reader_job_count; ++d)
-            {
-                stored_block[d]->Dispose(stored_block[d]);
-                stored_block[d] = 0;
-            }
-            return err;
-        }
+int Longtail_GetRequiredChunkHashes(
+    const struct Longtail_VersionIndex* version_index,
+    const struct Longtail_VersionDiff* version_diff,
+    uint32_t* out_chunk_count,
+    TLongtail_Hash* out_chunk_hashes)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(version_diff, "%p"),
+        LONGTAIL_LOGFIELD(out_chunk_count, "%p"),
+        LONGTAIL_LOGFIELD(out_chunk_hashes, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-        if (err != ENOENT)
-        {
-            if (!(permissions & Longtail_StorageAPI_UserWriteAccess))
-            {
-                err = job->m_VersionStorageAPI->SetPermissions(job->m_VersionStorageAPI, full_asset_path, permissions | (Longtail_StorageAPI_UserWriteAccess));
-                if (err)
-                {
-                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->SetPermissions() failed with %d", err)
-                    Longtail_Free(full_asset_path);
-                    for (uint32_t d = 0; d < block_reader_job_count; ++d)
-                    {
-                        stored_block[d]->Dispose(stored_block[d]);
-                        stored_block[d] = 0;
-                    }
-                    return err;
-                }
-            }
-        }
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_diff != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_chunk_count != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, (*version_index->m_ChunkCount == 0) ||  out_chunk_hashes != 0, return EINVAL)
 
-        uint64_t asset_size = job->m_VersionIndex->m_AssetSizes[job->m_AssetIndex];
-        err = job->m_VersionStorageAPI->OpenWriteFile(job->m_VersionStorageAPI, full_asset_path, asset_size, &job->m_AssetOutputFile);
-        if (err)
+    uint32_t max_chunk_count = *version_index->m_ChunkCount;
+    void* work_mem = Longtail_Alloc("GetRequiredChunkHashes", LongtailPrivate_LookupTable_GetSize(max_chunk_count));
+    if (!work_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+
+    struct Longtail_LookupTable* chunk_lookup = LongtailPrivate_LookupTable_Create(work_mem, max_chunk_count, 0);
+
+    uint32_t chunk_count = 0;
+
+    uint32_t added_asset_count = *version_diff->m_TargetAddedCount;
+    for (uint32_t a = 0; a < added_asset_count; ++a)
+    {
+        uint32_t asset_index = version_diff->m_TargetAddedAssetIndexes[a];
+        uint32_t asset_chunk_count = version_index->m_AssetChunkCounts[asset_index];
+        uint32_t asset_chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
+        for (uint32_t ci = 0; ci < asset_chunk_count; ++ci)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->OpenWriteFile() failed with %d", err)
-            Longtail_Free(full_asset_path);
-            for (uint32_t d = 0; d < block_reader_job_count; ++d)
+            uint32_t chunk_index = version_index->m_AssetChunkIndexes[asset_chunk_index_start + ci];
+            TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
+            if (0 == LongtailPrivate_LookupTable_PutUnique(chunk_lookup, chunk_hash, chunk_count))
             {
-                stored_block[d]->Dispose(stored_block[d]);
-                stored_block[d] = 0;
+                out_chunk_hashes[chunk_count] = chunk_hash;
+                ++chunk_count;
             }
-            return err;
         }
-        Longtail_Free(full_asset_path);
-        full_asset_path = 0;
     }
-
-    Longtail_JobAPI_Jobs sync_write_job = 0;
-    if (write_chunk_index_offset + write_chunk_count < asset_chunk_count)
+    uint32_t modified_asset_count = *version_diff->m_ModifiedContentCount;
+    for (uint32_t a = 0; a < modified_asset_count; ++a)
     {
-        int err = CreatePartialAssetWriteJob(
-            job->m_BlockStoreAPI,
-            job->m_VersionStorageAPI,
-            job->m_JobAPI,
-            job->m_ProgressAPI,
-            job->m_OptionalCancelAPI,
-            job->m_OptionalCancelToken,
-            job->m_StoreIndex,
-            job->m_VersionIndex,
-            job->m_VersionFolder,
-            job->m_ChunkHashToBlockIndex,
-            job->m_AssetIndex,
-            job->m_RetainPermissions,
-            job->m_JobGroup,
-            job,    // Reuse job
-            write_chunk_index_offset + write_chunk_count,
-            job->m_AssetOutputFile,
-            &sync_write_job);
-
-        if (err)
+        uint32_t asset_index = version_diff->m_TargetContentModifiedAssetIndexes[a];
+        uint32_t asset_chunk_count = version_index->m_AssetChunkCounts[asset_index];
+        uint32_t asset_chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
+        for (uint32_t ci = 0; ci < asset_chunk_count; ++ci)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreatePartialAssetWriteJob() failed with %d", err)
-            for (uint32_t d = 0; d < block_reader_job_count; ++d)
+            uint32_t chunk_index = version_index->m_AssetChunkIndexes[asset_chunk_index_start + ci];
+            TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
+            if (0 == LongtailPrivate_LookupTable_PutUnique(chunk_lookup, chunk_hash, chunk_count))
             {
-                stored_block[d]->Dispose(stored_block[d]);
-                stored_block[d] = 0;
+                out_chunk_hashes[chunk_count] = chunk_hash;
+                ++chunk_count;
             }
-            return err;
         }
-        // Reading of blocks will start immediately
     }
 
-    uint32_t chunk_index_offset = write_chunk_index_offset;
-    uint32_t chunk_index_start = job->m_VersionIndex->m_AssetChunkIndexStarts[job->m_AssetIndex];
+    Longtail_Free(work_mem);
+    *out_chunk_count = chunk_count;
 
-    uint64_t write_offset = 0;
-    for (uint32_t c = 0; c < chunk_index_offset; ++c)
-    {
-        uint32_t chunk_index = job->m_VersionIndex->m_AssetChunkIndexes[chunk_index_start + c];
-        uint32_t chunk_size = job->m_VersionIndex->m_ChunkSizes[chunk_index];
-        write_offset += chunk_size;
-    }
+    return 0;
+}
 
-    uint32_t block_chunks_count = 0;
-    for(uint32_t b = 0; b < block_reader_job_count; ++b)
-    {
-        struct Longtail_BlockIndex* block_index = stored_block[b]->m_BlockIndex;
-        block_chunks_count += *block_index->m_ChunkCount;
-    }
+struct AssetPartLookup
+{
+    uint64_t* m_AssetOffsets;
+    uint32_t* m_AssetIndexes;
+    uint32_t* m_ChunkIndexes;
+    uint32_t* m_Tags;
+    struct Longtail_LookupTable* m_ChunkHashToIndex;
+};
 
-    size_t block_chunks_lookup_size = LongtailPrivate_LookupTable_GetSize(block_chunks_count);
-    size_t chunk_sizes_size = sizeof(uint32_t) * block_chunks_count;
-    size_t chunk_offsets_size = sizeof(uint32_t) * block_chunks_count;
-    size_t block_indexes_size = sizeof(uint32_t) * block_chunks_count;
-    size_t buffer_size = 512*1024;
+static int CreateAssetPartLookup(
+    struct Longtail_VersionIndex* version_index,
+    struct AssetPartLookup** out_assert_part_lookup)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(out_assert_part_lookup, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 
-    size_t work_mem_size =
-        block_chunks_lookup_size +
-        chunk_sizes_size +
-        chunk_offsets_size +
-        block_indexes_size +
-        buffer_size;
-    void* work_mem = Longtail_Alloc("WritePartialAssetFromBlocks", work_mem_size);
-    if (!work_mem)
+    LONGTAIL_FATAL_ASSERT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, out_assert_part_lookup != 0, return EINVAL)
+
+    uint32_t asset_chunk_index_count = *version_index->m_AssetChunkIndexCount;
+    size_t asset_part_lookup_size =
+        sizeof(struct AssetPartLookup) +
+        sizeof(uint64_t) * asset_chunk_index_count +
+        sizeof(uint32_t) * asset_chunk_index_count +
+        sizeof(uint32_t) * asset_chunk_index_count +
+        sizeof(uint32_t) * asset_chunk_index_count +
+        LongtailPrivate_LookupTable_GetSize(asset_chunk_index_count);
+    struct AssetPartLookup* asset_part_lookup = (struct AssetPartLookup*)Longtail_Alloc("CreateAssetPartLookup", asset_part_lookup_size);
+    if (!asset_part_lookup_size)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        for (uint32_t d = 0; d < block_reader_job_count; ++d)
-        {
-            stored_block[d]->Dispose(stored_block[d]);
-            stored_block[d] = 0;
-        }
-        job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
-        job->m_AssetOutputFile = 0;
-        if (sync_write_job)
-        {
-            int err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
-            LONGTAIL_FATAL_ASSERT(ctx, err == 0, err = 0)
-        }
         return ENOMEM;
     }
-    char* p = (char*)work_mem;
-    struct Longtail_LookupTable* block_chunks_lookup = LongtailPrivate_LookupTable_Create(p, block_chunks_count, 0);
-    p += block_chunks_lookup_size;
-    uint32_t* chunk_sizes = (uint32_t*)p;
-    p += chunk_sizes_size;
-    uint32_t* chunk_offsets = (uint32_t*)p;
-    p += chunk_offsets_size;
-    uint32_t* block_indexes = (uint32_t*)p;
-    p += block_indexes_size;
-    char* buffer = p;
+    char* p = (char*)&asset_part_lookup[1];
 
-    uint32_t block_chunk_index_offset = 0;
-    for(uint32_t b = 0; b < block_reader_job_count; ++b)
-    {
-        uint32_t chunk_offset = 0;
-        struct Longtail_BlockIndex* block_index = stored_block[b]->m_BlockIndex;
-        for (uint32_t c = 0; c < *block_index->m_ChunkCount; ++c)
-        {
-            TLongtail_Hash chunk_hash = block_index->m_ChunkHashes[c];
-            uint32_t chunk_size = block_index->m_ChunkSizes[c];
-            chunk_sizes[block_chunk_index_offset] = chunk_size;
-            chunk_offsets[block_chunk_index_offset] = chunk_offset;
-            block_indexes[block_chunk_index_offset] = b;
-            chunk_offset += chunk_size;
+    asset_part_lookup->m_AssetOffsets = (uint64_t*)p;
+    p += sizeof(uint64_t) * asset_chunk_index_count;
 
-            LongtailPrivate_LookupTable_Put(block_chunks_lookup, chunk_hash, block_chunk_index_offset);
+    asset_part_lookup->m_AssetIndexes = (uint32_t*)p;
+    p += sizeof(uint32_t) * asset_chunk_index_count;
 
-            block_chunk_index_offset++;
-        }
-    }
+    asset_part_lookup->m_ChunkIndexes = (uint32_t*)p;
+    p += sizeof(uint32_t) * asset_chunk_index_count;
 
-    size_t buffer_used_size = 0;
-    uint32_t chunk_index_end = write_chunk_index_offset + write_chunk_count;
+    asset_part_lookup->m_Tags = (uint32_t*)p;
+    p += sizeof(uint32_t) * asset_chunk_index_count;
 
-    while (chunk_index_offset < chunk_index_end)
-    {
-        uint32_t asset_chunk_index = chunk_index_start + chunk_index_offset;
-        uint32_t chunk_index = job->m_VersionIndex->m_AssetChunkIndexes[asset_chunk_index];
-        TLongtail_Hash chunk_hash = job->m_VersionIndex->m_ChunkHashes[chunk_index];
+    asset_part_lookup->m_ChunkHashToIndex = LongtailPrivate_LookupTable_Create(p, asset_chunk_index_count, 0);
 
-        uint32_t* chunk_block_index = LongtailPrivate_LookupTable_Get(block_chunks_lookup, chunk_hash);
-        if (chunk_block_index == 0)
+    uint32_t unique_chunk_count = 0;
+    uint32_t asset_count = *version_index->m_AssetCount;
+    for (uint32_t asset_index = 0; asset_index < asset_count; ++asset_index)
+    {
+        const char* path = &version_index->m_NameData[version_index->m_NameOffsets[asset_index]];
+        uint32_t asset_chunk_count = version_index->m_AssetChunkCounts[asset_index];
+        uint32_t asset_chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
+        uint64_t asset_chunk_offset = 0;
+        for (uint32_t asset_chunk_index = 0; asset_chunk_index < asset_chunk_count; ++asset_chunk_index)
         {
-            for (uint32_t d = 0; d < block_reader_job_count; ++d)
-            {
-                stored_block[d]->Dispose(stored_block[d]);
-                stored_block[d] = 0;
-            }
-            job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
-            job->m_AssetOutputFile = 0;
-            if (sync_write_job)
+            LONGTAIL_FATAL_ASSERT(ctx, asset_chunk_index_start + asset_chunk_index < *version_index->m_AssetChunkIndexCount, return EINVAL)
+            uint32_t chunk_index = version_index->m_AssetChunkIndexes[asset_chunk_index_start + asset_chunk_index];
+            LONGTAIL_FATAL_ASSERT(ctx, chunk_index < *version_index->m_ChunkCount, return EINVAL)
+            uint32_t chunk_size = version_index->m_ChunkSizes[chunk_index];
+            TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
+            uint32_t tag = version_index->m_ChunkTags[chunk_index];
+            if (0 == LongtailPrivate_LookupTable_PutUnique(asset_part_lookup->m_ChunkHashToIndex, chunk_hash, unique_chunk_count))
             {
-                int err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
-                LONGTAIL_FATAL_ASSERT(ctx, err == 0, err = 0; return 0)
+                asset_part_lookup->m_AssetOffsets[unique_chunk_count] = asset_chunk_offset;
+                asset_part_lookup->m_AssetIndexes[unique_chunk_count] = asset_index;
+                asset_part_lookup->m_ChunkIndexes[unique_chunk_count] = unique_chunk_count;
+                asset_part_lookup->m_Tags[unique_chunk_count] = tag;
+                unique_chunk_count++;
             }
-            Longtail_Free(work_mem);
-            return EINVAL;
+            asset_chunk_offset += chunk_size;
         }
+    }
+    *out_assert_part_lookup = asset_part_lookup;
+    return 0;
+}
 
-        uint32_t block_index = block_indexes[*chunk_block_index];
-        uint32_t chunk_block_offset = chunk_offsets[*chunk_block_index];
-        uint32_t chunk_size = chunk_sizes[*chunk_block_index];
-        const char* block_data = (char*)stored_block[block_index]->m_BlockData;
+struct WriteBlockJob
+{
+    struct Longtail_AsyncPutStoredBlockAPI m_AsyncCompleteAPI;
+    struct Longtail_StorageAPI* m_SourceStorageAPI;
+    struct Longtail_BlockStoreAPI* m_BlockStoreAPI;
+    struct Longtail_JobAPI* m_JobAPI;
+    uint32_t m_JobID;
+    struct Longtail_StoredBlock* m_StoredBlock;
+    const char* m_AssetsFolder;
+    const struct Longtail_StoreIndex* m_StoreIndex;
+    const struct Longtail_VersionIndex* m_VersionIndex;
+    struct AssetPartLookup* m_AssetPartLookup;
+    uint32_t m_BlockIndex;
+    int m_PutStoredBlockErr;
+};
 
-        while(chunk_index_offset < (chunk_index_end - 1))
-        {
-            uint32_t next_chunk_index = job->m_VersionIndex->m_AssetChunkIndexes[asset_chunk_index + 1];
-            TLongtail_Hash next_chunk_hash = job->m_VersionIndex->m_ChunkHashes[next_chunk_index];
+static void BlockWriterJobOnComplete(struct Longtail_AsyncPutStoredBlockAPI* async_complete_api, int err)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(err, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-            uint32_t* next_chunk_block_index = LongtailPrivate_LookupTable_Get(block_chunks_lookup, next_chunk_hash);
-            if (next_chunk_block_index == 0)
-            {
-                for (uint32_t d = 0; d < block_reader_job_count; ++d)
-                {
-                    stored_block[d]->Dispose(stored_block[d]);
-                    stored_block[d] = 0;
-                }
-                job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
-                job->m_AssetOutputFile = 0;
-                if (sync_write_job)
-                {
-                    int err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
-                    LONGTAIL_FATAL_ASSERT(ctx, err == 0, err = 0; return 0)
-                }
-                Longtail_Free(work_mem);
-                return EINVAL;
-            }
-            uint32_t next_block_index = block_indexes[*next_chunk_block_index];
-            if (next_block_index != block_index)
-            {
-                break;
-            }
-            uint32_t next_chunk_block_offset = chunk_offsets[*next_chunk_block_index];
-            if (next_chunk_block_offset != chunk_block_offset + chunk_size)
-            {
-                break;
-            }
-            uint32_t next_chunk_size = chunk_sizes[*next_chunk_block_index];
-            chunk_size += next_chunk_size;
-            ++chunk_index_offset;
-        }
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BlockWriterJobOnComplete() caller failed with %d", err)
+    }
+    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api != 0, return)
+    struct WriteBlockJob* job = (struct WriteBlockJob*)async_complete_api;
+    LONGTAIL_FATAL_ASSERT(ctx, job->m_AsyncCompleteAPI.OnComplete != 0, return);
+    LONGTAIL_FATAL_ASSERT(ctx, job->m_StoredBlock != 0, return);
+    LONGTAIL_FATAL_ASSERT(ctx, job->m_JobID != 0, return);
+    uint32_t job_id = job->m_JobID;
+    SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+    job->m_JobID = 0;
+    job->m_PutStoredBlockErr = err;
+    job->m_JobAPI->ResumeJob(job->m_JobAPI, job_id);
+}
 
-        if (buffer_used_size + chunk_size <= buffer_size)
-        {
-            if (buffer_used_size > 0 || (chunk_index_offset < chunk_index_end - 1))
-            {
-                memcpy(&buffer[buffer_used_size], &block_data[chunk_block_offset], chunk_size);
-                buffer_used_size += chunk_size;
-                ++chunk_index_offset;
-                continue;
-            }
-        }
-
-        if (buffer_used_size > 0)
-        {
-            int err = job->m_VersionStorageAPI->Write(job->m_VersionStorageAPI, job->m_AssetOutputFile, write_offset, buffer_used_size, buffer);
-            if (err)
-            {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->Write() failed with %d", err)
-                job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
-                job->m_AssetOutputFile = 0;
-
-                for (uint32_t d = 0; d < block_reader_job_count; ++d)
-                {
-                    stored_block[d]->Dispose(stored_block[d]);
-                    stored_block[d] = 0;
-                }
-                if (sync_write_job)
-                {
-                    int sync_err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
-                    LONGTAIL_FATAL_ASSERT(ctx, sync_err == 0, return 0)
-                }
-                Longtail_Free(work_mem);
-                return err;
-            }
-            write_offset += buffer_used_size;
-            buffer_used_size = 0;
-        }
-
-        if (buffer_used_size + chunk_size <= buffer_size)
-        {
-            if (buffer_used_size > 0 || (chunk_index_offset < chunk_index_end - 1))
-            {
-                memcpy(&buffer[buffer_used_size], &block_data[chunk_block_offset], chunk_size);
-                buffer_used_size += chunk_size;
-                ++chunk_index_offset;
-                continue;
-            }
-        }
-
-        int err = job->m_VersionStorageAPI->Write(job->m_VersionStorageAPI, job->m_AssetOutputFile, write_offset, chunk_size, &block_data[chunk_block_offset]);
-        if (err)
-        {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->Write() failed with %d", err)
-            job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
-            job->m_AssetOutputFile = 0;
-
-            for (uint32_t d = 0; d < block_reader_job_count; ++d)
-            {
-                stored_block[d]->Dispose(stored_block[d]);
-                stored_block[d] = 0;
-            }
-            if (sync_write_job)
-            {
-                int sync_err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
-                LONGTAIL_FATAL_ASSERT(ctx, sync_err == 0, return 0)
-            }
-            Longtail_Free(work_mem);
-            return err;
-        }
-        write_offset += chunk_size;
-
-        ++chunk_index_offset;
-    }
-
-    if (buffer_used_size > 0)
-    {
-        int err = job->m_VersionStorageAPI->Write(job->m_VersionStorageAPI, job->m_AssetOutputFile, write_offset, buffer_used_size, buffer);
-        if (err)
-        {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->Write() failed with %d", err)
-            job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
-            job->m_AssetOutputFile = 0;
-
-            for (uint32_t d = 0; d < block_reader_job_count; ++d)
-            {
-                stored_block[d]->Dispose(stored_block[d]);
-                stored_block[d] = 0;
-            }
-            if (sync_write_job)
-            {
-                int sync_err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
-                LONGTAIL_FATAL_ASSERT(ctx, sync_err == 0, return 0)
-            }
-            Longtail_Free(work_mem);
-            return err;
-        }
-        write_offset += buffer_used_size;
-        buffer_used_size = 0;
-    }
-
-    Longtail_Free(work_mem);
-
-    for (uint32_t d = 0; d < block_reader_job_count; ++d)
-    {
-        stored_block[d]->Dispose(stored_block[d]);
-        stored_block[d] = 0;
-    }
-
-    if (sync_write_job)
-    {
-        // We can now release the next write job which will in turn close the job->m_AssetOutputFile
-        int err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
-        if (err)
-        {
-            job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
-            return err;
-        }
-        return 0;
-    }
-
-    job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
-    job->m_AssetOutputFile = 0;
-
-    if (job->m_RetainPermissions)
-    {
-        char* full_asset_path = job->m_VersionStorageAPI->ConcatPath(job->m_VersionStorageAPI, job->m_VersionFolder, asset_path);
-        int err = job->m_VersionStorageAPI->SetPermissions(job->m_VersionStorageAPI, full_asset_path, (uint16_t)job->m_VersionIndex->m_Permissions[job->m_AssetIndex]);
-        Longtail_Free(full_asset_path);
-        full_asset_path = 0;
-        if (err)
-        {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->SetPermissions() failed with %d", err)
-            return err;
-        }
-    }
+static int DisposePutBlock(struct Longtail_StoredBlock* stored_block)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(stored_block, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
+    Longtail_Free(stored_block);
     return 0;
 }
 
-struct WriteAssetsFromBlockJob
-{
-    struct Longtail_StorageAPI* m_VersionStorageAPI;
-    const struct Longtail_VersionIndex* m_VersionIndex;
-    const char* m_VersionFolder;
-    struct BlockReaderJob m_BlockReadJob;
-    uint32_t m_BlockIndex;
-    uint32_t* m_AssetIndexes;
-    uint32_t m_AssetCount;
-    int m_RetainPermissions;
-};
-
-static int WriteAssetsFromBlock(void* context, uint32_t job_id, int detected_error)
+static int WriteContentBlockJob(void* context, uint32_t job_id, int detected_error)
 {
+#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(context, "%p"),
         LONGTAIL_LOGFIELD(job_id, "%u"),
         LONGTAIL_LOGFIELD(detected_error, "%d")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return EINVAL)
 
-    struct WriteAssetsFromBlockJob* job = (struct WriteAssetsFromBlockJob*)context;
-    struct Longtail_StorageAPI* version_storage_api = job->m_VersionStorageAPI;
-    const char* version_folder = job->m_VersionFolder;
-    const struct Longtail_VersionIndex* version_index = job->m_VersionIndex;
-    uint32_t* asset_indexes = job->m_AssetIndexes;
-    uint32_t asset_count = job->m_AssetCount;
+    struct WriteBlockJob* job = (struct WriteBlockJob*)context;
+    LONGTAIL_FATAL_ASSERT(ctx, job->m_JobID == 0, return EINVAL);
 
     if (detected_error)
     {
-       LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "WriteAssetsFromBlock aborted due to previous error %d", detected_error)
-       SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
-       return 0;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "WriteContentBlockJob aborted due to previous error %d", detected_error)
+        return 0;
     }
 
-    if (job->m_BlockReadJob.m_GetStoredBlockErr)
+    if (job->m_AsyncCompleteAPI.OnComplete)
     {
-        LONGTAIL_LOG(ctx, (job->m_BlockReadJob.m_GetStoredBlockErr == ECANCELED) ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "BlockReadJob() failed with %d", job->m_BlockReadJob.m_GetStoredBlockErr)
-        return job->m_BlockReadJob.m_GetStoredBlockErr;
+        // We got a notification so we are complete
+        job->m_AsyncCompleteAPI.OnComplete = 0;
+        LONGTAIL_MONITOR_BLOCK_SAVED(job->m_StoreIndex, job->m_BlockIndex, job->m_PutStoredBlockErr);
+        return job->m_PutStoredBlockErr;
     }
 
-    const char* block_data = (char*)job->m_BlockReadJob.m_StoredBlock->m_BlockData;
-    struct Longtail_BlockIndex* block_index = job->m_BlockReadJob.m_StoredBlock->m_BlockIndex;
+    LONGTAIL_MONTITOR_BLOCK_COMPOSE(job->m_StoreIndex, job->m_BlockIndex);
 
-    uint32_t block_chunks_count = *block_index->m_ChunkCount;
+    struct Longtail_StorageAPI* source_storage_api = job->m_SourceStorageAPI;
+    struct Longtail_BlockStoreAPI* block_store_api = job->m_BlockStoreAPI;
 
-    size_t chuck_offsets_size = sizeof(uint32_t) * block_chunks_count;
-    size_t block_chunks_lookup_size = LongtailPrivate_LookupTable_GetSize(block_chunks_count);
-    size_t tmp_mem_size =
-        chuck_offsets_size +
-        block_chunks_lookup_size;
+    const struct Longtail_StoreIndex* store_index = job->m_StoreIndex;
 
-    char* tmp_mem = (char*)Longtail_Alloc("WriteAssetsFromBlock", tmp_mem_size);
-    if (!tmp_mem)
+    TLongtail_Hash block_hash = store_index->m_BlockHashes[job->m_BlockIndex];
+
+    uint32_t chunk_count = store_index->m_BlockChunkCounts[job->m_BlockIndex];
+    uint32_t first_chunk_index = store_index->m_BlockChunksOffsets[job->m_BlockIndex];
+
+    uint32_t block_data_size = 0;
+    for (uint32_t chunk_index = first_chunk_index; chunk_index < first_chunk_index + chunk_count; ++chunk_index)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
-        return ENOMEM;
+        uint32_t chunk_size = store_index->m_ChunkSizes[chunk_index];
+        block_data_size += chunk_size;
     }
-    struct Longtail_LookupTable* block_chunks_lookup = LongtailPrivate_LookupTable_Create(tmp_mem, block_chunks_count, 0);
-    uint32_t* chunk_offsets = (uint32_t*)(&tmp_mem[block_chunks_lookup_size]);
-    const uint32_t* chunk_sizes = block_index->m_ChunkSizes;
 
-    uint32_t block_chunk_index_offset = 0;
-    uint32_t chunk_offset = 0;
-    for (uint32_t c = 0; c < block_chunks_count; ++c)
+    size_t block_index_size = Longtail_GetBlockIndexSize(chunk_count);
+    size_t stored_block_size = sizeof(struct Longtail_StoredBlock);
+    size_t put_block_mem_size =
+        stored_block_size +
+        block_index_size +
+        block_data_size;
+
+    void* put_block_mem = Longtail_Alloc("WriteContentBlockJob", put_block_mem_size);
+    if (!put_block_mem)
     {
-        TLongtail_Hash chunk_hash = block_index->m_ChunkHashes[c];
-        uint32_t chunk_size = block_index->m_ChunkSizes[c];
-        chunk_offsets[block_chunk_index_offset] = chunk_offset;
-        chunk_offset += chunk_size;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM);
+        return ENOMEM;
+    }
 
-        LongtailPrivate_LookupTable_Put(block_chunks_lookup, chunk_hash, block_chunk_index_offset);
+    char* p = (char*)put_block_mem;
+    struct Longtail_StoredBlock* stored_block = (struct Longtail_StoredBlock*)p;
+    p += stored_block_size;
+    struct Longtail_BlockIndex* block_index_ptr = (struct Longtail_BlockIndex*)p;
+    p += block_index_size;
+    char* block_data_buffer = p;
 
-        block_chunk_index_offset++;
-    }
+    char* write_buffer = block_data_buffer;
 
-    for (uint32_t i = 0; i < asset_count; ++i)
+    uint32_t last_asset_index = 0;
+    uint32_t path_name_offset = 0xffffffffu;
+    uint32_t tag = 0;
+
+    Longtail_StorageAPI_HOpenFile file_handle = 0;
+    uint64_t asset_file_size = 0;
+    uint32_t write_offset = 0;
+
+    for (uint32_t chunk_index = first_chunk_index; chunk_index < first_chunk_index + chunk_count; ++chunk_index)
     {
-        uint32_t asset_index = asset_indexes[i];
-        const char* asset_path = &version_index->m_NameData[version_index->m_NameOffsets[asset_index]];
-        char* full_asset_path = version_storage_api->ConcatPath(version_storage_api, version_folder, asset_path);
-        int err = EnsureParentPathExists(version_storage_api, full_asset_path);
-        if (err)
-        {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed with %d", err)
-            Longtail_Free(full_asset_path);
-            SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
-            Longtail_Free(tmp_mem);
-            return err;
-        }
+        TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_index];
+        uint32_t chunk_size = store_index->m_ChunkSizes[chunk_index];
 
-        uint16_t permissions;
-        err = version_storage_api->GetPermissions(version_storage_api, full_asset_path, &permissions);
-        if (err && (err != ENOENT))
+        uint32_t* asset_part_index = LongtailPrivate_LookupTable_Get(job->m_AssetPartLookup->m_ChunkHashToIndex, chunk_hash);
+        LONGTAIL_FATAL_ASSERT(ctx, asset_part_index != 0, return EINVAL)
+        uint32_t next_asset_index = *asset_part_index;
+
+        uint32_t next_tag = job->m_AssetPartLookup->m_Tags[next_asset_index];
+        if (path_name_offset != 0xffffffffu && tag != next_tag)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->GetPermissions() failed with %d", err)
-            Longtail_Free(full_asset_path);
-            SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
-            Longtail_Free(tmp_mem);
-            return err;
-        }
-
-        if (err != ENOENT)
-        {
-            if (!(permissions & Longtail_StorageAPI_UserWriteAccess))
-            {
-                err = version_storage_api->SetPermissions(version_storage_api, full_asset_path, permissions | (Longtail_StorageAPI_UserWriteAccess));
-                if (err)
-                {
-                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->SetPermissions() failed with %d", err)
-                    Longtail_Free(full_asset_path);
-                    SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
-                    Longtail_Free(tmp_mem);
-                    return err;
-                }
-            }
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "WriteContentBlockJob(%p, %u, %d): Warning: Inconsistent tag type for chunks inside block 0x%" PRIx64 ", retaining 0x%" PRIx64 "",
+                context, job, job_id, detected_error,
+                block_hash, tag)
         }
-
-        Longtail_StorageAPI_HOpenFile asset_file;
-        err = version_storage_api->OpenWriteFile(version_storage_api, full_asset_path, 0, &asset_file);
-        if (err)
+        else
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->OpenWriteFile() failed with %d", err)
-            Longtail_Free(full_asset_path);
-            full_asset_path = 0;
-            SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
-            Longtail_Free(tmp_mem);
-            return err;
+            tag = next_tag;
         }
 
-        uint64_t asset_write_offset = 0;
-        uint32_t asset_chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
-        uint32_t asset_chunk_count = version_index->m_AssetChunkCounts[asset_index];
-        for (uint32_t asset_chunk_index = 0; asset_chunk_index < asset_chunk_count; ++asset_chunk_index)
+        uint32_t asset_index = job->m_AssetPartLookup->m_AssetIndexes[next_asset_index];
+        uint32_t next_path_name_offset = job->m_VersionIndex->m_NameOffsets[asset_index];
+        if (next_path_name_offset != path_name_offset)
         {
-            uint32_t chunk_index = version_index->m_AssetChunkIndexes[asset_chunk_index_start + asset_chunk_index];
-            TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
-
-            uint32_t* chunk_block_index = LongtailPrivate_LookupTable_Get(block_chunks_lookup, chunk_hash);
-            if (chunk_block_index == 0)
+            if (file_handle)
             {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", err)
-                version_storage_api->CloseFile(version_storage_api, asset_file);
-                asset_file = 0;
-                Longtail_Free(full_asset_path);
-                full_asset_path = 0;
-                SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
-                Longtail_Free(tmp_mem);
-                return err;
+                source_storage_api->CloseFile(source_storage_api, file_handle);
+                file_handle = 0;
+                LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_VersionIndex, last_asset_index);
             }
+            const char* asset_path = &job->m_VersionIndex->m_NameData[next_path_name_offset];
+            LONGTAIL_FATAL_ASSERT(ctx, !IsDirPath(asset_path), return EINVAL)
 
-            uint32_t chunk_block_offset = chunk_offsets[*chunk_block_index];
-            uint32_t chunk_size = chunk_sizes[*chunk_block_index];
-
-            while(asset_chunk_index < (asset_chunk_count - 1))
+            char* full_path = source_storage_api->ConcatPath(source_storage_api, job->m_AssetsFolder, asset_path);
+            int err = source_storage_api->OpenReadFile(source_storage_api, full_path, &file_handle);
+            LONGTAIL_MONTITOR_ASSET_OPEN(job->m_VersionIndex, asset_index, err);
+            Longtail_Free(full_path);
+            full_path = 0;
+            if (err)
             {
-                uint32_t next_chunk_index = version_index->m_AssetChunkIndexes[asset_chunk_index_start + asset_chunk_index + 1];
-                TLongtail_Hash next_chunk_hash = version_index->m_ChunkHashes[next_chunk_index];
-                uint32_t* next_chunk_block_index = LongtailPrivate_LookupTable_Get(block_chunks_lookup, next_chunk_hash);
-                if (next_chunk_block_index == 0)
-                {
-                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", err)
-                    version_storage_api->CloseFile(version_storage_api, asset_file);
-                    asset_file = 0;
-                    Longtail_Free(full_asset_path);
-                    full_asset_path = 0;
-                    SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
-                    Longtail_Free(tmp_mem);
-                    return err;
-                }
-
-                uint32_t next_chunk_block_offset = chunk_offsets[*next_chunk_block_index];
-                if (next_chunk_block_offset != chunk_block_offset + chunk_size)
-                {
-                    break;
-                }
-                uint32_t next_chunk_size = chunk_sizes[*next_chunk_block_index];
-                chunk_size += next_chunk_size;
-                ++asset_chunk_index;
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "source_storage_api->OpenReadFile() failed with %d", err);
+                Longtail_Free(put_block_mem);
+                return err;
             }
-
-            err = version_storage_api->Write(version_storage_api, asset_file, asset_write_offset, chunk_size, &block_data[chunk_block_offset]);
+            last_asset_index = asset_index;
+            uint64_t next_asset_file_size = 0;
+            err = source_storage_api->GetSize(source_storage_api, file_handle, &next_asset_file_size);
             if (err)
             {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->Write() failed with %d", err)
-                version_storage_api->CloseFile(version_storage_api, asset_file);
-                asset_file = 0;
-                Longtail_Free(full_asset_path);
-                full_asset_path = 0;
-                SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
-                Longtail_Free(tmp_mem);
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "source_storage_api->GetSize() failed with %d", err);
+                Longtail_Free(put_block_mem);
+                LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_VersionIndex, last_asset_index);
+                source_storage_api->CloseFile(source_storage_api, file_handle);
                 return err;
             }
-            asset_write_offset += chunk_size;
+            asset_file_size = next_asset_file_size;
+            path_name_offset = next_path_name_offset;
         }
 
-        version_storage_api->CloseFile(version_storage_api, asset_file);
-        asset_file = 0;
-
-        if (job->m_RetainPermissions)
+        uint64_t asset_offset = job->m_AssetPartLookup->m_AssetOffsets[next_asset_index];
+        if (asset_file_size < (asset_offset + chunk_size))
         {
-            err = version_storage_api->SetPermissions(version_storage_api, full_asset_path, version_index->m_Permissions[asset_index]);
-            if (err)
-            {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->SetPermissions() failed with %d", err)
-                Longtail_Free(full_asset_path);
-                full_asset_path = 0;
-                SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
-                Longtail_Free(tmp_mem);
-                return err;
-            }
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Source asset file does not match indexed size %" PRIu64 " < %" PRIu64,
+                asset_file_size, (asset_offset + chunk_size))
+            Longtail_Free(put_block_mem);
+            source_storage_api->CloseFile(source_storage_api, file_handle);
+            LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_VersionIndex, asset_index);
+            return EBADF;
         }
-        Longtail_Free(full_asset_path);
-        full_asset_path = 0;
+        int err = source_storage_api->Read(source_storage_api, file_handle, asset_offset, chunk_size, write_buffer + write_offset);
+        LONGTAIL_MONTITOR_ASSET_READ(job->m_StoreIndex, job->m_VersionIndex, asset_index, asset_offset, chunk_size, chunk_hash, job->m_BlockIndex, write_offset, err);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "source_storage_api->Read() failed with %d", err);
+            Longtail_Free(put_block_mem);
+            source_storage_api->CloseFile(source_storage_api, file_handle);
+            LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_VersionIndex, last_asset_index);
+            return err;
+        }
+        write_offset += chunk_size;
     }
-    Longtail_Free(tmp_mem);
-
-    SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
-    return 0;
-}
-
-struct AssetWriteList
-{
-    uint32_t m_BlockJobCount;
-    uint32_t m_AssetJobCount;
-    uint32_t* m_BlockJobAssetIndexes;
-    uint32_t* m_AssetIndexJobs;
-};
-
-struct JobCompareContext
-{
-    const struct AssetWriteList* m_AssetWriteList;
-    const uint32_t* asset_chunk_counts;
-    const uint32_t* asset_chunk_index_starts;
-    const uint32_t* asset_chunk_indexes;
-    const TLongtail_Hash* chunk_hashes;
-    struct Longtail_LookupTable* chunk_hash_to_block_index;
-};
 
-static uint32_t GetJobBlockIndex(struct JobCompareContext* c, uint32_t asset_index)
-{
-#if defined(LONGTAIL_ASSERTS)
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(c, "%p"),
-        LONGTAIL_LOGFIELD(asset_index, "%u"),
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
+    if (file_handle)
+    {
+        source_storage_api->CloseFile(source_storage_api, file_handle);
+        file_handle = 0;
+        LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_VersionIndex, last_asset_index);
+    }
 
-    uint32_t asset_chunk_offset = c->asset_chunk_index_starts[asset_index];
-    uint32_t chunk_index = c->asset_chunk_indexes[asset_chunk_offset];
+    Longtail_InitBlockIndex(block_index_ptr, chunk_count);
+    memmove(block_index_ptr->m_ChunkHashes, &store_index->m_ChunkHashes[first_chunk_index], sizeof(TLongtail_Hash) * chunk_count);
+    memmove(block_index_ptr->m_ChunkSizes, &store_index->m_ChunkSizes[first_chunk_index], sizeof(uint32_t) * chunk_count);
+    *block_index_ptr->m_BlockHash = block_hash;
+    *block_index_ptr->m_HashIdentifier = *store_index->m_HashIdentifier;
+    *block_index_ptr->m_Tag = tag;
+    *block_index_ptr->m_ChunkCount = chunk_count;
+    job->m_StoredBlock = stored_block;
+    job->m_StoredBlock->Dispose = DisposePutBlock;
+    job->m_StoredBlock->m_BlockIndex = block_index_ptr;
+    job->m_StoredBlock->m_BlockData = block_data_buffer;
+    job->m_StoredBlock->m_BlockChunksDataSize = block_data_size;
 
-    TLongtail_Hash chunk_hash = c->chunk_hashes[chunk_index];
+    job->m_JobID = job_id;
+    job->m_AsyncCompleteAPI.OnComplete = BlockWriterJobOnComplete;
 
-    const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(c->chunk_hash_to_block_index, chunk_hash);
-    LONGTAIL_FATAL_ASSERT(ctx, block_index_ptr, return 0)
+    LONGTAIL_MONITOR_BLOCK_SAVE(job->m_StoreIndex, job->m_BlockIndex, put_block_mem_size);
+    int err = block_store_api->PutStoredBlock(block_store_api, job->m_StoredBlock, &job->m_AsyncCompleteAPI);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_store_api->PutStoredBlock() failed with %d", err);
+        SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+        job->m_JobID = 0;
+        LONGTAIL_MONITOR_BLOCK_SAVED(job->m_StoreIndex, job->m_BlockIndex, err);
+        return err;
+    }
 
-    return *block_index_ptr;
+    return EBUSY;
 }
 
-static SORTFUNC(JobCompare)
+int Longtail_WriteContent(
+    struct Longtail_StorageAPI* source_storage_api,
+    struct Longtail_BlockStoreAPI* block_store_api,
+    struct Longtail_JobAPI* job_api,
+    struct Longtail_ProgressAPI* progress_api,
+    struct Longtail_CancelAPI* optional_cancel_api,
+    Longtail_CancelAPI_HCancelToken optional_cancel_token,
+    struct Longtail_StoreIndex* store_index,
+    struct Longtail_VersionIndex* version_index,
+    const char* assets_folder)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(context, "%p"),
-        LONGTAIL_LOGFIELD(a_ptr, "%p"),
-        LONGTAIL_LOGFIELD(b_ptr, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
-
-    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return 0)
-    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
-    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
+        LONGTAIL_LOGFIELD(source_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(job_api, "%p"),
+        LONGTAIL_LOGFIELD(progress_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(assets_folder, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    struct JobCompareContext* c = (struct JobCompareContext*)context;
-    uint32_t a = *(const uint32_t*)a_ptr;
-    uint32_t b = *(const uint32_t*)b_ptr;
+    LONGTAIL_VALIDATE_INPUT(ctx, source_storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, job_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, assets_folder != 0, return EINVAL)
 
-    uint32_t a_chunk_count = c->asset_chunk_counts[a];
-    uint32_t b_chunk_count = c->asset_chunk_counts[b];
-    if (a_chunk_count == 0)
+    uint32_t block_count = *store_index->m_BlockCount;
+    if (block_count == 0)
     {
-        if (b_chunk_count == 0)
-        {
-            return 0;
-        }
-        else
+        return 0;
+    }
+
+    uint32_t version_chunk_count = *version_index->m_ChunkCount;
+    uint32_t version_store_index_chunk_count = *store_index->m_ChunkCount;
+
+    size_t chunk_lookup_size = LongtailPrivate_LookupTable_GetSize(version_chunk_count);
+    size_t chunk_sizes_size = sizeof(uint32_t) * version_store_index_chunk_count;
+    size_t write_block_jobs_size = sizeof(struct WriteBlockJob) * block_count;
+    size_t funcs_size = sizeof(Longtail_JobAPI_JobFunc*) * block_count;
+    size_t ctxs_size = sizeof(void*) * block_count;
+
+    size_t work_mem_size =
+        chunk_lookup_size +
+        chunk_sizes_size +
+        write_block_jobs_size +
+        funcs_size +
+        ctxs_size;
+
+    void* work_mem = Longtail_Alloc("WriteContent", work_mem_size);
+    if (!work_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+
+    char* p = (char*)work_mem;
+
+    struct Longtail_LookupTable* chunk_lookup = LongtailPrivate_LookupTable_Create(p, version_chunk_count, 0);
+    p += chunk_lookup_size;
+    uint32_t* chunk_sizes = (uint32_t*)p;
+    p += chunk_sizes_size;
+    struct WriteBlockJob* write_block_jobs = (struct WriteBlockJob*)p;
+    p += write_block_jobs_size;
+    Longtail_JobAPI_JobFunc* funcs = (Longtail_JobAPI_JobFunc*)p;
+    p += funcs_size;
+    void** ctxs = (void**)p;
+    p += ctxs_size;
+
+    for (uint32_t c = 0; c < version_chunk_count; ++c)
+    {
+        LongtailPrivate_LookupTable_Put(chunk_lookup, version_index->m_ChunkHashes[c], c);
+    }
+
+    for (uint32_t c = 0; c < version_store_index_chunk_count; ++c)
+    {
+        uint32_t* version_chunk_index = LongtailPrivate_LookupTable_Get(chunk_lookup, store_index->m_ChunkHashes[c]);
+        if (version_chunk_index == 0)
         {
-            return -1;
+            Longtail_Free(work_mem);
+            return EINVAL;
         }
+        chunk_sizes[c] = version_index->m_ChunkSizes[*version_chunk_index];
     }
-    else if (b_chunk_count == 0)
+
+    struct AssetPartLookup* asset_part_lookup;
+    int err = CreateAssetPartLookup(version_index, &asset_part_lookup);
+    if (err)
     {
-        return 1;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateAssetPartLookup() failed with %d", err)
+        Longtail_Free(work_mem);
+        return err;
     }
-    uint32_t a_block_index = GetJobBlockIndex(c, a);
-    uint32_t b_block_index = GetJobBlockIndex(c, b);
-    if (a_block_index < b_block_index)
+
+    uint32_t job_count = 0;
+    for (uint32_t block_index = 0; block_index < block_count; ++block_index)
     {
-        return -1;
+        TLongtail_Hash block_hash = store_index->m_BlockHashes[block_index];
+
+        struct WriteBlockJob* job = &write_block_jobs[job_count];
+        job->m_AsyncCompleteAPI.m_API.Dispose = 0;
+        job->m_AsyncCompleteAPI.OnComplete = 0;
+        job->m_SourceStorageAPI = source_storage_api;
+        job->m_BlockStoreAPI = block_store_api;
+        job->m_JobAPI = job_api;
+        job->m_JobID = 0;
+        job->m_StoredBlock = 0;
+        job->m_AssetsFolder = assets_folder;
+        job->m_StoreIndex = store_index;
+        job->m_VersionIndex = version_index;
+        job->m_BlockIndex = block_index;
+        job->m_AssetPartLookup = asset_part_lookup;
+
+        funcs[job_count] = WriteContentBlockJob;
+        ctxs[job_count] = job;
+
+        ++job_count;
     }
-    else if (a_block_index > b_block_index)
+
+    uint32_t jobs_submitted = 0;
+    err = Longtail_RunJobsBatched(
+        job_api,
+        progress_api,
+        optional_cancel_api,
+        optional_cancel_token,
+        job_count,
+        funcs,
+        ctxs,
+        &jobs_submitted);
+    if (err)
     {
-        return 1;
+        LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "Longtail_RunJobsBatched() failed with %d", err)
+        Longtail_Free(asset_part_lookup);
+        Longtail_Free(work_mem);
+        return err;
+    }
+
+    Longtail_Free(asset_part_lookup);
+    asset_part_lookup = 0;
+
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "WriteBlockJob() failed with %d", err)
+        Longtail_Free(work_mem);
+        return err;
     }
+
+    Longtail_Free(work_mem);
     return 0;
 }
 
-static struct AssetWriteList* CreateAssetWriteList(uint32_t asset_count)
+struct BlockReaderJob
+{
+    struct Longtail_AsyncGetStoredBlockAPI m_AsyncCompleteAPI;
+    struct Longtail_BlockStoreAPI* m_BlockStoreAPI;
+    struct Longtail_JobAPI* m_JobAPI;
+    uint32_t m_JobID;
+    TLongtail_Hash m_BlockHash;
+    void* m_TargetBuffer;
+    uint32_t m_TargetBufferSize;
+    struct Longtail_StoredBlock* m_StoredBlock;
+    int m_GetStoredBlockErr;
+};
+
+void BlockReaderJobOnComplete(struct Longtail_AsyncGetStoredBlockAPI* async_complete_api, struct Longtail_StoredBlock* stored_block, int err)
 {
+#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(asset_count, "%u")
+        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(err, "%d")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-    size_t awl_size = sizeof(struct AssetWriteList) + sizeof(uint32_t) * asset_count + sizeof(uint32_t) * asset_count;
-    struct AssetWriteList* awl = (struct AssetWriteList*)(Longtail_Alloc("CreateAssetWriteList", awl_size));
-    if (!awl)
+    if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_Alloc() failed with %d", ENOMEM)
-        return 0;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BlockReaderJobOnComplete() failed with %d", err)
     }
-    awl->m_BlockJobCount = 0;
-    awl->m_AssetJobCount = 0;
-    awl->m_BlockJobAssetIndexes = (uint32_t*)(void*)&awl[1];
-    awl->m_AssetIndexJobs = &awl->m_BlockJobAssetIndexes[asset_count];
-    return awl;
+    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api != 0, return)
+    struct BlockReaderJob* job = (struct BlockReaderJob*)async_complete_api;
+    LONGTAIL_FATAL_ASSERT(ctx, job->m_AsyncCompleteAPI.OnComplete != 0, return);
+    if (err == 0)
+    {
+        // Reject blocks that are still encoded by a block store layer that is missing from the block store
+        err = Longtail_ValidateStoredBlockData(stored_block);
+        if (err)
+        {
+            SAFE_DISPOSE_STORED_BLOCK(stored_block);
+        }
+    }
+    job->m_GetStoredBlockErr = err;
+    job->m_StoredBlock = stored_block;
+    job->m_JobAPI->ResumeJob(job->m_JobAPI, job->m_JobID);
 }
 
-static int BuildAssetWriteList(
-    uint32_t asset_count,
-    const uint32_t* optional_asset_indexes,
-    uint32_t* name_offsets,
-    const char* name_data,
-    const TLongtail_Hash* chunk_hashes,
-    const uint32_t* asset_chunk_counts,
-    const uint32_t* asset_chunk_index_starts,
-    const uint32_t* asset_chunk_indexes,
-    struct Longtail_LookupTable* chunk_hash_to_block_index,
-    struct AssetWriteList** out_asset_write_list)
+static int BlockReader(void* context, uint32_t job_id, int detected_error)
 {
+#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(asset_count, "%u"),
-        LONGTAIL_LOGFIELD(optional_asset_indexes, "%p"),
-        LONGTAIL_LOGFIELD(name_offsets, "%p"),
-        LONGTAIL_LOGFIELD(name_data, "%p"),
-        LONGTAIL_LOGFIELD(chunk_hashes, "%p"),
-        LONGTAIL_LOGFIELD(asset_chunk_counts, "%p"),
-        LONGTAIL_LOGFIELD(asset_chunk_index_starts, "%p"),
-        LONGTAIL_LOGFIELD(asset_chunk_indexes, "%p"),
-        LONGTAIL_LOGFIELD(chunk_hash_to_block_index, "%p"),
-        LONGTAIL_LOGFIELD(out_asset_write_list, "%p")
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(job_id, "%u"),
+        LONGTAIL_LOGFIELD(detected_error, "%d")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_FATAL_ASSERT(ctx, asset_count == 0 || name_offsets != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, asset_count == 0 || name_data != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, asset_count == 0 || chunk_hashes != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, asset_count == 0 || asset_chunk_counts != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, asset_count == 0 || asset_chunk_index_starts != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, asset_count == 0 || asset_chunk_indexes != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, chunk_hash_to_block_index != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, out_asset_write_list != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return EINVAL)
 
-    struct AssetWriteList* awl = CreateAssetWriteList(asset_count);
-    if (awl == 0)
+    struct BlockReaderJob* job = (struct BlockReaderJob*)context;
+
+    if (detected_error)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateAssetWriteList() CreateAssetWriteList() failed with %d", ENOMEM)
-        return ENOMEM;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "BlockReader aborted due to previous error %d", detected_error)
+        return 0;
     }
 
-    for (uint32_t i = 0; i < asset_count; ++i)
+    if (job->m_AsyncCompleteAPI.OnComplete)
     {
-        uint32_t asset_index = optional_asset_indexes ? optional_asset_indexes[i] : i;
-        const char* path = &name_data[name_offsets[asset_index]];
-        uint32_t chunk_count = asset_chunk_counts[asset_index];
-        uint32_t asset_chunk_offset = asset_chunk_index_starts[asset_index];
-        if (chunk_count == 0)
-        {
-            awl->m_AssetIndexJobs[awl->m_AssetJobCount] = asset_index;
-            ++awl->m_AssetJobCount;
-            continue;
-        }
-        uint32_t chunk_index = asset_chunk_indexes[asset_chunk_offset];
-        TLongtail_Hash chunk_hash = chunk_hashes[chunk_index];
-        uint32_t* content_block_index = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, chunk_hash);
-        if (content_block_index == 0)
-        {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", ENOENT)
-            Longtail_Free(awl);
-            return ENOENT;
-        }
+        // We got a notification so we are complete
+        job->m_AsyncCompleteAPI.OnComplete = 0;
+        return job->m_GetStoredBlockErr;
+    }
 
-        int is_block_job = 1;
-        for (uint32_t c = 1; c < chunk_count; ++c)
-        {
-            uint32_t next_chunk_index = asset_chunk_indexes[asset_chunk_offset + c];
-            TLongtail_Hash next_chunk_hash = chunk_hashes[next_chunk_index];
-            uint32_t* next_content_block_index = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, next_chunk_hash);
-            if (next_content_block_index == 0)
+    job->m_JobID = job_id;
+    job->m_StoredBlock = 0;
+    job->m_AsyncCompleteAPI.OnComplete = BlockReaderJobOnComplete;
+
+    int err = job->m_TargetBuffer ?
+        Longtail_BlockStore_GetStoredBlockToBuffer(job->m_BlockStoreAPI, job->m_BlockHash, job->m_TargetBuffer, job->m_TargetBufferSize, &job->m_AsyncCompleteAPI) :
+        job->m_BlockStoreAPI->GetStoredBlock(job->m_BlockStoreAPI, job->m_BlockHash, &job->m_AsyncCompleteAPI);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job->m_BlockStoreAPI->GetStoredBlock() failed with %d", err)
+        return err;
+    }
+    return EBUSY;
+}
+
+static int WriteReady(void* context, uint32_t job_id, int detected_error)
+{
+    // Nothing to do here, we are just a syncronization point
+    return 0;
+}
+
+#define MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE  32u
+#define MAX_WRITE_VEC_COUNT                 64u
+
+struct WritePartialAssetFromBlocksJob
+{
+    struct Longtail_StorageAPI* m_VersionStorageAPI;
+    struct Longtail_BlockStoreAPI* m_BlockStoreAPI;
+    struct Longtail_JobAPI* m_JobAPI;
+    struct Longtail_ProgressAPI* m_ProgressAPI;
+    struct Longtail_CancelAPI* m_OptionalCancelAPI;
+    Longtail_CancelAPI_HCancelToken m_OptionalCancelToken;
+    const struct Longtail_StoreIndex* m_StoreIndex;
+    const struct Longtail_VersionIndex* m_VersionIndex;
+    const char* m_VersionFolder;
+    struct Longtail_LookupTable* m_ChunkHashToBlockIndex;
+    uint32_t m_AssetIndex;
+    int m_RetainPermissions;
+
+    Longtail_JobAPI_Group m_JobGroup;
+    struct BlockReaderJob m_BlockReaderJobs[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
+    uint32_t m_BlockReaderJobCount;
+
+    uint32_t m_AssetChunkIndexOffset;
+    uint32_t m_AssetChunkCount;
+
+    // Set when the blocks hold exactly the chunks of the asset range in order, the block data
+    // is then read directly into the buffer and written with one write
+    char* m_WriteBuffer;
+    size_t m_WriteBufferSize;
+
+    Longtail_StorageAPI_HOpenFile m_AssetOutputFile;
+};
+
+// Returns the size of the asset range [asset_chunk_index_offset, asset_chunk_index_offset + asset_chunk_count) if the
+// blocks hold exactly the chunks of the range in asset order, otherwise zero. Sets the offset of each block in the range.
+static size_t GetSingleAssetBlocksDataSize(
+    const struct Longtail_StoreIndex* store_index,
+    const struct Longtail_VersionIndex* version_index,
+    uint32_t asset_index,
+    uint32_t asset_chunk_index_offset,
+    uint32_t asset_chunk_count,
+    uint32_t block_count,
+    const uint32_t* block_indexes,
+    size_t* out_block_data_offsets)
+{
+    uint32_t chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index] + asset_chunk_index_offset;
+    uint32_t asset_chunk_index = 0;
+    size_t data_size = 0;
+    for (uint32_t b = 0; b < block_count; ++b)
+    {
+        uint32_t block_chunks_offset = store_index->m_BlockChunksOffsets[block_indexes[b]];
+        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[block_indexes[b]];
+        out_block_data_offsets[b] = data_size;
+        for (uint32_t c = 0; c < block_chunk_count; ++c)
+        {
+            if (asset_chunk_index == asset_chunk_count)
             {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", ENOENT)
-                Longtail_Free(awl);
-                return ENOENT;
+                return 0;
             }
-            if (*content_block_index != *next_content_block_index)
+            uint32_t chunk_index = version_index->m_AssetChunkIndexes[chunk_index_start + asset_chunk_index];
+            if (version_index->m_ChunkHashes[chunk_index] != store_index->m_ChunkHashes[block_chunks_offset + c])
             {
-                is_block_job = 0;
-                // We don't break here since we want to validate that all the chunks are in the content index
+                return 0;
             }
-        }
-
-        if (is_block_job)
-        {
-            awl->m_BlockJobAssetIndexes[awl->m_BlockJobCount] = asset_index;
-            ++awl->m_BlockJobCount;
-        }
-        else
-        {
-            awl->m_AssetIndexJobs[awl->m_AssetJobCount] = asset_index;
-            ++awl->m_AssetJobCount;
+            data_size += store_index->m_ChunkSizes[block_chunks_offset + c];
+            ++asset_chunk_index;
         }
     }
+    return (asset_chunk_index == asset_chunk_count) ? data_size : 0;
+}
 
-    struct JobCompareContext block_job_compare_context = {
-            awl,
-            asset_chunk_counts,
-            asset_chunk_index_starts,
-            asset_chunk_indexes,
-            chunk_hashes,
-            chunk_hash_to_block_index
-        };
-    QSORT(awl->m_BlockJobAssetIndexes, (size_t)awl->m_BlockJobCount, sizeof(uint32_t), JobCompare, &block_job_compare_context);
-    QSORT(awl->m_AssetIndexJobs, (size_t)awl->m_AssetJobCount, sizeof(uint32_t), JobCompare, &block_job_compare_context);
+int WritePartialAssetFromBlocks(void* context, uint32_t job_id, int detected_error);
 
-    *out_asset_write_list = awl;
-    return 0;
+static uint32_t GetMaxParallelBlockReadJobs(struct Longtail_JobAPI* job_api)
+{
+    uint32_t worker_count = job_api->GetWorkerCount(job_api);
+    if (worker_count > 2)
+    {
+        worker_count--;
+    }
+    else if (worker_count == 0)
+    {
+        worker_count = 1;
+    }
+    const uint32_t max_parallell_block_read_jobs = worker_count < MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE ? worker_count : MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE;
+    return max_parallell_block_read_jobs;
 }
 
-static int WriteAssets(
+// Returns the write sync task, or the write task if there is no need for reading new blocks
+static int CreatePartialAssetWriteJob(
     struct Longtail_BlockStoreAPI* block_store_api,
     struct Longtail_StorageAPI* version_storage_api,
     struct Longtail_JobAPI* job_api,
@@ -6136,1214 +8032,3860 @@ static int WriteAssets(
     Longtail_CancelAPI_HCancelToken optional_cancel_token,
     const struct Longtail_StoreIndex* store_index,
     const struct Longtail_VersionIndex* version_index,
-    const char* version_path,
+    const char* version_folder,
     struct Longtail_LookupTable* chunk_hash_to_block_index,
-    struct AssetWriteList* awl,
-    int retain_permssions)
+    uint32_t asset_index,
+    int retain_permissions,
+    Longtail_JobAPI_Group job_group,
+    struct WritePartialAssetFromBlocksJob* job,
+    uint32_t asset_chunk_index_offset,
+    Longtail_StorageAPI_HOpenFile asset_output_file,
+    Longtail_JobAPI_Jobs* out_jobs)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(block_store_api, "%p"),
         LONGTAIL_LOGFIELD(version_storage_api, "%p"),
         LONGTAIL_LOGFIELD(job_api, "%p"),
-        LONGTAIL_LOGFIELD(progress_api, "%p"),
-        LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
-        LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
         LONGTAIL_LOGFIELD(store_index, "%p"),
         LONGTAIL_LOGFIELD(version_index, "%p"),
-        LONGTAIL_LOGFIELD(version_path, "%s"),
+        LONGTAIL_LOGFIELD(version_folder, "%s"),
         LONGTAIL_LOGFIELD(chunk_hash_to_block_index, "%p"),
-        LONGTAIL_LOGFIELD(awl, "%p"),
-        LONGTAIL_LOGFIELD(retain_permssions, "%d")
+        LONGTAIL_LOGFIELD(asset_index, "%u"),
+        LONGTAIL_LOGFIELD(retain_permissions, "%d"),
+        LONGTAIL_LOGFIELD(job_group, "%p"),
+        LONGTAIL_LOGFIELD(job, "%p"),
+        LONGTAIL_LOGFIELD(asset_chunk_index_offset, "%u"),
+        LONGTAIL_LOGFIELD(asset_output_file, "%p"),
+        LONGTAIL_LOGFIELD(out_jobs, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 
-    LONGTAIL_FATAL_ASSERT(ctx, block_store_api != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, version_storage_api != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, job_api != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, store_index != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, version_index != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, version_path != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, chunk_hash_to_block_index != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, awl != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, block_store_api !=0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, version_storage_api !=0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, job_api !=0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, store_index !=0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, version_index !=0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, version_folder !=0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, chunk_hash_to_block_index !=0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, asset_index < *version_index->m_AssetCount, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, job !=0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, out_jobs !=0, return EINVAL)
 
-#if defined(LONGTAIL_ASSERTS)
+    job->m_VersionStorageAPI = version_storage_api;
+    job->m_BlockStoreAPI = block_store_api;
+    job->m_JobAPI = job_api;
+    job->m_ProgressAPI = progress_api;
+    job->m_OptionalCancelAPI = optional_cancel_api;
+    job->m_OptionalCancelToken = optional_cancel_token;
+    job->m_StoreIndex = store_index;
+    job->m_VersionIndex = version_index;
+    job->m_VersionFolder = version_folder;
+    job->m_ChunkHashToBlockIndex = chunk_hash_to_block_index;
+    job->m_AssetIndex = asset_index;
+    job->m_JobGroup = job_group;
+    job->m_RetainPermissions = retain_permissions;
+    job->m_BlockReaderJobCount = 0;
+    job->m_AssetChunkIndexOffset = asset_chunk_index_offset;
+    job->m_AssetChunkCount = 0;
+    job->m_WriteBuffer = 0;
+    job->m_WriteBufferSize = 0;
+    job->m_AssetOutputFile = asset_output_file;
+
+    uint32_t chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
+    uint32_t chunk_start_index_offset = chunk_index_start + asset_chunk_index_offset;
+    uint32_t chunk_index_end = chunk_index_start + version_index->m_AssetChunkCounts[asset_index];
+    uint32_t chunk_index_offset = chunk_start_index_offset;
+
+    Longtail_JobAPI_JobFunc block_read_funcs[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
+    void* block_read_ctx[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
+    uint32_t block_indexes[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
+
+    const uint32_t max_parallell_block_read_jobs = GetMaxParallelBlockReadJobs(job_api);
+
+    while (chunk_index_offset != chunk_index_end && job->m_BlockReaderJobCount <= max_parallell_block_read_jobs)
     {
-        uint32_t j = 0;
-        while (j < awl->m_BlockJobCount)
+        uint32_t chunk_index = version_index->m_AssetChunkIndexes[chunk_index_offset];
+        TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
+        const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, chunk_hash);
+        LONGTAIL_FATAL_ASSERT(ctx, block_index_ptr, return EINVAL)
+        uint32_t block_index = *block_index_ptr;
+        TLongtail_Hash block_hash = store_index->m_BlockHashes[block_index];
+        int has_block = 0;
+        for (uint32_t d = 0; d < job->m_BlockReaderJobCount; ++d)
         {
-            uint32_t asset_index = awl->m_BlockJobAssetIndexes[j];
-            TLongtail_Hash first_chunk_hash = version_index->m_ChunkHashes[version_index->m_AssetChunkIndexes[version_index->m_AssetChunkIndexStarts[asset_index]]];
-            const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, first_chunk_hash);
-            if (!block_index_ptr)
+            if (job->m_BlockReaderJobs[d].m_BlockHash == block_hash)
             {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", EINVAL)
-                return EINVAL;
+                has_block = 1;
+                break;
             }
-            uint32_t block_index = *block_index_ptr;
-            TLongtail_Hash block_hash = store_index->m_BlockHashes[block_index];
-
-            ++j;
-            while (j < awl->m_BlockJobCount)
+        }
+        if (!has_block)
+        {
+            if (job->m_BlockReaderJobCount == max_parallell_block_read_jobs)
             {
-                uint32_t asset_index = awl->m_BlockJobAssetIndexes[j];
-                TLongtail_Hash first_chunk_hash = version_index->m_ChunkHashes[version_index->m_AssetChunkIndexes[version_index->m_AssetChunkIndexStarts[asset_index]]];
-                const uint32_t* next_block_index_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, first_chunk_hash);
-                if (!next_block_index_ptr)
-                {
-                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", EINVAL)
-                    return EINVAL;
-                }
-                uint32_t next_block_index = *next_block_index_ptr;
-                if (next_block_index != block_index)
-                {
-                    break;
-                }
-                ++j;
+                break;
             }
+            struct BlockReaderJob* block_job = &job->m_BlockReaderJobs[job->m_BlockReaderJobCount];
+            block_job->m_BlockStoreAPI = block_store_api;
+            block_job->m_BlockHash = block_hash;
+            block_job->m_TargetBuffer = 0;
+            block_job->m_TargetBufferSize = 0;
+            block_job->m_AsyncCompleteAPI.m_API.Dispose = 0;
+            block_job->m_AsyncCompleteAPI.OnComplete = 0;
+            block_job->m_JobAPI = job_api;
+            block_job->m_JobID = 0;
+            block_job->m_StoredBlock = 0;
+            block_read_funcs[job->m_BlockReaderJobCount] = BlockReader;
+            block_read_ctx[job->m_BlockReaderJobCount] = block_job;
+            block_indexes[job->m_BlockReaderJobCount] = block_index;
+            ++job->m_BlockReaderJobCount;
         }
+        ++job->m_AssetChunkCount;
+        ++chunk_index_offset;
     }
-#endif // defined(LONGTAIL_ASSERTS)
-
-    const uint32_t max_parallell_block_read_jobs = GetMaxParallelBlockReadJobs(job_api);
 
-    uint32_t asset_job_count = 0;
-    for (uint32_t a = 0; a < awl->m_AssetJobCount; ++a)
+    if (block_store_api->GetStoredBlockToBuffer && job->m_BlockReaderJobCount > 0)
     {
-        uint32_t asset_index = awl->m_AssetIndexJobs[a];
-        uint32_t chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
-        uint32_t chunk_count = version_index->m_AssetChunkCounts[asset_index];
-        if (chunk_count == 0)
+        // Blocks that only hold this part of the asset are decompressed straight into the write buffer
+        size_t block_data_offsets[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
+        size_t write_buffer_size = GetSingleAssetBlocksDataSize(store_index, version_index, asset_index, asset_chunk_index_offset, job->m_AssetChunkCount, job->m_BlockReaderJobCount, block_indexes, block_data_offsets);
+        char* write_buffer = write_buffer_size ? (char*)Longtail_Alloc("WritePartialAssetFromBlocks", write_buffer_size) : 0;
+        if (write_buffer)
         {
-            asset_job_count += 1;   // Write job
-            continue;
+            for (uint32_t d = 0; d < job->m_BlockReaderJobCount; ++d)
+            {
+                size_t block_data_end = (d + 1 < job->m_BlockReaderJobCount) ? block_data_offsets[d + 1] : write_buffer_size;
+                job->m_BlockReaderJobs[d].m_TargetBuffer = &write_buffer[block_data_offsets[d]];
+                job->m_BlockReaderJobs[d].m_TargetBufferSize = (uint32_t)(block_data_end - block_data_offsets[d]);
+            }
+            job->m_WriteBuffer = write_buffer;
+            job->m_WriteBufferSize = write_buffer_size;
         }
+    }
 
-        uint32_t chunk_index_end = chunk_index_start + chunk_count;
-        uint32_t chunk_index_offset = chunk_index_start;
-
-        while(chunk_index_offset != chunk_index_end)
-        {
-            uint32_t block_read_job_count = 0;
-            TLongtail_Hash block_hashes[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
-            while (chunk_index_offset != chunk_index_end && block_read_job_count < max_parallell_block_read_jobs)
-            {
-                uint32_t chunk_index = version_index->m_AssetChunkIndexes[chunk_index_offset];
-                TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
-                const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, chunk_hash);
-                LONGTAIL_FATAL_ASSERT(ctx, block_index_ptr, return EINVAL)
-                uint32_t block_index = *block_index_ptr;
-                TLongtail_Hash block_hash = store_index->m_BlockHashes[block_index];
-                int has_block = 0;
-                for (uint32_t d = 0; d < block_read_job_count; ++d)
-                {
-                    if (block_hashes[d] == block_hash)
-                    {
-                        has_block = 1;
-                        break;
-                    }
-                }
-                if (!has_block)
-                {
-                    block_hashes[block_read_job_count++] = block_hash;
-                }
-                ++chunk_index_offset;
-            }
-            asset_job_count += 1;   // Write job
-            asset_job_count += 1;   // Sync job
-            asset_job_count += block_read_job_count;
-        }
-    }
-
-    int err = block_store_api->PreflightGet(block_store_api, *store_index->m_BlockCount, store_index->m_BlockHashes, 0);
+    Longtail_JobAPI_JobFunc write_funcs[1] = { WritePartialAssetFromBlocks };
+    void* write_ctx[1] = { job };
+    Longtail_JobAPI_Jobs write_job;
+    int err = job_api->CreateJobs(job_api, job_group, progress_api, optional_cancel_api, optional_cancel_token, 1, write_funcs, write_ctx, 0, &write_job);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_store_api->PreflightGet() failed with %d", err)
+        LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job_api->CreateJobs() failed with %d", err)
+        Longtail_Free(job->m_WriteBuffer);
+        job->m_WriteBuffer = 0;
         return err;
     }
 
-    if (optional_cancel_api && optional_cancel_token && optional_cancel_api->IsCancelled(optional_cancel_api, optional_cancel_token) == ECANCELED)
+    if (job->m_BlockReaderJobCount > 0)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Cancelled, failed with %d", ECANCELED)
-        return ECANCELED;
+        Longtail_JobAPI_Jobs block_read_jobs;
+        err = job_api->CreateJobs(job_api, job_group, progress_api, optional_cancel_api, optional_cancel_token, job->m_BlockReaderJobCount, block_read_funcs, block_read_ctx, 1, &block_read_jobs);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job_api->CreateJobs() failed with %d", err)
+            return err;
+        }
+        Longtail_JobAPI_JobFunc sync_write_funcs[1] = { WriteReady };
+        void* sync_write_ctx[1] = { 0 };
+        Longtail_JobAPI_Jobs write_sync_job;
+        err = job_api->CreateJobs(job_api, job_group, progress_api, optional_cancel_api, optional_cancel_token, 1, sync_write_funcs, sync_write_ctx, 0, &write_sync_job);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job_api->CreateJobs() failed with %d", err)
+            return err;
+        }
+
+        err = job_api->AddDependecies(job_api, 1, write_job, 1, write_sync_job);
+        LONGTAIL_FATAL_ASSERT(ctx, err == 0, return err)
+        err = job_api->AddDependecies(job_api, 1, write_job, job->m_BlockReaderJobCount, block_read_jobs);
+        LONGTAIL_FATAL_ASSERT(ctx, err == 0, return err)
+        err = job_api->ReadyJobs(job_api, job->m_BlockReaderJobCount, block_read_jobs);
+        LONGTAIL_FATAL_ASSERT(ctx, err == 0, return err)
+
+        *out_jobs = write_sync_job;
+        return 0;
     }
+    *out_jobs = write_job;
+    return 0;
+}
 
-    struct WriteAssetsFromBlockJob* block_jobs = (struct WriteAssetsFromBlockJob*)Longtail_Alloc("WriteAssets", (size_t)(sizeof(struct WriteAssetsFromBlockJob) * awl->m_BlockJobCount));
-    if (!block_jobs)
+// Hands the output file over to the next partial write job or closes it and applies the asset permissions
+static int FinishPartialAssetWrite(struct WritePartialAssetFromBlocksJob* job, Longtail_JobAPI_Jobs sync_write_job, const char* asset_path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(job, "%p"),
+        LONGTAIL_LOGFIELD(sync_write_job, "%p"),
+        LONGTAIL_LOGFIELD(asset_path, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    if (sync_write_job)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return ENOMEM;
+        // We can now release the next write job which will in turn close the job->m_AssetOutputFile
+        int err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
+        if (err)
+        {
+            job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
+            return err;
+        }
+        return 0;
     }
 
-    uint32_t job_count = asset_job_count;
+    job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
+    job->m_AssetOutputFile = 0;
+
+    if (job->m_RetainPermissions)
     {
-        uint32_t j = 0;
-        uint32_t block_job_count = 0;
-        while (j < awl->m_BlockJobCount)
+        char* full_asset_path = job->m_VersionStorageAPI->ConcatPath(job->m_VersionStorageAPI, job->m_VersionFolder, asset_path);
+        int err = job->m_VersionStorageAPI->SetPermissions(job->m_VersionStorageAPI, full_asset_path, (uint16_t)job->m_VersionIndex->m_Permissions[job->m_AssetIndex]);
+        Longtail_Free(full_asset_path);
+        full_asset_path = 0;
+        if (err)
         {
-            uint32_t asset_index = awl->m_BlockJobAssetIndexes[j];
-            TLongtail_Hash first_chunk_hash = version_index->m_ChunkHashes[version_index->m_AssetChunkIndexes[version_index->m_AssetChunkIndexStarts[asset_index]]];
-            const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, first_chunk_hash);
-            LONGTAIL_FATAL_ASSERT(ctx, block_index_ptr, return EINVAL)
-            uint32_t block_index = *block_index_ptr;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->SetPermissions() failed with %d", err)
+            return err;
+        }
+    }
 
-            job_count++;
+    return 0;
+}
 
-            ++j;
-            while (j < awl->m_BlockJobCount)
-            {
-                uint32_t next_asset_index = awl->m_BlockJobAssetIndexes[j];
-                TLongtail_Hash next_first_chunk_hash = version_index->m_ChunkHashes[version_index->m_AssetChunkIndexes[version_index->m_AssetChunkIndexStarts[next_asset_index]]];
-                uint32_t* next_block_index = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, next_first_chunk_hash);
-                LONGTAIL_FATAL_ASSERT(ctx, next_block_index != 0, return EINVAL)
-                if (block_index != *next_block_index)
-                {
-                    break;
-                }
+int WritePartialAssetFromBlocks(void* context, uint32_t job_id, int detected_error)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(job_id, "%u"),
+        LONGTAIL_LOGFIELD(detected_error, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 
-                ++j;
-            }
+    LONGTAIL_FATAL_ASSERT(ctx, context !=0, return EINVAL)
+    struct WritePartialAssetFromBlocksJob* job = (struct WritePartialAssetFromBlocksJob*)context;
 
-            job_count++;
-        }
-    }
+    uint32_t block_reader_job_count = job->m_BlockReaderJobCount;
 
-    Longtail_JobAPI_Group job_group = 0;
-    err = job_api->ReserveJobs(job_api, job_count, &job_group);
-    if (err)
+    if ((!job->m_AssetOutputFile) && job->m_AssetChunkIndexOffset)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job_api->ReserveJobs() failed with %d", err)
-        Longtail_Free(block_jobs);
-        return err;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "WritePartialAssetFromBlocks(%p, %u, %d) aborted due to previous error %d",
+            context, job, job_id, detected_error, detected_error)
+        for (uint32_t d = 0; d < block_reader_job_count; ++d)
+        {
+            SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReaderJobs[d].m_StoredBlock);
+        }
+        Longtail_Free(job->m_WriteBuffer);
+        job->m_WriteBuffer = 0;
+        return 0;
     }
 
-    uint32_t j = 0;
-    uint32_t block_job_count = 0;
-    while (j < awl->m_BlockJobCount)
+    if (detected_error)
     {
-        uint32_t asset_index = awl->m_BlockJobAssetIndexes[j];
-        TLongtail_Hash first_chunk_hash = version_index->m_ChunkHashes[version_index->m_AssetChunkIndexes[version_index->m_AssetChunkIndexStarts[asset_index]]];
-        const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, first_chunk_hash);
-        LONGTAIL_FATAL_ASSERT(ctx, block_index_ptr, return EINVAL)
-        uint32_t block_index = *block_index_ptr;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "WritePartialAssetFromBlocks aborted due to previous error %d", detected_error)
 
-        struct WriteAssetsFromBlockJob* job = &block_jobs[block_job_count++];
-        struct BlockReaderJob* block_job = &job->m_BlockReadJob;
-        block_job->m_BlockStoreAPI = block_store_api;
-        block_job->m_AsyncCompleteAPI.m_API.Dispose = 0;
-        block_job->m_AsyncCompleteAPI.OnComplete = 0;
-        block_job->m_BlockHash = store_index->m_BlockHashes[block_index];
-        block_job->m_JobAPI = job_api;
-        block_job->m_JobID = 0;
-        block_job->m_StoredBlock = 0;
-        Longtail_JobAPI_JobFunc block_read_funcs[1] = { BlockReader };
-        void* block_read_ctxs[1] = {block_job};
-        Longtail_JobAPI_Jobs block_read_job;
-        err = job_api->CreateJobs(job_api, job_group, progress_api, optional_cancel_api, optional_cancel_token, 1, block_read_funcs, block_read_ctxs, 1, &block_read_job);
-        if (err)
+        for (uint32_t d = 0; d < block_reader_job_count; ++d)
         {
-            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job_api->CreateJobs() failed with %d", err)
-            return err;
+            SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReaderJobs[d].m_StoredBlock);
+        }
+        Longtail_Free(job->m_WriteBuffer);
+        job->m_WriteBuffer = 0;
+        if (job->m_AssetOutputFile)
+        {
+            job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
+            job->m_AssetOutputFile = 0;
         }
+        return 0;
+    }
 
-        job->m_VersionStorageAPI = version_storage_api;
-        job->m_VersionIndex = version_index;
-        job->m_VersionFolder = version_path;
-        job->m_BlockIndex = block_index;
-        job->m_AssetIndexes = &awl->m_BlockJobAssetIndexes[j];
-        job->m_RetainPermissions = retain_permssions;
+    // Need to fetch all the data we need from the context since we will reuse the context
+    int block_reader_errors = 0;
+    int write_buffer_complete = job->m_WriteBuffer != 0;
+    TLongtail_Hash block_hashes[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
+    struct Longtail_StoredBlock* stored_block[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
+    for (uint32_t d = 0; d < block_reader_job_count; ++d)
+    {
+        if (job->m_BlockReaderJobs[d].m_GetStoredBlockErr)
+        {
+            block_reader_errors = block_reader_errors == 0 ? job->m_BlockReaderJobs[d].m_GetStoredBlockErr : block_reader_errors;
+            block_hashes[d] = 0;
+            stored_block[d] = 0;
+            continue;
+        }
+        block_hashes[d] = job->m_BlockReaderJobs[d].m_BlockHash;
+        stored_block[d] = job->m_BlockReaderJobs[d].m_StoredBlock;
+        if (stored_block[d]->m_BlockData != job->m_BlockReaderJobs[d].m_TargetBuffer)
+        {
+            write_buffer_complete = 0;
+        }
+    }
+    char* write_buffer = job->m_WriteBuffer;
+    size_t write_buffer_size = write_buffer_complete ? job->m_WriteBufferSize : 0;
+    job->m_WriteBuffer = 0;
 
-        job->m_AssetCount = 1;
-        ++j;
-        while (j < awl->m_BlockJobCount)
+    if (block_reader_errors)
+    {
+        LONGTAIL_LOG(ctx, (block_reader_errors == ECANCELED) ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "BlockRead() failed with %d", block_reader_errors)
+        for (uint32_t d = 0; d < block_reader_job_count; ++d)
         {
-            uint32_t next_asset_index = awl->m_BlockJobAssetIndexes[j];
-            TLongtail_Hash next_first_chunk_hash = version_index->m_ChunkHashes[version_index->m_AssetChunkIndexes[version_index->m_AssetChunkIndexStarts[next_asset_index]]];
-            uint32_t* next_block_index = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, next_first_chunk_hash);
-            LONGTAIL_FATAL_ASSERT(ctx, next_block_index != 0, return EINVAL)
-            if (block_index != *next_block_index)
+            if (stored_block[d] && stored_block[d]->Dispose)
             {
-                break;
+                stored_block[d]->Dispose(stored_block[d]);
+                stored_block[d] = 0;
             }
+        }
 
-            ++job->m_AssetCount;
-            ++j;
+        Longtail_Free(write_buffer);
+        if (job->m_AssetOutputFile)
+        {
+            job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
+            job->m_AssetOutputFile = 0;
         }
+        return block_reader_errors;
+    }
 
-        Longtail_JobAPI_JobFunc funcs[1] = { WriteAssetsFromBlock };
-        void* ctxs[1] = { job };
+    uint32_t write_chunk_index_offset = job->m_AssetChunkIndexOffset;
+    uint32_t write_chunk_count = job->m_AssetChunkCount;
+    uint32_t asset_chunk_count = job->m_VersionIndex->m_AssetChunkCounts[job->m_AssetIndex];
+    const char* asset_path = &job->m_VersionIndex->m_NameData[job->m_VersionIndex->m_NameOffsets[job->m_AssetIndex]];
 
-        Longtail_JobAPI_Jobs block_write_job;
-        err = job_api->CreateJobs(job_api, job_group, progress_api, optional_cancel_api, optional_cancel_token, 1, funcs, ctxs, 0, &block_write_job);
+    if (!job->m_AssetOutputFile)
+    {
+        char* full_asset_path = job->m_VersionStorageAPI->ConcatPath(job->m_VersionStorageAPI, job->m_VersionFolder, asset_path);
+        int err = EnsureParentPathExists(job->m_VersionStorageAPI, full_asset_path);
         if (err)
         {
-            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job_api->CreateJobs() failed with %d", err)
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed with %d", err)
+            Longtail_Free(full_asset_path);
+            for (uint32_t d = 0; d < block_reader_job_count; ++d)
+            {
+                stored_block[d]->Dispose(stored_block[d]);
+                stored_block[d] = 0;
+            }
+            Longtail_Free(write_buffer);
             return err;
         }
-        err = job_api->AddDependecies(job_api, 1, block_write_job, 1, block_read_job);
+        if (IsDirPath(full_asset_path))
+        {
+            // Remove trailing forward slash
+            full_asset_path[strlen(full_asset_path) - 1] = '\0';
+            err = job->m_VersionStorageAPI->CreateDir(job->m_VersionStorageAPI, full_asset_path);
+            if (err == EEXIST)
+            {
+                err = 0;
+            }
+            if (err != 0)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->CreateDir() failed with %d", err)
+                Longtail_Free(full_asset_path);
+                return err;
+            }
+            Longtail_Free(full_asset_path);
+            return err;
+        }
+
+        uint16_t permissions;
+        err = job->m_VersionStorageAPI->GetPermissions(job->m_VersionStorageAPI, full_asset_path, &permissions);
+        if (err && (err != ENOENT))
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->GetPermissions() failed with %d", err)
+            Longtail_Free(full_asset_path);
+            for (uint32_t d = 0; d < block_reader_job_count; ++d)
+            {
+                stored_block[d]->Dispose(stored_block[d]);
+                stored_block[d] = 0;
+            }
+            Longtail_Free(write_buffer);
+            return err;
+        }
+
+        if (err != ENOENT)
+        {
+            if (!(permissions & Longtail_StorageAPI_UserWriteAccess))
+            {
+                err = job->m_VersionStorageAPI->SetPermissions(job->m_VersionStorageAPI, full_asset_path, permissions | (Longtail_StorageAPI_UserWriteAccess));
+                if (err)
+                {
+                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->SetPermissions() failed with %d", err)
+                    Longtail_Free(full_asset_path);
+                    for (uint32_t d = 0; d < block_reader_job_count; ++d)
+                    {
+                        stored_block[d]->Dispose(stored_block[d]);
+                        stored_block[d] = 0;
+                    }
+                    Longtail_Free(write_buffer);
+                    return err;
+                }
+            }
+        }
+
+        uint64_t asset_size = job->m_VersionIndex->m_AssetSizes[job->m_AssetIndex];
+        err = job->m_VersionStorageAPI->OpenWriteFile(job->m_VersionStorageAPI, full_asset_path, asset_size, &job->m_AssetOutputFile);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->OpenWriteFile() failed with %d", err)
+            Longtail_Free(full_asset_path);
+            for (uint32_t d = 0; d < block_reader_job_count; ++d)
+            {
+                stored_block[d]->Dispose(stored_block[d]);
+                stored_block[d] = 0;
+            }
+            Longtail_Free(write_buffer);
+            return err;
+        }
+        Longtail_Free(full_asset_path);
+        full_asset_path = 0;
+    }
+
+    Longtail_JobAPI_Jobs sync_write_job = 0;
+    if (write_chunk_index_offset + write_chunk_count < asset_chunk_count)
+    {
+        int err = CreatePartialAssetWriteJob(
+            job->m_BlockStoreAPI,
+            job->m_VersionStorageAPI,
+            job->m_JobAPI,
+            job->m_ProgressAPI,
+            job->m_OptionalCancelAPI,
+            job->m_OptionalCancelToken,
+            job->m_StoreIndex,
+            job->m_VersionIndex,
+            job->m_VersionFolder,
+            job->m_ChunkHashToBlockIndex,
+            job->m_AssetIndex,
+            job->m_RetainPermissions,
+            job->m_JobGroup,
+            job,    // Reuse job
+            write_chunk_index_offset + write_chunk_count,
+            job->m_AssetOutputFile,
+            &sync_write_job);
+
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreatePartialAssetWriteJob() failed with %d", err)
+            for (uint32_t d = 0; d < block_reader_job_count; ++d)
+            {
+                stored_block[d]->Dispose(stored_block[d]);
+                stored_block[d] = 0;
+            }
+            Longtail_Free(write_buffer);
+            return err;
+        }
+        // Reading of blocks will start immediately
+    }
+
+    uint32_t chunk_index_offset = write_chunk_index_offset;
+    uint32_t chunk_index_start = job->m_VersionIndex->m_AssetChunkIndexStarts[job->m_AssetIndex];
+
+    uint64_t write_offset = 0;
+    for (uint32_t c = 0; c < chunk_index_offset; ++c)
+    {
+        uint32_t chunk_index = job->m_VersionIndex->m_AssetChunkIndexes[chunk_index_start + c];
+        uint32_t chunk_size = job->m_VersionIndex->m_ChunkSizes[chunk_index];
+        write_offset += chunk_size;
+    }
+
+    if (write_buffer_size > 0)
+    {
+        int err = job->m_VersionStorageAPI->Write(job->m_VersionStorageAPI, job->m_AssetOutputFile, write_offset, write_buffer_size, write_buffer);
+        for (uint32_t d = 0; d < block_reader_job_count; ++d)
+        {
+            stored_block[d]->Dispose(stored_block[d]);
+            stored_block[d] = 0;
+        }
+        Longtail_Free(write_buffer);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->Write() failed with %d", err)
+            job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
+            job->m_AssetOutputFile = 0;
+            if (sync_write_job)
+            {
+                int sync_err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
+                LONGTAIL_FATAL_ASSERT(ctx, sync_err == 0, return 0)
+            }
+            return err;
+        }
+        return FinishPartialAssetWrite(job, sync_write_job, asset_path);
+    }
+
+    uint32_t block_chunks_count = 0;
+    for(uint32_t b = 0; b < block_reader_job_count; ++b)
+    {
+        struct Longtail_BlockIndex* block_index = stored_block[b]->m_BlockIndex;
+        block_chunks_count += *block_index->m_ChunkCount;
+    }
+
+    size_t block_chunks_lookup_size = LongtailPrivate_LookupTable_GetSize(block_chunks_count);
+    size_t chunk_sizes_size = sizeof(uint32_t) * block_chunks_count;
+    size_t chunk_offsets_size = sizeof(uint32_t) * block_chunks_count;
+    size_t block_indexes_size = sizeof(uint32_t) * block_chunks_count;
+    size_t buffer_size = 512*1024;
+
+    size_t work_mem_size =
+        block_chunks_lookup_size +
+        chunk_sizes_size +
+        chunk_offsets_size +
+        block_indexes_size +
+        buffer_size;
+    void* work_mem = Longtail_Alloc("WritePartialAssetFromBlocks", work_mem_size);
+    if (!work_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        for (uint32_t d = 0; d < block_reader_job_count; ++d)
+        {
+            stored_block[d]->Dispose(stored_block[d]);
+            stored_block[d] = 0;
+        }
+        job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
+        job->m_AssetOutputFile = 0;
+        if (sync_write_job)
+        {
+            int err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
+            LONGTAIL_FATAL_ASSERT(ctx, err == 0, err = 0)
+        }
+        return ENOMEM;
+    }
+    char* p = (char*)work_mem;
+    struct Longtail_LookupTable* block_chunks_lookup = LongtailPrivate_LookupTable_Create(p, block_chunks_count, 0);
+    p += block_chunks_lookup_size;
+    uint32_t* chunk_sizes = (uint32_t*)p;
+    p += chunk_sizes_size;
+    uint32_t* chunk_offsets = (uint32_t*)p;
+    p += chunk_offsets_size;
+    uint32_t* block_indexes = (uint32_t*)p;
+    p += block_indexes_size;
+    char* buffer = p;
+
+    uint32_t block_chunk_index_offset = 0;
+    for(uint32_t b = 0; b < block_reader_job_count; ++b)
+    {
+        uint32_t chunk_offset = 0;
+        struct Longtail_BlockIndex* block_index = stored_block[b]->m_BlockIndex;
+        for (uint32_t c = 0; c < *block_index->m_ChunkCount; ++c)
+        {
+            TLongtail_Hash chunk_hash = block_index->m_ChunkHashes[c];
+            uint32_t chunk_size = block_index->m_ChunkSizes[c];
+            chunk_sizes[block_chunk_index_offset] = chunk_size;
+            chunk_offsets[block_chunk_index_offset] = chunk_offset;
+            block_indexes[block_chunk_index_offset] = b;
+            chunk_offset += chunk_size;
+
+            LongtailPrivate_LookupTable_Put(block_chunks_lookup, chunk_hash, block_chunk_index_offset);
+
+            block_chunk_index_offset++;
+        }
+    }
+
+    size_t buffer_used_size = 0;
+    uint32_t chunk_index_end = write_chunk_index_offset + write_chunk_count;
+
+    while (chunk_index_offset < chunk_index_end)
+    {
+        uint32_t asset_chunk_index = chunk_index_start + chunk_index_offset;
+        uint32_t chunk_index = job->m_VersionIndex->m_AssetChunkIndexes[asset_chunk_index];
+        TLongtail_Hash chunk_hash = job->m_VersionIndex->m_ChunkHashes[chunk_index];
+
+        uint32_t* chunk_block_index = LongtailPrivate_LookupTable_Get(block_chunks_lookup, chunk_hash);
+        if (chunk_block_index == 0)
+        {
+            for (uint32_t d = 0; d < block_reader_job_count; ++d)
+            {
+                stored_block[d]->Dispose(stored_block[d]);
+                stored_block[d] = 0;
+            }
+            job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
+            job->m_AssetOutputFile = 0;
+            if (sync_write_job)
+            {
+                int err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
+                LONGTAIL_FATAL_ASSERT(ctx, err == 0, err = 0; return 0)
+            }
+            Longtail_Free(work_mem);
+            return EINVAL;
+        }
+
+        uint32_t block_index = block_indexes[*chunk_block_index];
+        uint32_t chunk_block_offset = chunk_offsets[*chunk_block_index];
+        uint32_t chunk_size = chunk_sizes[*chunk_block_index];
+        const char* block_data = (char*)stored_block[block_index]->m_BlockData;
+
+        while(chunk_index_offset < (chunk_index_end - 1))
+        {
+            uint32_t next_chunk_index = job->m_VersionIndex->m_AssetChunkIndexes[asset_chunk_index + 1];
+            TLongtail_Hash next_chunk_hash = job->m_VersionIndex->m_ChunkHashes[next_chunk_index];
+
+            uint32_t* next_chunk_block_index = LongtailPrivate_LookupTable_Get(block_chunks_lookup, next_chunk_hash);
+            if (next_chunk_block_index == 0)
+            {
+                for (uint32_t d = 0; d < block_reader_job_count; ++d)
+                {
+                    stored_block[d]->Dispose(stored_block[d]);
+                    stored_block[d] = 0;
+                }
+                job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
+                job->m_AssetOutputFile = 0;
+                if (sync_write_job)
+                {
+                    int err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
+                    LONGTAIL_FATAL_ASSERT(ctx, err == 0, err = 0; return 0)
+                }
+                Longtail_Free(work_mem);
+                return EINVAL;
+            }
+            uint32_t next_block_index = block_indexes[*next_chunk_block_index];
+            if (next_block_index != block_index)
+            {
+                break;
+            }
+            uint32_t next_chunk_block_offset = chunk_offsets[*next_chunk_block_index];
+            if (next_chunk_block_offset != chunk_block_offset + chunk_size)
+            {
+                break;
+            }
+            uint32_t next_chunk_size = chunk_sizes[*next_chunk_block_index];
+            chunk_size += next_chunk_size;
+            ++chunk_index_offset;
+        }
+
+        if (buffer_used_size + chunk_size <= buffer_size)
+        {
+            if (buffer_used_size > 0 || (chunk_index_offset < chunk_index_end - 1))
+            {
+                memcpy(&buffer[buffer_used_size], &block_data[chunk_block_offset], chunk_size);
+                buffer_used_size += chunk_size;
+                ++chunk_index_offset;
+                continue;
+            }
+        }
+
+        if (buffer_used_size > 0)
+        {
+            int err = job->m_VersionStorageAPI->Write(job->m_VersionStorageAPI, job->m_AssetOutputFile, write_offset, buffer_used_size, buffer);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->Write() failed with %d", err)
+                job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
+                job->m_AssetOutputFile = 0;
+
+                for (uint32_t d = 0; d < block_reader_job_count; ++d)
+                {
+                    stored_block[d]->Dispose(stored_block[d]);
+                    stored_block[d] = 0;
+                }
+                if (sync_write_job)
+                {
+                    int sync_err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
+                    LONGTAIL_FATAL_ASSERT(ctx, sync_err == 0, return 0)
+                }
+                Longtail_Free(work_mem);
+                return err;
+            }
+            write_offset += buffer_used_size;
+            buffer_used_size = 0;
+        }
+
+        if (buffer_used_size + chunk_size <= buffer_size)
+        {
+            if (buffer_used_size > 0 || (chunk_index_offset < chunk_index_end - 1))
+            {
+                memcpy(&buffer[buffer_used_size], &block_data[chunk_block_offset], chunk_size);
+                buffer_used_size += chunk_size;
+                ++chunk_index_offset;
+                continue;
+            }
+        }
+
+        int err = job->m_VersionStorageAPI->Write(job->m_VersionStorageAPI, job->m_AssetOutputFile, write_offset, chunk_size, &block_data[chunk_block_offset]);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->Write() failed with %d", err)
+            job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
+            job->m_AssetOutputFile = 0;
+
+            for (uint32_t d = 0; d < block_reader_job_count; ++d)
+            {
+                stored_block[d]->Dispose(stored_block[d]);
+                stored_block[d] = 0;
+            }
+            if (sync_write_job)
+            {
+                int sync_err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
+                LONGTAIL_FATAL_ASSERT(ctx, sync_err == 0, return 0)
+            }
+            Longtail_Free(work_mem);
+            return err;
+        }
+        write_offset += chunk_size;
+
+        ++chunk_index_offset;
+    }
+
+    if (buffer_used_size > 0)
+    {
+        int err = job->m_VersionStorageAPI->Write(job->m_VersionStorageAPI, job->m_AssetOutputFile, write_offset, buffer_used_size, buffer);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_VersionStorageAPI->Write() failed with %d", err)
+            job->m_VersionStorageAPI->CloseFile(job->m_VersionStorageAPI, job->m_AssetOutputFile);
+            job->m_AssetOutputFile = 0;
+
+            for (uint32_t d = 0; d < block_reader_job_count; ++d)
+            {
+                stored_block[d]->Dispose(stored_block[d]);
+                stored_block[d] = 0;
+            }
+            if (sync_write_job)
+            {
+                int sync_err = job->m_JobAPI->ReadyJobs(job->m_JobAPI, 1, sync_write_job);
+                LONGTAIL_FATAL_ASSERT(ctx, sync_err == 0, return 0)
+            }
+            Longtail_Free(work_mem);
+            return err;
+        }
+        write_offset += buffer_used_size;
+        buffer_used_size = 0;
+    }
+
+    Longtail_Free(work_mem);
+
+    for (uint32_t d = 0; d < block_reader_job_count; ++d)
+    {
+        stored_block[d]->Dispose(stored_block[d]);
+        stored_block[d] = 0;
+    }
+    Longtail_Free(write_buffer);
+
+    return FinishPartialAssetWrite(job, sync_write_job, asset_path);
+}
+
+struct WriteAssetsFromBlockJob
+{
+    struct Longtail_StorageAPI* m_VersionStorageAPI;
+    const struct Longtail_VersionIndex* m_VersionIndex;
+    const char* m_VersionFolder;
+    struct BlockReaderJob m_BlockReadJob;
+    uint32_t m_BlockIndex;
+    uint32_t* m_AssetIndexes;
+    uint32_t m_AssetCount;
+    int m_RetainPermissions;
+};
+
+static int WriteAssetsFromBlock(void* context, uint32_t job_id, int detected_error)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(job_id, "%u"),
+        LONGTAIL_LOGFIELD(detected_error, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return 0)
+
+    struct WriteAssetsFromBlockJob* job = (struct WriteAssetsFromBlockJob*)context;
+    struct Longtail_StorageAPI* version_storage_api = job->m_VersionStorageAPI;
+    const char* version_folder = job->m_VersionFolder;
+    const struct Longtail_VersionIndex* version_index = job->m_VersionIndex;
+    uint32_t* asset_indexes = job->m_AssetIndexes;
+    uint32_t asset_count = job->m_AssetCount;
+
+    if (detected_error)
+    {
+       LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "WriteAssetsFromBlock aborted due to previous error %d", detected_error)
+       SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
+       return 0;
+    }
+
+    if (job->m_BlockReadJob.m_GetStoredBlockErr)
+    {
+        LONGTAIL_LOG(ctx, (job->m_BlockReadJob.m_GetStoredBlockErr == ECANCELED) ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "BlockReadJob() failed with %d", job->m_BlockReadJob.m_GetStoredBlockErr)
+        return job->m_BlockReadJob.m_GetStoredBlockErr;
+    }
+
+    const char* block_data = (char*)job->m_BlockReadJob.m_StoredBlock->m_BlockData;
+    struct Longtail_BlockIndex* block_index = job->m_BlockReadJob.m_StoredBlock->m_BlockIndex;
+
+    uint32_t block_chunks_count = *block_index->m_ChunkCount;
+
+    size_t chuck_offsets_size = sizeof(uint32_t) * block_chunks_count;
+    size_t block_chunks_lookup_size = LongtailPrivate_LookupTable_GetSize(block_chunks_count);
+    size_t tmp_mem_size =
+        chuck_offsets_size +
+        block_chunks_lookup_size;
+
+    char* tmp_mem = (char*)Longtail_Alloc("WriteAssetsFromBlock", tmp_mem_size);
+    if (!tmp_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
+        return ENOMEM;
+    }
+    struct Longtail_LookupTable* block_chunks_lookup = LongtailPrivate_LookupTable_Create(tmp_mem, block_chunks_count, 0);
+    uint32_t* chunk_offsets = (uint32_t*)(&tmp_mem[block_chunks_lookup_size]);
+    const uint32_t* chunk_sizes = block_index->m_ChunkSizes;
+
+    uint32_t block_chunk_index_offset = 0;
+    uint32_t chunk_offset = 0;
+    for (uint32_t c = 0; c < block_chunks_count; ++c)
+    {
+        TLongtail_Hash chunk_hash = block_index->m_ChunkHashes[c];
+        uint32_t chunk_size = block_index->m_ChunkSizes[c];
+        chunk_offsets[block_chunk_index_offset] = chunk_offset;
+        chunk_offset += chunk_size;
+
+        LongtailPrivate_LookupTable_Put(block_chunks_lookup, chunk_hash, block_chunk_index_offset);
+
+        block_chunk_index_offset++;
+    }
+
+    for (uint32_t i = 0; i < asset_count; ++i)
+    {
+        uint32_t asset_index = asset_indexes[i];
+        const char* asset_path = &version_index->m_NameData[version_index->m_NameOffsets[asset_index]];
+        char* full_asset_path = version_storage_api->ConcatPath(version_storage_api, version_folder, asset_path);
+        int err = EnsureParentPathExists(version_storage_api, full_asset_path);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed with %d", err)
+            Longtail_Free(full_asset_path);
+            SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
+            Longtail_Free(tmp_mem);
+            return err;
+        }
+
+        uint16_t permissions;
+        err = version_storage_api->GetPermissions(version_storage_api, full_asset_path, &permissions);
+        if (err && (err != ENOENT))
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->GetPermissions() failed with %d", err)
+            Longtail_Free(full_asset_path);
+            SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
+            Longtail_Free(tmp_mem);
+            return err;
+        }
+
+        if (err != ENOENT)
+        {
+            if (!(permissions & Longtail_StorageAPI_UserWriteAccess))
+            {
+                err = version_storage_api->SetPermissions(version_storage_api, full_asset_path, permissions | (Longtail_StorageAPI_UserWriteAccess));
+                if (err)
+                {
+                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->SetPermissions() failed with %d", err)
+                    Longtail_Free(full_asset_path);
+                    SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
+                    Longtail_Free(tmp_mem);
+                    return err;
+                }
+            }
+        }
+
+        Longtail_StorageAPI_HOpenFile asset_file;
+        err = version_storage_api->OpenWriteFile(version_storage_api, full_asset_path, 0, &asset_file);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->OpenWriteFile() failed with %d", err)
+            Longtail_Free(full_asset_path);
+            full_asset_path = 0;
+            SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
+            Longtail_Free(tmp_mem);
+            return err;
+        }
+
+        uint64_t asset_write_offset = 0;
+        uint32_t asset_chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
+        uint32_t asset_chunk_count = version_index->m_AssetChunkCounts[asset_index];
+        for (uint32_t asset_chunk_index = 0; asset_chunk_index < asset_chunk_count; ++asset_chunk_index)
+        {
+            uint32_t chunk_index = version_index->m_AssetChunkIndexes[asset_chunk_index_start + asset_chunk_index];
+            TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
+
+            uint32_t* chunk_block_index = LongtailPrivate_LookupTable_Get(block_chunks_lookup, chunk_hash);
+            if (chunk_block_index == 0)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", err)
+                version_storage_api->CloseFile(version_storage_api, asset_file);
+                asset_file = 0;
+                Longtail_Free(full_asset_path);
+                full_asset_path = 0;
+                SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
+                Longtail_Free(tmp_mem);
+                return err;
+            }
+
+            uint32_t chunk_block_offset = chunk_offsets[*chunk_block_index];
+            uint32_t chunk_size = chunk_sizes[*chunk_block_index];
+
+            // The asset is written sequentially so every following chunk is contiguous in the target,
+            // chunks that are also contiguous in the block are merged into the same buffer
+            struct Longtail_StorageAPI_IOVec write_vecs[MAX_WRITE_VEC_COUNT];
+            write_vecs[0].m_Data = &block_data[chunk_block_offset];
+            write_vecs[0].m_Length = chunk_size;
+            uint32_t write_vec_count = 1;
+
+            while(asset_chunk_index < (asset_chunk_count - 1))
+            {
+                uint32_t next_chunk_index = version_index->m_AssetChunkIndexes[asset_chunk_index_start + asset_chunk_index + 1];
+                TLongtail_Hash next_chunk_hash = version_index->m_ChunkHashes[next_chunk_index];
+                uint32_t* next_chunk_block_index = LongtailPrivate_LookupTable_Get(block_chunks_lookup, next_chunk_hash);
+                if (next_chunk_block_index == 0)
+                {
+                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", err)
+                    version_storage_api->CloseFile(version_storage_api, asset_file);
+                    asset_file = 0;
+                    Longtail_Free(full_asset_path);
+                    full_asset_path = 0;
+                    SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
+                    Longtail_Free(tmp_mem);
+                    return err;
+                }
+
+                uint32_t next_chunk_block_offset = chunk_offsets[*next_chunk_block_index];
+                uint32_t next_chunk_size = chunk_sizes[*next_chunk_block_index];
+                struct Longtail_StorageAPI_IOVec* last_vec = &write_vecs[write_vec_count - 1];
+                if (&block_data[next_chunk_block_offset] == (const char*)last_vec->m_Data + last_vec->m_Length)
+                {
+                    last_vec->m_Length += next_chunk_size;
+                }
+                else if (write_vec_count < MAX_WRITE_VEC_COUNT)
+                {
+                    write_vecs[write_vec_count].m_Data = &block_data[next_chunk_block_offset];
+                    write_vecs[write_vec_count].m_Length = next_chunk_size;
+                    ++write_vec_count;
+                }
+                else
+                {
+                    break;
+                }
+                chunk_size += next_chunk_size;
+                ++asset_chunk_index;
+            }
+
+            if (write_vec_count == 1)
+            {
+                err = version_storage_api->Write(version_storage_api, asset_file, asset_write_offset, chunk_size, &block_data[chunk_block_offset]);
+            }
+            else
+            {
+                err = version_storage_api->WriteV(version_storage_api, asset_file, asset_write_offset, write_vec_count, write_vecs);
+            }
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->Write() failed with %d", err)
+                version_storage_api->CloseFile(version_storage_api, asset_file);
+                asset_file = 0;
+                Longtail_Free(full_asset_path);
+                full_asset_path = 0;
+                SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
+                Longtail_Free(tmp_mem);
+                return err;
+            }
+            asset_write_offset += chunk_size;
+        }
+
+        version_storage_api->CloseFile(version_storage_api, asset_file);
+        asset_file = 0;
+
+        if (job->m_RetainPermissions)
+        {
+            err = version_storage_api->SetPermissions(version_storage_api, full_asset_path, version_index->m_Permissions[asset_index]);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->SetPermissions() failed with %d", err)
+                Longtail_Free(full_asset_path);
+                full_asset_path = 0;
+                SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
+                Longtail_Free(tmp_mem);
+                return err;
+            }
+        }
+        Longtail_Free(full_asset_path);
+        full_asset_path = 0;
+    }
+    Longtail_Free(tmp_mem);
+
+    SAFE_DISPOSE_STORED_BLOCK(job->m_BlockReadJob.m_StoredBlock);
+    return 0;
+}
+
+struct AssetWriteList
+{
+    uint32_t m_BlockJobCount;
+    uint32_t m_AssetJobCount;
+    uint32_t* m_BlockJobAssetIndexes;
+    uint32_t* m_AssetIndexJobs;
+};
+
+struct JobCompareContext
+{
+    const struct AssetWriteList* m_AssetWriteList;
+    const uint32_t* asset_chunk_counts;
+    const uint32_t* asset_chunk_index_starts;
+    const uint32_t* asset_chunk_indexes;
+    const TLongtail_Hash* chunk_hashes;
+    struct Longtail_LookupTable* chunk_hash_to_block_index;
+};
+
+static uint32_t GetJobBlockIndex(struct JobCompareContext* c, uint32_t asset_index)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(c, "%p"),
+        LONGTAIL_LOGFIELD(asset_index, "%u"),
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    uint32_t asset_chunk_offset = c->asset_chunk_index_starts[asset_index];
+    uint32_t chunk_index = c->asset_chunk_indexes[asset_chunk_offset];
+
+    TLongtail_Hash chunk_hash = c->chunk_hashes[chunk_index];
+
+    const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(c->chunk_hash_to_block_index, chunk_hash);
+    LONGTAIL_FATAL_ASSERT(ctx, block_index_ptr, return 0)
+
+    return *block_index_ptr;
+}
+
+static SORTFUNC(JobCompare)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(a_ptr, "%p"),
+        LONGTAIL_LOGFIELD(b_ptr, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
+
+    struct JobCompareContext* c = (struct JobCompareContext*)context;
+    uint32_t a = *(const uint32_t*)a_ptr;
+    uint32_t b = *(const uint32_t*)b_ptr;
+
+    uint32_t a_chunk_count = c->asset_chunk_counts[a];
+    uint32_t b_chunk_count = c->asset_chunk_counts[b];
+    if (a_chunk_count == 0)
+    {
+        if (b_chunk_count == 0)
+        {
+            return 0;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    else if (b_chunk_count == 0)
+    {
+        return 1;
+    }
+    uint32_t a_block_index = GetJobBlockIndex(c, a);
+    uint32_t b_block_index = GetJobBlockIndex(c, b);
+    if (a_block_index < b_block_index)
+    {
+        return -1;
+    }
+    else if (a_block_index > b_block_index)
+    {
+        return 1;
+    }
+    return 0;
+}
+
+static struct AssetWriteList* CreateAssetWriteList(uint32_t asset_count)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(asset_count, "%u")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    size_t awl_size = sizeof(struct AssetWriteList) + sizeof(uint32_t) * asset_count + sizeof(uint32_t) * asset_count;
+    struct AssetWriteList* awl = (struct AssetWriteList*)(Longtail_Alloc("CreateAssetWriteList", awl_size));
+    if (!awl)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_Alloc() failed with %d", ENOMEM)
+        return 0;
+    }
+    awl->m_BlockJobCount = 0;
+    awl->m_AssetJobCount = 0;
+    awl->m_BlockJobAssetIndexes = (uint32_t*)(void*)&awl[1];
+    awl->m_AssetIndexJobs = &awl->m_BlockJobAssetIndexes[asset_count];
+    return awl;
+}
+
+static int BuildAssetWriteList(
+    uint32_t asset_count,
+    const uint32_t* optional_asset_indexes,
+    uint32_t* name_offsets,
+    const char* name_data,
+    const TLongtail_Hash* chunk_hashes,
+    const uint32_t* asset_chunk_counts,
+    const uint32_t* asset_chunk_index_starts,
+    const uint32_t* asset_chunk_indexes,
+    struct Longtail_LookupTable* chunk_hash_to_block_index,
+    struct AssetWriteList** out_asset_write_list)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(asset_count, "%u"),
+        LONGTAIL_LOGFIELD(optional_asset_indexes, "%p"),
+        LONGTAIL_LOGFIELD(name_offsets, "%p"),
+        LONGTAIL_LOGFIELD(name_data, "%p"),
+        LONGTAIL_LOGFIELD(chunk_hashes, "%p"),
+        LONGTAIL_LOGFIELD(asset_chunk_counts, "%p"),
+        LONGTAIL_LOGFIELD(asset_chunk_index_starts, "%p"),
+        LONGTAIL_LOGFIELD(asset_chunk_indexes, "%p"),
+        LONGTAIL_LOGFIELD(chunk_hash_to_block_index, "%p"),
+        LONGTAIL_LOGFIELD(out_asset_write_list, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_FATAL_ASSERT(ctx, asset_count == 0 || name_offsets != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, asset_count == 0 || name_data != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, asset_count == 0 || chunk_hashes != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, asset_count == 0 || asset_chunk_counts != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, asset_count == 0 || asset_chunk_index_starts != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, asset_count == 0 || asset_chunk_indexes != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, chunk_hash_to_block_index != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, out_asset_write_list != 0, return EINVAL)
+
+    struct AssetWriteList* awl = CreateAssetWriteList(asset_count);
+    if (awl == 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateAssetWriteList() CreateAssetWriteList() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+
+    for (uint32_t i = 0; i < asset_count; ++i)
+    {
+        uint32_t asset_index = optional_asset_indexes ? optional_asset_indexes[i] : i;
+        const char* path = &name_data[name_offsets[asset_index]];
+        uint32_t chunk_count = asset_chunk_counts[asset_index];
+        uint32_t asset_chunk_offset = asset_chunk_index_starts[asset_index];
+        if (chunk_count == 0)
+        {
+            awl->m_AssetIndexJobs[awl->m_AssetJobCount] = asset_index;
+            ++awl->m_AssetJobCount;
+            continue;
+        }
+        uint32_t chunk_index = asset_chunk_indexes[asset_chunk_offset];
+        TLongtail_Hash chunk_hash = chunk_hashes[chunk_index];
+        uint32_t* content_block_index = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, chunk_hash);
+        if (content_block_index == 0)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", ENOENT)
+            Longtail_Free(awl);
+            return ENOENT;
+        }
+
+        int is_block_job = 1;
+        for (uint32_t c = 1; c < chunk_count; ++c)
+        {
+            uint32_t next_chunk_index = asset_chunk_indexes[asset_chunk_offset + c];
+            TLongtail_Hash next_chunk_hash = chunk_hashes[next_chunk_index];
+            uint32_t* next_content_block_index = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, next_chunk_hash);
+            if (next_content_block_index == 0)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", ENOENT)
+                Longtail_Free(awl);
+                return ENOENT;
+            }
+            if (*content_block_index != *next_content_block_index)
+            {
+                is_block_job = 0;
+                // We don't break here since we want to validate that all the chunks are in the content index
+            }
+        }
+
+        if (is_block_job)
+        {
+            awl->m_BlockJobAssetIndexes[awl->m_BlockJobCount] = asset_index;
+            ++awl->m_BlockJobCount;
+        }
+        else
+        {
+            awl->m_AssetIndexJobs[awl->m_AssetJobCount] = asset_index;
+            ++awl->m_AssetJobCount;
+        }
+    }
+
+    struct JobCompareContext block_job_compare_context = {
+            awl,
+            asset_chunk_counts,
+            asset_chunk_index_starts,
+            asset_chunk_indexes,
+            chunk_hashes,
+            chunk_hash_to_block_index
+        };
+    QSORT(awl->m_BlockJobAssetIndexes, (size_t)awl->m_BlockJobCount, sizeof(uint32_t), JobCompare, &block_job_compare_context);
+    QSORT(awl->m_AssetIndexJobs, (size_t)awl->m_AssetJobCount, sizeof(uint32_t), JobCompare, &block_job_compare_context);
+
+    *out_asset_write_list = awl;
+    return 0;
+}
+
+static int WriteAssets(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    struct Longtail_StorageAPI* version_storage_api,
+    struct Longtail_JobAPI* job_api,
+    struct Longtail_ProgressAPI* progress_api,
+    struct Longtail_CancelAPI* optional_cancel_api,
+    Longtail_CancelAPI_HCancelToken optional_cancel_token,
+    const struct Longtail_StoreIndex* store_index,
+    const struct Longtail_VersionIndex* version_index,
+    const char* version_path,
+    struct Longtail_LookupTable* chunk_hash_to_block_index,
+    struct AssetWriteList* awl,
+    int retain_permssions)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(job_api, "%p"),
+        LONGTAIL_LOGFIELD(progress_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(version_path, "%s"),
+        LONGTAIL_LOGFIELD(chunk_hash_to_block_index, "%p"),
+        LONGTAIL_LOGFIELD(awl, "%p"),
+        LONGTAIL_LOGFIELD(retain_permssions, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_FATAL_ASSERT(ctx, block_store_api != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, version_storage_api != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, job_api != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, version_path != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, chunk_hash_to_block_index != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, awl != 0, return EINVAL)
+
+#if defined(LONGTAIL_ASSERTS)
+    {
+        uint32_t j = 0;
+        while (j < awl->m_BlockJobCount)
+        {
+            uint32_t asset_index = awl->m_BlockJobAssetIndexes[j];
+            TLongtail_Hash first_chunk_hash = version_index->m_ChunkHashes[version_index->m_AssetChunkIndexes[version_index->m_AssetChunkIndexStarts[asset_index]]];
+            const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, first_chunk_hash);
+            if (!block_index_ptr)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", EINVAL)
+                return EINVAL;
+            }
+            uint32_t block_index = *block_index_ptr;
+            TLongtail_Hash block_hash = store_index->m_BlockHashes[block_index];
+
+            ++j;
+            while (j < awl->m_BlockJobCount)
+            {
+                uint32_t asset_index = awl->m_BlockJobAssetIndexes[j];
+                TLongtail_Hash first_chunk_hash = version_index->m_ChunkHashes[version_index->m_AssetChunkIndexes[version_index->m_AssetChunkIndexStarts[asset_index]]];
+                const uint32_t* next_block_index_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, first_chunk_hash);
+                if (!next_block_index_ptr)
+                {
+                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", EINVAL)
+                    return EINVAL;
+                }
+                uint32_t next_block_index = *next_block_index_ptr;
+                if (next_block_index != block_index)
+                {
+                    break;
+                }
+                ++j;
+            }
+        }
+    }
+#endif // defined(LONGTAIL_ASSERTS)
+
+    const uint32_t max_parallell_block_read_jobs = GetMaxParallelBlockReadJobs(job_api);
+
+    uint32_t asset_job_count = 0;
+    for (uint32_t a = 0; a < awl->m_AssetJobCount; ++a)
+    {
+        uint32_t asset_index = awl->m_AssetIndexJobs[a];
+        uint32_t chunk_index_start = version_index->m_AssetChunkIndexStarts[asset_index];
+        uint32_t chunk_count = version_index->m_AssetChunkCounts[asset_index];
+        if (chunk_count == 0)
+        {
+            asset_job_count += 1;   // Write job
+            continue;
+        }
+
+        uint32_t chunk_index_end = chunk_index_start + chunk_count;
+        uint32_t chunk_index_offset = chunk_index_start;
+
+        while(chunk_index_offset != chunk_index_end)
+        {
+            uint32_t block_read_job_count = 0;
+            TLongtail_Hash block_hashes[MAX_BLOCKS_PER_PARTIAL_ASSET_WRITE];
+            while (chunk_index_offset != chunk_index_end && block_read_job_count < max_parallell_block_read_jobs)
+            {
+                uint32_t chunk_index = version_index->m_AssetChunkIndexes[chunk_index_offset];
+                TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
+                const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, chunk_hash);
+                LONGTAIL_FATAL_ASSERT(ctx, block_index_ptr, return EINVAL)
+                uint32_t block_index = *block_index_ptr;
+                TLongtail_Hash block_hash = store_index->m_BlockHashes[block_index];
+                int has_block = 0;
+                for (uint32_t d = 0; d < block_read_job_count; ++d)
+                {
+                    if (block_hashes[d] == block_hash)
+                    {
+                        has_block = 1;
+                        break;
+                    }
+                }
+                if (!has_block)
+                {
+                    block_hashes[block_read_job_count++] = block_hash;
+                }
+                ++chunk_index_offset;
+            }
+            asset_job_count += 1;   // Write job
+            asset_job_count += 1;   // Sync job
+            asset_job_count += block_read_job_count;
+        }
+    }
+
+    int err = block_store_api->PreflightGet(block_store_api, *store_index->m_BlockCount, store_index->m_BlockHashes, 0);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_store_api->PreflightGet() failed with %d", err)
+        return err;
+    }
+
+    if (optional_cancel_api && optional_cancel_token && optional_cancel_api->IsCancelled(optional_cancel_api, optional_cancel_token) == ECANCELED)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Cancelled, failed with %d", ECANCELED)
+        return ECANCELED;
+    }
+
+    struct WriteAssetsFromBlockJob* block_jobs = (struct WriteAssetsFromBlockJob*)Longtail_Alloc("WriteAssets", (size_t)(sizeof(struct WriteAssetsFromBlockJob) * awl->m_BlockJobCount));
+    if (!block_jobs)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+
+    uint32_t job_count = asset_job_count;
+    {
+        uint32_t j = 0;
+        uint32_t block_job_count = 0;
+        while (j < awl->m_BlockJobCount)
+        {
+            uint32_t asset_index = awl->m_BlockJobAssetIndexes[j];
+            TLongtail_Hash first_chunk_hash = version_index->m_ChunkHashes[version_index->m_AssetChunkIndexes[version_index->m_AssetChunkIndexStarts[asset_index]]];
+            const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, first_chunk_hash);
+            LONGTAIL_FATAL_ASSERT(ctx, block_index_ptr, return EINVAL)
+            uint32_t block_index = *block_index_ptr;
+
+            job_count++;
+
+            ++j;
+            while (j < awl->m_BlockJobCount)
+            {
+                uint32_t next_asset_index = awl->m_BlockJobAssetIndexes[j];
+                TLongtail_Hash next_first_chunk_hash = version_index->m_ChunkHashes[version_index->m_AssetChunkIndexes[version_index->m_AssetChunkIndexStarts[next_asset_index]]];
+                uint32_t* next_block_index = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, next_first_chunk_hash);
+                LONGTAIL_FATAL_ASSERT(ctx, next_block_index != 0, return EINVAL)
+                if (block_index != *next_block_index)
+                {
+                    break;
+                }
+
+                ++j;
+            }
+
+            job_count++;
+        }
+    }
+
+    Longtail_JobAPI_Group job_group = 0;
+    err = job_api->ReserveJobs(job_api, job_count, &job_group);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job_api->ReserveJobs() failed with %d", err)
+        Longtail_Free(block_jobs);
+        return err;
+    }
+
+    uint32_t j = 0;
+    uint32_t block_job_count = 0;
+    while (j < awl->m_BlockJobCount)
+    {
+        uint32_t asset_index = awl->m_BlockJobAssetIndexes[j];
+        TLongtail_Hash first_chunk_hash = version_index->m_ChunkHashes[version_index->m_AssetChunkIndexes[version_index->m_AssetChunkIndexStarts[asset_index]]];
+        const uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, first_chunk_hash);
+        LONGTAIL_FATAL_ASSERT(ctx, block_index_ptr, return EINVAL)
+        uint32_t block_index = *block_index_ptr;
+
+        struct WriteAssetsFromBlockJob* job = &block_jobs[block_job_count++];
+        struct BlockReaderJob* block_job = &job->m_BlockReadJob;
+        block_job->m_BlockStoreAPI = block_store_api;
+        block_job->m_AsyncCompleteAPI.m_API.Dispose = 0;
+        block_job->m_AsyncCompleteAPI.OnComplete = 0;
+        block_job->m_BlockHash = store_index->m_BlockHashes[block_index];
+        block_job->m_TargetBuffer = 0;
+        block_job->m_TargetBufferSize = 0;
+        block_job->m_JobAPI = job_api;
+        block_job->m_JobID = 0;
+        block_job->m_StoredBlock = 0;
+        Longtail_JobAPI_JobFunc block_read_funcs[1] = { BlockReader };
+        void* block_read_ctxs[1] = {block_job};
+        Longtail_JobAPI_Jobs block_read_job;
+        err = job_api->CreateJobs(job_api, job_group, progress_api, optional_cancel_api, optional_cancel_token, 1, block_read_funcs, block_read_ctxs, 1, &block_read_job);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job_api->CreateJobs() failed with %d", err)
+            return err;
+        }
+
+        job->m_VersionStorageAPI = version_storage_api;
+        job->m_VersionIndex = version_index;
+        job->m_VersionFolder = version_path;
+        job->m_BlockIndex = block_index;
+        job->m_AssetIndexes = &awl->m_BlockJobAssetIndexes[j];
+        job->m_RetainPermissions = retain_permssions;
+
+        job->m_AssetCount = 1;
+        ++j;
+        while (j < awl->m_BlockJobCount)
+        {
+            uint32_t next_asset_index = awl->m_BlockJobAssetIndexes[j];
+            TLongtail_Hash next_first_chunk_hash = version_index->m_ChunkHashes[version_index->m_AssetChunkIndexes[version_index->m_AssetChunkIndexStarts[next_asset_index]]];
+            uint32_t* next_block_index = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, next_first_chunk_hash);
+            LONGTAIL_FATAL_ASSERT(ctx, next_block_index != 0, return EINVAL)
+            if (block_index != *next_block_index)
+            {
+                break;
+            }
+
+            ++job->m_AssetCount;
+            ++j;
+        }
+
+        Longtail_JobAPI_JobFunc funcs[1] = { WriteAssetsFromBlock };
+        void* ctxs[1] = { job };
+
+        Longtail_JobAPI_Jobs block_write_job;
+        err = job_api->CreateJobs(job_api, job_group, progress_api, optional_cancel_api, optional_cancel_token, 1, funcs, ctxs, 0, &block_write_job);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job_api->CreateJobs() failed with %d", err)
+            return err;
+        }
+        err = job_api->AddDependecies(job_api, 1, block_write_job, 1, block_read_job);
         LONGTAIL_FATAL_ASSERT(ctx, err == 0, return err)
         err = job_api->ReadyJobs(job_api, 1, block_read_job);
         LONGTAIL_FATAL_ASSERT(ctx, err == 0, return err)
     }
-/*
-block_readorCount = blocks_remaning > 8 ? 8 : blocks_remaning
+/*
+block_readorCount = blocks_remaning > 8 ? 8 : blocks_remaning
+
+Create block_reador Tasks [block_readorCount]
+Create WriteSync Task
+Create Write Task
+    Depends on block_reador Tasks [block_readorCount]
+    Depends on WriteSync Task
+
+Ready block_reador Tasks [block_readorCount]
+Ready WriteSync Task
+
+WaitForAllTasks()
+
+JOBS:
+
+Write Task Execute (When block_reador Tasks [block_readorCount] and WriteSync Task is complete)
+    Newblock_readorCount = blocks_remaning > 8 ? 8 : blocks_remaning
+    if ([block_readorCount] > 0)
+        Create block_reador Tasks for up to remaining blocks [Newblock_readorCount]
+        Create WriteSync Task
+        Create Write Task
+            Depends on block_reador Tasks [Newblock_readorCount]
+            Depends on WriteSync Task
+        Ready block_reador Tasks [Newblock_readorCount]
+    Write and Longtail_Free block_readed Tasks Data [block_readorCount] To Disk
+    if ([block_readorCount] > 0)
+        Ready WriteSync Task
+*/
+
+    size_t asset_jobs_size = sizeof(struct WritePartialAssetFromBlocksJob) * awl->m_AssetJobCount;
+    struct WritePartialAssetFromBlocksJob* asset_jobs = (struct WritePartialAssetFromBlocksJob*)Longtail_Alloc("WriteAssets", asset_jobs_size);
+    if (!asset_jobs)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(block_jobs);
+        return ENOMEM;
+    }
+    for (uint32_t a = 0; a < awl->m_AssetJobCount; ++a)
+    {
+        Longtail_JobAPI_Jobs write_sync_job;
+        err = CreatePartialAssetWriteJob(
+            block_store_api,
+            version_storage_api,
+            job_api,
+            progress_api,
+            optional_cancel_api,
+            optional_cancel_token,
+            store_index,
+            version_index,
+            version_path,
+            chunk_hash_to_block_index,
+            awl->m_AssetIndexJobs[a],
+            retain_permssions,
+            job_group,
+            &asset_jobs[a],
+            0,
+            (Longtail_StorageAPI_HOpenFile)0,
+            &write_sync_job);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreatePartialAssetWriteJob() failed with %d", err)
+            Longtail_Free(asset_jobs);
+            Longtail_Free(block_jobs);
+            return err;
+        }
+        err = job_api->ReadyJobs(job_api, 1, write_sync_job);
+        LONGTAIL_FATAL_ASSERT(ctx, err == 0, return err)
+    }
+
+    err = job_api->WaitForAllJobs(job_api, job_group, progress_api, optional_cancel_api, optional_cancel_token);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job_api->WaitForAllJobs() failed with %d", err)
+        Longtail_Free(asset_jobs);
+        Longtail_Free(block_jobs);
+        return err;
+    }
+
+    Longtail_Free(asset_jobs);
+    Longtail_Free(block_jobs);
+
+    return 0;
+}
+
+int Longtail_WriteVersion(
+    struct Longtail_BlockStoreAPI* block_storage_api,
+    struct Longtail_StorageAPI* version_storage_api,
+    struct Longtail_JobAPI* job_api,
+    struct Longtail_ProgressAPI* progress_api,
+    struct Longtail_CancelAPI* optional_cancel_api,
+    Longtail_CancelAPI_HCancelToken optional_cancel_token,
+    const struct Longtail_StoreIndex* store_index,
+    const struct Longtail_VersionIndex* version_index,
+    const char* version_path,
+    int retain_permissions)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(job_api, "%p"),
+        LONGTAIL_LOGFIELD(progress_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(version_path, "%s"),
+        LONGTAIL_LOGFIELD(retain_permissions, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, job_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_path != 0, return EINVAL)
+
+    if (*version_index->m_AssetCount == 0)
+    {
+        return 0;
+    }
+
+    uint32_t block_count = *store_index->m_BlockCount;
+    uint32_t chunk_count = *store_index->m_ChunkCount;
+    struct Longtail_LookupTable* chunk_hash_to_block_index = LongtailPrivate_LookupTable_Create(Longtail_Alloc("WriteVersion", LongtailPrivate_LookupTable_GetSize(chunk_count)), chunk_count, 0);
+    if (!chunk_hash_to_block_index)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    for (uint32_t b = 0; b < block_count; ++b)
+    {
+        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
+        uint32_t chunk_index_offset = store_index->m_BlockChunksOffsets[b];
+        for (uint32_t c = 0; c < block_chunk_count; ++c)
+    {
+            uint32_t chunk_index = chunk_index_offset + c;
+            TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_index];
+            LongtailPrivate_LookupTable_PutUnique(chunk_hash_to_block_index, chunk_hash, b);
+        }
+        chunk_index_offset += block_chunk_count;
+    }
+
+    uint32_t asset_count = *version_index->m_AssetCount;
+
+    struct AssetWriteList* awl;
+    int err = BuildAssetWriteList(
+        asset_count,
+        0,
+        version_index->m_NameOffsets,
+        version_index->m_NameData,
+        version_index->m_ChunkHashes,
+        version_index->m_AssetChunkCounts,
+        version_index->m_AssetChunkIndexStarts,
+        version_index->m_AssetChunkIndexes,
+        chunk_hash_to_block_index,
+        &awl);
+
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BuildAssetWriteList() failed with %d", err)
+        Longtail_Free(chunk_hash_to_block_index);
+        return err;
+    }
+
+    err = WriteAssets(
+        block_storage_api,
+        version_storage_api,
+        job_api,
+        progress_api,
+        optional_cancel_api,
+        optional_cancel_token,
+        store_index,
+        version_index,
+        version_path,
+        chunk_hash_to_block_index,
+        awl,
+        retain_permissions);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "WriteAssets() failed with %d", err)
+    }
+
+    Longtail_Free(awl);
+    Longtail_Free(chunk_hash_to_block_index);
+
+    return err;
+}
+
+static int CompareHash(const void* a_ptr, const void* b_ptr) 
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(a_ptr, "%p"),
+        LONGTAIL_LOGFIELD(b_ptr, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
+
+    TLongtail_Hash a = *((const TLongtail_Hash*)a_ptr);
+    TLongtail_Hash b = *((const TLongtail_Hash*)b_ptr);
+    if (a > b) return  1;
+    if (a < b) return -1;
+    return 0;
+}
+
+static uint32_t MakeUnique(TLongtail_Hash* hashes, uint32_t count)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(hashes, "%p"),
+        LONGTAIL_LOGFIELD(count, "%u")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_FATAL_ASSERT(ctx, count == 0 || hashes != 0, return 0)
+
+    uint32_t w = 0;
+    uint32_t r = 0;
+    while (r < count)
+    {
+        hashes[w] = hashes[r];
+        ++r;
+        while (r < count && hashes[r - 1] == hashes[r])
+        {
+            ++r;
+        }
+        ++w;
+    }
+    return w;
+}
+
+static int DiffHashes(
+    const TLongtail_Hash* reference_hashes,
+    uint32_t reference_hash_count,
+    const TLongtail_Hash* new_hashes,
+    uint32_t new_hash_count,
+    uint32_t* added_hash_count,
+    TLongtail_Hash* added_hashes,
+    uint32_t* removed_hash_count,
+    TLongtail_Hash* removed_hashes)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(reference_hashes, "%p"),
+        LONGTAIL_LOGFIELD(reference_hash_count, "%u"),
+        LONGTAIL_LOGFIELD(new_hashes, "%p"),
+        LONGTAIL_LOGFIELD(new_hash_count, "%u"),
+        LONGTAIL_LOGFIELD(added_hash_count, "%p"),
+        LONGTAIL_LOGFIELD(added_hashes, "%p"),
+        LONGTAIL_LOGFIELD(removed_hash_count, "%p"),
+        LONGTAIL_LOGFIELD(removed_hashes, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_FATAL_ASSERT(ctx, reference_hash_count == 0 || reference_hashes != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, new_hash_count == 0 || added_hashes != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, added_hash_count != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, added_hashes != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, (removed_hash_count == 0 && removed_hashes == 0) || (removed_hash_count != 0 && removed_hashes != 0), return EINVAL)
+
+    size_t work_mem_size = (sizeof(TLongtail_Hash) * reference_hash_count) +
+        (sizeof(TLongtail_Hash) * new_hash_count);
+    void* work_mem = Longtail_Alloc("DiffHashes", work_mem_size);
+    if (!work_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+
+    TLongtail_Hash* tmp_refs = (TLongtail_Hash*)work_mem;
+    TLongtail_Hash* tmp_news = (TLongtail_Hash*)&tmp_refs[reference_hash_count];
+
+    memmove(tmp_refs, reference_hashes, (size_t)(sizeof(TLongtail_Hash) * reference_hash_count));
+    memmove(tmp_news, new_hashes, (size_t)(sizeof(TLongtail_Hash) * new_hash_count));
+
+    qsort(&tmp_refs[0], (size_t)reference_hash_count, sizeof(TLongtail_Hash), CompareHash);
+    reference_hash_count = MakeUnique(&tmp_refs[0], reference_hash_count);
+
+    qsort(&tmp_news[0], (size_t)new_hash_count, sizeof(TLongtail_Hash), CompareHash);
+    new_hash_count = MakeUnique(&tmp_news[0], new_hash_count);
+
+    uint32_t removed = 0;
+    uint32_t added = 0;
+    uint32_t ni = 0;
+    uint32_t ri = 0;
+    while (ri < reference_hash_count && ni < new_hash_count)
+    {
+        if (tmp_refs[ri] == tmp_news[ni])
+        {
+            ++ri;
+            ++ni;
+            continue;
+        }
+        else if (tmp_refs[ri] < tmp_news[ni])
+        {
+            if (removed_hashes)
+            {
+                removed_hashes[removed] = tmp_refs[ri];
+            }
+            ++removed;
+            ++ri;
+        }
+        else if (tmp_refs[ri] > tmp_news[ni])
+        {
+            added_hashes[added++] = tmp_news[ni++];
+        }
+    }
+    while (ni < new_hash_count)
+    {
+        added_hashes[added++] = tmp_news[ni++];
+    }
+    *added_hash_count = added;
+    while (ri < reference_hash_count)
+    {
+        if (removed_hashes)
+        {
+            removed_hashes[removed] = tmp_refs[ri];
+        }
+        ++removed;
+        ++ri;
+    }
+    if (removed_hash_count)
+    {
+        *removed_hash_count = removed;
+    }
+
+    Longtail_Free(work_mem);
+    work_mem = 0;
+
+    if (added > 0)
+    {
+        // Reorder the new hashes so they are in the same order that they where when they were created
+        // so chunks that belongs together are group together in blocks
+        struct Longtail_LookupTable* added_hashes_lookup = LongtailPrivate_LookupTable_Create(Longtail_Alloc("DiffHashes", LongtailPrivate_LookupTable_GetSize(added)), added, 0);
+        if (!added_hashes_lookup)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+            return ENOMEM;
+        }
+        for (uint32_t i = 0; i < added; ++i)
+        {
+            LongtailPrivate_LookupTable_Put(added_hashes_lookup, added_hashes[i], i);
+        }
+        added = 0;
+        for (uint32_t i = 0; i < new_hash_count; ++i)
+        {
+            TLongtail_Hash hash = new_hashes[i];
+            if (LongtailPrivate_LookupTable_Get(added_hashes_lookup, hash) == 0)
+            {
+                continue;
+            }
+            added_hashes[added++] = hash;
+        }
+        Longtail_Free(added_hashes_lookup);
+    }
+    return 0;
+}
+
+int Longtail_CreateStoreIndex(
+    struct Longtail_HashAPI* hash_api,
+    uint32_t chunk_count,
+    const TLongtail_Hash* chunk_hashes,
+    const uint32_t* chunk_sizes,
+    const uint32_t* optional_chunk_tags,
+    uint32_t max_block_size,
+    uint32_t max_chunks_per_block,
+    struct Longtail_StoreIndex** out_store_index)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(hash_api, "%p"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u"),
+        LONGTAIL_LOGFIELD(chunk_hashes, "%p"),
+        LONGTAIL_LOGFIELD(chunk_sizes, "%p"),
+        LONGTAIL_LOGFIELD(optional_chunk_tags, "%p"),
+        LONGTAIL_LOGFIELD(max_block_size, "%u"),
+        LONGTAIL_LOGFIELD(max_chunks_per_block, "%u"),
+        LONGTAIL_LOGFIELD(out_store_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || hash_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || chunk_hashes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || chunk_sizes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || max_block_size != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || max_chunks_per_block != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
+
+    if (chunk_count == 0)
+    {
+        int err = Longtail_CreateStoreIndexFromBlocks(0, 0, out_store_index);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
+            return err;
+        }
+        return 0;
+    }
+
+    size_t work_mem_size = (sizeof(uint32_t) * chunk_count) +
+        (sizeof(struct Longtail_BlockIndex*) * chunk_count) +
+        (sizeof(uint32_t) * max_chunks_per_block);
+    struct ScratchScope scratch;
+    struct Longtail_ScratchArena* scratch_arena = AcquireScratchScope(&scratch, "Longtail_CreateStoreIndex", work_mem_size + LongtailPrivate_LookupTable_GetSize((uint32_t)chunk_count) + 64);
+    if (!scratch_arena)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "AcquireScratchScope() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    void* work_mem = Longtail_ScratchArena_Alloc(scratch_arena, work_mem_size);
+    if (!work_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_Alloc() failed with %d", ENOMEM)
+        ReleaseScratchScope(&scratch);
+        return ENOMEM;
+    }
+    uint32_t* tmp_chunk_indexes = (uint32_t*)work_mem;
+    struct Longtail_BlockIndex** tmp_block_indexes = (struct Longtail_BlockIndex**)&tmp_chunk_indexes[chunk_count];
+    uint32_t* tmp_stored_chunk_indexes = (uint32_t*)&tmp_block_indexes[chunk_count];
+    uint32_t unique_chunk_count = GetUniqueHashes(scratch_arena, (uint32_t)chunk_count, chunk_hashes, tmp_chunk_indexes);
+
+    uint32_t i = 0;
+    uint32_t block_count = 0;
+
+    while (i < unique_chunk_count)
+    {
+        uint32_t chunk_count_in_block = 0;
+
+        uint32_t chunk_index = tmp_chunk_indexes[i];
+
+        uint32_t current_size = chunk_sizes[chunk_index];
+        uint32_t current_tag = optional_chunk_tags ? optional_chunk_tags[chunk_index] : 0;
+
+        tmp_stored_chunk_indexes[chunk_count_in_block] = chunk_index;
+        ++chunk_count_in_block;
+
+        while((i + 1) < unique_chunk_count)
+        {
+            chunk_index = tmp_chunk_indexes[(i + 1)];
+            uint32_t chunk_size = chunk_sizes[chunk_index];
+            uint32_t tag = optional_chunk_tags ? optional_chunk_tags[chunk_index] : 0;
+
+            if (tag != current_tag)
+            {
+                break;
+            }
+
+            // Break if resulting chunk count will exceed max_chunks_per_block
+            if (chunk_count_in_block == max_chunks_per_block)
+            {
+                break;
+            }
+
+            // Overshoot by 10% is ok
+            if ((current_size + chunk_size) > (max_block_size + (max_block_size / 10)))
+            {
+                break;
+            }
+
+            current_size += chunk_size;
+            tmp_stored_chunk_indexes[chunk_count_in_block] = chunk_index;
+            ++chunk_count_in_block;
+
+            ++i;
+        }
+
+        int err = Longtail_CreateBlockIndex(
+            hash_api,
+            current_tag,
+            chunk_count_in_block,
+            tmp_stored_chunk_indexes,
+            chunk_hashes,
+            chunk_sizes,
+            &tmp_block_indexes[block_count]);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateBlockIndex() failed with %d", err)
+            for (uint32_t b = 0; b < block_count; ++b)
+            {
+                Longtail_Free(tmp_block_indexes[b]);
+            }
+            ReleaseScratchScope(&scratch);
+            return err;
+        }
+
+        ++block_count;
+        ++i;
+    }
+
+    int err = Longtail_CreateStoreIndexFromBlocks(
+        block_count,
+        (const struct Longtail_BlockIndex**)tmp_block_indexes,
+        out_store_index);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
+        for (uint32_t b = 0; b < block_count; ++b)
+        {
+            Longtail_Free(tmp_block_indexes[b]);
+        }
+        ReleaseScratchScope(&scratch);
+        return err;
+    }
+
+    for (uint32_t b = 0; b < block_count; ++b)
+    {
+        struct Longtail_BlockIndex* block_index = tmp_block_indexes[b];
+        Longtail_Free(block_index);
+        block_index = 0;
+    }
+    ReleaseScratchScope(&scratch);
+    return err;
+}
+
+int Longtail_CreateMissingContent(
+    struct Longtail_HashAPI* hash_api,
+    const struct Longtail_StoreIndex* store_index,
+    const struct Longtail_VersionIndex* version_index,
+    uint32_t max_block_size,
+    uint32_t max_chunks_per_block,
+    struct Longtail_StoreIndex** out_store_index)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(hash_api, "%p"),
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(max_block_size, "%u"),
+        LONGTAIL_LOGFIELD(max_chunks_per_block, "%u"),
+        LONGTAIL_LOGFIELD(out_store_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, hash_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, max_block_size != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, max_chunks_per_block != 0, return EINVAL)
+
+    uint32_t chunk_count = *version_index->m_ChunkCount;
+    size_t added_hashes_size = sizeof(TLongtail_Hash) * chunk_count;
+    TLongtail_Hash* added_hashes = (TLongtail_Hash*)Longtail_Alloc("CreateMissingContent", added_hashes_size);
+    if (!added_hashes)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+
+    uint32_t added_hash_count = 0;
+    int err = DiffHashes(
+        store_index->m_ChunkHashes,
+        *store_index->m_ChunkCount,
+        version_index->m_ChunkHashes,
+        chunk_count,
+        &added_hash_count,
+        added_hashes,
+        0,
+        0);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "DiffHashes() failed with %d", err)
+        Longtail_Free(added_hashes);
+        return err;
+    }
+
+    if (added_hash_count == 0)
+    {
+        Longtail_Free(added_hashes);
+        err = Longtail_CreateStoreIndexFromBlocks(
+            0,
+            0,
+            out_store_index);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
+        }
+        return err;
+    }
+
+    size_t chunk_index_lookup_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
+    size_t tmp_diff_chunk_sizes_size = sizeof(uint32_t) * added_hash_count;
+    size_t tmp_diff_chunk_tags_size = sizeof(uint32_t) * added_hash_count;
+    size_t work_mem_size =
+        chunk_index_lookup_size +
+        tmp_diff_chunk_sizes_size +
+        tmp_diff_chunk_tags_size;
+    void* work_mem = Longtail_Alloc("CreateMissingContent", work_mem_size);
+    if (!work_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(added_hashes);
+        return ENOMEM;
+    }
+    char* p = (char*)work_mem;
+    struct Longtail_LookupTable* chunk_index_lookup = LongtailPrivate_LookupTable_Create(p, chunk_count, 0);
+    p += chunk_index_lookup_size;
+    uint32_t* tmp_diff_chunk_sizes = (uint32_t*)p;
+    p += tmp_diff_chunk_sizes_size;
+    uint32_t* tmp_diff_chunk_tags = (uint32_t*)p;
+
+    for (uint32_t i = 0; i < chunk_count; ++i)
+    {
+        LongtailPrivate_LookupTable_Put(chunk_index_lookup, version_index->m_ChunkHashes[i], i);
+    }
+
+    for (uint32_t j = 0; j < added_hash_count; ++j)
+    {
+        const uint32_t* chunk_index_ptr = LongtailPrivate_LookupTable_Get(chunk_index_lookup, added_hashes[j]);
+        LONGTAIL_FATAL_ASSERT(ctx, chunk_index_ptr, return EINVAL)
+        uint32_t chunk_index = *chunk_index_ptr;
+        tmp_diff_chunk_sizes[j] = version_index->m_ChunkSizes[chunk_index];
+        tmp_diff_chunk_tags[j] = version_index->m_ChunkTags[chunk_index];
+    }
+
+    err = Longtail_CreateStoreIndex(
+        hash_api,
+        added_hash_count,
+        added_hashes,
+        tmp_diff_chunk_sizes,
+        tmp_diff_chunk_tags,
+        max_block_size,
+        max_chunks_per_block,
+        out_store_index);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexRaw() failed with %d", err)
+    }
+
+    Longtail_Free(work_mem);
+    Longtail_Free(added_hashes);
+
+    return err;
+}
+
+int Longtail_GetMissingChunks(
+    const struct Longtail_StoreIndex* store_index,
+    uint32_t chunk_count,
+    const TLongtail_Hash* chunk_hashes,
+    uint32_t* out_chunk_count,
+    TLongtail_Hash* out_missing_chunk_hashes)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u"),
+        LONGTAIL_LOGFIELD(chunk_hashes, "%p"),
+        LONGTAIL_LOGFIELD(out_chunk_count, "%p"),
+        LONGTAIL_LOGFIELD(out_missing_chunk_hashes, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, (chunk_count == 0) || (chunk_hashes != 0), return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_chunk_count != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, (chunk_count == 0) || (out_missing_chunk_hashes != 0), return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count <= 0xffffffffu, return EINVAL)
+
+    uint32_t reference_chunk_count = *store_index->m_ChunkCount;
+    void* chunk_to_reference_block_index_lookup_mem = Longtail_Alloc("GetMissingChunks", LongtailPrivate_LookupTable_GetSize(reference_chunk_count));
+    if (!chunk_to_reference_block_index_lookup_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    struct Longtail_LookupTable* chunk_to_reference_block_index_lookup = LongtailPrivate_LookupTable_Create(chunk_to_reference_block_index_lookup_mem, reference_chunk_count, 0);
+    LONGTAIL_FATAL_ASSERT(ctx, chunk_to_reference_block_index_lookup != 0, return EINVAL )
+
+    uint32_t reference_block_count = *store_index->m_BlockCount;
+    for (uint32_t b = 0; b < reference_block_count; ++b)
+    {
+        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
+        uint32_t chunk_index_offset = store_index->m_BlockChunksOffsets[b];
+        for (uint32_t c = 0; c < block_chunk_count; ++c)
+    {
+            uint32_t chunk_index = chunk_index_offset + c;
+            TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_index];
+            LongtailPrivate_LookupTable_PutUnique(chunk_to_reference_block_index_lookup, chunk_hash, b);
+        }
+    }
+
+    uint32_t missing_chunk_count = 0;
+    for (uint32_t c = 0; c < (uint32_t)chunk_count; ++c)
+    {
+        TLongtail_Hash chunk_hash = chunk_hashes[c];
+        if (LongtailPrivate_LookupTable_Get(chunk_to_reference_block_index_lookup, chunk_hash))
+        {
+            continue;
+        }
+        out_missing_chunk_hashes[missing_chunk_count++] = chunk_hash;
+    }
+    Longtail_Free(chunk_to_reference_block_index_lookup);
+    *out_chunk_count = missing_chunk_count;
+    return 0;
+}
+
+static SORTFUNC(SortBlockUsageHighToLow)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(a_ptr, "%p"),
+        LONGTAIL_LOGFIELD(b_ptr, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
+
+    const uint32_t* block_usages = (const uint32_t*)context;
+    const uint32_t a_index = *(const uint32_t*)a_ptr;
+    const uint32_t b_index = *(const uint32_t*)b_ptr;
+    const uint32_t a_usage = block_usages[a_index];
+    const uint32_t b_usage = block_usages[b_index];
+    return (a_usage < b_usage) ?
+        1 : ((a_usage > b_usage) ?
+            -1 : ((a_index < b_index) ?
+                -1 : ((a_index == b_index) ?
+                    0 : 1)));
+}
+
+int Longtail_GetExistingStoreIndex(
+    const struct Longtail_StoreIndex* store_index,
+    uint32_t chunk_count,
+    const TLongtail_Hash* chunks,
+    uint32_t min_block_usage_percent,
+    struct Longtail_StoreIndex** out_store_index)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u"),
+        LONGTAIL_LOGFIELD(chunks, "%p"),
+        LONGTAIL_LOGFIELD(min_block_usage_percent, "%u"),
+        LONGTAIL_LOGFIELD(out_store_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, (chunk_count == 0) || (chunks != 0), return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
+
+    uint32_t hash_identifier = *store_index->m_HashIdentifier;
+    uint32_t store_block_count = *store_index->m_BlockCount;
+    uint32_t store_chunk_count = *store_index->m_ChunkCount;
+
+    size_t chunk_to_index_lookup_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
+    size_t block_to_index_lookup_size = LongtailPrivate_LookupTable_GetSize(store_block_count);
+    size_t chunk_to_store_index_lookup_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
+    size_t found_store_block_hashes_size = sizeof(TLongtail_Hash) * store_block_count;
+    size_t block_uses_percent_size = sizeof(uint32_t) * store_block_count;
+    size_t block_index_size = sizeof(uint32_t) * store_block_count;
+    size_t block_order_size = sizeof(uint32_t) * store_block_count;
+
+    size_t tmp_mem_size = chunk_to_index_lookup_size +
+        block_to_index_lookup_size +
+        chunk_to_store_index_lookup_size +
+        found_store_block_hashes_size +
+        block_uses_percent_size +
+        block_index_size +
+        block_order_size;
+
+    struct ScratchScope scratch;
+    struct Longtail_ScratchArena* scratch_arena = AcquireScratchScope(&scratch, "Longtail_GetExistingStoreIndex", tmp_mem_size);
+    if (!scratch_arena)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "AcquireScratchScope() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    void* tmp_mem = Longtail_ScratchArena_Alloc(scratch_arena, tmp_mem_size);
+    if (!tmp_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_Alloc() failed with %d", ENOMEM)
+        ReleaseScratchScope(&scratch);
+        return ENOMEM;
+    }
+    char* p = (char*)tmp_mem;
+
+    struct Longtail_LookupTable* chunk_to_index_lookup = LongtailPrivate_LookupTable_Create(p, chunk_count, 0);
+    p += chunk_to_index_lookup_size;
+
+    struct Longtail_LookupTable* block_to_index_lookup = LongtailPrivate_LookupTable_Create(p, store_block_count, 0);
+    p += block_to_index_lookup_size;
+
+    struct Longtail_LookupTable* chunk_to_store_index_lookup = LongtailPrivate_LookupTable_Create(p, chunk_count, 0);
+    p += chunk_to_store_index_lookup_size;
+
+    TLongtail_Hash* found_store_block_hashes = (TLongtail_Hash*)p;
+    p += found_store_block_hashes_size;
+
+    uint32_t* block_uses_percent = (uint32_t*)p;
+    p += block_uses_percent_size;
+
+    uint32_t* block_index = (uint32_t*)p;
+    p += block_index_size;
+
+    uint32_t* block_order = (uint32_t*)p;
+    p += block_order_size;
+
+    uint32_t unique_chunk_count = 0;
+    for (uint32_t i = 0; i < chunk_count; ++i)
+    {
+        TLongtail_Hash chunk_hash = chunks[i];
+        uint32_t* c_ptr = LongtailPrivate_LookupTable_PutUnique(chunk_to_index_lookup, chunk_hash, i);
+        if (c_ptr)
+        {
+            continue;
+        }
+        ++unique_chunk_count;
+    }
+
+    uint32_t found_block_count = 0;
+    uint32_t found_chunk_count = 0;
+    if (min_block_usage_percent <= 100)
+    {
+        uint32_t potential_block_count = 0;
+        for (uint32_t b = 0; b < store_block_count; ++b)
+        {
+            uint32_t block_use = 0;
+            uint32_t block_size = 0;
+            TLongtail_Hash block_hash = store_index->m_BlockHashes[b];
+            uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
+            uint32_t chunk_offset = store_index->m_BlockChunksOffsets[b];
+            for (uint32_t c = 0; c < block_chunk_count; ++c)
+            {
+                uint32_t chunk_size = store_index->m_ChunkSizes[chunk_offset];
+                TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_offset];
+                ++chunk_offset;
+                block_size += chunk_size;
+                if (LongtailPrivate_LookupTable_Get(chunk_to_index_lookup, chunk_hash))
+                {
+                    block_use += chunk_size;
+                }
+            }
+            if (block_use > 0)
+            {
+                uint32_t block_usage_percent = (uint32_t)(((uint64_t)block_use * 100) / block_size);
+                if (min_block_usage_percent > 0 &&
+                    block_usage_percent < min_block_usage_percent) {
+                    continue;
+                }
+
+                block_order[potential_block_count] = potential_block_count;
+                block_index[potential_block_count] = b;
+                block_uses_percent[potential_block_count] = block_usage_percent;
+
+                ++potential_block_count;
+            }
+        }
+
+        if (potential_block_count == 0)
+        {
+            ReleaseScratchScope(&scratch);
+            return Longtail_CreateStoreIndexFromBlocks(
+                0,
+                0,
+                out_store_index);
+        }
+
+        // Favour blocks we use more data out of - if a chunk is in multiple blocks we want to pick
+        // the blocks that has highest ratio of use inside the block.
+        // This does not guarantee a perfect block match as one block can be a 100% match which
+        // could lead to skipping part or whole of another 100% match block resulting in us
+        // picking a block that we will not use 100% of
+        QSORT(block_order, potential_block_count, sizeof(uint32_t), SortBlockUsageHighToLow, (void*)block_uses_percent);
+
+        for (uint32_t bo = 0; (bo < potential_block_count) && (found_chunk_count < unique_chunk_count); ++bo)
+        {
+            uint32_t pb = block_order[bo];
+            uint32_t b = block_index[pb];
+
+            TLongtail_Hash block_hash = store_index->m_BlockHashes[b];
+            uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
+            uint32_t store_chunk_index_offset = store_index->m_BlockChunksOffsets[b];
+            uint32_t current_found_block_index = found_block_count;
+            for (uint32_t c = 0; c < block_chunk_count; ++c)
+            {
+                TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[store_chunk_index_offset];
+                if (!LongtailPrivate_LookupTable_Get(chunk_to_index_lookup, chunk_hash))
+                {
+                    ++store_chunk_index_offset;
+                    continue;
+                }
+                if (LongtailPrivate_LookupTable_PutUnique(chunk_to_store_index_lookup, chunk_hash, store_chunk_index_offset))
+                {
+                    ++store_chunk_index_offset;
+                    continue;
+                }
+                found_chunk_count++;
+                if (current_found_block_index == found_block_count)
+                {
+                    uint32_t* block_index_ptr = LongtailPrivate_LookupTable_PutUnique(block_to_index_lookup, block_hash, current_found_block_index);
+                    if (block_index_ptr == 0)
+                    {
+                        found_store_block_hashes[found_block_count++] = block_hash;
+                    }
+                    ++store_chunk_index_offset;
+                    continue;
+                }
+                ++store_chunk_index_offset;
+            }
+        }
+    }
+
+    if (found_block_count == 0)
+    {
+        ReleaseScratchScope(&scratch);
+        return Longtail_CreateStoreIndexFromBlocks(
+            0,
+            0,
+            out_store_index);
+    }
+
+    // We have a list of block hashes we want to keep in found_store_block_hashes
+    // We have a lookup from block hash to block index in store index in block_to_index_lookup
+
+    size_t block_hash_lookup_size = LongtailPrivate_LookupTable_GetSize(found_block_count);
+    size_t block_index_header_ptrs_size = sizeof(struct LongtailBlockIndex*) * found_block_count;
+    size_t block_index_headers_size = sizeof(struct Longtail_BlockIndex) * found_block_count;
+    size_t tmp_mem_2_size = block_index_header_ptrs_size +
+        block_index_headers_size +
+        block_hash_lookup_size;
+    void* tmp_mem_2 = Longtail_ScratchArena_Alloc(scratch_arena, tmp_mem_2_size);
+    if (!tmp_mem_2){
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_Alloc() failed with %d", ENOMEM)
+        ReleaseScratchScope(&scratch);
+        return ENOMEM;
+
+    }
+    struct Longtail_BlockIndex** block_index_header_ptrs = (struct Longtail_BlockIndex**)tmp_mem_2;
+    struct Longtail_BlockIndex* block_index_headers = (struct Longtail_BlockIndex*)&block_index_header_ptrs[found_block_count];
+    struct Longtail_LookupTable* block_hash_lookup = LongtailPrivate_LookupTable_Create(&((char*)block_index_headers)[block_index_headers_size], found_block_count, 0);
+    for (uint32_t b = 0; b < store_block_count; ++b)
+    {
+        TLongtail_Hash block_hash = store_index->m_BlockHashes[b];
+        if (0 == LongtailPrivate_LookupTable_Get(block_to_index_lookup, block_hash))
+        {
+            continue;
+        }
+        LongtailPrivate_LookupTable_Put(block_hash_lookup, block_hash, b);
+    }
+
+    for (uint32_t b = 0; b < found_block_count; ++b)
+    {
+        TLongtail_Hash block_hash = found_store_block_hashes[b];
+        uint32_t store_block_index = *LongtailPrivate_LookupTable_Get(block_hash_lookup, block_hash);
+        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[store_block_index];
+        uint32_t block_chunk_index_offset = store_index->m_BlockChunksOffsets[store_block_index];
+        block_index_headers[b].m_BlockHash = &store_index->m_BlockHashes[store_block_index];
+        block_index_headers[b].m_HashIdentifier = store_index->m_HashIdentifier;
+        block_index_headers[b].m_ChunkCount = &store_index->m_BlockChunkCounts[store_block_index];
+        block_index_headers[b].m_Tag = &store_index->m_BlockTags[store_block_index];
+        block_index_headers[b].m_ChunkHashes = &store_index->m_ChunkHashes[block_chunk_index_offset];
+        block_index_headers[b].m_ChunkSizes = &store_index->m_ChunkSizes[block_chunk_index_offset];
+        block_index_header_ptrs[b] = &block_index_headers[b];
+    }
+
+    int err = Longtail_CreateStoreIndexFromBlocks(
+        found_block_count,
+        (const struct Longtail_BlockIndex**)block_index_header_ptrs,
+        out_store_index);
+    ReleaseScratchScope(&scratch);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
+        return err;
+    }
+    return 0;
+}
+
+static int CompareHashes(const void* a_ptr, const void* b_ptr)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(a_ptr, "%p"),
+        LONGTAIL_LOGFIELD(b_ptr, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
+
+    TLongtail_Hash a = *(const TLongtail_Hash*)a_ptr;
+    TLongtail_Hash b = *(const TLongtail_Hash*)b_ptr;
+    return (a > b) ? 1 : (a < b) ? -1 : 0;
+}
+
+static SORTFUNC(SortPathShortToLong)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(a_ptr, "%p"),
+        LONGTAIL_LOGFIELD(b_ptr, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
+
+        const uint32_t* asset_path_lengths = (const uint32_t*)context;
+    uint32_t a = *(const uint32_t*)a_ptr;
+    uint32_t b = *(const uint32_t*)b_ptr;
+    uint32_t a_len = asset_path_lengths[a];
+    uint32_t b_len = asset_path_lengths[b];
+    if (a_len < b_len)
+    {
+        return -1;
+    }
+    if (a_len > b_len)
+    {
+        return 1;
+    }
+    if (a < b)
+    {
+        return -1;
+    }
+    if (a > b)
+    {
+        return 1;
+    }
+    return 0;
+}
+
+static SORTFUNC(SortPathLongToShort)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(a_ptr, "%p"),
+        LONGTAIL_LOGFIELD(b_ptr, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
+    const uint32_t* asset_path_lengths = (const uint32_t*)context;
+    uint32_t a = *(const uint32_t*)a_ptr;
+    uint32_t b = *(const uint32_t*)b_ptr;
+    uint32_t a_len = asset_path_lengths[a];
+    uint32_t b_len = asset_path_lengths[b];
+    if (a_len < b_len)
+    {
+        return 1;
+    }
+    if (a_len > b_len)
+    {
+        return -1;
+    }
+    if (a < b)
+    {
+        return 1;
+    }
+    if (a > b)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static size_t GetVersionDiffDataSize(uint32_t removed_count, uint32_t added_count, uint32_t modified_content_count, uint32_t modified_permission_count, uint32_t moved_count)
+{
+    return
+        sizeof(uint32_t) +                              // m_SourceRemovedCount
+        sizeof(uint32_t) +                              // m_TargetAddedCount
+        sizeof(uint32_t) +                              // m_ModifiedContentCount
+        sizeof(uint32_t) +                              // m_ModifiedPermissionsCount
+        sizeof(uint32_t) +                              // m_MovedCount
+        sizeof(uint32_t) * removed_count +              // m_SourceRemovedAssetIndexes
+        sizeof(uint32_t) * added_count +                // m_TargetAddedAssetIndexes
+        sizeof(uint32_t) * modified_content_count +     // m_SourceContentModifiedAssetIndexes
+        sizeof(uint32_t) * modified_content_count +     // m_TargetContentModifiedAssetIndexes
+        sizeof(uint32_t) * modified_permission_count +  // m_SourcePermissionsModifiedAssetIndexes
+        sizeof(uint32_t) * modified_permission_count +  // m_TargetPermissionsModifiedAssetIndexes
+        sizeof(uint32_t) * moved_count +                // m_SourceMovedAssetIndexes
+        sizeof(uint32_t) * moved_count;                 // m_TargetMovedAssetIndexes
+}
+
+static size_t GetVersionDiffSize(uint32_t removed_count, uint32_t added_count, uint32_t modified_content_count, uint32_t modified_permission_count, uint32_t moved_count)
+{
+    return sizeof(struct Longtail_VersionDiff) +
+        GetVersionDiffDataSize(removed_count, added_count, modified_content_count, modified_permission_count, moved_count);
+}
+
+static void InitVersionDiff(struct Longtail_VersionDiff* version_diff)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(version_diff, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+
+    LONGTAIL_FATAL_ASSERT(ctx, version_diff != 0, return)
+
+    char* p = (char*)version_diff;
+    p += sizeof(struct Longtail_VersionDiff);
+
+    version_diff->m_SourceRemovedCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    version_diff->m_TargetAddedCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    version_diff->m_ModifiedContentCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    version_diff->m_ModifiedPermissionsCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    version_diff->m_MovedCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    uint32_t removed_count = *version_diff->m_SourceRemovedCount;
+    uint32_t added_count = *version_diff->m_TargetAddedCount;
+    uint32_t modified_content_count = *version_diff->m_ModifiedContentCount;
+    uint32_t modified_permissions_count = *version_diff->m_ModifiedPermissionsCount;
+    uint32_t moved_count = *version_diff->m_MovedCount;
+
+    version_diff->m_SourceRemovedAssetIndexes = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * removed_count;
+
+    version_diff->m_TargetAddedAssetIndexes = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * added_count;
+
+    version_diff->m_SourceContentModifiedAssetIndexes = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * modified_content_count;
+
+    version_diff->m_TargetContentModifiedAssetIndexes = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * modified_content_count;
+
+    version_diff->m_SourcePermissionsModifiedAssetIndexes = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * modified_permissions_count;
+
+    version_diff->m_TargetPermissionsModifiedAssetIndexes = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * modified_permissions_count;
+
+    version_diff->m_SourceMovedAssetIndexes = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * moved_count;
+
+    version_diff->m_TargetMovedAssetIndexes = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * moved_count;
+}
+
+int Longtail_CreateVersionDiff(
+    struct Longtail_HashAPI* hash_api,
+    const struct Longtail_VersionIndex* source_version,
+    const struct Longtail_VersionIndex* target_version,
+    struct Longtail_VersionDiff** out_version_diff)
+{
+    return Longtail_CreateVersionDiff2(hash_api, source_version, target_version, 0, out_version_diff);
+}
+
+// Pairs removed and added files with identical content and size, the paired entries are
+// taken out of the removed and added lists
+static uint32_t PairMovedAssets(
+    const struct Longtail_VersionIndex* source_version,
+    const struct Longtail_VersionIndex* target_version,
+    struct Longtail_LookupTable* content_hash_to_removed_index,
+    uint32_t* next_removed_index,
+    uint32_t* removed_source_asset_indexes,
+    uint32_t* source_removed_count,
+    uint32_t* added_target_asset_indexes,
+    uint32_t* target_added_count,
+    uint32_t* moved_source_asset_indexes,
+    uint32_t* moved_target_asset_indexes)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(source_version, "%p"),
+        LONGTAIL_LOGFIELD(target_version, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    const uint32_t unpaired = 0xffffffffu;
+    for (uint32_t r = 0; r < *source_removed_count; ++r)
+    {
+        uint32_t source_asset_index = removed_source_asset_indexes[r];
+        next_removed_index[r] = unpaired;
+        if (source_version->m_AssetSizes[source_asset_index] == 0)
+        {
+            continue;
+        }
+        const char* source_path = &source_version->m_NameData[source_version->m_NameOffsets[source_asset_index]];
+        if (IsDirPath(source_path))
+        {
+            continue;
+        }
+        uint32_t* first_removed_index = LongtailPrivate_LookupTable_PutUnique(content_hash_to_removed_index, source_version->m_ContentHashes[source_asset_index], r);
+        if (first_removed_index)
+        {
+            // Chain removed assets with the same content, most recent first
+            next_removed_index[r] = *first_removed_index;
+            *first_removed_index = r;
+        }
+    }
+
+    uint32_t moved_count = 0;
+    for (uint32_t a = 0; a < *target_added_count; ++a)
+    {
+        uint32_t target_asset_index = added_target_asset_indexes[a];
+        uint64_t target_asset_size = target_version->m_AssetSizes[target_asset_index];
+        if (target_asset_size == 0)
+        {
+            continue;
+        }
+        uint32_t* removed_index_ptr = LongtailPrivate_LookupTable_Get(content_hash_to_removed_index, target_version->m_ContentHashes[target_asset_index]);
+        if (!removed_index_ptr)
+        {
+            continue;
+        }
+        const char* target_path = &target_version->m_NameData[target_version->m_NameOffsets[target_asset_index]];
+        if (IsDirPath(target_path))
+        {
+            continue;
+        }
+        uint32_t* link = removed_index_ptr;
+        while (*link != unpaired && source_version->m_AssetSizes[removed_source_asset_indexes[*link]] != target_asset_size)
+        {
+            link = &next_removed_index[*link];
+        }
+        if (*link == unpaired)
+        {
+            continue;
+        }
+        uint32_t r = *link;
+        *link = next_removed_index[r];
+        uint32_t source_asset_index = removed_source_asset_indexes[r];
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Moved asset %s to %s", &source_version->m_NameData[source_version->m_NameOffsets[source_asset_index]], target_path)
+        moved_source_asset_indexes[moved_count] = source_asset_index;
+        moved_target_asset_indexes[moved_count] = target_asset_index;
+        ++moved_count;
+        removed_source_asset_indexes[r] = unpaired;
+        added_target_asset_indexes[a] = unpaired;
+    }
+    if (moved_count == 0)
+    {
+        return 0;
+    }
+
+    uint32_t kept_count = 0;
+    for (uint32_t r = 0; r < *source_removed_count; ++r)
+    {
+        if (removed_source_asset_indexes[r] != unpaired)
+        {
+            removed_source_asset_indexes[kept_count++] = removed_source_asset_indexes[r];
+        }
+    }
+    *source_removed_count = kept_count;
+    kept_count = 0;
+    for (uint32_t a = 0; a < *target_added_count; ++a)
+    {
+        if (added_target_asset_indexes[a] != unpaired)
+        {
+            added_target_asset_indexes[kept_count++] = added_target_asset_indexes[a];
+        }
+    }
+    *target_added_count = kept_count;
+    return moved_count;
+}
+
+int Longtail_CreateVersionDiff2(
+    struct Longtail_HashAPI* hash_api,
+    const struct Longtail_VersionIndex* source_version,
+    const struct Longtail_VersionIndex* target_version,
+    int detect_moved_assets,
+    struct Longtail_VersionDiff** out_version_diff)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(hash_api, "%p"),
+        LONGTAIL_LOGFIELD(source_version, "%p"),
+        LONGTAIL_LOGFIELD(target_version, "%p"),
+        LONGTAIL_LOGFIELD(detect_moved_assets, "%d"),
+        LONGTAIL_LOGFIELD(out_version_diff, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, source_version != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, target_version != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_version_diff != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, hash_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, hash_api->GetIdentifier(hash_api) == *source_version->m_HashIdentifier, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, hash_api->GetIdentifier(hash_api) == *target_version->m_HashIdentifier, return EINVAL)
+
+    uint32_t source_asset_count = *source_version->m_AssetCount;
+    uint32_t target_asset_count = *target_version->m_AssetCount;
+
+    size_t source_asset_lookup_table_size = LongtailPrivate_LookupTable_GetSize(source_asset_count);
+    size_t target_asset_lookup_table_size = LongtailPrivate_LookupTable_GetSize(target_asset_count);
+    size_t moved_lookup_table_size = detect_moved_assets ? LongtailPrivate_LookupTable_GetSize(source_asset_count) : 0;
+    size_t moved_work_mem_size = detect_moved_assets ? (moved_lookup_table_size + sizeof(uint32_t) * source_asset_count * 3) : 0;
+
+    size_t work_mem_size =
+        moved_work_mem_size +
+        source_asset_lookup_table_size +
+        target_asset_lookup_table_size +
+        sizeof(TLongtail_Hash) * source_asset_count +
+        sizeof(TLongtail_Hash) * target_asset_count +
+        sizeof(uint32_t) * source_asset_count +
+        sizeof(uint32_t) * target_asset_count +
+        sizeof(uint32_t) * source_asset_count +
+        sizeof(uint32_t) * target_asset_count +
+        sizeof(uint32_t) * source_asset_count +
+        sizeof(uint32_t) * target_asset_count +
+        sizeof(uint32_t) * source_asset_count +
+        sizeof(uint32_t) * target_asset_count;
+    struct ScratchScope scratch;
+    struct Longtail_ScratchArena* scratch_arena = AcquireScratchScope(&scratch, "Longtail_CreateVersionDiff", work_mem_size);
+    if (!scratch_arena)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "AcquireScratchScope() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    void* work_mem = Longtail_ScratchArena_Alloc(scratch_arena, work_mem_size);
+    if (!work_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_ScratchArena_Alloc() failed with %d", ENOMEM)
+        ReleaseScratchScope(&scratch);
+        return ENOMEM;
+    }
+    uint8_t* p = (uint8_t*)work_mem;
 
-Create block_reador Tasks [block_readorCount]
-Create WriteSync Task
-Create Write Task
-    Depends on block_reador Tasks [block_readorCount]
-    Depends on WriteSync Task
+    struct Longtail_LookupTable* source_path_hash_to_index = LongtailPrivate_LookupTable_Create(p, source_asset_count ,0);
+    p += source_asset_lookup_table_size;
+    struct Longtail_LookupTable* target_path_hash_to_index = LongtailPrivate_LookupTable_Create(p, target_asset_count ,0);
+    p += target_asset_lookup_table_size;
 
-Ready block_reador Tasks [block_readorCount]
-Ready WriteSync Task
+    TLongtail_Hash* source_path_hashes = (TLongtail_Hash*)p;
+    TLongtail_Hash* target_path_hashes = &source_path_hashes[source_asset_count];
 
-WaitForAllTasks()
+    uint32_t* removed_source_asset_indexes = (uint32_t*)&target_path_hashes[target_asset_count];
+    uint32_t* added_target_asset_indexes = &removed_source_asset_indexes[source_asset_count];
 
-JOBS:
+    uint32_t* modified_source_content_indexes = &added_target_asset_indexes[target_asset_count];
+    uint32_t* modified_target_content_indexes = &modified_source_content_indexes[source_asset_count];
 
-Write Task Execute (When block_reador Tasks [block_readorCount] and WriteSync Task is complete)
-    Newblock_readorCount = blocks_remaning > 8 ? 8 : blocks_remaning
-    if ([block_readorCount] > 0)
-        Create block_reador Tasks for up to remaining blocks [Newblock_readorCount]
-        Create WriteSync Task
-        Create Write Task
-            Depends on block_reador Tasks [Newblock_readorCount]
-            Depends on WriteSync Task
-        Ready block_reador Tasks [Newblock_readorCount]
-    Write and Longtail_Free block_readed Tasks Data [block_readorCount] To Disk
-    if ([block_readorCount] > 0)
-        Ready WriteSync Task
-*/
+    uint32_t* modified_source_permissions_indexes = &modified_target_content_indexes[target_asset_count];
+    uint32_t* modified_target_permissions_indexes = &modified_source_permissions_indexes[source_asset_count];
 
-    size_t asset_jobs_size = sizeof(struct WritePartialAssetFromBlocksJob) * awl->m_AssetJobCount;
-    struct WritePartialAssetFromBlocksJob* asset_jobs = (struct WritePartialAssetFromBlocksJob*)Longtail_Alloc("WriteAssets", asset_jobs_size);
-    if (!asset_jobs)
+    uint32_t* source_assets_path_lengths = &modified_target_permissions_indexes[target_asset_count];
+    uint32_t* target_assets_path_lengths = &source_assets_path_lengths[source_asset_count];
+    p = (uint8_t*)&target_assets_path_lengths[target_asset_count];
+
+    struct Longtail_LookupTable* content_hash_to_removed_index = detect_moved_assets ? LongtailPrivate_LookupTable_Create(p, source_asset_count, 0) : 0;
+    p += moved_lookup_table_size;
+    uint32_t* next_removed_index = (uint32_t*)p;
+    uint32_t* moved_source_asset_indexes = &next_removed_index[detect_moved_assets ? source_asset_count : 0];
+    uint32_t* moved_target_asset_indexes = &moved_source_asset_indexes[detect_moved_assets ? source_asset_count : 0];
+
+    if (*source_version->m_Version < LONGTAIL_VERSION_INDEX_VERSION_0_0_2)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        Longtail_Free(block_jobs);
-        return ENOMEM;
+        // We are re-hashing since we might have an older version hash that is incompatible
+        for (uint32_t i = 0; i < source_asset_count; ++i)
+        {
+            const char* path = &source_version->m_NameData[source_version->m_NameOffsets[i]];
+            source_assets_path_lengths[i] = (uint32_t)strlen(path);
+            int err = GetPathHashWithLength(hash_api, path, source_assets_path_lengths[i], &source_path_hashes[i]);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_GetPathHash() failed with %d", err)
+                ReleaseScratchScope(&scratch);
+                return err;
+            }
+            LongtailPrivate_LookupTable_Put(source_path_hash_to_index, source_path_hashes[i], i);
+        }
     }
-    for (uint32_t a = 0; a < awl->m_AssetJobCount; ++a)
+    else
     {
-        Longtail_JobAPI_Jobs write_sync_job;
-        err = CreatePartialAssetWriteJob(
-            block_store_api,
-            version_storage_api,
-            job_api,
-            progress_api,
-            optional_cancel_api,
-            optional_cancel_token,
-            store_index,
-            version_index,
-            version_path,
-            chunk_hash_to_block_index,
-            awl->m_AssetIndexJobs[a],
-            retain_permssions,
-            job_group,
-            &asset_jobs[a],
-            0,
-            (Longtail_StorageAPI_HOpenFile)0,
-            &write_sync_job);
-        if (err)
+        memcpy(source_path_hashes, source_version->m_PathHashes, sizeof(TLongtail_Hash) * source_asset_count);
+        for (uint32_t i = 0; i < source_asset_count; ++i)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreatePartialAssetWriteJob() failed with %d", err)
-            Longtail_Free(asset_jobs);
-            Longtail_Free(block_jobs);
-            return err;
+            const char* path = &source_version->m_NameData[source_version->m_NameOffsets[i]];
+            source_assets_path_lengths[i] = (uint32_t)strlen(path);
+            LongtailPrivate_LookupTable_Put(source_path_hash_to_index, source_version->m_PathHashes[i], i);
         }
-        err = job_api->ReadyJobs(job_api, 1, write_sync_job);
-        LONGTAIL_FATAL_ASSERT(ctx, err == 0, return err)
     }
 
-    err = job_api->WaitForAllJobs(job_api, job_group, progress_api, optional_cancel_api, optional_cancel_token);
-    if (err)
+    if (*target_version->m_Version < LONGTAIL_VERSION_INDEX_VERSION_0_0_2)
     {
-        LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "job_api->WaitForAllJobs() failed with %d", err)
-        Longtail_Free(asset_jobs);
-        Longtail_Free(block_jobs);
-        return err;
+        // We are re-hashing since we might have an older version hash that is incompatible
+        for (uint32_t i = 0; i < target_asset_count; ++i)
+        {
+            const char* path = &target_version->m_NameData[target_version->m_NameOffsets[i]];
+            target_assets_path_lengths[i] = (uint32_t)strlen(path);
+            int err = GetPathHashWithLength(hash_api, path, target_assets_path_lengths[i], &target_path_hashes[i]);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_GetPathHash() failed with %d", err)
+                ReleaseScratchScope(&scratch);
+                return err;
+            }
+            LongtailPrivate_LookupTable_Put(target_path_hash_to_index, target_path_hashes[i], i);
+        }
+    }
+    else
+    {
+        memcpy(target_path_hashes, target_version->m_PathHashes, sizeof(TLongtail_Hash) * target_asset_count);
+        for (uint32_t i = 0; i < target_asset_count; ++i)
+        {
+            const char* path = &target_version->m_NameData[target_version->m_NameOffsets[i]];
+            target_assets_path_lengths[i] = (uint32_t)strlen(path);
+            LongtailPrivate_LookupTable_Put(target_path_hash_to_index, target_version->m_PathHashes[i], i);
+        }
     }
 
-    Longtail_Free(asset_jobs);
-    Longtail_Free(block_jobs);
+    qsort(source_path_hashes, source_asset_count, sizeof(TLongtail_Hash), CompareHashes);
+    qsort(target_path_hashes, target_asset_count, sizeof(TLongtail_Hash), CompareHashes);
 
-    return 0;
-}
+    const uint32_t max_modified_content_count = source_asset_count < target_asset_count ? source_asset_count : target_asset_count;
+    const uint32_t max_modified_permission_count = source_asset_count < target_asset_count ? source_asset_count : target_asset_count;
+    const uint32_t indexes_count = source_asset_count + target_asset_count + max_modified_content_count + max_modified_content_count + max_modified_permission_count + max_modified_permission_count;
 
-int Longtail_WriteVersion(
-    struct Longtail_BlockStoreAPI* block_storage_api,
-    struct Longtail_StorageAPI* version_storage_api,
-    struct Longtail_JobAPI* job_api,
-    struct Longtail_ProgressAPI* progress_api,
-    struct Longtail_CancelAPI* optional_cancel_api,
-    Longtail_CancelAPI_HCancelToken optional_cancel_token,
-    const struct Longtail_StoreIndex* store_index,
-    const struct Longtail_VersionIndex* version_index,
-    const char* version_path,
-    int retain_permissions)
-{
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(block_storage_api, "%p"),
-        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
-        LONGTAIL_LOGFIELD(job_api, "%p"),
-        LONGTAIL_LOGFIELD(progress_api, "%p"),
-        LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
-        LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
-        LONGTAIL_LOGFIELD(store_index, "%p"),
-        LONGTAIL_LOGFIELD(version_index, "%p"),
-        LONGTAIL_LOGFIELD(version_path, "%s"),
-        LONGTAIL_LOGFIELD(retain_permissions, "%d")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+    uint32_t source_removed_count = 0;
+    uint32_t target_added_count = 0;
+    uint32_t modified_content_count = 0;
+    uint32_t modified_permissions_count = 0;
 
-    LONGTAIL_VALIDATE_INPUT(ctx, block_storage_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_storage_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, job_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_path != 0, return EINVAL)
+    uint32_t source_index = 0;
+    uint32_t target_index = 0;
+    while (source_index < source_asset_count && target_index < target_asset_count)
+    {
+        TLongtail_Hash source_path_hash = source_path_hashes[source_index];
+        TLongtail_Hash target_path_hash = target_path_hashes[target_index];
+        const uint32_t* source_asset_index_ptr = LongtailPrivate_LookupTable_Get(source_path_hash_to_index, source_path_hash);
+        LONGTAIL_FATAL_ASSERT(ctx, source_asset_index_ptr, return EINVAL)
+        uint32_t source_asset_index = *source_asset_index_ptr;
+        const uint32_t* target_asset_index_ptr = LongtailPrivate_LookupTable_Get(target_path_hash_to_index, target_path_hash);
+        LONGTAIL_FATAL_ASSERT(ctx, target_asset_index_ptr, return EINVAL)
+        uint32_t target_asset_index = *target_asset_index_ptr;
 
-    if (*version_index->m_AssetCount == 0)
+        const char* source_path = &source_version->m_NameData[source_version->m_NameOffsets[source_asset_index]];
+        const char* target_path = &target_version->m_NameData[target_version->m_NameOffsets[target_asset_index]];
+
+        if (source_path_hash == target_path_hash)
+        {
+            TLongtail_Hash source_content_hash = source_version->m_ContentHashes[source_asset_index];
+            TLongtail_Hash target_content_hash = target_version->m_ContentHashes[target_asset_index];
+            if (source_content_hash != target_content_hash)
+            {
+                modified_source_content_indexes[modified_content_count] = source_asset_index;
+                modified_target_content_indexes[modified_content_count] = target_asset_index;
+                ++modified_content_count;
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Mismatching content for asset %s", source_path)
+            }
+
+            uint16_t source_permissions = source_version->m_Permissions[source_asset_index];
+            uint16_t target_permissions = target_version->m_Permissions[target_asset_index];
+            if (source_permissions != target_permissions)
+            {
+                modified_source_permissions_indexes[modified_permissions_count] = source_asset_index;
+                modified_target_permissions_indexes[modified_permissions_count] = target_asset_index;
+                ++modified_permissions_count;
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Mismatching permissions for asset %s", source_path)
+            }
+
+            ++source_index;
+            ++target_index;
+        }
+        else if (source_path_hash < target_path_hash)
+        {
+            const uint32_t* source_asset_index_ptr = LongtailPrivate_LookupTable_Get(source_path_hash_to_index, source_path_hash);
+            LONGTAIL_FATAL_ASSERT(ctx, source_asset_index_ptr, return EINVAL)
+            source_asset_index = *source_asset_index_ptr;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Removed asset %s", source_path)
+            removed_source_asset_indexes[source_removed_count] = source_asset_index;
+            ++source_removed_count;
+            ++source_index;
+        }
+        else
+        {
+            const uint32_t* target_asset_index_ptr = LongtailPrivate_LookupTable_Get(target_path_hash_to_index, target_path_hash);
+            LONGTAIL_FATAL_ASSERT(ctx, target_asset_index_ptr, return EINVAL)
+            target_asset_index = *target_asset_index_ptr;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Added asset %s", target_path)
+            added_target_asset_indexes[target_added_count] = target_asset_index;
+            ++target_added_count;
+            ++target_index;
+        } 
+    }
+    while (source_index < source_asset_count)
     {
-        return 0;
+        // source_path_hash removed
+        TLongtail_Hash source_path_hash = source_path_hashes[source_index];
+        const uint32_t* source_asset_index_ptr = LongtailPrivate_LookupTable_Get(source_path_hash_to_index, source_path_hash);
+        LONGTAIL_FATAL_ASSERT(ctx, source_asset_index_ptr, return EINVAL)
+        uint32_t source_asset_index = *source_asset_index_ptr;
+        const char* source_path = &source_version->m_NameData[source_version->m_NameOffsets[source_asset_index]];
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Removed asset %s", source_path)
+        removed_source_asset_indexes[source_removed_count] = source_asset_index;
+        ++source_removed_count;
+        ++source_index;
     }
-
-    uint32_t block_count = *store_index->m_BlockCount;
-    uint32_t chunk_count = *store_index->m_ChunkCount;
-    struct Longtail_LookupTable* chunk_hash_to_block_index = LongtailPrivate_LookupTable_Create(Longtail_Alloc("WriteVersion", LongtailPrivate_LookupTable_GetSize(chunk_count)), chunk_count, 0);
-    if (!chunk_hash_to_block_index)
+    while (target_index < target_asset_count)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return ENOMEM;
+        // target_path_hash added
+        TLongtail_Hash target_path_hash = target_path_hashes[target_index];
+        const uint32_t* target_asset_index_ptr = LongtailPrivate_LookupTable_Get(target_path_hash_to_index, target_path_hash);
+        LONGTAIL_FATAL_ASSERT(ctx, target_asset_index_ptr, return EINVAL)
+        uint32_t target_asset_index = *target_asset_index_ptr;
+        const char* target_path = &target_version->m_NameData[target_version->m_NameOffsets[target_asset_index]];
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Added asset %s", target_path)
+        added_target_asset_indexes[target_added_count] = target_asset_index;
+        ++target_added_count;
+        ++target_index;
     }
-    for (uint32_t b = 0; b < block_count; ++b)
+    uint32_t moved_count = 0;
+    if (detect_moved_assets && source_removed_count > 0 && target_added_count > 0)
     {
-        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
-        uint32_t chunk_index_offset = store_index->m_BlockChunksOffsets[b];
-        for (uint32_t c = 0; c < block_chunk_count; ++c)
+        moved_count = PairMovedAssets(
+            source_version,
+            target_version,
+            content_hash_to_removed_index,
+            next_removed_index,
+            removed_source_asset_indexes,
+            &source_removed_count,
+            added_target_asset_indexes,
+            &target_added_count,
+            moved_source_asset_indexes,
+            moved_target_asset_indexes);
+    }
+    if (source_removed_count > 0)
     {
-            uint32_t chunk_index = chunk_index_offset + c;
-            TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_index];
-            LongtailPrivate_LookupTable_PutUnique(chunk_hash_to_block_index, chunk_hash, b);
-        }
-        chunk_index_offset += block_chunk_count;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Found %u removed assets", source_removed_count)
     }
-
-    uint32_t asset_count = *version_index->m_AssetCount;
-
-    struct AssetWriteList* awl;
-    int err = BuildAssetWriteList(
-        asset_count,
-        0,
-        version_index->m_NameOffsets,
-        version_index->m_NameData,
-        version_index->m_ChunkHashes,
-        version_index->m_AssetChunkCounts,
-        version_index->m_AssetChunkIndexStarts,
-        version_index->m_AssetChunkIndexes,
-        chunk_hash_to_block_index,
-        &awl);
-
-    if (err)
+    if (target_added_count > 0)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BuildAssetWriteList() failed with %d", err)
-        Longtail_Free(chunk_hash_to_block_index);
-        return err;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Found %u added assets", target_added_count)
     }
-
-    err = WriteAssets(
-        block_storage_api,
-        version_storage_api,
-        job_api,
-        progress_api,
-        optional_cancel_api,
-        optional_cancel_token,
-        store_index,
-        version_index,
-        version_path,
-        chunk_hash_to_block_index,
-        awl,
-        retain_permissions);
-    if (err)
+    if (modified_content_count > 0)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "WriteAssets() failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Mismatching content for %u assets found", modified_content_count)
     }
-
-    Longtail_Free(awl);
-    Longtail_Free(chunk_hash_to_block_index);
-
-    return err;
-}
-
-static int CompareHash(const void* a_ptr, const void* b_ptr) 
-{
-#if defined(LONGTAIL_ASSERTS)
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(a_ptr, "%p"),
-        LONGTAIL_LOGFIELD(b_ptr, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
-
-    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
-    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
-
-    TLongtail_Hash a = *((const TLongtail_Hash*)a_ptr);
-    TLongtail_Hash b = *((const TLongtail_Hash*)b_ptr);
-    if (a > b) return  1;
-    if (a < b) return -1;
-    return 0;
-}
-
-static uint32_t MakeUnique(TLongtail_Hash* hashes, uint32_t count)
-{
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(hashes, "%p"),
-        LONGTAIL_LOGFIELD(count, "%u")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-
-    LONGTAIL_FATAL_ASSERT(ctx, count == 0 || hashes != 0, return 0)
-
-    uint32_t w = 0;
-    uint32_t r = 0;
-    while (r < count)
+    if (modified_permissions_count > 0)
     {
-        hashes[w] = hashes[r];
-        ++r;
-        while (r < count && hashes[r - 1] == hashes[r])
-        {
-            ++r;
-        }
-        ++w;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Mismatching permission for %u assets found", modified_permissions_count)
+    }
+    if (moved_count > 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Found %u moved assets", moved_count)
     }
-    return w;
-}
-
-static int DiffHashes(
-    const TLongtail_Hash* reference_hashes,
-    uint32_t reference_hash_count,
-    const TLongtail_Hash* new_hashes,
-    uint32_t new_hash_count,
-    uint32_t* added_hash_count,
-    TLongtail_Hash* added_hashes,
-    uint32_t* removed_hash_count,
-    TLongtail_Hash* removed_hashes)
-{
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(reference_hashes, "%p"),
-        LONGTAIL_LOGFIELD(reference_hash_count, "%u"),
-        LONGTAIL_LOGFIELD(new_hashes, "%p"),
-        LONGTAIL_LOGFIELD(new_hash_count, "%u"),
-        LONGTAIL_LOGFIELD(added_hash_count, "%p"),
-        LONGTAIL_LOGFIELD(added_hashes, "%p"),
-        LONGTAIL_LOGFIELD(removed_hash_count, "%p"),
-        LONGTAIL_LOGFIELD(removed_hashes, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-
-    LONGTAIL_FATAL_ASSERT(ctx, reference_hash_count == 0 || reference_hashes != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, new_hash_count == 0 || added_hashes != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, added_hash_count != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, added_hashes != 0, return EINVAL)
-    LONGTAIL_FATAL_ASSERT(ctx, (removed_hash_count == 0 && removed_hashes == 0) || (removed_hash_count != 0 && removed_hashes != 0), return EINVAL)
 
-    size_t work_mem_size = (sizeof(TLongtail_Hash) * reference_hash_count) +
-        (sizeof(TLongtail_Hash) * new_hash_count);
-    void* work_mem = Longtail_Alloc("DiffHashes", work_mem_size);
-    if (!work_mem)
+    size_t version_diff_size = GetVersionDiffSize(source_removed_count, target_added_count, modified_content_count, modified_permissions_count, moved_count);
+    struct Longtail_VersionDiff* version_diff = (struct Longtail_VersionDiff*)Longtail_Alloc("CreateVersionDiff", version_diff_size);
+    if (!version_diff)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        ReleaseScratchScope(&scratch);
         return ENOMEM;
     }
+    uint32_t* counts_ptr = (uint32_t*)(void*)&version_diff[1];
+    counts_ptr[0] = source_removed_count;
+    counts_ptr[1] = target_added_count;
+    counts_ptr[2] = modified_content_count;
+    counts_ptr[3] = modified_permissions_count;
+    counts_ptr[4] = moved_count;
+    InitVersionDiff(version_diff);
 
-    TLongtail_Hash* tmp_refs = (TLongtail_Hash*)work_mem;
-    TLongtail_Hash* tmp_news = (TLongtail_Hash*)&tmp_refs[reference_hash_count];
+    memmove(version_diff->m_SourceRemovedAssetIndexes, removed_source_asset_indexes, sizeof(uint32_t) * source_removed_count);
+    memmove(version_diff->m_TargetAddedAssetIndexes, added_target_asset_indexes, sizeof(uint32_t) * target_added_count);
+    memmove(version_diff->m_SourceContentModifiedAssetIndexes, modified_source_content_indexes, sizeof(uint32_t) * modified_content_count);
+    memmove(version_diff->m_TargetContentModifiedAssetIndexes, modified_target_content_indexes, sizeof(uint32_t) * modified_content_count);
+    memmove(version_diff->m_SourcePermissionsModifiedAssetIndexes, modified_source_permissions_indexes, sizeof(uint32_t) * modified_permissions_count);
+    memmove(version_diff->m_TargetPermissionsModifiedAssetIndexes, modified_target_permissions_indexes, sizeof(uint32_t) * modified_permissions_count);
+    memmove(version_diff->m_SourceMovedAssetIndexes, moved_source_asset_indexes, sizeof(uint32_t) * moved_count);
+    memmove(version_diff->m_TargetMovedAssetIndexes, moved_target_asset_indexes, sizeof(uint32_t) * moved_count);
 
-    memmove(tmp_refs, reference_hashes, (size_t)(sizeof(TLongtail_Hash) * reference_hash_count));
-    memmove(tmp_news, new_hashes, (size_t)(sizeof(TLongtail_Hash) * new_hash_count));
+    QSORT(version_diff->m_SourceRemovedAssetIndexes, source_removed_count, sizeof(uint32_t), SortPathLongToShort, (void*)source_assets_path_lengths);
+    QSORT(version_diff->m_TargetAddedAssetIndexes, target_added_count, sizeof(uint32_t), SortPathShortToLong, (void*)target_assets_path_lengths);
 
-    qsort(&tmp_refs[0], (size_t)reference_hash_count, sizeof(TLongtail_Hash), CompareHash);
-    reference_hash_count = MakeUnique(&tmp_refs[0], reference_hash_count);
+    ReleaseScratchScope(&scratch);
+    *out_version_diff = version_diff;
+    return 0;
+}
 
-    qsort(&tmp_news[0], (size_t)new_hash_count, sizeof(TLongtail_Hash), CompareHash);
-    new_hash_count = MakeUnique(&tmp_news[0], new_hash_count);
+#define LONGTAIL_CHANGE_VERSION_STAGING_FOLDER ".longtail_staging"
 
-    uint32_t removed = 0;
-    uint32_t added = 0;
-    uint32_t ni = 0;
-    uint32_t ri = 0;
-    while (ri < reference_hash_count && ni < new_hash_count)
-    {
-        if (tmp_refs[ri] == tmp_news[ni])
-        {
-            ++ri;
-            ++ni;
-            continue;
-        }
-        else if (tmp_refs[ri] < tmp_news[ni])
-        {
-            if (removed_hashes)
-            {
-                removed_hashes[removed] = tmp_refs[ri];
-            }
-            ++removed;
-            ++ri;
-        }
-        else if (tmp_refs[ri] > tmp_news[ni])
-        {
-            added_hashes[added++] = tmp_news[ni++];
-        }
-    }
-    while (ni < new_hash_count)
+static char* GetSourceAssetPath(
+    struct Longtail_StorageAPI* version_storage_api,
+    const struct Longtail_VersionIndex* source_version,
+    const char* version_path,
+    const char* optional_staging_path,
+    uint32_t source_asset_index)
+{
+    if (optional_staging_path)
     {
-        added_hashes[added++] = tmp_news[ni++];
+        char staged_name[16];
+        snprintf(staged_name, sizeof(staged_name), "%u", source_asset_index);
+        return version_storage_api->ConcatPath(version_storage_api, optional_staging_path, staged_name);
     }
-    *added_hash_count = added;
-    while (ri < reference_hash_count)
+    const char* asset_path = &source_version->m_NameData[source_version->m_NameOffsets[source_asset_index]];
+    return version_storage_api->ConcatPath(version_storage_api, version_path, asset_path);
+}
+
+static int MakeWritable(struct Longtail_StorageAPI* storage_api, const char* path)
+{
+    uint16_t permissions = 0;
+    int err = storage_api->GetPermissions(storage_api, path, &permissions);
+    if (err)
     {
-        if (removed_hashes)
-        {
-            removed_hashes[removed] = tmp_refs[ri];
-        }
-        ++removed;
-        ++ri;
+        return err;
     }
-    if (removed_hash_count)
+    if (permissions & Longtail_StorageAPI_UserWriteAccess)
     {
-        *removed_hash_count = removed;
+        return 0;
     }
+    return storage_api->SetPermissions(storage_api, path, permissions | Longtail_StorageAPI_UserWriteAccess);
+}
 
-    Longtail_Free(work_mem);
-    work_mem = 0;
+// Moves a file of the source version into the staging folder, the staging folder is created on first use
+static int StageSourceAsset(
+    struct Longtail_StorageAPI* version_storage_api,
+    const struct Longtail_VersionIndex* source_version,
+    const char* version_path,
+    uint32_t source_asset_index,
+    uint8_t* source_asset_is_staged,
+    char** io_staging_path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(source_version, "%p"),
+        LONGTAIL_LOGFIELD(version_path, "%s"),
+        LONGTAIL_LOGFIELD(source_asset_index, "%u"),
+        LONGTAIL_LOGFIELD(source_asset_is_staged, "%p"),
+        LONGTAIL_LOGFIELD(io_staging_path, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    if (added > 0)
+    if (*io_staging_path == 0)
     {
-        // Reorder the new hashes so they are in the same order that they where when they were created
-        // so chunks that belongs together are group together in blocks
-        struct Longtail_LookupTable* added_hashes_lookup = LongtailPrivate_LookupTable_Create(Longtail_Alloc("DiffHashes", LongtailPrivate_LookupTable_GetSize(added)), added, 0);
-        if (!added_hashes_lookup)
+        char* staging_path = version_storage_api->ConcatPath(version_storage_api, version_path, LONGTAIL_CHANGE_VERSION_STAGING_FOLDER);
+        if (!staging_path)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ConcatPath() failed with %d", ENOMEM)
             return ENOMEM;
         }
-        for (uint32_t i = 0; i < added; ++i)
-        {
-            LongtailPrivate_LookupTable_Put(added_hashes_lookup, added_hashes[i], i);
-        }
-        added = 0;
-        for (uint32_t i = 0; i < new_hash_count; ++i)
+        *io_staging_path = staging_path;
+        int err = version_storage_api->CreateDir(version_storage_api, staging_path);
+        if (err && err != EEXIST)
         {
-            TLongtail_Hash hash = new_hashes[i];
-            if (LongtailPrivate_LookupTable_Get(added_hashes_lookup, hash) == 0)
-            {
-                continue;
-            }
-            added_hashes[added++] = hash;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->CreateDir() failed for `%s` with %d", staging_path, err)
+            return err;
         }
-        Longtail_Free(added_hashes_lookup);
     }
+    char* source_path = GetSourceAssetPath(version_storage_api, source_version, version_path, 0, source_asset_index);
+    char* staged_path = GetSourceAssetPath(version_storage_api, source_version, version_path, *io_staging_path, source_asset_index);
+    if (!source_path || !staged_path)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ConcatPath() failed with %d", ENOMEM)
+        Longtail_Free(staged_path);
+        Longtail_Free(source_path);
+        return ENOMEM;
+    }
+    if (version_storage_api->IsFile(version_storage_api, staged_path))
+    {
+        // Left over from an interrupted update
+        (void)MakeWritable(version_storage_api, staged_path);
+        (void)version_storage_api->RemoveFile(version_storage_api, staged_path);
+    }
+    int err = version_storage_api->RenameFile(version_storage_api, source_path, staged_path);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->RenameFile() failed for `%s` with %d", source_path, err)
+        Longtail_Free(staged_path);
+        Longtail_Free(source_path);
+        return err;
+    }
+    source_asset_is_staged[source_asset_index] = 1;
+    Longtail_Free(staged_path);
+    Longtail_Free(source_path);
     return 0;
 }
 
-int Longtail_CreateStoreIndex(
-    struct Longtail_HashAPI* hash_api,
-    uint32_t chunk_count,
-    const TLongtail_Hash* chunk_hashes,
-    const uint32_t* chunk_sizes,
-    const uint32_t* optional_chunk_tags,
-    uint32_t max_block_size,
-    uint32_t max_chunks_per_block,
-    struct Longtail_StoreIndex** out_store_index)
+// Moved assets are staged before removing assets so a move can not collide with a removed path
+static int StageMovedAssets(
+    struct Longtail_StorageAPI* version_storage_api,
+    const struct Longtail_VersionIndex* source_version,
+    const struct Longtail_VersionDiff* version_diff,
+    const char* version_path,
+    uint8_t* source_asset_is_staged,
+    char** io_staging_path)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(hash_api, "%p"),
-        LONGTAIL_LOGFIELD(chunk_count, "%u"),
-        LONGTAIL_LOGFIELD(chunk_hashes, "%p"),
-        LONGTAIL_LOGFIELD(chunk_sizes, "%p"),
-        LONGTAIL_LOGFIELD(optional_chunk_tags, "%p"),
-        LONGTAIL_LOGFIELD(max_block_size, "%u"),
-        LONGTAIL_LOGFIELD(max_chunks_per_block, "%u"),
-        LONGTAIL_LOGFIELD(out_store_index, "%p")
+        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(source_version, "%p"),
+        LONGTAIL_LOGFIELD(version_diff, "%p"),
+        LONGTAIL_LOGFIELD(version_path, "%s"),
+        LONGTAIL_LOGFIELD(source_asset_is_staged, "%p"),
+        LONGTAIL_LOGFIELD(io_staging_path, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || hash_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || chunk_hashes != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || chunk_sizes != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || max_block_size != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count == 0 || max_chunks_per_block != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
-
-    if (chunk_count == 0)
+    for (uint32_t m = 0; m < *version_diff->m_MovedCount; ++m)
     {
-        int err = Longtail_CreateStoreIndexFromBlocks(0, 0, out_store_index);
+        int err = StageSourceAsset(version_storage_api, source_version, version_path, version_diff->m_SourceMovedAssetIndexes[m], source_asset_is_staged, io_staging_path);
         if (err)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "StageSourceAsset() failed with %d", err)
             return err;
         }
-        return 0;
-    }
-
-    size_t work_mem_size = (sizeof(uint32_t) * chunk_count) +
-        (sizeof(struct Longtail_BlockIndex*) * chunk_count) +
-        (sizeof(uint32_t) * max_chunks_per_block);
-    void* work_mem = Longtail_Alloc("Longtail_CreateStoreIndex", work_mem_size);
-    if (!work_mem)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return ENOMEM;
     }
-    uint32_t* tmp_chunk_indexes = (uint32_t*)work_mem;
-    struct Longtail_BlockIndex** tmp_block_indexes = (struct Longtail_BlockIndex**)&tmp_chunk_indexes[chunk_count];
-    uint32_t* tmp_stored_chunk_indexes = (uint32_t*)&tmp_block_indexes[chunk_count];
-    uint32_t unique_chunk_count = GetUniqueHashes((uint32_t)chunk_count, chunk_hashes, tmp_chunk_indexes);
+    return 0;
+}
 
-    uint32_t i = 0;
-    uint32_t block_count = 0;
+static int ApplyMovedAssets(
+    struct Longtail_StorageAPI* version_storage_api,
+    const struct Longtail_VersionIndex* source_version,
+    const struct Longtail_VersionIndex* target_version,
+    const struct Longtail_VersionDiff* version_diff,
+    const char* version_path,
+    uint8_t* source_asset_is_staged,
+    const char* staging_path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(source_version, "%p"),
+        LONGTAIL_LOGFIELD(target_version, "%p"),
+        LONGTAIL_LOGFIELD(version_diff, "%p"),
+        LONGTAIL_LOGFIELD(version_path, "%s"),
+        LONGTAIL_LOGFIELD(source_asset_is_staged, "%p"),
+        LONGTAIL_LOGFIELD(staging_path, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    while (i < unique_chunk_count)
+    for (uint32_t m = 0; m < *version_diff->m_MovedCount; ++m)
     {
-        uint32_t chunk_count_in_block = 0;
-
-        uint32_t chunk_index = tmp_chunk_indexes[i];
-
-        uint32_t current_size = chunk_sizes[chunk_index];
-        uint32_t current_tag = optional_chunk_tags ? optional_chunk_tags[chunk_index] : 0;
-
-        tmp_stored_chunk_indexes[chunk_count_in_block] = chunk_index;
-        ++chunk_count_in_block;
-
-        while((i + 1) < unique_chunk_count)
+        uint32_t source_asset_index = version_diff->m_SourceMovedAssetIndexes[m];
+        uint32_t target_asset_index = version_diff->m_TargetMovedAssetIndexes[m];
+        const char* target_asset_path = &target_version->m_NameData[target_version->m_NameOffsets[target_asset_index]];
+        char* staged_path = GetSourceAssetPath(version_storage_api, source_version, version_path, staging_path, source_asset_index);
+        char* target_path = version_storage_api->ConcatPath(version_storage_api, version_path, target_asset_path);
+        if (!staged_path || !target_path)
         {
-            chunk_index = tmp_chunk_indexes[(i + 1)];
-            uint32_t chunk_size = chunk_sizes[chunk_index];
-            uint32_t tag = optional_chunk_tags ? optional_chunk_tags[chunk_index] : 0;
-
-            if (tag != current_tag)
-            {
-                break;
-            }
-
-            // Break if resulting chunk count will exceed max_chunks_per_block
-            if (chunk_count_in_block == max_chunks_per_block)
-            {
-                break;
-            }
-
-            // Overshoot by 10% is ok
-            if ((current_size + chunk_size) > (max_block_size + (max_block_size / 10)))
-            {
-                break;
-            }
-
-            current_size += chunk_size;
-            tmp_stored_chunk_indexes[chunk_count_in_block] = chunk_index;
-            ++chunk_count_in_block;
-
-            ++i;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ConcatPath() failed with %d", ENOMEM)
+            Longtail_Free(target_path);
+            Longtail_Free(staged_path);
+            return ENOMEM;
         }
-
-        int err = Longtail_CreateBlockIndex(
-            hash_api,
-            current_tag,
-            chunk_count_in_block,
-            tmp_stored_chunk_indexes,
-            chunk_hashes,
-            chunk_sizes,
-            &tmp_block_indexes[block_count]);
+        int err = EnsureParentPathExists(version_storage_api, target_path);
         if (err)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateBlockIndex() failed with %d", err)
-            Longtail_Free(work_mem);
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed for `%s` with %d", target_path, err)
+            Longtail_Free(target_path);
+            Longtail_Free(staged_path);
             return err;
         }
-
-        ++block_count;
-        ++i;
-    }
-
-    int err = Longtail_CreateStoreIndexFromBlocks(
-        block_count,
-        (const struct Longtail_BlockIndex**)tmp_block_indexes,
-        out_store_index);
-    if (err)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
-        return err;
-    }
-
-    for (uint32_t b = 0; b < block_count; ++b)
-    {
-        struct Longtail_BlockIndex* block_index = tmp_block_indexes[b];
-        Longtail_Free(block_index);
-        block_index = 0;
+        err = version_storage_api->RenameFile(version_storage_api, staged_path, target_path);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->RenameFile() failed for `%s` with %d", target_path, err)
+            Longtail_Free(target_path);
+            Longtail_Free(staged_path);
+            return err;
+        }
+        source_asset_is_staged[source_asset_index] = 0;
+        Longtail_Free(target_path);
+        Longtail_Free(staged_path);
     }
-    Longtail_Free(work_mem);
-    return err;
+    return 0;
 }
 
-int Longtail_CreateMissingContent(
-    struct Longtail_HashAPI* hash_api,
-    const struct Longtail_StoreIndex* store_index,
-    const struct Longtail_VersionIndex* version_index,
-    uint32_t max_block_size,
-    uint32_t max_chunks_per_block,
-    struct Longtail_StoreIndex** out_store_index)
+static void RemoveStagedAssets(
+    struct Longtail_StorageAPI* version_storage_api,
+    const struct Longtail_VersionIndex* source_version,
+    const uint8_t* source_asset_is_staged,
+    const char* staging_path)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(hash_api, "%p"),
-        LONGTAIL_LOGFIELD(store_index, "%p"),
-        LONGTAIL_LOGFIELD(version_index, "%p"),
-        LONGTAIL_LOGFIELD(max_block_size, "%u"),
-        LONGTAIL_LOGFIELD(max_chunks_per_block, "%u"),
-        LONGTAIL_LOGFIELD(out_store_index, "%p")
+        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(source_version, "%p"),
+        LONGTAIL_LOGFIELD(source_asset_is_staged, "%p"),
+        LONGTAIL_LOGFIELD(staging_path, "%s")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, hash_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, max_block_size != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, max_chunks_per_block != 0, return EINVAL)
-
-    uint32_t chunk_count = *version_index->m_ChunkCount;
-    size_t added_hashes_size = sizeof(TLongtail_Hash) * chunk_count;
-    TLongtail_Hash* added_hashes = (TLongtail_Hash*)Longtail_Alloc("CreateMissingContent", added_hashes_size);
-    if (!added_hashes)
+    uint32_t source_asset_count = *source_version->m_AssetCount;
+    for (uint32_t source_asset_index = 0; source_asset_index < source_asset_count; ++source_asset_index)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return ENOMEM;
+        if (!source_asset_is_staged[source_asset_index])
+        {
+            continue;
+        }
+        char* staged_path = GetSourceAssetPath(version_storage_api, source_version, 0, staging_path, source_asset_index);
+        if (!staged_path)
+        {
+            continue;
+        }
+        (void)MakeWritable(version_storage_api, staged_path);
+        int err = version_storage_api->RemoveFile(version_storage_api, staged_path);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "version_storage_api->RemoveFile() failed for `%s` with %d", staged_path, err)
+        }
+        Longtail_Free(staged_path);
     }
-
-    uint32_t added_hash_count = 0;
-    int err = DiffHashes(
-        store_index->m_ChunkHashes,
-        *store_index->m_ChunkCount,
-        version_index->m_ChunkHashes,
-        chunk_count,
-        &added_hash_count,
-        added_hashes,
-        0,
-        0);
+    int err = version_storage_api->RemoveDir(version_storage_api, staging_path);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "DiffHashes() failed with %d", err)
-        Longtail_Free(added_hashes);
-        return err;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "version_storage_api->RemoveDir() failed for `%s` with %d", staging_path, err)
     }
+}
 
-    if (added_hash_count == 0)
+// Puts staged files back where they came from, used when a version change fails so we don't lose
+// the original files of the source version
+static void RestoreStagedAssets(
+    struct Longtail_StorageAPI* version_storage_api,
+    const struct Longtail_VersionIndex* source_version,
+    const uint8_t* source_asset_is_staged,
+    const char* version_path,
+    const char* staging_path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(source_version, "%p"),
+        LONGTAIL_LOGFIELD(source_asset_is_staged, "%p"),
+        LONGTAIL_LOGFIELD(version_path, "%s"),
+        LONGTAIL_LOGFIELD(staging_path, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    uint32_t source_asset_count = *source_version->m_AssetCount;
+    for (uint32_t source_asset_index = 0; source_asset_index < source_asset_count; ++source_asset_index)
     {
-        Longtail_Free(added_hashes);
-        err = Longtail_CreateStoreIndexFromBlocks(
-            0,
-            0,
-            out_store_index);
+        if (!source_asset_is_staged[source_asset_index])
+        {
+            continue;
+        }
+        char* staged_path = GetSourceAssetPath(version_storage_api, source_version, version_path, staging_path, source_asset_index);
+        char* source_path = GetSourceAssetPath(version_storage_api, source_version, version_path, 0, source_asset_index);
+        if (!staged_path || !source_path)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ConcatPath() failed with %d", ENOMEM)
+            Longtail_Free(source_path);
+            Longtail_Free(staged_path);
+            continue;
+        }
+        int err = EnsureParentPathExists(version_storage_api, source_path);
+        if (!err && version_storage_api->IsFile(version_storage_api, source_path))
+        {
+            // Partially written content of the target version
+            (void)MakeWritable(version_storage_api, source_path);
+            err = version_storage_api->RemoveFile(version_storage_api, source_path);
+        }
+        if (!err)
+        {
+            err = version_storage_api->RenameFile(version_storage_api, staged_path, source_path);
+        }
         if (err)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to restore `%s` from `%s` with %d", source_path, staged_path, err)
         }
-        return err;
+        Longtail_Free(source_path);
+        Longtail_Free(staged_path);
     }
-
-    size_t chunk_index_lookup_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
-    size_t tmp_diff_chunk_sizes_size = sizeof(uint32_t) * added_hash_count;
-    size_t tmp_diff_chunk_tags_size = sizeof(uint32_t) * added_hash_count;
-    size_t work_mem_size =
-        chunk_index_lookup_size +
-        tmp_diff_chunk_sizes_size +
-        tmp_diff_chunk_tags_size;
-    void* work_mem = Longtail_Alloc("CreateMissingContent", work_mem_size);
-    if (!work_mem)
+    int err = version_storage_api->RemoveDir(version_storage_api, staging_path);
+    if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        Longtail_Free(added_hashes);
-        return ENOMEM;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "version_storage_api->RemoveDir() failed for `%s` with %d", staging_path, err)
     }
-    char* p = (char*)work_mem;
-    struct Longtail_LookupTable* chunk_index_lookup = LongtailPrivate_LookupTable_Create(p, chunk_count, 0);
-    p += chunk_index_lookup_size;
-    uint32_t* tmp_diff_chunk_sizes = (uint32_t*)p;
-    p += tmp_diff_chunk_sizes_size;
-    uint32_t* tmp_diff_chunk_tags = (uint32_t*)p;
+}
 
-    for (uint32_t i = 0; i < chunk_count; ++i)
+static int CleanUpRemoveAssets(
+    struct Longtail_StorageAPI* version_storage_api,
+    struct Longtail_CancelAPI* optional_cancel_api,
+    Longtail_CancelAPI_HCancelToken optional_cancel_token,
+    const struct Longtail_VersionIndex* source_version,
+    const struct Longtail_VersionDiff* version_diff,
+    const char* version_path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
+        LONGTAIL_LOGFIELD(source_version, "%p"),
+        LONGTAIL_LOGFIELD(version_diff, "%p"),
+        LONGTAIL_LOGFIELD(version_path, "%s")
+        MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+        LONGTAIL_VALIDATE_INPUT(ctx, version_storage_api != 0, return EINVAL)
+        LONGTAIL_VALIDATE_INPUT(ctx, source_version != 0, return EINVAL)
+        LONGTAIL_VALIDATE_INPUT(ctx, version_diff != 0, return EINVAL)
+        LONGTAIL_VALIDATE_INPUT(ctx, version_path != 0, return EINVAL)
+
+    uint32_t remove_count = *version_diff->m_SourceRemovedCount;
+    LONGTAIL_FATAL_ASSERT(ctx, remove_count <= *source_version->m_AssetCount, return EINVAL);
+    if (remove_count == 0)
     {
-        LongtailPrivate_LookupTable_Put(chunk_index_lookup, version_index->m_ChunkHashes[i], i);
+        return 0;
     }
 
-    for (uint32_t j = 0; j < added_hash_count; ++j)
+    int err = 0;
+    char* full_asset_path = 0;
+    uint32_t* remove_indexes = (uint32_t*)Longtail_Alloc("ChangeVersion", sizeof(uint32_t) * remove_count);
+    if (!remove_indexes)
     {
-        const uint32_t* chunk_index_ptr = LongtailPrivate_LookupTable_Get(chunk_index_lookup, added_hashes[j]);
-        LONGTAIL_FATAL_ASSERT(ctx, chunk_index_ptr, return EINVAL)
-        uint32_t chunk_index = *chunk_index_ptr;
-        tmp_diff_chunk_sizes[j] = version_index->m_ChunkSizes[chunk_index];
-        tmp_diff_chunk_tags[j] = version_index->m_ChunkTags[chunk_index];
+        err = ENOMEM;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", err)
+        return err;
     }
+    memcpy(remove_indexes, version_diff->m_SourceRemovedAssetIndexes, sizeof(uint32_t) * remove_count);
 
-    err = Longtail_CreateStoreIndex(
-        hash_api,
-        added_hash_count,
-        added_hashes,
-        tmp_diff_chunk_sizes,
-        tmp_diff_chunk_tags,
-        max_block_size,
-        max_chunks_per_block,
-        out_store_index);
-    if (err)
+    uint32_t retry_count = 10;
+    uint32_t successful_remove_count = 0;
+    while (retry_count && (successful_remove_count < remove_count))
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexRaw() failed with %d", err)
+        if (retry_count < 10)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Longtail_ChangeVersion: Retrying removal of remaning %u assets in %s", remove_count - successful_remove_count, version_path)
+        }
+        --retry_count;
+        if ((successful_remove_count & 0x7f) == 0x7f) {
+            if (optional_cancel_api && optional_cancel_token && optional_cancel_api->IsCancelled(optional_cancel_api, optional_cancel_token) == ECANCELED)
+            {
+                err = ECANCELED;
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Operation cancelled, failed with %d", err)
+                Longtail_Free(remove_indexes);
+                return err;
+            }
+        }
+        for (uint32_t r = 0; r < remove_count; ++r)
+        {
+            uint32_t asset_index = remove_indexes[r];
+            if (asset_index == 0xffffffff)
+            {
+                continue;
+            }
+            const char* asset_path = &source_version->m_NameData[source_version->m_NameOffsets[asset_index]];
+            char* full_asset_path = version_storage_api->ConcatPath(version_storage_api, version_path, asset_path);
+            if (IsDirPath(asset_path))
+            {
+                full_asset_path[strlen(full_asset_path) - 1] = '\0';
+                if (!version_storage_api->IsDir(version_storage_api, full_asset_path))
+                {
+                    remove_indexes[r] = 0xffffffff;
+                    Longtail_Free(full_asset_path);
+                    Longtail_Free(remove_indexes);
+                    return err;
+                }
+                uint16_t permissions = 0;
+                err = version_storage_api->GetPermissions(version_storage_api, full_asset_path, &permissions);
+                if (err)
+                {
+                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->GetPermissions() failed with %d", err)
+                    LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, err)
+                    Longtail_Free(full_asset_path);
+                    Longtail_Free(remove_indexes);
+                    return err;
+                }
+                if (!(permissions & Longtail_StorageAPI_UserWriteAccess))
+                {
+                    err = version_storage_api->SetPermissions(version_storage_api, full_asset_path, permissions | (Longtail_StorageAPI_UserWriteAccess | Longtail_StorageAPI_GroupWriteAccess | Longtail_StorageAPI_OtherWriteAccess));
+                    if (err)
+                    {
+                        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->SetPermissions() failed with %d", err)
+                        LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, err)
+                        Longtail_Free(full_asset_path);
+                        Longtail_Free(remove_indexes);
+                        return err;
+                    }
+                }
+                err = version_storage_api->RemoveDir(version_storage_api, full_asset_path);
+                if (err && version_storage_api->IsDir(version_storage_api, full_asset_path))
+                {
+                    if (!retry_count)
+                    {
+                        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Can't to remove dir `%s`, failed with %d", full_asset_path, err)
+                        Longtail_Free(full_asset_path);
+                        Longtail_Free(remove_indexes);
+                        LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, err)
+                        return err;
+                    }
+                    Longtail_Free(full_asset_path);
+                    full_asset_path = 0;
+                    continue;
+                }
+                LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, 0)
+            }
+            else
+            {
+                if (!version_storage_api->IsFile(version_storage_api, full_asset_path))
+                {
+                    remove_indexes[r] = 0xffffffff;
+                    Longtail_Free(full_asset_path);
+                    continue;
+                }
+                uint16_t permissions = 0;
+                err = version_storage_api->GetPermissions(version_storage_api, full_asset_path, &permissions);
+                if (err)
+                {
+                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->GetPermissions() failed with %d", err)
+                    LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, err)
+                    Longtail_Free(full_asset_path);
+                    Longtail_Free(remove_indexes);
+                    return err;
+                }
+                if (!(permissions & Longtail_StorageAPI_UserWriteAccess))
+                {
+                    err = version_storage_api->SetPermissions(version_storage_api, full_asset_path, permissions | (Longtail_StorageAPI_UserWriteAccess));
+                    if (err)
+                    {
+                        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->SetPermissions() failed with %d", err)
+                        LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, err)
+                        Longtail_Free(full_asset_path);
+                        Longtail_Free(remove_indexes);
+                        return err;
+                    }
+                }
+                err = version_storage_api->RemoveFile(version_storage_api, full_asset_path);
+                if (err && version_storage_api->IsFile(version_storage_api, full_asset_path))
+                {
+                    if (!retry_count)
+                    {
+                        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Can't to file dir `%s`, failed with %d", full_asset_path, err)
+                        LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, err)
+                        Longtail_Free(full_asset_path);
+                        Longtail_Free(remove_indexes);
+                        return err;
+                    }
+                    Longtail_Free(full_asset_path);
+                    full_asset_path = 0;
+                    continue;
+                }
+                LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, 0)
+            }
+            Longtail_Free(full_asset_path);
+            full_asset_path = 0;
+            remove_indexes[r] = 0xffffffff;
+            ++successful_remove_count;
+        }
     }
-
-    Longtail_Free(work_mem);
-    Longtail_Free(added_hashes);
-
+    Longtail_Free(remove_indexes);
     return err;
 }
 
-int Longtail_GetMissingChunks(
-    const struct Longtail_StoreIndex* store_index,
-    uint32_t chunk_count,
-    const TLongtail_Hash* chunk_hashes,
-    uint32_t* out_chunk_count,
-    TLongtail_Hash* out_missing_chunk_hashes)
+static int RetainPermissions(
+    struct Longtail_StorageAPI* version_storage_api,
+    struct Longtail_CancelAPI* optional_cancel_api,
+    Longtail_CancelAPI_HCancelToken optional_cancel_token,
+    const struct Longtail_VersionIndex* target_version,
+    const struct Longtail_VersionDiff* version_diff,
+    const char* version_path)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(store_index, "%p"),
-        LONGTAIL_LOGFIELD(chunk_count, "%u"),
-        LONGTAIL_LOGFIELD(chunk_hashes, "%p"),
-        LONGTAIL_LOGFIELD(out_chunk_count, "%p"),
-        LONGTAIL_LOGFIELD(out_missing_chunk_hashes, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
+        LONGTAIL_LOGFIELD(target_version, "%p"),
+        LONGTAIL_LOGFIELD(version_diff, "%p"),
+        LONGTAIL_LOGFIELD(version_path, "%s")
+        MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, (chunk_count == 0) || (chunk_hashes != 0), return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_chunk_count != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, (chunk_count == 0) || (out_missing_chunk_hashes != 0), return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, chunk_count <= 0xffffffffu, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, target_version != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_diff != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_path != 0, return EINVAL)
 
-    uint32_t reference_chunk_count = *store_index->m_ChunkCount;
-    void* chunk_to_reference_block_index_lookup_mem = Longtail_Alloc("GetMissingChunks", LongtailPrivate_LookupTable_GetSize(reference_chunk_count));
-    if (!chunk_to_reference_block_index_lookup_mem)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return ENOMEM;
-    }
-    struct Longtail_LookupTable* chunk_to_reference_block_index_lookup = LongtailPrivate_LookupTable_Create(chunk_to_reference_block_index_lookup_mem, reference_chunk_count, 0);
-    LONGTAIL_FATAL_ASSERT(ctx, chunk_to_reference_block_index_lookup != 0, return EINVAL )
+    char* full_path = 0;
 
-    uint32_t reference_block_count = *store_index->m_BlockCount;
-    for (uint32_t b = 0; b < reference_block_count; ++b)
-    {
-        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
-        uint32_t chunk_index_offset = store_index->m_BlockChunksOffsets[b];
-        for (uint32_t c = 0; c < block_chunk_count; ++c)
+    uint32_t version_diff_modified_permissions_count = *version_diff->m_ModifiedPermissionsCount;
+    for (uint32_t i = 0; i < version_diff_modified_permissions_count; ++i)
     {
-            uint32_t chunk_index = chunk_index_offset + c;
-            TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_index];
-            LongtailPrivate_LookupTable_PutUnique(chunk_to_reference_block_index_lookup, chunk_hash, b);
+        if ((i & 0x7f) == 0x7f)
+        {
+            if (optional_cancel_api && optional_cancel_token && optional_cancel_api->IsCancelled(optional_cancel_api, optional_cancel_token) == ECANCELED)
+            {
+                int err = ECANCELED;
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Operation cancelled, failed with %d", err)
+                return err;
+            }
+        }
+        uint32_t asset_index = version_diff->m_TargetPermissionsModifiedAssetIndexes[i];
+        const char* asset_path = &target_version->m_NameData[target_version->m_NameOffsets[asset_index]];
+        char* full_path = version_storage_api->ConcatPath(version_storage_api, version_path, asset_path);
+        uint16_t permissions = (uint16_t)target_version->m_Permissions[asset_index];
+        int err = version_storage_api->SetPermissions(version_storage_api, full_path, permissions);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->SetPermissions() failed for `%s` with %d", full_path, err)
+            Longtail_Free(full_path);
+            return err;
         }
+        Longtail_Free(full_path);
     }
 
-    uint32_t missing_chunk_count = 0;
-    for (uint32_t c = 0; c < (uint32_t)chunk_count; ++c)
+    uint32_t version_diff_added_permissions_count = *version_diff->m_TargetAddedCount;
+    for (uint32_t i = 0; i < version_diff_added_permissions_count; ++i)
     {
-        TLongtail_Hash chunk_hash = chunk_hashes[c];
-        if (LongtailPrivate_LookupTable_Get(chunk_to_reference_block_index_lookup, chunk_hash))
+        if ((i & 0x7f) == 0x7f)
         {
-            continue;
+            if (optional_cancel_api && optional_cancel_token && optional_cancel_api->IsCancelled(optional_cancel_api, optional_cancel_token) == ECANCELED)
+            {
+                int err = ECANCELED;
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Operation cancelled, failed with %d", err)
+                return err;
+            }
+        }
+        uint32_t asset_index = version_diff->m_TargetAddedAssetIndexes[i];
+        const char* asset_path = &target_version->m_NameData[target_version->m_NameOffsets[asset_index]];
+        if (!IsDirPath(asset_path))
+        {
+            char* full_path = version_storage_api->ConcatPath(version_storage_api, version_path, asset_path);
+            uint16_t permissions = (uint16_t)target_version->m_Permissions[asset_index];
+            int err = version_storage_api->SetPermissions(version_storage_api, full_path, permissions);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->SetPermissions() failed for `%s` with %d", full_path, err)
+                Longtail_Free(full_path);
+                return err;
+            }
+            Longtail_Free(full_path);
         }
-        out_missing_chunk_hashes[missing_chunk_count++] = chunk_hash;
     }
-    Longtail_Free(chunk_to_reference_block_index_lookup);
-    *out_chunk_count = missing_chunk_count;
-    return 0;
-}
-
-static SORTFUNC(SortBlockUsageHighToLow)
-{
-#if defined(LONGTAIL_ASSERTS)
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(context, "%p"),
-        LONGTAIL_LOGFIELD(a_ptr, "%p"),
-        LONGTAIL_LOGFIELD(b_ptr, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return 0)
-    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
-    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
+    uint32_t version_diff_moved_count = *version_diff->m_MovedCount;
+    for (uint32_t i = 0; i < version_diff_moved_count; ++i)
+    {
+        uint32_t asset_index = version_diff->m_TargetMovedAssetIndexes[i];
+        const char* asset_path = &target_version->m_NameData[target_version->m_NameOffsets[asset_index]];
+        char* full_path = version_storage_api->ConcatPath(version_storage_api, version_path, asset_path);
+        uint16_t permissions = (uint16_t)target_version->m_Permissions[asset_index];
+        int err = version_storage_api->SetPermissions(version_storage_api, full_path, permissions);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->SetPermissions() failed for `%s` with %d", full_path, err)
+            Longtail_Free(full_path);
+            return err;
+        }
+        Longtail_Free(full_path);
+    }
 
-    const uint32_t* block_usages = (const uint32_t*)context;
-    const uint32_t a_index = *(const uint32_t*)a_ptr;
-    const uint32_t b_index = *(const uint32_t*)b_ptr;
-    const uint32_t a_usage = block_usages[a_index];
-    const uint32_t b_usage = block_usages[b_index];
-    return (a_usage < b_usage) ?
-        1 : ((a_usage > b_usage) ?
-            -1 : ((a_index < b_index) ?
-                -1 : ((a_index == b_index) ?
-                    0 : 1)));
+    return 0;
 }
 
-int Longtail_GetExistingStoreIndex(
+int Longtail_ChangeVersion(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    struct Longtail_StorageAPI* version_storage_api,
+    struct Longtail_HashAPI* hash_api,
+    struct Longtail_JobAPI* job_api,
+    struct Longtail_ProgressAPI* progress_api,
+    struct Longtail_CancelAPI* optional_cancel_api,
+    Longtail_CancelAPI_HCancelToken optional_cancel_token,
     const struct Longtail_StoreIndex* store_index,
-    uint32_t chunk_count,
-    const TLongtail_Hash* chunks,
-    uint32_t min_block_usage_percent,
-    struct Longtail_StoreIndex** out_store_index)
+    const struct Longtail_VersionIndex* source_version,
+    const struct Longtail_VersionIndex* target_version,
+    const struct Longtail_VersionDiff* version_diff,
+    const char* version_path,
+    int retain_permissions)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_store_api, "%p"),
+        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(hash_api, "%p"),
+        LONGTAIL_LOGFIELD(job_api, "%p"),
+        LONGTAIL_LOGFIELD(progress_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
         LONGTAIL_LOGFIELD(store_index, "%p"),
-        LONGTAIL_LOGFIELD(chunk_count, "%u"),
-        LONGTAIL_LOGFIELD(chunks, "%p"),
-        LONGTAIL_LOGFIELD(min_block_usage_percent, "%u"),
-        LONGTAIL_LOGFIELD(out_store_index, "%p")
+        LONGTAIL_LOGFIELD(source_version, "%p"),
+        LONGTAIL_LOGFIELD(target_version, "%p"),
+        LONGTAIL_LOGFIELD(version_diff, "%p"),
+        LONGTAIL_LOGFIELD(version_path, "%s"),
+        LONGTAIL_LOGFIELD(retain_permissions, "%d")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
+    LONGTAIL_VALIDATE_INPUT(ctx, block_store_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, hash_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, job_api != 0, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, (chunk_count == 0) || (chunks != 0), return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
-
-    uint32_t hash_identifier = *store_index->m_HashIdentifier;
-    uint32_t store_block_count = *store_index->m_BlockCount;
-    uint32_t store_chunk_count = *store_index->m_ChunkCount;
-
-    size_t chunk_to_index_lookup_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
-    size_t block_to_index_lookup_size = LongtailPrivate_LookupTable_GetSize(store_block_count);
-    size_t chunk_to_store_index_lookup_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
-    size_t found_store_block_hashes_size = sizeof(TLongtail_Hash) * store_block_count;
-    size_t block_uses_percent_size = sizeof(uint32_t) * store_block_count;
-    size_t block_index_size = sizeof(uint32_t) * store_block_count;
-    size_t block_order_size = sizeof(uint32_t) * store_block_count;
-
-    size_t tmp_mem_size = chunk_to_index_lookup_size +
-        block_to_index_lookup_size +
-        chunk_to_store_index_lookup_size +
-        found_store_block_hashes_size +
-        block_uses_percent_size +
-        block_index_size +
-        block_order_size;
+    LONGTAIL_VALIDATE_INPUT(ctx, source_version != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, target_version != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_diff != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_path != 0, return EINVAL)
 
-    void* tmp_mem = Longtail_Alloc("Longtail_GetExistingStoreIndex", tmp_mem_size);
-    if (!tmp_mem)
+    int err = EnsureParentPathExists(version_storage_api, version_path);
+    if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return ENOMEM;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed with %d", err)
+        return err;
+    }
+    err = version_storage_api->CreateDir(version_storage_api, version_path);
+    if (err == EEXIST)
+    {
+        err = 0;
+    }
+    if (err != 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->CreateDir() failed with %d", err)
+        return err;
     }
-    char* p = (char*)tmp_mem;
-
-    struct Longtail_LookupTable* chunk_to_index_lookup = LongtailPrivate_LookupTable_Create(p, chunk_count, 0);
-    p += chunk_to_index_lookup_size;
-
-    struct Longtail_LookupTable* block_to_index_lookup = LongtailPrivate_LookupTable_Create(p, store_block_count, 0);
-    p += block_to_index_lookup_size;
-
-    struct Longtail_LookupTable* chunk_to_store_index_lookup = LongtailPrivate_LookupTable_Create(p, chunk_count, 0);
-    p += chunk_to_store_index_lookup_size;
-
-    TLongtail_Hash* found_store_block_hashes = (TLongtail_Hash*)p;
-    p += found_store_block_hashes_size;
-
-    uint32_t* block_uses_percent = (uint32_t*)p;
-    p += block_uses_percent_size;
-
-    uint32_t* block_index = (uint32_t*)p;
-    p += block_index_size;
-
-    uint32_t* block_order = (uint32_t*)p;
-    p += block_order_size;
 
-    uint32_t unique_chunk_count = 0;
-    for (uint32_t i = 0; i < chunk_count; ++i)
+    uint8_t* source_asset_is_staged = 0;
+    char* staging_path = 0;
+    if (*version_diff->m_MovedCount > 0)
     {
-        TLongtail_Hash chunk_hash = chunks[i];
-        uint32_t* c_ptr = LongtailPrivate_LookupTable_PutUnique(chunk_to_index_lookup, chunk_hash, i);
-        if (c_ptr)
+        source_asset_is_staged = (uint8_t*)Longtail_Alloc("ChangeVersion", sizeof(uint8_t) * *source_version->m_AssetCount);
+        if (!source_asset_is_staged)
         {
-            continue;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+            return ENOMEM;
+        }
+        memset(source_asset_is_staged, 0, sizeof(uint8_t) * *source_version->m_AssetCount);
+        err = StageMovedAssets(version_storage_api, source_version, version_diff, version_path, source_asset_is_staged, &staging_path);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "StageMovedAssets() failed with %d", err)
         }
-        ++unique_chunk_count;
     }
 
-    uint32_t found_block_count = 0;
-    uint32_t found_chunk_count = 0;
-    if (min_block_usage_percent <= 100)
+    if (err == 0)
     {
-        uint32_t potential_block_count = 0;
-        for (uint32_t b = 0; b < store_block_count; ++b)
+        err = CleanUpRemoveAssets(version_storage_api, optional_cancel_api, optional_cancel_token, source_version, version_diff, version_path);
+        if (err != 0)
         {
-            uint32_t block_use = 0;
-            uint32_t block_size = 0;
-            TLongtail_Hash block_hash = store_index->m_BlockHashes[b];
-            uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
-            uint32_t chunk_offset = store_index->m_BlockChunksOffsets[b];
-            for (uint32_t c = 0; c < block_chunk_count; ++c)
-            {
-                uint32_t chunk_size = store_index->m_ChunkSizes[chunk_offset];
-                TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_offset];
-                ++chunk_offset;
-                block_size += chunk_size;
-                if (LongtailPrivate_LookupTable_Get(chunk_to_index_lookup, chunk_hash))
-                {
-                    block_use += chunk_size;
-                }
-            }
-            if (block_use > 0)
-            {
-                uint32_t block_usage_percent = (uint32_t)(((uint64_t)block_use * 100) / block_size);
-                if (min_block_usage_percent > 0 &&
-                    block_usage_percent < min_block_usage_percent) {
-                    continue;
-                }
-
-                block_order[potential_block_count] = potential_block_count;
-                block_index[potential_block_count] = b;
-                block_uses_percent[potential_block_count] = block_usage_percent;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CleanUpRemoveAssets() failed with %d", err)
+        }
+    }
 
-                ++potential_block_count;
-            }
+    if (err == 0 && staging_path)
+    {
+        err = ApplyMovedAssets(version_storage_api, source_version, target_version, version_diff, version_path, source_asset_is_staged, staging_path);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ApplyMovedAssets() failed with %d", err)
         }
+    }
 
-        if (potential_block_count == 0)
+    if (staging_path)
+    {
+        if (err)
         {
-            Longtail_Free(tmp_mem);
-            return Longtail_CreateStoreIndexFromBlocks(
-                0,
-                0,
-                out_store_index);
+            RestoreStagedAssets(version_storage_api, source_version, source_asset_is_staged, version_path, staging_path);
         }
+        else
+        {
+            RemoveStagedAssets(version_storage_api, source_version, source_asset_is_staged, staging_path);
+        }
+        Longtail_Free(staging_path);
+        staging_path = 0;
+    }
+    Longtail_Free(source_asset_is_staged);
+    source_asset_is_staged = 0;
 
-        // Favour blocks we use more data out of - if a chunk is in multiple blocks we want to pick
-        // the blocks that has highest ratio of use inside the block.
-        // This does not guarantee a perfect block match as one block can be a 100% match which
-        // could lead to skipping part or whole of another 100% match block resulting in us
-        // picking a block that we will not use 100% of
-        QSORT(block_order, potential_block_count, sizeof(uint32_t), SortBlockUsageHighToLow, (void*)block_uses_percent);
+    if (err)
+    {
+        return err;
+    }
 
-        for (uint32_t bo = 0; (bo < potential_block_count) && (found_chunk_count < unique_chunk_count); ++bo)
+    uint32_t added_count = *version_diff->m_TargetAddedCount;
+    uint32_t modified_content_count = *version_diff->m_ModifiedContentCount;
+    uint32_t write_asset_count = added_count + modified_content_count;
+
+    LONGTAIL_FATAL_ASSERT(ctx, write_asset_count <= *target_version->m_AssetCount, return EINVAL);
+    if (write_asset_count > 0)
+    {
+        uint32_t chunk_count = (uint32_t)*store_index->m_ChunkCount;
+        size_t chunk_hash_to_block_index_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
+        size_t asset_indexes_size = sizeof(uint32_t) * write_asset_count;
+        size_t work_mem_size = chunk_hash_to_block_index_size + asset_indexes_size;
+
+        void* work_mem = Longtail_Alloc("ChangeVersion", work_mem_size);
+        if (!work_mem)
         {
-            uint32_t pb = block_order[bo];
-            uint32_t b = block_index[pb];
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+            return ENOMEM;
+        }
 
-            TLongtail_Hash block_hash = store_index->m_BlockHashes[b];
+        char* p = (char*)work_mem;
+        struct Longtail_LookupTable* chunk_hash_to_block_index = LongtailPrivate_LookupTable_Create(p, chunk_count, 0);
+        p += chunk_hash_to_block_index_size;
+        uint32_t* asset_indexes = (uint32_t*)p;
+
+        uint32_t block_count = *store_index->m_BlockCount;
+        for (uint32_t b = 0; b < block_count; ++b)
+        {
             uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
-            uint32_t store_chunk_index_offset = store_index->m_BlockChunksOffsets[b];
-            uint32_t current_found_block_index = found_block_count;
+            uint32_t chunk_index_offset = store_index->m_BlockChunksOffsets[b];
             for (uint32_t c = 0; c < block_chunk_count; ++c)
-            {
-                TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[store_chunk_index_offset];
-                if (!LongtailPrivate_LookupTable_Get(chunk_to_index_lookup, chunk_hash))
-                {
-                    ++store_chunk_index_offset;
-                    continue;
-                }
-                if (LongtailPrivate_LookupTable_PutUnique(chunk_to_store_index_lookup, chunk_hash, store_chunk_index_offset))
-                {
-                    ++store_chunk_index_offset;
-                    continue;
-                }
-                found_chunk_count++;
-                if (current_found_block_index == found_block_count)
-                {
-                    uint32_t* block_index_ptr = LongtailPrivate_LookupTable_PutUnique(block_to_index_lookup, block_hash, current_found_block_index);
-                    if (block_index_ptr == 0)
-                    {
-                        found_store_block_hashes[found_block_count++] = block_hash;
-                    }
-                    ++store_chunk_index_offset;
-                    continue;
-                }
-                ++store_chunk_index_offset;
+        {
+                uint32_t chunk_index = chunk_index_offset + c;
+                TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_index];
+                LongtailPrivate_LookupTable_PutUnique(chunk_hash_to_block_index, chunk_hash, b);
             }
         }
-    }
 
-    if (found_block_count == 0)
-    {
-        Longtail_Free(tmp_mem);
-        return Longtail_CreateStoreIndexFromBlocks(
-            0,
-            0,
-            out_store_index);
-    }
+        for (uint32_t i = 0; i < added_count; ++i)
+        {
+            asset_indexes[i] = version_diff->m_TargetAddedAssetIndexes[i];
+        }
+        for (uint32_t i = 0; i < modified_content_count; ++i)
+        {
+            asset_indexes[added_count + i] = version_diff->m_TargetContentModifiedAssetIndexes[i];
+        }
 
-    // We have a list of block hashes we want to keep in found_store_block_hashes
-    // We have a lookup from block hash to block index in store index in block_to_index_lookup
+        struct AssetWriteList* awl;
+        err = BuildAssetWriteList(
+            write_asset_count,
+            asset_indexes,
+            target_version->m_NameOffsets,
+            target_version->m_NameData,
+            target_version->m_ChunkHashes,
+            target_version->m_AssetChunkCounts,
+            target_version->m_AssetChunkIndexStarts,
+            target_version->m_AssetChunkIndexes,
+            chunk_hash_to_block_index,
+            &awl);
 
-    size_t block_hash_lookup_size = LongtailPrivate_LookupTable_GetSize(found_block_count);
-    size_t block_index_header_ptrs_size = sizeof(struct LongtailBlockIndex*) * found_block_count;
-    size_t block_index_headers_size = sizeof(struct Longtail_BlockIndex) * found_block_count;
-    size_t tmp_mem_2_size = block_index_header_ptrs_size +
-        block_index_headers_size +
-        block_hash_lookup_size;
-    void* tmp_mem_2 = Longtail_Alloc("Longtail_GetExistingStoreIndex", tmp_mem_2_size);
-    if (!tmp_mem_2){
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        Longtail_Free(tmp_mem);
-        return ENOMEM;
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BuildAssetWriteList() failed with %d", err)
+            Longtail_Free(work_mem);
+            return err;
+        }
 
-    }
-    struct Longtail_BlockIndex** block_index_header_ptrs = (struct Longtail_BlockIndex**)tmp_mem_2;
-    struct Longtail_BlockIndex* block_index_headers = (struct Longtail_BlockIndex*)&block_index_header_ptrs[found_block_count];
-    struct Longtail_LookupTable* block_hash_lookup = LongtailPrivate_LookupTable_Create(&((char*)block_index_headers)[block_index_headers_size], found_block_count, 0);
-    for (uint32_t b = 0; b < store_block_count; ++b)
-    {
-        TLongtail_Hash block_hash = store_index->m_BlockHashes[b];
-        if (0 == LongtailPrivate_LookupTable_Get(block_to_index_lookup, block_hash))
+        err = WriteAssets(
+            block_store_api,
+            version_storage_api,
+            job_api,
+            progress_api,
+            optional_cancel_api,
+            optional_cancel_token,
+            store_index,
+            target_version,
+            version_path,
+            chunk_hash_to_block_index,
+            awl,
+            retain_permissions);
+
+        Longtail_Free(awl);
+        awl = 0;
+
+        if (err)
         {
-            continue;
+            LONGTAIL_LOG(ctx, err == ECANCELED ?  LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "WriteAssets() failed with %d", err)
+            Longtail_Free(work_mem);
+            return err;
         }
-        LongtailPrivate_LookupTable_Put(block_hash_lookup, block_hash, b);
-    }
 
-    for (uint32_t b = 0; b < found_block_count; ++b)
-    {
-        TLongtail_Hash block_hash = found_store_block_hashes[b];
-        uint32_t store_block_index = *LongtailPrivate_LookupTable_Get(block_hash_lookup, block_hash);
-        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[store_block_index];
-        uint32_t block_chunk_index_offset = store_index->m_BlockChunksOffsets[store_block_index];
-        block_index_headers[b].m_BlockHash = &store_index->m_BlockHashes[store_block_index];
-        block_index_headers[b].m_HashIdentifier = store_index->m_HashIdentifier;
-        block_index_headers[b].m_ChunkCount = &store_index->m_BlockChunkCounts[store_block_index];
-        block_index_headers[b].m_Tag = &store_index->m_BlockTags[block_chunk_index_offset];
-        block_index_headers[b].m_ChunkHashes = &store_index->m_ChunkHashes[block_chunk_index_offset];
-        block_index_headers[b].m_ChunkSizes = &store_index->m_ChunkSizes[block_chunk_index_offset];
-        block_index_header_ptrs[b] = &block_index_headers[b];
+        Longtail_Free(work_mem);
+        work_mem = 0;
     }
-    Longtail_Free(tmp_mem);
 
-    int err = Longtail_CreateStoreIndexFromBlocks(
-        found_block_count,
-        (const struct Longtail_BlockIndex**)block_index_header_ptrs,
-        out_store_index);
-    Longtail_Free(tmp_mem_2);
-    if (err)
+    if (err == 0 && retain_permissions)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
-        return err;
+        err = RetainPermissions(version_storage_api, optional_cancel_api, optional_cancel_token, target_version, version_diff, version_path);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "RetainPermissions() failed with %d", err)
+        }
     }
-    return 0;
+
+    return err;
 }
 
-static int CompareHashes(const void* a_ptr, const void* b_ptr)
+
+struct Longtail_BlockChunkWriteInfo
 {
-#if defined(LONGTAIL_ASSERTS)
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(a_ptr, "%p"),
-        LONGTAIL_LOGFIELD(b_ptr, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
+    uint32_t ChunkIndex;
+    uint32_t AssetIndex;
+    uint64_t Offset;
+};
 
-    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
-    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
+typedef struct Longtail_BlockChunkWriteInfo* TBlockChunkWriteArray;
 
-    TLongtail_Hash a = *(const TLongtail_Hash*)a_ptr;
-    TLongtail_Hash b = *(const TLongtail_Hash*)b_ptr;
-    return (a > b) ? 1 : (a < b) ? -1 : 0;
-}
+struct Longtail_LocalChunkWriteInfo
+{
+    uint32_t ChunkIndex;
+    uint32_t AssetIndex;
+    uint64_t Offset;
+    uint64_t SourceOffset;
+};
+
+typedef struct Longtail_LocalChunkWriteInfo* TLocalChunkWriteArray;
+
+struct Longtail_BlockWriteInfos
+{
+    TBlockChunkWriteArray* m_BlockWritesArrays;
+    uint32_t m_BlockCount;
+    TBlockChunkWriteArray m_ZeroSizeWriteInfoArray;
+    // Chunks copied from the files of the source version, indexed by source asset index
+    TLocalChunkWriteArray* m_LocalWritesArrays;
+    uint32_t m_LocalAssetCount;
+};
+
+struct ContentBlock2JobContext
+{
+    const struct Longtail_StoreIndex* m_StoreIndex;
+    const struct Longtail_VersionIndex* m_VersionIndex;
+    const struct Longtail_BlockWriteInfos* m_BlockWriteInfos;
+    struct Longtail_BlockStoreAPI* m_BlockStoreAPI;
+    struct Longtail_ConcurrentChunkWriteAPI* m_ConcurrentChunkWriteApi;
+    struct Longtail_JobAPI* m_JobAPI;
+    const char* m_VersionPath;
+    struct Longtail_StorageAPI* m_VersionStorageAPI;
+    const struct Longtail_VersionIndex* m_SourceVersionIndex;
+    const uint8_t* m_SourceAssetIsStaged;
+    const char* m_StagingPath;
+    struct Longtail_HashAPI* m_HashAPI;
+};
+
+struct LocalChunkWriteJob
+{
+    const struct ContentBlock2JobContext* m_Context;
+    uint32_t m_SourceAssetIndex;
+    // Chunks that did not match their hash on disk, written from the block store afterwards
+    TBlockChunkWriteArray m_FallbackWrites;
+};
+
+struct ContentBlock2Job
+{
+    struct Longtail_AsyncGetStoredBlockAPI m_AsyncCompleteAPI;
+    const struct ContentBlock2JobContext* m_Context;
+    uint32_t m_BlockIndex;
+    struct Longtail_StoredBlock* m_StoredBlock;
+    int m_GetStoredBlockErr;
+    uint32_t m_JobID;
+};
 
-static SORTFUNC(SortPathShortToLong)
+static SORTFUNC(SortBlockChunkWriteInfo)
 {
 #if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
@@ -7355,664 +11897,1154 @@ static SORTFUNC(SortPathShortToLong)
     struct Longtail_LogContextFmt_Private* ctx = 0;
 #endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, context == 0, return 0)
     LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
     LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
 
-        const uint32_t* asset_path_lengths = (const uint32_t*)context;
-    uint32_t a = *(const uint32_t*)a_ptr;
-    uint32_t b = *(const uint32_t*)b_ptr;
-    uint32_t a_len = asset_path_lengths[a];
-    uint32_t b_len = asset_path_lengths[b];
-    if (a_len < b_len)
+    const struct Longtail_BlockChunkWriteInfo* a = (const struct Longtail_BlockChunkWriteInfo*)a_ptr;
+    const struct Longtail_BlockChunkWriteInfo* b = (const struct Longtail_BlockChunkWriteInfo*)b_ptr;
+    if (a->AssetIndex < b->AssetIndex)
     {
         return -1;
     }
-    if (a_len > b_len)
+    if (a->AssetIndex > b->AssetIndex)
     {
         return 1;
     }
-    if (a < b)
+    if (a->Offset < b->Offset)
     {
         return -1;
     }
-    if (a > b)
+    if (a->Offset > b->Offset)
+    {
+        return 1;
+    }
+    if (a->ChunkIndex < b->ChunkIndex)
+    {
+        return -1;
+    }
+    if (a->ChunkIndex > b->ChunkIndex)
     {
         return 1;
     }
     return 0;
 }
 
-static SORTFUNC(SortPathLongToShort)
+static void WriteContentBlock2GetStoredBlockComplete(struct Longtail_AsyncGetStoredBlockAPI* async_complete_api, struct Longtail_StoredBlock* stored_block, int err)
 {
 #if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(context, "%p"),
-        LONGTAIL_LOGFIELD(a_ptr, "%p"),
-        LONGTAIL_LOGFIELD(b_ptr, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(err, "%d")
+        MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 #else
     struct Longtail_LogContextFmt_Private* ctx = 0;
 #endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return 0)
-    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
-    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
-    const uint32_t* asset_path_lengths = (const uint32_t*)context;
-    uint32_t a = *(const uint32_t*)a_ptr;
-    uint32_t b = *(const uint32_t*)b_ptr;
-    uint32_t a_len = asset_path_lengths[a];
-    uint32_t b_len = asset_path_lengths[b];
-    if (a_len < b_len)
-    {
-        return 1;
-    }
-    if (a_len > b_len)
-    {
-        return -1;
-    }
-    if (a < b)
-    {
-        return 1;
-    }
-    if (a > b)
+    if (err)
     {
-        return -1;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "WriteContentBlock2GetStoredBlockComplete() failed with %d", err)
     }
-    return 0;
+    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api != 0, return)
+    struct ContentBlock2Job* job = (struct ContentBlock2Job*)async_complete_api;
+    LONGTAIL_FATAL_ASSERT(ctx, job->m_AsyncCompleteAPI.OnComplete != 0, return);
+    LONGTAIL_MONTITOR_BLOCK_LOADED(job->m_Context->m_StoreIndex, job->m_BlockIndex, err);
+    job->m_GetStoredBlockErr = err;
+    job->m_StoredBlock = stored_block;
+    job->m_Context->m_JobAPI->ResumeJob(job->m_Context->m_JobAPI, job->m_JobID);
 }
 
-static size_t GetVersionDiffDataSize(uint32_t removed_count, uint32_t added_count, uint32_t modified_content_count, uint32_t modified_permission_count)
-{
-    return
-        sizeof(uint32_t) +                              // m_SourceRemovedCount
-        sizeof(uint32_t) +                              // m_TargetAddedCount
-        sizeof(uint32_t) +                              // m_ModifiedContentCount
-        sizeof(uint32_t) +                              // m_ModifiedPermissionsCount
-        sizeof(uint32_t) * removed_count +              // m_SourceRemovedAssetIndexes
-        sizeof(uint32_t) * added_count +                // m_TargetAddedAssetIndexes
-        sizeof(uint32_t) * modified_content_count +     // m_SourceContentModifiedAssetIndexes
-        sizeof(uint32_t) * modified_content_count +     // m_TargetContentModifiedAssetIndexes
-        sizeof(uint32_t) * modified_permission_count +  // m_SourcePermissionsModifiedAssetIndexes
-        sizeof(uint32_t) * modified_permission_count;   // m_TargetPermissionsModifiedAssetIndexes
-}
+#define CREATE_DIRECTORIES_JOB_DIR_COUNT  64u
 
-static size_t GetVersionDiffSize(uint32_t removed_count, uint32_t added_count, uint32_t modified_content_count, uint32_t modified_permission_count)
+struct CreateDirectoriesJob
 {
-    return sizeof(struct Longtail_VersionDiff) +
-        GetVersionDiffDataSize(removed_count, added_count, modified_content_count, modified_permission_count);
-}
+    struct Longtail_ConcurrentChunkWriteAPI* m_ConcurrentChunkWriteApi;
+    const struct Longtail_VersionIndex* m_VersionIndex;
+    const uint32_t* m_AssetIndexes;
+    uint32_t m_AssetIndexCount;
+};
 
-static void InitVersionDiff(struct Longtail_VersionDiff* version_diff)
+static int CreateDirectoriesJob(void* context, uint32_t job_id, int detected_error)
 {
+#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(version_diff, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(job_id, "%u"),
+        LONGTAIL_LOGFIELD(detected_error, "%d")
+        MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_FATAL_ASSERT(ctx, version_diff != 0, return)
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return EINVAL)
 
-    char* p = (char*)version_diff;
-    p += sizeof(struct Longtail_VersionDiff);
+    struct CreateDirectoriesJob* job = (struct CreateDirectoriesJob*)context;
 
-    version_diff->m_SourceRemovedCount = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
+    if (detected_error)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "CreateDirectoriesJob aborted due to previous error %d", detected_error)
+        return 0;
+    }
 
-    version_diff->m_TargetAddedCount = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
+    for (uint32_t i = 0; i < job->m_AssetIndexCount; ++i)
+    {
+        uint32_t asset_index = job->m_AssetIndexes[i];
+        int err = job->m_ConcurrentChunkWriteApi->CreateDir(job->m_ConcurrentChunkWriteApi, asset_index);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_ConcurrentChunkWriteApi->CreateDir() failed with %d", err)
+            LONGTAIL_MONTITOR_ASSET_OPEN(job->m_VersionIndex, asset_index, err);
+            return err;
+        }
+        LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_VersionIndex, asset_index);
+    }
+    return 0;
+}
 
-    version_diff->m_ModifiedContentCount = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
+// Creates all directories of the target version up front, in parallel, so the
+// file writes that follow find their parent folders in the write api directory cache
+static int CreateTargetDirectories(
+    struct Longtail_JobAPI* job_api,
+    struct Longtail_CancelAPI* optional_cancel_api,
+    Longtail_CancelAPI_HCancelToken optional_cancel_token,
+    struct Longtail_ConcurrentChunkWriteAPI* concurrent_chunk_write_api,
+    const struct Longtail_VersionIndex* target_version,
+    const struct Longtail_BlockWriteInfos* block_write_infos)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(job_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
+        LONGTAIL_LOGFIELD(concurrent_chunk_write_api, "%p"),
+        LONGTAIL_LOGFIELD(target_version, "%p"),
+        LONGTAIL_LOGFIELD(block_write_infos, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 
-    version_diff->m_ModifiedPermissionsCount = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
+    uint32_t* dir_asset_indexes = 0;
+    ptrdiff_t zero_size_count = arrlen(block_write_infos->m_ZeroSizeWriteInfoArray);
+    for (ptrdiff_t i = 0; i < zero_size_count; ++i)
+    {
+        uint32_t asset_index = block_write_infos->m_ZeroSizeWriteInfoArray[i].AssetIndex;
+        const char* asset_path = &target_version->m_NameData[target_version->m_NameOffsets[asset_index]];
+        if (IsDirPath(asset_path))
+        {
+            arrput(dir_asset_indexes, asset_index);
+        }
+    }
+    uint32_t dir_count = (uint32_t)arrlen(dir_asset_indexes);
+    if (dir_count == 0)
+    {
+        return 0;
+    }
 
-    uint32_t removed_count = *version_diff->m_SourceRemovedCount;
-    uint32_t added_count = *version_diff->m_TargetAddedCount;
-    uint32_t modified_content_count = *version_diff->m_ModifiedContentCount;
-    uint32_t modified_permissions_count = *version_diff->m_ModifiedPermissionsCount;
+    uint32_t job_count = (dir_count + CREATE_DIRECTORIES_JOB_DIR_COUNT - 1) / CREATE_DIRECTORIES_JOB_DIR_COUNT;
+    size_t job_mem_size =
+        sizeof(struct CreateDirectoriesJob) * job_count +
+        sizeof(Longtail_JobAPI_JobFunc) * job_count +
+        sizeof(void*) * job_count;
+    void* job_mem = Longtail_Alloc("CreateTargetDirectories", job_mem_size);
+    if (job_mem == 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        arrfree(dir_asset_indexes);
+        return ENOMEM;
+    }
+    struct CreateDirectoriesJob* jobs = (struct CreateDirectoriesJob*)job_mem;
+    Longtail_JobAPI_JobFunc* job_funcs = (Longtail_JobAPI_JobFunc*)&jobs[job_count];
+    void** job_ctxs = (void**)&job_funcs[job_count];
+    for (uint32_t j = 0; j < job_count; ++j)
+    {
+        uint32_t start = j * CREATE_DIRECTORIES_JOB_DIR_COUNT;
+        uint32_t count = (dir_count - start) < CREATE_DIRECTORIES_JOB_DIR_COUNT ? (dir_count - start) : CREATE_DIRECTORIES_JOB_DIR_COUNT;
+        jobs[j].m_ConcurrentChunkWriteApi = concurrent_chunk_write_api;
+        jobs[j].m_VersionIndex = target_version;
+        jobs[j].m_AssetIndexes = &dir_asset_indexes[start];
+        jobs[j].m_AssetIndexCount = count;
+        job_funcs[j] = CreateDirectoriesJob;
+        job_ctxs[j] = &jobs[j];
+    }
 
-    version_diff->m_SourceRemovedAssetIndexes = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * removed_count;
+    uint32_t jobs_submitted = 0;
+    int err = Longtail_RunJobsBatched(
+        job_api,
+        0,
+        optional_cancel_api,
+        optional_cancel_token,
+        job_count,
+        job_funcs,
+        job_ctxs,
+        &jobs_submitted);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "Longtail_RunJobsBatched() failed with %d", err)
+    }
+    Longtail_Free(job_mem);
+    arrfree(dir_asset_indexes);
+    return err;
+}
 
-    version_diff->m_TargetAddedAssetIndexes = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * added_count;
+static int WriteNonBlockAssetsJob(void* context, uint32_t job_id, int detected_error)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(job_id, "%u"),
+        LONGTAIL_LOGFIELD(detected_error, "%d")
+        MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-    version_diff->m_SourceContentModifiedAssetIndexes = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * modified_content_count;
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return EINVAL)
 
-    version_diff->m_TargetContentModifiedAssetIndexes = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * modified_content_count;
+    struct ContentBlock2JobContext* job = (struct ContentBlock2JobContext*)context;
 
-    version_diff->m_SourcePermissionsModifiedAssetIndexes = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * modified_permissions_count;
+    if (detected_error)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "WriteNonBlockAssetsJob aborted due to previous error %d", detected_error)
+        return 0;
+    }
 
-    version_diff->m_TargetPermissionsModifiedAssetIndexes = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * modified_permissions_count;
+    TBlockChunkWriteArray block_write_infos = job->m_BlockWriteInfos->m_ZeroSizeWriteInfoArray;
+    ptrdiff_t block_write_chunk_info_count = arrlen(block_write_infos);
+    for (ptrdiff_t block_write_chunk_info_index = 0; block_write_chunk_info_index < block_write_chunk_info_count; ++block_write_chunk_info_index)
+    {
+        const TBlockChunkWriteArray block_chunk_write_info = &block_write_infos[block_write_chunk_info_index];
+        const uint32_t asset_index = block_chunk_write_info->AssetIndex;
+        const char* asset_path = &job->m_VersionIndex->m_NameData[job->m_VersionIndex->m_NameOffsets[asset_index]];
+        if (IsDirPath(asset_path))
+        {
+            // Created by CreateTargetDirectories
+            continue;
+        }
+        int err = job->m_ConcurrentChunkWriteApi->Open(job->m_ConcurrentChunkWriteApi, asset_index);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "m_ConcurrentChunkWriteApi->Open() failed with %d", err)
+            return err;
+        }
+        LONGTAIL_MONTITOR_ASSET_OPEN(job->m_VersionIndex, asset_index, err);
+        job->m_ConcurrentChunkWriteApi->Close(job->m_ConcurrentChunkWriteApi, asset_index);
+        LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_VersionIndex, asset_index);
+    }
+    return 0;
 }
 
-int Longtail_CreateVersionDiff(
-    struct Longtail_HashAPI* hash_api,
-    const struct Longtail_VersionIndex* source_version,
-    const struct Longtail_VersionIndex* target_version,
-    struct Longtail_VersionDiff** out_version_diff)
+static int WriteContentBlock2Job(void* context, uint32_t job_id, int detected_error)
 {
+#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(hash_api, "%p"),
-        LONGTAIL_LOGFIELD(source_version, "%p"),
-        LONGTAIL_LOGFIELD(target_version, "%p"),
-        LONGTAIL_LOGFIELD(out_version_diff, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(job_id, "%u"),
+        LONGTAIL_LOGFIELD(detected_error, "%d")
+        MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return EINVAL)
+
+    struct ContentBlock2Job* job = (struct ContentBlock2Job*)context;
+
+    if (detected_error)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "WriteContentBlock2Job aborted due to previous error %d", detected_error)
+        SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+        return 0;
+    }
+
+    uint32_t block_index = job->m_BlockIndex;
+    TLongtail_Hash block_hash = job->m_Context->m_StoreIndex->m_BlockHashes[block_index];
+
+    if (job->m_AsyncCompleteAPI.OnComplete == 0)
+    {
+        LONGTAIL_FATAL_ASSERT(ctx, job->m_StoredBlock == 0, return EINVAL)
+        job->m_JobID = job_id;
+        job->m_AsyncCompleteAPI.OnComplete = WriteContentBlock2GetStoredBlockComplete;
 
-    LONGTAIL_VALIDATE_INPUT(ctx, source_version != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, target_version != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_version_diff != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, hash_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, hash_api->GetIdentifier(hash_api) == *source_version->m_HashIdentifier, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, hash_api->GetIdentifier(hash_api) == *target_version->m_HashIdentifier, return EINVAL)
+        LONGTAIL_MONTITOR_BLOCK_LOAD(job->m_Context->m_StoreIndex, block_index);
+        int err = job->m_Context->m_BlockStoreAPI->GetStoredBlock(job->m_Context->m_BlockStoreAPI, block_hash, &job->m_AsyncCompleteAPI);
+        if (err == 0)
+        {
+            return EBUSY;
+        }
+        else
+        {
+            LONGTAIL_MONTITOR_BLOCK_LOADED(job->m_Context->m_StoreIndex, block_index, err);
+            return err;
+        }
+    }
 
-    uint32_t source_asset_count = *source_version->m_AssetCount;
-    uint32_t target_asset_count = *target_version->m_AssetCount;
+    if (job->m_GetStoredBlockErr != 0)
+    {
+        return job->m_GetStoredBlockErr;
+    }
 
-    size_t source_asset_lookup_table_size = LongtailPrivate_LookupTable_GetSize(source_asset_count);
-    size_t target_asset_lookup_table_size = LongtailPrivate_LookupTable_GetSize(target_asset_count);
+    LONGTAIL_FATAL_ASSERT(ctx, job->m_StoredBlock != 0, return EINVAL)
+    struct Longtail_StoredBlock* stored_block = job->m_StoredBlock;
 
-    size_t work_mem_size =
-        source_asset_lookup_table_size +
-        target_asset_lookup_table_size +
-        sizeof(TLongtail_Hash) * source_asset_count +
-        sizeof(TLongtail_Hash) * target_asset_count +
-        sizeof(uint32_t) * source_asset_count +
-        sizeof(uint32_t) * target_asset_count +
-        sizeof(uint32_t) * source_asset_count +
-        sizeof(uint32_t) * target_asset_count +
-        sizeof(uint32_t) * source_asset_count +
-        sizeof(uint32_t) * target_asset_count +
-        sizeof(uint32_t) * source_asset_count +
-        sizeof(uint32_t) * target_asset_count;
-    void* work_mem = Longtail_Alloc("CreateVersionDiff", work_mem_size);
-    uint8_t* p = (uint8_t*)work_mem;
+    uint32_t chunk_count = *stored_block->m_BlockIndex->m_ChunkCount;
+    size_t chunk_hash_to_chunk_index_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
+    size_t chunk_offsets_size = sizeof(uint32_t) * chunk_count;
 
-    struct Longtail_LookupTable* source_path_hash_to_index = LongtailPrivate_LookupTable_Create(p, source_asset_count ,0);
-    p += source_asset_lookup_table_size;
-    struct Longtail_LookupTable* target_path_hash_to_index = LongtailPrivate_LookupTable_Create(p, target_asset_count ,0);
-    p += target_asset_lookup_table_size;
+    size_t work_mem_size = chunk_hash_to_chunk_index_size + chunk_offsets_size;
+    void* work_mem = Longtail_Alloc("WriteContentBlock2Job", work_mem_size);
+    if (!work_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+        LONGTAIL_MONTITOR_BLOCK_COMPLETE(job->m_Context->m_StoreIndex, block_index, ENOMEM);
+        return ENOMEM;
+    }
+    uint8_t* data_ptr = (uint8_t*)work_mem;
 
-    TLongtail_Hash* source_path_hashes = (TLongtail_Hash*)p;
-    TLongtail_Hash* target_path_hashes = &source_path_hashes[source_asset_count];
+    struct Longtail_LookupTable* chunk_hash_to_chunk_index = LongtailPrivate_LookupTable_Create(data_ptr, chunk_count, 0);
+    data_ptr += chunk_hash_to_chunk_index_size;
+    uint32_t* chunk_offsets_in_block = (uint32_t*)data_ptr;
 
-    uint32_t* removed_source_asset_indexes = (uint32_t*)&target_path_hashes[target_asset_count];
-    uint32_t* added_target_asset_indexes = &removed_source_asset_indexes[source_asset_count];
+    uint32_t chunk_offset = 0;
+    for (uint32_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
+    {
+        uint32_t* existing_ptr = LongtailPrivate_LookupTable_PutUnique(chunk_hash_to_chunk_index, stored_block->m_BlockIndex->m_ChunkHashes[chunk_index], chunk_index);
+        LONGTAIL_FATAL_ASSERT(ctx, !existing_ptr, return EINVAL)
+        chunk_offsets_in_block[chunk_index] = chunk_offset;
+        chunk_offset += stored_block->m_BlockIndex->m_ChunkSizes[chunk_index];
+    }
 
-    uint32_t* modified_source_content_indexes = &added_target_asset_indexes[target_asset_count];
-    uint32_t* modified_target_content_indexes = &modified_source_content_indexes[source_asset_count];
+    const uint8_t* block_data = (const uint8_t*)stored_block->m_BlockData;
 
-    uint32_t* modified_source_permissions_indexes = &modified_target_content_indexes[target_asset_count];
-    uint32_t* modified_target_permissions_indexes = &modified_source_permissions_indexes[source_asset_count];
+    int asset_is_open = 0;
+    uint32_t last_asset_index = 0;
 
-    uint32_t* source_assets_path_lengths = &modified_target_permissions_indexes[target_asset_count];
-    uint32_t* target_assets_path_lengths = &source_assets_path_lengths[source_asset_count];
+    TBlockChunkWriteArray write_infos = job->m_Context->m_BlockWriteInfos->m_BlockWritesArrays[block_index];
+    ptrdiff_t block_write_chunk_info_count = arrlen(write_infos);
 
-    if (*source_version->m_Version < LONGTAIL_VERSION_INDEX_VERSION_0_0_2)
+    QSORT(write_infos, block_write_chunk_info_count, sizeof(struct Longtail_BlockChunkWriteInfo), SortBlockChunkWriteInfo, 0);
+
+    ptrdiff_t block_write_chunk_info_index = 0;
+    while (block_write_chunk_info_index < block_write_chunk_info_count)
     {
-        // We are re-hashing since we might have an older version hash that is incompatible
-        for (uint32_t i = 0; i < source_asset_count; ++i)
+        const TBlockChunkWriteArray block_chunk_write_info = &write_infos[block_write_chunk_info_index];
+        const uint32_t asset_index = block_chunk_write_info->AssetIndex;
+        const char* asset_path = &job->m_Context->m_VersionIndex->m_NameData[job->m_Context->m_VersionIndex->m_NameOffsets[asset_index]];
+
+        if (asset_is_open)
         {
-            const char* path = &source_version->m_NameData[source_version->m_NameOffsets[i]];
-            source_assets_path_lengths[i] = (uint32_t)strlen(path);
-            int err = GetPathHashWithLength(hash_api, path, source_assets_path_lengths[i], &source_path_hashes[i]);
-            if (err)
+            if (last_asset_index != asset_index)
             {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_GetPathHash() failed with %d", err)
-                Longtail_Free(work_mem);
-                return err;
+                job->m_Context->m_ConcurrentChunkWriteApi->Close(job->m_Context->m_ConcurrentChunkWriteApi, last_asset_index);
+                asset_is_open = 0;
             }
-            LongtailPrivate_LookupTable_Put(source_path_hash_to_index, source_path_hashes[i], i);
-        }
-    }
-    else
-    {
-        memcpy(source_path_hashes, source_version->m_PathHashes, sizeof(TLongtail_Hash) * source_asset_count);
-        for (uint32_t i = 0; i < source_asset_count; ++i)
-        {
-            const char* path = &source_version->m_NameData[source_version->m_NameOffsets[i]];
-            source_assets_path_lengths[i] = (uint32_t)strlen(path);
-            LongtailPrivate_LookupTable_Put(source_path_hash_to_index, source_version->m_PathHashes[i], i);
         }
-    }
 
-    if (*target_version->m_Version < LONGTAIL_VERSION_INDEX_VERSION_0_0_2)
-    {
-        // We are re-hashing since we might have an older version hash that is incompatible
-        for (uint32_t i = 0; i < target_asset_count; ++i)
+        if (asset_is_open == 0)
         {
-            const char* path = &target_version->m_NameData[target_version->m_NameOffsets[i]];
-            target_assets_path_lengths[i] = (uint32_t)strlen(path);
-            int err = GetPathHashWithLength(hash_api, path, target_assets_path_lengths[i], &target_path_hashes[i]);
+            uint32_t asset_chunk_count = job->m_Context->m_VersionIndex->m_AssetChunkCounts[asset_index];
+            int err = job->m_Context->m_ConcurrentChunkWriteApi->Open(job->m_Context->m_ConcurrentChunkWriteApi, asset_index);
             if (err)
             {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_GetPathHash() failed with %d", err)
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Open() failed for `%s` with %d", asset_path, err)
+                LONGTAIL_MONTITOR_ASSET_OPEN(job->m_Context->m_VersionIndex, asset_index, err);
                 Longtail_Free(work_mem);
+                SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+                LONGTAIL_MONTITOR_BLOCK_COMPLETE(job->m_Context->m_StoreIndex, job->m_BlockIndex, err);
                 return err;
             }
-            LongtailPrivate_LookupTable_Put(target_path_hash_to_index, target_path_hashes[i], i);
+            last_asset_index = asset_index;
+            asset_is_open = 1;
         }
-    }
-    else
-    {
-        memcpy(target_path_hashes, target_version->m_PathHashes, sizeof(TLongtail_Hash) * target_asset_count);
-        for (uint32_t i = 0; i < target_asset_count; ++i)
+
+        uint32_t chunk_index = block_chunk_write_info->ChunkIndex;
+        TLongtail_Hash chunk_hash = job->m_Context->m_VersionIndex->m_ChunkHashes[chunk_index];
+        uint32_t* chunk_index_in_block_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_chunk_index, chunk_hash);
+        if (chunk_index_in_block_ptr == 0)
         {
-            const char* path = &target_version->m_NameData[target_version->m_NameOffsets[i]];
-            target_assets_path_lengths[i] = (uint32_t)strlen(path);
-            LongtailPrivate_LookupTable_Put(target_path_hash_to_index, target_version->m_PathHashes[i], i);
+            job->m_Context->m_ConcurrentChunkWriteApi->Close(job->m_Context->m_ConcurrentChunkWriteApi, asset_index);
+            asset_is_open = 0;
+            LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_Context->m_VersionIndex, asset_index);
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to find chunk in block for `%s` with %d", asset_path, ENOENT)
+            Longtail_Free(work_mem);
+            SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+            LONGTAIL_MONTITOR_BLOCK_COMPLETE(job->m_Context->m_StoreIndex, job->m_BlockIndex, ENOENT);
+            return ENOENT;
         }
-    }
 
-    qsort(source_path_hashes, source_asset_count, sizeof(TLongtail_Hash), CompareHashes);
-    qsort(target_path_hashes, target_asset_count, sizeof(TLongtail_Hash), CompareHashes);
-
-    const uint32_t max_modified_content_count = source_asset_count < target_asset_count ? source_asset_count : target_asset_count;
-    const uint32_t max_modified_permission_count = source_asset_count < target_asset_count ? source_asset_count : target_asset_count;
-    const uint32_t indexes_count = source_asset_count + target_asset_count + max_modified_content_count + max_modified_content_count + max_modified_permission_count + max_modified_permission_count;
-
-    uint32_t source_removed_count = 0;
-    uint32_t target_added_count = 0;
-    uint32_t modified_content_count = 0;
-    uint32_t modified_permissions_count = 0;
-
-    uint32_t source_index = 0;
-    uint32_t target_index = 0;
-    while (source_index < source_asset_count && target_index < target_asset_count)
-    {
-        TLongtail_Hash source_path_hash = source_path_hashes[source_index];
-        TLongtail_Hash target_path_hash = target_path_hashes[target_index];
-        const uint32_t* source_asset_index_ptr = LongtailPrivate_LookupTable_Get(source_path_hash_to_index, source_path_hash);
-        LONGTAIL_FATAL_ASSERT(ctx, source_asset_index_ptr, return EINVAL)
-        uint32_t source_asset_index = *source_asset_index_ptr;
-        const uint32_t* target_asset_index_ptr = LongtailPrivate_LookupTable_Get(target_path_hash_to_index, target_path_hash);
-        LONGTAIL_FATAL_ASSERT(ctx, target_asset_index_ptr, return EINVAL)
-        uint32_t target_asset_index = *target_asset_index_ptr;
+        uint32_t chunk_index_in_block = *chunk_index_in_block_ptr;
+        uint32_t chunk_size = stored_block->m_BlockIndex->m_ChunkSizes[chunk_index_in_block];
+        uint32_t chunk_offset_in_block = chunk_offsets_in_block[chunk_index_in_block];
+        LONGTAIL_MONTITOR_CHUNK_READ(job->m_Context->m_StoreIndex, job->m_Context->m_VersionIndex, block_index, chunk_index, chunk_index_in_block, 0);
 
-        const char* source_path = &source_version->m_NameData[source_version->m_NameOffsets[source_asset_index]];
-        const char* target_path = &target_version->m_NameData[target_version->m_NameOffsets[target_asset_index]];
+        // Chunks that follow each other in the target are written as one run, chunks that are
+        // also contiguous in the block are merged into the same buffer
+        struct Longtail_StorageAPI_IOVec write_vecs[MAX_WRITE_VEC_COUNT];
+        write_vecs[0].m_Data = &block_data[chunk_offset_in_block];
+        write_vecs[0].m_Length = chunk_size;
+        uint32_t write_vec_count = 1;
+        uint32_t chunk_index_in_block_prev = chunk_index_in_block;
 
-        if (source_path_hash == target_path_hash)
+        uint32_t chunk_run_count = 1;
+        uint32_t chunk_run_size = chunk_size;
+        while (block_write_chunk_info_index + chunk_run_count < block_write_chunk_info_count)
         {
-            TLongtail_Hash source_content_hash = source_version->m_ContentHashes[source_asset_index];
-            TLongtail_Hash target_content_hash = target_version->m_ContentHashes[target_asset_index];
-            if (source_content_hash != target_content_hash)
+            const TBlockChunkWriteArray block_chunk_write_info_next = &write_infos[block_write_chunk_info_index + chunk_run_count];
+            if (block_chunk_write_info_next->AssetIndex != asset_index)
             {
-                modified_source_content_indexes[modified_content_count] = source_asset_index;
-                modified_target_content_indexes[modified_content_count] = target_asset_index;
-                ++modified_content_count;
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Mismatching content for asset %s", source_path)
+                break;
             }
-
-            uint16_t source_permissions = source_version->m_Permissions[source_asset_index];
-            uint16_t target_permissions = target_version->m_Permissions[target_asset_index];
-            if (source_permissions != target_permissions)
+            if (block_chunk_write_info_next->Offset != (block_chunk_write_info->Offset + chunk_run_size))
             {
-                modified_source_permissions_indexes[modified_permissions_count] = source_asset_index;
-                modified_target_permissions_indexes[modified_permissions_count] = target_asset_index;
-                ++modified_permissions_count;
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Mismatching permissions for asset %s", source_path)
+                break;
+            }
+            uint32_t chunk_index_next = block_chunk_write_info_next->ChunkIndex;
+            TLongtail_Hash chunk_hash_next = job->m_Context->m_VersionIndex->m_ChunkHashes[chunk_index_next];
+            uint32_t* chunk_index_in_block_ptr_next = LongtailPrivate_LookupTable_Get(chunk_hash_to_chunk_index, chunk_hash_next);
+            if (chunk_index_in_block_ptr_next == 0)
+            {
+                job->m_Context->m_ConcurrentChunkWriteApi->Close(job->m_Context->m_ConcurrentChunkWriteApi, asset_index);
+                asset_is_open = 0;
+                LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_Context->m_VersionIndex, asset_index);
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to find chunk in block for `%s` with %d", asset_path, ENOENT)
+                Longtail_Free(work_mem);
+                SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+                LONGTAIL_MONTITOR_BLOCK_COMPLETE(job->m_Context->m_StoreIndex, job->m_BlockIndex, ENOENT);
+                return ENOENT;
+            }
+            uint32_t chunk_index_in_block_next = *chunk_index_in_block_ptr_next;
+            uint32_t chunk_size_next = stored_block->m_BlockIndex->m_ChunkSizes[chunk_index_in_block_next];
+            if (chunk_index_in_block_next == chunk_index_in_block_prev + 1)
+            {
+                write_vecs[write_vec_count - 1].m_Length += chunk_size_next;
             }
+            else if (write_vec_count < MAX_WRITE_VEC_COUNT)
+            {
+                write_vecs[write_vec_count].m_Data = &block_data[chunk_offsets_in_block[chunk_index_in_block_next]];
+                write_vecs[write_vec_count].m_Length = chunk_size_next;
+                ++write_vec_count;
+            }
+            else
+            {
+                break;
+            }
+            chunk_index_in_block_prev = chunk_index_in_block_next;
+            LONGTAIL_MONTITOR_CHUNK_READ(job->m_Context->m_StoreIndex, job->m_Context->m_VersionIndex, block_index, chunk_index_next, chunk_index_in_block_next, 0);
 
-            ++source_index;
-            ++target_index;
-        }
-        else if (source_path_hash < target_path_hash)
-        {
-            const uint32_t* source_asset_index_ptr = LongtailPrivate_LookupTable_Get(source_path_hash_to_index, source_path_hash);
-            LONGTAIL_FATAL_ASSERT(ctx, source_asset_index_ptr, return EINVAL)
-            source_asset_index = *source_asset_index_ptr;
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Removed asset %s", source_path)
-            removed_source_asset_indexes[source_removed_count] = source_asset_index;
-            ++source_removed_count;
-            ++source_index;
+            chunk_run_size += chunk_size_next;
+            chunk_run_count++;
         }
-        else
+
+        int err = (write_vec_count == 1) ?
+            job->m_Context->m_ConcurrentChunkWriteApi->Write(job->m_Context->m_ConcurrentChunkWriteApi, asset_index, block_chunk_write_info->Offset, chunk_run_size, &block_data[chunk_offset_in_block]) :
+            job->m_Context->m_ConcurrentChunkWriteApi->WriteV(job->m_Context->m_ConcurrentChunkWriteApi, asset_index, block_chunk_write_info->Offset, write_vec_count, write_vecs);
+        LONGTAIL_MONTITOR_ASSET_WRITE(job->m_Context->m_StoreIndex, job->m_Context->m_VersionIndex, asset_index, block_chunk_write_info->Offset, chunk_run_size, chunk_index, chunk_index_in_block, chunk_run_count, block_index, chunk_offset_in_block, err);
+        if (err)
         {
-            const uint32_t* target_asset_index_ptr = LongtailPrivate_LookupTable_Get(target_path_hash_to_index, target_path_hash);
-            LONGTAIL_FATAL_ASSERT(ctx, target_asset_index_ptr, return EINVAL)
-            target_asset_index = *target_asset_index_ptr;
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Added asset %s", target_path)
-            added_target_asset_indexes[target_added_count] = target_asset_index;
-            ++target_added_count;
-            ++target_index;
-        } 
-    }
-    while (source_index < source_asset_count)
-    {
-        // source_path_hash removed
-        TLongtail_Hash source_path_hash = source_path_hashes[source_index];
-        const uint32_t* source_asset_index_ptr = LongtailPrivate_LookupTable_Get(source_path_hash_to_index, source_path_hash);
-        LONGTAIL_FATAL_ASSERT(ctx, source_asset_index_ptr, return EINVAL)
-        uint32_t source_asset_index = *source_asset_index_ptr;
-        const char* source_path = &source_version->m_NameData[source_version->m_NameOffsets[source_asset_index]];
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Removed asset %s", source_path)
-        removed_source_asset_indexes[source_removed_count] = source_asset_index;
-        ++source_removed_count;
-        ++source_index;
+            job->m_Context->m_ConcurrentChunkWriteApi->Close(job->m_Context->m_ConcurrentChunkWriteApi, asset_index);
+            asset_is_open = 0;
+            LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_Context->m_VersionIndex, asset_index);
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Write() failed for `%s` with %d", asset_path, err)
+            Longtail_Free(work_mem);
+            SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+            LONGTAIL_MONTITOR_BLOCK_COMPLETE(job->m_Context->m_StoreIndex, job->m_BlockIndex, err);
+            return err;
+        }
+        block_write_chunk_info_index += chunk_run_count;
     }
-    while (target_index < target_asset_count)
+    if (asset_is_open != 0)
     {
-        // target_path_hash added
-        TLongtail_Hash target_path_hash = target_path_hashes[target_index];
-        const uint32_t* target_asset_index_ptr = LongtailPrivate_LookupTable_Get(target_path_hash_to_index, target_path_hash);
-        LONGTAIL_FATAL_ASSERT(ctx, target_asset_index_ptr, return EINVAL)
-        uint32_t target_asset_index = *target_asset_index_ptr;
-        const char* target_path = &target_version->m_NameData[target_version->m_NameOffsets[target_asset_index]];
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Added asset %s", target_path)
-        added_target_asset_indexes[target_added_count] = target_asset_index;
-        ++target_added_count;
-        ++target_index;
+        job->m_Context->m_ConcurrentChunkWriteApi->Close(job->m_Context->m_ConcurrentChunkWriteApi, last_asset_index);
+        asset_is_open = 0;
+        LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_Context->m_VersionIndex, last_asset_index);
     }
-    if (source_removed_count > 0)
+
+    Longtail_Free(work_mem);
+    SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+    LONGTAIL_MONTITOR_BLOCK_COMPLETE(job->m_Context->m_StoreIndex, job->m_BlockIndex, 0);
+    job->m_Context->m_ConcurrentChunkWriteApi->Flush(job->m_Context->m_ConcurrentChunkWriteApi);
+    return 0;
+}
+
+static SORTFUNC(SortLocalChunkWriteInfo)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(a_ptr, "%p"),
+        LONGTAIL_LOGFIELD(b_ptr, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, context == 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
+    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
+
+    const struct Longtail_LocalChunkWriteInfo* a = (const struct Longtail_LocalChunkWriteInfo*)a_ptr;
+    const struct Longtail_LocalChunkWriteInfo* b = (const struct Longtail_LocalChunkWriteInfo*)b_ptr;
+    if (a->AssetIndex < b->AssetIndex)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Found %u removed assets", source_removed_count)
+        return -1;
     }
-    if (target_added_count > 0)
+    if (a->AssetIndex > b->AssetIndex)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Found %u added assets", target_added_count)
+        return 1;
     }
-    if (modified_content_count > 0)
+    if (a->Offset < b->Offset)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Mismatching content for %u assets found", modified_content_count)
+        return -1;
     }
-    if (modified_permissions_count > 0)
+    if (a->Offset > b->Offset)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_CreateVersionDiff: Mismatching permission for %u assets found", modified_permissions_count)
+        return 1;
     }
+    return 0;
+}
 
-    size_t version_diff_size = GetVersionDiffSize(source_removed_count, target_added_count, modified_content_count, modified_permissions_count);
-    struct Longtail_VersionDiff* version_diff = (struct Longtail_VersionDiff*)Longtail_Alloc("CreateVersionDiff", version_diff_size);
-    if (!version_diff)
+#define LONGTAIL_LOCAL_CHUNKS_MAX_RUN_SIZE (8u * 1024u * 1024u)
+
+static void AddLocalChunkFallbackWrites(
+    struct LocalChunkWriteJob* job,
+    const struct Longtail_LocalChunkWriteInfo* write_infos,
+    ptrdiff_t write_info_count)
+{
+    for (ptrdiff_t i = 0; i < write_info_count; ++i)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        Longtail_Free(work_mem);
-        return ENOMEM;
+        struct Longtail_BlockChunkWriteInfo fallback_write = {write_infos[i].ChunkIndex, write_infos[i].AssetIndex, write_infos[i].Offset};
+        arrput(job->m_FallbackWrites, fallback_write);
     }
-    uint32_t* counts_ptr = (uint32_t*)(void*)&version_diff[1];
-    counts_ptr[0] = source_removed_count;
-    counts_ptr[1] = target_added_count;
-    counts_ptr[2] = modified_content_count;
-    counts_ptr[3] = modified_permissions_count;
-    InitVersionDiff(version_diff);
-
-    memmove(version_diff->m_SourceRemovedAssetIndexes, removed_source_asset_indexes, sizeof(uint32_t) * source_removed_count);
-    memmove(version_diff->m_TargetAddedAssetIndexes, added_target_asset_indexes, sizeof(uint32_t) * target_added_count);
-    memmove(version_diff->m_SourceContentModifiedAssetIndexes, modified_source_content_indexes, sizeof(uint32_t) * modified_content_count);
-    memmove(version_diff->m_TargetContentModifiedAssetIndexes, modified_target_content_indexes, sizeof(uint32_t) * modified_content_count);
-    memmove(version_diff->m_SourcePermissionsModifiedAssetIndexes, modified_source_permissions_indexes, sizeof(uint32_t) * modified_permissions_count);
-    memmove(version_diff->m_TargetPermissionsModifiedAssetIndexes, modified_target_permissions_indexes, sizeof(uint32_t) * modified_permissions_count);
-
-    QSORT(version_diff->m_SourceRemovedAssetIndexes, source_removed_count, sizeof(uint32_t), SortPathLongToShort, (void*)source_assets_path_lengths);
-    QSORT(version_diff->m_TargetAddedAssetIndexes, target_added_count, sizeof(uint32_t), SortPathShortToLong, (void*)target_assets_path_lengths);
-
-    Longtail_Free(work_mem);
-    *out_version_diff = version_diff;
-    return 0;
 }
 
-static int CleanUpRemoveAssets(
-    struct Longtail_StorageAPI* version_storage_api,
-    struct Longtail_CancelAPI* optional_cancel_api,
-    Longtail_CancelAPI_HCancelToken optional_cancel_token,
-    const struct Longtail_VersionIndex* source_version,
-    const struct Longtail_VersionDiff* version_diff,
-    const char* version_path)
+static int WriteLocalChunksJob(void* context, uint32_t job_id, int detected_error)
 {
+#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
-        LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
-        LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
-        LONGTAIL_LOGFIELD(source_version, "%p"),
-        LONGTAIL_LOGFIELD(version_diff, "%p"),
-        LONGTAIL_LOGFIELD(version_path, "%s")
-        MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(job_id, "%u"),
+        LONGTAIL_LOGFIELD(detected_error, "%d")
+        MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-        LONGTAIL_VALIDATE_INPUT(ctx, version_storage_api != 0, return EINVAL)
-        LONGTAIL_VALIDATE_INPUT(ctx, source_version != 0, return EINVAL)
-        LONGTAIL_VALIDATE_INPUT(ctx, version_diff != 0, return EINVAL)
-        LONGTAIL_VALIDATE_INPUT(ctx, version_path != 0, return EINVAL)
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return EINVAL)
 
-    uint32_t remove_count = *version_diff->m_SourceRemovedCount;
-    LONGTAIL_FATAL_ASSERT(ctx, remove_count <= *source_version->m_AssetCount, return EINVAL);
-    if (remove_count == 0)
+    struct LocalChunkWriteJob* job = (struct LocalChunkWriteJob*)context;
+
+    if (detected_error)
     {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "WriteLocalChunksJob aborted due to previous error %d", detected_error)
         return 0;
     }
 
-    int err = 0;
-    char* full_asset_path = 0;
-    uint32_t* remove_indexes = (uint32_t*)Longtail_Alloc("ChangeVersion", sizeof(uint32_t) * remove_count);
-    if (!remove_indexes)
+    const struct ContentBlock2JobContext* job_context = job->m_Context;
+    struct Longtail_StorageAPI* version_storage_api = job_context->m_VersionStorageAPI;
+    struct Longtail_ConcurrentChunkWriteAPI* concurrent_chunk_write_api = job_context->m_ConcurrentChunkWriteApi;
+    const struct Longtail_VersionIndex* version_index = job_context->m_VersionIndex;
+    uint32_t source_asset_index = job->m_SourceAssetIndex;
+
+    TLocalChunkWriteArray write_infos = job_context->m_BlockWriteInfos->m_LocalWritesArrays[source_asset_index];
+    ptrdiff_t write_info_count = arrlen(write_infos);
+
+    QSORT(write_infos, write_info_count, sizeof(struct Longtail_LocalChunkWriteInfo), SortLocalChunkWriteInfo, 0);
+
+    char* source_path = GetSourceAssetPath(
+        version_storage_api,
+        job_context->m_SourceVersionIndex,
+        job_context->m_VersionPath,
+        job_context->m_SourceAssetIsStaged[source_asset_index] ? job_context->m_StagingPath : 0,
+        source_asset_index);
+    if (!source_path)
     {
-        err = ENOMEM;
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", err)
-        return err;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ConcatPath() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    Longtail_StorageAPI_HOpenFile source_file;
+    int err = version_storage_api->OpenReadFile(version_storage_api, source_path, &source_file);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "version_storage_api->OpenReadFile() failed for `%s` with %d, using block store", source_path, err)
+        Longtail_Free(source_path);
+        AddLocalChunkFallbackWrites(job, write_infos, write_info_count);
+        return 0;
     }
-    memcpy(remove_indexes, version_diff->m_SourceRemovedAssetIndexes, sizeof(uint32_t) * remove_count);
 
-    uint32_t retry_count = 10;
-    uint32_t successful_remove_count = 0;
-    while (retry_count && (successful_remove_count < remove_count))
+    void* buffer = 0;
+    uint32_t buffer_size = 0;
+    int asset_is_open = 0;
+    uint32_t last_asset_index = 0;
+
+    ptrdiff_t write_info_index = 0;
+    while (write_info_index < write_info_count)
     {
-        if (retry_count < 10)
+        const struct Longtail_LocalChunkWriteInfo* write_info = &write_infos[write_info_index];
+        const uint32_t asset_index = write_info->AssetIndex;
+
+        if (asset_is_open && last_asset_index != asset_index)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Longtail_ChangeVersion: Retrying removal of remaning %u assets in %s", remove_count - successful_remove_count, version_path)
+            concurrent_chunk_write_api->Close(concurrent_chunk_write_api, last_asset_index);
+            LONGTAIL_MONTITOR_ASSET_CLOSE(version_index, last_asset_index);
+            asset_is_open = 0;
         }
-        --retry_count;
-        if ((successful_remove_count & 0x7f) == 0x7f) {
-            if (optional_cancel_api && optional_cancel_token && optional_cancel_api->IsCancelled(optional_cancel_api, optional_cancel_token) == ECANCELED)
+        if (!asset_is_open)
+        {
+            err = concurrent_chunk_write_api->Open(concurrent_chunk_write_api, asset_index);
+            if (err)
             {
-                err = ECANCELED;
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Operation cancelled, failed with %d", err)
-                Longtail_Free(remove_indexes);
-                return err;
+                const char* asset_path = &version_index->m_NameData[version_index->m_NameOffsets[asset_index]];
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Open() failed for `%s` with %d", asset_path, err)
+                LONGTAIL_MONTITOR_ASSET_OPEN(version_index, asset_index, err);
+                break;
             }
+            last_asset_index = asset_index;
+            asset_is_open = 1;
         }
-        for (uint32_t r = 0; r < remove_count; ++r)
+
+        // Copy runs of chunks that are adjacent both in the source file and the target asset with one read and one write
+        uint32_t run_size = version_index->m_ChunkSizes[write_info->ChunkIndex];
+        ptrdiff_t run_count = 1;
+        while (write_info_index + run_count < write_info_count)
         {
-            uint32_t asset_index = remove_indexes[r];
-            if (asset_index == 0xffffffff)
+            const struct Longtail_LocalChunkWriteInfo* next_write_info = &write_infos[write_info_index + run_count];
+            uint32_t next_chunk_size = version_index->m_ChunkSizes[next_write_info->ChunkIndex];
+            if (next_write_info->AssetIndex != asset_index ||
+                next_write_info->Offset != write_info->Offset + run_size ||
+                next_write_info->SourceOffset != write_info->SourceOffset + run_size ||
+                run_size + next_chunk_size > LONGTAIL_LOCAL_CHUNKS_MAX_RUN_SIZE)
             {
-                continue;
+                break;
             }
-            const char* asset_path = &source_version->m_NameData[source_version->m_NameOffsets[asset_index]];
-            char* full_asset_path = version_storage_api->ConcatPath(version_storage_api, version_path, asset_path);
-            if (IsDirPath(asset_path))
+            run_size += next_chunk_size;
+            ++run_count;
+        }
+
+        if (run_size > buffer_size)
+        {
+            Longtail_Free(buffer);
+            buffer = Longtail_Alloc("WriteLocalChunksJob", run_size);
+            if (!buffer)
             {
-                full_asset_path[strlen(full_asset_path) - 1] = '\0';
-                if (!version_storage_api->IsDir(version_storage_api, full_asset_path))
-                {
-                    remove_indexes[r] = 0xffffffff;
-                    Longtail_Free(full_asset_path);
-                    Longtail_Free(remove_indexes);
-                    return err;
-                }
-                uint16_t permissions = 0;
-                err = version_storage_api->GetPermissions(version_storage_api, full_asset_path, &permissions);
-                if (err)
-                {
-                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->GetPermissions() failed with %d", err)
-                    LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, err)
-                    Longtail_Free(full_asset_path);
-                    Longtail_Free(remove_indexes);
-                    return err;
-                }
-                if (!(permissions & Longtail_StorageAPI_UserWriteAccess))
-                {
-                    err = version_storage_api->SetPermissions(version_storage_api, full_asset_path, permissions | (Longtail_StorageAPI_UserWriteAccess | Longtail_StorageAPI_GroupWriteAccess | Longtail_StorageAPI_OtherWriteAccess));
-                    if (err)
-                    {
-                        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->SetPermissions() failed with %d", err)
-                        LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, err)
-                        Longtail_Free(full_asset_path);
-                        Longtail_Free(remove_indexes);
-                        return err;
-                    }
-                }
-                err = version_storage_api->RemoveDir(version_storage_api, full_asset_path);
-                if (err && version_storage_api->IsDir(version_storage_api, full_asset_path))
-                {
-                    if (!retry_count)
-                    {
-                        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Can't to remove dir `%s`, failed with %d", full_asset_path, err)
-                        Longtail_Free(full_asset_path);
-                        Longtail_Free(remove_indexes);
-                        LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, err)
-                        return err;
-                    }
-                    Longtail_Free(full_asset_path);
-                    full_asset_path = 0;
-                    continue;
-                }
-                LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, 0)
+                err = ENOMEM;
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", err)
+                break;
             }
-            else
+            buffer_size = run_size;
+        }
+
+        err = version_storage_api->Read(version_storage_api, source_file, write_info->SourceOffset, run_size, buffer);
+        if (err)
+        {
+            // The file on disk does not look like the source version says, get the whole run from the block store
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "version_storage_api->Read() failed for `%s` with %d, using block store", source_path, err)
+            AddLocalChunkFallbackWrites(job, write_info, run_count);
+            err = 0;
+            write_info_index += run_count;
+            continue;
+        }
+
+        // The source version index may be stale, only copy chunks that still hash to what the target expects,
+        // matching chunks are still written in as long runs as possible
+        const uint8_t* run_data = (const uint8_t*)buffer;
+        ptrdiff_t write_start = 0;
+        uint32_t write_offset_in_run = 0;
+        uint32_t chunk_offset_in_run = 0;
+        for (ptrdiff_t r = 0; r <= run_count; ++r)
+        {
+            int chunk_matches = 0;
+            uint32_t chunk_size = 0;
+            if (r < run_count)
             {
-                if (!version_storage_api->IsFile(version_storage_api, full_asset_path))
-                {
-                    remove_indexes[r] = 0xffffffff;
-                    Longtail_Free(full_asset_path);
-                    continue;
-                }
-                uint16_t permissions = 0;
-                err = version_storage_api->GetPermissions(version_storage_api, full_asset_path, &permissions);
+                uint32_t chunk_index = write_info[r].ChunkIndex;
+                chunk_size = version_index->m_ChunkSizes[chunk_index];
+                TLongtail_Hash chunk_hash = 0;
+                err = job_context->m_HashAPI->HashBuffer(job_context->m_HashAPI, chunk_size, &run_data[chunk_offset_in_run], &chunk_hash);
                 if (err)
                 {
-                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->GetPermissions() failed with %d", err)
-                    LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, err)
-                    Longtail_Free(full_asset_path);
-                    Longtail_Free(remove_indexes);
-                    return err;
+                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "m_HashAPI->HashBuffer() failed with %d", err)
+                    break;
                 }
-                if (!(permissions & Longtail_StorageAPI_UserWriteAccess))
+                chunk_matches = chunk_hash == version_index->m_ChunkHashes[chunk_index];
+            }
+            if (!chunk_matches)
+            {
+                if (r > write_start)
                 {
-                    err = version_storage_api->SetPermissions(version_storage_api, full_asset_path, permissions | (Longtail_StorageAPI_UserWriteAccess));
+                    err = concurrent_chunk_write_api->Write(concurrent_chunk_write_api, asset_index, write_info[write_start].Offset, chunk_offset_in_run - write_offset_in_run, &run_data[write_offset_in_run]);
                     if (err)
                     {
-                        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->SetPermissions() failed with %d", err)
-                        LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, err)
-                        Longtail_Free(full_asset_path);
-                        Longtail_Free(remove_indexes);
-                        return err;
+                        const char* asset_path = &version_index->m_NameData[version_index->m_NameOffsets[asset_index]];
+                        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Write() failed for `%s` with %d", asset_path, err)
+                        break;
                     }
                 }
-                err = version_storage_api->RemoveFile(version_storage_api, full_asset_path);
-                if (err && version_storage_api->IsFile(version_storage_api, full_asset_path))
+                if (r < run_count)
                 {
-                    if (!retry_count)
-                    {
-                        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Can't to file dir `%s`, failed with %d", full_asset_path, err)
-                        LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, err)
-                        Longtail_Free(full_asset_path);
-                        Longtail_Free(remove_indexes);
-                        return err;
-                    }
-                    Longtail_Free(full_asset_path);
-                    full_asset_path = 0;
-                    continue;
+                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Chunk at offset %" PRIu64 " in `%s` does not match the source version, using block store", write_info[r].SourceOffset, source_path)
+                    AddLocalChunkFallbackWrites(job, &write_info[r], 1);
                 }
-                LONGTAIL_MONITOR_ASSET_REMOVE(source_version, asset_index, 0)
+                write_start = r + 1;
+                write_offset_in_run = chunk_offset_in_run + chunk_size;
             }
-            Longtail_Free(full_asset_path);
-            full_asset_path = 0;
-            remove_indexes[r] = 0xffffffff;
-            ++successful_remove_count;
+            chunk_offset_in_run += chunk_size;
+        }
+        if (err)
+        {
+            break;
         }
+        write_info_index += run_count;
     }
-    Longtail_Free(remove_indexes);
-    return err;
+    if (asset_is_open)
+    {
+        concurrent_chunk_write_api->Close(concurrent_chunk_write_api, last_asset_index);
+        LONGTAIL_MONTITOR_ASSET_CLOSE(version_index, last_asset_index);
+    }
+    Longtail_Free(buffer);
+    version_storage_api->CloseFile(version_storage_api, source_file);
+    Longtail_Free(source_path);
+    if (err)
+    {
+        return err;
+    }
+    concurrent_chunk_write_api->Flush(concurrent_chunk_write_api);
+    return 0;
 }
 
-static int RetainPermissions(
-    struct Longtail_StorageAPI* version_storage_api,
+// Writes the chunks that WriteLocalChunksJob could not copy from disk using blocks from the block store
+static int WriteLocalChunkFallbacks(
+    const struct ContentBlock2JobContext* context,
+    struct Longtail_ProgressAPI* progress_api,
     struct Longtail_CancelAPI* optional_cancel_api,
     Longtail_CancelAPI_HCancelToken optional_cancel_token,
-    const struct Longtail_VersionIndex* target_version,
-    const struct Longtail_VersionDiff* version_diff,
-    const char* version_path)
+    struct LocalChunkWriteJob* local_jobs,
+    uint32_t local_job_count)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(progress_api, "%p"),
         LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
         LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
+        LONGTAIL_LOGFIELD(local_jobs, "%p"),
+        LONGTAIL_LOGFIELD(local_job_count, "%u")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    ptrdiff_t fallback_write_count = 0;
+    for (uint32_t l = 0; l < local_job_count; ++l)
+    {
+        fallback_write_count += arrlen(local_jobs[l].m_FallbackWrites);
+    }
+    if (fallback_write_count == 0)
+    {
+        return 0;
+    }
+
+    const struct Longtail_StoreIndex* store_index = context->m_StoreIndex;
+    const struct Longtail_VersionIndex* version_index = context->m_VersionIndex;
+    uint32_t block_count = *store_index->m_BlockCount;
+    uint32_t chunk_count = *store_index->m_ChunkCount;
+
+    size_t block_write_infos_size = sizeof(struct Longtail_BlockWriteInfos) + sizeof(TBlockChunkWriteArray) * block_count;
+    size_t chunk_hash_to_block_index_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
+    size_t work_mem_size = block_write_infos_size + chunk_hash_to_block_index_size;
+    void* work_mem = Longtail_Alloc("WriteLocalChunkFallbacks", work_mem_size);
+    if (!work_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    struct Longtail_BlockWriteInfos* block_write_infos = (struct Longtail_BlockWriteInfos*)work_mem;
+    block_write_infos->m_BlockCount = block_count;
+    block_write_infos->m_BlockWritesArrays = (TBlockChunkWriteArray*)&block_write_infos[1];
+    memset(block_write_infos->m_BlockWritesArrays, 0, sizeof(TBlockChunkWriteArray) * block_count);
+    block_write_infos->m_ZeroSizeWriteInfoArray = 0;
+    block_write_infos->m_LocalWritesArrays = 0;
+    block_write_infos->m_LocalAssetCount = 0;
+    struct Longtail_LookupTable* chunk_hash_to_block_index = LongtailPrivate_LookupTable_Create(&((uint8_t*)work_mem)[block_write_infos_size], chunk_count, 0);
+
+    for (uint32_t b = 0; b < block_count; ++b)
+    {
+        uint32_t block_chunk_offset = store_index->m_BlockChunksOffsets[b];
+        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
+        for (uint32_t c = 0; c < block_chunk_count; ++c)
+        {
+            LongtailPrivate_LookupTable_PutUnique(chunk_hash_to_block_index, store_index->m_ChunkHashes[block_chunk_offset + c], b);
+        }
+    }
+
+    int err = 0;
+    uint32_t fetch_block_count = 0;
+    for (uint32_t l = 0; l < local_job_count && !err; ++l)
+    {
+        TBlockChunkWriteArray fallback_writes = local_jobs[l].m_FallbackWrites;
+        ptrdiff_t write_count = arrlen(fallback_writes);
+        for (ptrdiff_t w = 0; w < write_count; ++w)
+        {
+            TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[fallback_writes[w].ChunkIndex];
+            uint32_t* block_index_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, chunk_hash);
+            if (block_index_ptr == 0)
+            {
+                err = ENOENT;
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Chunk 0x%" PRIx64 " does not match on disk and is not in the store index, failed with %d", chunk_hash, err)
+                break;
+            }
+            fetch_block_count += arrlen(block_write_infos->m_BlockWritesArrays[*block_index_ptr]) == 0 ? 1 : 0;
+            arrput(block_write_infos->m_BlockWritesArrays[*block_index_ptr], fallback_writes[w]);
+        }
+    }
+
+    size_t job_mem_size =
+        sizeof(struct ContentBlock2Job) * fetch_block_count +
+        sizeof(Longtail_JobAPI_JobFunc) * fetch_block_count +
+        sizeof(void*) * fetch_block_count;
+    void* job_mem = err ? 0 : Longtail_Alloc("WriteLocalChunkFallbacks", job_mem_size);
+    if (!err && !job_mem)
+    {
+        err = ENOMEM;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", err)
+    }
+    if (!err)
+    {
+        struct ContentBlock2JobContext fallback_context = *context;
+        fallback_context.m_BlockWriteInfos = block_write_infos;
+
+        uint8_t* job_mem_ptr = (uint8_t*)job_mem;
+        struct ContentBlock2Job* jobs = (struct ContentBlock2Job*)job_mem_ptr;
+        job_mem_ptr += sizeof(struct ContentBlock2Job) * fetch_block_count;
+        Longtail_JobAPI_JobFunc* job_funcs = (Longtail_JobAPI_JobFunc*)job_mem_ptr;
+        job_mem_ptr += sizeof(Longtail_JobAPI_JobFunc) * fetch_block_count;
+        void** job_ctxs = (void**)job_mem_ptr;
+
+        uint32_t job_index = 0;
+        for (uint32_t b = 0; b < block_count; ++b)
+        {
+            if (arrlen(block_write_infos->m_BlockWritesArrays[b]) == 0)
+            {
+                continue;
+            }
+            struct ContentBlock2Job* job = &jobs[job_index];
+            job->m_AsyncCompleteAPI.m_API.Dispose = 0;
+            job->m_AsyncCompleteAPI.OnComplete = 0;
+            job->m_Context = &fallback_context;
+            job->m_BlockIndex = b;
+            job->m_StoredBlock = 0;
+            job->m_JobID = 0;
+            job_funcs[job_index] = WriteContentBlock2Job;
+            job_ctxs[job_index] = job;
+            ++job_index;
+        }
+
+        uint32_t jobs_submitted = 0;
+        err = Longtail_RunJobsBatched(
+            context->m_JobAPI,
+            progress_api,
+            optional_cancel_api,
+            optional_cancel_token,
+            fetch_block_count,
+            job_funcs,
+            job_ctxs,
+            &jobs_submitted);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "Longtail_RunJobsBatched() failed with %d", err)
+        }
+    }
+    Longtail_Free(job_mem);
+    for (uint32_t b = 0; b < block_count; ++b)
+    {
+        arrfree(block_write_infos->m_BlockWritesArrays[b]);
+    }
+    Longtail_Free(work_mem);
+    return err;
+}
+
+// Moves the files of the source version that we copy chunks from out of the way
+// if they are about to be removed or overwritten
+static int StageLocalChunkSources(
+    struct Longtail_StorageAPI* version_storage_api,
+    const struct Longtail_VersionIndex* source_version,
+    const struct Longtail_VersionDiff* version_diff,
+    const struct Longtail_BlockWriteInfos* block_write_infos,
+    const char* version_path,
+    uint8_t* source_asset_is_staged,
+    char** io_staging_path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(source_version, "%p"),
+        LONGTAIL_LOGFIELD(version_diff, "%p"),
+        LONGTAIL_LOGFIELD(block_write_infos, "%p"),
+        LONGTAIL_LOGFIELD(version_path, "%s"),
+        LONGTAIL_LOGFIELD(source_asset_is_staged, "%p"),
+        LONGTAIL_LOGFIELD(io_staging_path, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    uint32_t replaced_count = *version_diff->m_SourceRemovedCount + *version_diff->m_ModifiedContentCount;
+    for (uint32_t r = 0; r < replaced_count; ++r)
+    {
+        uint32_t source_asset_index = (r < *version_diff->m_SourceRemovedCount) ?
+            version_diff->m_SourceRemovedAssetIndexes[r] :
+            version_diff->m_SourceContentModifiedAssetIndexes[r - *version_diff->m_SourceRemovedCount];
+        if (arrlen(block_write_infos->m_LocalWritesArrays[source_asset_index]) == 0)
+        {
+            continue;
+        }
+        int err = StageSourceAsset(version_storage_api, source_version, version_path, source_asset_index, source_asset_is_staged, io_staging_path);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "StageSourceAsset() failed with %d", err)
+            return err;
+        }
+    }
+    return 0;
+}
+
+static void FreeBlockWriteInfos(struct Longtail_BlockWriteInfos* block_write_infos)
+{
+    for (ptrdiff_t i = 0; i < block_write_infos->m_BlockCount; ++i)
+    {
+        arrfree(block_write_infos->m_BlockWritesArrays[i]);
+    }
+    for (uint32_t i = 0; i < block_write_infos->m_LocalAssetCount; ++i)
+    {
+        arrfree(block_write_infos->m_LocalWritesArrays[i]);
+    }
+    arrfree(block_write_infos->m_ZeroSizeWriteInfoArray);
+    Longtail_Free(block_write_infos);
+}
+
+#define SAVE_FREE_BLOCK_WRITE_INFOS(i) if (i) {FreeBlockWriteInfos(i); i = 0;}
+
+static int CreateBlockWriteInfos(
+    const struct Longtail_VersionIndex* target_version,
+    const struct Longtail_VersionDiff* version_diff,
+    const struct Longtail_StoreIndex* store_index,
+    const struct Longtail_VersionIndex* optional_local_source_version,
+    struct Longtail_BlockWriteInfos** out_block_write_infos)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(store_index, "%p"),
         LONGTAIL_LOGFIELD(target_version, "%p"),
         LONGTAIL_LOGFIELD(version_diff, "%p"),
-        LONGTAIL_LOGFIELD(version_path, "%s")
-        MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+        LONGTAIL_LOGFIELD(optional_local_source_version, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, version_storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, target_version != 0, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, version_diff != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_path != 0, return EINVAL)
 
-    char* full_path = 0;
+    uint32_t added_count = *version_diff->m_TargetAddedCount;
+    uint32_t modified_content_count = *version_diff->m_ModifiedContentCount;
+    uint32_t write_asset_count = added_count + modified_content_count;
 
-    uint32_t version_diff_modified_permissions_count = *version_diff->m_ModifiedPermissionsCount;
-    for (uint32_t i = 0; i < version_diff_modified_permissions_count; ++i)
+    if (write_asset_count == 0)
     {
-        if ((i & 0x7f) == 0x7f)
+        return 0;
+    }
+
+    int err = 0;
+
+    uint32_t chunk_count = *store_index->m_ChunkCount;
+    uint32_t block_count = *store_index->m_BlockCount;
+    uint32_t local_asset_count = optional_local_source_version ? *optional_local_source_version->m_AssetCount : 0;
+    uint32_t local_chunk_count = optional_local_source_version ? *optional_local_source_version->m_ChunkCount : 0;
+
+    size_t block_write_infos_size = sizeof(struct Longtail_BlockWriteInfos) + sizeof(TBlockChunkWriteArray) * (block_count) + sizeof(TLocalChunkWriteArray) * local_asset_count;
+    void* block_write_infos_mem = Longtail_Alloc("ChangeVersion2", block_write_infos_size);
+    if (!block_write_infos_mem)
+    {
+        err = ENOMEM;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", err)
+        return err;
+    }
+    struct Longtail_BlockWriteInfos* block_write_infos = (struct Longtail_BlockWriteInfos*)block_write_infos_mem;
+    block_write_infos->m_BlockCount = block_count;
+    block_write_infos->m_BlockWritesArrays = (TBlockChunkWriteArray*)&block_write_infos[1];
+    memset(block_write_infos->m_BlockWritesArrays, 0, sizeof(TBlockChunkWriteArray) * block_count);
+    block_write_infos->m_ZeroSizeWriteInfoArray = 0;
+    block_write_infos->m_LocalAssetCount = local_asset_count;
+    block_write_infos->m_LocalWritesArrays = (TLocalChunkWriteArray*)&block_write_infos->m_BlockWritesArrays[block_count];
+    memset(block_write_infos->m_LocalWritesArrays, 0, sizeof(TLocalChunkWriteArray) * local_asset_count);
+
+    size_t chunk_hash_to_block_index_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
+    size_t asset_indexes_size = sizeof(uint32_t) * write_asset_count;
+    size_t chunk_hash_to_local_chunk_size = optional_local_source_version ? LongtailPrivate_LookupTable_GetSize(local_chunk_count) : 0;
+    size_t local_chunk_asset_indexes_size = sizeof(uint32_t) * local_chunk_count;
+    size_t local_chunk_offsets_size = sizeof(uint64_t) * local_chunk_count;
+    size_t local_asset_is_replaced_size = sizeof(uint8_t) * local_asset_count;
+    size_t work_mem_size = chunk_hash_to_block_index_size + asset_indexes_size + chunk_hash_to_local_chunk_size + local_chunk_asset_indexes_size + local_chunk_offsets_size + local_asset_is_replaced_size;
+    void* work_mem = Longtail_Alloc("ChangeVersion2", work_mem_size);
+    if (!work_mem)
+    {
+        err = ENOMEM;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", err)
+        SAVE_FREE_BLOCK_WRITE_INFOS(block_write_infos);
+        return err;
+    }
+    uint8_t* work_mem_ptr = (uint8_t*)work_mem;
+
+    struct Longtail_LookupTable* chunk_hash_to_block_index = LongtailPrivate_LookupTable_Create(work_mem_ptr, chunk_count, 0);
+    work_mem_ptr += chunk_hash_to_block_index_size;
+
+    struct Longtail_LookupTable* chunk_hash_to_local_chunk = optional_local_source_version ? LongtailPrivate_LookupTable_Create(work_mem_ptr, local_chunk_count, 0) : 0;
+    work_mem_ptr += chunk_hash_to_local_chunk_size;
+
+    uint64_t* local_chunk_offsets = (uint64_t*)work_mem_ptr;
+    work_mem_ptr += local_chunk_offsets_size;
+
+    uint32_t* asset_indexes = (uint32_t*)work_mem_ptr;
+    work_mem_ptr += asset_indexes_size;
+
+    uint32_t* local_chunk_asset_indexes = (uint32_t*)work_mem_ptr;
+    work_mem_ptr += local_chunk_asset_indexes_size;
+
+    uint8_t* local_asset_is_replaced = (uint8_t*)work_mem_ptr;
+
+    if (optional_local_source_version)
+    {
+        // Files that are removed or rewritten can only be read if they are staged before we touch the version,
+        // so prefer picking chunks from files that are left as is
+        memset(local_asset_is_replaced, 0, local_asset_is_replaced_size);
+        for (uint32_t r = 0; r < *version_diff->m_SourceRemovedCount; ++r)
         {
-            if (optional_cancel_api && optional_cancel_token && optional_cancel_api->IsCancelled(optional_cancel_api, optional_cancel_token) == ECANCELED)
-            {
-                int err = ECANCELED;
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Operation cancelled, failed with %d", err)
-                return err;
-            }
+            local_asset_is_replaced[version_diff->m_SourceRemovedAssetIndexes[r]] = 1;
         }
-        uint32_t asset_index = version_diff->m_TargetPermissionsModifiedAssetIndexes[i];
-        const char* asset_path = &target_version->m_NameData[target_version->m_NameOffsets[asset_index]];
-        char* full_path = version_storage_api->ConcatPath(version_storage_api, version_path, asset_path);
-        uint16_t permissions = (uint16_t)target_version->m_Permissions[asset_index];
-        int err = version_storage_api->SetPermissions(version_storage_api, full_path, permissions);
-        if (err)
+        for (uint32_t m = 0; m < modified_content_count; ++m)
+        {
+            local_asset_is_replaced[version_diff->m_SourceContentModifiedAssetIndexes[m]] = 1;
+        }
+        // Moved assets are renamed into place before any chunks are written so they can not be used as a source
+        for (uint32_t m = 0; m < *version_diff->m_MovedCount; ++m)
+        {
+            local_asset_is_replaced[version_diff->m_SourceMovedAssetIndexes[m]] = 2;
+        }
+
+        uint32_t local_chunk_source_count = 0;
+        for (uint8_t pass = 0; pass < 2; ++pass)
+        {
+            for (uint32_t local_asset_index = 0; local_asset_index < local_asset_count; ++local_asset_index)
+            {
+                if (local_asset_is_replaced[local_asset_index] != pass)
+                {
+                    continue;
+                }
+                uint32_t local_asset_chunk_count = optional_local_source_version->m_AssetChunkCounts[local_asset_index];
+                uint32_t local_asset_chunk_offset = optional_local_source_version->m_AssetChunkIndexStarts[local_asset_index];
+                uint64_t local_file_offset = 0;
+                for (uint32_t c = 0; c < local_asset_chunk_count; ++c)
+                {
+                    uint32_t local_chunk_index = optional_local_source_version->m_AssetChunkIndexes[local_asset_chunk_offset + c];
+                    TLongtail_Hash local_chunk_hash = optional_local_source_version->m_ChunkHashes[local_chunk_index];
+                    if (LongtailPrivate_LookupTable_PutUnique(chunk_hash_to_local_chunk, local_chunk_hash, local_chunk_source_count) == 0)
+                    {
+                        local_chunk_asset_indexes[local_chunk_source_count] = local_asset_index;
+                        local_chunk_offsets[local_chunk_source_count] = local_file_offset;
+                        ++local_chunk_source_count;
+                    }
+                    local_file_offset += optional_local_source_version->m_ChunkSizes[local_chunk_index];
+                }
+            }
+        }
+    }
+
+    for (uint32_t b = 0; b < block_count; ++b)
+    {
+        LONGTAIL_MONTITOR_BLOCK_PREPARE(store_index, b);
+        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
+        uint32_t chunk_index_offset = store_index->m_BlockChunksOffsets[b];
+        for (uint32_t c = 0; c < block_chunk_count; ++c)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->SetPermissions() failed for `%s` with %d", full_path, err)
-            Longtail_Free(full_path);
-            return err;
+            uint32_t chunk_index = chunk_index_offset + c;
+            TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_index];
+            LongtailPrivate_LookupTable_PutUnique(chunk_hash_to_block_index, chunk_hash, b);
         }
-        Longtail_Free(full_path);
     }
 
-    uint32_t version_diff_added_permissions_count = *version_diff->m_TargetAddedCount;
-    for (uint32_t i = 0; i < version_diff_added_permissions_count; ++i)
+    for (uint32_t i = 0; i < added_count; ++i)
     {
-        if ((i & 0x7f) == 0x7f)
+        asset_indexes[i] = version_diff->m_TargetAddedAssetIndexes[i];
+    }
+    for (uint32_t i = 0; i < modified_content_count; ++i)
+    {
+        asset_indexes[added_count + i] = version_diff->m_TargetContentModifiedAssetIndexes[i];
+    }
+
+    uint32_t* name_offsets = target_version->m_NameOffsets;
+    const char* name_data = target_version->m_NameData;
+    const TLongtail_Hash* chunk_hashes = target_version->m_ChunkHashes;
+    const TLongtail_Hash* block_hashes = store_index->m_BlockHashes;
+    const uint32_t* asset_chunk_counts = target_version->m_AssetChunkCounts;
+    const uint32_t* asset_chunk_index_starts = target_version->m_AssetChunkIndexStarts;
+    const uint32_t* asset_chunk_indexes = target_version->m_AssetChunkIndexes;
+
+    for (uint32_t i = 0; i < write_asset_count; ++i)
+    {
+        uint32_t asset_index = asset_indexes[i];
+        const char* path = &name_data[name_offsets[asset_index]];
+        uint32_t chunk_count = asset_chunk_counts[asset_index];
+        uint32_t asset_chunk_offset = asset_chunk_index_starts[asset_index];
+        if (chunk_count == 0)
         {
-            if (optional_cancel_api && optional_cancel_token && optional_cancel_api->IsCancelled(optional_cancel_api, optional_cancel_token) == ECANCELED)
-            {
-                int err = ECANCELED;
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Operation cancelled, failed with %d", err)
-                return err;
-            }
+            struct Longtail_BlockChunkWriteInfo chunk_write_info;
+            chunk_write_info.ChunkIndex = 0;
+            chunk_write_info.AssetIndex = asset_index;
+            chunk_write_info.Offset = 0;
+
+            arrput(block_write_infos->m_ZeroSizeWriteInfoArray, chunk_write_info);
+            continue;
         }
-        uint32_t asset_index = version_diff->m_TargetAddedAssetIndexes[i];
-        const char* asset_path = &target_version->m_NameData[target_version->m_NameOffsets[asset_index]];
-        if (!IsDirPath(asset_path))
+        uint64_t file_offset = 0;
+        for (uint32_t chunk_offset = 0; chunk_offset < chunk_count; ++chunk_offset)
         {
-            char* full_path = version_storage_api->ConcatPath(version_storage_api, version_path, asset_path);
-            uint16_t permissions = (uint16_t)target_version->m_Permissions[asset_index];
-            int err = version_storage_api->SetPermissions(version_storage_api, full_path, permissions);
-            if (err)
+            uint32_t chunk_index = asset_chunk_indexes[asset_chunk_offset + chunk_offset];
+            TLongtail_Hash chunk_hash = chunk_hashes[chunk_index];
+            uint32_t* local_chunk_source = chunk_hash_to_local_chunk ? LongtailPrivate_LookupTable_Get(chunk_hash_to_local_chunk, chunk_hash) : 0;
+            if (local_chunk_source)
             {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->SetPermissions() failed for `%s` with %d", full_path, err)
-                Longtail_Free(full_path);
+                TLocalChunkWriteArray* local_write_info = &block_write_infos->m_LocalWritesArrays[local_chunk_asset_indexes[*local_chunk_source]];
+
+                struct Longtail_LocalChunkWriteInfo chunk_write_info;
+                chunk_write_info.ChunkIndex = chunk_index;
+                chunk_write_info.AssetIndex = asset_index;
+                chunk_write_info.Offset = file_offset;
+                chunk_write_info.SourceOffset = local_chunk_offsets[*local_chunk_source];
+
+                arrput(*local_write_info, chunk_write_info);
+
+                file_offset += target_version->m_ChunkSizes[chunk_index];
+                continue;
+            }
+            uint32_t* content_block_index = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, chunk_hash);
+            if (content_block_index == 0)
+            {
+                err = ENOENT;
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", err)
+                SAVE_FREE_BLOCK_WRITE_INFOS(block_write_infos);
+                Longtail_Free(work_mem);
                 return err;
             }
-            Longtail_Free(full_path);
+            LONGTAIL_MONTITOR_BLOCK_PREPARE(store_index, *content_block_index);
+            TBlockChunkWriteArray* block_write_info = &block_write_infos->m_BlockWritesArrays[*content_block_index];
+
+            struct Longtail_BlockChunkWriteInfo chunk_write_info;
+            chunk_write_info.ChunkIndex = chunk_index;
+            chunk_write_info.AssetIndex = asset_index;
+            chunk_write_info.Offset = file_offset;
+
+            arrput(*block_write_info, chunk_write_info);
+
+            file_offset += target_version->m_ChunkSizes[chunk_index];
         }
     }
+    Longtail_Free(work_mem);
+    work_mem = 0;
 
+    *out_block_write_infos = block_write_infos;
     return 0;
 }
 
-int Longtail_ChangeVersion(
+int Longtail_ChangeVersion2(
     struct Longtail_BlockStoreAPI* block_store_api,
     struct Longtail_StorageAPI* version_storage_api,
+    struct Longtail_ConcurrentChunkWriteAPI* concurrent_chunk_write_api,
     struct Longtail_HashAPI* hash_api,
     struct Longtail_JobAPI* job_api,
     struct Longtail_ProgressAPI* progress_api,
@@ -8024,10 +13056,46 @@ int Longtail_ChangeVersion(
     const struct Longtail_VersionDiff* version_diff,
     const char* version_path,
     int retain_permissions)
+{
+    return Longtail_ChangeVersion3(
+        block_store_api,
+        version_storage_api,
+        concurrent_chunk_write_api,
+        hash_api,
+        job_api,
+        progress_api,
+        optional_cancel_api,
+        optional_cancel_token,
+        store_index,
+        source_version,
+        target_version,
+        version_diff,
+        version_path,
+        retain_permissions,
+        0);
+}
+
+int Longtail_ChangeVersion3(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    struct Longtail_StorageAPI* version_storage_api,
+    struct Longtail_ConcurrentChunkWriteAPI* concurrent_chunk_write_api,
+    struct Longtail_HashAPI* hash_api,
+    struct Longtail_JobAPI* job_api,
+    struct Longtail_ProgressAPI* progress_api,
+    struct Longtail_CancelAPI* optional_cancel_api,
+    Longtail_CancelAPI_HCancelToken optional_cancel_token,
+    const struct Longtail_StoreIndex* store_index,
+    const struct Longtail_VersionIndex* source_version,
+    const struct Longtail_VersionIndex* target_version,
+    const struct Longtail_VersionDiff* version_diff,
+    const char* version_path,
+    int retain_permissions,
+    int use_local_chunks)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(block_store_api, "%p"),
         LONGTAIL_LOGFIELD(version_storage_api, "%p"),
+        LONGTAIL_LOGFIELD(concurrent_chunk_write_api, "%p"),
         LONGTAIL_LOGFIELD(hash_api, "%p"),
         LONGTAIL_LOGFIELD(job_api, "%p"),
         LONGTAIL_LOGFIELD(progress_api, "%p"),
@@ -8038,7 +13106,8 @@ int Longtail_ChangeVersion(
         LONGTAIL_LOGFIELD(target_version, "%p"),
         LONGTAIL_LOGFIELD(version_diff, "%p"),
         LONGTAIL_LOGFIELD(version_path, "%s"),
-        LONGTAIL_LOGFIELD(retain_permissions, "%d")
+        LONGTAIL_LOGFIELD(retain_permissions, "%d"),
+        LONGTAIL_LOGFIELD(use_local_chunks, "%d")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
     LONGTAIL_VALIDATE_INPUT(ctx, block_store_api != 0, return EINVAL)
@@ -8068,1727 +13137,2468 @@ int Longtail_ChangeVersion(
         return err;
     }
 
-    err = CleanUpRemoveAssets(version_storage_api, optional_cancel_api, optional_cancel_token, source_version, version_diff, version_path);
-    if (err != 0)
+    struct Longtail_BlockWriteInfos* block_write_infos = 0;
+    err = CreateBlockWriteInfos(
+        target_version,
+        version_diff,
+        store_index,
+        use_local_chunks ? source_version : 0,
+        &block_write_infos);
+    if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CleanUpRemoveAssets() failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateBlockWriteInfos failed with %d", err)
         return err;
     }
 
-    uint32_t added_count = *version_diff->m_TargetAddedCount;
-    uint32_t modified_content_count = *version_diff->m_ModifiedContentCount;
-    uint32_t write_asset_count = added_count + modified_content_count;
+    uint32_t fetch_block_count = 0;
+    uint32_t local_source_count = 0;
+    if (block_write_infos != 0)
+    {
+        for (uint32_t b = 0; b < block_write_infos->m_BlockCount; ++b)
+        {
+            fetch_block_count += arrlen(block_write_infos->m_BlockWritesArrays[b]) > 0 ? 1 : 0;
+        }
+        for (uint32_t a = 0; a < block_write_infos->m_LocalAssetCount; ++a)
+        {
+            local_source_count += arrlen(block_write_infos->m_LocalWritesArrays[a]) > 0 ? 1 : 0;
+        }
+    }
 
-    LONGTAIL_FATAL_ASSERT(ctx, write_asset_count <= *target_version->m_AssetCount, return EINVAL);
-    if (write_asset_count > 0)
+    int use_staging = use_local_chunks || (*version_diff->m_MovedCount > 0);
+    size_t source_asset_is_staged_size = use_staging ? (sizeof(uint8_t) * *source_version->m_AssetCount) : 0;
+    size_t preflight_block_hashes_size = use_local_chunks ? (sizeof(TLongtail_Hash) * fetch_block_count) : 0;
+    void* local_mem = 0;
+    TLongtail_Hash* preflight_block_hashes = 0;
+    uint8_t* source_asset_is_staged = 0;
+    char* staging_path = 0;
+    if (use_staging)
     {
-        uint32_t chunk_count = (uint32_t)*store_index->m_ChunkCount;
-        size_t chunk_hash_to_block_index_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
-        size_t asset_indexes_size = sizeof(uint32_t) * write_asset_count;
-        size_t work_mem_size = chunk_hash_to_block_index_size + asset_indexes_size;
+        local_mem = Longtail_Alloc("ChangeVersion2", preflight_block_hashes_size + source_asset_is_staged_size + 1);
+        if (!local_mem)
+        {
+            err = ENOMEM;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", err)
+            SAVE_FREE_BLOCK_WRITE_INFOS(block_write_infos);
+            return err;
+        }
+        preflight_block_hashes = (TLongtail_Hash*)local_mem;
+        source_asset_is_staged = (uint8_t*)local_mem + preflight_block_hashes_size;
+        memset(source_asset_is_staged, 0, source_asset_is_staged_size);
+    }
 
-        void* work_mem = Longtail_Alloc("ChangeVersion", work_mem_size);
-        if (!work_mem)
+    if (use_local_chunks)
+    {
+        // Only ask for the blocks we can not find chunks for on disk
+        uint32_t preflight_block_count = 0;
+        for (uint32_t b = 0; block_write_infos && b < block_write_infos->m_BlockCount; ++b)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-            return ENOMEM;
+            if (arrlen(block_write_infos->m_BlockWritesArrays[b]) > 0)
+            {
+                preflight_block_hashes[preflight_block_count++] = store_index->m_BlockHashes[b];
+            }
         }
+        err = block_store_api->PreflightGet(block_store_api, preflight_block_count, preflight_block_hashes, 0);
+    }
+    else
+    {
+        err = block_store_api->PreflightGet(block_store_api, *store_index->m_BlockCount, store_index->m_BlockHashes, 0);
+    }
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_store_api->PreflightGet() failed with %d", err)
+        Longtail_Free(local_mem);
+        SAVE_FREE_BLOCK_WRITE_INFOS(block_write_infos);
+        return err;
+    }
 
-        char* p = (char*)work_mem;
-        struct Longtail_LookupTable* chunk_hash_to_block_index = LongtailPrivate_LookupTable_Create(p, chunk_count, 0);
-        p += chunk_hash_to_block_index_size;
-        uint32_t* asset_indexes = (uint32_t*)p;
+    if (local_source_count > 0)
+    {
+        err = StageLocalChunkSources(version_storage_api, source_version, version_diff, block_write_infos, version_path, source_asset_is_staged, &staging_path);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "StageLocalChunkSources() failed with %d", err)
+        }
+    }
 
-        uint32_t block_count = *store_index->m_BlockCount;
-        for (uint32_t b = 0; b < block_count; ++b)
+    if (err == 0)
+    {
+        err = StageMovedAssets(version_storage_api, source_version, version_diff, version_path, source_asset_is_staged, &staging_path);
+        if (err)
         {
-            uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
-            uint32_t chunk_index_offset = store_index->m_BlockChunksOffsets[b];
-            for (uint32_t c = 0; c < block_chunk_count; ++c)
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "StageMovedAssets() failed with %d", err)
+        }
+    }
+
+    if (err == 0)
+    {
+        err = CleanUpRemoveAssets(version_storage_api, optional_cancel_api, optional_cancel_token, source_version, version_diff, version_path);
+        if (err != 0)
         {
-                uint32_t chunk_index = chunk_index_offset + c;
-                TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_index];
-                LongtailPrivate_LookupTable_PutUnique(chunk_hash_to_block_index, chunk_hash, b);
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CleanUpRemoveAssets() failed with %d", err)
+        }
+    }
+
+    if (err == 0 && staging_path)
+    {
+        err = ApplyMovedAssets(version_storage_api, source_version, target_version, version_diff, version_path, source_asset_is_staged, staging_path);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ApplyMovedAssets() failed with %d", err)
+        }
+    }
+
+    if (err == 0)
+    {
+        err = concurrent_chunk_write_api->Flush(concurrent_chunk_write_api);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Flush failed with %d", err)
+        }
+    }
+
+    if (err == 0 && block_write_infos != 0)
+    {
+        err = CreateTargetDirectories(job_api, optional_cancel_api, optional_cancel_token, concurrent_chunk_write_api, target_version, block_write_infos);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "CreateTargetDirectories() failed with %d", err)
+        }
+    }
+
+    if (err == 0 && block_write_infos != 0)
+    {
+        ptrdiff_t zero_size_job_count = (arrlen(block_write_infos->m_ZeroSizeWriteInfoArray) > 0) ? 1 : 0;
+        size_t job_count = zero_size_job_count + local_source_count + fetch_block_count;
+        if (job_count > 0)
+        {
+            size_t job_mem_size =
+                sizeof(struct ContentBlock2Job) * fetch_block_count +
+                sizeof(struct LocalChunkWriteJob) * local_source_count +
+                sizeof(Longtail_JobAPI_JobFunc) * job_count +
+                sizeof(void*) * job_count;
+            void* job_mem = Longtail_Alloc("ChangeVersion2", job_mem_size);
+            if (job_mem == 0)
+            {
+                err = ENOMEM;
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", err)
+            }
+            else
+            {
+                uint8_t* job_mem_ptr = (uint8_t*)job_mem;
+                struct ContentBlock2Job* jobs = (struct ContentBlock2Job*)job_mem_ptr;
+                job_mem_ptr += sizeof(struct ContentBlock2Job) * fetch_block_count;
+                struct LocalChunkWriteJob* local_jobs = (struct LocalChunkWriteJob*)job_mem_ptr;
+                job_mem_ptr += sizeof(struct LocalChunkWriteJob) * local_source_count;
+                Longtail_JobAPI_JobFunc* job_funcs = (Longtail_JobAPI_JobFunc*)job_mem_ptr;
+                job_mem_ptr += sizeof(Longtail_JobAPI_JobFunc) * job_count;
+                void** job_ctxs = (void**)job_mem_ptr;
+
+                struct ContentBlock2JobContext context;
+                context.m_StoreIndex = store_index;
+                context.m_VersionIndex = target_version;
+                context.m_BlockWriteInfos = block_write_infos;
+                context.m_BlockStoreAPI = block_store_api;
+                context.m_ConcurrentChunkWriteApi = concurrent_chunk_write_api;
+                context.m_JobAPI = job_api;
+                context.m_VersionPath = version_path;
+                context.m_VersionStorageAPI = version_storage_api;
+                context.m_SourceVersionIndex = source_version;
+                context.m_SourceAssetIsStaged = source_asset_is_staged;
+                context.m_StagingPath = staging_path;
+                context.m_HashAPI = hash_api;
+
+                size_t job_index = 0;
+                if (zero_size_job_count)
+                {
+                    job_funcs[job_index] = WriteNonBlockAssetsJob;
+                    job_ctxs[job_index] = &context;
+                    ++job_index;
+                }
+
+                // Local copies are queued first, they don't wait for any downloads
+                uint32_t local_job_index = 0;
+                for (uint32_t a = 0; a < block_write_infos->m_LocalAssetCount; ++a)
+                {
+                    if (arrlen(block_write_infos->m_LocalWritesArrays[a]) == 0)
+                    {
+                        continue;
+                    }
+                    struct LocalChunkWriteJob* local_job = &local_jobs[local_job_index++];
+                    local_job->m_Context = &context;
+                    local_job->m_SourceAssetIndex = a;
+                    local_job->m_FallbackWrites = 0;
+
+                    job_funcs[job_index] = WriteLocalChunksJob;
+                    job_ctxs[job_index] = local_job;
+                    ++job_index;
+                }
+
+                uint32_t block_job_index = 0;
+                for (uint32_t b = 0; b < block_write_infos->m_BlockCount; ++b)
+                {
+                    if (arrlen(block_write_infos->m_BlockWritesArrays[b]) == 0)
+                    {
+                        continue;
+                    }
+                    struct ContentBlock2Job* job = &jobs[block_job_index++];
+                    job->m_AsyncCompleteAPI.m_API.Dispose = 0;
+                    job->m_AsyncCompleteAPI.OnComplete = 0;
+                    job->m_Context = &context;
+                    job->m_BlockIndex = b;
+                    job->m_StoredBlock = 0;
+                    job->m_JobID = 0;
+
+                    job_funcs[job_index] = WriteContentBlock2Job;
+                    job_ctxs[job_index] = job;
+                    ++job_index;
+                }
+
+                uint32_t jobs_submitted = 0;
+                err = Longtail_RunJobsBatched(
+                    job_api,
+                    progress_api,
+                    optional_cancel_api,
+                    optional_cancel_token,
+                    (uint32_t)job_count,
+                    job_funcs,
+                    job_ctxs,
+                    &jobs_submitted);
+                if (err)
+                {
+                    LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "Longtail_RunJobsBatched() failed with %d", err)
+                }
+                if (err == 0 && local_source_count > 0)
+                {
+                    err = WriteLocalChunkFallbacks(
+                        &context,
+                        progress_api,
+                        optional_cancel_api,
+                        optional_cancel_token,
+                        local_jobs,
+                        local_source_count);
+                    if (err)
+                    {
+                        LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "WriteLocalChunkFallbacks() failed with %d", err)
+                    }
+                }
+                for (uint32_t l = 0; l < local_source_count; ++l)
+                {
+                    arrfree(local_jobs[l].m_FallbackWrites);
+                }
+                Longtail_Free(job_mem);
+                job_mem = 0;
             }
         }
 
-        for (uint32_t i = 0; i < added_count; ++i)
-        {
-            asset_indexes[i] = version_diff->m_TargetAddedAssetIndexes[i];
-        }
-        for (uint32_t i = 0; i < modified_content_count; ++i)
+        if (err == 0)
         {
-            asset_indexes[added_count + i] = version_diff->m_TargetContentModifiedAssetIndexes[i];
+            err = concurrent_chunk_write_api->Flush(concurrent_chunk_write_api);
+            if (err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Flush() failed with %d", err)
+            }
         }
+    }
+    SAVE_FREE_BLOCK_WRITE_INFOS(block_write_infos);
 
-        struct AssetWriteList* awl;
-        err = BuildAssetWriteList(
-            write_asset_count,
-            asset_indexes,
-            target_version->m_NameOffsets,
-            target_version->m_NameData,
-            target_version->m_ChunkHashes,
-            target_version->m_AssetChunkCounts,
-            target_version->m_AssetChunkIndexStarts,
-            target_version->m_AssetChunkIndexes,
-            chunk_hash_to_block_index,
-            &awl);
-
+    if (staging_path)
+    {
         if (err)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "BuildAssetWriteList() failed with %d", err)
-            Longtail_Free(work_mem);
-            return err;
+            RestoreStagedAssets(version_storage_api, source_version, source_asset_is_staged, version_path, staging_path);
         }
-
-        err = WriteAssets(
-            block_store_api,
-            version_storage_api,
-            job_api,
-            progress_api,
-            optional_cancel_api,
-            optional_cancel_token,
-            store_index,
-            target_version,
-            version_path,
-            chunk_hash_to_block_index,
-            awl,
-            retain_permissions);
-
-        Longtail_Free(awl);
-        awl = 0;
-
-        if (err)
+        else
         {
-            LONGTAIL_LOG(ctx, err == ECANCELED ?  LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "WriteAssets() failed with %d", err)
-            Longtail_Free(work_mem);
-            return err;
+            RemoveStagedAssets(version_storage_api, source_version, source_asset_is_staged, staging_path);
         }
+        Longtail_Free(staging_path);
+        staging_path = 0;
+    }
+    Longtail_Free(local_mem);
+    local_mem = 0;
 
-        Longtail_Free(work_mem);
-        work_mem = 0;
+    if (err)
+    {
+        return err;
     }
 
-    if (err == 0 && retain_permissions)
+    if (retain_permissions)
     {
         err = RetainPermissions(version_storage_api, optional_cancel_api, optional_cancel_token, target_version, version_diff, version_path);
         if (err)
         {
             LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "RetainPermissions() failed with %d", err)
+            (void)concurrent_chunk_write_api->Flush(concurrent_chunk_write_api);
+            return err;
         }
     }
-
-    return err;
+    return 0;
 }
 
-
-struct Longtail_BlockChunkWriteInfo
+size_t Longtail_GetStoreIndexDataSize(uint32_t block_count, uint32_t chunk_count)
 {
-    uint32_t ChunkIndex;
-    uint32_t AssetIndex;
-    uint64_t Offset;
-};
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 
-typedef struct Longtail_BlockChunkWriteInfo* TBlockChunkWriteArray;
+    return
+        sizeof(uint32_t) +                          // m_Version
+        sizeof(uint32_t) +                          // m_HashIdentifier
+        sizeof(uint32_t) +                          // m_BlockCount
+        sizeof(uint32_t) +                          // m_ChunkCount
+        (sizeof(TLongtail_Hash) * block_count) +    // m_BlockHashes
+        (sizeof(TLongtail_Hash) * chunk_count) +    // m_ChunkHashes
+        (sizeof(uint32_t) * block_count) +          // m_BlockChunksOffsets
+        (sizeof(uint32_t) * block_count) +          // m_BlockChunkCounts
+        (sizeof(uint32_t) * block_count) +          // m_BlockTags
+        (sizeof(uint32_t) * chunk_count);           // m_ChunkSizes
+}
 
-struct Longtail_BlockWriteInfos
+struct Longtail_StoreIndex* Longtail_InitStoreIndex(void* mem, uint32_t block_count, uint32_t chunk_count)
 {
-    TBlockChunkWriteArray* m_BlockWritesArrays;
-    uint32_t m_BlockCount;
-    TBlockChunkWriteArray m_ZeroSizeWriteInfoArray;
-};
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(mem, "%p"),
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 
-struct ContentBlock2JobContext
-{
-    const struct Longtail_StoreIndex* m_StoreIndex;
-    const struct Longtail_VersionIndex* m_VersionIndex;
-    const struct Longtail_BlockWriteInfos* m_BlockWriteInfos;
-    struct Longtail_BlockStoreAPI* m_BlockStoreAPI;
-    struct Longtail_ConcurrentChunkWriteAPI* m_ConcurrentChunkWriteApi;
-    struct Longtail_JobAPI* m_JobAPI;
-    const char* m_VersionPath;
-};
+    LONGTAIL_VALIDATE_INPUT(ctx, mem != 0, return 0)
 
-struct ContentBlock2Job
+    struct Longtail_StoreIndex* store_index = (struct Longtail_StoreIndex*)mem;
+    char* p = (char*)&store_index[1];
+
+    store_index->m_Version = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    store_index->m_HashIdentifier = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    store_index->m_BlockCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    store_index->m_ChunkCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    store_index->m_BlockHashes = (TLongtail_Hash*)(void*)p;
+    p += sizeof(TLongtail_Hash) * block_count;
+
+    store_index->m_ChunkHashes = (TLongtail_Hash*)(void*)p;
+    p += sizeof(TLongtail_Hash) * chunk_count;
+
+    store_index->m_BlockChunksOffsets = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * block_count;
+
+    store_index->m_BlockChunkCounts = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * block_count;
+
+    store_index->m_BlockTags = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * block_count;
+
+    store_index->m_ChunkSizes = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * chunk_count;
+
+    return store_index;
+}
+
+static int InitStoreIndexFromData(
+    struct Longtail_StoreIndex* store_index,
+    void* data,
+    uint64_t data_size)
 {
-    struct Longtail_AsyncGetStoredBlockAPI m_AsyncCompleteAPI;
-    const struct ContentBlock2JobContext* m_Context;
-    uint32_t m_BlockIndex;
-    struct Longtail_StoredBlock* m_StoredBlock;
-    int m_GetStoredBlockErr;
-    uint32_t m_JobID;
-};
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(data, "%p"),
+        LONGTAIL_LOGFIELD(data_size, "%" PRIu64)
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 
-static SORTFUNC(SortBlockChunkWriteInfo)
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, data != 0, return EINVAL)
+
+    if (data_size < (4 * sizeof(uint32_t)))
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Store index is invalid, not big enough for minimal header. Size %" PRIu64 " < %" PRIu64 "", data_size, (4 * sizeof(uint32_t)));
+        return EBADF;
+    }
+
+    char* p = (char*)data;
+
+    store_index->m_Version = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    if (*store_index->m_Version != Longtail_CurrentStoreIndexVersion)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Mismatching versions in store index data %" PRIu64 " != %" PRIu64 "", (void*)store_index->m_Version, Longtail_CurrentStoreIndexVersion);
+        return EBADF;
+    }
+
+    store_index->m_HashIdentifier = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    store_index->m_BlockCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    store_index->m_ChunkCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    uint32_t block_count = *store_index->m_BlockCount;
+    uint32_t chunk_count = *store_index->m_ChunkCount;
+
+    size_t store_index_data_size = Longtail_GetStoreIndexDataSize(block_count, chunk_count);
+    if (store_index_data_size > data_size)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Store index data is truncated: %" PRIu64 " <= %" PRIu64, data_size, store_index_data_size)
+        return EBADF;
+    }
+
+    store_index->m_BlockHashes = (TLongtail_Hash*)(void*)p;
+    p += sizeof(TLongtail_Hash) * block_count;
+
+    store_index->m_ChunkHashes = (TLongtail_Hash*)(void*)p;
+    p += sizeof(TLongtail_Hash) * chunk_count;
+
+    store_index->m_BlockChunksOffsets = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * block_count;
+
+    store_index->m_BlockChunkCounts = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * block_count;
+
+    store_index->m_BlockTags = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * block_count;
+
+    store_index->m_ChunkSizes = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * chunk_count;
+
+    return 0;
+}
+
+size_t Longtail_GetStoreIndexSize(uint32_t block_count, uint32_t chunk_count)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(context, "%p"),
-        LONGTAIL_LOGFIELD(a_ptr, "%p"),
-        LONGTAIL_LOGFIELD(b_ptr, "%p")
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(chunk_count, "%u")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
 
-    LONGTAIL_FATAL_ASSERT(ctx, context == 0, return 0)
-    LONGTAIL_FATAL_ASSERT(ctx, a_ptr != 0, return 0)
-    LONGTAIL_FATAL_ASSERT(ctx, b_ptr != 0, return 0)
+    size_t store_index_size =
+        sizeof(struct Longtail_StoreIndex) +
+        Longtail_GetStoreIndexDataSize(block_count, chunk_count);
+
+    return store_index_size;
+}
+
+int Longtail_CreateStoreIndexFromBlocks(
+    uint32_t block_count,
+    const struct Longtail_BlockIndex** block_indexes,
+    struct Longtail_StoreIndex** out_store_index)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(block_indexes, "%p"),
+        LONGTAIL_LOGFIELD(out_store_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, block_count == 0 || block_indexes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
 
-    const struct Longtail_BlockChunkWriteInfo* a = (const struct Longtail_BlockChunkWriteInfo*)a_ptr;
-    const struct Longtail_BlockChunkWriteInfo* b = (const struct Longtail_BlockChunkWriteInfo*)b_ptr;
-    if (a->AssetIndex < b->AssetIndex)
-    {
-        return -1;
-    }
-    if (a->AssetIndex > b->AssetIndex)
-    {
-        return 1;
-    }
-    if (a->Offset < b->Offset)
+    uint32_t hash_identifier = 0;
+
+    uint32_t chunk_count = 0;
+    for (uint32_t b = 0; b < block_count; ++b)
     {
-        return -1;
+        const struct Longtail_BlockIndex* block_index = block_indexes[b];
+        hash_identifier = (hash_identifier == 0) ? *block_index->m_HashIdentifier : hash_identifier;
+        chunk_count += *block_index->m_ChunkCount;
     }
-    if (a->Offset > b->Offset)
+    size_t store_index_size = Longtail_GetStoreIndexSize(block_count, chunk_count);
+    void* store_index_mem = (struct Longtail_StoreIndex*)Longtail_Alloc("CreateStoreIndexFromBlocks", store_index_size);
+    if (!store_index_mem)
     {
-        return 1;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
     }
-    if (a->ChunkIndex < b->ChunkIndex)
+    struct Longtail_StoreIndex* store_index = Longtail_InitStoreIndex(
+        store_index_mem,
+        block_count,
+        chunk_count);
+    if (!store_index)
     {
-        return -1;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitStoreIndex() failed with %d", ENOMEM)
+        return ENOMEM;
     }
-    if (a->ChunkIndex > b->ChunkIndex)
+
+    *store_index->m_Version = Longtail_CurrentStoreIndexVersion;
+    *store_index->m_HashIdentifier = hash_identifier;
+    *store_index->m_BlockCount = block_count;
+    *store_index->m_ChunkCount = chunk_count;
+    uint32_t c = 0;
+
+    for (uint32_t b = 0; b < block_count; ++b)
     {
-        return 1;
+        const struct Longtail_BlockIndex* block_index = block_indexes[b];
+        uint32_t block_chunk_count = *block_index->m_ChunkCount;
+        store_index->m_BlockHashes[b] = *block_index->m_BlockHash;
+        store_index->m_BlockTags[b] = *block_index->m_Tag;
+        store_index->m_BlockChunkCounts[b] = block_chunk_count;
+        store_index->m_BlockChunksOffsets[b] = c;
+        memcpy(&store_index->m_ChunkHashes[c], block_index->m_ChunkHashes, sizeof(TLongtail_Hash) * block_chunk_count);
+        memcpy(&store_index->m_ChunkSizes[c], block_index->m_ChunkSizes, sizeof(uint32_t) * block_chunk_count);
+        c += block_chunk_count;
     }
+
+    *out_store_index = store_index;
     return 0;
 }
 
-static void WriteContentBlock2GetStoredBlockComplete(struct Longtail_AsyncGetStoredBlockAPI* async_complete_api, struct Longtail_StoredBlock* stored_block, int err)
+int Longtail_MakeBlockIndex(
+    const struct Longtail_StoreIndex* store_index,
+    uint32_t block_index,
+    struct Longtail_BlockIndex* out_block_index)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
-        LONGTAIL_LOGFIELD(stored_block, "%p"),
-        LONGTAIL_LOGFIELD(err, "%d")
-        MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(block_index, "%u"),
+        LONGTAIL_LOGFIELD(out_block_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    if (err)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "WriteContentBlock2GetStoredBlockComplete() failed with %d", err)
-    }
-    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api != 0, return)
-    struct ContentBlock2Job* job = (struct ContentBlock2Job*)async_complete_api;
-    LONGTAIL_FATAL_ASSERT(ctx, job->m_AsyncCompleteAPI.OnComplete != 0, return);
-    LONGTAIL_MONTITOR_BLOCK_LOADED(job->m_Context->m_StoreIndex, job->m_BlockIndex, err);
-    job->m_GetStoredBlockErr = err;
-    job->m_StoredBlock = stored_block;
-    job->m_Context->m_JobAPI->ResumeJob(job->m_Context->m_JobAPI, job->m_JobID);
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, block_index < (*store_index->m_BlockCount), return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    uint32_t block_chunks_offset = store_index->m_BlockChunksOffsets[block_index];
+    out_block_index->m_BlockHash = &store_index->m_BlockHashes[block_index];
+    out_block_index->m_HashIdentifier = store_index->m_HashIdentifier;
+    out_block_index->m_ChunkCount = &store_index->m_BlockChunkCounts[block_index];
+    out_block_index->m_Tag = &store_index->m_BlockTags[block_index];
+    out_block_index->m_ChunkHashes = &store_index->m_ChunkHashes[block_chunks_offset];
+    out_block_index->m_ChunkSizes = &store_index->m_ChunkSizes[block_chunks_offset];
+    return 0;
 }
 
-static int WriteNonBlockAssetsJob(void* context, uint32_t job_id, int detected_error)
+int Longtail_MergeStoreIndex(
+    const struct Longtail_StoreIndex* local_store_index,
+    const struct Longtail_StoreIndex* remote_store_index,
+    struct Longtail_StoreIndex** out_store_index)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(context, "%p"),
-        LONGTAIL_LOGFIELD(job_id, "%u"),
-        LONGTAIL_LOGFIELD(detected_error, "%d")
-        MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
-
-    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return EINVAL)
+        LONGTAIL_LOGFIELD(local_store_index, "%p"),
+        LONGTAIL_LOGFIELD(remote_store_index, "%p"),
+        LONGTAIL_LOGFIELD(out_store_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    struct ContentBlock2JobContext* job = (struct ContentBlock2JobContext*)context;
+    LONGTAIL_VALIDATE_INPUT(ctx, local_store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, local_store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
 
-    if (detected_error)
+    uint32_t local_block_count = *local_store_index->m_BlockCount;
+    uint32_t remote_block_count = *remote_store_index->m_BlockCount;
+    uint32_t hash_identifier = 0;
+    if (local_block_count == 0)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "WriteNonBlockAssetsJob aborted due to previous error %d", detected_error)
-        return 0;
+        if (remote_block_count == 0)
+        {
+            return Longtail_CreateStoreIndexFromBlocks(0, 0, out_store_index);
+        }
+        hash_identifier = *remote_store_index->m_HashIdentifier;
     }
-
-    TBlockChunkWriteArray block_write_infos = job->m_BlockWriteInfos->m_ZeroSizeWriteInfoArray;
-    ptrdiff_t block_write_chunk_info_count = arrlen(block_write_infos);
-    for (ptrdiff_t block_write_chunk_info_index = 0; block_write_chunk_info_index < block_write_chunk_info_count; ++block_write_chunk_info_index)
+    else
     {
-        const TBlockChunkWriteArray block_chunk_write_info = &block_write_infos[block_write_chunk_info_index];
-        const uint32_t asset_index = block_chunk_write_info->AssetIndex;
-        const char* asset_path = &job->m_VersionIndex->m_NameData[job->m_VersionIndex->m_NameOffsets[asset_index]];
-        if (IsDirPath(asset_path))
+        hash_identifier = *local_store_index->m_HashIdentifier;
+        if (remote_block_count != 0)
         {
-            int err = job->m_ConcurrentChunkWriteApi->CreateDir(job->m_ConcurrentChunkWriteApi, asset_index);
-            if (err)
+            if (hash_identifier != *remote_store_index->m_HashIdentifier)
             {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "job->m_ConcurrentChunkWriteApi->CreateDir() failed with %d", err)
-                LONGTAIL_MONTITOR_ASSET_OPEN(job->m_VersionIndex, asset_index, err);
-                return err;
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_MergeStoreIndex(), store indexes has conflicting hash identifier, failed with %d", EINVAL)
+                return EINVAL;
             }
         }
-        else
+    }
+    size_t local_block_hash_to_index_size = LongtailPrivate_LookupTable_GetSize(local_block_count);
+    size_t remote_block_hash_to_index_size = LongtailPrivate_LookupTable_GetSize(remote_block_count);
+    size_t block_hashes_size = sizeof(TLongtail_Hash) * ((size_t)local_block_count + (size_t)remote_block_count);
+    size_t work_mem_size = local_block_hash_to_index_size + remote_block_hash_to_index_size + block_hashes_size;
+
+    void* work_mem = Longtail_Alloc("MergeStoreIndex", work_mem_size);
+    if (!work_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+
+    char* p = (char*)work_mem;
+    struct Longtail_LookupTable* local_block_hash_to_index = LongtailPrivate_LookupTable_Create(p, local_block_count, 0);
+    p += local_block_hash_to_index_size;
+    struct Longtail_LookupTable* remote_block_hash_to_index = LongtailPrivate_LookupTable_Create(p, remote_block_count, 0);
+    p += remote_block_hash_to_index_size;
+    TLongtail_Hash* block_hashes = (TLongtail_Hash*)p;
+
+    uint32_t unique_block_count = 0;
+    uint32_t chunk_count = 0;
+    for (uint32_t local_block = 0; local_block < local_block_count; ++local_block)
+    {
+        TLongtail_Hash block_hash = local_store_index->m_BlockHashes[local_block];
+        if (LongtailPrivate_LookupTable_PutUnique(local_block_hash_to_index, block_hash, local_block))
         {
-            int err = job->m_ConcurrentChunkWriteApi->Open(job->m_ConcurrentChunkWriteApi, asset_index);
-            if (err)
-            {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "m_ConcurrentChunkWriteApi->Open() failed with %d", err)
-                return err;
-            }
-            LONGTAIL_MONTITOR_ASSET_OPEN(job->m_VersionIndex, asset_index, err);
-            job->m_ConcurrentChunkWriteApi->Close(job->m_ConcurrentChunkWriteApi, asset_index);
+            continue;
         }
-        LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_VersionIndex, asset_index);
+        block_hashes[unique_block_count] = block_hash;
+        ++unique_block_count;
+        chunk_count += local_store_index->m_BlockChunkCounts[local_block];
+    }
+    for (uint32_t remote_block = 0; remote_block < remote_block_count; ++remote_block)
+    {
+        TLongtail_Hash block_hash = remote_store_index->m_BlockHashes[remote_block];
+        if (LongtailPrivate_LookupTable_Get(local_block_hash_to_index, block_hash))
+        {
+            continue;
+        }
+        if (LongtailPrivate_LookupTable_PutUnique(remote_block_hash_to_index, block_hash, remote_block))
+        {
+            continue;
+        }
+        block_hashes[unique_block_count] = block_hash;
+        ++unique_block_count;
+        chunk_count += remote_store_index->m_BlockChunkCounts[remote_block];
+    }
+
+    size_t merged_block_store_index_size = Longtail_GetStoreIndexSize(unique_block_count, chunk_count);
+    void* merged_block_store_index_mem = Longtail_Alloc("MergeStoreIndex", merged_block_store_index_size);
+    if (!merged_block_store_index_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(work_mem);
+        return ENOMEM;
+    }
+    struct Longtail_StoreIndex* merged_store_index = Longtail_InitStoreIndex(merged_block_store_index_mem, unique_block_count, chunk_count);
+    *merged_store_index->m_Version = Longtail_CurrentStoreIndexVersion;
+    *merged_store_index->m_HashIdentifier = hash_identifier;
+    *merged_store_index->m_BlockCount = unique_block_count;
+    *merged_store_index->m_ChunkCount = chunk_count;
+    uint32_t chunk_index_offset = 0;
+    const struct Longtail_StoreIndex* source_index = local_store_index;
+    struct Longtail_LookupTable* source_lookup_table = local_block_hash_to_index;
+    for (uint32_t b = 0; b < unique_block_count; ++b)
+    {
+        TLongtail_Hash block_hash = block_hashes[b];
+        uint32_t* index_ptr = LongtailPrivate_LookupTable_Get(source_lookup_table, block_hash);
+        if (!index_ptr)
+        {
+            // When block is no longer found in local_store_index, switch over to remote_store_index
+            LONGTAIL_FATAL_ASSERT(ctx, source_index != remote_store_index, return EINVAL)
+            source_index = remote_store_index;
+            source_lookup_table = remote_block_hash_to_index;
+            index_ptr = LongtailPrivate_LookupTable_Get(source_lookup_table, block_hash);
+            LONGTAIL_FATAL_ASSERT(ctx, index_ptr, return EINVAL)
+        }
+        uint32_t source_block = *index_ptr;
+        uint32_t block_chunk_count = source_index->m_BlockChunkCounts[source_block];
+        merged_store_index->m_BlockTags[b] = source_index->m_BlockTags[source_block];
+        uint32_t block_chunk_offset = source_index->m_BlockChunksOffsets[source_block];
+        const TLongtail_Hash* local_chunk_hashes = &source_index->m_ChunkHashes[block_chunk_offset];
+        const uint32_t* local_chunk_sizes = &source_index->m_ChunkSizes[block_chunk_offset];
+
+        merged_store_index->m_BlockHashes[b] = block_hash;
+        merged_store_index->m_BlockChunkCounts[b] = block_chunk_count;
+        merged_store_index->m_BlockChunksOffsets[b] = chunk_index_offset;
+        TLongtail_Hash* merged_chunk_hashes = &merged_store_index->m_ChunkHashes[chunk_index_offset];
+        memcpy(merged_chunk_hashes, local_chunk_hashes, sizeof(TLongtail_Hash) * block_chunk_count);
+        uint32_t* merged_chunk_sizes = &merged_store_index->m_ChunkSizes[chunk_index_offset];
+        memcpy(merged_chunk_sizes, local_chunk_sizes, sizeof(uint32_t) * block_chunk_count);
+        chunk_index_offset += block_chunk_count;
     }
+    Longtail_Free(work_mem);
+    *out_store_index = merged_store_index;
     return 0;
 }
 
-static int WriteContentBlock2Job(void* context, uint32_t job_id, int detected_error)
+LONGTAIL_EXPORT int Longtail_PruneStoreIndex(
+    const struct Longtail_StoreIndex* source_store_index,
+    uint32_t keep_block_count,
+    const TLongtail_Hash* keep_block_hashes,
+    struct Longtail_StoreIndex** out_store_index)
 {
-#if defined(LONGTAIL_ASSERTS)
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(context, "%p"),
-        LONGTAIL_LOGFIELD(job_id, "%u"),
-        LONGTAIL_LOGFIELD(detected_error, "%d")
-        MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-#else
-    struct Longtail_LogContextFmt_Private* ctx = 0;
-#endif // defined(LONGTAIL_ASSERTS)
-
-    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return EINVAL)
-
-    struct ContentBlock2Job* job = (struct ContentBlock2Job*)context;
-
-    if (detected_error)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "WriteContentBlock2Job aborted due to previous error %d", detected_error)
-        SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
-        return 0;
-    }
-
-    uint32_t block_index = job->m_BlockIndex;
-    TLongtail_Hash block_hash = job->m_Context->m_StoreIndex->m_BlockHashes[block_index];
-
-    if (job->m_AsyncCompleteAPI.OnComplete == 0)
-    {
-        LONGTAIL_FATAL_ASSERT(ctx, job->m_StoredBlock == 0, return EINVAL)
-        job->m_JobID = job_id;
-        job->m_AsyncCompleteAPI.OnComplete = WriteContentBlock2GetStoredBlockComplete;
-
-        LONGTAIL_MONTITOR_BLOCK_LOAD(job->m_Context->m_StoreIndex, block_index);
-        int err = job->m_Context->m_BlockStoreAPI->GetStoredBlock(job->m_Context->m_BlockStoreAPI, block_hash, &job->m_AsyncCompleteAPI);
-        if (err == 0)
-        {
-            return EBUSY;
-        }
-        else
-        {
-            LONGTAIL_MONTITOR_BLOCK_LOADED(job->m_Context->m_StoreIndex, block_index, err);
-            return err;
-        }
-    }
+        LONGTAIL_LOGFIELD(source_store_index, "%p"),
+        LONGTAIL_LOGFIELD(keep_block_count, "%u"),
+        LONGTAIL_LOGFIELD(keep_block_hashes, "%p"),
+        LONGTAIL_LOGFIELD(out_store_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    if (job->m_GetStoredBlockErr != 0)
-    {
-        return job->m_GetStoredBlockErr;
-    }
+    LONGTAIL_VALIDATE_INPUT(ctx, source_store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, (keep_block_count == 0) || (keep_block_hashes != 0), return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
 
-    LONGTAIL_FATAL_ASSERT(ctx, job->m_StoredBlock != 0, return EINVAL)
-    struct Longtail_StoredBlock* stored_block = job->m_StoredBlock;
+    uint32_t store_block_count = *source_store_index->m_BlockCount;
+    uint32_t store_chunk_count = *source_store_index->m_ChunkCount;
+    size_t keep_block_hash_lookup_size = LongtailPrivate_LookupTable_GetSize(keep_block_count);
+    size_t block_hashes_size = sizeof(TLongtail_Hash) * store_block_count;
+    size_t chunk_hashes_size = sizeof(TLongtail_Hash) * store_chunk_count;
+    size_t block_chunks_offsets_size = sizeof(uint32_t) * store_block_count;
+    size_t block_chunks_counts_size = sizeof(uint32_t) * store_block_count;
+    size_t block_tags_size = sizeof(uint32_t) * store_block_count;
+    size_t chunk_sizes_size = sizeof(uint32_t) * store_chunk_count;
 
-    uint32_t chunk_count = *stored_block->m_BlockIndex->m_ChunkCount;
-    size_t chunk_hash_to_chunk_index_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
-    size_t chunk_offsets_size = sizeof(uint32_t) * chunk_count;
+    size_t work_mem_size = keep_block_hash_lookup_size +
+        block_hashes_size +
+        chunk_hashes_size +
+        block_chunks_offsets_size +
+        block_chunks_counts_size +
+        block_tags_size +
+        chunk_sizes_size;
 
-    size_t work_mem_size = chunk_hash_to_chunk_index_size + chunk_offsets_size;
-    void* work_mem = Longtail_Alloc("WriteContentBlock2Job", work_mem_size);
+    void* work_mem = Longtail_Alloc("PruneStoreIndex", work_mem_size);
     if (!work_mem)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
-        LONGTAIL_MONTITOR_BLOCK_COMPLETE(job->m_Context->m_StoreIndex, block_index, ENOMEM);
         return ENOMEM;
     }
-    uint8_t* data_ptr = (uint8_t*)work_mem;
 
-    struct Longtail_LookupTable* chunk_hash_to_chunk_index = LongtailPrivate_LookupTable_Create(data_ptr, chunk_count, 0);
-    data_ptr += chunk_hash_to_chunk_index_size;
-    uint32_t* chunk_offsets_in_block = (uint32_t*)data_ptr;
+    char* p = (char*)work_mem;
+    struct Longtail_LookupTable* keep_block_hash_lookup = LongtailPrivate_LookupTable_Create(p, keep_block_count, 0);
+    p += keep_block_hash_lookup_size;
 
-    uint32_t chunk_offset = 0;
-    for (uint32_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
-    {
-        uint32_t* existing_ptr = LongtailPrivate_LookupTable_PutUnique(chunk_hash_to_chunk_index, stored_block->m_BlockIndex->m_ChunkHashes[chunk_index], chunk_index);
-        LONGTAIL_FATAL_ASSERT(ctx, !existing_ptr, return EINVAL)
-        chunk_offsets_in_block[chunk_index] = chunk_offset;
-        chunk_offset += stored_block->m_BlockIndex->m_ChunkSizes[chunk_index];
-    }
+    TLongtail_Hash* block_hashes = (TLongtail_Hash*)p;
+    p += block_hashes_size;
 
-    const uint8_t* block_data = (const uint8_t*)stored_block->m_BlockData;
+    TLongtail_Hash* chunk_hashes = (TLongtail_Hash*)p;
+    p += chunk_hashes_size;
 
-    int asset_is_open = 0;
-    uint32_t last_asset_index = 0;
+    uint32_t* block_chunks_offsets = (uint32_t*)p;
+    p += block_chunks_offsets_size;
 
-    TBlockChunkWriteArray write_infos = job->m_Context->m_BlockWriteInfos->m_BlockWritesArrays[block_index];
-    ptrdiff_t block_write_chunk_info_count = arrlen(write_infos);
+    uint32_t* block_chunks_counts = (uint32_t*)p;
+    p += block_chunks_counts_size;
 
-    QSORT(write_infos, block_write_chunk_info_count, sizeof(struct Longtail_BlockChunkWriteInfo), SortBlockChunkWriteInfo, 0);
+    uint32_t* block_tags = (uint32_t*)p;
+    p += block_tags_size;
 
-    ptrdiff_t block_write_chunk_info_index = 0;
-    while (block_write_chunk_info_index < block_write_chunk_info_count)
-    {
-        const TBlockChunkWriteArray block_chunk_write_info = &write_infos[block_write_chunk_info_index];
-        const uint32_t asset_index = block_chunk_write_info->AssetIndex;
-        const char* asset_path = &job->m_Context->m_VersionIndex->m_NameData[job->m_Context->m_VersionIndex->m_NameOffsets[asset_index]];
+    uint32_t* chunk_sizes = (uint32_t*)p;
+    p += chunk_sizes_size;
 
-        if (asset_is_open)
+    for (uint32_t keep_block = 0; keep_block < keep_block_count; ++keep_block)
+    {
+        TLongtail_Hash block_hash = keep_block_hashes[keep_block];
+        if (LongtailPrivate_LookupTable_PutUnique(keep_block_hash_lookup, block_hash, keep_block))
         {
-            if (last_asset_index != asset_index)
-            {
-                job->m_Context->m_ConcurrentChunkWriteApi->Close(job->m_Context->m_ConcurrentChunkWriteApi, last_asset_index);
-                asset_is_open = 0;
-            }
+            continue;
         }
+    }
 
-        if (asset_is_open == 0)
+    uint32_t block_count = 0;
+    uint32_t chunk_count = 0;
+    for (uint32_t block = 0; block < store_block_count; ++block)
+    {
+        TLongtail_Hash block_hash = source_store_index->m_BlockHashes[block];
+        if (!LongtailPrivate_LookupTable_Get(keep_block_hash_lookup, block_hash))
         {
-            uint32_t asset_chunk_count = job->m_Context->m_VersionIndex->m_AssetChunkCounts[asset_index];
-            int err = job->m_Context->m_ConcurrentChunkWriteApi->Open(job->m_Context->m_ConcurrentChunkWriteApi, asset_index);
-            if (err)
-            {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Open() failed for `%s` with %d", asset_path, err)
-                LONGTAIL_MONTITOR_ASSET_OPEN(job->m_Context->m_VersionIndex, asset_index, err);
-                Longtail_Free(work_mem);
-                SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
-                LONGTAIL_MONTITOR_BLOCK_COMPLETE(job->m_Context->m_StoreIndex, job->m_BlockIndex, err);
-                return err;
-            }
-            last_asset_index = asset_index;
-            asset_is_open = 1;
+            continue;
         }
+        uint32_t block_chunk_count = source_store_index->m_BlockChunkCounts[block];
+        uint32_t chunk_offset = source_store_index->m_BlockChunksOffsets[block];
 
-        uint32_t chunk_index = block_chunk_write_info->ChunkIndex;
-        TLongtail_Hash chunk_hash = job->m_Context->m_VersionIndex->m_ChunkHashes[chunk_index];
-        uint32_t* chunk_index_in_block_ptr = LongtailPrivate_LookupTable_Get(chunk_hash_to_chunk_index, chunk_hash);
-        if (chunk_index_in_block_ptr == 0)
+        block_hashes[block_count] = block_hash;
+        block_tags[block_count] = source_store_index->m_BlockTags[block];
+        block_chunks_offsets[block_count] = chunk_count;
+        block_chunks_counts[block_count] = block_chunk_count;
+        for (uint32_t chunk = 0; chunk < block_chunk_count; ++chunk)
         {
-            job->m_Context->m_ConcurrentChunkWriteApi->Close(job->m_Context->m_ConcurrentChunkWriteApi, asset_index);
-            asset_is_open = 0;
-            LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_Context->m_VersionIndex, asset_index);
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to find chunk in block for `%s` with %d", asset_path, ENOENT)
-            Longtail_Free(work_mem);
-            SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
-            LONGTAIL_MONTITOR_BLOCK_COMPLETE(job->m_Context->m_StoreIndex, job->m_BlockIndex, ENOENT);
-            return ENOENT;
+            chunk_hashes[chunk_count + chunk] = source_store_index->m_ChunkHashes[chunk_offset + chunk];
+            chunk_sizes[chunk_count + chunk] = source_store_index->m_ChunkSizes[chunk_offset + chunk];
         }
 
-        uint32_t chunk_index_in_block = *chunk_index_in_block_ptr;
-        uint32_t chunk_size = stored_block->m_BlockIndex->m_ChunkSizes[chunk_index_in_block];
-        uint32_t chunk_offset_in_block = chunk_offsets_in_block[chunk_index_in_block];
-        LONGTAIL_MONTITOR_CHUNK_READ(job->m_Context->m_StoreIndex, job->m_Context->m_VersionIndex, block_index, chunk_index, chunk_index_in_block, 0);
-
-        uint32_t chunk_run_count = 1;
-        uint32_t chunk_run_size = chunk_size;
-        while (block_write_chunk_info_index + chunk_run_count < block_write_chunk_info_count)
-        {
-            const TBlockChunkWriteArray block_chunk_write_info_next = &write_infos[block_write_chunk_info_index + chunk_run_count];
-            if (block_chunk_write_info_next->AssetIndex != asset_index)
-            {
-                break;
-            }
-            if (block_chunk_write_info_next->Offset != (block_chunk_write_info->Offset + chunk_run_size))
-            {
-                break;
-            }
-            uint32_t chunk_index_next = block_chunk_write_info_next->ChunkIndex;
-            TLongtail_Hash chunk_hash_next = job->m_Context->m_VersionIndex->m_ChunkHashes[chunk_index_next];
-            uint32_t* chunk_index_in_block_ptr_next = LongtailPrivate_LookupTable_Get(chunk_hash_to_chunk_index, chunk_hash_next);
-            if (chunk_index_in_block_ptr_next == 0)
-            {
-                job->m_Context->m_ConcurrentChunkWriteApi->Close(job->m_Context->m_ConcurrentChunkWriteApi, asset_index);
-                asset_is_open = 0;
-                LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_Context->m_VersionIndex, asset_index);
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to find chunk in block for `%s` with %d", asset_path, ENOENT)
-                Longtail_Free(work_mem);
-                SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
-                LONGTAIL_MONTITOR_BLOCK_COMPLETE(job->m_Context->m_StoreIndex, job->m_BlockIndex, ENOENT);
-                return ENOENT;
-            }
-            uint32_t chunk_index_in_block_next = *chunk_index_in_block_ptr_next;
-            if (chunk_index_in_block_next != chunk_index_in_block + chunk_run_count)
-            {
-                break;
-            }
-            uint32_t chunk_size_next = stored_block->m_BlockIndex->m_ChunkSizes[chunk_index_in_block_next];
-            LONGTAIL_MONTITOR_CHUNK_READ(job->m_Context->m_StoreIndex, job->m_Context->m_VersionIndex, block_index, chunk_index_next, chunk_index_in_block_next, 0);
-
-            chunk_run_size += chunk_size_next;
-            chunk_run_count++;
-        }
+        chunk_count += block_chunk_count;
+        block_count++;
+    }
 
-        int err = job->m_Context->m_ConcurrentChunkWriteApi->Write(job->m_Context->m_ConcurrentChunkWriteApi, asset_index, block_chunk_write_info->Offset, chunk_run_size, &block_data[chunk_offset_in_block]);
-        LONGTAIL_MONTITOR_ASSET_WRITE(job->m_Context->m_StoreIndex, job->m_Context->m_VersionIndex, asset_index, block_chunk_write_info->Offset, chunk_run_size, chunk_index, chunk_index_in_block, chunk_run_count, block_index, chunk_offset_in_block, err);
-        if (err)
-        {
-            job->m_Context->m_ConcurrentChunkWriteApi->Close(job->m_Context->m_ConcurrentChunkWriteApi, asset_index);
-            asset_is_open = 0;
-            LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_Context->m_VersionIndex, asset_index);
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Write() failed for `%s` with %d", asset_path, err)
-            Longtail_Free(work_mem);
-            SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
-            LONGTAIL_MONTITOR_BLOCK_COMPLETE(job->m_Context->m_StoreIndex, job->m_BlockIndex, err);
-            return err;
-        }
-        block_write_chunk_info_index += chunk_run_count;
+    size_t store_index_size = Longtail_GetStoreIndexSize(block_count, chunk_count);
+    void* store_index_mem = (struct Longtail_StoreIndex*)Longtail_Alloc("PruneStoreIndex", store_index_size);
+    if (!store_index_mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(work_mem);
+        return ENOMEM;
     }
-    if (asset_is_open != 0)
+    struct Longtail_StoreIndex* store_index = Longtail_InitStoreIndex(
+        store_index_mem,
+        block_count,
+        chunk_count);
+    if (!store_index)
     {
-        job->m_Context->m_ConcurrentChunkWriteApi->Close(job->m_Context->m_ConcurrentChunkWriteApi, last_asset_index);
-        asset_is_open = 0;
-        LONGTAIL_MONTITOR_ASSET_CLOSE(job->m_Context->m_VersionIndex, last_asset_index);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitStoreIndex() failed with %d", ENOMEM)
+        Longtail_Free(work_mem);
+        return ENOMEM;
     }
 
+    *store_index->m_Version = Longtail_CurrentStoreIndexVersion;
+    *store_index->m_HashIdentifier = *source_store_index->m_HashIdentifier;
+    *store_index->m_BlockCount = block_count;
+    *store_index->m_ChunkCount = chunk_count;
+
+    memcpy(store_index->m_BlockHashes, block_hashes, sizeof(TLongtail_Hash) * block_count);
+    memcpy(store_index->m_ChunkHashes, chunk_hashes, sizeof(TLongtail_Hash) * chunk_count);
+    memcpy(store_index->m_BlockChunksOffsets, block_chunks_offsets, sizeof(uint32_t) * block_count);
+    memcpy(store_index->m_BlockChunkCounts, block_chunks_counts, sizeof(uint32_t) * block_count);
+    memcpy(store_index->m_BlockTags, block_tags, sizeof(uint32_t) * block_count);
+    memcpy(store_index->m_ChunkSizes, chunk_sizes, sizeof(uint32_t) * chunk_count);
+
     Longtail_Free(work_mem);
-    SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
-    LONGTAIL_MONTITOR_BLOCK_COMPLETE(job->m_Context->m_StoreIndex, job->m_BlockIndex, 0);
-    job->m_Context->m_ConcurrentChunkWriteApi->Flush(job->m_Context->m_ConcurrentChunkWriteApi);
+
+    *out_store_index = store_index;
     return 0;
 }
 
-static void FreeBlockWriteInfos(struct Longtail_BlockWriteInfos* block_write_infos)
+struct CompactStoreContext
 {
-    for (ptrdiff_t i = 0; i < block_write_infos->m_BlockCount; ++i)
-    {
-        arrfree(block_write_infos->m_BlockWritesArrays[i]);
-    }
-    arrfree(block_write_infos->m_ZeroSizeWriteInfoArray);
-    Longtail_Free(block_write_infos);
-}
+    struct Longtail_BlockStoreAPI* m_BlockStoreAPI;
+    struct Longtail_JobAPI* m_JobAPI;
+    const struct Longtail_StoreIndex* m_SourceStoreIndex;
+    const struct Longtail_StoreIndex* m_CompactStoreIndex;
+    struct Longtail_LookupTable* m_RepackChunkLookup;
+    const uint32_t* m_RepackSourceBlocks;
+    const uint32_t* m_RepackSourceChunks;
+    const uint32_t* m_RepackSourceOffsets;
+};
 
-#define SAVE_FREE_BLOCK_WRITE_INFOS(i) if (i) {FreeBlockWriteInfos(i); i = 0;}
+struct CompactBlockJob;
 
-static int CreateBlockWriteInfos(
-    const struct Longtail_VersionIndex* target_version,
-    const struct Longtail_VersionDiff* version_diff,
-    const struct Longtail_StoreIndex* store_index,
-    struct Longtail_BlockWriteInfos** out_block_write_infos)
+struct CompactBlockGetComplete
 {
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(store_index, "%p"),
-        LONGTAIL_LOGFIELD(target_version, "%p"),
-        LONGTAIL_LOGFIELD(version_diff, "%p")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+    struct Longtail_AsyncGetStoredBlockAPI m_API;
+    struct CompactBlockJob* m_Job;
+};
 
-    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, target_version != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_diff != 0, return EINVAL)
+struct CompactBlockPutComplete
+{
+    struct Longtail_AsyncPutStoredBlockAPI m_API;
+    struct CompactBlockJob* m_Job;
+};
 
-    uint32_t added_count = *version_diff->m_TargetAddedCount;
-    uint32_t modified_content_count = *version_diff->m_ModifiedContentCount;
-    uint32_t write_asset_count = added_count + modified_content_count;
+struct CompactBlockJob
+{
+    struct CompactBlockGetComplete m_GetComplete;
+    struct CompactBlockPutComplete m_PutComplete;
+    const struct CompactStoreContext* m_Context;
+    uint32_t m_JobID;
+    uint32_t m_BlockIndex;
+    uint32_t m_NextChunk;
+    struct Longtail_StoredBlock* m_SourceBlock;
+    struct Longtail_StoredBlock* m_StoredBlock;
+    int m_Err;
+};
 
-    if (write_asset_count == 0)
+static void CompactBlockGetOnComplete(struct Longtail_AsyncGetStoredBlockAPI* async_complete_api, struct Longtail_StoredBlock* stored_block, int err)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(stored_block, "%p"),
+        LONGTAIL_LOGFIELD(err, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    if (err)
     {
-        return 0;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompactBlockGetOnComplete() failed with %d", err)
     }
+    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api != 0, return)
+    struct CompactBlockJob* job = ((struct CompactBlockGetComplete*)async_complete_api)->m_Job;
+    LONGTAIL_FATAL_ASSERT(ctx, job->m_GetComplete.m_API.OnComplete != 0, return);
+    job->m_SourceBlock = stored_block;
+    job->m_Err = err;
+    job->m_Context->m_JobAPI->ResumeJob(job->m_Context->m_JobAPI, job->m_JobID);
+}
 
-    int err = 0;
-
-    uint32_t chunk_count = *store_index->m_ChunkCount;
-    uint32_t block_count = *store_index->m_BlockCount;
+static void CompactBlockPutOnComplete(struct Longtail_AsyncPutStoredBlockAPI* async_complete_api, int err)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(async_complete_api, "%p"),
+        LONGTAIL_LOGFIELD(err, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
 
-    size_t block_write_infos_size = sizeof(struct Longtail_BlockWriteInfos) + sizeof(TBlockChunkWriteArray) * (block_count);
-    void* block_write_infos_mem = Longtail_Alloc("ChangeVersion2", block_write_infos_size);
-    if (!block_write_infos_mem)
-    {
-        err = ENOMEM;
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", err)
-        return err;
-    }
-    struct Longtail_BlockWriteInfos* block_write_infos = (struct Longtail_BlockWriteInfos*)block_write_infos_mem;
-    block_write_infos->m_BlockCount = block_count;
-    if (block_count > 0)
+    if (err)
     {
-        block_write_infos->m_BlockWritesArrays = (TBlockChunkWriteArray*)&block_write_infos[1];
-        memset(block_write_infos->m_BlockWritesArrays, 0, sizeof(TBlockChunkWriteArray) * block_count);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompactBlockPutOnComplete() caller failed with %d", err)
     }
-    else
+    LONGTAIL_FATAL_ASSERT(ctx, async_complete_api != 0, return)
+    struct CompactBlockJob* job = ((struct CompactBlockPutComplete*)async_complete_api)->m_Job;
+    LONGTAIL_FATAL_ASSERT(ctx, job->m_PutComplete.m_API.OnComplete != 0, return);
+    SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+    job->m_Err = err;
+    job->m_Context->m_JobAPI->ResumeJob(job->m_Context->m_JobAPI, job->m_JobID);
+}
+
+// Builds one compacted block. The live chunks are copied from one source block at a time so a running
+// job holds at most the block being built plus one fetched source block.
+static int CompactBlockJob(void* context, uint32_t job_id, int detected_error)
+{
+#if defined(LONGTAIL_ASSERTS)
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(context, "%p"),
+        LONGTAIL_LOGFIELD(job_id, "%u"),
+        LONGTAIL_LOGFIELD(detected_error, "%d")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+#else
+    struct Longtail_LogContextFmt_Private* ctx = 0;
+#endif // defined(LONGTAIL_ASSERTS)
+
+    LONGTAIL_FATAL_ASSERT(ctx, context != 0, return EINVAL)
+
+    struct CompactBlockJob* job = (struct CompactBlockJob*)context;
+    const struct CompactStoreContext* compact_context = job->m_Context;
+    const struct Longtail_StoreIndex* source_store_index = compact_context->m_SourceStoreIndex;
+    const struct Longtail_StoreIndex* compact_store_index = compact_context->m_CompactStoreIndex;
+
+    if (detected_error)
     {
-        block_write_infos->m_BlockWritesArrays = 0;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "CompactBlockJob aborted due to previous error %d", detected_error)
+        SAFE_DISPOSE_STORED_BLOCK(job->m_SourceBlock);
+        SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+        return 0;
     }
-    block_write_infos->m_ZeroSizeWriteInfoArray = 0;
 
-    size_t chunk_hash_to_block_index_size = LongtailPrivate_LookupTable_GetSize(chunk_count);
-    size_t asset_indexes_size = sizeof(uint32_t) * write_asset_count;
-    size_t work_mem_size = chunk_hash_to_block_index_size + asset_indexes_size;
-    void* work_mem = Longtail_Alloc("ChangeVersion2", work_mem_size);
-    if (!work_mem)
+    if (job->m_PutComplete.m_API.OnComplete)
     {
-        err = ENOMEM;
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", err)
-        SAVE_FREE_BLOCK_WRITE_INFOS(block_write_infos);
-        return err;
+        // We got a notification so we are complete
+        job->m_PutComplete.m_API.OnComplete = 0;
+        return job->m_Err;
     }
-    uint8_t* work_mem_ptr = (uint8_t*)work_mem;
-
-    struct Longtail_LookupTable* chunk_hash_to_block_index = LongtailPrivate_LookupTable_Create(work_mem_ptr, chunk_count, 0);
-    work_mem_ptr += chunk_hash_to_block_index_size;
 
-    uint32_t* asset_indexes = (uint32_t*)work_mem_ptr;
+    uint32_t chunk_count = compact_store_index->m_BlockChunkCounts[job->m_BlockIndex];
+    uint32_t first_chunk_index = compact_store_index->m_BlockChunksOffsets[job->m_BlockIndex];
 
-    for (uint32_t b = 0; b < block_count; ++b)
+    if (job->m_StoredBlock == 0)
     {
-        LONGTAIL_MONTITOR_BLOCK_PREPARE(store_index, b);
-        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
-        uint32_t chunk_index_offset = store_index->m_BlockChunksOffsets[b];
-        for (uint32_t c = 0; c < block_chunk_count; ++c)
+        uint32_t block_data_size = 0;
+        for (uint32_t chunk_index = first_chunk_index; chunk_index < first_chunk_index + chunk_count; ++chunk_index)
         {
-            uint32_t chunk_index = chunk_index_offset + c;
-            TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_index];
-            LongtailPrivate_LookupTable_PutUnique(chunk_hash_to_block_index, chunk_hash, b);
+            block_data_size += compact_store_index->m_ChunkSizes[chunk_index];
         }
-    }
 
-    for (uint32_t i = 0; i < added_count; ++i)
-    {
-        asset_indexes[i] = version_diff->m_TargetAddedAssetIndexes[i];
-    }
-    for (uint32_t i = 0; i < modified_content_count; ++i)
-    {
-        asset_indexes[added_count + i] = version_diff->m_TargetContentModifiedAssetIndexes[i];
-    }
+        size_t block_index_size = Longtail_GetBlockIndexSize(chunk_count);
+        size_t stored_block_size = sizeof(struct Longtail_StoredBlock);
+        size_t put_block_mem_size =
+            stored_block_size +
+            block_index_size +
+            block_data_size;
 
-    uint32_t* name_offsets = target_version->m_NameOffsets;
-    const char* name_data = target_version->m_NameData;
-    const TLongtail_Hash* chunk_hashes = target_version->m_ChunkHashes;
-    const TLongtail_Hash* block_hashes = store_index->m_BlockHashes;
-    const uint32_t* asset_chunk_counts = target_version->m_AssetChunkCounts;
-    const uint32_t* asset_chunk_index_starts = target_version->m_AssetChunkIndexStarts;
-    const uint32_t* asset_chunk_indexes = target_version->m_AssetChunkIndexes;
+        void* put_block_mem = Longtail_Alloc("CompactBlockJob", put_block_mem_size);
+        if (!put_block_mem)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM);
+            return ENOMEM;
+        }
 
-    for (uint32_t i = 0; i < write_asset_count; ++i)
+        char* p = (char*)put_block_mem;
+        struct Longtail_StoredBlock* stored_block = (struct Longtail_StoredBlock*)p;
+        p += stored_block_size;
+        struct Longtail_BlockIndex* block_index_ptr = (struct Longtail_BlockIndex*)p;
+        p += block_index_size;
+
+        Longtail_InitBlockIndex(block_index_ptr, chunk_count);
+        memmove(block_index_ptr->m_ChunkHashes, &compact_store_index->m_ChunkHashes[first_chunk_index], sizeof(TLongtail_Hash) * chunk_count);
+        memmove(block_index_ptr->m_ChunkSizes, &compact_store_index->m_ChunkSizes[first_chunk_index], sizeof(uint32_t) * chunk_count);
+        *block_index_ptr->m_BlockHash = compact_store_index->m_BlockHashes[job->m_BlockIndex];
+        *block_index_ptr->m_HashIdentifier = *compact_store_index->m_HashIdentifier;
+        *block_index_ptr->m_Tag = compact_store_index->m_BlockTags[job->m_BlockIndex];
+        *block_index_ptr->m_ChunkCount = chunk_count;
+        stored_block->Dispose = DisposePutBlock;
+        stored_block->m_BlockIndex = block_index_ptr;
+        stored_block->m_BlockData = p;
+        stored_block->m_BlockChunksDataSize = block_data_size;
+        job->m_StoredBlock = stored_block;
+        job->m_NextChunk = 0;
+    }
+
+    if (job->m_GetComplete.m_API.OnComplete)
     {
-        uint32_t asset_index = asset_indexes[i];
-        const char* path = &name_data[name_offsets[asset_index]];
-        uint32_t chunk_count = asset_chunk_counts[asset_index];
-        uint32_t asset_chunk_offset = asset_chunk_index_starts[asset_index];
-        if (chunk_count == 0)
+        job->m_GetComplete.m_API.OnComplete = 0;
+        if (job->m_Err)
         {
-            struct Longtail_BlockChunkWriteInfo chunk_write_info;
-            chunk_write_info.ChunkIndex = 0;
-            chunk_write_info.AssetIndex = asset_index;
-            chunk_write_info.Offset = 0;
+            SAFE_DISPOSE_STORED_BLOCK(job->m_SourceBlock);
+            SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+            return job->m_Err;
+        }
+        LONGTAIL_FATAL_ASSERT(ctx, job->m_SourceBlock != 0, return EINVAL);
 
-            arrput(block_write_infos->m_ZeroSizeWriteInfoArray, chunk_write_info);
-            continue;
+        // Copy the run of chunks that comes from the fetched source block
+        const struct Longtail_BlockIndex* source_block_index = job->m_SourceBlock->m_BlockIndex;
+        const char* source_data = (const char*)job->m_SourceBlock->m_BlockData;
+        uint32_t source_chunk_count = *source_block_index->m_ChunkCount;
+        uint32_t source_block = 0xffffffffu;
+        uint32_t write_offset = 0;
+        for (uint32_t chunk_index = 0; chunk_index < job->m_NextChunk; ++chunk_index)
+        {
+            write_offset += compact_store_index->m_ChunkSizes[first_chunk_index + chunk_index];
         }
-        uint64_t file_offset = 0;
-        for (uint32_t chunk_offset = 0; chunk_offset < chunk_count; ++chunk_offset)
+        while (job->m_NextChunk < chunk_count)
         {
-            uint32_t chunk_index = asset_chunk_indexes[asset_chunk_offset + chunk_offset];
-            TLongtail_Hash chunk_hash = chunk_hashes[chunk_index];
-            uint32_t* content_block_index = LongtailPrivate_LookupTable_Get(chunk_hash_to_block_index, chunk_hash);
-            if (content_block_index == 0)
+            uint32_t chunk_index = first_chunk_index + job->m_NextChunk;
+            TLongtail_Hash chunk_hash = compact_store_index->m_ChunkHashes[chunk_index];
+            uint32_t chunk_size = compact_store_index->m_ChunkSizes[chunk_index];
+            const uint32_t* repack_index = LongtailPrivate_LookupTable_Get(compact_context->m_RepackChunkLookup, chunk_hash);
+            LONGTAIL_FATAL_ASSERT(ctx, repack_index != 0, return EINVAL);
+            uint32_t chunk_source_block = compact_context->m_RepackSourceBlocks[*repack_index];
+            if (source_block == 0xffffffffu)
             {
-                err = ENOENT;
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "LongtailPrivate_LookupTable_Get() failed with %d", err)
-                SAVE_FREE_BLOCK_WRITE_INFOS(block_write_infos);
-                Longtail_Free(work_mem);
-                return err;
+                source_block = chunk_source_block;
             }
-            LONGTAIL_MONTITOR_BLOCK_PREPARE(store_index, *content_block_index);
-            TBlockChunkWriteArray* block_write_info = &block_write_infos->m_BlockWritesArrays[*content_block_index];
+            else if (chunk_source_block != source_block)
+            {
+                break;
+            }
+            uint32_t source_chunk = compact_context->m_RepackSourceChunks[*repack_index];
+            uint32_t source_offset = compact_context->m_RepackSourceOffsets[*repack_index];
+            if (source_chunk >= source_chunk_count ||
+                source_block_index->m_ChunkHashes[source_chunk] != chunk_hash ||
+                (uint64_t)source_offset + chunk_size > job->m_SourceBlock->m_BlockChunksDataSize)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Block 0x%" PRIx64 " does not match the store index for chunk 0x%" PRIx64 ", failed with %d",
+                    source_store_index->m_BlockHashes[source_block], chunk_hash, EBADF);
+                SAFE_DISPOSE_STORED_BLOCK(job->m_SourceBlock);
+                SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+                return EBADF;
+            }
+            memcpy(&((char*)job->m_StoredBlock->m_BlockData)[write_offset], &source_data[source_offset], chunk_size);
+            write_offset += chunk_size;
+            job->m_NextChunk++;
+        }
+        SAFE_DISPOSE_STORED_BLOCK(job->m_SourceBlock);
+    }
 
-            struct Longtail_BlockChunkWriteInfo chunk_write_info;
-            chunk_write_info.ChunkIndex = chunk_index;
-            chunk_write_info.AssetIndex = asset_index;
-            chunk_write_info.Offset = file_offset;
+    job->m_JobID = job_id;
 
-            arrput(*block_write_info, chunk_write_info);
+    if (job->m_NextChunk < chunk_count)
+    {
+        TLongtail_Hash chunk_hash = compact_store_index->m_ChunkHashes[first_chunk_index + job->m_NextChunk];
+        const uint32_t* repack_index = LongtailPrivate_LookupTable_Get(compact_context->m_RepackChunkLookup, chunk_hash);
+        LONGTAIL_FATAL_ASSERT(ctx, repack_index != 0, return EINVAL);
+        TLongtail_Hash source_block_hash = source_store_index->m_BlockHashes[compact_context->m_RepackSourceBlocks[*repack_index]];
 
-            file_offset += target_version->m_ChunkSizes[chunk_index];
+        job->m_SourceBlock = 0;
+        job->m_GetComplete.m_API.OnComplete = CompactBlockGetOnComplete;
+        int err = compact_context->m_BlockStoreAPI->GetStoredBlock(compact_context->m_BlockStoreAPI, source_block_hash, &job->m_GetComplete.m_API);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "block_store_api->GetStoredBlock() failed with %d", err)
+            job->m_GetComplete.m_API.OnComplete = 0;
+            SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+            return err;
         }
+        return EBUSY;
     }
-    Longtail_Free(work_mem);
-    work_mem = 0;
 
-    *out_block_write_infos = block_write_infos;
-    return 0;
+    job->m_PutComplete.m_API.OnComplete = CompactBlockPutOnComplete;
+    int err = compact_context->m_BlockStoreAPI->PutStoredBlock(compact_context->m_BlockStoreAPI, job->m_StoredBlock, &job->m_PutComplete.m_API);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_store_api->PutStoredBlock() failed with %d", err);
+        job->m_PutComplete.m_API.OnComplete = 0;
+        SAFE_DISPOSE_STORED_BLOCK(job->m_StoredBlock);
+        return err;
+    }
+    return EBUSY;
 }
 
-int Longtail_ChangeVersion2(
+int Longtail_CompactStore(
     struct Longtail_BlockStoreAPI* block_store_api,
-    struct Longtail_StorageAPI* version_storage_api,
-    struct Longtail_ConcurrentChunkWriteAPI* concurrent_chunk_write_api,
     struct Longtail_HashAPI* hash_api,
     struct Longtail_JobAPI* job_api,
     struct Longtail_ProgressAPI* progress_api,
     struct Longtail_CancelAPI* optional_cancel_api,
     Longtail_CancelAPI_HCancelToken optional_cancel_token,
     const struct Longtail_StoreIndex* store_index,
-    const struct Longtail_VersionIndex* source_version,
-    const struct Longtail_VersionIndex* target_version,
-    const struct Longtail_VersionDiff* version_diff,
-    const char* version_path,
-    int retain_permissions)
+    uint32_t version_index_count,
+    const struct Longtail_VersionIndex** version_indexes,
+    uint32_t min_block_usage_percent,
+    uint32_t max_block_size,
+    uint32_t max_chunks_per_block,
+    struct Longtail_StoreIndex** out_store_index)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(block_store_api, "%p"),
-        LONGTAIL_LOGFIELD(version_storage_api, "%p"),
-        LONGTAIL_LOGFIELD(concurrent_chunk_write_api, "%p"),
         LONGTAIL_LOGFIELD(hash_api, "%p"),
         LONGTAIL_LOGFIELD(job_api, "%p"),
         LONGTAIL_LOGFIELD(progress_api, "%p"),
         LONGTAIL_LOGFIELD(optional_cancel_api, "%p"),
         LONGTAIL_LOGFIELD(optional_cancel_token, "%p"),
         LONGTAIL_LOGFIELD(store_index, "%p"),
-        LONGTAIL_LOGFIELD(source_version, "%p"),
-        LONGTAIL_LOGFIELD(target_version, "%p"),
-        LONGTAIL_LOGFIELD(version_diff, "%p"),
-        LONGTAIL_LOGFIELD(version_path, "%s"),
-        LONGTAIL_LOGFIELD(retain_permissions, "%d")
+        LONGTAIL_LOGFIELD(version_index_count, "%u"),
+        LONGTAIL_LOGFIELD(version_indexes, "%p"),
+        LONGTAIL_LOGFIELD(min_block_usage_percent, "%u"),
+        LONGTAIL_LOGFIELD(max_block_size, "%u"),
+        LONGTAIL_LOGFIELD(max_chunks_per_block, "%u"),
+        LONGTAIL_LOGFIELD(out_store_index, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
     LONGTAIL_VALIDATE_INPUT(ctx, block_store_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_storage_api != 0, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, hash_api != 0, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, job_api != 0, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, source_version != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, target_version != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_diff != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_path != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, (version_index_count == 0) || (version_indexes != 0), return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, min_block_usage_percent <= 100, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
+
+    uint32_t store_block_count = *store_index->m_BlockCount;
+    uint32_t store_chunk_count = *store_index->m_ChunkCount;
 
-    int err = EnsureParentPathExists(version_storage_api, version_path);
-    if (err)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed with %d", err)
-        return err;
-    }
-    err = version_storage_api->CreateDir(version_storage_api, version_path);
-    if (err == EEXIST)
+    uint32_t live_chunk_count = 0;
+    for (uint32_t v = 0; v < version_index_count; ++v)
     {
-        err = 0;
-    }
-    if (err != 0)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "version_storage_api->CreateDir() failed with %d", err)
-        return err;
+        live_chunk_count += *version_indexes[v]->m_ChunkCount;
     }
 
-    err = block_store_api->PreflightGet(block_store_api, *store_index->m_BlockCount, store_index->m_BlockHashes, 0);
-    if (err)
+    size_t live_chunk_lookup_size = LongtailPrivate_LookupTable_GetSize(live_chunk_count);
+    size_t kept_chunk_lookup_size = LongtailPrivate_LookupTable_GetSize(store_chunk_count);
+    size_t repack_chunk_lookup_size = LongtailPrivate_LookupTable_GetSize(store_chunk_count);
+    size_t block_usage_size = sizeof(uint32_t) * store_block_count;
+    size_t keep_block_hashes_size = sizeof(TLongtail_Hash) * store_block_count;
+    size_t repack_chunk_hashes_size = sizeof(TLongtail_Hash) * store_chunk_count;
+    size_t repack_chunk_sizes_size = sizeof(uint32_t) * store_chunk_count;
+    size_t repack_chunk_tags_size = sizeof(uint32_t) * store_chunk_count;
+    size_t repack_source_blocks_size = sizeof(uint32_t) * store_chunk_count;
+    size_t repack_source_chunks_size = sizeof(uint32_t) * store_chunk_count;
+    size_t repack_source_offsets_size = sizeof(uint32_t) * store_chunk_count;
+
+    size_t work_mem_size =
+        live_chunk_lookup_size +
+        kept_chunk_lookup_size +
+        repack_chunk_lookup_size +
+        block_usage_size +
+        keep_block_hashes_size +
+        repack_chunk_hashes_size +
+        repack_chunk_sizes_size +
+        repack_chunk_tags_size +
+        repack_source_blocks_size +
+        repack_source_chunks_size +
+        repack_source_offsets_size;
+
+    void* work_mem = Longtail_Alloc("CompactStore", work_mem_size);
+    if (!work_mem)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "block_store_api->PreflightGet() failed with %d", err)
-        return err;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
     }
 
-    err = CleanUpRemoveAssets(version_storage_api, optional_cancel_api, optional_cancel_token, source_version, version_diff, version_path);
-    if (err != 0)
+    char* p = (char*)work_mem;
+    struct Longtail_LookupTable* live_chunk_lookup = LongtailPrivate_LookupTable_Create(p, live_chunk_count, 0);
+    p += live_chunk_lookup_size;
+    struct Longtail_LookupTable* kept_chunk_lookup = LongtailPrivate_LookupTable_Create(p, store_chunk_count, 0);
+    p += kept_chunk_lookup_size;
+    struct Longtail_LookupTable* repack_chunk_lookup = LongtailPrivate_LookupTable_Create(p, store_chunk_count, 0);
+    p += repack_chunk_lookup_size;
+    uint32_t* block_usage = (uint32_t*)p;
+    p += block_usage_size;
+    TLongtail_Hash* keep_block_hashes = (TLongtail_Hash*)p;
+    p += keep_block_hashes_size;
+    TLongtail_Hash* repack_chunk_hashes = (TLongtail_Hash*)p;
+    p += repack_chunk_hashes_size;
+    uint32_t* repack_chunk_sizes = (uint32_t*)p;
+    p += repack_chunk_sizes_size;
+    uint32_t* repack_chunk_tags = (uint32_t*)p;
+    p += repack_chunk_tags_size;
+    uint32_t* repack_source_blocks = (uint32_t*)p;
+    p += repack_source_blocks_size;
+    uint32_t* repack_source_chunks = (uint32_t*)p;
+    p += repack_source_chunks_size;
+    uint32_t* repack_source_offsets = (uint32_t*)p;
+    p += repack_source_offsets_size;
+
+    for (uint32_t v = 0; v < version_index_count; ++v)
+    {
+        const struct Longtail_VersionIndex* version_index = version_indexes[v];
+        uint32_t version_chunk_count = *version_index->m_ChunkCount;
+        for (uint32_t c = 0; c < version_chunk_count; ++c)
+        {
+            LongtailPrivate_LookupTable_PutUnique(live_chunk_lookup, version_index->m_ChunkHashes[c], c);
+        }
+    }
+
+    // Blocks without live chunks are dropped, blocks at or above the usage threshold are kept as is
+    // and the live chunks of the remaining blocks are repacked
+    uint32_t keep_block_count = 0;
+    for (uint32_t b = 0; b < store_block_count; ++b)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CleanUpRemoveAssets() failed with %d", err)
-        return err;
+        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
+        uint32_t chunk_offset = store_index->m_BlockChunksOffsets[b];
+        uint64_t block_size = 0;
+        uint64_t block_use = 0;
+        for (uint32_t c = 0; c < block_chunk_count; ++c)
+        {
+            uint32_t chunk_size = store_index->m_ChunkSizes[chunk_offset + c];
+            block_size += chunk_size;
+            if (LongtailPrivate_LookupTable_Get(live_chunk_lookup, store_index->m_ChunkHashes[chunk_offset + c]))
+            {
+                block_use += chunk_size;
+            }
+        }
+        block_usage[b] = block_use == 0 ? 0 : (block_size == 0 ? 100 : (uint32_t)((block_use * 100) / block_size));
+        if (block_use == 0)
+        {
+            continue;
+        }
+        if (block_usage[b] >= min_block_usage_percent)
+        {
+            keep_block_hashes[keep_block_count++] = store_index->m_BlockHashes[b];
+            for (uint32_t c = 0; c < block_chunk_count; ++c)
+            {
+                LongtailPrivate_LookupTable_PutUnique(kept_chunk_lookup, store_index->m_ChunkHashes[chunk_offset + c], b);
+            }
+        }
     }
 
-    err = concurrent_chunk_write_api->Flush(concurrent_chunk_write_api);
-    if (err)
+    uint32_t repack_chunk_count = 0;
+    for (uint32_t b = 0; b < store_block_count; ++b)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Flush failed with %d", err)
-        return err;
+        if (block_usage[b] == 0 || block_usage[b] >= min_block_usage_percent)
+        {
+            continue;
+        }
+        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
+        uint32_t chunk_offset = store_index->m_BlockChunksOffsets[b];
+        uint32_t source_offset = 0;
+        for (uint32_t c = 0; c < block_chunk_count; ++c)
+        {
+            TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_offset + c];
+            uint32_t chunk_size = store_index->m_ChunkSizes[chunk_offset + c];
+            if (LongtailPrivate_LookupTable_Get(live_chunk_lookup, chunk_hash) &&
+                LongtailPrivate_LookupTable_Get(kept_chunk_lookup, chunk_hash) == 0 &&
+                LongtailPrivate_LookupTable_PutUnique(repack_chunk_lookup, chunk_hash, repack_chunk_count) == 0)
+            {
+                repack_chunk_hashes[repack_chunk_count] = chunk_hash;
+                repack_chunk_sizes[repack_chunk_count] = chunk_size;
+                repack_chunk_tags[repack_chunk_count] = store_index->m_BlockTags[b];
+                repack_source_blocks[repack_chunk_count] = b;
+                repack_source_chunks[repack_chunk_count] = c;
+                repack_source_offsets[repack_chunk_count] = source_offset;
+                ++repack_chunk_count;
+            }
+            source_offset += chunk_size;
+        }
     }
 
-    struct Longtail_BlockWriteInfos* block_write_infos = 0;
-    err = CreateBlockWriteInfos(
-        target_version,
-        version_diff,
-        store_index,
-        &block_write_infos);
-    
+    struct Longtail_StoreIndex* compact_store_index = 0;
+    int err = Longtail_CreateStoreIndex(
+        hash_api,
+        repack_chunk_count,
+        repack_chunk_hashes,
+        repack_chunk_sizes,
+        repack_chunk_tags,
+        max_block_size,
+        max_chunks_per_block,
+        &compact_store_index);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateBlockWriteInfos failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndex() failed with %d", err)
+        Longtail_Free(work_mem);
         return err;
     }
 
-    if (block_write_infos != 0)
+    uint32_t compact_block_count = *compact_store_index->m_BlockCount;
+    if (compact_block_count > 0)
     {
-        ptrdiff_t block_write_info_count = block_write_infos->m_BlockCount;
-        ptrdiff_t zero_size_job_count = (arrlen(block_write_infos->m_ZeroSizeWriteInfoArray) > 0) ? 1 : 0;
-        size_t job_count = block_write_info_count + zero_size_job_count;
-        if (job_count > 0)
+        size_t jobs_size = sizeof(struct CompactBlockJob) * compact_block_count;
+        size_t funcs_size = sizeof(Longtail_JobAPI_JobFunc*) * compact_block_count;
+        size_t ctxs_size = sizeof(void*) * compact_block_count;
+        void* job_mem = Longtail_Alloc("CompactStore", jobs_size + funcs_size + ctxs_size);
+        if (!job_mem)
         {
-            size_t job_mem_size =
-                sizeof(struct ContentBlock2Job) * block_write_info_count +
-                sizeof(Longtail_JobAPI_JobFunc) * job_count +
-                sizeof(void*) * job_count;
-            void* job_mem = Longtail_Alloc("ChangeVersion2", job_mem_size);
-            if (job_mem == 0)
-            {
-                err = ENOMEM;
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", err)
-                SAVE_FREE_BLOCK_WRITE_INFOS(block_write_infos);
-                return err;
-            }
-            uint8_t* job_mem_ptr = (uint8_t*)job_mem;
-            struct ContentBlock2Job* jobs = (struct ContentBlock2Job*)job_mem_ptr;
-            job_mem_ptr += sizeof(struct ContentBlock2Job) * block_write_info_count;
-            Longtail_JobAPI_JobFunc* job_funcs = (Longtail_JobAPI_JobFunc*)job_mem_ptr;
-            job_mem_ptr += sizeof(Longtail_JobAPI_JobFunc) * job_count;
-            void** job_ctxs = (void**)job_mem_ptr;
-
-            struct ContentBlock2JobContext context;
-            context.m_StoreIndex = store_index;
-            context.m_VersionIndex = target_version;
-            context.m_BlockWriteInfos = block_write_infos;
-            context.m_BlockStoreAPI = block_store_api;
-            context.m_ConcurrentChunkWriteApi = concurrent_chunk_write_api;
-            context.m_JobAPI = job_api;
-            context.m_VersionPath = version_path;
-
-            if (zero_size_job_count)
-            {
-                job_funcs[0] = WriteNonBlockAssetsJob;
-                job_ctxs[0] = &context;
-            }
-
-            for (ptrdiff_t i = 0; i < block_write_info_count; ++i)
-            {
-                struct ContentBlock2Job* job = &jobs[i];
-                job->m_AsyncCompleteAPI.m_API.Dispose = 0;
-                job->m_AsyncCompleteAPI.OnComplete = 0;
-                job->m_Context = &context;
-                job->m_BlockIndex = (uint32_t)i;
-                job->m_StoredBlock = 0;
-                job->m_JobID = 0;
-
-                job_funcs[i + zero_size_job_count] = WriteContentBlock2Job;
-                job_ctxs[i + zero_size_job_count] = job;
-            }
-
-            uint32_t jobs_submitted = 0;
-            err = Longtail_RunJobsBatched(
-                job_api,
-                progress_api,
-                optional_cancel_api,
-                optional_cancel_token,
-                (uint32_t)job_count,
-                job_funcs,
-                job_ctxs,
-                &jobs_submitted);
-            if (err)
-            {
-                LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "Longtail_RunJobsBatched() failed with %d", err)
-                Longtail_Free(job_mem);
-                SAVE_FREE_BLOCK_WRITE_INFOS(block_write_infos);
-                return err;
-            }
-
-            SAVE_FREE_BLOCK_WRITE_INFOS(block_write_infos);
-            Longtail_Free(job_mem);
-            job_mem = 0;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+            Longtail_Free(compact_store_index);
+            Longtail_Free(work_mem);
+            return ENOMEM;
         }
-
-        err = concurrent_chunk_write_api->Flush(concurrent_chunk_write_api);
+        char* jp = (char*)job_mem;
+        struct CompactBlockJob* jobs = (struct CompactBlockJob*)jp;
+        jp += jobs_size;
+        Longtail_JobAPI_JobFunc* funcs = (Longtail_JobAPI_JobFunc*)jp;
+        jp += funcs_size;
+        void** ctxs = (void**)jp;
+
+        struct CompactStoreContext compact_context;
+        compact_context.m_BlockStoreAPI = block_store_api;
+        compact_context.m_JobAPI = job_api;
+        compact_context.m_SourceStoreIndex = store_index;
+        compact_context.m_CompactStoreIndex = compact_store_index;
+        compact_context.m_RepackChunkLookup = repack_chunk_lookup;
+        compact_context.m_RepackSourceBlocks = repack_source_blocks;
+        compact_context.m_RepackSourceChunks = repack_source_chunks;
+        compact_context.m_RepackSourceOffsets = repack_source_offsets;
+
+        for (uint32_t b = 0; b < compact_block_count; ++b)
+        {
+            struct CompactBlockJob* job = &jobs[b];
+            job->m_GetComplete.m_API.m_API.Dispose = 0;
+            job->m_GetComplete.m_API.OnComplete = 0;
+            job->m_GetComplete.m_Job = job;
+            job->m_PutComplete.m_API.m_API.Dispose = 0;
+            job->m_PutComplete.m_API.OnComplete = 0;
+            job->m_PutComplete.m_Job = job;
+            job->m_Context = &compact_context;
+            job->m_JobID = 0;
+            job->m_BlockIndex = b;
+            job->m_NextChunk = 0;
+            job->m_SourceBlock = 0;
+            job->m_StoredBlock = 0;
+            job->m_Err = 0;
+            funcs[b] = CompactBlockJob;
+            ctxs[b] = job;
+        }
+
+        uint32_t jobs_submitted = 0;
+        err = Longtail_RunJobsBatched(
+            job_api,
+            progress_api,
+            optional_cancel_api,
+            optional_cancel_token,
+            compact_block_count,
+            funcs,
+            ctxs,
+            &jobs_submitted);
+        Longtail_Free(job_mem);
         if (err)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Flush() failed with %d", err)
+            LONGTAIL_LOG(ctx, err == ECANCELED ? LONGTAIL_LOG_LEVEL_DEBUG : LONGTAIL_LOG_LEVEL_ERROR, "Longtail_RunJobsBatched() failed with %d", err)
+            Longtail_Free(compact_store_index);
+            Longtail_Free(work_mem);
             return err;
         }
     }
 
-    if (retain_permissions)
+    struct Longtail_StoreIndex* kept_store_index = 0;
+    err = Longtail_PruneStoreIndex(
+        store_index,
+        keep_block_count,
+        keep_block_hashes,
+        &kept_store_index);
+    Longtail_Free(work_mem);
+    if (err)
     {
-        err = RetainPermissions(version_storage_api, optional_cancel_api, optional_cancel_token, target_version, version_diff, version_path);
-        if (err)
-        {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "RetainPermissions() failed with %d", err)
-            (void)concurrent_chunk_write_api->Flush(concurrent_chunk_write_api);
-            return err;
-        }
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_PruneStoreIndex() failed with %d", err)
+        Longtail_Free(compact_store_index);
+        return err;
     }
-    return 0;
-}
-
-size_t Longtail_GetStoreIndexDataSize(uint32_t block_count, uint32_t chunk_count)
-{
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(block_count, "%u"),
-        LONGTAIL_LOGFIELD(chunk_count, "%u")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 
-    return
-        sizeof(uint32_t) +                          // m_Version
-        sizeof(uint32_t) +                          // m_HashIdentifier
-        sizeof(uint32_t) +                          // m_BlockCount
-        sizeof(uint32_t) +                          // m_ChunkCount
-        (sizeof(TLongtail_Hash) * block_count) +    // m_BlockHashes
-        (sizeof(TLongtail_Hash) * chunk_count) +    // m_ChunkHashes
-        (sizeof(uint32_t) * block_count) +          // m_BlockChunksOffsets
-        (sizeof(uint32_t) * block_count) +          // m_BlockChunkCounts
-        (sizeof(uint32_t) * block_count) +          // m_BlockTags
-        (sizeof(uint32_t) * chunk_count);           // m_ChunkSizes
+    err = Longtail_MergeStoreIndex(kept_store_index, compact_store_index, out_store_index);
+    Longtail_Free(kept_store_index);
+    Longtail_Free(compact_store_index);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_MergeStoreIndex() failed with %d", err)
+        return err;
+    }
+    return 0;
 }
 
-struct Longtail_StoreIndex* Longtail_InitStoreIndex(void* mem, uint32_t block_count, uint32_t chunk_count)
+LONGTAIL_EXPORT int Longtail_ValidateStore(
+    const struct Longtail_StoreIndex* store_index,
+    const struct Longtail_VersionIndex* version_index)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(mem, "%p"),
-        LONGTAIL_LOGFIELD(block_count, "%u"),
-        LONGTAIL_LOGFIELD(chunk_count, "%u")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(version_index, "%p"),
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, mem != 0, return 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
 
-    struct Longtail_StoreIndex* store_index = (struct Longtail_StoreIndex*)mem;
-    char* p = (char*)&store_index[1];
+    uint32_t store_index_chunk_count = (uint32_t)*store_index->m_ChunkCount;
+    struct Longtail_LookupTable* content_chunk_lookup = LongtailPrivate_LookupTable_Create(Longtail_Alloc("ValidateContent", LongtailPrivate_LookupTable_GetSize(store_index_chunk_count)), store_index_chunk_count ,0);
+    if (!content_chunk_lookup)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+       return ENOMEM;
+    }
+    for (uint32_t chunk_index = 0; chunk_index < store_index_chunk_count; ++chunk_index)
+    {
+        TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_index];
+        LongtailPrivate_LookupTable_Put(content_chunk_lookup, chunk_hash, chunk_index);
+    }
 
-    store_index->m_Version = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
+    uint32_t chunk_missing_count = 0;
+    uint32_t asset_size_mismatch_count = 0;
 
-    store_index->m_HashIdentifier = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
+    uint32_t version_index_chunk_count = *version_index->m_ChunkCount;
+    for (uint32_t chunk_index = 0; chunk_index < version_index_chunk_count; ++chunk_index)
+    {
+        TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
+        if (LongtailPrivate_LookupTable_Get(content_chunk_lookup, chunk_hash) == 0)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_ValidateStore() content index does not contain chunk 0x%" PRIx64 "",
+                chunk_hash)
+            ++chunk_missing_count;
+            continue;
+        }
+    }
 
-    store_index->m_BlockCount = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
+    uint32_t version_index_asset_count = *version_index->m_AssetCount;
+    for (uint32_t asset_index = 0; asset_index < version_index_asset_count; ++asset_index)
+    {
+        uint64_t asset_size = version_index->m_AssetSizes[asset_index];
+        uint32_t chunk_count = version_index->m_AssetChunkCounts[asset_index];
+        uint32_t first_chunk_index = version_index->m_AssetChunkIndexStarts[asset_index];
+        uint64_t asset_chunked_size = 0;
+        for (uint32_t i = 0; i < chunk_count; ++i)
+        {
+            uint32_t chunk_index = version_index->m_AssetChunkIndexes[first_chunk_index + i];
+            TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
+            uint32_t chunk_size = version_index->m_ChunkSizes[chunk_index];
+            asset_chunked_size += chunk_size;
+        }
+        const char* asset_path = &version_index->m_NameData[version_index->m_NameOffsets[asset_index]];
+        if ((asset_chunked_size != asset_size) && (!IsDirPath(asset_path)))
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "Longtail_ValidateStore() asset size for %s mismatch, accumulated chunks size: %" PRIu64 ", asset size:  %" PRIu64 "",
+                asset_path, asset_chunked_size, asset_size)
+            ++asset_size_mismatch_count;
+        }
+    }
 
-    store_index->m_ChunkCount = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
+    int err = 0;
+    if (asset_size_mismatch_count > 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "Longtail_ValidateStore() has %u assets that does not match chunk sizes",
+            asset_size_mismatch_count)
+        err = EINVAL;
+    }
 
-    store_index->m_BlockHashes = (TLongtail_Hash*)(void*)p;
-    p += sizeof(TLongtail_Hash) * block_count;
+    if (chunk_missing_count > 0)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "Longtail_ValidateStore() has %u missing chunks",
+            chunk_missing_count)
+        err = err ? err : ENOENT;
+    }
 
-    store_index->m_ChunkHashes = (TLongtail_Hash*)(void*)p;
-    p += sizeof(TLongtail_Hash) * chunk_count;
+    Longtail_Free(content_chunk_lookup);
 
-    store_index->m_BlockChunksOffsets = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * block_count;
+    return err;
+}
 
-    store_index->m_BlockChunkCounts = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * block_count;
+struct Longtail_StoreIndex* Longtail_CopyStoreIndex(const struct Longtail_StoreIndex* store_index)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    store_index->m_BlockTags = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * block_count;
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return 0)
 
-    store_index->m_ChunkSizes = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * chunk_count;
+    uint32_t block_count = *store_index->m_BlockCount;
+    uint32_t chunk_count = *store_index->m_ChunkCount;
+    size_t store_index_size = Longtail_GetStoreIndexSize(block_count, chunk_count);
+    void* mem = Longtail_Alloc("Longtail_CopyStoreIndex", store_index_size);
+    struct Longtail_StoreIndex* copy_store_index = Longtail_InitStoreIndex(mem, block_count, chunk_count);
 
-    return store_index;
+    *copy_store_index->m_Version = Longtail_CurrentStoreIndexVersion;
+    *copy_store_index->m_HashIdentifier = *store_index->m_HashIdentifier;
+    *copy_store_index->m_BlockCount = block_count;
+    *copy_store_index->m_ChunkCount = chunk_count;
+    memcpy(copy_store_index->m_BlockHashes, store_index->m_BlockHashes, sizeof(TLongtail_Hash) * block_count);
+    memcpy(copy_store_index->m_ChunkHashes, store_index->m_ChunkHashes, sizeof(TLongtail_Hash) * chunk_count);
+    memcpy(copy_store_index->m_BlockChunksOffsets, store_index->m_BlockChunksOffsets, sizeof(uint32_t) * block_count);
+    memcpy(copy_store_index->m_BlockChunkCounts, store_index->m_BlockChunkCounts, sizeof(uint32_t) * block_count);
+    memcpy(copy_store_index->m_BlockTags, store_index->m_BlockTags, sizeof(uint32_t) * block_count);
+    memcpy(copy_store_index->m_ChunkSizes, store_index->m_ChunkSizes, sizeof(uint32_t) * chunk_count);
+    return copy_store_index;
 }
 
-static int InitStoreIndexFromData(
-    struct Longtail_StoreIndex* store_index,
-    void* data,
-    uint64_t data_size)
+static int CreateStoreIndexFromRange(
+    const struct Longtail_StoreIndex* store_index,
+    uint32_t block_range_start,
+    uint32_t block_range_end,
+    uint32_t block_range_chunk_count,
+    struct Longtail_StoreIndex** out_store_index)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(store_index, "%p"),
-        LONGTAIL_LOGFIELD(data, "%p"),
-        LONGTAIL_LOGFIELD(data_size, "%" PRIu64)
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
+        LONGTAIL_LOGFIELD(block_range_start, "%u"),
+        LONGTAIL_LOGFIELD(block_range_end, "%u"),
+        LONGTAIL_LOGFIELD(block_range_chunk_count, "%u"),
+        LONGTAIL_LOGFIELD(out_store_index, "%p"),
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
     LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, data != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, block_range_start < block_range_end, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, block_range_chunk_count > 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
 
-    if (data_size < (4 * sizeof(uint32_t)))
+    uint32_t block_range_count = block_range_end - block_range_start;
+
+    size_t block_indexes_size = 0;
+    for (uint32_t block_offset = 0; block_offset < block_range_count; ++block_offset)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Store index is invalid, not big enough for minimal header. Size %" PRIu64 " < %" PRIu64 "", data_size, (4 * sizeof(uint32_t)));
-        return EBADF;
+        uint32_t b = block_offset + block_range_start;
+        block_indexes_size += Longtail_GetBlockIndexSize(store_index->m_BlockChunkCounts[b]);
     }
+    size_t work_mem_size =
+        sizeof(struct Longtail_BlockIndex*) * block_range_count +
+        block_indexes_size;
 
-    char* p = (char*)data;
-
-    store_index->m_Version = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
-
-    if (*store_index->m_Version != Longtail_CurrentStoreIndexVersion)
+    void* work_mem = (uint8_t*)Longtail_Alloc("CreateStoreIndexFromRange", work_mem_size);
+    if (!work_mem)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Mismatching versions in store index data %" PRIu64 " != %" PRIu64 "", (void*)store_index->m_Version, Longtail_CurrentStoreIndexVersion);
-        return EBADF;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
     }
 
-    store_index->m_HashIdentifier = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
-
-    store_index->m_BlockCount = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
-
-    store_index->m_ChunkCount = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t);
+    char* p = (char*)work_mem;
+    struct Longtail_BlockIndex** block_index_array = (struct Longtail_BlockIndex**)p;
+    p += sizeof(struct Longtail_BlockIndex*) * block_range_count;
 
-    uint32_t block_count = *store_index->m_BlockCount;
-    uint32_t chunk_count = *store_index->m_ChunkCount;
+    for (uint32_t block_offset = 0; block_offset < block_range_count; ++block_offset)
+    {
+        uint32_t b = block_offset + block_range_start;
+        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
+        struct Longtail_BlockIndex* block_index = Longtail_InitBlockIndex(p, block_chunk_count);
 
-    size_t store_index_data_size = Longtail_GetStoreIndexDataSize(block_count, chunk_count);
-    if (store_index_data_size > data_size)
+        *block_index->m_BlockHash = store_index->m_BlockHashes[b];
+        *block_index->m_HashIdentifier = *store_index->m_HashIdentifier;
+        *block_index->m_ChunkCount = block_chunk_count;
+        *block_index->m_Tag = store_index->m_BlockTags[b];
+        uint32_t block_chunk_offset = store_index->m_BlockChunksOffsets[b];
+        for (uint32_t chunk_offset = 0; chunk_offset < block_chunk_count; ++chunk_offset)
+        {
+            block_index->m_ChunkHashes[chunk_offset] = store_index->m_ChunkHashes[block_chunk_offset + chunk_offset];
+            block_index->m_ChunkSizes[chunk_offset] = store_index->m_ChunkSizes[block_chunk_offset + chunk_offset];
+        }
+        block_index_array[block_offset] = block_index;
+        p += Longtail_GetBlockIndexSize(block_chunk_count);
+    }
+    int err = Longtail_CreateStoreIndexFromBlocks(block_range_count, (const struct Longtail_BlockIndex**)block_index_array, out_store_index);
+    if (err != 0)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Store index data is truncated: %" PRIu64 " <= %" PRIu64, data_size, store_index_data_size)
-        return EBADF;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks failed with %d", err)
+        Longtail_Free(work_mem);
+        return err;
     }
-
-    store_index->m_BlockHashes = (TLongtail_Hash*)(void*)p;
-    p += sizeof(TLongtail_Hash) * block_count;
-
-    store_index->m_ChunkHashes = (TLongtail_Hash*)(void*)p;
-    p += sizeof(TLongtail_Hash) * chunk_count;
-
-    store_index->m_BlockChunksOffsets = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * block_count;
-
-    store_index->m_BlockChunkCounts = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * block_count;
-
-    store_index->m_BlockTags = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * block_count;
-
-    store_index->m_ChunkSizes = (uint32_t*)(void*)p;
-    p += sizeof(uint32_t) * chunk_count;
-
+    Longtail_Free(work_mem);
     return 0;
 }
 
-size_t Longtail_GetStoreIndexSize(uint32_t block_count, uint32_t chunk_count)
-{
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(block_count, "%u"),
-        LONGTAIL_LOGFIELD(chunk_count, "%u")
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
-
-    size_t store_index_size =
-        sizeof(struct Longtail_StoreIndex) +
-        Longtail_GetStoreIndexDataSize(block_count, chunk_count);
-
-    return store_index_size;
-}
-
-int Longtail_CreateStoreIndexFromBlocks(
-    uint32_t block_count,
-    const struct Longtail_BlockIndex** block_indexes,
-    struct Longtail_StoreIndex** out_store_index)
+int Longtail_SplitStoreIndex(
+    struct Longtail_StoreIndex* store_index,
+    size_t split_size,
+    struct Longtail_StoreIndex*** out_store_indexes,
+    uint64_t* out_count)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(block_count, "%u"),
-        LONGTAIL_LOGFIELD(block_indexes, "%p"),
-        LONGTAIL_LOGFIELD(out_store_index, "%p")
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(split_size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(out_store_indexes, "%p"),
+        LONGTAIL_LOGFIELD(out_count, "%p"),
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, block_count == 0 || block_indexes != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, split_size > 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_store_indexes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_count != 0, return EINVAL)
 
-    uint32_t hash_identifier = 0;
+    uint32_t block_count = *store_index->m_BlockCount;
+    if (block_count == 0)
+    {
+        struct Longtail_StoreIndex** result = (struct Longtail_StoreIndex**)Longtail_Alloc("Longtail_SplitStoreIndex", sizeof(struct Longtail_StoreIndex*));
+        if (!result)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+            return ENOMEM;
+        }
+        int err = Longtail_CreateStoreIndexFromBlocks(0, 0, &result[0]);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
+            Longtail_Free((void*)result);
+            return err;
+        }
+        *out_store_indexes = result;
+        *out_count = 1;
+        return 0;
+    }
 
-    uint32_t chunk_count = 0;
-    for (uint32_t b = 0; b < block_count; ++b)
+    size_t result_count = 0;
     {
-        const struct Longtail_BlockIndex* block_index = block_indexes[b];
-        hash_identifier = (hash_identifier == 0) ? *block_index->m_HashIdentifier : hash_identifier;
-        chunk_count += *block_index->m_ChunkCount;
+        uint32_t block_range_start = 0;
+        uint32_t block_range_end = 0;
+        uint32_t block_range_chunk_count = 0;
+        size_t current_index_size = 0;
+        while (block_range_end < block_count)
+        {
+            uint32_t block_chunk_count = store_index->m_BlockChunkCounts[block_range_end];
+            size_t next_index_size = Longtail_GetStoreIndexSize(block_range_end - block_range_start + 1, block_range_chunk_count + block_chunk_count);
+            if (block_range_end > block_range_start && next_index_size > split_size)
+            {
+                result_count++;
+                block_range_start = block_range_end;
+                block_range_chunk_count = 0;
+                current_index_size = 0;
+                continue;
+            }
+            block_range_chunk_count += block_chunk_count;
+            current_index_size += next_index_size;
+            ++block_range_end;
+        }
+        if (block_range_start < block_range_end)
+        {
+            result_count++;
+        }
     }
-    size_t store_index_size = Longtail_GetStoreIndexSize(block_count, chunk_count);
-    void* store_index_mem = (struct Longtail_StoreIndex*)Longtail_Alloc("CreateStoreIndexFromBlocks", store_index_size);
-    if (!store_index_mem)
+    LONGTAIL_FATAL_ASSERT(ctx, result_count > 0, return EINVAL);
+
+    struct Longtail_StoreIndex** result = (struct Longtail_StoreIndex**)Longtail_Alloc("Longtail_SplitStoreIndex", sizeof(struct Longtail_StoreIndex*) * result_count);
+    if (!result)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
         return ENOMEM;
     }
-    struct Longtail_StoreIndex* store_index = Longtail_InitStoreIndex(
-        store_index_mem,
-        block_count,
-        chunk_count);
-    if (!store_index)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitStoreIndex() failed with %d", ENOMEM)
-        return ENOMEM;
+        result_count = 0;
+        uint32_t block_range_start = 0;
+        uint32_t block_range_end = 0;
+        uint32_t block_range_chunk_count = 0;
+        size_t current_index_size = 0;
+        while (block_range_end < block_count)
+        {
+            uint32_t block_chunk_count = store_index->m_BlockChunkCounts[block_range_end];
+            size_t next_index_size = Longtail_GetStoreIndexSize(block_range_end - block_range_start + 1, block_range_chunk_count + block_chunk_count);
+            if (block_range_end > block_range_start && next_index_size > split_size)
+            {
+                int err = CreateStoreIndexFromRange(
+                    store_index,
+                    block_range_start,
+                    block_range_end,
+                    block_range_chunk_count,
+                    &result[result_count]);
+                if (err != 0)
+                {
+                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateStoreIndexFromRange failed with %d", err)
+                    while (result_count > 0)
+                    {
+                        --result_count;
+                        Longtail_Free((void*)result[result_count]);
+                    }
+                    Longtail_Free((void*)result);
+                    return err;
+                }
+                result_count++;
+                block_range_start = block_range_end;
+                block_range_chunk_count = 0;
+                current_index_size = 0;
+                continue;
+            }
+            block_range_chunk_count += block_chunk_count;
+            current_index_size += next_index_size;
+            ++block_range_end;
+        }
+        if (block_range_start < block_range_end)
+        {
+            LONGTAIL_FATAL_ASSERT(ctx, block_range_chunk_count > 0, return EINVAL);
+            int err = CreateStoreIndexFromRange(
+                store_index,
+                block_range_start,
+                block_range_end,
+                block_range_chunk_count,
+                &result[result_count]);
+            if (err != 0)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateStoreIndexFromRange failed with %d", err)
+                while (result_count > 0)
+                {
+                    --result_count;
+                    Longtail_Free((void*)result[result_count]);
+                }
+                Longtail_Free((void*)result);
+                return err;
+            }
+            result_count++;
+        }
     }
+    *out_store_indexes = result;
+    *out_count = result_count;
 
-    *store_index->m_Version = Longtail_CurrentStoreIndexVersion;
-    *store_index->m_HashIdentifier = hash_identifier;
-    *store_index->m_BlockCount = block_count;
-    *store_index->m_ChunkCount = chunk_count;
-    uint32_t c = 0;
+    return 0;
+}
 
-    for (uint32_t b = 0; b < block_count; ++b)
+#define LONGTAIL_COMPACT_STORE_INDEX_HEADER_VALUE_COUNT 3u
+#define LONGTAIL_COMPACT_STORE_INDEX_SECTION_COUNT      6u
+
+static void SetupCompactStoreIndexSections(
+    const struct Longtail_StoreIndex* store_index,
+    struct CompactSection* sections)
+{
+    uint32_t block_count = *store_index->m_BlockCount;
+    uint32_t chunk_count = *store_index->m_ChunkCount;
+    struct CompactSection s[LONGTAIL_COMPACT_STORE_INDEX_SECTION_COUNT] = {
+        {COMPACT_SECTION_RAW_HASH, block_count, store_index->m_BlockHashes,         0, store_index->m_BlockHashes,          0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_RAW_HASH, chunk_count, store_index->m_ChunkHashes,         0, store_index->m_ChunkHashes,          0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_DELTA32,  block_count, store_index->m_BlockChunksOffsets,  0, store_index->m_BlockChunksOffsets,   0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_VARINT32, block_count, store_index->m_BlockChunkCounts,    0, store_index->m_BlockChunkCounts,     0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_RLE32,    block_count, store_index->m_BlockTags,           0, store_index->m_BlockTags,            0, 0, 0, 0, 0, 0, 0},
+        {COMPACT_SECTION_VARINT32, chunk_count, store_index->m_ChunkSizes,          0, store_index->m_ChunkSizes,           0, 0, 0, 0, 0, 0, 0}
+    };
+    memcpy(sections, s, sizeof(s));
+}
+
+int Longtail_WriteCompactStoreIndexToBuffer(
+    const struct Longtail_StoreIndex* store_index,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    uint32_t compression_type,
+    void** out_buffer,
+    size_t* out_size)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(compression_type, "%u"),
+        LONGTAIL_LOGFIELD(out_buffer, "%p"),
+        LONGTAIL_LOGFIELD(out_size, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, compression_type == 0 || optional_compression_registry != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_buffer != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_size != 0, return EINVAL)
+
+    uint64_t header_values[LONGTAIL_COMPACT_STORE_INDEX_HEADER_VALUE_COUNT] = {
+        *store_index->m_HashIdentifier,
+        *store_index->m_BlockCount,
+        *store_index->m_ChunkCount
+    };
+    struct CompactSection sections[LONGTAIL_COMPACT_STORE_INDEX_SECTION_COUNT];
+    SetupCompactStoreIndexSections(store_index, sections);
+
+    int err = CompactIndex_Encode(
+        LONGTAIL_COMPACT_STORE_INDEX_MAGIC,
+        optional_compression_registry,
+        compression_type,
+        LONGTAIL_COMPACT_STORE_INDEX_HEADER_VALUE_COUNT,
+        header_values,
+        LONGTAIL_COMPACT_STORE_INDEX_SECTION_COUNT,
+        sections,
+        out_buffer,
+        out_size);
+    if (err)
     {
-        const struct Longtail_BlockIndex* block_index = block_indexes[b];
-        uint32_t block_chunk_count = *block_index->m_ChunkCount;
-        store_index->m_BlockHashes[b] = *block_index->m_BlockHash;
-        store_index->m_BlockTags[b] = *block_index->m_Tag;
-        store_index->m_BlockChunkCounts[b] = block_chunk_count;
-        store_index->m_BlockChunksOffsets[b] = c;
-        memcpy(&store_index->m_ChunkHashes[c], block_index->m_ChunkHashes, sizeof(TLongtail_Hash) * block_chunk_count);
-        memcpy(&store_index->m_ChunkSizes[c], block_index->m_ChunkSizes, sizeof(uint32_t) * block_chunk_count);
-        c += block_chunk_count;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompactIndex_Encode() failed with %d", err)
+        return err;
     }
-
-    *out_store_index = store_index;
     return 0;
 }
 
-int Longtail_MakeBlockIndex(
+int Longtail_WriteCompactStoreIndex(
+    struct Longtail_StorageAPI* storage_api,
     const struct Longtail_StoreIndex* store_index,
-    uint32_t block_index,
-    struct Longtail_BlockIndex* out_block_index)
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    uint32_t compression_type,
+    const char* path)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
         LONGTAIL_LOGFIELD(store_index, "%p"),
-        LONGTAIL_LOGFIELD(block_index, "%u"),
-        LONGTAIL_LOGFIELD(out_block_index, "%p")
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(compression_type, "%u"),
+        LONGTAIL_LOGFIELD(path, "%s")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
-
-    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, block_index < (*store_index->m_BlockCount), return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
-    uint32_t block_chunks_offset = store_index->m_BlockChunksOffsets[block_index];
-    out_block_index->m_BlockHash = &store_index->m_BlockHashes[block_index];
-    out_block_index->m_HashIdentifier = store_index->m_HashIdentifier;
-    out_block_index->m_ChunkCount = &store_index->m_BlockChunkCounts[block_index];
-    out_block_index->m_Tag = &store_index->m_BlockTags[block_index];
-    out_block_index->m_ChunkHashes = &store_index->m_ChunkHashes[block_chunks_offset];
-    out_block_index->m_ChunkSizes = &store_index->m_ChunkSizes[block_chunks_offset];
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
+
+    void* buffer = 0;
+    size_t size = 0;
+    int err = Longtail_WriteCompactStoreIndexToBuffer(store_index, optional_compression_registry, compression_type, &buffer, &size);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_WriteCompactStoreIndexToBuffer() failed with %d", err)
+        return err;
+    }
+    err = WriteIndexBuffer(storage_api, path, buffer, size);
+    Longtail_Free(buffer);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "WriteIndexBuffer() failed with %d", err)
+        return err;
+    }
     return 0;
 }
 
-int Longtail_MergeStoreIndex(
-    const struct Longtail_StoreIndex* local_store_index,
-    const struct Longtail_StoreIndex* remote_store_index,
+static int ReadCompactStoreIndex(
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    const void* buffer,
+    size_t size,
     struct Longtail_StoreIndex** out_store_index)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(local_store_index, "%p"),
-        LONGTAIL_LOGFIELD(remote_store_index, "%p"),
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(size, "%" PRIu64),
         LONGTAIL_LOGFIELD(out_store_index, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, local_store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, local_store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
-
-    uint32_t local_block_count = *local_store_index->m_BlockCount;
-    uint32_t remote_block_count = *remote_store_index->m_BlockCount;
-    uint32_t hash_identifier = 0;
-    if (local_block_count == 0)
+    uint64_t header_values[LONGTAIL_COMPACT_STORE_INDEX_HEADER_VALUE_COUNT];
+    struct CompactSection sections[LONGTAIL_COMPACT_STORE_INDEX_SECTION_COUNT];
+    void* payload_mem = 0;
+    int err = CompactIndex_Decode(
+        optional_compression_registry,
+        buffer,
+        size,
+        LONGTAIL_COMPACT_STORE_INDEX_HEADER_VALUE_COUNT,
+        header_values,
+        LONGTAIL_COMPACT_STORE_INDEX_SECTION_COUNT,
+        LONGTAIL_COMPACT_STORE_INDEX_SECTION_COUNT,
+        sections,
+        &payload_mem);
+    if (err)
     {
-        if (remote_block_count == 0)
-        {
-            return Longtail_CreateStoreIndexFromBlocks(0, 0, out_store_index);
-        }
-        hash_identifier = *remote_store_index->m_HashIdentifier;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompactIndex_Decode() failed with %d", err)
+        return err;
     }
-    else
+    if (header_values[0] > 0xffffffffu || header_values[1] > 0xffffffffu || header_values[2] > 0xffffffffu)
     {
-        hash_identifier = *local_store_index->m_HashIdentifier;
-        if (remote_block_count != 0)
-        {
-            if (hash_identifier != *remote_store_index->m_HashIdentifier)
-            {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_MergeStoreIndex(), store indexes has conflicting hash identifier, failed with %d", EINVAL)
-                return EINVAL;
-            }
-        }
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Compact store index header is invalid, failed with %d", EBADF)
+        Longtail_Free(payload_mem);
+        return EBADF;
     }
-    size_t local_block_hash_to_index_size = LongtailPrivate_LookupTable_GetSize(local_block_count);
-    size_t remote_block_hash_to_index_size = LongtailPrivate_LookupTable_GetSize(remote_block_count);
-    size_t block_hashes_size = sizeof(TLongtail_Hash) * ((size_t)local_block_count + (size_t)remote_block_count);
-    size_t work_mem_size = local_block_hash_to_index_size + remote_block_hash_to_index_size + block_hashes_size;
+    uint32_t block_count = (uint32_t)header_values[1];
+    uint32_t chunk_count = (uint32_t)header_values[2];
 
-    void* work_mem = Longtail_Alloc("MergeStoreIndex", work_mem_size);
-    if (!work_mem)
+    size_t store_index_size = Longtail_GetStoreIndexSize(block_count, chunk_count);
+    void* mem = Longtail_Alloc("ReadCompactStoreIndex", store_index_size);
+    if (!mem)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(payload_mem);
         return ENOMEM;
     }
+    struct Longtail_StoreIndex* store_index = Longtail_InitStoreIndex(mem, block_count, chunk_count);
+    *store_index->m_Version = Longtail_CurrentStoreIndexVersion;
+    *store_index->m_HashIdentifier = (uint32_t)header_values[0];
+    *store_index->m_BlockCount = block_count;
+    *store_index->m_ChunkCount = chunk_count;
 
-    char* p = (char*)work_mem;
-    struct Longtail_LookupTable* local_block_hash_to_index = LongtailPrivate_LookupTable_Create(p, local_block_count, 0);
-    p += local_block_hash_to_index_size;
-    struct Longtail_LookupTable* remote_block_hash_to_index = LongtailPrivate_LookupTable_Create(p, remote_block_count, 0);
-    p += remote_block_hash_to_index_size;
-    TLongtail_Hash* block_hashes = (TLongtail_Hash*)p;
-
-    uint32_t unique_block_count = 0;
-    uint32_t chunk_count = 0;
-    for (uint32_t local_block = 0; local_block < local_block_count; ++local_block)
-    {
-        TLongtail_Hash block_hash = local_store_index->m_BlockHashes[local_block];
-        if (LongtailPrivate_LookupTable_PutUnique(local_block_hash_to_index, block_hash, local_block))
-        {
-            continue;
-        }
-        block_hashes[unique_block_count] = block_hash;
-        ++unique_block_count;
-        chunk_count += local_store_index->m_BlockChunkCounts[local_block];
-    }
-    for (uint32_t remote_block = 0; remote_block < remote_block_count; ++remote_block)
-    {
-        TLongtail_Hash block_hash = remote_store_index->m_BlockHashes[remote_block];
-        if (LongtailPrivate_LookupTable_Get(local_block_hash_to_index, block_hash))
-        {
-            continue;
-        }
-        if (LongtailPrivate_LookupTable_PutUnique(remote_block_hash_to_index, block_hash, remote_block))
-        {
-            continue;
-        }
-        block_hashes[unique_block_count] = block_hash;
-        ++unique_block_count;
-        chunk_count += remote_store_index->m_BlockChunkCounts[remote_block];
-    }
-
-    size_t merged_block_store_index_size = Longtail_GetStoreIndexSize(unique_block_count, chunk_count);
-    void* merged_block_store_index_mem = Longtail_Alloc("MergeStoreIndex", merged_block_store_index_size);
-    if (!merged_block_store_index_mem)
+    struct CompactSection targets[LONGTAIL_COMPACT_STORE_INDEX_SECTION_COUNT];
+    SetupCompactStoreIndexSections(store_index, targets);
+    for (uint32_t s = 0; s < LONGTAIL_COMPACT_STORE_INDEX_SECTION_COUNT; ++s)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        Longtail_Free(work_mem);
-        return ENOMEM;
+        targets[s].m_Source = 0;
+        targets[s].m_Data = sections[s].m_Data;
+        targets[s].m_DataSize = sections[s].m_DataSize;
+        targets[s].m_EncodedSize = sections[s].m_EncodedSize;
+        targets[s].m_CompressionAPI = sections[s].m_CompressionAPI;
     }
-    struct Longtail_StoreIndex* merged_store_index = Longtail_InitStoreIndex(merged_block_store_index_mem, unique_block_count, chunk_count);
-    *merged_store_index->m_Version = Longtail_CurrentStoreIndexVersion;
-    *merged_store_index->m_HashIdentifier = hash_identifier;
-    *merged_store_index->m_BlockCount = unique_block_count;
-    *merged_store_index->m_ChunkCount = chunk_count;
-    uint32_t chunk_index_offset = 0;
-    const struct Longtail_StoreIndex* source_index = local_store_index;
-    struct Longtail_LookupTable* source_lookup_table = local_block_hash_to_index;
-    for (uint32_t b = 0; b < unique_block_count; ++b)
+    err = CompactIndex_DecodeSections(optional_job_api, LONGTAIL_COMPACT_STORE_INDEX_SECTION_COUNT, targets);
+    Longtail_Free(payload_mem);
+    if (err)
     {
-        TLongtail_Hash block_hash = block_hashes[b];
-        uint32_t* index_ptr = LongtailPrivate_LookupTable_Get(source_lookup_table, block_hash);
-        if (!index_ptr)
-        {
-            // When block is no longer found in local_store_index, switch over to remote_store_index
-            LONGTAIL_FATAL_ASSERT(ctx, source_index != remote_store_index, return EINVAL)
-            source_index = remote_store_index;
-            source_lookup_table = remote_block_hash_to_index;
-            index_ptr = LongtailPrivate_LookupTable_Get(source_lookup_table, block_hash);
-            LONGTAIL_FATAL_ASSERT(ctx, index_ptr, return EINVAL)
-        }
-        uint32_t source_block = *index_ptr;
-        uint32_t block_chunk_count = source_index->m_BlockChunkCounts[source_block];
-        merged_store_index->m_BlockTags[b] = source_index->m_BlockTags[source_block];
-        uint32_t block_chunk_offset = source_index->m_BlockChunksOffsets[source_block];
-        const TLongtail_Hash* local_chunk_hashes = &source_index->m_ChunkHashes[block_chunk_offset];
-        const uint32_t* local_chunk_sizes = &source_index->m_ChunkSizes[block_chunk_offset];
-
-        merged_store_index->m_BlockHashes[b] = block_hash;
-        merged_store_index->m_BlockChunkCounts[b] = block_chunk_count;
-        merged_store_index->m_BlockChunksOffsets[b] = chunk_index_offset;
-        TLongtail_Hash* merged_chunk_hashes = &merged_store_index->m_ChunkHashes[chunk_index_offset];
-        memcpy(merged_chunk_hashes, local_chunk_hashes, sizeof(TLongtail_Hash) * block_chunk_count);
-        uint32_t* merged_chunk_sizes = &merged_store_index->m_ChunkSizes[chunk_index_offset];
-        memcpy(merged_chunk_sizes, local_chunk_sizes, sizeof(uint32_t) * block_chunk_count);
-        chunk_index_offset += block_chunk_count;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CompactIndex_DecodeSections() failed with %d", err)
+        Longtail_Free(mem);
+        return err;
     }
-    Longtail_Free(work_mem);
-    *out_store_index = merged_store_index;
+    *out_store_index = store_index;
     return 0;
 }
 
-LONGTAIL_EXPORT int Longtail_PruneStoreIndex(
-    const struct Longtail_StoreIndex* source_store_index,
-    uint32_t keep_block_count,
-    const TLongtail_Hash* keep_block_hashes,
-    struct Longtail_StoreIndex** out_store_index)
+int Longtail_WriteStoreIndexToBuffer(
+    const struct Longtail_StoreIndex* store_index,
+    void** out_buffer,
+    size_t* out_size)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(source_store_index, "%p"),
-        LONGTAIL_LOGFIELD(keep_block_count, "%u"),
-        LONGTAIL_LOGFIELD(keep_block_hashes, "%p"),
-        LONGTAIL_LOGFIELD(out_store_index, "%p")
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(out_buffer, "%p"),
+        LONGTAIL_LOGFIELD(out_size, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, source_store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, (keep_block_count == 0) || (keep_block_hashes != 0), return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
-
-    uint32_t store_block_count = *source_store_index->m_BlockCount;
-    uint32_t store_chunk_count = *source_store_index->m_ChunkCount;
-    size_t keep_block_hash_lookup_size = LongtailPrivate_LookupTable_GetSize(keep_block_count);
-    size_t block_hashes_size = sizeof(TLongtail_Hash) * store_block_count;
-    size_t chunk_hashes_size = sizeof(TLongtail_Hash) * store_chunk_count;
-    size_t block_chunks_offsets_size = sizeof(uint32_t) * store_block_count;
-    size_t block_chunks_counts_size = sizeof(uint32_t) * store_block_count;
-    size_t block_tags_size = sizeof(uint32_t) * store_block_count;
-    size_t chunk_sizes_size = sizeof(uint32_t) * store_chunk_count;
-
-    size_t work_mem_size = keep_block_hash_lookup_size +
-        block_hashes_size +
-        chunk_hashes_size +
-        block_chunks_offsets_size +
-        block_chunks_counts_size +
-        block_tags_size +
-        chunk_sizes_size;
-
-    void* work_mem = Longtail_Alloc("PruneStoreIndex", work_mem_size);
-    if (!work_mem)
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_buffer != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_size != 0, return EINVAL)
+
+    size_t index_data_size = Longtail_GetStoreIndexDataSize(*store_index->m_BlockCount, *store_index->m_ChunkCount);
+    *out_buffer = Longtail_Alloc("WriteStoreIndexToBuffer", index_data_size);
+    if (!(*out_buffer))
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_GetStoreIndexDataSize() failed with %d", ENOMEM)
         return ENOMEM;
     }
+    memcpy(*out_buffer, store_index->m_Version, index_data_size);
+    *out_size = index_data_size;
+    return 0;
+}
 
-    char* p = (char*)work_mem;
-    struct Longtail_LookupTable* keep_block_hash_lookup = LongtailPrivate_LookupTable_Create(p, keep_block_count, 0);
-    p += keep_block_hash_lookup_size;
+int Longtail_WriteStoreIndex(
+    struct Longtail_StorageAPI* storage_api,
+    struct Longtail_StoreIndex* store_index,
+    const char* path)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    TLongtail_Hash* block_hashes = (TLongtail_Hash*)p;
-    p += block_hashes_size;
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
 
-    TLongtail_Hash* chunk_hashes = (TLongtail_Hash*)p;
-    p += chunk_hashes_size;
+    size_t index_data_size = Longtail_GetStoreIndexDataSize(*store_index->m_BlockCount, *store_index->m_ChunkCount);
 
-    uint32_t* block_chunks_offsets = (uint32_t*)p;
-    p += block_chunks_offsets_size;
+    int err = EnsureParentPathExists(storage_api, path);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed with %d", err)
+        return err;
+    }
+    Longtail_StorageAPI_HOpenFile file_handle;
+    err = storage_api->OpenWriteFile(storage_api, path, 0, &file_handle);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenWriteFile() failed with %d", err)
+        return err;
+    }
 
-    uint32_t* block_chunks_counts = (uint32_t*)p;
-    p += block_chunks_counts_size;
+    err = storage_api->Write(storage_api, file_handle, 0, index_data_size, store_index->m_Version);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Write() failed with %d", err)
+        storage_api->CloseFile(storage_api, file_handle);
+        file_handle = 0;
+        return err;
+    }
+    storage_api->CloseFile(storage_api, file_handle);
+    file_handle = 0;
 
-    uint32_t* block_tags = (uint32_t*)p;
-    p += block_tags_size;
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "wrote %" PRIu64 " bytes", index_data_size)
 
-    uint32_t* chunk_sizes = (uint32_t*)p;
-    p += chunk_sizes_size;
+    return 0;
+}
 
-    for (uint32_t keep_block = 0; keep_block < keep_block_count; ++keep_block)
-    {
-        TLongtail_Hash block_hash = keep_block_hashes[keep_block];
-        if (LongtailPrivate_LookupTable_PutUnique(keep_block_hash_lookup, block_hash, keep_block))
-        {
-            continue;
-        }
-    }
+int Longtail_ReadStoreIndexFromBuffer(
+    const void* buffer,
+    size_t size,
+    struct Longtail_StoreIndex** out_store_index)
+{
+    return Longtail_ReadStoreIndexFromBuffer2(buffer, size, 0, 0, out_store_index);
+}
 
-    uint32_t block_count = 0;
-    uint32_t chunk_count = 0;
-    for (uint32_t block = 0; block < store_block_count; ++block)
-    {
-        TLongtail_Hash block_hash = source_store_index->m_BlockHashes[block];
-        if (!LongtailPrivate_LookupTable_Get(keep_block_hash_lookup, block_hash))
-        {
-            continue;
-        }
-        uint32_t block_chunk_count = source_store_index->m_BlockChunkCounts[block];
-        uint32_t chunk_offset = source_store_index->m_BlockChunksOffsets[block];
+int Longtail_ReadStoreIndexFromBuffer2(
+    const void* buffer,
+    size_t size,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    struct Longtail_StoreIndex** out_store_index)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(out_store_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-        block_hashes[block_count] = block_hash;
-        block_tags[block_count] = source_store_index->m_BlockTags[block];
-        block_chunks_offsets[block_count] = chunk_count;
-        block_chunks_counts[block_count] = block_chunk_count;
-        for (uint32_t chunk = 0; chunk < block_chunk_count; ++chunk)
+    LONGTAIL_VALIDATE_INPUT(ctx, buffer != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, size != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
+
+    if (IsCompactIndex(LONGTAIL_COMPACT_STORE_INDEX_MAGIC, buffer, size))
+    {
+        int err = ReadCompactStoreIndex(optional_compression_registry, optional_job_api, buffer, size, out_store_index);
+        if (err)
         {
-            chunk_hashes[chunk_count + chunk] = source_store_index->m_ChunkHashes[chunk_offset + chunk];
-            chunk_sizes[chunk_count + chunk] = source_store_index->m_ChunkSizes[chunk_offset + chunk];
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ReadCompactStoreIndex() failed with %d", err)
+            return err;
         }
-
-        chunk_count += block_chunk_count;
-        block_count++;
+        return 0;
     }
 
-    size_t store_index_size = Longtail_GetStoreIndexSize(block_count, chunk_count);
-    void* store_index_mem = (struct Longtail_StoreIndex*)Longtail_Alloc("PruneStoreIndex", store_index_size);
-    if (!store_index_mem)
+    size_t store_index_size = sizeof(struct Longtail_StoreIndex) + size;
+    struct Longtail_StoreIndex* store_index = (struct Longtail_StoreIndex*)Longtail_Alloc("ReadStoreIndexFromBuffer", store_index_size);
+    if (!store_index)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        Longtail_Free(work_mem);
         return ENOMEM;
     }
-    struct Longtail_StoreIndex* store_index = Longtail_InitStoreIndex(
-        store_index_mem,
-        block_count,
-        chunk_count);
-    if (!store_index)
+    memcpy(&store_index[1], buffer, size);
+    int err = InitStoreIndexFromData(store_index, &store_index[1], size);
+    if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_InitStoreIndex() failed with %d", ENOMEM)
-        Longtail_Free(work_mem);
-        return ENOMEM;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "InitStoreIndexFromData() failed with %d", err)
+        Longtail_Free(store_index);
+        return err;
     }
-
-    *store_index->m_Version = Longtail_CurrentStoreIndexVersion;
-    *store_index->m_HashIdentifier = *source_store_index->m_HashIdentifier;
-    *store_index->m_BlockCount = block_count;
-    *store_index->m_ChunkCount = chunk_count;
-
-    memcpy(store_index->m_BlockHashes, block_hashes, sizeof(TLongtail_Hash) * block_count);
-    memcpy(store_index->m_ChunkHashes, chunk_hashes, sizeof(TLongtail_Hash) * chunk_count);
-    memcpy(store_index->m_BlockChunksOffsets, block_chunks_offsets, sizeof(uint32_t) * block_count);
-    memcpy(store_index->m_BlockChunkCounts, block_chunks_counts, sizeof(uint32_t) * block_count);
-    memcpy(store_index->m_BlockTags, block_tags, sizeof(uint32_t) * block_count);
-    memcpy(store_index->m_ChunkSizes, chunk_sizes, sizeof(uint32_t) * chunk_count);
-
-    Longtail_Free(work_mem);
-
     *out_store_index = store_index;
     return 0;
 }
 
-LONGTAIL_EXPORT int Longtail_ValidateStore(
-    const struct Longtail_StoreIndex* store_index,
-    const struct Longtail_VersionIndex* version_index)
+int Longtail_ReadStoreIndex(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    struct Longtail_StoreIndex** out_store_index)
+{
+    return Longtail_ReadStoreIndex2(storage_api, 0, 0, path, out_store_index);
+}
+
+int Longtail_ReadStoreIndex2(
+    struct Longtail_StorageAPI* storage_api,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    const char* path,
+    struct Longtail_StoreIndex** out_store_index)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(store_index, "%p"),
-        LONGTAIL_LOGFIELD(version_index, "%p"),
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(optional_compression_registry, "%p"),
+        LONGTAIL_LOGFIELD(optional_job_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(out_store_index, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, version_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
 
-    uint32_t store_index_chunk_count = (uint32_t)*store_index->m_ChunkCount;
-    struct Longtail_LookupTable* content_chunk_lookup = LongtailPrivate_LookupTable_Create(Longtail_Alloc("ValidateContent", LongtailPrivate_LookupTable_GetSize(store_index_chunk_count)), store_index_chunk_count ,0);
-    if (!content_chunk_lookup)
+    Longtail_StorageAPI_HOpenFile file_handle;
+    int err = storage_api->OpenReadFile(storage_api, path, &file_handle);
+    if (err != 0)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-       return ENOMEM;
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_WARNING : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+        return err;
     }
-    for (uint32_t chunk_index = 0; chunk_index < store_index_chunk_count; ++chunk_index)
+    uint64_t store_index_data_size;
+    err = storage_api->GetSize(storage_api, file_handle, &store_index_data_size);
+    if (err != 0)
     {
-        TLongtail_Hash chunk_hash = store_index->m_ChunkHashes[chunk_index];
-        LongtailPrivate_LookupTable_Put(content_chunk_lookup, chunk_hash, chunk_index);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetSize() failed with %d", err)
+        return err;
     }
-
-    uint32_t chunk_missing_count = 0;
-    uint32_t asset_size_mismatch_count = 0;
-
-    uint32_t version_index_chunk_count = *version_index->m_ChunkCount;
-    for (uint32_t chunk_index = 0; chunk_index < version_index_chunk_count; ++chunk_index)
+    size_t store_index_size = store_index_data_size + sizeof(struct Longtail_StoreIndex);
+    struct Longtail_StoreIndex* store_index = (struct Longtail_StoreIndex*)Longtail_Alloc("ReadStoreIndex", store_index_size);
+    if (!store_index)
     {
-        TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
-        if (LongtailPrivate_LookupTable_Get(content_chunk_lookup, chunk_hash) == 0)
-        {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Longtail_ValidateStore() content index does not contain chunk 0x%" PRIx64 "",
-                chunk_hash)
-            ++chunk_missing_count;
-            continue;
-        }
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        storage_api->CloseFile(storage_api, file_handle);
+        return err;
     }
-
-    uint32_t version_index_asset_count = *version_index->m_AssetCount;
-    for (uint32_t asset_index = 0; asset_index < version_index_asset_count; ++asset_index)
+    err = storage_api->Read(storage_api, file_handle, 0, store_index_data_size, &store_index[1]);
+    if (err)
     {
-        uint64_t asset_size = version_index->m_AssetSizes[asset_index];
-        uint32_t chunk_count = version_index->m_AssetChunkCounts[asset_index];
-        uint32_t first_chunk_index = version_index->m_AssetChunkIndexStarts[asset_index];
-        uint64_t asset_chunked_size = 0;
-        for (uint32_t i = 0; i < chunk_count; ++i)
-        {
-            uint32_t chunk_index = version_index->m_AssetChunkIndexes[first_chunk_index + i];
-            TLongtail_Hash chunk_hash = version_index->m_ChunkHashes[chunk_index];
-            uint32_t chunk_size = version_index->m_ChunkSizes[chunk_index];
-            asset_chunked_size += chunk_size;
-        }
-        const char* asset_path = &version_index->m_NameData[version_index->m_NameOffsets[asset_index]];
-        if ((asset_chunked_size != asset_size) && (!IsDirPath(asset_path)))
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
+        Longtail_Free(store_index);
+        storage_api->CloseFile(storage_api, file_handle);
+        return err;
+    }
+    storage_api->CloseFile(storage_api, file_handle);
+    if (IsCompactIndex(LONGTAIL_COMPACT_STORE_INDEX_MAGIC, &store_index[1], store_index_data_size))
+    {
+        struct Longtail_StoreIndex* compact_store_index = 0;
+        err = ReadCompactStoreIndex(optional_compression_registry, optional_job_api, &store_index[1], store_index_data_size, &compact_store_index);
+        Longtail_Free(store_index);
+        if (err)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "Longtail_ValidateStore() asset size for %s mismatch, accumulated chunks size: %" PRIu64 ", asset size:  %" PRIu64 "",
-                asset_path, asset_chunked_size, asset_size)
-            ++asset_size_mismatch_count;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ReadCompactStoreIndex() failed with %d", err)
+            return err;
         }
+        store_index = compact_store_index;
     }
-
-    int err = 0;
-    if (asset_size_mismatch_count > 0)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "Longtail_ValidateStore() has %u assets that does not match chunk sizes",
-            asset_size_mismatch_count)
-        err = EINVAL;
+    else
+    {
+        err = InitStoreIndexFromData(store_index, &store_index[1], store_index_data_size);
     }
-
-    if (chunk_missing_count > 0)
+    if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "Longtail_ValidateStore() has %u missing chunks",
-            chunk_missing_count)
-        err = err ? err : ENOENT;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "InitStoreIndexFromData() failed with %d", err)
+        Longtail_Free(store_index);
+        return err;
     }
 
-    Longtail_Free(content_chunk_lookup);
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Read store index containing %u chunk in %u blocks",
+        *store_index->m_ChunkCount, *store_index->m_BlockCount)
 
-    return err;
+    *out_store_index = store_index;
+
+    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "read %" PRIu64 " bytes", store_index_data_size)
+
+    return 0;
 }
 
-struct Longtail_StoreIndex* Longtail_CopyStoreIndex(const struct Longtail_StoreIndex* store_index)
+static size_t GetBlockRefCountIndexDataSize(uint32_t block_count)
 {
-    MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(store_index, "%p"),
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+    return
+        sizeof(uint32_t) +                          // m_Version
+        sizeof(uint32_t) +                          // m_BlockCount
+        (sizeof(TLongtail_Hash) * block_count) +    // m_BlockHashes
+        (sizeof(uint32_t) * block_count);           // m_RefCounts
+}
 
-    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return 0)
+size_t Longtail_GetBlockRefCountIndexSize(uint32_t block_count)
+{
+    return sizeof(struct Longtail_BlockRefCountIndex) + GetBlockRefCountIndexDataSize(block_count);
+}
 
-    uint32_t block_count = *store_index->m_BlockCount;
-    uint32_t chunk_count = *store_index->m_ChunkCount;
-    size_t store_index_size = Longtail_GetStoreIndexSize(block_count, chunk_count);
-    void* mem = Longtail_Alloc("Longtail_CopyStoreIndex", store_index_size);
-    struct Longtail_StoreIndex* copy_store_index = Longtail_InitStoreIndex(mem, block_count, chunk_count);
+static struct Longtail_BlockRefCountIndex* InitBlockRefCountIndex(void* mem, uint32_t block_count)
+{
+    struct Longtail_BlockRefCountIndex* ref_count_index = (struct Longtail_BlockRefCountIndex*)mem;
+    char* p = (char*)&ref_count_index[1];
 
-    *copy_store_index->m_Version = Longtail_CurrentStoreIndexVersion;
-    *copy_store_index->m_HashIdentifier = *store_index->m_HashIdentifier;
-    *copy_store_index->m_BlockCount = block_count;
-    *copy_store_index->m_ChunkCount = chunk_count;
-    memcpy(copy_store_index->m_BlockHashes, store_index->m_BlockHashes, sizeof(TLongtail_Hash) * block_count);
-    memcpy(copy_store_index->m_ChunkHashes, store_index->m_ChunkHashes, sizeof(TLongtail_Hash) * chunk_count);
-    memcpy(copy_store_index->m_BlockChunksOffsets, store_index->m_BlockChunksOffsets, sizeof(uint32_t) * block_count);
-    memcpy(copy_store_index->m_BlockChunkCounts, store_index->m_BlockChunkCounts, sizeof(uint32_t) * block_count);
-    memcpy(copy_store_index->m_BlockTags, store_index->m_BlockTags, sizeof(uint32_t) * block_count);
-    memcpy(copy_store_index->m_ChunkSizes, store_index->m_ChunkSizes, sizeof(uint32_t) * chunk_count);
-    return copy_store_index;
+    ref_count_index->m_Version = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    ref_count_index->m_BlockCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    ref_count_index->m_BlockHashes = (TLongtail_Hash*)(void*)p;
+    p += sizeof(TLongtail_Hash) * block_count;
+
+    ref_count_index->m_RefCounts = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * block_count;
+
+    *ref_count_index->m_Version = Longtail_CurrentBlockRefCountIndexVersion;
+    *ref_count_index->m_BlockCount = block_count;
+    return ref_count_index;
 }
 
-static int CreateStoreIndexFromRange(
-    const struct Longtail_StoreIndex* store_index,
-    uint32_t block_range_start,
-    uint32_t block_range_end,
-    uint32_t block_range_chunk_count,
-    struct Longtail_StoreIndex** out_store_index)
+static int InitBlockRefCountIndexFromData(
+    struct Longtail_BlockRefCountIndex* ref_count_index,
+    void* data,
+    uint64_t data_size)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(store_index, "%p"),
-        LONGTAIL_LOGFIELD(block_range_start, "%u"),
-        LONGTAIL_LOGFIELD(block_range_end, "%u"),
-        LONGTAIL_LOGFIELD(block_range_chunk_count, "%u"),
-        LONGTAIL_LOGFIELD(out_store_index, "%p"),
-    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+        LONGTAIL_LOGFIELD(ref_count_index, "%p"),
+        LONGTAIL_LOGFIELD(data, "%p"),
+        LONGTAIL_LOGFIELD(data_size, "%" PRIu64)
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_OFF)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, block_range_start < block_range_end, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, block_range_chunk_count > 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
+    if (data_size < (2 * sizeof(uint32_t)))
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Block ref count index is invalid, not big enough for minimal header. Size %" PRIu64 " < %" PRIu64 "", data_size, (2 * sizeof(uint32_t)));
+        return EBADF;
+    }
 
-    uint32_t block_range_count = block_range_end - block_range_start;
+    char* p = (char*)data;
 
-    size_t block_indexes_size = 0;
-    for (uint32_t block_offset = 0; block_offset < block_range_count; ++block_offset)
+    ref_count_index->m_Version = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    if (*ref_count_index->m_Version != Longtail_CurrentBlockRefCountIndexVersion)
     {
-        uint32_t b = block_offset + block_range_start;
-        block_indexes_size += Longtail_GetBlockIndexSize(store_index->m_BlockChunkCounts[b]);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Mismatching versions in block ref count index data %u != %u", *ref_count_index->m_Version, Longtail_CurrentBlockRefCountIndexVersion);
+        return EBADF;
     }
-    size_t work_mem_size =
-        sizeof(struct Longtail_BlockIndex*) * block_range_count +
-        block_indexes_size;
 
-    void* work_mem = (uint8_t*)Longtail_Alloc("CreateStoreIndexFromRange", work_mem_size);
-    if (!work_mem)
+    ref_count_index->m_BlockCount = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t);
+
+    uint32_t block_count = *ref_count_index->m_BlockCount;
+    if (GetBlockRefCountIndexDataSize(block_count) > data_size)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        return ENOMEM;
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Block ref count index data is truncated: %" PRIu64 " < %" PRIu64, data_size, (uint64_t)GetBlockRefCountIndexDataSize(block_count))
+        return EBADF;
     }
 
-    char* p = (char*)work_mem;
-    struct Longtail_BlockIndex** block_index_array = (struct Longtail_BlockIndex**)p;
-    p += sizeof(struct Longtail_BlockIndex*) * block_range_count;
+    ref_count_index->m_BlockHashes = (TLongtail_Hash*)(void*)p;
+    p += sizeof(TLongtail_Hash) * block_count;
 
-    for (uint32_t block_offset = 0; block_offset < block_range_count; ++block_offset)
-    {
-        uint32_t b = block_offset + block_range_start;
-        uint32_t block_chunk_count = store_index->m_BlockChunkCounts[b];
-        struct Longtail_BlockIndex* block_index = Longtail_InitBlockIndex(p, block_chunk_count);
+    ref_count_index->m_RefCounts = (uint32_t*)(void*)p;
+    p += sizeof(uint32_t) * block_count;
 
-        *block_index->m_BlockHash = store_index->m_BlockHashes[b];
-        *block_index->m_HashIdentifier = *store_index->m_HashIdentifier;
-        *block_index->m_ChunkCount = block_chunk_count;
-        *block_index->m_Tag = store_index->m_BlockTags[b];
-        uint32_t block_chunk_offset = store_index->m_BlockChunksOffsets[b];
-        for (uint32_t chunk_offset = 0; chunk_offset < block_chunk_count; ++chunk_offset)
+    // Blocks that reach zero references are removed so a zero count means the data is corrupt
+    for (uint32_t b = 0; b < block_count; ++b)
+    {
+        if (ref_count_index->m_RefCounts[b] == 0)
         {
-            block_index->m_ChunkHashes[chunk_offset] = store_index->m_ChunkHashes[block_chunk_offset + chunk_offset];
-            block_index->m_ChunkSizes[chunk_offset] = store_index->m_ChunkSizes[block_chunk_offset + chunk_offset];
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Block ref count index has a zero reference count for block 0x%" PRIx64, ref_count_index->m_BlockHashes[b])
+            return EBADF;
         }
-        block_index_array[block_offset] = block_index;
-        p += Longtail_GetBlockIndexSize(block_chunk_count);
-    }
-    int err = Longtail_CreateStoreIndexFromBlocks(block_range_count, (const struct Longtail_BlockIndex**)block_index_array, out_store_index);
-    if (err != 0)
-    {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks failed with %d", err)
-        Longtail_Free(work_mem);
-        return err;
     }
-    Longtail_Free(work_mem);
+
     return 0;
 }
 
-int Longtail_SplitStoreIndex(
-    struct Longtail_StoreIndex* store_index,
-    size_t split_size,
-    struct Longtail_StoreIndex*** out_store_indexes,
-    uint64_t* out_count)
+int Longtail_CreateBlockRefCountIndex(
+    uint32_t block_count,
+    const TLongtail_Hash* block_hashes,
+    const uint32_t* ref_counts,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(store_index, "%p"),
-        LONGTAIL_LOGFIELD(split_size, "%" PRIu64),
-        LONGTAIL_LOGFIELD(out_store_indexes, "%p"),
-        LONGTAIL_LOGFIELD(out_count, "%p"),
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(block_hashes, "%p"),
+        LONGTAIL_LOGFIELD(ref_counts, "%p"),
+        LONGTAIL_LOGFIELD(out_ref_count_index, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, split_size > 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_store_indexes != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_count != 0, return EINVAL)
-
-    uint32_t block_count = *store_index->m_BlockCount;
-    if (block_count == 0)
+    LONGTAIL_VALIDATE_INPUT(ctx, block_count == 0 || block_hashes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, block_count == 0 || ref_counts != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_ref_count_index != 0, return EINVAL)
+    for (uint32_t b = 0; b < block_count; ++b)
     {
-        struct Longtail_StoreIndex** result = (struct Longtail_StoreIndex**)Longtail_Alloc("Longtail_SplitStoreIndex", sizeof(struct Longtail_StoreIndex*));
-        if (!result)
-        {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-            return ENOMEM;
-        }
-        int err = Longtail_CreateStoreIndexFromBlocks(0, 0, &result[0]);
-        if (err)
+        if (ref_counts[b] == 0)
         {
-            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_CreateStoreIndexFromBlocks() failed with %d", err)
-            Longtail_Free((void*)result);
-            return err;
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Block 0x%" PRIx64 " has a zero reference count, failed with %d", block_hashes[b], EINVAL)
+            return EINVAL;
         }
-        *out_store_indexes = result;
-        *out_count = 1;
-        return 0;
     }
 
-    size_t result_count = 0;
+    void* mem = Longtail_Alloc("CreateBlockRefCountIndex", Longtail_GetBlockRefCountIndexSize(block_count));
+    if (!mem)
     {
-        uint32_t block_range_start = 0;
-        uint32_t block_range_end = 0;
-        uint32_t block_range_chunk_count = 0;
-        size_t current_index_size = 0;
-        while (block_range_end < block_count)
-        {
-            uint32_t block_chunk_count = store_index->m_BlockChunkCounts[block_range_end];
-            size_t next_index_size = Longtail_GetStoreIndexSize(block_range_end - block_range_start + 1, block_range_chunk_count + block_chunk_count);
-            if (block_range_end > block_range_start && next_index_size > split_size)
-            {
-                result_count++;
-                block_range_start = block_range_end;
-                block_range_chunk_count = 0;
-                current_index_size = 0;
-                continue;
-            }
-            block_range_chunk_count += block_chunk_count;
-            current_index_size += next_index_size;
-            ++block_range_end;
-        }
-        if (block_range_start < block_range_end)
-        {
-            result_count++;
-        }
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
     }
-    LONGTAIL_FATAL_ASSERT(ctx, result_count > 0, return EINVAL);
+    struct Longtail_BlockRefCountIndex* ref_count_index = InitBlockRefCountIndex(mem, block_count);
+    if (block_count > 0)
+    {
+        memcpy(ref_count_index->m_BlockHashes, block_hashes, sizeof(TLongtail_Hash) * block_count);
+        memcpy(ref_count_index->m_RefCounts, ref_counts, sizeof(uint32_t) * block_count);
+    }
+    *out_ref_count_index = ref_count_index;
+    return 0;
+}
 
-    struct Longtail_StoreIndex** result = (struct Longtail_StoreIndex**)Longtail_Alloc("Longtail_SplitStoreIndex", sizeof(struct Longtail_StoreIndex*) * result_count);
-    if (!result)
+static int ChangeBlockRefCounts(
+    const struct Longtail_BlockRefCountIndex* ref_count_index,
+    uint32_t block_count,
+    const TLongtail_Hash* block_hashes,
+    int retire,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(ref_count_index, "%p"),
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(block_hashes, "%p"),
+        LONGTAIL_LOGFIELD(retire, "%d"),
+        LONGTAIL_LOGFIELD(out_ref_count_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    uint32_t index_block_count = *ref_count_index->m_BlockCount;
+    size_t change_lookup_size = LongtailPrivate_LookupTable_GetSize(block_count);
+    size_t change_hashes_size = sizeof(TLongtail_Hash) * block_count;
+    size_t change_applied_size = sizeof(uint8_t) * block_count;
+    void* work_mem = Longtail_Alloc("ChangeBlockRefCounts", change_lookup_size + change_hashes_size + change_applied_size);
+    if (!work_mem)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
         return ENOMEM;
     }
+    char* p = (char*)work_mem;
+    struct Longtail_LookupTable* change_lookup = LongtailPrivate_LookupTable_Create(p, block_count, 0);
+    p += change_lookup_size;
+    TLongtail_Hash* change_hashes = (TLongtail_Hash*)p;
+    p += change_hashes_size;
+    uint8_t* change_applied = (uint8_t*)p;
+
+    // A version references each of its blocks once
+    uint32_t change_count = 0;
+    for (uint32_t b = 0; b < block_count; ++b)
     {
-        result_count = 0;
-        uint32_t block_range_start = 0;
-        uint32_t block_range_end = 0;
-        uint32_t block_range_chunk_count = 0;
-        size_t current_index_size = 0;
-        while (block_range_end < block_count)
+        if (LongtailPrivate_LookupTable_PutUnique(change_lookup, block_hashes[b], change_count) == 0)
         {
-            uint32_t block_chunk_count = store_index->m_BlockChunkCounts[block_range_end];
-            size_t next_index_size = Longtail_GetStoreIndexSize(block_range_end - block_range_start + 1, block_range_chunk_count + block_chunk_count);
-            if (block_range_end > block_range_start && next_index_size > split_size)
-            {
-                int err = CreateStoreIndexFromRange(
-                    store_index,
-                    block_range_start,
-                    block_range_end,
-                    block_range_chunk_count,
-                    &result[result_count]);
-                if (err != 0)
-                {
-                    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateStoreIndexFromRange failed with %d", err)
-                    while (result_count > 0)
-                    {
-                        --result_count;
-                        Longtail_Free((void*)result[result_count]);
-                    }
-                    Longtail_Free((void*)result);
-                    return err;
-                }
-                result_count++;
-                block_range_start = block_range_end;
-                block_range_chunk_count = 0;
-                current_index_size = 0;
-                continue;
-            }
-            block_range_chunk_count += block_chunk_count;
-            current_index_size += next_index_size;
-            ++block_range_end;
+            change_hashes[change_count] = block_hashes[b];
+            change_applied[change_count] = 0;
+            ++change_count;
+        }
+    }
+
+    uint32_t result_block_count = 0;
+    for (uint32_t b = 0; b < index_block_count; ++b)
+    {
+        uint32_t ref_count = ref_count_index->m_RefCounts[b];
+        const uint32_t* change_index = LongtailPrivate_LookupTable_Get(change_lookup, ref_count_index->m_BlockHashes[b]);
+        if (change_index)
+        {
+            change_applied[*change_index] = 1;
+            ref_count = retire ? ref_count - 1 : ref_count + 1;
+        }
+        result_block_count += (ref_count > 0) ? 1 : 0;
+    }
+    for (uint32_t c = 0; c < change_count; ++c)
+    {
+        if (change_applied[c])
+        {
+            continue;
         }
-        if (block_range_start < block_range_end)
+        if (retire)
         {
-            LONGTAIL_FATAL_ASSERT(ctx, block_range_chunk_count > 0, return EINVAL);
-            int err = CreateStoreIndexFromRange(
-                store_index,
-                block_range_start,
-                block_range_end,
-                block_range_chunk_count,
-                &result[result_count]);
-            if (err != 0)
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Retired block 0x%" PRIx64 " is not referenced", change_hashes[c])
+            continue;
+        }
+        ++result_block_count;
+    }
+
+    void* mem = Longtail_Alloc("ChangeBlockRefCounts", Longtail_GetBlockRefCountIndexSize(result_block_count));
+    if (!mem)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(work_mem);
+        return ENOMEM;
+    }
+    struct Longtail_BlockRefCountIndex* result = InitBlockRefCountIndex(mem, result_block_count);
+
+    // Kept blocks retain their order, newly referenced blocks are appended
+    uint32_t block_index = 0;
+    for (uint32_t b = 0; b < index_block_count; ++b)
+    {
+        TLongtail_Hash block_hash = ref_count_index->m_BlockHashes[b];
+        uint32_t ref_count = ref_count_index->m_RefCounts[b];
+        if (LongtailPrivate_LookupTable_Get(change_lookup, block_hash))
+        {
+            ref_count = retire ? ref_count - 1 : ref_count + 1;
+        }
+        if (ref_count == 0)
+        {
+            continue;
+        }
+        result->m_BlockHashes[block_index] = block_hash;
+        result->m_RefCounts[block_index] = ref_count;
+        ++block_index;
+    }
+    if (!retire)
+    {
+        for (uint32_t c = 0; c < change_count; ++c)
+        {
+            if (change_applied[c])
             {
-                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "CreateStoreIndexFromRange failed with %d", err)
-                while (result_count > 0)
-                {
-                    --result_count;
-                    Longtail_Free((void*)result[result_count]);
-                }
-                Longtail_Free((void*)result);
-                return err;
+                continue;
             }
-            result_count++;
+            result->m_BlockHashes[block_index] = change_hashes[c];
+            result->m_RefCounts[block_index] = 1;
+            ++block_index;
         }
     }
-    *out_store_indexes = result;
-    *out_count = result_count;
+    LONGTAIL_FATAL_ASSERT(ctx, block_index == result_block_count, return EINVAL)
+    Longtail_Free(work_mem);
 
+    *out_ref_count_index = result;
     return 0;
 }
 
-int Longtail_WriteStoreIndexToBuffer(
-    const struct Longtail_StoreIndex* store_index,
+int Longtail_RegisterBlockRefs(
+    const struct Longtail_BlockRefCountIndex* ref_count_index,
+    uint32_t block_count,
+    const TLongtail_Hash* block_hashes,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(ref_count_index, "%p"),
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(block_hashes, "%p"),
+        LONGTAIL_LOGFIELD(out_ref_count_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, ref_count_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, block_count == 0 || block_hashes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_ref_count_index != 0, return EINVAL)
+
+    int err = ChangeBlockRefCounts(ref_count_index, block_count, block_hashes, 0, out_ref_count_index);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ChangeBlockRefCounts() failed with %d", err)
+        return err;
+    }
+    return 0;
+}
+
+int Longtail_RetireBlockRefs(
+    const struct Longtail_BlockRefCountIndex* ref_count_index,
+    uint32_t block_count,
+    const TLongtail_Hash* block_hashes,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(ref_count_index, "%p"),
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(block_hashes, "%p"),
+        LONGTAIL_LOGFIELD(out_ref_count_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, ref_count_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, block_count == 0 || block_hashes != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_ref_count_index != 0, return EINVAL)
+
+    int err = ChangeBlockRefCounts(ref_count_index, block_count, block_hashes, 1, out_ref_count_index);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "ChangeBlockRefCounts() failed with %d", err)
+        return err;
+    }
+    return 0;
+}
+
+int Longtail_WriteBlockRefCountIndexToBuffer(
+    const struct Longtail_BlockRefCountIndex* ref_count_index,
     void** out_buffer,
     size_t* out_size)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(ref_count_index, "%p"),
         LONGTAIL_LOGFIELD(out_buffer, "%p"),
         LONGTAIL_LOGFIELD(out_size, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, ref_count_index != 0, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, out_buffer != 0, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, out_size != 0, return EINVAL)
 
-    size_t index_data_size = Longtail_GetStoreIndexDataSize(*store_index->m_BlockCount, *store_index->m_ChunkCount);
-    *out_buffer = Longtail_Alloc("WriteStoreIndexToBuffer", index_data_size);
+    size_t index_data_size = GetBlockRefCountIndexDataSize(*ref_count_index->m_BlockCount);
+    *out_buffer = Longtail_Alloc("WriteBlockRefCountIndexToBuffer", index_data_size);
     if (!(*out_buffer))
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_GetStoreIndexDataSize() failed with %d", ENOMEM)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
         return ENOMEM;
     }
-    memcpy(*out_buffer, store_index->m_Version, index_data_size);
+    memcpy(*out_buffer, ref_count_index->m_Version, index_data_size);
     *out_size = index_data_size;
     return 0;
 }
 
-int Longtail_WriteStoreIndex(
+int Longtail_ReadBlockRefCountIndexFromBuffer(
+    const void* buffer,
+    size_t size,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(buffer, "%p"),
+        LONGTAIL_LOGFIELD(size, "%" PRIu64),
+        LONGTAIL_LOGFIELD(out_ref_count_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
+
+    LONGTAIL_VALIDATE_INPUT(ctx, buffer != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, size != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_ref_count_index != 0, return EINVAL)
+
+    struct Longtail_BlockRefCountIndex* ref_count_index = (struct Longtail_BlockRefCountIndex*)Longtail_Alloc("ReadBlockRefCountIndexFromBuffer", sizeof(struct Longtail_BlockRefCountIndex) + size);
+    if (!ref_count_index)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        return ENOMEM;
+    }
+    memcpy(&ref_count_index[1], buffer, size);
+    int err = InitBlockRefCountIndexFromData(ref_count_index, &ref_count_index[1], size);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "InitBlockRefCountIndexFromData() failed with %d", err)
+        Longtail_Free(ref_count_index);
+        return err;
+    }
+    *out_ref_count_index = ref_count_index;
+    return 0;
+}
+
+int Longtail_WriteBlockRefCountIndex(
     struct Longtail_StorageAPI* storage_api,
-    struct Longtail_StoreIndex* store_index,
+    const struct Longtail_BlockRefCountIndex* ref_count_index,
     const char* path)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(storage_api, "%p"),
-        LONGTAIL_LOGFIELD(store_index, "%p"),
+        LONGTAIL_LOGFIELD(ref_count_index, "%p"),
         LONGTAIL_LOGFIELD(path, "%s")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
     LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, ref_count_index != 0, return EINVAL)
     LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
 
-    size_t index_data_size = Longtail_GetStoreIndexDataSize(*store_index->m_BlockCount, *store_index->m_ChunkCount);
+    size_t index_data_size = GetBlockRefCountIndexDataSize(*ref_count_index->m_BlockCount);
 
     int err = EnsureParentPathExists(storage_api, path);
     if (err)
@@ -9803,119 +15613,251 @@ int Longtail_WriteStoreIndex(
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenWriteFile() failed with %d", err)
         return err;
     }
-
-    err = storage_api->Write(storage_api, file_handle, 0, index_data_size, store_index->m_Version);
+    err = storage_api->Write(storage_api, file_handle, 0, index_data_size, ref_count_index->m_Version);
+    storage_api->CloseFile(storage_api, file_handle);
     if (err)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Write() failed with %d", err)
-        storage_api->CloseFile(storage_api, file_handle);
-        file_handle = 0;
         return err;
     }
-    storage_api->CloseFile(storage_api, file_handle);
-    file_handle = 0;
-
-    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "wrote %" PRIu64 " bytes", index_data_size)
-
     return 0;
 }
 
-int Longtail_ReadStoreIndexFromBuffer(
-    const void* buffer,
-    size_t size,
-    struct Longtail_StoreIndex** out_store_index)
+int Longtail_ReadBlockRefCountIndex(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
-        LONGTAIL_LOGFIELD(buffer, "%p"),
-        LONGTAIL_LOGFIELD(size, "%" PRIu64),
-        LONGTAIL_LOGFIELD(out_store_index, "%p")
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(out_ref_count_index, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, buffer != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, size != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, out_ref_count_index != 0, return EINVAL)
 
-    size_t store_index_size = sizeof(struct Longtail_StoreIndex) + size;
-    struct Longtail_StoreIndex* store_index = (struct Longtail_StoreIndex*)Longtail_Alloc("ReadStoreIndexFromBuffer", store_index_size);
-    if (!store_index)
+    Longtail_StorageAPI_HOpenFile file_handle;
+    int err = storage_api->OpenReadFile(storage_api, path, &file_handle);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_WARNING : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+        return err;
+    }
+    uint64_t index_data_size;
+    err = storage_api->GetSize(storage_api, file_handle, &index_data_size);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetSize() failed with %d", err)
+        storage_api->CloseFile(storage_api, file_handle);
+        return err;
+    }
+    struct Longtail_BlockRefCountIndex* ref_count_index = (struct Longtail_BlockRefCountIndex*)Longtail_Alloc("ReadBlockRefCountIndex", sizeof(struct Longtail_BlockRefCountIndex) + index_data_size);
+    if (!ref_count_index)
     {
         LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        storage_api->CloseFile(storage_api, file_handle);
         return ENOMEM;
     }
-    memcpy(&store_index[1], buffer, size);
-    int err = InitStoreIndexFromData(store_index, &store_index[1], size);
+    err = storage_api->Read(storage_api, file_handle, 0, index_data_size, &ref_count_index[1]);
+    storage_api->CloseFile(storage_api, file_handle);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "InitStoreIndexFromData() failed with %d", err)
-        Longtail_Free(store_index);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
+        Longtail_Free(ref_count_index);
         return err;
     }
-    *out_store_index = store_index;
+    err = InitBlockRefCountIndexFromData(ref_count_index, &ref_count_index[1], index_data_size);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "InitBlockRefCountIndexFromData() failed with %d", err)
+        Longtail_Free(ref_count_index);
+        return err;
+    }
+    *out_ref_count_index = ref_count_index;
     return 0;
 }
 
-int Longtail_ReadStoreIndex(
+static char* GetBlockRefCountIndexSiblingPath(const char* path, const char* suffix)
+{
+    size_t path_length = strlen(path);
+    size_t suffix_length = strlen(suffix);
+    char* sibling_path = (char*)Longtail_Alloc("UpdateBlockRefCountIndex", path_length + suffix_length + 1);
+    if (!sibling_path)
+    {
+        return 0;
+    }
+    memcpy(sibling_path, path, path_length);
+    memcpy(&sibling_path[path_length], suffix, suffix_length + 1);
+    return sibling_path;
+}
+
+static int UpdateBlockRefCountIndexLocked(
     struct Longtail_StorageAPI* storage_api,
     const char* path,
-    struct Longtail_StoreIndex** out_store_index)
+    const char* tmp_path,
+    const char* backup_path,
+    uint32_t block_count,
+    const TLongtail_Hash* block_hashes,
+    int retire,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index)
 {
     MAKE_LOG_CONTEXT_FIELDS(ctx)
         LONGTAIL_LOGFIELD(storage_api, "%p"),
         LONGTAIL_LOGFIELD(path, "%s"),
-        LONGTAIL_LOGFIELD(out_store_index, "%p")
+        LONGTAIL_LOGFIELD(tmp_path, "%s"),
+        LONGTAIL_LOGFIELD(backup_path, "%s"),
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(block_hashes, "%p"),
+        LONGTAIL_LOGFIELD(retire, "%d"),
+        LONGTAIL_LOGFIELD(out_ref_count_index, "%p")
     MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
-    LONGTAIL_VALIDATE_INPUT(ctx, out_store_index != 0, return EINVAL)
+    // A backup without an index is left by an update that was interrupted before the new index was in place
+    if (!storage_api->IsFile(storage_api, path) && storage_api->IsFile(storage_api, backup_path))
+    {
+        int err = storage_api->RenameFile(storage_api, backup_path, path);
+        if (err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to restore block ref count index from `%s`, failed with %d", backup_path, err)
+            return err;
+        }
+    }
 
-    Longtail_StorageAPI_HOpenFile file_handle;
-    int err = storage_api->OpenReadFile(storage_api, path, &file_handle);
-    if (err != 0)
+    struct Longtail_BlockRefCountIndex* ref_count_index = 0;
+    int err = storage_api->IsFile(storage_api, path) ?
+        Longtail_ReadBlockRefCountIndex(storage_api, path, &ref_count_index) :
+        Longtail_CreateBlockRefCountIndex(0, 0, 0, &ref_count_index);
+    if (err)
     {
-        LONGTAIL_LOG(ctx, err == ENOENT ? LONGTAIL_LOG_LEVEL_WARNING : LONGTAIL_LOG_LEVEL_ERROR, "storage_api->OpenReadFile() failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to read block ref count index, failed with %d", err)
         return err;
     }
-    uint64_t store_index_data_size;
-    err = storage_api->GetSize(storage_api, file_handle, &store_index_data_size);
-    if (err != 0)
+    struct Longtail_BlockRefCountIndex* updated_ref_count_index = 0;
+    err = retire ?
+        Longtail_RetireBlockRefs(ref_count_index, block_count, block_hashes, &updated_ref_count_index) :
+        Longtail_RegisterBlockRefs(ref_count_index, block_count, block_hashes, &updated_ref_count_index);
+    Longtail_Free(ref_count_index);
+    if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->GetSize() failed with %d", err)
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to change block ref counts, failed with %d", err)
         return err;
     }
-    size_t store_index_size = store_index_data_size + sizeof(struct Longtail_StoreIndex);
-    struct Longtail_StoreIndex* store_index = (struct Longtail_StoreIndex*)Longtail_Alloc("ReadStoreIndex", store_index_size);
-    if (!store_index)
+
+    // Write to a temporary file first so a failed write does not lose the references of all versions.
+    // Renaming does not replace an existing file on all storage APIs, the current index is kept as a backup
+    // until the new index is in place so there is always a complete index on disk
+    err = Longtail_WriteBlockRefCountIndex(storage_api, updated_ref_count_index, tmp_path);
+    int has_backup = 0;
+    if (!err && storage_api->IsFile(storage_api, path))
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
-        storage_api->CloseFile(storage_api, file_handle);
-        return err;
+        if (storage_api->IsFile(storage_api, backup_path))
+        {
+            err = storage_api->RemoveFile(storage_api, backup_path);
+        }
+        if (!err)
+        {
+            err = storage_api->RenameFile(storage_api, path, backup_path);
+            has_backup = err == 0;
+        }
     }
-    err = storage_api->Read(storage_api, file_handle, 0, store_index_data_size, &store_index[1]);
-    if (err)
+    if (!err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->Read() failed with %d", err)
-        Longtail_Free(store_index);
-        storage_api->CloseFile(storage_api, file_handle);
-        return err;
+        err = storage_api->RenameFile(storage_api, tmp_path, path);
+        if (err && has_backup)
+        {
+            int restore_err = storage_api->RenameFile(storage_api, backup_path, path);
+            if (restore_err)
+            {
+                LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to restore block ref count index from `%s`, failed with %d", backup_path, restore_err)
+            }
+        }
     }
-    err = InitStoreIndexFromData(store_index, &store_index[1], store_index_data_size);
-    storage_api->CloseFile(storage_api, file_handle);
     if (err)
     {
-        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "InitStoreIndexFromData() failed with %d", err)
-        Longtail_Free(store_index);
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Failed to write block ref count index, failed with %d", err)
+        storage_api->RemoveFile(storage_api, tmp_path);
+        Longtail_Free(updated_ref_count_index);
         return err;
     }
+    if (has_backup)
+    {
+        int remove_err = storage_api->RemoveFile(storage_api, backup_path);
+        if (remove_err)
+        {
+            LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_WARNING, "Failed to remove block ref count index backup `%s`, failed with %d", backup_path, remove_err)
+        }
+    }
+    if (out_ref_count_index)
+    {
+        *out_ref_count_index = updated_ref_count_index;
+    }
+    else
+    {
+        Longtail_Free(updated_ref_count_index);
+    }
+    return 0;
+}
 
-    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_DEBUG, "Read store index containing %u chunk in %u blocks",
-        *store_index->m_ChunkCount, *store_index->m_BlockCount)
+int Longtail_UpdateBlockRefCountIndex(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    uint32_t block_count,
+    const TLongtail_Hash* block_hashes,
+    int retire,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index)
+{
+    MAKE_LOG_CONTEXT_FIELDS(ctx)
+        LONGTAIL_LOGFIELD(storage_api, "%p"),
+        LONGTAIL_LOGFIELD(path, "%s"),
+        LONGTAIL_LOGFIELD(block_count, "%u"),
+        LONGTAIL_LOGFIELD(block_hashes, "%p"),
+        LONGTAIL_LOGFIELD(retire, "%d"),
+        LONGTAIL_LOGFIELD(out_ref_count_index, "%p")
+    MAKE_LOG_CONTEXT_WITH_FIELDS(ctx, 0, LONGTAIL_LOG_LEVEL_DEBUG)
 
-    *out_store_index = store_index;
+    LONGTAIL_VALIDATE_INPUT(ctx, storage_api != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, path != 0, return EINVAL)
+    LONGTAIL_VALIDATE_INPUT(ctx, block_count == 0 || block_hashes != 0, return EINVAL)
 
-    LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_INFO, "read %" PRIu64 " bytes", store_index_data_size)
+    char* lock_path = GetBlockRefCountIndexSiblingPath(path, ".lock");
+    char* tmp_path = GetBlockRefCountIndexSiblingPath(path, ".tmp");
+    char* backup_path = GetBlockRefCountIndexSiblingPath(path, ".bak");
+    if (!lock_path || !tmp_path || !backup_path)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "Longtail_Alloc() failed with %d", ENOMEM)
+        Longtail_Free(backup_path);
+        Longtail_Free(tmp_path);
+        Longtail_Free(lock_path);
+        return ENOMEM;
+    }
 
-    return 0;
+    int err = EnsureParentPathExists(storage_api, lock_path);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "EnsureParentPathExists() failed with %d", err)
+        Longtail_Free(backup_path);
+        Longtail_Free(tmp_path);
+        Longtail_Free(lock_path);
+        return err;
+    }
+    Longtail_StorageAPI_HLockFile lock_file;
+    err = storage_api->LockFile(storage_api, lock_path, &lock_file);
+    if (err)
+    {
+        LONGTAIL_LOG(ctx, LONGTAIL_LOG_LEVEL_ERROR, "storage_api->LockFile() failed with %d", err)
+        Longtail_Free(backup_path);
+        Longtail_Free(tmp_path);
+        Longtail_Free(lock_path);
+        return err;
+    }
+    err = UpdateBlockRefCountIndexLocked(storage_api, path, tmp_path, backup_path, block_count, block_hashes, retire, out_ref_count_index);
+    storage_api->UnlockFile(storage_api, lock_file);
+    Longtail_Free(backup_path);
+    Longtail_Free(tmp_path);
+    Longtail_Free(lock_path);
+    return err;
 }
 
 LONGTAIL_EXPORT int Longtail_CreateArchiveIndex(
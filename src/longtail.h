@@ -332,6 +332,12 @@ struct Longtail_StorageAPI_EntryProperties
     int m_IsDir;
 };
 
+struct Longtail_StorageAPI_IOVec
+{
+    const void* m_Data;
+    uint64_t m_Length;
+};
+
 struct Longtail_StorageAPI;
 
 typedef int (*Longtail_Storage_OpenReadFileFunc)(struct Longtail_StorageAPI* storage_api, const char* path, Longtail_StorageAPI_HOpenFile* out_open_file);
@@ -360,6 +366,8 @@ typedef char* (*Longtail_Storage_GetParentPathFunc)(struct Longtail_StorageAPI*
 typedef int (*Longtail_Storage_MapFileFunc)(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HOpenFile f, uint64_t offset, uint64_t length, Longtail_StorageAPI_HFileMap* out_file_map, const void** out_data_ptr);
 typedef void (*Longtail_Storage_UnmapFileFunc)(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HFileMap m);
 typedef int (*Longtail_Storage_OpenAppendFileFunc)(struct Longtail_StorageAPI* storage_api, const char* path, Longtail_StorageAPI_HOpenFile* out_open_file);
+typedef int (*Longtail_Storage_WriteVFunc)(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HOpenFile f, uint64_t offset, uint32_t vec_count, const struct Longtail_StorageAPI_IOVec* vecs);
+typedef int (*Longtail_Storage_GetFileStatFunc)(struct Longtail_StorageAPI* storage_api, const char* path, uint64_t* out_size, uint64_t* out_modification_time, uint64_t* out_change_time, uint64_t* out_file_id);
 
 struct Longtail_StorageAPI
 {
@@ -390,6 +398,8 @@ struct Longtail_StorageAPI
     Longtail_Storage_MapFileFunc MapFile;
     Longtail_Storage_UnmapFileFunc UnMapFile;
     Longtail_Storage_OpenAppendFileFunc OpenAppendFile;
+    Longtail_Storage_WriteVFunc WriteV;
+    Longtail_Storage_GetFileStatFunc GetFileStat;
 };
 
 LONGTAIL_EXPORT uint64_t Longtail_GetStorageAPISize();
@@ -422,7 +432,9 @@ LONGTAIL_EXPORT struct Longtail_StorageAPI* Longtail_MakeStorageAPI(
     Longtail_Storage_GetParentPathFunc get_parent_path_func,
     Longtail_Storage_MapFileFunc map_file_func,
     Longtail_Storage_UnmapFileFunc unmap_file_func,
-    Longtail_Storage_OpenAppendFileFunc open_append_file_func);
+    Longtail_Storage_OpenAppendFileFunc open_append_file_func,
+    Longtail_Storage_WriteVFunc write_v_func,
+    Longtail_Storage_GetFileStatFunc get_file_stat_func);
 
 LONGTAIL_EXPORT int Longtail_Storage_OpenReadFile(struct Longtail_StorageAPI* storage_api, const char* path, Longtail_StorageAPI_HOpenFile* out_open_file);
 LONGTAIL_EXPORT int Longtail_Storage_GetSize(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HOpenFile f, uint64_t* out_size);
@@ -450,6 +462,8 @@ LONGTAIL_EXPORT char* Longtail_Storage_GetParentPath(struct Longtail_StorageAPI*
 LONGTAIL_EXPORT int Longtail_Storage_MapFile(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HOpenFile f, uint64_t offset, uint64_t length, Longtail_StorageAPI_HFileMap* out_file_map, const void** out_data_ptr);
 LONGTAIL_EXPORT void Longtail_Storage_UnmapFile(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HFileMap m);
 LONGTAIL_EXPORT int Longtail_Storage_OpenAppendFile(struct Longtail_StorageAPI* storage_api, const char* path, Longtail_StorageAPI_HOpenFile* out_open_file);
+LONGTAIL_EXPORT int Longtail_Storage_WriteV(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HOpenFile f, uint64_t offset, uint32_t vec_count, const struct Longtail_StorageAPI_IOVec* vecs);
+LONGTAIL_EXPORT int Longtail_Storage_GetFileStat(struct Longtail_StorageAPI* storage_api, const char* path, uint64_t* out_size, uint64_t* out_modification_time, uint64_t* out_change_time, uint64_t* out_file_id);
 
 ////////////// Longtail_ConcurrentChunkWriteAPI
 
@@ -460,6 +474,7 @@ typedef int (*Longtail_ConcurrentChunkWrite_OpenFunc)(struct Longtail_Concurrent
 typedef void (*Longtail_ConcurrentChunkWrite_CloseFunc)(struct Longtail_ConcurrentChunkWriteAPI* concurrent_file_write_api, uint32_t asset_index);
 typedef int (*Longtail_ConcurrentChunkWrite_WriteFunc)(struct Longtail_ConcurrentChunkWriteAPI* concurrent_file_write_api, uint32_t asset_index, uint64_t offset, uint32_t size, const void* input);
 typedef int (*Longtail_ConcurrentChunkWrite_FlushFunc)(struct Longtail_ConcurrentChunkWriteAPI* concurrent_file_write_api);
+typedef int (*Longtail_ConcurrentChunkWrite_WriteVFunc)(struct Longtail_ConcurrentChunkWriteAPI* concurrent_file_write_api, uint32_t asset_index, uint64_t offset, uint32_t vec_count, const struct Longtail_StorageAPI_IOVec* vecs);
 
 struct Longtail_ConcurrentChunkWriteAPI
 {
@@ -469,6 +484,7 @@ struct Longtail_ConcurrentChunkWriteAPI
     Longtail_ConcurrentChunkWrite_CloseFunc Close;
     Longtail_ConcurrentChunkWrite_WriteFunc Write;
     Longtail_ConcurrentChunkWrite_FlushFunc Flush;
+    Longtail_ConcurrentChunkWrite_WriteVFunc WriteV;
 };
 
 LONGTAIL_EXPORT uint64_t Longtail_GetConcurrentChunkWriteAPISize();
@@ -480,7 +496,8 @@ LONGTAIL_EXPORT struct Longtail_ConcurrentChunkWriteAPI* Longtail_MakeConcurrent
     Longtail_ConcurrentChunkWrite_OpenFunc open_func,
     Longtail_ConcurrentChunkWrite_CloseFunc close_func,
     Longtail_ConcurrentChunkWrite_WriteFunc write_func,
-    Longtail_ConcurrentChunkWrite_FlushFunc flush_func
+    Longtail_ConcurrentChunkWrite_FlushFunc flush_func,
+    Longtail_ConcurrentChunkWrite_WriteVFunc write_v_func
 );
 
 LONGTAIL_EXPORT int Longtail_ConcurrentChunkWrite_CreateDir(struct Longtail_ConcurrentChunkWriteAPI* concurrent_file_write_api, uint32_t asset_index);
@@ -488,6 +505,7 @@ LONGTAIL_EXPORT int Longtail_ConcurrentChunkWrite_Open(struct Longtail_Concurren
 LONGTAIL_EXPORT void Longtail_ConcurrentChunkWrite_Close(struct Longtail_ConcurrentChunkWriteAPI* concurrent_file_write_api, uint32_t asset_index);
 LONGTAIL_EXPORT int Longtail_ConcurrentChunkWrite_Write(struct Longtail_ConcurrentChunkWriteAPI* concurrent_file_write_api, uint32_t asset_index, uint64_t offset, uint32_t size, const void* input);
 LONGTAIL_EXPORT int Longtail_ConcurrentChunkWrite_Flush(struct Longtail_ConcurrentChunkWriteAPI* concurrent_file_write_api);
+LONGTAIL_EXPORT int Longtail_ConcurrentChunkWrite_WriteV(struct Longtail_ConcurrentChunkWriteAPI* concurrent_file_write_api, uint32_t asset_index, uint64_t offset, uint32_t vec_count, const struct Longtail_StorageAPI_IOVec* vecs);
 
 ////////////// Longtail_ProgressAPI
 
@@ -785,6 +803,18 @@ typedef int (*Longtail_BlockStore_GetExistingContentFunc)(struct Longtail_BlockS
 typedef int (*Longtail_BlockStore_PruneBlocksFunc)(struct Longtail_BlockStoreAPI* block_store_api, uint32_t block_keep_count, const TLongtail_Hash* block_keep_hashes, struct Longtail_AsyncPruneBlocksAPI* async_complete_api);
 typedef int (*Longtail_BlockStore_GetStatsFunc)(struct Longtail_BlockStoreAPI* block_store_api, struct Longtail_BlockStore_Stats* out_stats);
 typedef int (*Longtail_BlockStore_FlushFunc)(struct Longtail_BlockStoreAPI* block_store_api, struct Longtail_AsyncFlushAPI* async_complete_api);
+// Optional, gets a block with its chunk data placed in the caller owned buffer, buffer_size must be at least the block chunk data size.
+// The buffer must stay valid until the returned block has been disposed. Set by block stores that can produce the block data
+// directly into the buffer after Longtail_MakeBlockStoreAPI, which leaves it unset. Wrapping block stores forward it when the
+// store they wrap sets it. A store may complete with a block it already holds (such as a cached block) or a block it had to
+// decode, so callers must check if m_BlockData points into buffer.
+// Block stores that do not use Longtail_MakeBlockStoreAPI must set it and GetStoredBlockChunkRange to zero.
+typedef int (*Longtail_BlockStore_GetStoredBlockToBufferFunc)(struct Longtail_BlockStoreAPI* block_store_api, uint64_t block_hash, void* buffer, uint32_t buffer_size, struct Longtail_AsyncGetStoredBlockAPI* async_complete_api);
+// Optional, gets the chunk_count chunks starting at first_chunk_index of a block, the completed block has the block hash but only
+// needs to hold the chunks in the range so the block store can skip decoding the rest of the block. A store may complete with a block
+// holding more chunks (such as a whole block it already holds), callers must find the chunks by hash in the returned block index.
+// Longtail_MakeBlockStoreAPI leaves it unset, wrapping block stores forward it when the store they wrap sets it.
+typedef int (*Longtail_BlockStore_GetStoredBlockChunkRangeFunc)(struct Longtail_BlockStoreAPI* block_store_api, uint64_t block_hash, uint32_t first_chunk_index, uint32_t chunk_count, struct Longtail_AsyncGetStoredBlockAPI* async_complete_api);
 
 struct Longtail_BlockStoreAPI
 {
@@ -796,6 +826,8 @@ struct Longtail_BlockStoreAPI
     Longtail_BlockStore_PruneBlocksFunc PruneBlocks;
     Longtail_BlockStore_GetStatsFunc GetStats;
     Longtail_BlockStore_FlushFunc Flush;
+    Longtail_BlockStore_GetStoredBlockToBufferFunc GetStoredBlockToBuffer;
+    Longtail_BlockStore_GetStoredBlockChunkRangeFunc GetStoredBlockChunkRange;
 };
 
 
@@ -819,6 +851,10 @@ LONGTAIL_EXPORT int Longtail_BlockStore_GetExistingContent(struct Longtail_Block
 LONGTAIL_EXPORT int Longtail_BlockStore_PruneBlocks(struct Longtail_BlockStoreAPI* block_store_api, uint32_t block_keep_count, const TLongtail_Hash* block_keep_hashes,  struct Longtail_AsyncPruneBlocksAPI* async_complete_api);
 LONGTAIL_EXPORT int Longtail_BlockStore_GetStats(struct Longtail_BlockStoreAPI* block_store_api, struct Longtail_BlockStore_Stats* out_stats);
 LONGTAIL_EXPORT int Longtail_BlockStore_Flush(struct Longtail_BlockStoreAPI* block_store_api, struct Longtail_AsyncFlushAPI* async_complete_api);
+// Returns ENOTSUP if the block store does not implement GetStoredBlockToBuffer
+LONGTAIL_EXPORT int Longtail_BlockStore_GetStoredBlockToBuffer(struct Longtail_BlockStoreAPI* block_store_api, uint64_t block_hash, void* buffer, uint32_t buffer_size, struct Longtail_AsyncGetStoredBlockAPI* async_complete_api);
+// Returns ENOTSUP if the block store does not implement GetStoredBlockChunkRange
+LONGTAIL_EXPORT int Longtail_BlockStore_GetStoredBlockChunkRange(struct Longtail_BlockStoreAPI* block_store_api, uint64_t block_hash, uint32_t first_chunk_index, uint32_t chunk_count, struct Longtail_AsyncGetStoredBlockAPI* async_complete_api);
 
 typedef void (*Longtail_Assert)(const char* expression, const char* file, int line);
 LONGTAIL_EXPORT void Longtail_SetAssert(Longtail_Assert assert_func);
@@ -973,6 +1009,102 @@ LONGTAIL_EXPORT void* Longtail_ReAlloc(const char* context, void* old, size_t s)
 
 LONGTAIL_EXPORT void Longtail_Free(void* p);
 
+/*! @brief Scratch arena for transient work memory.
+ *
+ * A bump allocator backed by memory from Longtail_Alloc(). Allocations are released
+ * all at once by resetting the arena to a previously captured mark. When the arena
+ * has to grow past its first block, the blocks are merged into one block sized to
+ * the peak usage the next time the arena is reset to empty, so a reused arena stops
+ * allocating once it has seen its largest workload.
+ *
+ * A scratch arena is not thread safe, use one arena per thread or per operation.
+ */
+struct Longtail_ScratchArena;
+
+/*! @brief Creates a scratch arena.
+ *
+ * @param[in] initial_capacity  Size in bytes of the first block of the arena, zero to allocate on first use
+ * @return                      Pointer to the arena, zero if out of memory
+ */
+LONGTAIL_EXPORT struct Longtail_ScratchArena* Longtail_CreateScratchArena(size_t initial_capacity);
+
+/*! @brief Disposes a scratch arena and all memory allocated from it.
+ *
+ * @param[in] arena             Pointer to a struct Longtail_ScratchArena
+ */
+LONGTAIL_EXPORT void Longtail_DisposeScratchArena(struct Longtail_ScratchArena* arena);
+
+/*! @brief Allocates memory from a scratch arena.
+ *
+ * The memory is aligned to 16 bytes and is valid until the arena is reset to a mark captured before the allocation.
+ *
+ * @param[in] arena             Pointer to a struct Longtail_ScratchArena
+ * @param[in] size              Size in bytes to allocate
+ * @return                      Pointer to the memory, zero if out of memory
+ */
+LONGTAIL_EXPORT void* Longtail_ScratchArena_Alloc(struct Longtail_ScratchArena* arena, size_t size);
+
+/*! @brief Gets the current allocation mark of a scratch arena.
+ *
+ * @param[in] arena             Pointer to a struct Longtail_ScratchArena
+ * @return                      Number of bytes currently in use in the arena
+ */
+LONGTAIL_EXPORT size_t Longtail_ScratchArena_GetMark(struct Longtail_ScratchArena* arena);
+
+/*! @brief Releases all allocations made after @p mark was captured.
+ *
+ * Resetting to zero merges the blocks of the arena into one block sized to the peak usage. If that block
+ * can not be allocated the arena is still reset to empty and keeps its first block, and ENOMEM is returned.
+ *
+ * @param[in] arena             Pointer to a struct Longtail_ScratchArena
+ * @param[in] mark              A mark returned from Longtail_ScratchArena_GetMark()
+ * @return                      Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_ScratchArena_ResetToMark(struct Longtail_ScratchArena* arena, size_t mark);
+
+/*! @brief Gets the peak number of bytes in use since the arena was created or the peak was last reset.
+ *
+ * @param[in] arena             Pointer to a struct Longtail_ScratchArena
+ * @return                      Peak usage in bytes
+ */
+LONGTAIL_EXPORT size_t Longtail_ScratchArena_GetPeakUsage(struct Longtail_ScratchArena* arena);
+
+/*! @brief Sets the peak usage of the arena to its current usage.
+ *
+ * @param[in] arena             Pointer to a struct Longtail_ScratchArena
+ */
+LONGTAIL_EXPORT void Longtail_ScratchArena_ResetPeakUsage(struct Longtail_ScratchArena* arena);
+
+typedef struct Longtail_ScratchArena* (*Longtail_ScratchArena_AcquireFunc)(void* context, const char* operation, size_t size_hint);
+typedef void (*Longtail_ScratchArena_ReleaseFunc)(void* context, const char* operation, struct Longtail_ScratchArena* arena, size_t peak_usage);
+
+/*! @brief Sets the provider of scratch arenas used by longtail operations.
+ *
+ * Operations such as Longtail_CreateStoreIndex(), Longtail_GetExistingStoreIndex(), Longtail_CreateVersionIndex()
+ * and Longtail_CreateVersionDiff() acquire a scratch arena for their temporary memory and release it before returning.
+ * All memory the operation allocated from the arena is released before @p release_func is called, and
+ * @p peak_usage is the peak number of bytes the operation used from the arena.
+ *
+ * By default arenas are taken from a pool shared by all threads, an operation on a worker reuses the arena
+ * released by the previous operation so the temporary memory is only allocated once per concurrent operation.
+ * Setting a provider that hands out a per-thread arena gives the same reuse with memory owned by the caller.
+ *
+ * Not thread safe, call it before starting or after finishing all longtail operations. Any arenas pooled by
+ * the default provider are disposed.
+ *
+ * @param[in] acquire_func      Function returning an arena for @p operation, zero restores the default provider
+ * @param[in] release_func      Function called when @p operation is done with the arena, zero restores the default provider
+ * @param[in] context           Context passed to @p acquire_func and @p release_func
+ */
+LONGTAIL_EXPORT void Longtail_SetScratchArenaProvider(Longtail_ScratchArena_AcquireFunc acquire_func, Longtail_ScratchArena_ReleaseFunc release_func, void* context);
+
+/*! @brief Disposes the scratch arenas pooled by the default scratch arena provider.
+ *
+ * Call it when no longtail operations are running to release the pooled memory, for example before checking for leaks.
+ * Longtail_SetReAllocAndFree() and Longtail_SetScratchArenaProvider() dispose the pool as well.
+ */
+LONGTAIL_EXPORT void Longtail_DisposeScratchArenaPool();
+
 /*! @brief Ensures the full parent path exists.
  *
  * Creates any parent directories for @p path if they do not exist.
@@ -1146,6 +1278,24 @@ LONGTAIL_EXPORT int Longtail_CreateVersionIndex(
     int enable_file_map,
     struct Longtail_VersionIndex** out_version_index);
 
+/*! @brief Classify assets by content type to derive asset tags for Longtail_CreateVersionIndex().
+ *
+ * Files with an extension of an already compressed media or archive format (.png, .jpg, .ogg, .bk2, .zip etc)
+ * are tagged with @p compressed_content_tag, all other assets are tagged with @p default_tag. Use zero for
+ * @p compressed_content_tag to store already compressed content without spending time compressing it again.
+ *
+ * @param[in] file_infos                Pointer to am initialized Longtail_FileInfos structure
+ * @param[in] default_tag               The tag for assets that are not classified as compressed content
+ * @param[in] compressed_content_tag    The tag for assets that are classified as compressed content
+ * @param[out] out_asset_tags           An array with room for one tag for each entry in @p file_infos
+ * @return                              Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_GetContentTypeAssetTags(
+    const struct Longtail_FileInfos* file_infos,
+    uint32_t default_tag,
+    uint32_t compressed_content_tag,
+    uint32_t* out_asset_tags);
+
 
 /*! @brief Merges (adds) the content of an version index on top of an existing version index.
  *
@@ -1227,6 +1377,281 @@ LONGTAIL_EXPORT int Longtail_ReadVersionIndex(
     const char* path,
     struct Longtail_VersionIndex** out_version_index);
 
+/*! @brief Serializes a struct Longtail_VersionIndex to a compact byte buffer.
+ *
+ * The compact encoding stores each array of the version index as a separate section, sizes, counts and indexes
+ * as (delta) varints, chunk tags and permissions run length encoded and paths front coded against the previous path.
+ * Hashes are stored as is. Each section is optionally compressed with @p compression_type and located through a
+ * section table so Longtail_ReadVersionIndexSections() can read only the sections it needs. The compact encoding
+ * also stores the path directory of the version index, see Longtail_CreateVersionIndexPathDirectory().
+ * Compact version indexes are read with Longtail_ReadVersionIndexFromBuffer2() and Longtail_ReadVersionIndex2().
+ *
+ * @param[in] version_index                 Pointer to an initialized struct Longtail_VersionIndex
+ * @param[in] optional_compression_registry Compression registry used to resolve @p compression_type, may be null if @p compression_type is zero
+ * @param[in] compression_type              Compression type of the payload, zero for uncompressed
+ * @param[out] out_buffer                   Pointer to a buffer pointer intitialized on success
+ * @param[out] out_size                     Pointer to a size variable intitialized on success
+ * @return                                  Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_WriteCompactVersionIndexToBuffer(
+    const struct Longtail_VersionIndex* version_index,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    uint32_t compression_type,
+    void** out_buffer,
+    size_t* out_size);
+
+/*! @brief Writes a struct Longtail_VersionIndex using the compact encoding.
+ *
+ * See Longtail_WriteCompactVersionIndexToBuffer()
+ *
+ * @param[in] storage_api                   An initialized struct Longtail_StorageAPI
+ * @param[in] version_index                 Pointer to an initialized struct Longtail_VersionIndex
+ * @param[in] optional_compression_registry Compression registry used to resolve @p compression_type, may be null if @p compression_type is zero
+ * @param[in] compression_type              Compression type of the payload, zero for uncompressed
+ * @param[in] path                          A path in the storage api to store the version index to
+ * @return                                  Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_WriteCompactVersionIndex(
+    struct Longtail_StorageAPI* storage_api,
+    const struct Longtail_VersionIndex* version_index,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    uint32_t compression_type,
+    const char* path);
+
+/*! @brief Reads a struct Longtail_VersionIndex in either the plain or the compact encoding from a byte buffer.
+ *
+ * A compressed compact version index requires @p optional_compression_registry. If @p optional_job_api is given the
+ * sections of a compact version index are decoded in parallel.
+ *
+ * @param[in] buffer                        Buffer containing the serialized struct Longtail_VersionIndex
+ * @param[in] size                          Size of the buffer
+ * @param[in] optional_compression_registry Compression registry for compressed compact version indexes, may be null
+ * @param[in] optional_job_api              Job API used to decode sections in parallel, may be null
+ * @param[out] out_version_index            Pointer to an struct Longtail_VersionIndex pointer
+ * @return                                  Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_ReadVersionIndexFromBuffer2(
+    const void* buffer,
+    size_t size,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    struct Longtail_VersionIndex** out_version_index);
+
+/*! @brief Reads a struct Longtail_VersionIndex in either the plain or the compact encoding.
+ *
+ * See Longtail_ReadVersionIndexFromBuffer2()
+ *
+ * @param[in] storage_api                   An initialized struct Longtail_StorageAPI
+ * @param[in] optional_compression_registry Compression registry for compressed compact version indexes, may be null
+ * @param[in] optional_job_api              Job API used to decode sections in parallel, may be null
+ * @param[in] path                          A path in the storage api to read the version index from
+ * @param[out] out_version_index            Pointer to an struct Longtail_VersionIndex pointer
+ * @return                                  Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_ReadVersionIndex2(
+    struct Longtail_StorageAPI* storage_api,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    const char* path,
+    struct Longtail_VersionIndex** out_version_index);
+
+enum
+{
+    Longtail_VersionIndex_AssetSections      = 1,   // m_PathHashes, m_ContentHashes, m_AssetSizes, m_Permissions, m_NameOffsets and m_NameData
+    Longtail_VersionIndex_AssetChunkSections = 2,   // m_AssetChunkCounts, m_AssetChunkIndexStarts and m_AssetChunkIndexes
+    Longtail_VersionIndex_ChunkSections      = 4,   // m_ChunkHashes, m_ChunkSizes and m_ChunkTags
+    Longtail_VersionIndex_AllSections        = 7
+};
+
+/*! @brief Reads selected sections of a struct Longtail_VersionIndex.
+ *
+ * For a compact version index only the section table and the requested sections are read from the file, the arrays
+ * of the sections that are not requested are null in the returned version index. A version index in the plain
+ * encoding is read in full.
+ * A version index with all sections can be used as any other version index, with fewer sections it can only be
+ * used by code that reads the requested arrays, such as listing the assets with only Longtail_VersionIndex_AssetSections.
+ *
+ * @param[in] storage_api                   An initialized struct Longtail_StorageAPI
+ * @param[in] optional_compression_registry Compression registry for compressed compact version indexes, may be null
+ * @param[in] optional_job_api              Job API used to decode sections in parallel, may be null
+ * @param[in] path                          A path in the storage api to read the version index from
+ * @param[in] section_flags                 Longtail_VersionIndex_*Sections flags of the sections to read
+ * @param[out] out_version_index            Pointer to an struct Longtail_VersionIndex pointer
+ * @param[out] out_optional_path_directory  Pointer to a path directory pointer, requires Longtail_VersionIndex_AssetSections, may be null
+ * @return                                  Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_ReadVersionIndexSections(
+    struct Longtail_StorageAPI* storage_api,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    const char* path,
+    uint32_t section_flags,
+    struct Longtail_VersionIndex** out_version_index,
+    uint32_t** out_optional_path_directory);
+
+/*! @brief Creates the path directory of a version index.
+ *
+ * The path directory is the asset indexes of @p version_index sorted by path, the assets of a folder are consecutive
+ * in the path directory. Free it with Longtail_Free().
+ *
+ * @param[in] version_index         Pointer to a struct Longtail_VersionIndex with at least Longtail_VersionIndex_AssetSections
+ * @param[out] out_path_directory   Pointer to a path directory pointer, an array of *version_index->m_AssetCount asset indexes
+ * @return                          Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_CreateVersionIndexPathDirectory(
+    const struct Longtail_VersionIndex* version_index,
+    uint32_t** out_path_directory);
+
+/*! @brief Finds a file or the content of a folder in a version index in O(log n).
+ *
+ * If @p path is a file in the version index the range is that file, otherwise the range is all assets in the folder
+ * @p path, including the folder itself. An empty @p path is the root folder.
+ *
+ * @param[in] version_index     Pointer to a struct Longtail_VersionIndex with at least Longtail_VersionIndex_AssetSections
+ * @param[in] path_directory    The path directory of @p version_index
+ * @param[in] path              A file or folder path, a trailing '/' is optional for folders
+ * @param[out] out_first        Pointer to the index in @p path_directory of the first matching asset
+ * @param[out] out_count        Pointer to the number of matching assets, zero if nothing matches
+ * @return                      Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_FindVersionIndexPaths(
+    const struct Longtail_VersionIndex* version_index,
+    const uint32_t* path_directory,
+    const char* path,
+    uint32_t* out_first,
+    uint32_t* out_count);
+
+/*! @brief Creates a version index with the subset of assets selected by a path filter.
+ *
+ * Applies @p path_filter_api with the same rules as Longtail_GetFilesRecursively2(): paths are passed without the
+ * trailing '/' of folders and an excluded folder excludes everything in it. The filtered version index only holds
+ * the chunks used by the selected assets so it can be diffed and synced like a full version, filter both the source
+ * and target version index with the same filter to leave assets outside the filter untouched.
+ *
+ * The struct Longtail_VersionIndex @p out_version_index is allocated using Longtail_Alloc()
+ *
+ * @param[in] version_index         Pointer to an initialized struct Longtail_VersionIndex
+ * @param[in] path_filter_api       An implementation of struct Longtail_PathFilterAPI interface
+ * @param[in] root_path             The root path passed to @p path_filter_api
+ * @param[out] out_version_index    Pointer to an struct Longtail_VersionIndex pointer
+ * @return                          Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_FilterVersionIndex(
+    const struct Longtail_VersionIndex* version_index,
+    struct Longtail_PathFilterAPI* path_filter_api,
+    const char* root_path,
+    struct Longtail_VersionIndex** out_version_index);
+
+/*! @brief Stat information of the files of a folder at the time a version index was written to it.
+ *
+ * Holds the modification time, change time and file id (inode on posix, file index on Windows) of each asset in the
+ * version index written to a folder, in the asset order of the version index. Folders and files that could not be
+ * stat'ed have a zero modification time and are never treated as unchanged.
+ * A file whose path, size, permissions, modification time, change time and file id all match its entry in the folder
+ * state is assumed to have the content recorded in the version index and is not read when indexing the folder again.
+ * A file modified at or after m_WriteTime could have been changed again within the same timestamp granularity
+ * without its modification time changing, it is always read.
+ */
+struct Longtail_FolderState
+{
+    uint32_t* m_Version;
+    uint32_t* m_AssetCount;
+    uint64_t* m_ModificationTimes;  // []
+    uint64_t* m_ChangeTimes;        // []
+    uint64_t* m_FileIds;            // []
+    uint64_t m_WriteTime;           // Modification time of the folder state file, set by Longtail_ReadFolderState(), zero if not read
+};
+
+LONGTAIL_EXPORT size_t Longtail_GetFolderStateSize(uint32_t asset_count);
+
+/*! @brief Creates a struct Longtail_FolderState by stat'ing the assets of a version index in a folder.
+ *
+ * Call this right after @p version_index has been written to @p root_path, for example after Longtail_ChangeVersion2().
+ *
+ * @param[in] storage_api           An initialized struct Longtail_StorageAPI
+ * @param[in] root_path             The folder @p version_index was written to
+ * @param[in] version_index         Pointer to an initialized struct Longtail_VersionIndex
+ * @param[out] out_folder_state     Pointer to a struct Longtail_FolderState pointer, allocated using Longtail_Alloc()
+ * @return                          Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_CreateFolderState(
+    struct Longtail_StorageAPI* storage_api,
+    const char* root_path,
+    const struct Longtail_VersionIndex* version_index,
+    struct Longtail_FolderState** out_folder_state);
+
+/*! @brief Writes a struct Longtail_FolderState together with its version index.
+ *
+ * @param[in] storage_api           An initialized struct Longtail_StorageAPI
+ * @param[in] version_index         The version index @p folder_state was created from
+ * @param[in] folder_state          Pointer to an initialized struct Longtail_FolderState
+ * @param[in] path                  A path in the storage api to write the folder state to
+ * @return                          Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_WriteFolderState(
+    struct Longtail_StorageAPI* storage_api,
+    const struct Longtail_VersionIndex* version_index,
+    const struct Longtail_FolderState* folder_state,
+    const char* path);
+
+/*! @brief Reads a struct Longtail_FolderState and its version index written by Longtail_WriteFolderState().
+ *
+ * The modification time of the file at @p path is used as the write time of the folder state.
+ *
+ * @param[in] storage_api           An initialized struct Longtail_StorageAPI
+ * @param[in] path                  A path in the storage api to read the folder state from
+ * @param[out] out_version_index    Pointer to a struct Longtail_VersionIndex pointer, allocated using Longtail_Alloc()
+ * @param[out] out_folder_state     Pointer to a struct Longtail_FolderState pointer, allocated using Longtail_Alloc()
+ * @return                          Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_ReadFolderState(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    struct Longtail_VersionIndex** out_version_index,
+    struct Longtail_FolderState** out_folder_state);
+
+/*! @brief Creates a version index of a folder, reusing the assets that are unchanged since a folder state was created.
+ *
+ * Same as Longtail_CreateVersionIndex() but files that are unchanged according to @p folder_state are taken from
+ * @p state_version_index instead of being read and hashed, only new and modified files are read.
+ * Nothing is reused if @p state_version_index uses a different hash api or target chunk size. Files are only reused
+ * if they were modified before the write time of @p folder_state, so a folder state that was not read with
+ * Longtail_ReadFolderState() reuses no files.
+ *
+ * @param[in] storage_api           An implementation of struct Longtail_StorageAPI interface.
+ * @param[in] hash_api              An implementation of struct Longtail_HashAPI interface.
+ * @param[in] chunker_api           An implementation of struct Longtail_ChunkerAPI interface.
+ * @param[in] job_api               An implementation of struct Longtail_JobAPI interface
+ * @param[in] progress_api          An implementation of struct Longtail_JobAPI interface or null if no progress indication is required
+ * @param[in] optional_cancel_api   An implementation of struct Longtail_CancelAPI interface or null if no cancelling is required
+ * @param[in] optional_cancel_token A cancel token or null if @p optional_cancel_api is null
+ * @param[in] root_path             Root path for files in @p file_infos
+ * @param[in] file_infos            Pointer to am initialized Longtail_FileInfos structure
+ * @param[in] optional_asset_tags   An array with a tag for each entry in @p file_infos, or null if no tags are wanted
+ * @param[in] target_chunk_size     The target size of chunks
+ * @param[in] enable_file_map       Enable memory mapping when reading files, only has effect if storage_api supports memory mapping
+ * @param[in] state_version_index   The version index read by Longtail_ReadFolderState()
+ * @param[in] folder_state          The folder state read by Longtail_ReadFolderState()
+ * @param[out] out_version_index    Pointer to a struct Longtail_VersionIndex* pointer which will be set on success
+ * @return                          Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_CreateVersionIndexFromFolderState(
+    struct Longtail_StorageAPI* storage_api,
+    struct Longtail_HashAPI* hash_api,
+    struct Longtail_ChunkerAPI* chunker_api,
+    struct Longtail_JobAPI* job_api,
+    struct Longtail_ProgressAPI* progress_api,
+    struct Longtail_CancelAPI* optional_cancel_api,
+    Longtail_CancelAPI_HCancelToken optional_cancel_token,
+    const char* root_path,
+    const struct Longtail_FileInfos* file_infos,
+    const uint32_t* optional_asset_tags,
+    uint32_t target_chunk_size,
+    int enable_file_map,
+    const struct Longtail_VersionIndex* state_version_index,
+    const struct Longtail_FolderState* folder_state,
+    struct Longtail_VersionIndex** out_version_index);
+
 /*! @brief Get the chunks required to go to @p version_index by applying @p version_diff.
  *
  * Gets all the chunks required to apply @p version_diff which is a subset of all chunks in @p version_index
@@ -1359,12 +1784,33 @@ LONGTAIL_EXPORT int Longtail_CreateVersionDiff(
     const struct Longtail_VersionIndex* target_version,
     struct Longtail_VersionDiff** out_version_diff);
 
+/*! @brief Get the difference between to struct Longtail_VersionIndex, optionally detecting moved assets.
+ *
+ * Same as Longtail_CreateVersionDiff but if @p detect_moved_assets is set, a removed asset and an added asset
+ * with identical content hash and size are paired up as a moved asset instead of being reported as removed and added.
+ * Directories and empty files are never paired up.
+ *
+ * @param[in] hash_api             An implementation of struct Longtail_HashAPI interface
+ * @param[in] source_version       The version index we have
+ * @param[in] target_version       The version index we want
+ * @param[in] detect_moved_assets  Flag for detecting moved assets - 0 = report as removed and added, 1 = report as moved
+ * @param[out] out_version_diff    The resulting diff between @p source_version and @p target_version
+ * @return                         Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_CreateVersionDiff2(
+    struct Longtail_HashAPI* hash_api,
+    const struct Longtail_VersionIndex* source_version,
+    const struct Longtail_VersionIndex* target_version,
+    int detect_moved_assets,
+    struct Longtail_VersionDiff** out_version_diff);
+
 /*! @brief Unpack and modify a version.
  *
  * Applies the changes from @p version_diff to change a version from @p source_version to @p target_version.
  * Uses @p store_index to know where chunks are located in blocks - this can either be the full
  * store index of @p block_storage_api or a store index that is slimmed down using Longtail_BlockStore_GetExistingContent.
  * Blocks are fetched from @p block_storage_api on demand.
+ * Moved assets in @p version_diff (see Longtail_CreateVersionDiff2) are renamed in place without fetching any blocks.
  *
  * @param[in] block_storage_api     An implementation of struct Longtail_BlockStoreAPI interface
  * @param[in] version_storage_api   An implementation of struct Longtail_StorageAPI interface
@@ -1412,6 +1858,36 @@ LONGTAIL_EXPORT int Longtail_ChangeVersion2(
     const char* version_path,
     int retain_permissions);
 
+/*! @brief Unpack and modify a version, reusing chunks found in the current version.
+ *
+ * Same as Longtail_ChangeVersion2 but if @p use_local_chunks is set, chunks that exist in the files of
+ * @p source_version are copied from @p version_path instead of being fetched from @p block_store_api.
+ * Files that are about to be removed or overwritten are moved to a staging folder inside @p version_path
+ * until their chunks have been copied. Each copied chunk is hashed and if it does not match, because the
+ * content of @p version_path no longer matches @p source_version, the chunk is fetched from @p block_store_api instead.
+ * @p store_index must therefore hold all the chunks needed by @p version_diff.
+ * If the change fails, staged files are moved back to their original location.
+ *
+ * @param[in] use_local_chunks      Flag for copying chunks from the current version - 0 = fetch all chunks from blocks, 1 = copy chunks from local files when possible
+ * @return                          Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_ChangeVersion3(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    struct Longtail_StorageAPI* version_storage_api,
+    struct Longtail_ConcurrentChunkWriteAPI* concurrent_chunk_write_api,
+    struct Longtail_HashAPI* hash_api,
+    struct Longtail_JobAPI* job_api,
+    struct Longtail_ProgressAPI* progress_api,
+    struct Longtail_CancelAPI* optional_cancel_api,
+    Longtail_CancelAPI_HCancelToken optional_cancel_token,
+    const struct Longtail_StoreIndex* store_index,
+    const struct Longtail_VersionIndex* source_version,
+    const struct Longtail_VersionIndex* target_version,
+    const struct Longtail_VersionDiff* version_diff,
+    const char* version_path,
+    int retain_permissions,
+    int use_local_chunks);
+
 /*! @brief Get the size of the block index data.
  *
  * This size is just for the data of the block index excluding the struct Longtail_BlockIndex.
@@ -1591,6 +2067,18 @@ LONGTAIL_EXPORT int Longtail_CreateStoredBlock(
     uint32_t block_data_size,
     struct Longtail_StoredBlock** out_stored_block);
 
+/*! @brief Checks that the block data of a struct Longtail_StoredBlock holds the chunks of its block index.
+ *
+ * The block data size must be the sum of the chunk sizes in the block index. Blocks that are still encoded by a block
+ * store layer, such as compressed blocks read without a compress block store or delta blocks read without a
+ * delta block store, fail the check instead of being read with chunk offsets outside of the block data.
+ *
+ * @param[in] stored_block  Pointer to an initialized struct Longtail_StoredBlock
+ * @return                  Return code (errno style), zero if the block data matches, EBADF if not
+ */
+LONGTAIL_EXPORT int Longtail_ValidateStoredBlockData(
+    const struct Longtail_StoredBlock* stored_block);
+
 /*! @brief Writes a struct Longtail_StoredBlock to a byte buffer.
  *
  * Serializes a struct Longtail_StoredBlock to a buffer which is allocated using Longtail_Alloc()
@@ -1761,6 +2249,48 @@ LONGTAIL_EXPORT int Longtail_PruneStoreIndex(
     const TLongtail_Hash* keep_block_hashes,
     struct Longtail_StoreIndex** out_store_index);
 
+/*! @brief Repacks the live chunks of sparsely used blocks into new dense blocks.
+ *
+ * A chunk is live if it is referenced by any of @p version_indexes. Blocks in @p store_index without live chunks
+ * are dropped, blocks where at least @p min_block_usage_percent of the data is live are kept as is and the live
+ * chunks of the remaining blocks are packed into new blocks using the same packing as Longtail_CreateStoreIndex.
+ * The new blocks are written to @p block_store_api with PutStoredBlock, each job holds at most the block it
+ * builds and one source block in memory.
+ *
+ * The old blocks are not removed, flush @p block_store_api and call PruneBlocks with the block hashes of
+ * @p out_store_index to remove them. The new blocks only contain live chunks so if the operation is interrupted
+ * it can be restarted with the current store index of the block store without repacking the same chunks again.
+ *
+ * @param[in] block_store_api           The block store to compact
+ * @param[in] hash_api                  The hash API used to hash the new blocks
+ * @param[in] job_api                   The job API used to read and write blocks
+ * @param[in] progress_api              The progress API, may be null
+ * @param[in] optional_cancel_api       The cancel API, may be null
+ * @param[in] optional_cancel_token     The cancel token, may be null
+ * @param[in] store_index               The store index of @p block_store_api
+ * @param[in] version_index_count       The number of live versions in @p version_indexes
+ * @param[in] version_indexes           The live versions
+ * @param[in] min_block_usage_percent   Blocks with less live data than this are repacked
+ * @param[in] max_block_size            Max size of a new block
+ * @param[in] max_chunks_per_block      Max number of chunks in a new block
+ * @param[out] out_store_index          The store index of the kept and new blocks
+ * @return                              Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_CompactStore(
+    struct Longtail_BlockStoreAPI* block_store_api,
+    struct Longtail_HashAPI* hash_api,
+    struct Longtail_JobAPI* job_api,
+    struct Longtail_ProgressAPI* progress_api,
+    struct Longtail_CancelAPI* optional_cancel_api,
+    Longtail_CancelAPI_HCancelToken optional_cancel_token,
+    const struct Longtail_StoreIndex* store_index,
+    uint32_t version_index_count,
+    const struct Longtail_VersionIndex** version_indexes,
+    uint32_t min_block_usage_percent,
+    uint32_t max_block_size,
+    uint32_t max_chunks_per_block,
+    struct Longtail_StoreIndex** out_store_index);
+
 /*! @brief Validate that store_index contains all of version_index.
  *
  * Validates that all chunks required for @p version_index are present in @p store_index
@@ -1853,6 +2383,186 @@ LONGTAIL_EXPORT int Longtail_ReadStoreIndex(
     const char* path,
     struct Longtail_StoreIndex** out_store_index);
 
+/*! @brief Serializes a struct Longtail_StoreIndex to a compact byte buffer.
+ *
+ * Uses the same section based encoding as Longtail_WriteCompactVersionIndexToBuffer().
+ * Compact store indexes are read with Longtail_ReadStoreIndexFromBuffer2() and Longtail_ReadStoreIndex2().
+ *
+ * @param[in] store_index                   Pointer to an initialized struct Longtail_StoreIndex
+ * @param[in] optional_compression_registry Compression registry used to resolve @p compression_type, may be null if @p compression_type is zero
+ * @param[in] compression_type              Compression type of the payload, zero for uncompressed
+ * @param[out] out_buffer                   Pointer to a buffer pointer intitialized on success
+ * @param[out] out_size                     Pointer to a size variable intitialized on success
+ * @return                                  Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_WriteCompactStoreIndexToBuffer(
+    const struct Longtail_StoreIndex* store_index,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    uint32_t compression_type,
+    void** out_buffer,
+    size_t* out_size);
+
+/*! @brief Writes a struct Longtail_StoreIndex using the compact encoding.
+ *
+ * @param[in] storage_api                   An initialized struct Longtail_StorageAPI
+ * @param[in] store_index                   Pointer to an initialized struct Longtail_StoreIndex
+ * @param[in] optional_compression_registry Compression registry used to resolve @p compression_type, may be null if @p compression_type is zero
+ * @param[in] compression_type              Compression type of the payload, zero for uncompressed
+ * @param[in] path                          A path in the storage api to store the store index to
+ * @return                                  Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_WriteCompactStoreIndex(
+    struct Longtail_StorageAPI* storage_api,
+    const struct Longtail_StoreIndex* store_index,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    uint32_t compression_type,
+    const char* path);
+
+/*! @brief Reads a struct Longtail_StoreIndex in either the plain or the compact encoding from a byte buffer.
+ *
+ * @param[in] buffer                        Buffer containing the serialized struct Longtail_StoreIndex
+ * @param[in] size                          Size of the buffer
+ * @param[in] optional_compression_registry Compression registry for compressed compact store indexes, may be null
+ * @param[in] optional_job_api              Job API used to decode sections in parallel, may be null
+ * @param[out] out_store_index              Pointer to an struct Longtail_StoreIndex pointer
+ * @return                                  Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_ReadStoreIndexFromBuffer2(
+    const void* buffer,
+    size_t size,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    struct Longtail_StoreIndex** out_store_index);
+
+/*! @brief Reads a struct Longtail_StoreIndex in either the plain or the compact encoding.
+ *
+ * @param[in] storage_api                   An initialized struct Longtail_StorageAPI
+ * @param[in] optional_compression_registry Compression registry for compressed compact store indexes, may be null
+ * @param[in] optional_job_api              Job API used to decode sections in parallel, may be null
+ * @param[in] path                          A path in the storage api to read the store index from
+ * @param[out] out_store_index              Pointer to an struct Longtail_StoreIndex pointer
+ * @return                                  Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_ReadStoreIndex2(
+    struct Longtail_StorageAPI* storage_api,
+    struct Longtail_CompressionRegistryAPI* optional_compression_registry,
+    struct Longtail_JobAPI* optional_job_api,
+    const char* path,
+    struct Longtail_StoreIndex** out_store_index);
+
+/*! @brief Persistent per-block reference counts of the versions that use a store.
+ *
+ * A version references the blocks of the store index it was uploaded against, for example the version local
+ * store index written by upsync. Registering a version adds one reference to each of its blocks and retiring
+ * it removes one, blocks that reach zero references are removed from the index.
+ * The block hashes of the index are the keep list for PruneBlocks and Longtail_PruneStoreIndex so pruning
+ * does not need to load all version indexes that use the store.
+ *
+ * Longtail_RegisterBlockRefs and Longtail_RetireBlockRefs only change an index in memory. Reading, changing and
+ * writing back an index file that several writers share loses updates unless the writers are serialized, use
+ * Longtail_UpdateBlockRefCountIndex which does it under a lock file.
+ */
+struct Longtail_BlockRefCountIndex
+{
+    uint32_t* m_Version;
+    uint32_t* m_BlockCount;
+    TLongtail_Hash* m_BlockHashes;  // []
+    uint32_t* m_RefCounts;          // []
+};
+
+LONGTAIL_EXPORT size_t Longtail_GetBlockRefCountIndexSize(uint32_t block_count);
+
+/*! @brief Creates a struct Longtail_BlockRefCountIndex.
+ *
+ * @param[in] block_count           The number of blocks, may be zero to create an empty index
+ * @param[in] block_hashes          The block hashes
+ * @param[in] ref_counts            The reference count of each block, zero counts are rejected with EINVAL
+ * @param[out] out_ref_count_index  Pointer to a struct Longtail_BlockRefCountIndex pointer, allocated using Longtail_Alloc()
+ * @return                          Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_CreateBlockRefCountIndex(
+    uint32_t block_count,
+    const TLongtail_Hash* block_hashes,
+    const uint32_t* ref_counts,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index);
+
+/*! @brief Adds one reference to each block used by a version.
+ *
+ * Duplicate hashes in @p block_hashes are only counted once. The cost is proportional to the size of
+ * @p ref_count_index plus @p block_count, no version indexes are needed.
+ *
+ * @param[in] ref_count_index       The current reference counts
+ * @param[in] block_count           The number of blocks used by the version
+ * @param[in] block_hashes          The hashes of the blocks used by the version
+ * @param[out] out_ref_count_index  Pointer to a struct Longtail_BlockRefCountIndex pointer with the updated reference counts
+ * @return                          Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_RegisterBlockRefs(
+    const struct Longtail_BlockRefCountIndex* ref_count_index,
+    uint32_t block_count,
+    const TLongtail_Hash* block_hashes,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index);
+
+/*! @brief Removes one reference from each block used by a retired version.
+ *
+ * Pass the same block hashes as when the version was registered. Blocks that reach zero references are
+ * removed from the index, blocks that are not in the index are ignored.
+ *
+ * @param[in] ref_count_index       The current reference counts
+ * @param[in] block_count           The number of blocks used by the version
+ * @param[in] block_hashes          The hashes of the blocks used by the version
+ * @param[out] out_ref_count_index  Pointer to a struct Longtail_BlockRefCountIndex pointer with the updated reference counts
+ * @return                          Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_RetireBlockRefs(
+    const struct Longtail_BlockRefCountIndex* ref_count_index,
+    uint32_t block_count,
+    const TLongtail_Hash* block_hashes,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index);
+
+LONGTAIL_EXPORT int Longtail_WriteBlockRefCountIndexToBuffer(
+    const struct Longtail_BlockRefCountIndex* ref_count_index,
+    void** out_buffer,
+    size_t* out_size);
+
+LONGTAIL_EXPORT int Longtail_ReadBlockRefCountIndexFromBuffer(
+    const void* buffer,
+    size_t size,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index);
+
+LONGTAIL_EXPORT int Longtail_WriteBlockRefCountIndex(
+    struct Longtail_StorageAPI* storage_api,
+    const struct Longtail_BlockRefCountIndex* ref_count_index,
+    const char* path);
+
+LONGTAIL_EXPORT int Longtail_ReadBlockRefCountIndex(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index);
+
+/*! @brief Registers or retires the blocks of a version in a block ref count index file.
+ *
+ * Holds the lock file `<path>.lock` while the index at @p path is read, changed and written back so concurrent
+ * updates through the same storage are not lost. A missing index is treated as empty. The index is written
+ * to `<path>.tmp` and renamed to @p path, the previous index is kept as `<path>.bak` until the rename succeeded
+ * and is restored by the next update if the process was interrupted in between.
+ *
+ * @param[in] storage_api           The storage API holding the index
+ * @param[in] path                  The path of the index
+ * @param[in] block_count           The number of blocks used by the version
+ * @param[in] block_hashes          The hashes of the blocks used by the version
+ * @param[in] retire                Zero to register the blocks, non-zero to retire them
+ * @param[out] out_ref_count_index  Optional pointer to a struct Longtail_BlockRefCountIndex pointer with the written reference counts
+ * @return                          Return code (errno style), zero on success
+ */
+LONGTAIL_EXPORT int Longtail_UpdateBlockRefCountIndex(
+    struct Longtail_StorageAPI* storage_api,
+    const char* path,
+    uint32_t block_count,
+    const TLongtail_Hash* block_hashes,
+    int retire,
+    struct Longtail_BlockRefCountIndex** out_ref_count_index);
+
 struct Longtail_VersionIndex
 {
     uint32_t* m_Version;
@@ -1920,6 +2630,9 @@ struct Longtail_VersionDiff
     uint32_t* m_TargetContentModifiedAssetIndexes;
     uint32_t* m_SourcePermissionsModifiedAssetIndexes;
     uint32_t* m_TargetPermissionsModifiedAssetIndexes;
+    uint32_t* m_MovedCount;
+    uint32_t* m_SourceMovedAssetIndexes;
+    uint32_t* m_TargetMovedAssetIndexes;
 };
 
 ///////////// Longtail private functions
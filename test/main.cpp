@@ -56,6 +56,7 @@ int main(int argc, char** argv)
     Longtail_SetLogLevel(LONGTAIL_LOG_LEVEL_ERROR);
     Longtail_SetLog(LogStdErr, 0);
     int result = jc_test_run_all();
+    Longtail_DisposeScratchArenaPool();
     if (result == 0)
     {
         uint64_t allocation_count = Longtail_MemTracer_GetAllocationCount(0);
@@ -14,6 +14,8 @@
 #include "../lib/compressblockstore/longtail_compressblockstore.h"
 #include "../lib/compressionregistry/longtail_full_compression_registry.h"
 #include "../lib/concurrentchunkwrite/longtail_concurrentchunkwrite.h"
+#include "../lib/deltablockstore/longtail_deltablockstore.h"
+#include "../lib/directorycache/longtail_directorycache.h"
 #include "../lib/filestorage/longtail_filestorage.h"
 #include "../lib/fsblockstore/longtail_fsblockstore.h"
 #include "../lib/hpcdcchunker/longtail_hpcdcchunker.h"
@@ -22,8 +24,11 @@
 #include "../lib/lrublockstore/longtail_lrublockstore.h"
 #include "../lib/lz4/longtail_lz4.h"
 #include "../lib/memstorage/longtail_memstorage.h"
+#include "../lib/memtracer/longtail_memtracer.h"
 #include "../lib/meowhash/longtail_meowhash.h"
+#include "../lib/readaheadstorage/longtail_readaheadstorage.h"
 #include "../lib/shareblockstore/longtail_shareblockstore.h"
+#include "../lib/xxh3/longtail_xxh3.h"
 #include "../lib/zstd/longtail_zstd.h"
 
 #include "../lib/longtail_platform.h"
@@ -252,6 +257,82 @@ TEST(Longtail, Longtail_Malloc)
     Longtail_Free(p);
 }
 
+TEST(Longtail, Longtail_ScratchArena)
+{
+    struct Longtail_ScratchArena* arena = Longtail_CreateScratchArena(64);
+    ASSERT_NE((struct Longtail_ScratchArena*)0, arena);
+    ASSERT_EQ(0u, Longtail_ScratchArena_GetMark(arena));
+
+    uint8_t* a = (uint8_t*)Longtail_ScratchArena_Alloc(arena, 7);
+    ASSERT_NE((uint8_t*)0, a);
+    ASSERT_EQ(0u, ((uintptr_t)a) & 15);
+    memset(a, 0xa5, 7);
+    size_t mark = Longtail_ScratchArena_GetMark(arena);
+    ASSERT_EQ(16u, mark);
+
+    // Grows past the first block
+    uint8_t* b = (uint8_t*)Longtail_ScratchArena_Alloc(arena, 100000);
+    ASSERT_NE((uint8_t*)0, b);
+    ASSERT_EQ(0u, ((uintptr_t)b) & 15);
+    memset(b, 0x5a, 100000);
+    ASSERT_EQ(0xa5, a[6]);
+    size_t peak = Longtail_ScratchArena_GetPeakUsage(arena);
+    ASSERT_GE(peak, 16u + 100000u);
+
+    ASSERT_EQ(0, Longtail_ScratchArena_ResetToMark(arena, mark));
+    ASSERT_EQ(mark, Longtail_ScratchArena_GetMark(arena));
+    ASSERT_EQ(0xa5, a[6]);
+    ASSERT_EQ(peak, Longtail_ScratchArena_GetPeakUsage(arena));
+
+    // Resetting to empty merges the blocks, the peak workload then fits without growing
+    ASSERT_EQ(0, Longtail_ScratchArena_ResetToMark(arena, 0));
+    ASSERT_EQ(0u, Longtail_ScratchArena_GetMark(arena));
+    uint8_t* c = (uint8_t*)Longtail_ScratchArena_Alloc(arena, peak);
+    ASSERT_NE((uint8_t*)0, c);
+    uint8_t* d = (uint8_t*)Longtail_ScratchArena_Alloc(arena, 16);
+    ASSERT_NE((uint8_t*)0, d);
+    Longtail_ScratchArena_ResetPeakUsage(arena);
+    ASSERT_EQ(Longtail_ScratchArena_GetMark(arena), Longtail_ScratchArena_GetPeakUsage(arena));
+    ASSERT_EQ(0, Longtail_ScratchArena_ResetToMark(arena, 0));
+
+    Longtail_DisposeScratchArena(arena);
+}
+
+static int FailScratchArenaAllocs = 0;
+
+static void* FailScratchArena_ReAlloc(const char* context, void* old, size_t s)
+{
+    if (FailScratchArenaAllocs && s > 0 && strcmp(context, "ScratchArena") == 0)
+    {
+        return 0;
+    }
+    return Longtail_MemTracer_ReAlloc(context, old, s);
+}
+
+TEST(Longtail, Longtail_ScratchArenaResetOutOfMemory)
+{
+    struct Longtail_ScratchArena* arena = Longtail_CreateScratchArena(64);
+    ASSERT_NE((struct Longtail_ScratchArena*)0, arena);
+    ASSERT_NE((void*)0, Longtail_ScratchArena_Alloc(arena, 16));
+    ASSERT_NE((void*)0, Longtail_ScratchArena_Alloc(arena, 100000));
+
+    // The merged block can not be allocated, the arena is reset to its first block and stays usable
+    Longtail_SetReAllocAndFree(FailScratchArena_ReAlloc, Longtail_MemTracer_Free);
+    FailScratchArenaAllocs = 1;
+    ASSERT_EQ(ENOMEM, Longtail_ScratchArena_ResetToMark(arena, 0));
+    FailScratchArenaAllocs = 0;
+    Longtail_SetReAllocAndFree(Longtail_MemTracer_ReAlloc, Longtail_MemTracer_Free);
+
+    ASSERT_EQ(0u, Longtail_ScratchArena_GetMark(arena));
+    uint8_t* a = (uint8_t*)Longtail_ScratchArena_Alloc(arena, 64);
+    ASSERT_NE((uint8_t*)0, a);
+    memset(a, 0xa5, 64);
+    ASSERT_EQ(64u, Longtail_ScratchArena_GetMark(arena));
+    ASSERT_EQ(0, Longtail_ScratchArena_ResetToMark(arena, 0));
+
+    Longtail_DisposeScratchArena(arena);
+}
+
 TEST(Longtail, Longtail_ConcatPath)
 {
     char* p1 = Longtail_ConcatPath("", "file");
@@ -486,6 +567,26 @@ TEST(Longtail, Longtail_MeowHash)
     }
 }
 
+TEST(Longtail, Longtail_XXH3)
+{
+    const char* test_string = "This is the first test string which is fairly long and should - reconstructed properly, than you very much";
+    struct Longtail_HashAPI* hash_api = Longtail_CreateXXH3HashAPI();
+    ASSERT_NE((struct Longtail_HashAPI*)0, hash_api);
+    ASSERT_EQ(Longtail_GetXXH3HashType(), hash_api->GetIdentifier(hash_api));
+    uint64_t hash;
+    ASSERT_EQ(0, hash_api->HashBuffer(hash_api, 0, test_string, &hash));
+    ASSERT_EQ(0x2d06800538d394c2, hash);
+    ASSERT_EQ(0, hash_api->HashBuffer(hash_api, (uint32_t)(strlen(test_string) + 1), test_string, &hash));
+    ASSERT_EQ(0xa948390d40d6e4c3, hash);
+
+    Longtail_HashAPI_HContext context;
+    ASSERT_EQ(0, hash_api->BeginContext(hash_api, &context));
+    hash_api->Hash(hash_api, context, 10, test_string);
+    hash_api->Hash(hash_api, context, (uint32_t)(strlen(test_string) + 1 - 10), &test_string[10]);
+    ASSERT_EQ(hash, hash_api->EndContext(hash_api, context));
+    Longtail_DisposeAPI(&hash_api->m_API);
+}
+
 TEST(Longtail, Longtail_CreateBlockIndex)
 {
     struct Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
@@ -1117,6 +1218,7 @@ TEST(Longtail, Longtail_GetExistingStoreIndex)
             5,
             32);
         block_indexes[b] = blocks[b]->m_BlockIndex;
+        *block_indexes[b]->m_Tag = 0x100u + b;
     }
 
     struct Longtail_StoreIndex* store_index;
@@ -1164,6 +1266,12 @@ TEST(Longtail, Longtail_GetExistingStoreIndex)
     ASSERT_EQ(*block_indexes[1]->m_BlockHash, all_blocks->m_BlockHashes[3]);
     ASSERT_EQ(*block_indexes[5]->m_BlockHash, all_blocks->m_BlockHashes[4]);
     ASSERT_EQ(*block_indexes[0]->m_BlockHash, all_blocks->m_BlockHashes[5]);
+    ASSERT_EQ(0x104u, all_blocks->m_BlockTags[0]);
+    ASSERT_EQ(0x102u, all_blocks->m_BlockTags[1]);
+    ASSERT_EQ(0x103u, all_blocks->m_BlockTags[2]);
+    ASSERT_EQ(0x101u, all_blocks->m_BlockTags[3]);
+    ASSERT_EQ(0x105u, all_blocks->m_BlockTags[4]);
+    ASSERT_EQ(0x100u, all_blocks->m_BlockTags[5]);
     Longtail_Free(all_blocks);
 
     struct Longtail_StoreIndex* all_full_blocks;
@@ -1253,6 +1361,107 @@ static uint32_t* SetAssetTags(Longtail_StorageAPI* , const Longtail_FileInfos* f
     return result;
 }
 
+struct TestScratchArenaProvider
+{
+    struct Longtail_ScratchArena* m_Arena;
+    uint32_t m_AcquireCount;
+    uint32_t m_ReleaseCount;
+    size_t m_StoreIndexPeakUsage;
+};
+
+static struct Longtail_ScratchArena* TestScratchArenaProvider_Acquire(void* context, const char* operation, size_t size_hint)
+{
+    struct TestScratchArenaProvider* provider = (struct TestScratchArenaProvider*)context;
+    ++provider->m_AcquireCount;
+    return provider->m_Arena;
+}
+
+static void TestScratchArenaProvider_Release(void* context, const char* operation, struct Longtail_ScratchArena* arena, size_t peak_usage)
+{
+    struct TestScratchArenaProvider* provider = (struct TestScratchArenaProvider*)context;
+    ++provider->m_ReleaseCount;
+    if (strcmp(operation, "Longtail_GetExistingStoreIndex") == 0)
+    {
+        provider->m_StoreIndexPeakUsage = peak_usage;
+    }
+}
+
+TEST(Longtail, Longtail_ScratchArenaProvider)
+{
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    const uint8_t block_count = 4;
+    struct Longtail_StoredBlock* blocks[block_count];
+    struct Longtail_BlockIndex* block_indexes[block_count];
+    for (uint8_t b = 0; b < block_count; ++b)
+    {
+        blocks[b] = TestCreateStoredBlock(
+            hash_api,
+            b * block_count,
+            5,
+            32);
+        block_indexes[b] = blocks[b]->m_BlockIndex;
+    }
+
+    struct Longtail_StoreIndex* store_index;
+    ASSERT_EQ(0, Longtail_CreateStoreIndexFromBlocks(
+        block_count,
+        (const Longtail_BlockIndex **)block_indexes,
+        &store_index));
+
+    struct TestScratchArenaProvider provider;
+    provider.m_Arena = Longtail_CreateScratchArena(0);
+    provider.m_AcquireCount = 0;
+    provider.m_ReleaseCount = 0;
+    provider.m_StoreIndexPeakUsage = 0;
+    ASSERT_NE((struct Longtail_ScratchArena*)0, provider.m_Arena);
+    Longtail_SetScratchArenaProvider(TestScratchArenaProvider_Acquire, TestScratchArenaProvider_Release, &provider);
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        struct Longtail_StoreIndex* existing_store_index;
+        ASSERT_EQ(0, Longtail_GetExistingStoreIndex(
+            store_index,
+            *blocks[2]->m_BlockIndex->m_ChunkCount,
+            blocks[2]->m_BlockIndex->m_ChunkHashes,
+            0,
+            &existing_store_index));
+        ASSERT_EQ(1u, *existing_store_index->m_BlockCount);
+        ASSERT_EQ(*block_indexes[2]->m_BlockHash, existing_store_index->m_BlockHashes[0]);
+        Longtail_Free(existing_store_index);
+        ASSERT_EQ(i + 1, provider.m_AcquireCount);
+        ASSERT_EQ(i + 1, provider.m_ReleaseCount);
+        ASSERT_NE(0u, provider.m_StoreIndexPeakUsage);
+        ASSERT_EQ(0u, Longtail_ScratchArena_GetMark(provider.m_Arena));
+    }
+
+    Longtail_SetScratchArenaProvider(0, 0, 0);
+    Longtail_DisposeScratchArena(provider.m_Arena);
+
+    // The default provider reuses the arena released by the previous operation
+    uint64_t arena_allocation_count = Longtail_MemTracer_GetAllocationCount("ScratchArena");
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        struct Longtail_StoreIndex* existing_store_index;
+        ASSERT_EQ(0, Longtail_GetExistingStoreIndex(
+            store_index,
+            *blocks[2]->m_BlockIndex->m_ChunkCount,
+            blocks[2]->m_BlockIndex->m_ChunkHashes,
+            0,
+            &existing_store_index));
+        Longtail_Free(existing_store_index);
+        ASSERT_EQ(arena_allocation_count + 2, Longtail_MemTracer_GetAllocationCount("ScratchArena"));
+    }
+    Longtail_DisposeScratchArenaPool();
+    ASSERT_EQ(arena_allocation_count, Longtail_MemTracer_GetAllocationCount("ScratchArena"));
+
+    Longtail_Free(store_index);
+    for (uint8_t b = 0; b < block_count; ++b)
+    {
+        Longtail_Free(blocks[b]);
+    }
+    SAFE_DISPOSE_API(hash_api);
+}
+
 TEST(Longtail, CreateEmptyVersionIndex)
 {
     Longtail_StorageAPI* local_storage = Longtail_CreateFSStorageAPI();
@@ -2200,6 +2409,593 @@ TEST(Longtail, Longtail_CompressBlockStore)
     SAFE_DISPOSE_API(local_storage_api);
 }
 
+TEST(Longtail, Longtail_CompressBlockStoreSplitFrames)
+{
+    static const uint32_t SPLIT_FRAME_SIZE = 4096;
+    static const uint32_t CHUNK_SIZES[3] = {4711, 1147, 4142};
+
+    Longtail_StorageAPI* local_storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(4, 0);
+    Longtail_BlockStoreAPI* local_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, local_storage_api, "chunks", 0, 0);
+    Longtail_BlockStoreAPI* split_block_store_api = Longtail_CreateCompressBlockStoreAPI2(local_block_store_api, compression_registry, job_api, SPLIT_FRAME_SIZE);
+    Longtail_BlockStoreAPI* compress_block_store_api = Longtail_CreateCompressBlockStoreAPI(local_block_store_api, compression_registry);
+    ASSERT_NE((Longtail_BlockStoreAPI*)0, split_block_store_api);
+
+    size_t block_index_size = Longtail_GetBlockIndexSize(3);
+    uint32_t block_chunks_data_size = CHUNK_SIZES[0] + CHUNK_SIZES[1] + CHUNK_SIZES[2];
+    Longtail_StoredBlock* put_block = (struct Longtail_StoredBlock*)Longtail_Alloc(0, Longtail_GetStoredBlockSize(block_index_size + block_chunks_data_size));
+    put_block->Dispose = 0;
+    put_block->m_BlockIndex = Longtail_InitBlockIndex(&put_block[1], 3);
+    *put_block->m_BlockIndex->m_BlockHash = 0xdeadbeef;
+    *put_block->m_BlockIndex->m_HashIdentifier = hash_api->GetIdentifier(hash_api);
+    *put_block->m_BlockIndex->m_Tag = Longtail_GetZStdDefaultQuality();
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        put_block->m_BlockIndex->m_ChunkHashes[c] = 0xf001fa5 + c;
+        put_block->m_BlockIndex->m_ChunkSizes[c] = CHUNK_SIZES[c];
+    }
+    *put_block->m_BlockIndex->m_ChunkCount = 3;
+    put_block->m_BlockChunksDataSize = block_chunks_data_size;
+    put_block->m_BlockData = &((uint8_t*)put_block->m_BlockIndex)[block_index_size];
+    for (uint32_t i = 0; i < block_chunks_data_size; ++i)
+    {
+        ((uint8_t*)put_block->m_BlockData)[i] = (uint8_t)((i / 7) ^ (i % 13));
+    }
+
+    struct TestAsyncPutBlockComplete putCB;
+    ASSERT_EQ(0, split_block_store_api->PutStoredBlock(split_block_store_api, put_block, &putCB.m_API));
+    putCB.Wait();
+    ASSERT_EQ(0, putCB.m_Err);
+
+    // The stored block is split in independently compressed frames
+    struct TestAsyncGetBlockComplete getRawCB;
+    ASSERT_EQ(0, local_block_store_api->GetStoredBlock(local_block_store_api, 0xdeadbeef, &getRawCB.m_API));
+    getRawCB.Wait();
+    ASSERT_EQ(0, getRawCB.m_Err);
+    const uint32_t* header_ptr = (const uint32_t*)getRawCB.m_StoredBlock->m_BlockData;
+    ASSERT_EQ(block_chunks_data_size, header_ptr[0]);
+    ASSERT_EQ(0x80000000u | 3u, header_ptr[1]);
+    ASSERT_EQ(SPLIT_FRAME_SIZE, header_ptr[2]);
+    ASSERT_EQ(SPLIT_FRAME_SIZE, header_ptr[4]);
+    ASSERT_EQ(block_chunks_data_size - SPLIT_FRAME_SIZE * 2, header_ptr[6]);
+    getRawCB.m_StoredBlock->Dispose(getRawCB.m_StoredBlock);
+
+    // Both the parallel and the plain compress block store can read it back
+    Longtail_BlockStoreAPI* read_block_stores[2] = {split_block_store_api, compress_block_store_api};
+    for (uint32_t s = 0; s < 2; ++s)
+    {
+        struct TestAsyncGetBlockComplete getCB;
+        ASSERT_EQ(0, read_block_stores[s]->GetStoredBlock(read_block_stores[s], 0xdeadbeef, &getCB.m_API));
+        getCB.Wait();
+        ASSERT_EQ(0, getCB.m_Err);
+        Longtail_StoredBlock* get_block = getCB.m_StoredBlock;
+        ASSERT_NE((Longtail_StoredBlock*)0, get_block);
+        ASSERT_EQ(3u, *get_block->m_BlockIndex->m_ChunkCount);
+        ASSERT_EQ(block_chunks_data_size, get_block->m_BlockChunksDataSize);
+        ASSERT_EQ(0, memcmp(put_block->m_BlockData, get_block->m_BlockData, block_chunks_data_size));
+        get_block->Dispose(get_block);
+    }
+    Longtail_Free(put_block);
+
+    SAFE_DISPOSE_API(compress_block_store_api);
+    SAFE_DISPOSE_API(split_block_store_api);
+    SAFE_DISPOSE_API(local_block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(compression_registry);
+    SAFE_DISPOSE_API(local_storage_api);
+}
+
+TEST(Longtail, Longtail_CompressBlockStoreChunkRange)
+{
+    static const uint32_t CHUNK_SIZES[4] = {4711, 1147, 4142, 3000};
+
+    Longtail_StorageAPI* local_storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(4, 0);
+    Longtail_BlockStoreAPI* local_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, local_storage_api, "chunks", 0, 0);
+    Longtail_BlockStoreAPI* compress_block_store_api = Longtail_CreateCompressBlockStoreAPI3(local_block_store_api, compression_registry, job_api, 6000, 1);
+    ASSERT_NE((Longtail_BlockStoreAPI*)0, compress_block_store_api);
+
+    TLongtail_Hash chunk_hashes[4] = {0xf001fa5, 0xf001fa6, 0xf001fa7, 0xf001fa8};
+    uint32_t chunk_sizes[4] = {CHUNK_SIZES[0], CHUNK_SIZES[1], CHUNK_SIZES[2], CHUNK_SIZES[3]};
+    uint32_t block_chunks_data_size = CHUNK_SIZES[0] + CHUNK_SIZES[1] + CHUNK_SIZES[2] + CHUNK_SIZES[3];
+    Longtail_StoredBlock* put_block;
+    ASSERT_EQ(0, Longtail_CreateStoredBlock(0xdeadbeef, 0, 4, Longtail_GetZStdDefaultQuality(), chunk_hashes, chunk_sizes, block_chunks_data_size, &put_block));
+    for (uint32_t i = 0; i < block_chunks_data_size; ++i)
+    {
+        ((uint8_t*)put_block->m_BlockData)[i] = (uint8_t)((i / 7) ^ (i % 13));
+    }
+
+    struct TestAsyncPutBlockComplete putCB;
+    ASSERT_EQ(0, compress_block_store_api->PutStoredBlock(compress_block_store_api, put_block, &putCB.m_API));
+    putCB.Wait();
+    ASSERT_EQ(0, putCB.m_Err);
+
+    // Frames only end at chunk boundaries
+    struct TestAsyncGetBlockComplete getRawCB;
+    ASSERT_EQ(0, local_block_store_api->GetStoredBlock(local_block_store_api, 0xdeadbeef, &getRawCB.m_API));
+    getRawCB.Wait();
+    ASSERT_EQ(0, getRawCB.m_Err);
+    const uint32_t* header_ptr = (const uint32_t*)getRawCB.m_StoredBlock->m_BlockData;
+    ASSERT_EQ(0x80000000u | 3u, header_ptr[1]);
+    ASSERT_EQ(CHUNK_SIZES[0] + CHUNK_SIZES[1], header_ptr[2]);
+    ASSERT_EQ(CHUNK_SIZES[2], header_ptr[4]);
+    ASSERT_EQ(CHUNK_SIZES[3], header_ptr[6]);
+    getRawCB.m_StoredBlock->Dispose(getRawCB.m_StoredBlock);
+
+    static const uint32_t RANGES[3][2] = {{1, 1}, {2, 2}, {0, 4}};
+    for (uint32_t r = 0; r < 3; ++r)
+    {
+        uint32_t first_chunk_index = RANGES[r][0];
+        uint32_t chunk_count = RANGES[r][1];
+        uint32_t data_offset = 0;
+        for (uint32_t c = 0; c < first_chunk_index; ++c)
+        {
+            data_offset += CHUNK_SIZES[c];
+        }
+        uint32_t data_size = 0;
+        for (uint32_t c = first_chunk_index; c < first_chunk_index + chunk_count; ++c)
+        {
+            data_size += CHUNK_SIZES[c];
+        }
+        struct TestAsyncGetBlockComplete getCB;
+        ASSERT_EQ(0, Longtail_BlockStore_GetStoredBlockChunkRange(compress_block_store_api, 0xdeadbeef, first_chunk_index, chunk_count, &getCB.m_API));
+        getCB.Wait();
+        ASSERT_EQ(0, getCB.m_Err);
+        Longtail_StoredBlock* get_block = getCB.m_StoredBlock;
+        ASSERT_EQ(0xdeadbeef, *get_block->m_BlockIndex->m_BlockHash);
+        ASSERT_EQ(chunk_count, *get_block->m_BlockIndex->m_ChunkCount);
+        ASSERT_EQ(chunk_hashes[first_chunk_index], get_block->m_BlockIndex->m_ChunkHashes[0]);
+        ASSERT_EQ(data_size, get_block->m_BlockChunksDataSize);
+        ASSERT_EQ(0, memcmp(&((uint8_t*)put_block->m_BlockData)[data_offset], get_block->m_BlockData, data_size));
+        get_block->Dispose(get_block);
+    }
+
+    struct TestAsyncGetBlockComplete getOutOfRangeCB;
+    ASSERT_EQ(0, Longtail_BlockStore_GetStoredBlockChunkRange(compress_block_store_api, 0xdeadbeef, 3, 2, &getOutOfRangeCB.m_API));
+    getOutOfRangeCB.Wait();
+    ASSERT_EQ(EINVAL, getOutOfRangeCB.m_Err);
+
+    // A cache block store reads chunk ranges from its local store and gets whole blocks from its remote store
+    Longtail_BlockStoreAPI* cache_local_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, local_storage_api, "cache", 0, 0);
+    Longtail_BlockStoreAPI* cache_compress_block_store_api = Longtail_CreateCompressBlockStoreAPI(cache_local_block_store_api, compression_registry);
+    Longtail_BlockStoreAPI* cache_block_store_api = Longtail_CreateCacheBlockStoreAPI(job_api, cache_compress_block_store_api, compress_block_store_api);
+    Longtail_BlockStoreAPI* lru_block_store_api = Longtail_CreateLRUBlockStoreAPI(cache_block_store_api, 3);
+    Longtail_BlockStoreAPI* share_block_store_api = Longtail_CreateShareBlockStoreAPI(lru_block_store_api);
+    struct TestAsyncGetBlockComplete getRemoteCB;
+    ASSERT_EQ(0, Longtail_BlockStore_GetStoredBlockChunkRange(share_block_store_api, 0xdeadbeef, 1, 1, &getRemoteCB.m_API));
+    getRemoteCB.Wait();
+    ASSERT_EQ(0, getRemoteCB.m_Err);
+    ASSERT_EQ(4u, *getRemoteCB.m_StoredBlock->m_BlockIndex->m_ChunkCount);
+    getRemoteCB.m_StoredBlock->Dispose(getRemoteCB.m_StoredBlock);
+    struct TestAsyncFlushComplete flushCB;
+    ASSERT_EQ(0, cache_block_store_api->Flush(cache_block_store_api, &flushCB.m_API));
+    flushCB.Wait();
+    ASSERT_EQ(0, flushCB.m_Err);
+
+    struct TestAsyncGetBlockComplete getLocalCB;
+    ASSERT_EQ(0, Longtail_BlockStore_GetStoredBlockChunkRange(share_block_store_api, 0xdeadbeef, 1, 1, &getLocalCB.m_API));
+    getLocalCB.Wait();
+    ASSERT_EQ(0, getLocalCB.m_Err);
+    ASSERT_EQ(1u, *getLocalCB.m_StoredBlock->m_BlockIndex->m_ChunkCount);
+    ASSERT_EQ(chunk_hashes[1], getLocalCB.m_StoredBlock->m_BlockIndex->m_ChunkHashes[0]);
+    ASSERT_EQ(0, memcmp(&((uint8_t*)put_block->m_BlockData)[CHUNK_SIZES[0]], getLocalCB.m_StoredBlock->m_BlockData, CHUNK_SIZES[1]));
+    getLocalCB.m_StoredBlock->Dispose(getLocalCB.m_StoredBlock);
+
+    // A block held by the LRU block store is handed out whole
+    struct TestAsyncGetBlockComplete getWholeCB;
+    ASSERT_EQ(0, share_block_store_api->GetStoredBlock(share_block_store_api, 0xdeadbeef, &getWholeCB.m_API));
+    getWholeCB.Wait();
+    ASSERT_EQ(0, getWholeCB.m_Err);
+    getWholeCB.m_StoredBlock->Dispose(getWholeCB.m_StoredBlock);
+    struct TestAsyncGetBlockComplete getLRUCB;
+    ASSERT_EQ(0, Longtail_BlockStore_GetStoredBlockChunkRange(share_block_store_api, 0xdeadbeef, 1, 1, &getLRUCB.m_API));
+    getLRUCB.Wait();
+    ASSERT_EQ(0, getLRUCB.m_Err);
+    ASSERT_EQ(4u, *getLRUCB.m_StoredBlock->m_BlockIndex->m_ChunkCount);
+    ASSERT_EQ(0, memcmp(put_block->m_BlockData, getLRUCB.m_StoredBlock->m_BlockData, put_block->m_BlockChunksDataSize));
+    getLRUCB.m_StoredBlock->Dispose(getLRUCB.m_StoredBlock);
+
+    // Block stores that return blocks in another form than the block data do not read chunk ranges
+    Longtail_BlockStoreAPI* delta_block_store_api = Longtail_CreateDeltaBlockStoreAPI(compress_block_store_api, 0, 0);
+    Longtail_BlockStoreAPI* transcode_block_store_api = Longtail_CreateTranscodeBlockStoreAPI(local_block_store_api, compression_registry, 0, 0);
+    struct TestAsyncGetBlockComplete getUnsupportedCB;
+    ASSERT_EQ(ENOTSUP, Longtail_BlockStore_GetStoredBlockChunkRange(delta_block_store_api, 0xdeadbeef, 1, 1, &getUnsupportedCB.m_API));
+    ASSERT_EQ(ENOTSUP, Longtail_BlockStore_GetStoredBlockChunkRange(transcode_block_store_api, 0xdeadbeef, 1, 1, &getUnsupportedCB.m_API));
+    put_block->Dispose(put_block);
+
+    SAFE_DISPOSE_API(transcode_block_store_api);
+    SAFE_DISPOSE_API(delta_block_store_api);
+    SAFE_DISPOSE_API(share_block_store_api);
+    SAFE_DISPOSE_API(lru_block_store_api);
+    SAFE_DISPOSE_API(cache_block_store_api);
+    SAFE_DISPOSE_API(cache_compress_block_store_api);
+    SAFE_DISPOSE_API(cache_local_block_store_api);
+    SAFE_DISPOSE_API(compress_block_store_api);
+    SAFE_DISPOSE_API(local_block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(compression_registry);
+    SAFE_DISPOSE_API(local_storage_api);
+}
+
+TEST(Longtail, Longtail_CompressBlockStoreRawFrames)
+{
+    static const uint32_t CHUNK_SIZES[2] = {9000, 7000};
+
+    Longtail_StorageAPI* local_storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(4, 0);
+    Longtail_BlockStoreAPI* local_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, local_storage_api, "chunks", 0, 0);
+    Longtail_BlockStoreAPI* compress_block_store_api = Longtail_CreateCompressBlockStoreAPI4(local_block_store_api, compression_registry, job_api, 0, 1, 1, 0, 0);
+    ASSERT_NE((Longtail_BlockStoreAPI*)0, compress_block_store_api);
+    Longtail_BlockStoreAPI* plain_local_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, local_storage_api, "plain_chunks", 0, 0);
+    Longtail_BlockStoreAPI* plain_compress_block_store_api = Longtail_CreateCompressBlockStoreAPI(plain_local_block_store_api, compression_registry);
+
+    TLongtail_Hash chunk_hashes[2] = {0xf001fa5, 0xf001fa6};
+    uint32_t chunk_sizes[2] = {CHUNK_SIZES[0], CHUNK_SIZES[1]};
+    uint32_t block_chunks_data_size = CHUNK_SIZES[0] + CHUNK_SIZES[1];
+    Longtail_StoredBlock* put_block;
+    ASSERT_EQ(0, Longtail_CreateStoredBlock(0xdeadbeef, 0, 2, Longtail_GetZStdMaxQuality(), chunk_hashes, chunk_sizes, block_chunks_data_size, &put_block));
+    // First chunk is noise, second chunk is compressible
+    uint32_t x = 0x9e3779b9u;
+    for (uint32_t i = 0; i < CHUNK_SIZES[0]; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        ((uint8_t*)put_block->m_BlockData)[i] = (uint8_t)(x >> 24);
+    }
+    for (uint32_t i = CHUNK_SIZES[0]; i < block_chunks_data_size; ++i)
+    {
+        ((uint8_t*)put_block->m_BlockData)[i] = (uint8_t)((i / 7) ^ (i % 13));
+    }
+
+    struct TestAsyncPutBlockComplete putCB;
+    ASSERT_EQ(0, compress_block_store_api->PutStoredBlock(compress_block_store_api, put_block, &putCB.m_API));
+    putCB.Wait();
+    ASSERT_EQ(0, putCB.m_Err);
+
+    struct TestAsyncGetBlockComplete getRawCB;
+    ASSERT_EQ(0, local_block_store_api->GetStoredBlock(local_block_store_api, 0xdeadbeef, &getRawCB.m_API));
+    getRawCB.Wait();
+    ASSERT_EQ(0, getRawCB.m_Err);
+    const uint32_t* header_ptr = (const uint32_t*)getRawCB.m_StoredBlock->m_BlockData;
+    ASSERT_EQ(0x80000000u | 2u, header_ptr[1]);
+    ASSERT_EQ(CHUNK_SIZES[0], header_ptr[2]);
+    ASSERT_EQ(0x80000000u | CHUNK_SIZES[0], header_ptr[3]);
+    ASSERT_EQ(CHUNK_SIZES[1], header_ptr[4]);
+    ASSERT_GT(CHUNK_SIZES[1], header_ptr[5]);
+    ASSERT_EQ(0, memcmp(&header_ptr[6], put_block->m_BlockData, CHUNK_SIZES[0]));
+    getRawCB.m_StoredBlock->Dispose(getRawCB.m_StoredBlock);
+
+    struct TestAsyncGetBlockComplete getCB;
+    ASSERT_EQ(0, compress_block_store_api->GetStoredBlock(compress_block_store_api, 0xdeadbeef, &getCB.m_API));
+    getCB.Wait();
+    ASSERT_EQ(0, getCB.m_Err);
+    ASSERT_EQ(block_chunks_data_size, getCB.m_StoredBlock->m_BlockChunksDataSize);
+    ASSERT_EQ(0, memcmp(put_block->m_BlockData, getCB.m_StoredBlock->m_BlockData, block_chunks_data_size));
+    getCB.m_StoredBlock->Dispose(getCB.m_StoredBlock);
+
+    // Without raw frames the block keeps the plain header that older versions read
+    struct TestAsyncPutBlockComplete plainPutCB;
+    ASSERT_EQ(0, plain_compress_block_store_api->PutStoredBlock(plain_compress_block_store_api, put_block, &plainPutCB.m_API));
+    plainPutCB.Wait();
+    ASSERT_EQ(0, plainPutCB.m_Err);
+    struct TestAsyncGetBlockComplete getPlainCB;
+    ASSERT_EQ(0, plain_local_block_store_api->GetStoredBlock(plain_local_block_store_api, 0xdeadbeef, &getPlainCB.m_API));
+    getPlainCB.Wait();
+    ASSERT_EQ(0, getPlainCB.m_Err);
+    header_ptr = (const uint32_t*)getPlainCB.m_StoredBlock->m_BlockData;
+    ASSERT_EQ(block_chunks_data_size, header_ptr[0]);
+    ASSERT_EQ(0u, header_ptr[1] & 0x80000000u);
+    ASSERT_EQ(getPlainCB.m_StoredBlock->m_BlockChunksDataSize, sizeof(uint32_t) * 2 + header_ptr[1]);
+    getPlainCB.m_StoredBlock->Dispose(getPlainCB.m_StoredBlock);
+    put_block->Dispose(put_block);
+
+    SAFE_DISPOSE_API(plain_compress_block_store_api);
+    SAFE_DISPOSE_API(plain_local_block_store_api);
+    SAFE_DISPOSE_API(compress_block_store_api);
+    SAFE_DISPOSE_API(local_block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(compression_registry);
+    SAFE_DISPOSE_API(local_storage_api);
+}
+
+TEST(Longtail, Longtail_CompressBlockStoreAdaptiveCompression)
+{
+    static const uint32_t BLOCK_COUNT = 32;
+    static const uint32_t CHUNK_SIZE = 16384;
+
+    Longtail_StorageAPI* local_storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(4, 0);
+    Longtail_BlockStoreAPI* local_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, local_storage_api, "chunks", 0, 0);
+    const uint32_t adaptive_types[3] = {Longtail_GetZStdDefaultQuality(), Longtail_GetZStdHighQuality(), Longtail_GetZStdMaxQuality()};
+    Longtail_BlockStoreAPI* compress_block_store_api = Longtail_CreateCompressBlockStoreAPI4(local_block_store_api, compression_registry, 0, 0, 0, 0, adaptive_types, 3);
+    ASSERT_NE((Longtail_BlockStoreAPI*)0, compress_block_store_api);
+
+    Longtail_StoredBlock* put_blocks[BLOCK_COUNT];
+    for (uint32_t b = 0; b < BLOCK_COUNT; ++b)
+    {
+        TLongtail_Hash chunk_hash = 0xf001fa5 + b;
+        uint32_t chunk_size = CHUNK_SIZE;
+        // The last block uses a type outside of the adaptive types which is kept as is
+        uint32_t tag = (b == BLOCK_COUNT - 1) ? Longtail_GetLZ4DefaultQuality() : Longtail_GetZStdDefaultQuality();
+        ASSERT_EQ(0, Longtail_CreateStoredBlock(0xdeadbeef + b, 0, 1, tag, &chunk_hash, &chunk_size, CHUNK_SIZE, &put_blocks[b]));
+        for (uint32_t i = 0; i < CHUNK_SIZE; ++i)
+        {
+            ((uint8_t*)put_blocks[b]->m_BlockData)[i] = (uint8_t)((i / 7) ^ (i % 13) ^ b);
+        }
+        struct TestAsyncPutBlockComplete putCB;
+        ASSERT_EQ(0, compress_block_store_api->PutStoredBlock(compress_block_store_api, put_blocks[b], &putCB.m_API));
+        putCB.Wait();
+        ASSERT_EQ(0, putCB.m_Err);
+    }
+
+    for (uint32_t b = 0; b < BLOCK_COUNT; ++b)
+    {
+        struct TestAsyncGetBlockComplete getRawCB;
+        ASSERT_EQ(0, local_block_store_api->GetStoredBlock(local_block_store_api, 0xdeadbeef + b, &getRawCB.m_API));
+        getRawCB.Wait();
+        ASSERT_EQ(0, getRawCB.m_Err);
+        uint32_t stored_tag = *getRawCB.m_StoredBlock->m_BlockIndex->m_Tag;
+        getRawCB.m_StoredBlock->Dispose(getRawCB.m_StoredBlock);
+        // The level only moves once enough blocks have been measured so the first block uses the middle level,
+        // where the later blocks end up depends on the machine so they are only checked to stay within the family
+        if (b == 0)
+        {
+            ASSERT_EQ(Longtail_GetZStdHighQuality(), stored_tag);
+        }
+        else if (b == BLOCK_COUNT - 1)
+        {
+            ASSERT_EQ(Longtail_GetLZ4DefaultQuality(), stored_tag);
+        }
+        else
+        {
+            ASSERT_TRUE(stored_tag == adaptive_types[0] || stored_tag == adaptive_types[1] || stored_tag == adaptive_types[2]);
+        }
+
+        struct TestAsyncGetBlockComplete getCB;
+        ASSERT_EQ(0, compress_block_store_api->GetStoredBlock(compress_block_store_api, 0xdeadbeef + b, &getCB.m_API));
+        getCB.Wait();
+        ASSERT_EQ(0, getCB.m_Err);
+        ASSERT_EQ(CHUNK_SIZE, getCB.m_StoredBlock->m_BlockChunksDataSize);
+        ASSERT_EQ(0, memcmp(put_blocks[b]->m_BlockData, getCB.m_StoredBlock->m_BlockData, CHUNK_SIZE));
+        getCB.m_StoredBlock->Dispose(getCB.m_StoredBlock);
+        put_blocks[b]->Dispose(put_blocks[b]);
+    }
+
+    SAFE_DISPOSE_API(compress_block_store_api);
+    SAFE_DISPOSE_API(local_block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(compression_registry);
+    SAFE_DISPOSE_API(local_storage_api);
+}
+
+TEST(Longtail, Longtail_CompressBlockStoreGetNextAdaptiveLevel)
+{
+    // Slow puts move towards stronger compression, stopping at the strongest level
+    ASSERT_EQ(2u, Longtail_CompressBlockStore_GetNextAdaptiveLevel(1, 3, 1000, 1600));
+    ASSERT_EQ(2u, Longtail_CompressBlockStore_GetNextAdaptiveLevel(2, 3, 1000, 100000));
+
+    // Slow compression moves towards faster compression, stopping at the fastest level
+    ASSERT_EQ(0u, Longtail_CompressBlockStore_GetNextAdaptiveLevel(1, 3, 1600, 1000));
+    ASSERT_EQ(0u, Longtail_CompressBlockStore_GetNextAdaptiveLevel(0, 3, 100000, 1000));
+
+    // Within 3/2 of each other the level is kept
+    ASSERT_EQ(1u, Longtail_CompressBlockStore_GetNextAdaptiveLevel(1, 3, 1000, 1500));
+    ASSERT_EQ(1u, Longtail_CompressBlockStore_GetNextAdaptiveLevel(1, 3, 1500, 1000));
+    ASSERT_EQ(1u, Longtail_CompressBlockStore_GetNextAdaptiveLevel(1, 3, 0, 0));
+
+    // A single level never moves
+    ASSERT_EQ(0u, Longtail_CompressBlockStore_GetNextAdaptiveLevel(0, 1, 1000, 100000));
+    ASSERT_EQ(0u, Longtail_CompressBlockStore_GetNextAdaptiveLevel(0, 1, 100000, 1000));
+}
+
+TEST(Longtail, Longtail_TranscodeBlockStore)
+{
+    static const uint32_t CHUNK_SIZES[2] = {9000, 7000};
+
+    const uint32_t transcode_types[2] = {0, Longtail_GetLZ4DefaultQuality()};
+    for (uint32_t t = 0; t < 2; ++t)
+    {
+        Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+        Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+        Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(4, 0);
+        Longtail_BlockStoreAPI* remote_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "remote", 0, 0);
+        Longtail_BlockStoreAPI* local_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "local", 0, 0);
+        Longtail_BlockStoreAPI* remote_compress_block_store_api = Longtail_CreateCompressBlockStoreAPI(remote_block_store_api, compression_registry);
+        Longtail_BlockStoreAPI* transcode_block_store_api = Longtail_CreateTranscodeBlockStoreAPI(local_block_store_api, compression_registry, job_api, transcode_types[t]);
+        ASSERT_NE((Longtail_BlockStoreAPI*)0, transcode_block_store_api);
+        Longtail_BlockStoreAPI* cache_block_store_api = Longtail_CreateCacheBlockStoreAPI(job_api, transcode_block_store_api, remote_block_store_api);
+        Longtail_BlockStoreAPI* compress_block_store_api = Longtail_CreateCompressBlockStoreAPI(cache_block_store_api, compression_registry);
+
+        TLongtail_Hash chunk_hashes[2] = {0xf001fa5, 0xf001fa6};
+        uint32_t chunk_sizes[2] = {CHUNK_SIZES[0], CHUNK_SIZES[1]};
+        uint32_t block_chunks_data_size = CHUNK_SIZES[0] + CHUNK_SIZES[1];
+        Longtail_StoredBlock* put_block;
+        ASSERT_EQ(0, Longtail_CreateStoredBlock(0xdeadbeef, 0, 2, Longtail_GetZStdMaxQuality(), chunk_hashes, chunk_sizes, block_chunks_data_size, &put_block));
+        for (uint32_t i = 0; i < block_chunks_data_size; ++i)
+        {
+            ((uint8_t*)put_block->m_BlockData)[i] = (uint8_t)((i / 7) ^ (i % 13));
+        }
+        struct TestAsyncPutBlockComplete putCB;
+        ASSERT_EQ(0, remote_compress_block_store_api->PutStoredBlock(remote_compress_block_store_api, put_block, &putCB.m_API));
+        putCB.Wait();
+        ASSERT_EQ(0, putCB.m_Err);
+
+        // First get is served by the remote store and transcoded into the local store, second get is a cache hit
+        for (uint32_t g = 0; g < 2; ++g)
+        {
+            struct TestAsyncGetBlockComplete getCB;
+            ASSERT_EQ(0, compress_block_store_api->GetStoredBlock(compress_block_store_api, 0xdeadbeef, &getCB.m_API));
+            getCB.Wait();
+            ASSERT_EQ(0, getCB.m_Err);
+            ASSERT_EQ(block_chunks_data_size, getCB.m_StoredBlock->m_BlockChunksDataSize);
+            ASSERT_EQ(0, memcmp(put_block->m_BlockData, getCB.m_StoredBlock->m_BlockData, block_chunks_data_size));
+            getCB.m_StoredBlock->Dispose(getCB.m_StoredBlock);
+
+            struct TestAsyncFlushComplete flushCB;
+            ASSERT_EQ(0, compress_block_store_api->Flush(compress_block_store_api, &flushCB.m_API));
+            flushCB.Wait();
+            ASSERT_EQ(0, flushCB.m_Err);
+        }
+
+        struct TestAsyncGetBlockComplete getRemoteCB;
+        ASSERT_EQ(0, remote_block_store_api->GetStoredBlock(remote_block_store_api, 0xdeadbeef, &getRemoteCB.m_API));
+        getRemoteCB.Wait();
+        ASSERT_EQ(0, getRemoteCB.m_Err);
+        ASSERT_EQ(Longtail_GetZStdMaxQuality(), *getRemoteCB.m_StoredBlock->m_BlockIndex->m_Tag);
+        getRemoteCB.m_StoredBlock->Dispose(getRemoteCB.m_StoredBlock);
+
+        struct TestAsyncGetBlockComplete getLocalCB;
+        ASSERT_EQ(0, local_block_store_api->GetStoredBlock(local_block_store_api, 0xdeadbeef, &getLocalCB.m_API));
+        getLocalCB.Wait();
+        ASSERT_EQ(0, getLocalCB.m_Err);
+        ASSERT_EQ(transcode_types[t], *getLocalCB.m_StoredBlock->m_BlockIndex->m_Tag);
+        if (transcode_types[t] == 0)
+        {
+            ASSERT_EQ(block_chunks_data_size, getLocalCB.m_StoredBlock->m_BlockChunksDataSize);
+            ASSERT_EQ(0, memcmp(put_block->m_BlockData, getLocalCB.m_StoredBlock->m_BlockData, block_chunks_data_size));
+        }
+        getLocalCB.m_StoredBlock->Dispose(getLocalCB.m_StoredBlock);
+
+        // The transcode store hands out stored blocks, it has no decompressing get into a buffer
+        void* buffer = Longtail_Alloc(0, block_chunks_data_size);
+        struct TestAsyncGetBlockComplete getBufferCB;
+        ASSERT_EQ(ENOTSUP, Longtail_BlockStore_GetStoredBlockToBuffer(transcode_block_store_api, 0xdeadbeef, buffer, block_chunks_data_size, &getBufferCB.m_API));
+        Longtail_Free(buffer);
+        put_block->Dispose(put_block);
+
+        SAFE_DISPOSE_API(compress_block_store_api);
+        SAFE_DISPOSE_API(cache_block_store_api);
+        SAFE_DISPOSE_API(transcode_block_store_api);
+        SAFE_DISPOSE_API(remote_compress_block_store_api);
+        SAFE_DISPOSE_API(local_block_store_api);
+        SAFE_DISPOSE_API(remote_block_store_api);
+        SAFE_DISPOSE_API(job_api);
+        SAFE_DISPOSE_API(compression_registry);
+        SAFE_DISPOSE_API(storage_api);
+    }
+}
+
+TEST(Longtail, Longtail_CompressBlockStoreGetStoredBlockToBuffer)
+{
+    static const uint32_t CHUNK_SIZES[2] = {3111, 2048};
+
+    Longtail_StorageAPI* local_storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(1, 0);
+    Longtail_BlockStoreAPI* local_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, local_storage_api, "chunks", 0, 0);
+    Longtail_BlockStoreAPI* compress_block_store_api = Longtail_CreateCompressBlockStoreAPI(local_block_store_api, compression_registry);
+    ASSERT_NE((Longtail_BlockStoreAPI*)0, compress_block_store_api);
+
+    size_t block_index_size = Longtail_GetBlockIndexSize(2);
+    uint32_t block_chunks_data_size = CHUNK_SIZES[0] + CHUNK_SIZES[1];
+    Longtail_StoredBlock* put_block = (struct Longtail_StoredBlock*)Longtail_Alloc(0, Longtail_GetStoredBlockSize(block_index_size + block_chunks_data_size));
+    put_block->Dispose = 0;
+    put_block->m_BlockIndex = Longtail_InitBlockIndex(&put_block[1], 2);
+    *put_block->m_BlockIndex->m_BlockHash = 0xdeadbeef;
+    *put_block->m_BlockIndex->m_HashIdentifier = hash_api->GetIdentifier(hash_api);
+    *put_block->m_BlockIndex->m_Tag = Longtail_GetZStdDefaultQuality();
+    for (uint32_t c = 0; c < 2; ++c)
+    {
+        put_block->m_BlockIndex->m_ChunkHashes[c] = 0xf001fa5 + c;
+        put_block->m_BlockIndex->m_ChunkSizes[c] = CHUNK_SIZES[c];
+    }
+    *put_block->m_BlockIndex->m_ChunkCount = 2;
+    put_block->m_BlockChunksDataSize = block_chunks_data_size;
+    put_block->m_BlockData = &((uint8_t*)put_block->m_BlockIndex)[block_index_size];
+    for (uint32_t i = 0; i < block_chunks_data_size; ++i)
+    {
+        ((uint8_t*)put_block->m_BlockData)[i] = (uint8_t)((i / 5) ^ (i % 11));
+    }
+
+    struct TestAsyncPutBlockComplete putCB;
+    ASSERT_EQ(0, compress_block_store_api->PutStoredBlock(compress_block_store_api, put_block, &putCB.m_API));
+    putCB.Wait();
+    ASSERT_EQ(0, putCB.m_Err);
+
+    // The block data is decompressed into the caller buffer
+    void* buffer = Longtail_Alloc(0, block_chunks_data_size);
+    struct TestAsyncGetBlockComplete getCB1;
+    ASSERT_EQ(0, Longtail_BlockStore_GetStoredBlockToBuffer(compress_block_store_api, 0xdeadbeef, buffer, block_chunks_data_size, &getCB1.m_API));
+    getCB1.Wait();
+    ASSERT_EQ(0, getCB1.m_Err);
+    ASSERT_EQ(buffer, getCB1.m_StoredBlock->m_BlockData);
+    ASSERT_EQ(block_chunks_data_size, getCB1.m_StoredBlock->m_BlockChunksDataSize);
+    ASSERT_EQ(0xdeadbeef, *getCB1.m_StoredBlock->m_BlockIndex->m_BlockHash);
+    ASSERT_EQ(CHUNK_SIZES[1], getCB1.m_StoredBlock->m_BlockIndex->m_ChunkSizes[1]);
+    ASSERT_EQ(0, memcmp(put_block->m_BlockData, buffer, block_chunks_data_size));
+    getCB1.m_StoredBlock->Dispose(getCB1.m_StoredBlock);
+
+    // A buffer that can not hold the block data is rejected
+    struct TestAsyncGetBlockComplete getCB2;
+    ASSERT_EQ(0, Longtail_BlockStore_GetStoredBlockToBuffer(compress_block_store_api, 0xdeadbeef, buffer, block_chunks_data_size - 1, &getCB2.m_API));
+    getCB2.Wait();
+    ASSERT_EQ(EINVAL, getCB2.m_Err);
+
+    // Block stores without the entry point report it as unsupported
+    struct TestAsyncGetBlockComplete getCB3;
+    ASSERT_EQ(ENOTSUP, Longtail_BlockStore_GetStoredBlockToBuffer(local_block_store_api, 0xdeadbeef, buffer, block_chunks_data_size, &getCB3.m_API));
+
+    // Wrapping block stores forward the entry point only if the store they wrap has it
+    Longtail_BlockStoreAPI* remote_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, local_storage_api, "remote", 0, 0);
+    Longtail_BlockStoreAPI* cache_block_store_api = Longtail_CreateCacheBlockStoreAPI(job_api, compress_block_store_api, remote_block_store_api);
+    Longtail_BlockStoreAPI* delta_block_store_api = Longtail_CreateDeltaBlockStoreAPI(cache_block_store_api, 0, 0);
+    Longtail_BlockStoreAPI* lru_block_store_api = Longtail_CreateLRUBlockStoreAPI(delta_block_store_api, 3);
+    Longtail_BlockStoreAPI* share_block_store_api = Longtail_CreateShareBlockStoreAPI(lru_block_store_api);
+    Longtail_BlockStoreAPI* unsupported_block_store_api = Longtail_CreateLRUBlockStoreAPI(local_block_store_api, 3);
+    ASSERT_NE((Longtail_BlockStore_GetStoredBlockToBufferFunc)0, share_block_store_api->GetStoredBlockToBuffer);
+    ASSERT_EQ((Longtail_BlockStore_GetStoredBlockToBufferFunc)0, unsupported_block_store_api->GetStoredBlockToBuffer);
+    struct TestAsyncGetBlockComplete getCB4;
+    ASSERT_EQ(ENOTSUP, Longtail_BlockStore_GetStoredBlockToBuffer(unsupported_block_store_api, 0xdeadbeef, buffer, block_chunks_data_size, &getCB4.m_API));
+
+    memset(buffer, 0, block_chunks_data_size);
+    struct TestAsyncGetBlockComplete getCB5;
+    ASSERT_EQ(0, Longtail_BlockStore_GetStoredBlockToBuffer(share_block_store_api, 0xdeadbeef, buffer, block_chunks_data_size, &getCB5.m_API));
+    getCB5.Wait();
+    ASSERT_EQ(0, getCB5.m_Err);
+    ASSERT_EQ(buffer, getCB5.m_StoredBlock->m_BlockData);
+    ASSERT_EQ(0, memcmp(put_block->m_BlockData, buffer, block_chunks_data_size));
+    getCB5.m_StoredBlock->Dispose(getCB5.m_StoredBlock);
+
+    // A block already held by the LRU store is handed out as is
+    struct TestAsyncGetBlockComplete getCB6;
+    ASSERT_EQ(0, share_block_store_api->GetStoredBlock(share_block_store_api, 0xdeadbeef, &getCB6.m_API));
+    getCB6.Wait();
+    ASSERT_EQ(0, getCB6.m_Err);
+    getCB6.m_StoredBlock->Dispose(getCB6.m_StoredBlock);
+    memset(buffer, 0, block_chunks_data_size);
+    struct TestAsyncGetBlockComplete getCB7;
+    ASSERT_EQ(0, Longtail_BlockStore_GetStoredBlockToBuffer(share_block_store_api, 0xdeadbeef, buffer, block_chunks_data_size, &getCB7.m_API));
+    getCB7.Wait();
+    ASSERT_EQ(0, getCB7.m_Err);
+    ASSERT_NE(buffer, getCB7.m_StoredBlock->m_BlockData);
+    ASSERT_EQ(0, memcmp(put_block->m_BlockData, getCB7.m_StoredBlock->m_BlockData, block_chunks_data_size));
+    getCB7.m_StoredBlock->Dispose(getCB7.m_StoredBlock);
+
+    Longtail_Free(buffer);
+    Longtail_Free(put_block);
+
+    SAFE_DISPOSE_API(unsupported_block_store_api);
+    SAFE_DISPOSE_API(share_block_store_api);
+    SAFE_DISPOSE_API(lru_block_store_api);
+    SAFE_DISPOSE_API(delta_block_store_api);
+    SAFE_DISPOSE_API(cache_block_store_api);
+    SAFE_DISPOSE_API(remote_block_store_api);
+    SAFE_DISPOSE_API(compress_block_store_api);
+    SAFE_DISPOSE_API(local_block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(compression_registry);
+    SAFE_DISPOSE_API(local_storage_api);
+}
+
 TEST(Longtail, Longtail_TestGetFilesRecursively)
 {
     Longtail_StorageAPI* storage = Longtail_CreateInMemStorageAPI();
@@ -4666,6 +5462,10 @@ TEST(Longtail, TestFullHashRegistry)
             break;
     }
 
+    struct Longtail_HashAPI* xxh3_hash_api = 0;
+    ASSERT_EQ(0, hash_registry->GetHashAPI(hash_registry, Longtail_GetXXH3HashType(), &xxh3_hash_api));
+    ASSERT_NE((struct Longtail_HashAPI*)0, xxh3_hash_api);
+
     struct Longtail_HashAPI* error_hash_api = 0;
     ASSERT_EQ(ENOENT, hash_registry->GetHashAPI(hash_registry, 0xdeadbeefu, &error_hash_api));
     ASSERT_EQ((struct Longtail_HashAPI*)0, error_hash_api);
@@ -5708,6 +6508,8 @@ struct FailableStorageAPI
     static int MapFile(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HOpenFile f, uint64_t offset, uint64_t length, Longtail_StorageAPI_HFileMap* out_file_map, const void** out_data_ptr) { struct FailableStorageAPI* api = (struct FailableStorageAPI*)storage_api; return api->m_BackingAPI->MapFile(api->m_BackingAPI, f, offset, length, out_file_map, out_data_ptr);}
     static void UnmapFile(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HFileMap m) { struct FailableStorageAPI* api = (struct FailableStorageAPI*)storage_api; return api->m_BackingAPI->UnMapFile(api->m_BackingAPI, m); }
     static int OpenAppendFile(struct Longtail_StorageAPI* storage_api, const char* path, Longtail_StorageAPI_HOpenFile* out_open_file) { struct FailableStorageAPI* api = (struct FailableStorageAPI*)storage_api; return api->m_BackingAPI->OpenAppendFile(api->m_BackingAPI, path, out_open_file); }
+    static int WriteV(struct Longtail_StorageAPI* storage_api, Longtail_StorageAPI_HOpenFile f, uint64_t offset, uint32_t vec_count, const struct Longtail_StorageAPI_IOVec* vecs) { struct FailableStorageAPI* api = (struct FailableStorageAPI*)storage_api; return ((api->m_PassCount-- <= 0) && offset > 0 && api->m_WriteError != 0) ? api->m_WriteError : api->m_BackingAPI->WriteV(api->m_BackingAPI, f, offset, vec_count, vecs);}
+    static int GetFileStat(struct Longtail_StorageAPI* storage_api, const char* path, uint64_t* out_size, uint64_t* out_modification_time, uint64_t* out_change_time, uint64_t* out_file_id) { struct FailableStorageAPI* api = (struct FailableStorageAPI*)storage_api; return api->m_BackingAPI->GetFileStat(api->m_BackingAPI, path, out_size, out_modification_time, out_change_time, out_file_id); }
 };
 
 struct FailableStorageAPI* CreateFailableStorageAPI(struct Longtail_StorageAPI* backing_api)
@@ -5741,7 +6543,9 @@ struct FailableStorageAPI* CreateFailableStorageAPI(struct Longtail_StorageAPI*
         FailableStorageAPI::GetParentPath,
         FailableStorageAPI::MapFile,
         FailableStorageAPI::UnmapFile,
-        FailableStorageAPI::OpenAppendFile);
+        FailableStorageAPI::OpenAppendFile,
+        FailableStorageAPI::WriteV,
+        FailableStorageAPI::GetFileStat);
     struct FailableStorageAPI* failable_storage_api = (struct FailableStorageAPI*)api;
     failable_storage_api->m_BackingAPI = backing_api;
     failable_storage_api->m_PassCount = 0x7fffffff;
@@ -6164,6 +6968,270 @@ TEST(Longtail, TestLongtailBlockFS)
     SAFE_DISPOSE_API(mem_storage);
 }
 
+TEST(Longtail, TestLongtailBlockFSSequentialRead)
+{
+    static const uint32_t MAX_BLOCK_SIZE = 4096;
+    static const uint32_t MAX_CHUNKS_PER_BLOCK = 16u;
+    static const uint32_t FILE_SIZE = MAX_BLOCK_SIZE * 24;
+    static const uint32_t READ_SIZE = 100;
+
+    Longtail_StorageAPI* mem_storage = Longtail_CreateInMemStorageAPI();
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(8, 0);
+    Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    Longtail_BlockStoreAPI* raw_block_store = Longtail_CreateFSBlockStoreAPI(job_api, mem_storage, "store", 0, 0);
+    Longtail_BlockStoreAPI* block_store = Longtail_CreateCompressBlockStoreAPI(raw_block_store, compression_registry);
+
+    uint8_t* content_data = (uint8_t*)Longtail_Alloc(0, FILE_SIZE);
+    GenerateRandomData(content_data, FILE_SIZE);
+    ASSERT_EQ(0, mem_storage->CreateDir(mem_storage, "source"));
+    Longtail_StorageAPI_HOpenFile w;
+    ASSERT_EQ(0, mem_storage->OpenWriteFile(mem_storage, "source/data.bin", 0, &w));
+    ASSERT_EQ(0, mem_storage->Write(mem_storage, w, 0, FILE_SIZE, content_data));
+    mem_storage->CloseFile(mem_storage, w);
+
+    Longtail_FileInfos* version_paths;
+    ASSERT_EQ(0, Longtail_GetFilesRecursively2(mem_storage, job_api, 0, 0, 0, "source", &version_paths));
+    Longtail_VersionIndex* vindex;
+    ASSERT_EQ(0, Longtail_CreateVersionIndex(
+        mem_storage,
+        hash_api,
+        chunker_api,
+        job_api,
+        0,
+        0,
+        0,
+        "source",
+        version_paths,
+        0,
+        MAX_BLOCK_SIZE / MAX_CHUNKS_PER_BLOCK,
+        0,
+        &vindex));
+
+    struct Longtail_StoreIndex* store_index;
+    ASSERT_EQ(0, Longtail_CreateStoreIndex(
+        hash_api,
+        *vindex->m_ChunkCount,
+        vindex->m_ChunkHashes,
+        vindex->m_ChunkSizes,
+        vindex->m_ChunkTags,
+        MAX_BLOCK_SIZE,
+        MAX_CHUNKS_PER_BLOCK,
+        &store_index));
+    ASSERT_LT(4u, *store_index->m_BlockCount);
+    ASSERT_EQ(0, Longtail_WriteContent(
+        mem_storage,
+        block_store,
+        job_api,
+        0,
+        0,
+        0,
+        store_index,
+        vindex,
+        "source"));
+
+    struct Longtail_StorageAPI* block_store_fs = Longtail_CreateBlockStoreStorageAPI(
+        hash_api,
+        job_api,
+        block_store,
+        store_index,
+        vindex);
+    ASSERT_NE((struct Longtail_StorageAPI*)0, block_store_fs);
+
+    Longtail_StorageAPI_HOpenFile block_store_file;
+    ASSERT_EQ(0, block_store_fs->OpenReadFile(block_store_fs, "data.bin", &block_store_file));
+    uint8_t* buf = (uint8_t*)Longtail_Alloc(0, FILE_SIZE);
+    for (uint32_t o = 0; o < FILE_SIZE; o += READ_SIZE)
+    {
+        uint32_t s = (o + READ_SIZE) > FILE_SIZE ? FILE_SIZE - o : READ_SIZE;
+        ASSERT_EQ(0, block_store_fs->Read(block_store_fs, block_store_file, o, s, &buf[o]));
+    }
+    ASSERT_EQ(0, memcmp(content_data, buf, FILE_SIZE));
+
+    // Small sequential reads fetch each block once
+    Longtail_BlockStore_Stats stats;
+    ASSERT_EQ(0, raw_block_store->GetStats(raw_block_store, &stats));
+    ASSERT_EQ(*store_index->m_BlockCount, stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count]);
+
+    // Reading backwards still returns the right content
+    memset(buf, 0, FILE_SIZE);
+    for (uint32_t o = FILE_SIZE; o > 0;)
+    {
+        uint32_t s = o > (READ_SIZE * 7) ? (READ_SIZE * 7) : o;
+        o -= s;
+        ASSERT_EQ(0, block_store_fs->Read(block_store_fs, block_store_file, o, s, &buf[o]));
+    }
+    ASSERT_EQ(0, memcmp(content_data, buf, FILE_SIZE));
+    block_store_fs->CloseFile(block_store_fs, block_store_file);
+
+    // A random read in a newly opened file only gets the chunks it needs from the compress block store
+    ASSERT_EQ(0, block_store_fs->OpenReadFile(block_store_fs, "data.bin", &block_store_file));
+    ASSERT_EQ(0, block_store->GetStats(block_store, &stats));
+    uint64_t chunk_count_before = stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Chunk_Count];
+    const uint32_t random_read_offset = FILE_SIZE / 2 + 17;
+    ASSERT_EQ(0, block_store_fs->Read(block_store_fs, block_store_file, random_read_offset, 1, &buf[random_read_offset]));
+    ASSERT_EQ(content_data[random_read_offset], buf[random_read_offset]);
+    ASSERT_EQ(0, block_store->GetStats(block_store, &stats));
+    ASSERT_EQ(1u, stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Chunk_Count] - chunk_count_before);
+    block_store_fs->CloseFile(block_store_fs, block_store_file);
+
+    Longtail_Free(buf);
+    SAFE_DISPOSE_API(block_store_fs);
+    Longtail_Free(store_index);
+    Longtail_Free(vindex);
+    Longtail_Free(version_paths);
+    Longtail_Free(content_data);
+    SAFE_DISPOSE_API(block_store);
+    SAFE_DISPOSE_API(raw_block_store);
+    SAFE_DISPOSE_API(compression_registry);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(chunker_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(mem_storage);
+}
+
+struct BlockFSConcurrentReadContext
+{
+    Longtail_StorageAPI* m_BlockStoreFS;
+    Longtail_StorageAPI_HOpenFile m_File;
+    const uint8_t* m_ContentData;
+    uint32_t m_FileSize;
+    TLongtail_Atomic32 m_NextThread;
+    TLongtail_Atomic32 m_FailCount;
+};
+
+static int BlockFSConcurrentReadWorker(void* context_data)
+{
+    struct BlockFSConcurrentReadContext* context = (struct BlockFSConcurrentReadContext*)context_data;
+    uint32_t thread_index = (uint32_t)Longtail_AtomicAdd32(&context->m_NextThread, 1);
+    uint8_t* buf = (uint8_t*)Longtail_Alloc(0, context->m_FileSize);
+    // Mix sequential and scattered reads of different sizes so the threads move the seek position and block cache of the shared file around
+    uint32_t read_size = 97 + thread_index * 131;
+    uint32_t stride = (thread_index & 1) ? read_size * 5 : read_size;
+    for (uint32_t pass = 0; pass < 4; ++pass)
+    {
+        for (uint32_t o = (pass * read_size) % stride; o < context->m_FileSize; o += stride)
+        {
+            uint32_t size = (o + read_size) > context->m_FileSize ? context->m_FileSize - o : read_size;
+            if (context->m_BlockStoreFS->Read(context->m_BlockStoreFS, context->m_File, o, size, &buf[o]) != 0 ||
+                memcmp(&context->m_ContentData[o], &buf[o], size) != 0)
+            {
+                Longtail_AtomicAdd32(&context->m_FailCount, 1);
+            }
+        }
+    }
+    Longtail_Free(buf);
+    return 0;
+}
+
+TEST(Longtail, TestLongtailBlockFSConcurrentRead)
+{
+    static const uint32_t MAX_BLOCK_SIZE = 4096;
+    static const uint32_t MAX_CHUNKS_PER_BLOCK = 16u;
+    static const uint32_t FILE_SIZE = MAX_BLOCK_SIZE * 24;
+
+    Longtail_StorageAPI* mem_storage = Longtail_CreateInMemStorageAPI();
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(8, 0);
+    Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    Longtail_BlockStoreAPI* raw_block_store = Longtail_CreateFSBlockStoreAPI(job_api, mem_storage, "store", 0, 0);
+    Longtail_BlockStoreAPI* block_store = Longtail_CreateCompressBlockStoreAPI(raw_block_store, compression_registry);
+
+    uint8_t* content_data = (uint8_t*)Longtail_Alloc(0, FILE_SIZE);
+    GenerateRandomData(content_data, FILE_SIZE);
+    ASSERT_EQ(0, mem_storage->CreateDir(mem_storage, "source"));
+    Longtail_StorageAPI_HOpenFile w;
+    ASSERT_EQ(0, mem_storage->OpenWriteFile(mem_storage, "source/data.bin", 0, &w));
+    ASSERT_EQ(0, mem_storage->Write(mem_storage, w, 0, FILE_SIZE, content_data));
+    mem_storage->CloseFile(mem_storage, w);
+
+    Longtail_FileInfos* version_paths;
+    ASSERT_EQ(0, Longtail_GetFilesRecursively2(mem_storage, job_api, 0, 0, 0, "source", &version_paths));
+    Longtail_VersionIndex* vindex;
+    ASSERT_EQ(0, Longtail_CreateVersionIndex(
+        mem_storage,
+        hash_api,
+        chunker_api,
+        job_api,
+        0,
+        0,
+        0,
+        "source",
+        version_paths,
+        0,
+        MAX_BLOCK_SIZE / MAX_CHUNKS_PER_BLOCK,
+        0,
+        &vindex));
+
+    struct Longtail_StoreIndex* store_index;
+    ASSERT_EQ(0, Longtail_CreateStoreIndex(
+        hash_api,
+        *vindex->m_ChunkCount,
+        vindex->m_ChunkHashes,
+        vindex->m_ChunkSizes,
+        vindex->m_ChunkTags,
+        MAX_BLOCK_SIZE,
+        MAX_CHUNKS_PER_BLOCK,
+        &store_index));
+    ASSERT_EQ(0, Longtail_WriteContent(
+        mem_storage,
+        block_store,
+        job_api,
+        0,
+        0,
+        0,
+        store_index,
+        vindex,
+        "source"));
+
+    struct Longtail_StorageAPI* block_store_fs = Longtail_CreateBlockStoreStorageAPI(
+        hash_api,
+        job_api,
+        block_store,
+        store_index,
+        vindex);
+    ASSERT_NE((struct Longtail_StorageAPI*)0, block_store_fs);
+
+    // One open file is read from several threads at once
+    struct BlockFSConcurrentReadContext context;
+    context.m_BlockStoreFS = block_store_fs;
+    ASSERT_EQ(0, block_store_fs->OpenReadFile(block_store_fs, "data.bin", &context.m_File));
+    context.m_ContentData = content_data;
+    context.m_FileSize = FILE_SIZE;
+    context.m_NextThread = 0;
+    context.m_FailCount = 0;
+
+    static const uint32_t WORKER_COUNT = 8;
+    HLongtail_Thread worker_threads[WORKER_COUNT];
+    for (uint32_t t = 0; t < WORKER_COUNT; ++t)
+    {
+        ASSERT_EQ(0, Longtail_CreateThread(Longtail_Alloc(0, Longtail_GetThreadSize()), BlockFSConcurrentReadWorker, 0, &context, -1, &worker_threads[t]));
+    }
+    for (uint32_t t = 0; t < WORKER_COUNT; ++t)
+    {
+        Longtail_JoinThread(worker_threads[t], LONGTAIL_TIMEOUT_INFINITE);
+        Longtail_DeleteThread(worker_threads[t]);
+        Longtail_Free(worker_threads[t]);
+    }
+    ASSERT_EQ(0, context.m_FailCount);
+    block_store_fs->CloseFile(block_store_fs, context.m_File);
+
+    SAFE_DISPOSE_API(block_store_fs);
+    Longtail_Free(store_index);
+    Longtail_Free(vindex);
+    Longtail_Free(version_paths);
+    Longtail_Free(content_data);
+    SAFE_DISPOSE_API(block_store);
+    SAFE_DISPOSE_API(raw_block_store);
+    SAFE_DISPOSE_API(compression_registry);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(chunker_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(mem_storage);
+}
+
 struct FSBlockStoreSyncWriteContentWorkerContext {
     Longtail_StorageAPI* mem_storage;
     Longtail_HashAPI* hash_api;
@@ -6491,7 +7559,9 @@ static int DownloadFolder(
     const char* target_path,
     uint32_t TARGET_CHUNK_SIZE,
     uint32_t MAX_BLOCK_SIZE,
-    uint32_t MAX_CHUNKS_PER_BLOCK)
+    uint32_t MAX_CHUNKS_PER_BLOCK,
+    int use_local_chunks,
+    int detect_moved_assets)
 {
     struct Longtail_VersionIndex* version_index;
     int err = Longtail_ReadVersionIndex(storage_api, version_index_path, &version_index);
@@ -6528,7 +7598,7 @@ static int DownloadFolder(
     }
 
     struct Longtail_VersionDiff* version_diff;
-    err = Longtail_CreateVersionDiff(hash_api, current_version_index, version_index, &version_diff);
+    err = Longtail_CreateVersionDiff2(hash_api, current_version_index, version_index, detect_moved_assets, &version_diff);
     if (err)
     {
         return err;
@@ -6554,7 +7624,7 @@ static int DownloadFolder(
     Longtail_Free(required_chunk_hashes);
 
     Longtail_ConcurrentChunkWriteAPI* concurrent_chunk_write_api = Longtail_CreateConcurrentChunkWriteAPI(storage_api, version_index, version_diff, target_path);
-    err = Longtail_ChangeVersion2(
+    err = Longtail_ChangeVersion3(
         block_store_api,
         storage_api,
         concurrent_chunk_write_api,
@@ -6568,7 +7638,8 @@ static int DownloadFolder(
         version_index,
         version_diff,
         target_path,
-        1);
+        1,
+        use_local_chunks);
     SAFE_DISPOSE_API(concurrent_chunk_write_api);
     if (err)
     {
@@ -6824,7 +7895,7 @@ TEST(Longtail, TestCacheBlockStoreGetExistingContent)
         {
             char lvi_name[64];
             sprintf(lvi_name, "%s.lvi", version_names[w]);
-            ASSERT_EQ(0, DownloadFolder(storage_api, hash_api, chunker_api, job_api, cache_block_store_api, lvi_name, "current", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+            ASSERT_EQ(0, DownloadFolder(storage_api, hash_api, chunker_api, job_api, cache_block_store_api, lvi_name, "current", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK, 0, 0));
 
             {
                 TestAsyncFlushComplete flushCB;
@@ -7236,6 +8307,21 @@ TEST(Longtail, Longtail_PruneFSBlockStore)
         ASSERT_EQ(0, getCB2.m_Err);
     }
 
+    {
+        // The compress block store prunes the backing store with the same keep list
+        Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+        Longtail_BlockStoreAPI* compress_block_store_api = Longtail_CreateCompressBlockStoreAPI(block_store_api, compression_registry);
+        TestAsyncPruneBlocksComplete compressPruneCB;
+        ASSERT_EQ(0, compress_block_store_api->PruneBlocks(compress_block_store_api, 1, &block_hashes[0], &compressPruneCB.m_API));
+        compressPruneCB.Wait();
+        ASSERT_EQ(0, compressPruneCB.m_Err);
+        ASSERT_EQ(1, compressPruneCB.m_PruneCount);
+        struct TestAsyncGetBlockComplete getCB2;
+        ASSERT_EQ(ENOENT, block_store_api->GetStoredBlock(block_store_api, block_hashes[2], &getCB2.m_API));
+        SAFE_DISPOSE_API(compress_block_store_api);
+        SAFE_DISPOSE_API(compression_registry);
+    }
+
     SAFE_DISPOSE_API(block_store_api);
     SAFE_DISPOSE_API(job_api);
     SAFE_DISPOSE_API(storage_api);
@@ -8123,225 +9209,1993 @@ TEST(Longtail, Longtail_ReadBrokenLSI)
     ASSERT_NE(err, 0);
 }
 
-TEST(Longtail, Longtail_CaseSensitivePaths)
+TEST(Longtail, Longtail_CompactStore)
 {
-    static const uint32_t TARGET_CHUNK_SIZE = 16u;
-    static const uint32_t MAX_BLOCK_SIZE = 32u;
-    static const uint32_t MAX_CHUNKS_PER_BLOCK = 3u;
+    static const uint32_t TARGET_CHUNK_SIZE = 64u;
+    static const uint32_t MAX_BLOCK_SIZE = 1024u;
+    static const uint32_t MAX_CHUNKS_PER_BLOCK = 16u;
+    static const uint32_t FILE_SIZE = 100u;
 
-    Longtail_StorageAPI* source_storage = Longtail_CreateInMemStorageAPI();
-    Longtail_StorageAPI* target_storage = Longtail_CreateInMemStorageAPI();
-    Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
     Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
     Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
     Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
-    Longtail_BlockStoreAPI* fs_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, target_storage, "chunks", 0, 0);
-    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateCompressBlockStoreAPI(fs_block_store_api, compression_registry);
-
-    const char* TEST_FILENAMES1[2] = {
-        "local1/lowercase.txt",
-        "local1/UPPERCASE.txt",
-    };
-
-    const char* TEST_FILENAMES2[2] = {
-        "local2/LOWERCASE.txt",
-        "local2/uppercase.txt",
-    };
-
-    const char* TEST_STRINGS[2] = {
-        "This is the first test string which is fairly long and should - reconstructed properly, than you very much",
-        "Short string"
-    };
+    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "chunks", 0, 0);
 
-    for (uint32_t i = 0; i < 2; ++i)
+    // Version 2 keeps every other file of version 1 so the blocks of version 1 are about half used by version 2
+    uint8_t data[FILE_SIZE];
+    for (uint32_t i = 0; i < 20; ++i)
     {
-        ASSERT_NE(0, CreateParentPath(source_storage, TEST_FILENAMES1[i]));
-        Longtail_StorageAPI_HOpenFile w;
-        ASSERT_EQ(0, source_storage->OpenWriteFile(source_storage, TEST_FILENAMES1[i], 0, &w));
-        ASSERT_NE((Longtail_StorageAPI_HOpenFile)0, w);
-        ASSERT_EQ(0, source_storage->Write(source_storage, w, 0, strlen(TEST_STRINGS[i]) + 1, TEST_STRINGS[i]));
-        source_storage->CloseFile(source_storage, w);
-        w = 0;
+        uint32_t seed = 0x9e3779b9u * (i + 1);
+        for (uint32_t b = 0; b < FILE_SIZE; ++b)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            data[b] = (uint8_t)(seed >> 24);
+        }
+        char path[64];
+        for (uint32_t v = 0; v < 2; ++v)
+        {
+            if ((v == 0 && i >= 16) || (v == 1 && i < 16 && (i & 1)))
+            {
+                continue;
+            }
+            sprintf(path, "v%u/file%u.bin", v + 1, i);
+            ASSERT_NE(0, CreateParentPath(storage_api, path));
+            Longtail_StorageAPI_HOpenFile w;
+            ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, path, 0, &w));
+            ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, data));
+            storage_api->CloseFile(storage_api, w);
+        }
     }
 
-    for (uint32_t i = 0; i < 2; ++i)
-    {
-        ASSERT_NE(0, CreateParentPath(source_storage, TEST_FILENAMES2[i]));
-        Longtail_StorageAPI_HOpenFile w;
-        ASSERT_EQ(0, source_storage->OpenWriteFile(source_storage, TEST_FILENAMES2[i], 0, &w));
-        ASSERT_NE((Longtail_StorageAPI_HOpenFile)0, w);
-        ASSERT_EQ(0, source_storage->Write(source_storage, w, 0, strlen(TEST_STRINGS[i]) + 1, TEST_STRINGS[i]));
-        source_storage->CloseFile(source_storage, w);
-        w = 0;
-    }
+    ASSERT_EQ(0, UploadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "v1", "v1.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+    ASSERT_EQ(0, UploadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "v2", "v2.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
 
-    ASSERT_EQ(0, UploadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "local1", "version1.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
-    ASSERT_EQ(0, UploadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "local2", "version2.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+    Longtail_VersionIndex* version1_index;
+    ASSERT_EQ(0, Longtail_ReadVersionIndex(storage_api, "v1.lvi", &version1_index));
+    Longtail_VersionIndex* version2_index;
+    ASSERT_EQ(0, Longtail_ReadVersionIndex(storage_api, "v2.lvi", &version2_index));
 
-    ASSERT_EQ(0, DownloadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "version1.lvi", "target", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+    Longtail_StoreIndex* version1_store_index = SyncGetExistingContent(block_store_api, *version1_index->m_ChunkCount, version1_index->m_ChunkHashes, 0);
+    ASSERT_NE((Longtail_StoreIndex*)0, version1_store_index);
+    Longtail_StoreIndex* version2_store_index = SyncGetExistingContent(block_store_api, *version2_index->m_ChunkCount, version2_index->m_ChunkHashes, 0);
+    ASSERT_NE((Longtail_StoreIndex*)0, version2_store_index);
+    Longtail_StoreIndex* store_index;
+    ASSERT_EQ(0, Longtail_MergeStoreIndex(version1_store_index, version2_store_index, &store_index));
+    Longtail_Free(version2_store_index);
+    Longtail_Free(version1_store_index);
 
-    ASSERT_EQ(1, source_storage->IsFile(source_storage, "target/UPPERCASE.txt"));
-    ASSERT_EQ(1, source_storage->IsFile(source_storage, "target/lowercase.txt"));
+    const Longtail_VersionIndex* live_versions[1] = {version2_index};
+    Longtail_StoreIndex* compacted_store_index;
+    ASSERT_EQ(0, Longtail_CompactStore(block_store_api, hash_api, job_api, 0, 0, 0, store_index, 1, live_versions, 75, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK, &compacted_store_index));
+    ASSERT_EQ(0, Longtail_ValidateStore(compacted_store_index, version2_index));
+    ASSERT_LT(*compacted_store_index->m_BlockCount, *store_index->m_BlockCount);
+    ASSERT_LT(*compacted_store_index->m_ChunkCount, *store_index->m_ChunkCount);
 
-    ASSERT_EQ(0, source_storage->IsFile(source_storage, "target/uppercase.txt"));
-    ASSERT_EQ(0, source_storage->IsFile(source_storage, "target/LOWERCASE.txt"));
+    // A second pass finds nothing to repack
+    Longtail_StoreIndex* recompacted_store_index;
+    ASSERT_EQ(0, Longtail_CompactStore(block_store_api, hash_api, job_api, 0, 0, 0, compacted_store_index, 1, live_versions, 75, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK, &recompacted_store_index));
+    ASSERT_EQ(*compacted_store_index->m_BlockCount, *recompacted_store_index->m_BlockCount);
+    for (uint32_t b = 0; b < *compacted_store_index->m_BlockCount; ++b)
+    {
+        ASSERT_EQ(compacted_store_index->m_BlockHashes[b], recompacted_store_index->m_BlockHashes[b]);
+    }
+    Longtail_Free(recompacted_store_index);
 
-    ASSERT_EQ(0, DownloadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "version2.lvi", "target", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+    TestAsyncFlushComplete flushCB;
+    ASSERT_EQ(0, block_store_api->Flush(block_store_api, &flushCB.m_API));
+    flushCB.Wait();
+    ASSERT_EQ(0, flushCB.m_Err);
 
-    Longtail_FileInfos* file_infos;
-    ASSERT_EQ(0, Longtail_GetFilesRecursively2(source_storage, job_api, 0, 0, 0, "target", &file_infos));
-    ASSERT_EQ(2u, file_infos->m_Count);
-    Longtail_Free(file_infos);
+    TestAsyncPruneBlocksComplete pruneCB;
+    ASSERT_EQ(0, block_store_api->PruneBlocks(block_store_api, *compacted_store_index->m_BlockCount, compacted_store_index->m_BlockHashes, &pruneCB.m_API));
+    pruneCB.Wait();
+    ASSERT_EQ(0, pruneCB.m_Err);
+    ASSERT_NE(0u, pruneCB.m_PruneCount);
 
-    ASSERT_EQ(1, source_storage->IsFile(source_storage, "target/uppercase.txt"));
-    ASSERT_EQ(1, source_storage->IsFile(source_storage, "target/LOWERCASE.txt"));
+    ASSERT_EQ(0, DownloadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "v2.lvi", "target", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK, 0, 0));
+    ASSERT_EQ(0, ValidateVersion(storage_api, hash_api, chunker_api, job_api, "v2", "target", TARGET_CHUNK_SIZE));
 
-    ASSERT_EQ(0, source_storage->IsFile(source_storage, "target/UPPERCASE.txt"));
-    ASSERT_EQ(0, source_storage->IsFile(source_storage, "target/lowercase.txt"));
+    Longtail_Free(compacted_store_index);
+    Longtail_Free(store_index);
+    Longtail_Free(version2_index);
+    Longtail_Free(version1_index);
 
     SAFE_DISPOSE_API(block_store_api);
-    SAFE_DISPOSE_API(fs_block_store_api);
     SAFE_DISPOSE_API(job_api);
     SAFE_DISPOSE_API(chunker_api);
     SAFE_DISPOSE_API(hash_api);
-    SAFE_DISPOSE_API(compression_registry);
-    SAFE_DISPOSE_API(target_storage);
-    SAFE_DISPOSE_API(source_storage);
+    SAFE_DISPOSE_API(storage_api);
 }
 
-// Test writing blocks within a file in reverse order
-TEST(Longtail, Longtail_OutOfOrderWrites)
+TEST(Longtail, Longtail_BlockRefCountIndex)
 {
-    static const uint32_t CONTENT_SIZE = 1024 * 2u;
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
 
-    Longtail_StorageAPI* local_storage = Longtail_CreateFSStorageAPI();
-    char* temp_folder = Longtail_GetTempFolder();
-    char* test_file = local_storage->ConcatPath(local_storage, temp_folder, "longtail.test.ooowrite");
-    if (local_storage->IsFile(local_storage, test_file))
+    const TLongtail_Hash VERSION1_BLOCKS[3] = {0x1000, 0x2000, 0x2000};
+    const TLongtail_Hash VERSION2_BLOCKS[2] = {0x2000, 0x3000};
+
+    Longtail_BlockRefCountIndex* empty_index;
+    ASSERT_EQ(0, Longtail_CreateBlockRefCountIndex(0, 0, 0, &empty_index));
+    ASSERT_EQ(0u, *empty_index->m_BlockCount);
+
+    Longtail_BlockRefCountIndex* version1_index;
+    ASSERT_EQ(0, Longtail_RegisterBlockRefs(empty_index, 3, VERSION1_BLOCKS, &version1_index));
+    ASSERT_EQ(2u, *version1_index->m_BlockCount);
+    ASSERT_EQ(1u, version1_index->m_RefCounts[0]);
+    ASSERT_EQ(1u, version1_index->m_RefCounts[1]);
+
+    Longtail_BlockRefCountIndex* version2_index;
+    ASSERT_EQ(0, Longtail_RegisterBlockRefs(version1_index, 2, VERSION2_BLOCKS, &version2_index));
+    ASSERT_EQ(3u, *version2_index->m_BlockCount);
+    ASSERT_EQ(0x1000u, version2_index->m_BlockHashes[0]);
+    ASSERT_EQ(1u, version2_index->m_RefCounts[0]);
+    ASSERT_EQ(0x2000u, version2_index->m_BlockHashes[1]);
+    ASSERT_EQ(2u, version2_index->m_RefCounts[1]);
+    ASSERT_EQ(0x3000u, version2_index->m_BlockHashes[2]);
+    ASSERT_EQ(1u, version2_index->m_RefCounts[2]);
+
+    ASSERT_EQ(0, Longtail_WriteBlockRefCountIndex(storage_api, version2_index, "store.lbr"));
+    Longtail_BlockRefCountIndex* read_index;
+    ASSERT_EQ(0, Longtail_ReadBlockRefCountIndex(storage_api, "store.lbr", &read_index));
+    ASSERT_EQ(3u, *read_index->m_BlockCount);
+    ASSERT_EQ(0, memcmp(version2_index->m_BlockHashes, read_index->m_BlockHashes, sizeof(TLongtail_Hash) * 3));
+    ASSERT_EQ(0, memcmp(version2_index->m_RefCounts, read_index->m_RefCounts, sizeof(uint32_t) * 3));
+
+    // Retiring version 1 releases the block only it used
+    Longtail_BlockRefCountIndex* retired_index;
+    ASSERT_EQ(0, Longtail_RetireBlockRefs(read_index, 3, VERSION1_BLOCKS, &retired_index));
+    ASSERT_EQ(2u, *retired_index->m_BlockCount);
+    ASSERT_EQ(0x2000u, retired_index->m_BlockHashes[0]);
+    ASSERT_EQ(1u, retired_index->m_RefCounts[0]);
+    ASSERT_EQ(0x3000u, retired_index->m_BlockHashes[1]);
+    ASSERT_EQ(1u, retired_index->m_RefCounts[1]);
+
+    void* buffer;
+    size_t size;
+    ASSERT_EQ(0, Longtail_WriteBlockRefCountIndexToBuffer(retired_index, &buffer, &size));
+    Longtail_BlockRefCountIndex* buffer_index;
+    ASSERT_EQ(0, Longtail_ReadBlockRefCountIndexFromBuffer(buffer, size, &buffer_index));
+    Longtail_Free(buffer);
+
+    Longtail_BlockRefCountIndex* final_index;
+    ASSERT_EQ(0, Longtail_RetireBlockRefs(buffer_index, 2, VERSION2_BLOCKS, &final_index));
+    ASSERT_EQ(0u, *final_index->m_BlockCount);
+
+    // Zero reference counts are never stored, they are rejected on create and on read
+    const uint32_t ZERO_REF_COUNTS[2] = {1, 0};
+    Longtail_BlockRefCountIndex* zero_index;
+    ASSERT_EQ(EINVAL, Longtail_CreateBlockRefCountIndex(2, VERSION2_BLOCKS, ZERO_REF_COUNTS, &zero_index));
+    ASSERT_EQ(0, Longtail_WriteBlockRefCountIndexToBuffer(version2_index, &buffer, &size));
+    ((uint32_t*)&((TLongtail_Hash*)&((uint32_t*)buffer)[2])[3])[1] = 0;
+    ASSERT_EQ(EBADF, Longtail_ReadBlockRefCountIndexFromBuffer(buffer, size, &zero_index));
+    Longtail_Free(buffer);
+
+    // Updating the index file registers and retires under a lock file, a missing file is an empty index
+    Longtail_BlockRefCountIndex* file_index;
+    ASSERT_EQ(0, Longtail_UpdateBlockRefCountIndex(storage_api, "refs/store.lbr", 3, VERSION1_BLOCKS, 0, 0));
+    ASSERT_EQ(0, Longtail_UpdateBlockRefCountIndex(storage_api, "refs/store.lbr", 2, VERSION2_BLOCKS, 0, &file_index));
+    ASSERT_EQ(3u, *file_index->m_BlockCount);
+    ASSERT_EQ(0, memcmp(version2_index->m_RefCounts, file_index->m_RefCounts, sizeof(uint32_t) * 3));
+    Longtail_Free(file_index);
+    ASSERT_EQ(0, Longtail_UpdateBlockRefCountIndex(storage_api, "refs/store.lbr", 3, VERSION1_BLOCKS, 1, 0));
+    ASSERT_FALSE(storage_api->IsFile(storage_api, "refs/store.lbr.tmp"));
+    ASSERT_FALSE(storage_api->IsFile(storage_api, "refs/store.lbr.bak"));
+    ASSERT_EQ(0, Longtail_ReadBlockRefCountIndex(storage_api, "refs/store.lbr", &file_index));
+    ASSERT_EQ(2u, *file_index->m_BlockCount);
+    ASSERT_EQ(0, memcmp(retired_index->m_BlockHashes, file_index->m_BlockHashes, sizeof(TLongtail_Hash) * 2));
+    Longtail_Free(file_index);
+
+    // An update interrupted after the index was moved to the backup continues from the backup
+    ASSERT_EQ(0, storage_api->RenameFile(storage_api, "refs/store.lbr", "refs/store.lbr.bak"));
+    ASSERT_EQ(0, Longtail_UpdateBlockRefCountIndex(storage_api, "refs/store.lbr", 1, VERSION1_BLOCKS, 0, &file_index));
+    ASSERT_EQ(3u, *file_index->m_BlockCount);
+    Longtail_Free(file_index);
+    ASSERT_FALSE(storage_api->IsFile(storage_api, "refs/store.lbr.bak"));
+
+    Longtail_Free(final_index);
+    Longtail_Free(buffer_index);
+    Longtail_Free(retired_index);
+    Longtail_Free(read_index);
+    Longtail_Free(version2_index);
+    Longtail_Free(version1_index);
+    Longtail_Free(empty_index);
+    SAFE_DISPOSE_API(storage_api);
+}
+
+static void AssertEqualVersionIndex(const Longtail_VersionIndex* a, const Longtail_VersionIndex* b)
+{
+    ASSERT_EQ(*a->m_HashIdentifier, *b->m_HashIdentifier);
+    ASSERT_EQ(*a->m_TargetChunkSize, *b->m_TargetChunkSize);
+    ASSERT_EQ(*a->m_AssetCount, *b->m_AssetCount);
+    ASSERT_EQ(*a->m_ChunkCount, *b->m_ChunkCount);
+    ASSERT_EQ(*a->m_AssetChunkIndexCount, *b->m_AssetChunkIndexCount);
+    for (uint32_t i = 0; i < *a->m_AssetCount; ++i)
     {
-        ASSERT_EQ(0, local_storage->RemoveFile(local_storage, test_file));
+        ASSERT_EQ(a->m_PathHashes[i], b->m_PathHashes[i]);
+        ASSERT_EQ(a->m_ContentHashes[i], b->m_ContentHashes[i]);
+        ASSERT_EQ(a->m_AssetSizes[i], b->m_AssetSizes[i]);
+        ASSERT_EQ(a->m_AssetChunkCounts[i], b->m_AssetChunkCounts[i]);
+        ASSERT_EQ(a->m_AssetChunkIndexStarts[i], b->m_AssetChunkIndexStarts[i]);
+        ASSERT_EQ(a->m_Permissions[i], b->m_Permissions[i]);
+        ASSERT_STREQ(&a->m_NameData[a->m_NameOffsets[i]], &b->m_NameData[b->m_NameOffsets[i]]);
     }
+    for (uint32_t i = 0; i < *a->m_AssetChunkIndexCount; ++i)
+    {
+        ASSERT_EQ(a->m_AssetChunkIndexes[i], b->m_AssetChunkIndexes[i]);
+    }
+    for (uint32_t i = 0; i < *a->m_ChunkCount; ++i)
+    {
+        ASSERT_EQ(a->m_ChunkHashes[i], b->m_ChunkHashes[i]);
+        ASSERT_EQ(a->m_ChunkSizes[i], b->m_ChunkSizes[i]);
+        ASSERT_EQ(a->m_ChunkTags[i], b->m_ChunkTags[i]);
+    }
+}
 
-    char* data_ff = (char*)Longtail_Alloc(0, sizeof(char) * CONTENT_SIZE/2);
-    char* data_7f = (char*)Longtail_Alloc(0, sizeof(char) * CONTENT_SIZE/2);
-    char* data_tmp = (char*)Longtail_Alloc(0, sizeof(char) * CONTENT_SIZE/2);
-    memset(data_ff, (int)255, CONTENT_SIZE/2);
-    memset(data_7f, (int)127, CONTENT_SIZE/2);
-
-    Longtail_StorageAPI_HOpenFile content_file;
+// Rewrites an uncompressed format 2 compact index as the format 1 encoding written by older versions,
+// only the first section_count sections are kept and the payload is compressed if compression_api is set
+static void* MakeCompactIndexFormat1(const void* buffer, uint32_t section_count, Longtail_CompressionAPI* compression_api, uint32_t compression_type, size_t* out_size)
+{
+    uint32_t header[6];
+    memcpy(header, buffer, sizeof(header));
+    const uint8_t* table = &((const uint8_t*)buffer)[sizeof(header)];
+    uint8_t* payload = (uint8_t*)Longtail_Alloc(0, 65536);
+    uint8_t* p = payload;
+    uint64_t value;
+    for (uint32_t h = 0; h < header[4] + section_count; ++h)
+    {
+        if (h < header[4])
+        {
+            memcpy(&value, &table[h * sizeof(uint64_t)], sizeof(value));
+        }
+        else
+        {
+            memcpy(&value, &table[header[4] * sizeof(uint64_t) + (h - header[4]) * sizeof(uint64_t) * 3 + sizeof(uint64_t)], sizeof(value));
+        }
+        while (value >= 0x80)
+        {
+            *p++ = (uint8_t)(value | 0x80);
+            value >>= 7;
+        }
+        *p++ = (uint8_t)value;
+    }
+    for (uint32_t s = 0; s < section_count; ++s)
+    {
+        uint64_t entry[3];
+        memcpy(entry, &table[header[4] * sizeof(uint64_t) + s * sizeof(entry)], sizeof(entry));
+        memcpy(p, &((const uint8_t*)buffer)[entry[0]], (size_t)entry[1]);
+        p += entry[1];
+    }
+    uint64_t payload_size = (uint64_t)(p - payload);
+    size_t stored_size = (size_t)payload_size;
+    uint8_t* result = (uint8_t*)Longtail_Alloc(0, sizeof(uint32_t) * 4 + sizeof(uint64_t) + 65536);
+    if (compression_api)
+    {
+        compression_api->Compress(compression_api, compression_type, (const char*)payload, (char*)&result[sizeof(uint32_t) * 4 + sizeof(uint64_t)], stored_size, 65536, &stored_size);
+    }
+    else
+    {
+        memcpy(&result[sizeof(uint32_t) * 4 + sizeof(uint64_t)], payload, stored_size);
+    }
+    Longtail_Free(payload);
+    header[1] = 1;
+    header[2] = compression_api ? compression_type : 0;
+    memcpy(result, header, sizeof(uint32_t) * 4);
+    memcpy(&result[sizeof(uint32_t) * 4], &payload_size, sizeof(payload_size));
+    *out_size = sizeof(uint32_t) * 4 + sizeof(uint64_t) + stored_size;
+    return result;
+}
 
-    // Fill the second half of the file with 0xff
-    local_storage->OpenWriteFile(local_storage, test_file, 0, &content_file);
-    ASSERT_EQ(0,local_storage->Write(local_storage, content_file, CONTENT_SIZE/2, CONTENT_SIZE/2, data_ff));
-    local_storage->CloseFile(local_storage, content_file);
+TEST(Longtail, Longtail_CompactIndexes)
+{
+    static const uint32_t TARGET_CHUNK_SIZE = 64u;
+    static const uint32_t MAX_BLOCK_SIZE = 1024u;
+    static const uint32_t MAX_CHUNKS_PER_BLOCK = 16u;
+    static const uint32_t FILE_SIZE = 300u;
 
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
+    Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "chunks", 0, 0);
 
-    // Fill the first half of the file with 0x7f
-    local_storage->OpenAppendFile(local_storage, test_file, &content_file);
-    ASSERT_EQ(0,local_storage->Write(local_storage, content_file, 0, CONTENT_SIZE/2, data_7f));
-    local_storage->CloseFile(local_storage, content_file);
+    uint8_t data[FILE_SIZE];
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        uint32_t seed = 0x9e3779b9u * (i + 1);
+        for (uint32_t b = 0; b < FILE_SIZE; ++b)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            data[b] = (uint8_t)(seed >> 24);
+        }
+        char path[64];
+        sprintf(path, "source/folder%u/sub_folder%u/file%u.bin", i / 16, (i / 4) % 4, i);
+        ASSERT_NE(0, CreateParentPath(storage_api, path));
+        Longtail_StorageAPI_HOpenFile w;
+        ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, path, 0, &w));
+        ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, data));
+        storage_api->CloseFile(storage_api, w);
+    }
+    ASSERT_EQ(0, UploadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "source", "source.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
 
-    // Verify the contents
-    local_storage->OpenReadFile(local_storage, test_file, &content_file);
-    // The first half of the file should be 0x7f
-    ASSERT_EQ(0, local_storage->Read(local_storage, content_file, 0, CONTENT_SIZE/2, data_tmp));
-    ASSERT_EQ(0, memcmp(data_7f, data_tmp, CONTENT_SIZE/2));
+    Longtail_VersionIndex* version_index;
+    ASSERT_EQ(0, Longtail_ReadVersionIndex(storage_api, "source.lvi", &version_index));
+
+    void* raw_buffer = 0;
+    size_t raw_size = 0;
+    ASSERT_EQ(0, Longtail_WriteVersionIndexToBuffer(version_index, &raw_buffer, &raw_size));
+
+    void* compact_buffer = 0;
+    size_t compact_size = 0;
+    ASSERT_EQ(0, Longtail_WriteCompactVersionIndexToBuffer(version_index, 0, 0, &compact_buffer, &compact_size));
+    ASSERT_LT(compact_size, raw_size);
+
+    // An uncompressed compact version index is picked up by the plain read functions
+    Longtail_VersionIndex* compact_version_index;
+    ASSERT_EQ(0, Longtail_ReadVersionIndexFromBuffer(compact_buffer, compact_size, &compact_version_index));
+    AssertEqualVersionIndex(version_index, compact_version_index);
+    Longtail_Free(compact_version_index);
+    ASSERT_EQ(0, Longtail_ReadVersionIndexFromBuffer2(compact_buffer, compact_size, 0, job_api, &compact_version_index));
+    AssertEqualVersionIndex(version_index, compact_version_index);
+    Longtail_Free(compact_version_index);
+
+    // Format 1 indexes written by older versions are still read, the path directory is computed
+    Longtail_CompressionAPI* zstd_api;
+    uint32_t zstd_settings;
+    ASSERT_EQ(0, compression_registry->GetCompressionAPI(compression_registry, Longtail_GetZStdDefaultQuality(), &zstd_api, &zstd_settings));
+    for (uint32_t c = 0; c < 2; ++c)
+    {
+        size_t format_1_size;
+        void* format_1_buffer = MakeCompactIndexFormat1(compact_buffer, 11, c ? zstd_api : 0, Longtail_GetZStdDefaultQuality(), &format_1_size);
+        ASSERT_EQ(0, Longtail_ReadVersionIndexFromBuffer2(format_1_buffer, format_1_size, compression_registry, job_api, &compact_version_index));
+        AssertEqualVersionIndex(version_index, compact_version_index);
+        Longtail_Free(compact_version_index);
 
-    // The second half of the file should be 0xff
-    ASSERT_EQ(0, local_storage->Read(local_storage, content_file, CONTENT_SIZE/2, CONTENT_SIZE/2, data_tmp));
-    ASSERT_EQ(0, memcmp(data_ff, data_tmp, CONTENT_SIZE/2));
-    local_storage->CloseFile(local_storage, content_file);
+        Longtail_StorageAPI_HOpenFile w;
+        ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, "format1.lvi", 0, &w));
+        ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, format_1_size, format_1_buffer));
+        storage_api->CloseFile(storage_api, w);
+        Longtail_Free(format_1_buffer);
+        uint32_t* path_directory;
+        ASSERT_EQ(0, Longtail_ReadVersionIndexSections(storage_api, compression_registry, job_api, "format1.lvi", Longtail_VersionIndex_AssetSections, &compact_version_index, &path_directory));
+        for (uint32_t a = 1; a < *version_index->m_AssetCount; ++a)
+        {
+            ASSERT_LT(strcmp(&compact_version_index->m_NameData[compact_version_index->m_NameOffsets[path_directory[a - 1]]], &compact_version_index->m_NameData[compact_version_index->m_NameOffsets[path_directory[a]]]), 0);
+        }
+        Longtail_Free(path_directory);
+        Longtail_Free(compact_version_index);
+    }
+    Longtail_Free(compact_buffer);
 
-    SAFE_DISPOSE_API(local_storage);
+    void* compressed_buffer = 0;
+    size_t compressed_size = 0;
+    ASSERT_EQ(0, Longtail_WriteCompactVersionIndexToBuffer(version_index, compression_registry, Longtail_GetZStdDefaultQuality(), &compressed_buffer, &compressed_size));
+    ASSERT_EQ(EINVAL, Longtail_ReadVersionIndexFromBuffer(compressed_buffer, compressed_size, &compact_version_index));
+    ASSERT_EQ(0, Longtail_ReadVersionIndexFromBuffer2(compressed_buffer, compressed_size, compression_registry, job_api, &compact_version_index));
+    AssertEqualVersionIndex(version_index, compact_version_index);
+    Longtail_Free(compact_version_index);
+    Longtail_Free(compressed_buffer);
 
-    Longtail_Free(data_7f);
-    Longtail_Free(data_ff);
-    Longtail_Free(data_tmp);
-    Longtail_Free((void*)temp_folder);
-    Longtail_Free((void*)test_file);
+    ASSERT_EQ(0, Longtail_WriteCompactVersionIndex(storage_api, version_index, compression_registry, Longtail_GetZStdDefaultQuality(), "compact.lvi"));
+    ASSERT_EQ(0, Longtail_ReadVersionIndex2(storage_api, compression_registry, 0, "compact.lvi", &compact_version_index));
+    AssertEqualVersionIndex(version_index, compact_version_index);
+    Longtail_Free(compact_version_index);
+
+    // Raw data is still read by the new functions
+    ASSERT_EQ(0, Longtail_ReadVersionIndexFromBuffer2(raw_buffer, raw_size, compression_registry, job_api, &compact_version_index));
+    AssertEqualVersionIndex(version_index, compact_version_index);
+    Longtail_Free(compact_version_index);
+    Longtail_Free(raw_buffer);
+
+    Longtail_StoreIndex* store_index = SyncGetExistingContent(block_store_api, *version_index->m_ChunkCount, version_index->m_ChunkHashes, 0);
+    ASSERT_NE((Longtail_StoreIndex*)0, store_index);
+    ASSERT_EQ(0, Longtail_WriteStoreIndexToBuffer(store_index, &raw_buffer, &raw_size));
+    ASSERT_EQ(0, Longtail_WriteCompactStoreIndexToBuffer(store_index, 0, 0, &compact_buffer, &compact_size));
+    ASSERT_LT(compact_size, raw_size);
+    Longtail_Free(raw_buffer);
+
+    Longtail_StoreIndex* compact_store_index;
+    ASSERT_EQ(0, Longtail_ReadStoreIndexFromBuffer2(compact_buffer, compact_size, 0, job_api, &compact_store_index));
+    Longtail_Free(compact_store_index);
+    size_t format_1_size;
+    void* format_1_buffer = MakeCompactIndexFormat1(compact_buffer, 6, zstd_api, Longtail_GetZStdDefaultQuality(), &format_1_size);
+    ASSERT_EQ(0, Longtail_ReadStoreIndexFromBuffer2(format_1_buffer, format_1_size, compression_registry, job_api, &compact_store_index));
+    Longtail_Free(format_1_buffer);
+    Longtail_Free(compact_buffer);
+    ASSERT_EQ(0, Longtail_WriteCompactStoreIndex(storage_api, compact_store_index, compression_registry, Longtail_GetZStdDefaultQuality(), "compact.lsi"));
+    Longtail_Free(compact_store_index);
+    ASSERT_EQ(0, Longtail_ReadStoreIndex2(storage_api, compression_registry, job_api, "compact.lsi", &compact_store_index));
+    ASSERT_EQ(*store_index->m_HashIdentifier, *compact_store_index->m_HashIdentifier);
+    ASSERT_EQ(*store_index->m_BlockCount, *compact_store_index->m_BlockCount);
+    ASSERT_EQ(*store_index->m_ChunkCount, *compact_store_index->m_ChunkCount);
+    for (uint32_t b = 0; b < *store_index->m_BlockCount; ++b)
+    {
+        ASSERT_EQ(store_index->m_BlockHashes[b], compact_store_index->m_BlockHashes[b]);
+        ASSERT_EQ(store_index->m_BlockChunksOffsets[b], compact_store_index->m_BlockChunksOffsets[b]);
+        ASSERT_EQ(store_index->m_BlockChunkCounts[b], compact_store_index->m_BlockChunkCounts[b]);
+        ASSERT_EQ(store_index->m_BlockTags[b], compact_store_index->m_BlockTags[b]);
+    }
+    for (uint32_t c = 0; c < *store_index->m_ChunkCount; ++c)
+    {
+        ASSERT_EQ(store_index->m_ChunkHashes[c], compact_store_index->m_ChunkHashes[c]);
+        ASSERT_EQ(store_index->m_ChunkSizes[c], compact_store_index->m_ChunkSizes[c]);
+    }
+    Longtail_Free(compact_store_index);
+    Longtail_Free(store_index);
 
+    Longtail_Free(version_index);
+    SAFE_DISPOSE_API(block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(compression_registry);
+    SAFE_DISPOSE_API(chunker_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(storage_api);
 }
 
-// Test permissions on files and folders
-TEST(Longtail, Longtail_RetainPermissions)
+TEST(Longtail, Longtail_ReadVersionIndexSections)
 {
-    static const uint32_t TARGET_CHUNK_SIZE = 16u;
-    static const uint32_t MAX_BLOCK_SIZE = 32u;
-    static const uint32_t MAX_CHUNKS_PER_BLOCK = 3u;
+    static const uint32_t TARGET_CHUNK_SIZE = 64u;
+    static const uint32_t MAX_BLOCK_SIZE = 1024u;
+    static const uint32_t MAX_CHUNKS_PER_BLOCK = 16u;
+    static const uint32_t FILE_SIZE = 200u;
 
-    Longtail_StorageAPI* source_storage = Longtail_CreateInMemStorageAPI();
-    Longtail_StorageAPI* target_storage = Longtail_CreateInMemStorageAPI();
-    Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
     Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
     Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
+    Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
     Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
-    Longtail_BlockStoreAPI* fs_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, target_storage, "chunks", 0, 0);
-    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateCompressBlockStoreAPI(fs_block_store_api, compression_registry);
+    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "chunks", 0, 0);
 
-    const char* TEST_FILENAMES[2] = {
-        "local/file1.txt",
-        "local/file2.sh",
-    };
+    uint8_t data[FILE_SIZE];
+    for (uint32_t i = 0; i < 48; ++i)
+    {
+        memset(data, (int)i, FILE_SIZE);
+        char path[64];
+        sprintf(path, "source/folder%u/sub_folder%u/file%u.bin", i % 3, (i / 3) % 4, i);
+        ASSERT_NE(0, CreateParentPath(storage_api, path));
+        Longtail_StorageAPI_HOpenFile w;
+        ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, path, 0, &w));
+        ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, data));
+        storage_api->CloseFile(storage_api, w);
+    }
+    ASSERT_EQ(0, UploadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "source", "source.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
 
-    const uint16_t TEST_PERMISSIONS[2] = {
-        Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess | Longtail_StorageAPI_UserExecuteAccess,
-        Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess,
-    };
+    Longtail_VersionIndex* version_index;
+    ASSERT_EQ(0, Longtail_ReadVersionIndex(storage_api, "source.lvi", &version_index));
+    ASSERT_EQ(0, Longtail_WriteCompactVersionIndex(storage_api, version_index, compression_registry, Longtail_GetZStdDefaultQuality(), "compact.lvi"));
+    uint32_t asset_count = *version_index->m_AssetCount;
+
+    Longtail_VersionIndex* all_sections;
+    ASSERT_EQ(0, Longtail_ReadVersionIndexSections(storage_api, compression_registry, job_api, "compact.lvi", Longtail_VersionIndex_AllSections, &all_sections, 0));
+    AssertEqualVersionIndex(version_index, all_sections);
+    Longtail_Free(all_sections);
+
+    Longtail_VersionIndex* chunk_sections;
+    ASSERT_EQ(0, Longtail_ReadVersionIndexSections(storage_api, compression_registry, 0, "compact.lvi", Longtail_VersionIndex_ChunkSections, &chunk_sections, 0));
+    ASSERT_EQ((char*)0, chunk_sections->m_NameData);
+    ASSERT_EQ((uint32_t*)0, chunk_sections->m_AssetChunkIndexes);
+    for (uint32_t c = 0; c < *version_index->m_ChunkCount; ++c)
+    {
+        ASSERT_EQ(version_index->m_ChunkHashes[c], chunk_sections->m_ChunkHashes[c]);
+        ASSERT_EQ(version_index->m_ChunkSizes[c], chunk_sections->m_ChunkSizes[c]);
+    }
+    Longtail_Free(chunk_sections);
+
+    // The compact index stores the path directory, the plain index computes it
+    const char* paths[2] = {"compact.lvi", "source.lvi"};
+    for (uint32_t p = 0; p < 2; ++p)
+    {
+        Longtail_VersionIndex* asset_sections;
+        uint32_t* path_directory;
+        ASSERT_EQ(0, Longtail_ReadVersionIndexSections(storage_api, compression_registry, job_api, paths[p], Longtail_VersionIndex_AssetSections, &asset_sections, &path_directory));
+        if (p == 0)
+        {
+            ASSERT_EQ((TLongtail_Hash*)0, asset_sections->m_ChunkHashes);
+            ASSERT_EQ((uint32_t*)0, asset_sections->m_AssetChunkIndexStarts);
+        }
+        for (uint32_t a = 1; a < asset_count; ++a)
+        {
+            ASSERT_LT(strcmp(&asset_sections->m_NameData[asset_sections->m_NameOffsets[path_directory[a - 1]]], &asset_sections->m_NameData[asset_sections->m_NameOffsets[path_directory[a]]]), 0);
+        }
 
-    const uint16_t TEST_PERMISSIONS_MODIFIED[2] = {
-        Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess,
-        Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess | Longtail_StorageAPI_UserExecuteAccess,
-    };
+        uint32_t first;
+        uint32_t count;
+        ASSERT_EQ(0, Longtail_FindVersionIndexPaths(asset_sections, path_directory, "", &first, &count));
+        ASSERT_EQ(0u, first);
+        ASSERT_EQ(asset_count, count);
+
+        ASSERT_EQ(0, Longtail_FindVersionIndexPaths(asset_sections, path_directory, "folder1/sub_folder2/file19.bin", &first, &count));
+        ASSERT_EQ(1u, count);
+        uint32_t asset_index = path_directory[first];
+        ASSERT_STREQ("folder1/sub_folder2/file19.bin", &asset_sections->m_NameData[asset_sections->m_NameOffsets[asset_index]]);
+        ASSERT_EQ(FILE_SIZE, asset_sections->m_AssetSizes[asset_index]);
+
+        ASSERT_EQ(0, Longtail_FindVersionIndexPaths(asset_sections, path_directory, "folder1/sub_folder", &first, &count));
+        ASSERT_EQ(0u, count);
+        ASSERT_EQ(0, Longtail_FindVersionIndexPaths(asset_sections, path_directory, "folder3", &first, &count));
+        ASSERT_EQ(0u, count);
+
+        const char* folders[2] = {"folder1", "folder1/sub_folder2/"};
+        for (uint32_t f = 0; f < 2; ++f)
+        {
+            size_t folder_length = strlen("folder1/");
+            if (f == 1)
+            {
+                folder_length = strlen(folders[f]);
+            }
+            uint32_t expected_count = 0;
+            for (uint32_t a = 0; a < asset_count; ++a)
+            {
+                expected_count += strncmp(&version_index->m_NameData[version_index->m_NameOffsets[a]], f == 0 ? "folder1/" : folders[f], folder_length) == 0 ? 1 : 0;
+            }
+            ASSERT_EQ(0, Longtail_FindVersionIndexPaths(asset_sections, path_directory, folders[f], &first, &count));
+            ASSERT_EQ(expected_count, count);
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                ASSERT_EQ(0, strncmp(&asset_sections->m_NameData[asset_sections->m_NameOffsets[path_directory[i]]], f == 0 ? "folder1/" : folders[f], folder_length));
+            }
+        }
+        Longtail_Free(path_directory);
+        Longtail_Free(asset_sections);
+    }
 
-    const char* TEST_STRINGS[2] = {
-        "This is the first test string which is fairly long and should - reconstructed properly, than you very much",
-        "Short string"
-    };
+    Longtail_Free(version_index);
+    SAFE_DISPOSE_API(block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(compression_registry);
+    SAFE_DISPOSE_API(chunker_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(storage_api);
+}
 
-    for (uint32_t i = 0; i < 2; ++i)
+TEST(Longtail, Longtail_FilterVersionIndex)
+{
+    static const uint32_t TARGET_CHUNK_SIZE = 64u;
+    static const uint32_t MAX_BLOCK_SIZE = 256u;
+    static const uint32_t MAX_CHUNKS_PER_BLOCK = 4u;
+    static const uint32_t FILE_SIZE = 200u;
+
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "chunks", 0, 0);
+
+    uint8_t data[FILE_SIZE];
+    const char* platforms[3] = {"win64", "linux", "shared"};
+    for (uint32_t i = 0; i < 24; ++i)
     {
-        ASSERT_NE(0, CreateParentPath(source_storage, TEST_FILENAMES[i]));
+        memset(data, (int)i, FILE_SIZE);
+        char path[64];
+        sprintf(path, "source/%s/data/file%u.bin", platforms[i % 3], i);
+        ASSERT_NE(0, CreateParentPath(storage_api, path));
         Longtail_StorageAPI_HOpenFile w;
-        ASSERT_EQ(0, source_storage->OpenWriteFile(source_storage, TEST_FILENAMES[i], 0, &w));
-        ASSERT_NE((Longtail_StorageAPI_HOpenFile)0, w);
-        ASSERT_EQ(0, source_storage->Write(source_storage, w, 0, strlen(TEST_STRINGS[i]) + 1, TEST_STRINGS[i]));
-        source_storage->CloseFile(source_storage, w);
-        source_storage->SetPermissions(source_storage, TEST_FILENAMES[i], TEST_PERMISSIONS[i]);
-        w = 0;
+        ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, path, 0, &w));
+        ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, data));
+        storage_api->CloseFile(storage_api, w);
     }
+    ASSERT_EQ(0, UploadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "source", "source.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
 
-    ASSERT_EQ(0, UploadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "local", "version.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
-
-    for (uint32_t i = 0; i < 2; ++i)
+    // A file outside the filter in the target must be left as is
+    ASSERT_NE(0, CreateParentPath(storage_api, "target/linux/keep.bin"));
     {
-        source_storage->SetPermissions(source_storage, TEST_FILENAMES[i], TEST_PERMISSIONS_MODIFIED[i]);
+        Longtail_StorageAPI_HOpenFile w;
+        ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, "target/linux/keep.bin", 0, &w));
+        ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, 5, "keep!"));
+        storage_api->CloseFile(storage_api, w);
     }
 
-    ASSERT_EQ(0, UploadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "local", "version_modified.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+    struct ExcludeLinuxFilter
+    {
+        struct Longtail_PathFilterAPI m_API;
 
-    ASSERT_EQ(0, DownloadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "version.lvi", "target", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+        static int IncludeFunc(struct Longtail_PathFilterAPI* path_filter_api, const char* root_path, const char* asset_path, const char* asset_name, int is_dir, uint64_t size, uint16_t permissions)
+        {
+            return (is_dir && strcmp(asset_path, "linux") == 0) ? 0 : 1;
+        }
+    } exclude_linux_filter;
+    exclude_linux_filter.m_API.m_API.Dispose = 0;
+    exclude_linux_filter.m_API.Include = ExcludeLinuxFilter::IncludeFunc;
 
-    uint16_t permissions;
-    ASSERT_EQ(0, source_storage->GetPermissions(source_storage, "target/file1.txt", &permissions));
-    ASSERT_EQ((permissions & (Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess | Longtail_StorageAPI_UserExecuteAccess)), TEST_PERMISSIONS[0]);
-    ASSERT_EQ(0, source_storage->GetPermissions(source_storage, "target/file2.sh", &permissions));
-    ASSERT_EQ((permissions & (Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess)), TEST_PERMISSIONS[1]);
+    Longtail_VersionIndex* version_index;
+    ASSERT_EQ(0, Longtail_ReadVersionIndex(storage_api, "source.lvi", &version_index));
+    Longtail_VersionIndex* source_version_index;
+    ASSERT_EQ(0, Longtail_FilterVersionIndex(version_index, &exclude_linux_filter.m_API, "source", &source_version_index));
+    ASSERT_EQ(*version_index->m_HashIdentifier, *source_version_index->m_HashIdentifier);
+    ASSERT_EQ(*version_index->m_AssetCount - 1 - 1 - 8, *source_version_index->m_AssetCount);
+    ASSERT_LT(*source_version_index->m_ChunkCount, *version_index->m_ChunkCount);
+    for (uint32_t a = 0; a < *source_version_index->m_AssetCount; ++a)
+    {
+        const char* asset_path = &source_version_index->m_NameData[source_version_index->m_NameOffsets[a]];
+        ASSERT_NE(0, strncmp(asset_path, "linux/", 6));
+        uint64_t asset_size = 0;
+        for (uint32_t i = 0; i < source_version_index->m_AssetChunkCounts[a]; ++i)
+        {
+            uint32_t chunk_index = source_version_index->m_AssetChunkIndexes[source_version_index->m_AssetChunkIndexStarts[a] + i];
+            ASSERT_LT(chunk_index, *source_version_index->m_ChunkCount);
+            asset_size += source_version_index->m_ChunkSizes[chunk_index];
+        }
+        ASSERT_EQ(source_version_index->m_AssetSizes[a], asset_size);
+    }
 
-    ASSERT_EQ(0, DownloadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "version_modified.lvi", "target", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+    Longtail_FileInfos* target_file_infos;
+    ASSERT_EQ(0, Longtail_GetFilesRecursively2(storage_api, job_api, &exclude_linux_filter.m_API, 0, 0, "target", &target_file_infos));
+    Longtail_VersionIndex* target_version_index;
+    ASSERT_EQ(0, Longtail_CreateVersionIndex(storage_api, hash_api, chunker_api, job_api, 0, 0, 0, "target", target_file_infos, 0, TARGET_CHUNK_SIZE, 0, &target_version_index));
+    ASSERT_EQ(0u, *target_version_index->m_AssetCount);
+    Longtail_Free(target_file_infos);
 
-    ASSERT_EQ(0, source_storage->GetPermissions(source_storage, "target/file1.txt", &permissions));
-    ASSERT_EQ((permissions & (Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess)), TEST_PERMISSIONS_MODIFIED[0]);
-    ASSERT_EQ(0, source_storage->GetPermissions(source_storage, "target/file2.sh", &permissions));
-    ASSERT_EQ((permissions & (Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess | Longtail_StorageAPI_UserExecuteAccess)), TEST_PERMISSIONS_MODIFIED[1]);
+    Longtail_VersionDiff* version_diff;
+    ASSERT_EQ(0, Longtail_CreateVersionDiff2(hash_api, target_version_index, source_version_index, 1, &version_diff));
+    uint32_t required_chunk_count;
+    TLongtail_Hash* required_chunk_hashes = (TLongtail_Hash*)Longtail_Alloc(0, sizeof(TLongtail_Hash) * (*source_version_index->m_ChunkCount));
+    ASSERT_EQ(0, Longtail_GetRequiredChunkHashes(source_version_index, version_diff, &required_chunk_count, required_chunk_hashes));
+    ASSERT_EQ(*source_version_index->m_ChunkCount, required_chunk_count);
+    Longtail_StoreIndex* required_store_index = SyncGetExistingContent(block_store_api, required_chunk_count, required_chunk_hashes, 0);
+    ASSERT_NE((Longtail_StoreIndex*)0, required_store_index);
+    Longtail_StoreIndex* full_store_index = SyncGetExistingContent(block_store_api, *version_index->m_ChunkCount, version_index->m_ChunkHashes, 0);
+    ASSERT_NE((Longtail_StoreIndex*)0, full_store_index);
+    ASSERT_LT(*required_store_index->m_BlockCount, *full_store_index->m_BlockCount);
+    Longtail_Free(full_store_index);
+    Longtail_Free(required_chunk_hashes);
+
+    Longtail_ConcurrentChunkWriteAPI* concurrent_chunk_write_api = Longtail_CreateConcurrentChunkWriteAPI(storage_api, source_version_index, version_diff, "target");
+    ASSERT_EQ(0, Longtail_ChangeVersion2(
+        block_store_api,
+        storage_api,
+        concurrent_chunk_write_api,
+        hash_api,
+        job_api,
+        0,
+        0,
+        0,
+        required_store_index,
+        target_version_index,
+        source_version_index,
+        version_diff,
+        "target",
+        1));
+    SAFE_DISPOSE_API(concurrent_chunk_write_api);
+
+    ASSERT_EQ(1, storage_api->IsFile(storage_api, "target/win64/data/file0.bin"));
+    ASSERT_EQ(1, storage_api->IsFile(storage_api, "target/shared/data/file2.bin"));
+    ASSERT_EQ(0, storage_api->IsFile(storage_api, "target/linux/data/file1.bin"));
+    {
+        Longtail_StorageAPI_HOpenFile r;
+        ASSERT_EQ(0, storage_api->OpenReadFile(storage_api, "target/linux/keep.bin", &r));
+        uint64_t size;
+        ASSERT_EQ(0, storage_api->GetSize(storage_api, r, &size));
+        ASSERT_EQ(5u, size);
+        char keep[5];
+        ASSERT_EQ(0, storage_api->Read(storage_api, r, 0, 5, keep));
+        ASSERT_EQ(0, memcmp(keep, "keep!", 5));
+        storage_api->CloseFile(storage_api, r);
+    }
 
+    Longtail_Free(required_store_index);
+    Longtail_Free(version_diff);
+    Longtail_Free(target_version_index);
+    Longtail_Free(source_version_index);
+    Longtail_Free(version_index);
     SAFE_DISPOSE_API(block_store_api);
-    SAFE_DISPOSE_API(fs_block_store_api);
     SAFE_DISPOSE_API(job_api);
     SAFE_DISPOSE_API(chunker_api);
     SAFE_DISPOSE_API(hash_api);
-    SAFE_DISPOSE_API(compression_registry);
-    SAFE_DISPOSE_API(target_storage);
-    SAFE_DISPOSE_API(source_storage);
+    SAFE_DISPOSE_API(storage_api);
+}
+
+TEST(Longtail, Longtail_FolderState)
+{
+    static const uint32_t TARGET_CHUNK_SIZE = 64u;
+    static const uint32_t FILE_SIZE = 200u;
+
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+
+    uint8_t data[FILE_SIZE];
+    const char* paths[3] = {"folder/a.bin", "folder/sub/b.bin", "folder/sub/c.bin"};
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        memset(data, (int)i, FILE_SIZE);
+        ASSERT_NE(0, CreateParentPath(storage_api, paths[i]));
+        Longtail_StorageAPI_HOpenFile w;
+        ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, paths[i], 0, &w));
+        ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, data));
+        storage_api->CloseFile(storage_api, w);
+    }
+
+    Longtail_FileInfos* file_infos;
+    ASSERT_EQ(0, Longtail_GetFilesRecursively2(storage_api, job_api, 0, 0, 0, "folder", &file_infos));
+    Longtail_VersionIndex* version_index;
+    ASSERT_EQ(0, Longtail_CreateVersionIndex(storage_api, hash_api, chunker_api, job_api, 0, 0, 0, "folder", file_infos, 0, TARGET_CHUNK_SIZE, 0, &version_index));
+    Longtail_Free(file_infos);
+
+    Longtail_FolderState* folder_state;
+    ASSERT_EQ(0, Longtail_CreateFolderState(storage_api, "folder", version_index, &folder_state));
+    ASSERT_EQ(0, Longtail_WriteFolderState(storage_api, version_index, folder_state, "folder.lfs"));
+    Longtail_Free(folder_state);
+
+    Longtail_VersionIndex* state_version_index;
+    ASSERT_EQ(0, Longtail_ReadFolderState(storage_api, "folder.lfs", &state_version_index, &folder_state));
+    ASSERT_EQ(*version_index->m_AssetCount, *folder_state->m_AssetCount);
+    AssertEqualVersionIndex(version_index, state_version_index);
+    uint32_t c_asset_index = 0xffffffffu;
+    for (uint32_t a = 0; a < *state_version_index->m_AssetCount; ++a)
+    {
+        const char* asset_path = &state_version_index->m_NameData[state_version_index->m_NameOffsets[a]];
+        if (asset_path[strlen(asset_path) - 1] == '/')
+        {
+            ASSERT_EQ(0u, folder_state->m_ModificationTimes[a]);
+            continue;
+        }
+        ASSERT_NE(0u, folder_state->m_ModificationTimes[a]);
+        ASSERT_NE(0u, folder_state->m_FileIds[a]);
+        if (strcmp(asset_path, "sub/c.bin") == 0)
+        {
+            c_asset_index = a;
+        }
+    }
+    ASSERT_NE(0xffffffffu, c_asset_index);
+
+    // A reused asset keeps the content hash of the state, this one is not the real hash so we can tell it was not read
+    state_version_index->m_ContentHashes[c_asset_index] = 0x1234;
+
+    memset(data, 0x77, FILE_SIZE);
+    {
+        Longtail_StorageAPI_HOpenFile w;
+        ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, "folder/a.bin", 0, &w));
+        ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, data));
+        storage_api->CloseFile(storage_api, w);
+    }
+
+    ASSERT_EQ(0, Longtail_GetFilesRecursively2(storage_api, job_api, 0, 0, 0, "folder", &file_infos));
+    Longtail_VersionIndex* full_version_index;
+    ASSERT_EQ(0, Longtail_CreateVersionIndex(storage_api, hash_api, chunker_api, job_api, 0, 0, 0, "folder", file_infos, 0, TARGET_CHUNK_SIZE, 0, &full_version_index));
+    Longtail_VersionIndex* fast_version_index;
+    ASSERT_EQ(0, Longtail_CreateVersionIndexFromFolderState(storage_api, hash_api, chunker_api, job_api, 0, 0, 0, "folder", file_infos, 0, TARGET_CHUNK_SIZE, 0, state_version_index, folder_state, &fast_version_index));
+    ASSERT_EQ(*full_version_index->m_AssetCount, *fast_version_index->m_AssetCount);
+    for (uint32_t f = 0; f < *full_version_index->m_AssetCount; ++f)
+    {
+        const char* full_path = &full_version_index->m_NameData[full_version_index->m_NameOffsets[f]];
+        uint32_t a = 0;
+        while (a < *fast_version_index->m_AssetCount && strcmp(full_path, &fast_version_index->m_NameData[fast_version_index->m_NameOffsets[a]]) != 0)
+        {
+            ++a;
+        }
+        ASSERT_LT(a, *fast_version_index->m_AssetCount);
+        ASSERT_EQ(full_version_index->m_AssetSizes[f], fast_version_index->m_AssetSizes[a]);
+        ASSERT_EQ(full_version_index->m_Permissions[f], fast_version_index->m_Permissions[a]);
+        if (strcmp(full_path, "sub/c.bin") == 0)
+        {
+            ASSERT_EQ(0x1234u, fast_version_index->m_ContentHashes[a]);
+        }
+        else
+        {
+            ASSERT_EQ(full_version_index->m_ContentHashes[f], fast_version_index->m_ContentHashes[a]);
+        }
+    }
+    Longtail_Free(fast_version_index);
+
+    // A file modified at or after the folder state was written is read again
+    uint64_t write_time = folder_state->m_WriteTime;
+    ASSERT_LT(folder_state->m_ModificationTimes[c_asset_index], write_time);
+    folder_state->m_WriteTime = folder_state->m_ModificationTimes[c_asset_index];
+    ASSERT_EQ(0, Longtail_CreateVersionIndexFromFolderState(storage_api, hash_api, chunker_api, job_api, 0, 0, 0, "folder", file_infos, 0, TARGET_CHUNK_SIZE, 0, state_version_index, folder_state, &fast_version_index));
+    for (uint32_t a = 0; a < *fast_version_index->m_AssetCount; ++a)
+    {
+        ASSERT_NE(0x1234u, fast_version_index->m_ContentHashes[a]);
+    }
+    Longtail_Free(fast_version_index);
+    folder_state->m_WriteTime = write_time;
+
+    // A changed change time is not trusted even if the modification time is the same
+    ASSERT_EQ(0, storage_api->SetPermissions(storage_api, "folder/sub/c.bin", version_index->m_Permissions[c_asset_index]));
+    ASSERT_EQ(0, Longtail_CreateVersionIndexFromFolderState(storage_api, hash_api, chunker_api, job_api, 0, 0, 0, "folder", file_infos, 0, TARGET_CHUNK_SIZE, 0, state_version_index, folder_state, &fast_version_index));
+    for (uint32_t a = 0; a < *fast_version_index->m_AssetCount; ++a)
+    {
+        ASSERT_NE(0x1234u, fast_version_index->m_ContentHashes[a]);
+    }
+    Longtail_Free(fast_version_index);
+
+    // Nothing can be reused with a different target chunk size
+    Longtail_VersionIndex* rehashed_version_index;
+    ASSERT_EQ(0, Longtail_CreateVersionIndexFromFolderState(storage_api, hash_api, chunker_api, job_api, 0, 0, 0, "folder", file_infos, 0, TARGET_CHUNK_SIZE * 2, 0, state_version_index, folder_state, &rehashed_version_index));
+    for (uint32_t a = 0; a < *rehashed_version_index->m_AssetCount; ++a)
+    {
+        ASSERT_NE(0x1234u, rehashed_version_index->m_ContentHashes[a]);
+    }
+    Longtail_Free(rehashed_version_index);
+
+    Longtail_Free(full_version_index);
+    Longtail_Free(file_infos);
+    Longtail_Free(folder_state);
+    Longtail_Free(state_version_index);
+    Longtail_Free(version_index);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(chunker_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(storage_api);
+}
+
+TEST(Longtail, Longtail_CaseSensitivePaths)
+{
+    static const uint32_t TARGET_CHUNK_SIZE = 16u;
+    static const uint32_t MAX_BLOCK_SIZE = 32u;
+    static const uint32_t MAX_CHUNKS_PER_BLOCK = 3u;
+
+    Longtail_StorageAPI* source_storage = Longtail_CreateInMemStorageAPI();
+    Longtail_StorageAPI* target_storage = Longtail_CreateInMemStorageAPI();
+    Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+    Longtail_BlockStoreAPI* fs_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, target_storage, "chunks", 0, 0);
+    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateCompressBlockStoreAPI(fs_block_store_api, compression_registry);
+
+    const char* TEST_FILENAMES1[2] = {
+        "local1/lowercase.txt",
+        "local1/UPPERCASE.txt",
+    };
+
+    const char* TEST_FILENAMES2[2] = {
+        "local2/LOWERCASE.txt",
+        "local2/uppercase.txt",
+    };
+
+    const char* TEST_STRINGS[2] = {
+        "This is the first test string which is fairly long and should - reconstructed properly, than you very much",
+        "Short string"
+    };
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        ASSERT_NE(0, CreateParentPath(source_storage, TEST_FILENAMES1[i]));
+        Longtail_StorageAPI_HOpenFile w;
+        ASSERT_EQ(0, source_storage->OpenWriteFile(source_storage, TEST_FILENAMES1[i], 0, &w));
+        ASSERT_NE((Longtail_StorageAPI_HOpenFile)0, w);
+        ASSERT_EQ(0, source_storage->Write(source_storage, w, 0, strlen(TEST_STRINGS[i]) + 1, TEST_STRINGS[i]));
+        source_storage->CloseFile(source_storage, w);
+        w = 0;
+    }
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        ASSERT_NE(0, CreateParentPath(source_storage, TEST_FILENAMES2[i]));
+        Longtail_StorageAPI_HOpenFile w;
+        ASSERT_EQ(0, source_storage->OpenWriteFile(source_storage, TEST_FILENAMES2[i], 0, &w));
+        ASSERT_NE((Longtail_StorageAPI_HOpenFile)0, w);
+        ASSERT_EQ(0, source_storage->Write(source_storage, w, 0, strlen(TEST_STRINGS[i]) + 1, TEST_STRINGS[i]));
+        source_storage->CloseFile(source_storage, w);
+        w = 0;
+    }
+
+    ASSERT_EQ(0, UploadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "local1", "version1.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+    ASSERT_EQ(0, UploadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "local2", "version2.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+
+    ASSERT_EQ(0, DownloadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "version1.lvi", "target", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK, 0, 0));
+
+    ASSERT_EQ(1, source_storage->IsFile(source_storage, "target/UPPERCASE.txt"));
+    ASSERT_EQ(1, source_storage->IsFile(source_storage, "target/lowercase.txt"));
+
+    ASSERT_EQ(0, source_storage->IsFile(source_storage, "target/uppercase.txt"));
+    ASSERT_EQ(0, source_storage->IsFile(source_storage, "target/LOWERCASE.txt"));
+
+    ASSERT_EQ(0, DownloadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "version2.lvi", "target", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK, 0, 0));
+
+    Longtail_FileInfos* file_infos;
+    ASSERT_EQ(0, Longtail_GetFilesRecursively2(source_storage, job_api, 0, 0, 0, "target", &file_infos));
+    ASSERT_EQ(2u, file_infos->m_Count);
+    Longtail_Free(file_infos);
+
+    ASSERT_EQ(1, source_storage->IsFile(source_storage, "target/uppercase.txt"));
+    ASSERT_EQ(1, source_storage->IsFile(source_storage, "target/LOWERCASE.txt"));
+
+    ASSERT_EQ(0, source_storage->IsFile(source_storage, "target/UPPERCASE.txt"));
+    ASSERT_EQ(0, source_storage->IsFile(source_storage, "target/lowercase.txt"));
+
+    SAFE_DISPOSE_API(block_store_api);
+    SAFE_DISPOSE_API(fs_block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(chunker_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(compression_registry);
+    SAFE_DISPOSE_API(target_storage);
+    SAFE_DISPOSE_API(source_storage);
+}
+
+// Test writing blocks within a file in reverse order
+TEST(Longtail, Longtail_OutOfOrderWrites)
+{
+    static const uint32_t CONTENT_SIZE = 1024 * 2u;
+
+    Longtail_StorageAPI* local_storage = Longtail_CreateFSStorageAPI();
+    char* temp_folder = Longtail_GetTempFolder();
+    char* test_file = local_storage->ConcatPath(local_storage, temp_folder, "longtail.test.ooowrite");
+    if (local_storage->IsFile(local_storage, test_file))
+    {
+        ASSERT_EQ(0, local_storage->RemoveFile(local_storage, test_file));
+    }
+
+    char* data_ff = (char*)Longtail_Alloc(0, sizeof(char) * CONTENT_SIZE/2);
+    char* data_7f = (char*)Longtail_Alloc(0, sizeof(char) * CONTENT_SIZE/2);
+    char* data_tmp = (char*)Longtail_Alloc(0, sizeof(char) * CONTENT_SIZE/2);
+    memset(data_ff, (int)255, CONTENT_SIZE/2);
+    memset(data_7f, (int)127, CONTENT_SIZE/2);
+
+    Longtail_StorageAPI_HOpenFile content_file;
+
+    // Fill the second half of the file with 0xff
+    local_storage->OpenWriteFile(local_storage, test_file, 0, &content_file);
+    ASSERT_EQ(0,local_storage->Write(local_storage, content_file, CONTENT_SIZE/2, CONTENT_SIZE/2, data_ff));
+    local_storage->CloseFile(local_storage, content_file);
+
+
+    // Fill the first half of the file with 0x7f
+    local_storage->OpenAppendFile(local_storage, test_file, &content_file);
+    ASSERT_EQ(0,local_storage->Write(local_storage, content_file, 0, CONTENT_SIZE/2, data_7f));
+    local_storage->CloseFile(local_storage, content_file);
+
+    // Verify the contents
+    local_storage->OpenReadFile(local_storage, test_file, &content_file);
+    // The first half of the file should be 0x7f
+    ASSERT_EQ(0, local_storage->Read(local_storage, content_file, 0, CONTENT_SIZE/2, data_tmp));
+    ASSERT_EQ(0, memcmp(data_7f, data_tmp, CONTENT_SIZE/2));
+
+    // The second half of the file should be 0xff
+    ASSERT_EQ(0, local_storage->Read(local_storage, content_file, CONTENT_SIZE/2, CONTENT_SIZE/2, data_tmp));
+    ASSERT_EQ(0, memcmp(data_ff, data_tmp, CONTENT_SIZE/2));
+    local_storage->CloseFile(local_storage, content_file);
+
+    SAFE_DISPOSE_API(local_storage);
+
+    Longtail_Free(data_7f);
+    Longtail_Free(data_ff);
+    Longtail_Free(data_tmp);
+    Longtail_Free((void*)temp_folder);
+    Longtail_Free((void*)test_file);
+
+}
+
+// Test permissions on files and folders
+TEST(Longtail, Longtail_RetainPermissions)
+{
+    static const uint32_t TARGET_CHUNK_SIZE = 16u;
+    static const uint32_t MAX_BLOCK_SIZE = 32u;
+    static const uint32_t MAX_CHUNKS_PER_BLOCK = 3u;
+
+    Longtail_StorageAPI* source_storage = Longtail_CreateInMemStorageAPI();
+    Longtail_StorageAPI* target_storage = Longtail_CreateInMemStorageAPI();
+    Longtail_CompressionRegistryAPI* compression_registry = Longtail_CreateFullCompressionRegistry();
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+    Longtail_BlockStoreAPI* fs_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, target_storage, "chunks", 0, 0);
+    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateCompressBlockStoreAPI(fs_block_store_api, compression_registry);
+
+    const char* TEST_FILENAMES[2] = {
+        "local/file1.txt",
+        "local/file2.sh",
+    };
+
+    const uint16_t TEST_PERMISSIONS[2] = {
+        Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess | Longtail_StorageAPI_UserExecuteAccess,
+        Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess,
+    };
+
+    const uint16_t TEST_PERMISSIONS_MODIFIED[2] = {
+        Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess,
+        Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess | Longtail_StorageAPI_UserExecuteAccess,
+    };
+
+    const char* TEST_STRINGS[2] = {
+        "This is the first test string which is fairly long and should - reconstructed properly, than you very much",
+        "Short string"
+    };
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        ASSERT_NE(0, CreateParentPath(source_storage, TEST_FILENAMES[i]));
+        Longtail_StorageAPI_HOpenFile w;
+        ASSERT_EQ(0, source_storage->OpenWriteFile(source_storage, TEST_FILENAMES[i], 0, &w));
+        ASSERT_NE((Longtail_StorageAPI_HOpenFile)0, w);
+        ASSERT_EQ(0, source_storage->Write(source_storage, w, 0, strlen(TEST_STRINGS[i]) + 1, TEST_STRINGS[i]));
+        source_storage->CloseFile(source_storage, w);
+        source_storage->SetPermissions(source_storage, TEST_FILENAMES[i], TEST_PERMISSIONS[i]);
+        w = 0;
+    }
+
+    ASSERT_EQ(0, UploadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "local", "version.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        source_storage->SetPermissions(source_storage, TEST_FILENAMES[i], TEST_PERMISSIONS_MODIFIED[i]);
+    }
+
+    ASSERT_EQ(0, UploadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "local", "version_modified.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+
+    ASSERT_EQ(0, DownloadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "version.lvi", "target", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK, 0, 0));
+
+    uint16_t permissions;
+    ASSERT_EQ(0, source_storage->GetPermissions(source_storage, "target/file1.txt", &permissions));
+    ASSERT_EQ((permissions & (Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess | Longtail_StorageAPI_UserExecuteAccess)), TEST_PERMISSIONS[0]);
+    ASSERT_EQ(0, source_storage->GetPermissions(source_storage, "target/file2.sh", &permissions));
+    ASSERT_EQ((permissions & (Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess)), TEST_PERMISSIONS[1]);
+
+    ASSERT_EQ(0, DownloadFolder(source_storage, hash_api, chunker_api, job_api, fs_block_store_api, "version_modified.lvi", "target", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK, 0, 0));
+
+    ASSERT_EQ(0, source_storage->GetPermissions(source_storage, "target/file1.txt", &permissions));
+    ASSERT_EQ((permissions & (Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess)), TEST_PERMISSIONS_MODIFIED[0]);
+    ASSERT_EQ(0, source_storage->GetPermissions(source_storage, "target/file2.sh", &permissions));
+    ASSERT_EQ((permissions & (Longtail_StorageAPI_UserReadAccess | Longtail_StorageAPI_UserWriteAccess | Longtail_StorageAPI_UserExecuteAccess)), TEST_PERMISSIONS_MODIFIED[1]);
+
+    SAFE_DISPOSE_API(block_store_api);
+    SAFE_DISPOSE_API(fs_block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(chunker_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(compression_registry);
+    SAFE_DISPOSE_API(target_storage);
+    SAFE_DISPOSE_API(source_storage);
+}
+
+TEST(Longtail, Longtail_ChangeVersionLocalChunks)
+{
+    static const uint32_t TARGET_CHUNK_SIZE = 4096u;
+    static const uint32_t MAX_BLOCK_SIZE = 32768u;
+    static const uint32_t MAX_CHUNKS_PER_BLOCK = 16u;
+    static const uint32_t FILE_SIZE = 128 * 1024u;
+
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "chunks", 0, 0);
+
+    // "new" moves one file, edits the middle of one file, keeps one file and adds one file
+    const char* OLD_NAMES[3] = {"old/a.bin", "old/b.bin", "old/c.bin"};
+    const char* NEW_NAMES[4] = {"new/moved/a.bin", "new/b.bin", "new/c.bin", "new/d.bin"};
+    uint8_t* file_data[4];
+    for (uint32_t f = 0; f < 4; ++f)
+    {
+        file_data[f] = GenerateRandomData((uint8_t*)Longtail_Alloc(0, FILE_SIZE), FILE_SIZE);
+    }
+    for (uint32_t f = 0; f < 4; ++f)
+    {
+        if (f < 3)
+        {
+            Longtail_StorageAPI_HOpenFile w;
+            ASSERT_NE(0, CreateParentPath(storage_api, OLD_NAMES[f]));
+            ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, OLD_NAMES[f], 0, &w));
+            ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, file_data[f]));
+            storage_api->CloseFile(storage_api, w);
+        }
+        if (f == 1)
+        {
+            GenerateRandomData(&file_data[f][FILE_SIZE / 2], 1024);
+        }
+        Longtail_StorageAPI_HOpenFile w;
+        ASSERT_NE(0, CreateParentPath(storage_api, NEW_NAMES[f]));
+        ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, NEW_NAMES[f], 0, &w));
+        ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, file_data[f]));
+        storage_api->CloseFile(storage_api, w);
+    }
+    for (uint32_t f = 0; f < 4; ++f)
+    {
+        Longtail_Free(file_data[f]);
+    }
+
+    ASSERT_EQ(0, UploadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "new", "new.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+    ASSERT_EQ(0, CopyDir(storage_api, "old", "old_copy"));
+
+    struct Longtail_BlockStore_Stats stats;
+    ASSERT_EQ(0, block_store_api->GetStats(block_store_api, &stats));
+    uint64_t get_count_start = stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count];
+
+    ASSERT_EQ(0, DownloadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "new.lvi", "old_copy", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK, 0, 0));
+    ASSERT_EQ(0, block_store_api->GetStats(block_store_api, &stats));
+    uint64_t full_get_count = stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count] - get_count_start;
+    get_count_start = stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count];
+
+    ASSERT_EQ(0, DownloadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "new.lvi", "old", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK, 1, 0));
+    ASSERT_EQ(0, block_store_api->GetStats(block_store_api, &stats));
+    uint64_t local_get_count = stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count] - get_count_start;
+
+    // Only the blocks holding the edited range and the added file are fetched
+    ASSERT_LT(local_get_count, full_get_count);
+    ASSERT_GT(local_get_count, 0u);
+
+    ASSERT_EQ(0, ValidateVersion(storage_api, hash_api, chunker_api, job_api, "new", "old_copy", TARGET_CHUNK_SIZE));
+    ASSERT_EQ(0, ValidateVersion(storage_api, hash_api, chunker_api, job_api, "new", "old", TARGET_CHUNK_SIZE));
+    ASSERT_EQ(0, storage_api->IsDir(storage_api, "old/.longtail_staging"));
+
+    SAFE_DISPOSE_API(block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(chunker_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(storage_api);
+}
+
+TEST(Longtail, Longtail_ChangeVersionLocalChunksStaleSource)
+{
+    static const uint32_t TARGET_CHUNK_SIZE = 4096u;
+    static const uint32_t MAX_BLOCK_SIZE = 32768u;
+    static const uint32_t MAX_CHUNKS_PER_BLOCK = 16u;
+    static const uint32_t FILE_SIZE = 128 * 1024u;
+
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "chunks", 0, 0);
+    Longtail_BlockStoreAPI* empty_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "empty", 0, 0);
+
+    // "new" keeps a.bin, edits the middle of b.bin and adds c.bin
+    const char* OLD_NAMES[2] = {"old/a.bin", "old/b.bin"};
+    const char* NEW_NAMES[3] = {"new/a.bin", "new/b.bin", "new/c.bin"};
+    uint8_t* file_data[3];
+    for (uint32_t f = 0; f < 3; ++f)
+    {
+        file_data[f] = GenerateRandomData((uint8_t*)Longtail_Alloc(0, FILE_SIZE), FILE_SIZE);
+    }
+    uint8_t* old_b_data = (uint8_t*)Longtail_Alloc(0, FILE_SIZE);
+    memcpy(old_b_data, file_data[1], FILE_SIZE);
+    for (uint32_t f = 0; f < 3; ++f)
+    {
+        if (f < 2)
+        {
+            Longtail_StorageAPI_HOpenFile w;
+            ASSERT_NE(0, CreateParentPath(storage_api, OLD_NAMES[f]));
+            ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, OLD_NAMES[f], 0, &w));
+            ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, file_data[f]));
+            storage_api->CloseFile(storage_api, w);
+        }
+        if (f == 1)
+        {
+            GenerateRandomData(&file_data[f][FILE_SIZE / 2], 1024);
+        }
+        Longtail_StorageAPI_HOpenFile w;
+        ASSERT_NE(0, CreateParentPath(storage_api, NEW_NAMES[f]));
+        ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, NEW_NAMES[f], 0, &w));
+        ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, file_data[f]));
+        storage_api->CloseFile(storage_api, w);
+    }
+    for (uint32_t f = 0; f < 3; ++f)
+    {
+        Longtail_Free(file_data[f]);
+    }
+
+    ASSERT_EQ(0, UploadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "new", "new.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+    ASSERT_EQ(0, UploadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "old", "old.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+
+    struct Longtail_VersionIndex* old_version_index;
+    ASSERT_EQ(0, Longtail_ReadVersionIndex(storage_api, "old.lvi", &old_version_index));
+    struct Longtail_VersionIndex* new_version_index;
+    ASSERT_EQ(0, Longtail_ReadVersionIndex(storage_api, "new.lvi", &new_version_index));
+    struct Longtail_VersionDiff* version_diff;
+    ASSERT_EQ(0, Longtail_CreateVersionDiff(hash_api, old_version_index, new_version_index, &version_diff));
+
+    uint32_t required_chunk_count;
+    TLongtail_Hash* required_chunk_hashes = (TLongtail_Hash*)Longtail_Alloc(0, sizeof(TLongtail_Hash) * (*new_version_index->m_ChunkCount));
+    ASSERT_EQ(0, Longtail_GetRequiredChunkHashes(new_version_index, version_diff, &required_chunk_count, required_chunk_hashes));
+    struct Longtail_StoreIndex* store_index = SyncGetExistingContent(block_store_api, required_chunk_count, required_chunk_hashes, 0);
+    ASSERT_NE((struct Longtail_StoreIndex*)0, store_index);
+    Longtail_Free(required_chunk_hashes);
+
+    // A failed change puts the staged b.bin back in place
+    Longtail_ConcurrentChunkWriteAPI* concurrent_chunk_write_api = Longtail_CreateConcurrentChunkWriteAPI(storage_api, new_version_index, version_diff, "old");
+    ASSERT_NE(0, Longtail_ChangeVersion3(empty_block_store_api, storage_api, concurrent_chunk_write_api, hash_api, job_api, 0, 0, 0, store_index, old_version_index, new_version_index, version_diff, "old", 0, 1));
+    SAFE_DISPOSE_API(concurrent_chunk_write_api);
+    ASSERT_EQ(0, storage_api->IsDir(storage_api, "old/.longtail_staging"));
+    {
+        uint8_t* b_data = (uint8_t*)Longtail_Alloc(0, FILE_SIZE);
+        Longtail_StorageAPI_HOpenFile r;
+        ASSERT_EQ(0, storage_api->OpenReadFile(storage_api, "old/b.bin", &r));
+        ASSERT_EQ(0, storage_api->Read(storage_api, r, 0, FILE_SIZE, b_data));
+        storage_api->CloseFile(storage_api, r);
+        ASSERT_EQ(0, memcmp(b_data, old_b_data, FILE_SIZE));
+        Longtail_Free(b_data);
+    }
+    Longtail_Free(old_b_data);
+
+    // Change b.bin on disk without updating the source version index, the stale chunks must come from the store
+    {
+        uint8_t garbage[1024];
+        GenerateRandomData(garbage, sizeof(garbage));
+        Longtail_StorageAPI_HOpenFile w;
+        ASSERT_EQ(0, storage_api->OpenAppendFile(storage_api, "old/b.bin", &w));
+        ASSERT_EQ(0, storage_api->Write(storage_api, w, 8192, sizeof(garbage), garbage));
+        storage_api->CloseFile(storage_api, w);
+    }
+
+    concurrent_chunk_write_api = Longtail_CreateConcurrentChunkWriteAPI(storage_api, new_version_index, version_diff, "old");
+    ASSERT_EQ(0, Longtail_ChangeVersion3(block_store_api, storage_api, concurrent_chunk_write_api, hash_api, job_api, 0, 0, 0, store_index, old_version_index, new_version_index, version_diff, "old", 0, 1));
+    SAFE_DISPOSE_API(concurrent_chunk_write_api);
+
+    ASSERT_EQ(0, ValidateVersion(storage_api, hash_api, chunker_api, job_api, "new", "old", TARGET_CHUNK_SIZE));
+    ASSERT_EQ(0, storage_api->IsDir(storage_api, "old/.longtail_staging"));
+
+    Longtail_Free(store_index);
+    Longtail_Free(version_diff);
+    Longtail_Free(new_version_index);
+    Longtail_Free(old_version_index);
+    SAFE_DISPOSE_API(empty_block_store_api);
+    SAFE_DISPOSE_API(block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(chunker_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(storage_api);
+}
+
+TEST(Longtail, Longtail_ChangeVersionMovedAssets)
+{
+    static const uint32_t TARGET_CHUNK_SIZE = 4096u;
+    static const uint32_t MAX_BLOCK_SIZE = 32768u;
+    static const uint32_t MAX_CHUNKS_PER_BLOCK = 16u;
+    static const uint32_t FILE_SIZE = 64 * 1024u;
+
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "chunks", 0, 0);
+
+    // "new" renames one file, moves one file to a new folder, keeps one file and removes one file
+    const char* OLD_NAMES[4] = {"old/a.bin", "old/sub/b.bin", "old/c.bin", "old/d.bin"};
+    const char* NEW_NAMES[3] = {"new/renamed.bin", "new/moved/b.bin", "new/c.bin"};
+    for (uint32_t f = 0; f < 4; ++f)
+    {
+        uint8_t* data = GenerateRandomData((uint8_t*)Longtail_Alloc(0, FILE_SIZE), FILE_SIZE);
+        Longtail_StorageAPI_HOpenFile w;
+        ASSERT_NE(0, CreateParentPath(storage_api, OLD_NAMES[f]));
+        ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, OLD_NAMES[f], 0, &w));
+        ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, data));
+        storage_api->CloseFile(storage_api, w);
+        if (f < 3)
+        {
+            ASSERT_NE(0, CreateParentPath(storage_api, NEW_NAMES[f]));
+            ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, NEW_NAMES[f], 0, &w));
+            ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, data));
+            storage_api->CloseFile(storage_api, w);
+        }
+        Longtail_Free(data);
+    }
+
+    ASSERT_EQ(0, UploadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "new", "new.lvi", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK));
+    ASSERT_EQ(0, CopyDir(storage_api, "old", "old_copy"));
+
+    struct Longtail_BlockStore_Stats stats;
+    ASSERT_EQ(0, block_store_api->GetStats(block_store_api, &stats));
+    uint64_t get_count_start = stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count];
+
+    ASSERT_EQ(0, DownloadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "new.lvi", "old_copy", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK, 0, 0));
+    ASSERT_EQ(0, block_store_api->GetStats(block_store_api, &stats));
+    ASSERT_GT(stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count] - get_count_start, 0u);
+    get_count_start = stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count];
+
+    // Moves are applied as renames so nothing needs to be fetched
+    ASSERT_EQ(0, DownloadFolder(storage_api, hash_api, chunker_api, job_api, block_store_api, "new.lvi", "old", TARGET_CHUNK_SIZE, MAX_BLOCK_SIZE, MAX_CHUNKS_PER_BLOCK, 0, 1));
+    ASSERT_EQ(0, block_store_api->GetStats(block_store_api, &stats));
+    ASSERT_EQ(0u, stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_GetStoredBlock_Count] - get_count_start);
+
+    ASSERT_EQ(0, ValidateVersion(storage_api, hash_api, chunker_api, job_api, "new", "old_copy", TARGET_CHUNK_SIZE));
+    ASSERT_EQ(0, ValidateVersion(storage_api, hash_api, chunker_api, job_api, "new", "old", TARGET_CHUNK_SIZE));
+    ASSERT_EQ(0, storage_api->IsDir(storage_api, "old/.longtail_staging"));
+    ASSERT_EQ(0, storage_api->IsDir(storage_api, "old/sub"));
+
+    SAFE_DISPOSE_API(block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(chunker_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(storage_api);
+}
+
+TEST(Longtail, Longtail_ChunkLargeAssetMatchesSerialChunking)
+{
+    static const uint32_t TARGET_CHUNK_SIZE = 512u;
+    // Spans several parallel chunking ranges of TARGET_CHUNK_SIZE * 1024 bytes
+    static const uint32_t FILE_SIZE = 2 * 1024 * 1024 + 123457;
+
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+
+    uint8_t* data = GenerateRandomData((uint8_t*)Longtail_Alloc(0, FILE_SIZE), FILE_SIZE);
+    Longtail_StorageAPI_HOpenFile w;
+    ASSERT_NE(0, CreateParentPath(storage_api, "large/asset.bin"));
+    ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, "large/asset.bin", 0, &w));
+    ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, data));
+    storage_api->CloseFile(storage_api, w);
+
+    Longtail_FileInfos* file_infos;
+    ASSERT_EQ(0, Longtail_GetFilesRecursively2(storage_api, job_api, 0, 0, 0, "large", &file_infos));
+    Longtail_VersionIndex* version_index;
+    ASSERT_EQ(0, Longtail_CreateVersionIndex(storage_api, hash_api, chunker_api, job_api, 0, 0, 0, "large", file_infos, 0, TARGET_CHUNK_SIZE, 0, &version_index));
+
+    struct FeederContext
+    {
+        const uint8_t* data;
+        uint32_t size;
+        uint32_t offset;
+
+        static int FeederFunc(void* context, Longtail_ChunkerAPI_HChunker chunker, uint32_t requested_size, char* buffer, uint32_t* out_size)
+        {
+            FeederContext* c = (FeederContext*)context;
+            uint32_t read_count = c->size - c->offset;
+            if (requested_size < read_count)
+            {
+                read_count = requested_size;
+            }
+            memcpy(buffer, &c->data[c->offset], read_count);
+            c->offset += read_count;
+            *out_size = read_count;
+            return 0;
+        }
+    };
+    FeederContext feeder_context = {data, FILE_SIZE, 0};
+
+    // Chunk the whole file in one go with the same chunker settings as Longtail_CreateVersionIndex
+    uint32_t chunker_min_size;
+    ASSERT_EQ(0, chunker_api->GetMinChunkSize(chunker_api, &chunker_min_size));
+    Longtail_ChunkerAPI_HChunker chunker;
+    ASSERT_EQ(0, chunker_api->CreateChunker(
+        chunker_api,
+        (TARGET_CHUNK_SIZE / 8) < chunker_min_size ? chunker_min_size : (TARGET_CHUNK_SIZE / 8),
+        TARGET_CHUNK_SIZE / 2,
+        TARGET_CHUNK_SIZE * 2,
+        &chunker));
+
+    ASSERT_EQ(1u, *version_index->m_AssetCount);
+    uint32_t asset_chunk_count = version_index->m_AssetChunkCounts[0];
+    const uint32_t* asset_chunk_indexes = &version_index->m_AssetChunkIndexes[version_index->m_AssetChunkIndexStarts[0]];
+    uint32_t serial_chunk_count = 0;
+    Longtail_Chunker_ChunkRange r;
+    while (chunker_api->NextChunk(chunker_api, chunker, FeederContext::FeederFunc, &feeder_context, &r) == 0)
+    {
+        ASSERT_LT(serial_chunk_count, asset_chunk_count);
+        ASSERT_EQ(r.len, version_index->m_ChunkSizes[asset_chunk_indexes[serial_chunk_count]]);
+        ++serial_chunk_count;
+    }
+    ASSERT_EQ(serial_chunk_count, asset_chunk_count);
+    chunker_api->DisposeChunker(chunker_api, chunker);
+
+    Longtail_Free(version_index);
+    Longtail_Free(file_infos);
+    Longtail_Free(data);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(chunker_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(storage_api);
+}
+
+TEST(Longtail, Longtail_ReadAheadStorage)
+{
+    static const uint32_t TARGET_CHUNK_SIZE = 4096u;
+    static const uint32_t FILE_SIZE = 3 * 1024 * 1024 + 4321;
+
+    Longtail_StorageAPI* mem_storage = Longtail_CreateInMemStorageAPI();
+    Longtail_StorageAPI* storage_api = Longtail_CreateReadAheadStorageAPI(mem_storage, 65536, 3);
+    ASSERT_NE((Longtail_StorageAPI*)0, storage_api);
+    Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_ChunkerAPI* chunker_api = Longtail_CreateHPCDCChunkerAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+
+    uint8_t* data = GenerateRandomData((uint8_t*)Longtail_Alloc(0, FILE_SIZE), FILE_SIZE);
+    Longtail_StorageAPI_HOpenFile w;
+    ASSERT_NE(0, CreateParentPath(storage_api, "version/asset.bin"));
+    ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, "version/asset.bin", 0, &w));
+    ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, FILE_SIZE, data));
+    storage_api->CloseFile(storage_api, w);
+
+    // Sequential reads of odd sizes are served from the read ahead buffers, a seek falls back to a direct read
+    uint8_t* read_back = (uint8_t*)Longtail_Alloc(0, FILE_SIZE);
+    Longtail_StorageAPI_HOpenFile r;
+    ASSERT_EQ(0, storage_api->OpenReadFile(storage_api, "version/asset.bin", &r));
+    uint64_t offset = 0;
+    while (offset < FILE_SIZE)
+    {
+        uint64_t size = FILE_SIZE - offset < 40000 ? FILE_SIZE - offset : 40000;
+        ASSERT_EQ(0, storage_api->Read(storage_api, r, offset, size, &read_back[offset]));
+        offset += size;
+    }
+    ASSERT_EQ(0, memcmp(data, read_back, FILE_SIZE));
+    ASSERT_EQ(0, storage_api->Read(storage_api, r, 100000, 5000, read_back));
+    ASSERT_EQ(0, memcmp(&data[100000], read_back, 5000));
+    ASSERT_EQ(0, storage_api->Read(storage_api, r, 105000, 200000, read_back));
+    ASSERT_EQ(0, memcmp(&data[105000], read_back, 200000));
+    ASSERT_EQ(0, storage_api->Read(storage_api, r, 7, 13, read_back));
+    ASSERT_EQ(0, memcmp(&data[7], read_back, 13));
+    storage_api->CloseFile(storage_api, r);
+    Longtail_Free(read_back);
+
+    Longtail_FileInfos* file_infos;
+    ASSERT_EQ(0, Longtail_GetFilesRecursively2(storage_api, job_api, 0, 0, 0, "version", &file_infos));
+    Longtail_VersionIndex* read_ahead_version_index;
+    ASSERT_EQ(0, Longtail_CreateVersionIndex(storage_api, hash_api, chunker_api, job_api, 0, 0, 0, "version", file_infos, 0, TARGET_CHUNK_SIZE, 0, &read_ahead_version_index));
+    Longtail_VersionIndex* version_index;
+    ASSERT_EQ(0, Longtail_CreateVersionIndex(mem_storage, hash_api, chunker_api, job_api, 0, 0, 0, "version", file_infos, 0, TARGET_CHUNK_SIZE, 0, &version_index));
+    ASSERT_EQ(*version_index->m_ChunkCount, *read_ahead_version_index->m_ChunkCount);
+    ASSERT_EQ(version_index->m_ContentHashes[0], read_ahead_version_index->m_ContentHashes[0]);
+
+    Longtail_Free(version_index);
+    Longtail_Free(read_ahead_version_index);
+    Longtail_Free(file_infos);
+    Longtail_Free(data);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(chunker_api);
+    SAFE_DISPOSE_API(hash_api);
+    SAFE_DISPOSE_API(storage_api);
+    SAFE_DISPOSE_API(mem_storage);
+}
+
+static uint32_t CountFilesWithExtension(Longtail_StorageAPI* storage_api, Longtail_JobAPI* job_api, const char* path, const char* extension)
+{
+    Longtail_FileInfos* file_infos;
+    if (Longtail_GetFilesRecursively2(storage_api, job_api, 0, 0, 0, path, &file_infos))
+    {
+        return 0;
+    }
+    uint32_t count = 0;
+    for (uint32_t f = 0; f < file_infos->m_Count; ++f)
+    {
+        const char* file_path = &file_infos->m_PathData[file_infos->m_PathStartOffsets[f]];
+        size_t length = strlen(file_path);
+        if (length >= strlen(extension) && strcmp(&file_path[length - strlen(extension)], extension) == 0)
+        {
+            ++count;
+        }
+    }
+    Longtail_Free(file_infos);
+    return count;
+}
+
+TEST(Longtail, Longtail_FSBlockStorePacks)
+{
+    struct Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateFSBlockStoreAPI2(job_api, storage_api, "cache/chunks", 0, 0, 7000);
+    ASSERT_NE((Longtail_BlockStoreAPI*)0, block_store_api);
+
+    static const uint32_t BLOCK_CHUNK_COUNTS[4] = {2, 2, 2, 1};
+    static const uint32_t BLOCK_CHUNK_SIZES[4][2] = {{1000, 1000}, {3000, 1000}, {2000, 2000}, {1000, 0}};
+    TLongtail_Hash block_hashes[4];
+    TLongtail_Hash chunk_hashes[4][2];
+    for (uint32_t b = 0; b < 4; ++b)
+    {
+        Longtail_StoredBlock* block = GenerateStoredBlock(hash_api, BLOCK_CHUNK_COUNTS[b], BLOCK_CHUNK_SIZES[b]);
+        struct TestAsyncPutBlockComplete putCB;
+        ASSERT_EQ(0, block_store_api->PutStoredBlock(block_store_api, block, &putCB.m_API));
+        putCB.Wait();
+        ASSERT_EQ(0, putCB.m_Err);
+        block_hashes[b] = *block->m_BlockIndex->m_BlockHash;
+        memcpy(chunk_hashes[b], block->m_BlockIndex->m_ChunkHashes, sizeof(TLongtail_Hash) * BLOCK_CHUNK_COUNTS[b]);
+        block->Dispose(block);
+    }
+
+    // Blocks in the active pack can be read before the pack index is written
+    {
+        struct TestAsyncGetBlockComplete getCB;
+        ASSERT_EQ(0, block_store_api->GetStoredBlock(block_store_api, block_hashes[3], &getCB.m_API));
+        getCB.Wait();
+        ASSERT_EQ(0, getCB.m_Err);
+        ASSERT_EQ(1u, *getCB.m_StoredBlock->m_BlockIndex->m_ChunkCount);
+        getCB.m_StoredBlock->Dispose(getCB.m_StoredBlock);
+    }
+
+    {
+        struct TestAsyncFlushComplete flushCB;
+        ASSERT_EQ(0, block_store_api->Flush(block_store_api, &flushCB.m_API));
+        flushCB.Wait();
+        ASSERT_EQ(0, flushCB.m_Err);
+    }
+    ASSERT_EQ(2u, CountFilesWithExtension(storage_api, job_api, "cache/chunks", ".lpk"));
+    ASSERT_EQ(2u, CountFilesWithExtension(storage_api, job_api, "cache/chunks", ".lpi"));
+    ASSERT_EQ(0u, CountFilesWithExtension(storage_api, job_api, "cache/chunks", ".lrb"));
+    SAFE_DISPOSE_API(block_store_api);
+
+    // Rebuild the store index from the packs
+    ASSERT_EQ(0, storage_api->RemoveFile(storage_api, "cache/chunks/store.lsi"));
+    block_store_api = Longtail_CreateFSBlockStoreAPI2(job_api, storage_api, "cache/chunks", 0, 0, 7000);
+    {
+        struct Longtail_StoreIndex* store_index = SyncGetExistingContent(block_store_api, 8, &chunk_hashes[0][0], 0);
+        ASSERT_NE((struct Longtail_StoreIndex*)0, store_index);
+        ASSERT_EQ(4u, *store_index->m_BlockCount);
+        Longtail_Free(store_index);
+    }
+
+    TLongtail_Hash keep_hashes[2] = {block_hashes[0], block_hashes[2]};
+    TestAsyncPruneBlocksComplete pruneCB;
+    ASSERT_EQ(0, block_store_api->PruneBlocks(block_store_api, 2, keep_hashes, &pruneCB.m_API));
+    pruneCB.Wait();
+    ASSERT_EQ(0, pruneCB.m_Err);
+    ASSERT_EQ(2, pruneCB.m_PruneCount);
+
+    // The mostly pruned first pack is rewritten to a new pack, the second pack only drops the pruned block from its index
+    ASSERT_EQ(2u, CountFilesWithExtension(storage_api, job_api, "cache/chunks", ".lpk"));
+    ASSERT_EQ(2u, CountFilesWithExtension(storage_api, job_api, "cache/chunks", ".lpi"));
+
+    // The kept blocks are readable through the remaining packs
+    for (uint32_t b = 0; b < 4; b += 2)
+    {
+        struct TestAsyncGetBlockComplete getCB;
+        ASSERT_EQ(0, block_store_api->GetStoredBlock(block_store_api, block_hashes[b], &getCB.m_API));
+        getCB.Wait();
+        ASSERT_EQ(0, getCB.m_Err);
+        ASSERT_EQ(block_hashes[b], *getCB.m_StoredBlock->m_BlockIndex->m_BlockHash);
+        getCB.m_StoredBlock->Dispose(getCB.m_StoredBlock);
+    }
+    SAFE_DISPOSE_API(block_store_api);
+
+    block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "cache/chunks", 0, 0);
+    for (uint32_t b = 0; b < 4; ++b)
+    {
+        struct TestAsyncGetBlockComplete getCB;
+        if (b == 1 || b == 3)
+        {
+            ASSERT_EQ(ENOENT, block_store_api->GetStoredBlock(block_store_api, block_hashes[b], &getCB.m_API));
+            continue;
+        }
+        ASSERT_EQ(0, block_store_api->GetStoredBlock(block_store_api, block_hashes[b], &getCB.m_API));
+        getCB.Wait();
+        ASSERT_EQ(0, getCB.m_Err);
+        ASSERT_EQ(block_hashes[b], *getCB.m_StoredBlock->m_BlockIndex->m_BlockHash);
+        ASSERT_EQ(BLOCK_CHUNK_SIZES[b][0], getCB.m_StoredBlock->m_BlockIndex->m_ChunkSizes[0]);
+        getCB.m_StoredBlock->Dispose(getCB.m_StoredBlock);
+    }
+
+    SAFE_DISPOSE_API(block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(storage_api);
+    SAFE_DISPOSE_API(hash_api);
+}
+
+static void* ReadTestFile(Longtail_StorageAPI* storage_api, const char* path, uint64_t* out_size)
+{
+    Longtail_StorageAPI_HOpenFile f;
+    if (storage_api->OpenReadFile(storage_api, path, &f))
+    {
+        return 0;
+    }
+    uint64_t size = 0;
+    void* data = 0;
+    if (storage_api->GetSize(storage_api, f, &size) == 0)
+    {
+        data = Longtail_Alloc("Test", size);
+        if (storage_api->Read(storage_api, f, 0, size, data))
+        {
+            Longtail_Free(data);
+            data = 0;
+        }
+    }
+    storage_api->CloseFile(storage_api, f);
+    *out_size = size;
+    return data;
+}
+
+static int WriteTestFile(Longtail_StorageAPI* storage_api, const char* path, uint64_t offset, const void* data, uint64_t size)
+{
+    Longtail_StorageAPI_HOpenFile f;
+    int err = offset == 0 ? storage_api->OpenWriteFile(storage_api, path, 0, &f) : storage_api->OpenAppendFile(storage_api, path, &f);
+    if (err)
+    {
+        return err;
+    }
+    err = storage_api->Write(storage_api, f, offset, size, data);
+    storage_api->CloseFile(storage_api, f);
+    return err;
+}
+
+TEST(Longtail, Longtail_FSBlockStorePackRecovery)
+{
+    struct Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateFSBlockStoreAPI2(job_api, storage_api, "cache/chunks", 0, 0, 1024 * 1024);
+    ASSERT_NE((Longtail_BlockStoreAPI*)0, block_store_api);
+
+    static const uint32_t BLOCK_CHUNK_SIZES[3][2] = {{1000, 1200}, {300, 1000}, {2000, 20}};
+    TLongtail_Hash block_hashes[3];
+    TLongtail_Hash chunk_hashes[6];
+    char pack_path[256] = "";
+    char pack_index_path[256] = "";
+    void* flushed_pack_index = 0;
+    uint64_t flushed_pack_index_size = 0;
+    void* flushed_store_index = 0;
+    uint64_t flushed_store_index_size = 0;
+    for (uint32_t b = 0; b < 3; ++b)
+    {
+        if (b == 2)
+        {
+            struct TestAsyncFlushComplete flushCB;
+            ASSERT_EQ(0, block_store_api->Flush(block_store_api, &flushCB.m_API));
+            flushCB.Wait();
+            ASSERT_EQ(0, flushCB.m_Err);
+
+            Longtail_FileInfos* file_infos;
+            ASSERT_EQ(0, Longtail_GetFilesRecursively2(storage_api, job_api, 0, 0, 0, "cache/chunks/packs", &file_infos));
+            ASSERT_EQ(2u, file_infos->m_Count);
+            for (uint32_t f = 0; f < file_infos->m_Count; ++f)
+            {
+                const char* file_path = &file_infos->m_PathData[file_infos->m_PathStartOffsets[f]];
+                sprintf(strstr(file_path, ".lpi") ? pack_index_path : pack_path, "cache/chunks/packs/%s", file_path);
+            }
+            Longtail_Free(file_infos);
+            flushed_pack_index = ReadTestFile(storage_api, pack_index_path, &flushed_pack_index_size);
+            ASSERT_NE((void*)0, flushed_pack_index);
+            flushed_store_index = ReadTestFile(storage_api, "cache/chunks/store.lsi", &flushed_store_index_size);
+            ASSERT_NE((void*)0, flushed_store_index);
+        }
+        Longtail_StoredBlock* block = GenerateStoredBlock(hash_api, 2, BLOCK_CHUNK_SIZES[b]);
+        struct TestAsyncPutBlockComplete putCB;
+        ASSERT_EQ(0, block_store_api->PutStoredBlock(block_store_api, block, &putCB.m_API));
+        putCB.Wait();
+        ASSERT_EQ(0, putCB.m_Err);
+        block_hashes[b] = *block->m_BlockIndex->m_BlockHash;
+        memcpy(&chunk_hashes[b * 2], block->m_BlockIndex->m_ChunkHashes, sizeof(TLongtail_Hash) * 2);
+        block->Dispose(block);
+    }
+    SAFE_DISPOSE_API(block_store_api);
+
+    // Put the pack index and store index back to how they were before the last block was added, as if the
+    // process crashed after appending the block. A partially written record after the block is ignored.
+    ASSERT_EQ(0, WriteTestFile(storage_api, pack_index_path, 0, flushed_pack_index, flushed_pack_index_size));
+    ASSERT_EQ(0, WriteTestFile(storage_api, "cache/chunks/store.lsi", 0, flushed_store_index, flushed_store_index_size));
+    Longtail_Free(flushed_pack_index);
+    Longtail_Free(flushed_store_index);
+    uint64_t pack_size = 0;
+    void* pack_data = ReadTestFile(storage_api, pack_path, &pack_size);
+    ASSERT_NE((void*)0, pack_data);
+    Longtail_Free(pack_data);
+    uint8_t torn_record[12];
+    memset(torn_record, 0x6c, sizeof(torn_record));
+    ASSERT_EQ(0, WriteTestFile(storage_api, pack_path, pack_size, torn_record, sizeof(torn_record)));
+
+    block_store_api = Longtail_CreateFSBlockStoreAPI2(job_api, storage_api, "cache/chunks", 0, 0, 1024 * 1024);
+    for (uint32_t b = 0; b < 3; ++b)
+    {
+        struct TestAsyncGetBlockComplete getCB;
+        ASSERT_EQ(0, block_store_api->GetStoredBlock(block_store_api, block_hashes[b], &getCB.m_API));
+        getCB.Wait();
+        ASSERT_EQ(0, getCB.m_Err);
+        ASSERT_EQ(block_hashes[b], *getCB.m_StoredBlock->m_BlockIndex->m_BlockHash);
+        ASSERT_EQ(BLOCK_CHUNK_SIZES[b][0], getCB.m_StoredBlock->m_BlockIndex->m_ChunkSizes[0]);
+        getCB.m_StoredBlock->Dispose(getCB.m_StoredBlock);
+    }
+    SAFE_DISPOSE_API(block_store_api);
+
+    // Rebuilding the store index also finds the block that is not in the pack index
+    ASSERT_EQ(0, WriteTestFile(storage_api, pack_index_path, 0, "broken", 6));
+    ASSERT_EQ(0, storage_api->RemoveFile(storage_api, "cache/chunks/store.lsi"));
+    block_store_api = Longtail_CreateFSBlockStoreAPI2(job_api, storage_api, "cache/chunks", 0, 0, 1024 * 1024);
+    {
+        struct Longtail_StoreIndex* store_index = SyncGetExistingContent(block_store_api, 6, chunk_hashes, 0);
+        ASSERT_NE((struct Longtail_StoreIndex*)0, store_index);
+        ASSERT_EQ(3u, *store_index->m_BlockCount);
+        Longtail_Free(store_index);
+    }
+    SAFE_DISPOSE_API(block_store_api);
+
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(storage_api);
+    SAFE_DISPOSE_API(hash_api);
+}
+
+TEST(Longtail, Longtail_FSBlockStoreResumeRescan)
+{
+    struct Longtail_HashAPI* hash_api = Longtail_CreateBlake3HashAPI();
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+    Longtail_BlockStoreAPI* block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "cache/chunks", 0, 0);
+
+    static const uint32_t BLOCK_CHUNK_SIZES[4][2] = {{1000, 1200}, {300, 1000}, {2000, 20}, {100, 900}};
+    Longtail_BlockIndex* block_indexes[4];
+    TLongtail_Hash chunk_hashes[8];
+    for (uint32_t b = 0; b < 4; ++b)
+    {
+        Longtail_StoredBlock* block = GenerateStoredBlock(hash_api, 2, BLOCK_CHUNK_SIZES[b]);
+        struct TestAsyncPutBlockComplete putCB;
+        ASSERT_EQ(0, block_store_api->PutStoredBlock(block_store_api, block, &putCB.m_API));
+        putCB.Wait();
+        ASSERT_EQ(0, putCB.m_Err);
+        block_indexes[b] = Longtail_CopyBlockIndex(block->m_BlockIndex);
+        memcpy(&chunk_hashes[b * 2], block->m_BlockIndex->m_ChunkHashes, sizeof(TLongtail_Hash) * 2);
+        block->Dispose(block);
+    }
+    SAFE_DISPOSE_API(block_store_api);
+
+    ASSERT_EQ(0, storage_api->RemoveFile(storage_api, "cache/chunks/store.lsi"));
+    block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "cache/chunks", 0, 0);
+    struct Longtail_StoreIndex* full_scan_index = SyncGetExistingContent(block_store_api, 8, chunk_hashes, 0);
+    ASSERT_NE((struct Longtail_StoreIndex*)0, full_scan_index);
+    ASSERT_EQ(4u, *full_scan_index->m_BlockCount);
+    SAFE_DISPOSE_API(block_store_api);
+
+    // Simulate an interrupted rescan that got as far as reading the first and third block
+    const struct Longtail_BlockIndex* checkpoint_blocks[2] = {block_indexes[0], block_indexes[2]};
+    struct Longtail_StoreIndex* checkpoint_index;
+    ASSERT_EQ(0, Longtail_CreateStoreIndexFromBlocks(2, checkpoint_blocks, &checkpoint_index));
+    ASSERT_EQ(0, storage_api->CreateDir(storage_api, "cache/chunks/store.lsi.scan"));
+    ASSERT_EQ(0, Longtail_WriteStoreIndex(storage_api, checkpoint_index, "cache/chunks/store.lsi.scan/00000000.lsi"));
+    Longtail_Free(checkpoint_index);
+
+    // Break the first block file, the resumed scan should not read it again
+    char block_path[64];
+    TLongtail_Hash block0_hash = *block_indexes[0]->m_BlockHash;
+    sprintf(block_path, "cache/chunks/chunks/%04x/0x%016" PRIx64 ".lrb", (uint32_t)(block0_hash >> 48), block0_hash);
+    Longtail_StorageAPI_HOpenFile block_file;
+    ASSERT_EQ(0, storage_api->OpenAppendFile(storage_api, block_path, &block_file));
+    uint8_t zeros[16] = {0};
+    ASSERT_EQ(0, storage_api->Write(storage_api, block_file, 0, sizeof(zeros), zeros));
+    storage_api->CloseFile(storage_api, block_file);
+
+    ASSERT_EQ(0, storage_api->RemoveFile(storage_api, "cache/chunks/store.lsi"));
+    block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "cache/chunks", 0, 0);
+    struct Longtail_StoreIndex* resumed_scan_index = SyncGetExistingContent(block_store_api, 8, chunk_hashes, 0);
+    ASSERT_NE((struct Longtail_StoreIndex*)0, resumed_scan_index);
+    ASSERT_EQ(*full_scan_index->m_BlockCount, *resumed_scan_index->m_BlockCount);
+    ASSERT_EQ(*full_scan_index->m_ChunkCount, *resumed_scan_index->m_ChunkCount);
+    for (uint32_t b = 0; b < *full_scan_index->m_BlockCount; ++b)
+    {
+        ASSERT_EQ(full_scan_index->m_BlockHashes[b], resumed_scan_index->m_BlockHashes[b]);
+        ASSERT_EQ(full_scan_index->m_BlockChunkCounts[b], resumed_scan_index->m_BlockChunkCounts[b]);
+    }
+    for (uint32_t c = 0; c < *full_scan_index->m_ChunkCount; ++c)
+    {
+        ASSERT_EQ(full_scan_index->m_ChunkHashes[c], resumed_scan_index->m_ChunkHashes[c]);
+        ASSERT_EQ(full_scan_index->m_ChunkSizes[c], resumed_scan_index->m_ChunkSizes[c]);
+    }
+    ASSERT_EQ(0, storage_api->IsDir(storage_api, "cache/chunks/store.lsi.scan"));
+    Longtail_Free(resumed_scan_index);
+    Longtail_Free(full_scan_index);
+
+    for (uint32_t b = 0; b < 4; ++b)
+    {
+        Longtail_Free(block_indexes[b]);
+    }
+    SAFE_DISPOSE_API(block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(storage_api);
+    SAFE_DISPOSE_API(hash_api);
+}
+
+static void TestStorageWriteV(struct Longtail_StorageAPI* storage_api, const char* path)
+{
+    const char header[] = "HEAD";
+    const char first[] = "first,";
+    const char second[] = "second,";
+    const char third[] = "third";
+    const char expected[] = "HEADfirst,second,third";
+
+    Longtail_StorageAPI_HOpenFile w;
+    ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, path, 0, &w));
+    ASSERT_EQ(0, storage_api->Write(storage_api, w, 0, 4, header));
+    struct Longtail_StorageAPI_IOVec vecs[4] = {
+        {first, 6},
+        {second, 0},
+        {second, 7},
+        {third, 5}};
+    ASSERT_EQ(0, Longtail_Storage_WriteV(storage_api, w, 4, 4, vecs));
+    storage_api->CloseFile(storage_api, w);
+
+    Longtail_StorageAPI_HOpenFile r;
+    ASSERT_EQ(0, storage_api->OpenReadFile(storage_api, path, &r));
+    uint64_t size = 0;
+    ASSERT_EQ(0, storage_api->GetSize(storage_api, r, &size));
+    ASSERT_EQ(sizeof(expected) - 1, size);
+    char data[sizeof(expected)] = {0};
+    ASSERT_EQ(0, storage_api->Read(storage_api, r, 0, size, data));
+    storage_api->CloseFile(storage_api, r);
+    ASSERT_STREQ(expected, data);
+    ASSERT_EQ(0, storage_api->RemoveFile(storage_api, path));
+}
+
+TEST(Longtail, Longtail_StorageWriteV)
+{
+    struct Longtail_StorageAPI* mem_storage = Longtail_CreateInMemStorageAPI();
+    TestStorageWriteV(mem_storage, "writev.bin");
+    SAFE_DISPOSE_API(mem_storage);
+
+    struct Longtail_StorageAPI* fs_storage = Longtail_CreateFSStorageAPI();
+    TestStorageWriteV(fs_storage, "testdata/writev.bin");
+    SAFE_DISPOSE_API(fs_storage);
+}
+
+TEST(Longtail, Longtail_DirectoryCache)
+{
+    struct Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+    struct Longtail_DirectoryCache* directory_cache = Longtail_CreateDirectoryCache();
+    ASSERT_NE((struct Longtail_DirectoryCache*)0, directory_cache);
+
+    ASSERT_EQ(0, Longtail_DirectoryCache_EnsureParentPathExists(directory_cache, storage_api, "a/b/c/file.txt"));
+    ASSERT_TRUE(storage_api->IsDir(storage_api, "a/b/c"));
+    ASSERT_EQ(0, Longtail_DirectoryCache_CreateDir(directory_cache, storage_api, "a/b/d"));
+    ASSERT_TRUE(storage_api->IsDir(storage_api, "a/b/d"));
+
+    // Removed behind the cache, a cached folder is not created again until the cache is cleared
+    ASSERT_EQ(0, storage_api->RemoveDir(storage_api, "a/b/c"));
+    ASSERT_EQ(0, Longtail_DirectoryCache_EnsureParentPathExists(directory_cache, storage_api, "a/b/c/other.txt"));
+    ASSERT_FALSE(storage_api->IsDir(storage_api, "a/b/c"));
+    Longtail_DirectoryCache_Clear(directory_cache);
+    ASSERT_EQ(0, Longtail_DirectoryCache_EnsureParentPathExists(directory_cache, storage_api, "a/b/c/other.txt"));
+    ASSERT_TRUE(storage_api->IsDir(storage_api, "a/b/c"));
+
+    Longtail_DisposeDirectoryCache(directory_cache);
+    SAFE_DISPOSE_API(storage_api);
+}
+
+static struct Longtail_StoredBlock* CreateDeltaTestBlock(TLongtail_Hash block_hash, const uint8_t* data, uint32_t size)
+{
+    TLongtail_Hash chunk_hash = block_hash + 1;
+    struct Longtail_StoredBlock* stored_block;
+    if (Longtail_CreateStoredBlock(block_hash, 0, 1, 0, &chunk_hash, &size, size, &stored_block))
+    {
+        return 0;
+    }
+    memcpy(stored_block->m_BlockData, data, size);
+    return stored_block;
+}
+
+static int PutDeltaTestBlock(struct Longtail_BlockStoreAPI* block_store_api, struct Longtail_StoredBlock* stored_block)
+{
+    struct TestAsyncPutBlockComplete putCB;
+    int err = block_store_api->PutStoredBlock(block_store_api, stored_block, &putCB.m_API);
+    if (err)
+    {
+        return err;
+    }
+    putCB.Wait();
+    return putCB.m_Err;
+}
+
+static int VerifyDeltaTestBlock(struct Longtail_BlockStoreAPI* block_store_api, TLongtail_Hash block_hash, const uint8_t* data, uint32_t size)
+{
+    struct TestAsyncGetBlockComplete getCB;
+    int err = block_store_api->GetStoredBlock(block_store_api, block_hash, &getCB.m_API);
+    if (err)
+    {
+        return err;
+    }
+    getCB.Wait();
+    if (getCB.m_Err)
+    {
+        return getCB.m_Err;
+    }
+    struct Longtail_StoredBlock* stored_block = getCB.m_StoredBlock;
+    err = (*stored_block->m_BlockIndex->m_BlockHash == block_hash &&
+        *stored_block->m_BlockIndex->m_ChunkCount == 1 &&
+        stored_block->m_BlockIndex->m_ChunkSizes[0] == size &&
+        stored_block->m_BlockChunksDataSize == size &&
+        memcmp(stored_block->m_BlockData, data, size) == 0) ? 0 : EBADF;
+    stored_block->Dispose(stored_block);
+    return err;
+}
+
+TEST(Longtail, Longtail_DeltaBlockStore)
+{
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+    Longtail_JobAPI* job_api = Longtail_CreateBikeshedJobAPI(0, 0);
+    Longtail_BlockStoreAPI* fs_block_store_api = Longtail_CreateFSBlockStoreAPI(job_api, storage_api, "store", 0, 0);
+    ASSERT_EQ(0, Longtail_DeltaBlockStore_HasIndex(storage_api, "store.ldi"));
+    Longtail_BlockStoreAPI* delta_block_store_api = Longtail_CreateDeltaBlockStoreAPI(fs_block_store_api, storage_api, "store.ldi");
+    ASSERT_NE((Longtail_BlockStoreAPI*)0, delta_block_store_api);
+    // The sidecar index marks the store before any delta block is put
+    ASSERT_NE(0, Longtail_DeltaBlockStore_HasIndex(storage_api, "store.ldi"));
+
+    const uint32_t base_size = 65536;
+    uint8_t* base_data = (uint8_t*)Longtail_Alloc(0, base_size);
+    uint32_t seed = 4711;
+    for (uint32_t i = 0; i < base_size; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        base_data[i] = (uint8_t)(seed >> 24);
+    }
+
+    // Same data with a few bytes patched and 100 bytes inserted in the middle
+    const uint32_t similar_size = base_size + 100;
+    uint8_t* similar_data = (uint8_t*)Longtail_Alloc(0, similar_size);
+    memcpy(similar_data, base_data, 30000);
+    memset(&similar_data[30000], 0x5a, 100);
+    memcpy(&similar_data[30100], &base_data[30000], base_size - 30000);
+    similar_data[1000] ^= 0xff;
+    similar_data[50000] ^= 0xff;
+
+    struct Longtail_StoredBlock* base_block = CreateDeltaTestBlock(0x1000, base_data, base_size);
+    struct Longtail_StoredBlock* similar_block = CreateDeltaTestBlock(0x2000, similar_data, similar_size);
+    ASSERT_EQ(0, PutDeltaTestBlock(delta_block_store_api, base_block));
+    ASSERT_EQ(0, PutDeltaTestBlock(delta_block_store_api, similar_block));
+    base_block->Dispose(base_block);
+    similar_block->Dispose(similar_block);
+
+    Longtail_BlockStore_Stats fs_stats;
+    fs_block_store_api->GetStats(fs_block_store_api, &fs_stats);
+    ASSERT_EQ(2, fs_stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_Count]);
+    ASSERT_LT(fs_stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_Byte_Count], (uint64_t)base_size + 1024);
+
+    ASSERT_EQ(0, VerifyDeltaTestBlock(delta_block_store_api, 0x1000, base_data, base_size));
+    ASSERT_EQ(0, VerifyDeltaTestBlock(delta_block_store_api, 0x2000, similar_data, similar_size));
+
+    SAFE_DISPOSE_API(delta_block_store_api);
+    ASSERT_TRUE(storage_api->IsFile(storage_api, "store.ldi"));
+
+    // The sidecar index is read back, a new similar block is stored as a delta against the same base block
+    delta_block_store_api = Longtail_CreateDeltaBlockStoreAPI(fs_block_store_api, storage_api, "store.ldi");
+    ASSERT_NE((Longtail_BlockStoreAPI*)0, delta_block_store_api);
+    similar_data[20000] ^= 0xff;
+    similar_block = CreateDeltaTestBlock(0x3000, similar_data, similar_size);
+    ASSERT_EQ(0, PutDeltaTestBlock(delta_block_store_api, similar_block));
+    similar_block->Dispose(similar_block);
+    fs_block_store_api->GetStats(fs_block_store_api, &fs_stats);
+    ASSERT_LT(fs_stats.m_StatU64[Longtail_BlockStoreAPI_StatU64_PutStoredBlock_Byte_Count], (uint64_t)base_size + 2048);
+
+    // Keeping a delta block keeps its base block
+    TLongtail_Hash keep_block_hash = 0x3000;
+    TestAsyncPruneBlocksComplete pruneCB;
+    ASSERT_EQ(0, delta_block_store_api->PruneBlocks(delta_block_store_api, 1, &keep_block_hash, &pruneCB.m_API));
+    pruneCB.Wait();
+    ASSERT_EQ(0, pruneCB.m_Err);
+    ASSERT_EQ(1u, pruneCB.m_PruneCount);
+    SAFE_DISPOSE_API(delta_block_store_api);
+
+    // Deltas are resolved without a sidecar index
+    delta_block_store_api = Longtail_CreateDeltaBlockStoreAPI(fs_block_store_api, 0, 0);
+    ASSERT_NE((Longtail_BlockStoreAPI*)0, delta_block_store_api);
+    ASSERT_EQ(0, VerifyDeltaTestBlock(delta_block_store_api, 0x3000, similar_data, similar_size));
+    ASSERT_EQ(0, VerifyDeltaTestBlock(delta_block_store_api, 0x1000, base_data, base_size));
+    struct TestAsyncGetBlockComplete getCB;
+    ASSERT_EQ(ENOENT, delta_block_store_api->GetStoredBlock(delta_block_store_api, 0x2000, &getCB.m_API));
+
+    // Read without the delta block store a delta block is rejected instead of being read past its data
+    struct TestAsyncGetBlockComplete deltaCB;
+    ASSERT_EQ(0, fs_block_store_api->GetStoredBlock(fs_block_store_api, 0x3000, &deltaCB.m_API));
+    deltaCB.Wait();
+    ASSERT_EQ(0, deltaCB.m_Err);
+    ASSERT_EQ(EBADF, Longtail_ValidateStoredBlockData(deltaCB.m_StoredBlock));
+    deltaCB.m_StoredBlock->Dispose(deltaCB.m_StoredBlock);
+    struct TestAsyncGetBlockComplete fullCB;
+    ASSERT_EQ(0, fs_block_store_api->GetStoredBlock(fs_block_store_api, 0x1000, &fullCB.m_API));
+    fullCB.Wait();
+    ASSERT_EQ(0, fullCB.m_Err);
+    ASSERT_EQ(0, Longtail_ValidateStoredBlockData(fullCB.m_StoredBlock));
+    fullCB.m_StoredBlock->Dispose(fullCB.m_StoredBlock);
+
+    Longtail_Free(similar_data);
+    Longtail_Free(base_data);
+    SAFE_DISPOSE_API(delta_block_store_api);
+    SAFE_DISPOSE_API(fs_block_store_api);
+    SAFE_DISPOSE_API(job_api);
+    SAFE_DISPOSE_API(storage_api);
+}
+
+TEST(Longtail, Longtail_GetContentTypeAssetTags)
+{
+    Longtail_StorageAPI* storage_api = Longtail_CreateInMemStorageAPI();
+    static const char* PATHS[4] = {"data/level.bin", "data/intro.BK2", "data/music.ogg", "data/icons.png/readme"};
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        ASSERT_EQ(0, EnsureParentPathExists(storage_api, PATHS[i]));
+        Longtail_StorageAPI_HOpenFile content_file;
+        ASSERT_EQ(0, storage_api->OpenWriteFile(storage_api, PATHS[i], 0, &content_file));
+        ASSERT_EQ(0, storage_api->Write(storage_api, content_file, 0, 1, "x"));
+        storage_api->CloseFile(storage_api, content_file);
+    }
+    Longtail_FileInfos* file_infos;
+    ASSERT_EQ(0, Longtail_GetFilesRecursively(storage_api, 0, 0, 0, "data", &file_infos));
+    ASSERT_EQ(5u, file_infos->m_Count);
+    uint32_t* tags = (uint32_t*)Longtail_Alloc(0, sizeof(uint32_t) * file_infos->m_Count);
+    ASSERT_EQ(0, Longtail_GetContentTypeAssetTags(file_infos, 17, 4, tags));
+    for (uint32_t f = 0; f < file_infos->m_Count; ++f)
+    {
+        const char* path = Longtail_FileInfos_GetPath(file_infos, f);
+        int compressed = strcmp(path, "intro.BK2") == 0 || strcmp(path, "music.ogg") == 0;
+        ASSERT_EQ(compressed ? 4u : 17u, tags[f]);
+    }
+    Longtail_Free(tags);
+    Longtail_Free(file_infos);
+    SAFE_DISPOSE_API(storage_api);
 }
 
 #if 0